@@ -0,0 +1,477 @@
+#include "binaryProtocol.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+
+
+ByteWriter::ByteWriter()
+        : mBytes( NULL ),
+          mSize( 0 ),
+          mCapacity( 0 ) {
+    }
+
+
+
+ByteWriter::~ByteWriter() {
+    if( mBytes != NULL ) {
+        delete [] mBytes;
+        }
+    }
+
+
+
+void ByteWriter::makeRoom( int inNumBytes ) {
+    if( mSize + inNumBytes <= mCapacity ) {
+        return;
+        }
+
+    int newCapacity = mCapacity * 2;
+
+    if( newCapacity < 256 ) {
+        newCapacity = 256;
+        }
+    while( newCapacity < mSize + inNumBytes ) {
+        newCapacity *= 2;
+        }
+
+    unsigned char *newBytes = new unsigned char[ newCapacity ];
+
+    if( mBytes != NULL ) {
+        memcpy( newBytes, mBytes, mSize );
+        delete [] mBytes;
+        }
+
+    mBytes = newBytes;
+    mCapacity = newCapacity;
+    }
+
+
+
+void ByteWriter::writeByte( unsigned char inByte ) {
+    makeRoom( 1 );
+    mBytes[ mSize ] = inByte;
+    mSize++;
+    }
+
+
+
+void ByteWriter::writeUInt( unsigned int inValue ) {
+    // at most 5 bytes for 32 bits
+    makeRoom( 5 );
+
+    while( inValue >= 0x80 ) {
+        mBytes[ mSize ] = (unsigned char)( ( inValue & 0x7F ) | 0x80 );
+        mSize++;
+        inValue >>= 7;
+        }
+    mBytes[ mSize ] = (unsigned char)inValue;
+    mSize++;
+    }
+
+
+
+void ByteWriter::writeInt( int inValue ) {
+    unsigned int u = (unsigned int)inValue;
+
+    writeUInt( ( u << 1 ) ^ ( inValue < 0 ? 0xFFFFFFFFu : 0 ) );
+    }
+
+
+
+void ByteWriter::writeFixed( double inValue, int inScale ) {
+    writeInt( (int)floor( inValue * inScale + 0.5 ) );
+    }
+
+
+
+void ByteWriter::writeBytes( const unsigned char *inBytes, int inLength ) {
+    makeRoom( inLength );
+    memcpy( &( mBytes[ mSize ] ), inBytes, inLength );
+    mSize += inLength;
+    }
+
+
+
+void ByteWriter::writeString( const char *inString ) {
+    int length = strlen( inString );
+
+    writeUInt( length );
+    writeBytes( (const unsigned char*)inString, length );
+    }
+
+
+
+
+ByteReader::ByteReader( const unsigned char *inBytes, int inLength )
+        : mBytes( inBytes ),
+          mLength( inLength ),
+          mPosition( 0 ),
+          mError( false ) {
+    }
+
+
+
+unsigned char ByteReader::readByte() {
+    if( mError || mPosition >= mLength ) {
+        mError = true;
+        return 0;
+        }
+
+    unsigned char b = mBytes[ mPosition ];
+    mPosition++;
+    return b;
+    }
+
+
+
+unsigned int ByteReader::readUInt() {
+    unsigned int value = 0;
+
+    for( int shift=0; shift<35; shift += 7 ) {
+        unsigned char b = readByte();
+
+        if( mError ) {
+            return 0;
+            }
+
+        value |= (unsigned int)( b & 0x7F ) << shift;
+
+        if( ( b & 0x80 ) == 0 ) {
+            return value;
+            }
+        }
+
+    // too many bytes
+    mError = true;
+    return 0;
+    }
+
+
+
+int ByteReader::readInt() {
+    unsigned int u = readUInt();
+
+    return (int)( ( u >> 1 ) ^ ( 0u - ( u & 1 ) ) );
+    }
+
+
+
+double ByteReader::readFixed( int inScale ) {
+    return (double)readInt() / inScale;
+    }
+
+
+
+void ByteReader::readString( SimpleVector<char> *ioText ) {
+    unsigned int length = readUInt();
+
+    if( mError ) {
+        return;
+        }
+
+    if( length > (unsigned int)( mLength - mPosition ) ) {
+        mError = true;
+        return;
+        }
+
+    ioText->appendArray( (char*)&( mBytes[ mPosition ] ), length );
+    mPosition += length;
+    }
+
+
+
+
+// appends printf-formatted value to ioText without allocating
+static void appendInt( SimpleVector<char> *ioText, int inValue ) {
+    char buffer[16];
+    int length = snprintf( buffer, sizeof( buffer ), "%d", inValue );
+    ioText->appendArray( buffer, length );
+    }
+
+
+static void appendFixed( SimpleVector<char> *ioText, double inValue,
+                         const char *inFormat ) {
+    char buffer[64];
+    int length = snprintf( buffer, sizeof( buffer ), inFormat, inValue );
+
+    if( length >= (int)sizeof( buffer ) ) {
+        length = sizeof( buffer ) - 1;
+        }
+    ioText->appendArray( buffer, length );
+    }
+
+
+
+void writeBinaryObject( ByteWriter *inWriter, int inID,
+                        int inNumContained, int *inContained,
+                        int *inNumSubContained, int **inSubContained ) {
+    inWriter->writeInt( inID );
+    inWriter->writeUInt( inNumContained );
+
+    for( int c=0; c<inNumContained; c++ ) {
+        inWriter->writeInt( inContained[c] );
+
+        if( inSubContained == NULL || inSubContained[c] == NULL ) {
+            inWriter->writeUInt( 0 );
+            }
+        else {
+            inWriter->writeUInt( inNumSubContained[c] );
+
+            for( int s=0; s<inNumSubContained[c]; s++ ) {
+                inWriter->writeInt( inSubContained[c][s] );
+                }
+            }
+        }
+    }
+
+
+
+void writeBinaryChunkCell( ByteWriter *inWriter,
+                           int inBiome, int inFloor, int inID,
+                           int inNumContained, int *inContained,
+                           int *inNumSubContained, int **inSubContained ) {
+    inWriter->writeInt( inBiome );
+    inWriter->writeInt( inFloor );
+
+    writeBinaryObject( inWriter, inID, inNumContained, inContained,
+                       inNumSubContained, inSubContained );
+    }
+
+
+
+char readBinaryChunkCell( ByteReader *inReader,
+                          int *outBiome, int *outFloor, int *outID,
+                          SimpleVector<int> *outContained,
+                          SimpleVector< SimpleVector<int> > *outSubContained ) {
+
+    outContained->deleteAll();
+    outSubContained->deleteAll();
+
+    *outBiome = inReader->readInt();
+    *outFloor = inReader->readInt();
+    *outID = inReader->readInt();
+
+    unsigned int numContained = inReader->readUInt();
+
+    for( unsigned int c=0; c<numContained && ! inReader->hadError(); c++ ) {
+        outContained->push_back( inReader->readInt() );
+
+        SimpleVector<int> subStack;
+        outSubContained->push_back( subStack );
+
+        SimpleVector<int> *sub =
+            outSubContained->getElement( outSubContained->size() - 1 );
+
+        unsigned int numSub = inReader->readUInt();
+
+        for( unsigned int s=0; s<numSub && ! inReader->hadError(); s++ ) {
+            sub->push_back( inReader->readInt() );
+            }
+        }
+
+    return ! inReader->hadError();
+    }
+
+
+
+// object as in writeBinaryObject to text, as in 345,3,4:5
+static void binaryObjectToText( ByteReader *inReader,
+                                SimpleVector<char> *ioText ) {
+    appendInt( ioText, inReader->readInt() );
+
+    unsigned int numContained = inReader->readUInt();
+
+    for( unsigned int c=0; c<numContained && ! inReader->hadError(); c++ ) {
+        ioText->push_back( ',' );
+        appendInt( ioText, inReader->readInt() );
+
+        unsigned int numSub = inReader->readUInt();
+
+        for( unsigned int s=0; s<numSub && ! inReader->hadError(); s++ ) {
+            ioText->push_back( ':' );
+            appendInt( ioText, inReader->readInt() );
+            }
+        }
+    }
+
+
+
+char binaryChunkCellToText( ByteReader *inReader,
+                            SimpleVector<char> *ioText ) {
+    appendInt( ioText, inReader->readInt() );
+    ioText->push_back( ':' );
+    appendInt( ioText, inReader->readInt() );
+    ioText->push_back( ':' );
+
+    binaryObjectToText( inReader, ioText );
+
+    return ! inReader->hadError();
+    }
+
+
+
+// same text as map.cpp's getMapChangeLineString
+static void mapChangeLineToText( ByteReader *inReader,
+                                 SimpleVector<char> *ioText ) {
+    int x = inReader->readInt();
+    int y = inReader->readInt();
+
+    char oldCoordsUsed = inReader->readByte();
+
+    int oldX = 0;
+    int oldY = 0;
+
+    if( oldCoordsUsed ) {
+        oldX = inReader->readInt();
+        oldY = inReader->readInt();
+        }
+
+    appendInt( ioText, x );
+    ioText->push_back( ' ' );
+    appendInt( ioText, y );
+    ioText->push_back( ' ' );
+
+    // floor
+    appendInt( ioText, inReader->readInt() );
+    ioText->push_back( ' ' );
+
+    binaryObjectToText( inReader, ioText );
+
+    // responsible player
+    ioText->push_back( ' ' );
+    appendInt( ioText, inReader->readInt() );
+
+    if( oldCoordsUsed ) {
+        ioText->push_back( ' ' );
+        appendInt( ioText, oldX );
+        ioText->push_back( ' ' );
+        appendInt( ioText, oldY );
+        ioText->push_back( ' ' );
+        appendFixed( ioText, inReader->readFixed( BINARY_MILLIONTHS ), "%f" );
+        }
+
+    ioText->push_back( '\n' );
+    }
+
+
+
+// same text as server.cpp's getUpdateLineFromRecord
+static void playerUpdateLineToText( ByteReader *inReader,
+                                    SimpleVector<char> *ioText ) {
+    char posUsed = inReader->readByte();
+
+    // action target, held origin, position
+    int pos[6] = { 0, 0, 0, 0, 0, 0 };
+
+    if( posUsed ) {
+        for( int i=0; i<6; i++ ) {
+            pos[i] = inReader->readInt();
+            }
+        }
+
+    // id, display ID, facing override, action attempt
+    for( int i=0; i<4; i++ ) {
+        appendInt( ioText, inReader->readInt() );
+        ioText->push_back( ' ' );
+        }
+
+    appendInt( ioText, pos[0] );
+    ioText->push_back( ' ' );
+    appendInt( ioText, pos[1] );
+    ioText->push_back( ' ' );
+
+    // holding
+    inReader->readString( ioText );
+    ioText->push_back( ' ' );
+
+    // held origin valid
+    appendInt( ioText, inReader->readInt() );
+    ioText->push_back( ' ' );
+
+    appendInt( ioText, pos[2] );
+    ioText->push_back( ' ' );
+    appendInt( ioText, pos[3] );
+    ioText->push_back( ' ' );
+
+    // held transition source
+    appendInt( ioText, inReader->readInt() );
+    ioText->push_back( ' ' );
+
+    // heat
+    appendFixed( ioText, inReader->readFixed( BINARY_HUNDREDTHS ), "%.2f" );
+    ioText->push_back( ' ' );
+
+    // done moving, forced
+    appendInt( ioText, inReader->readInt() );
+    ioText->push_back( ' ' );
+    appendInt( ioText, inReader->readInt() );
+    ioText->push_back( ' ' );
+
+    if( posUsed ) {
+        appendInt( ioText, pos[4] );
+        ioText->push_back( ' ' );
+        appendInt( ioText, pos[5] );
+        }
+    else {
+        ioText->appendArray( (char*)"X X", 3 );
+        }
+    ioText->push_back( ' ' );
+
+    // age, age rate, move speed
+    for( int i=0; i<3; i++ ) {
+        appendFixed( ioText, inReader->readFixed( BINARY_HUNDREDTHS ),
+                     "%.2f" );
+        ioText->push_back( ' ' );
+        }
+
+    // clothing
+    inReader->readString( ioText );
+
+    // just ate, just ate ID, responsible player, held yum
+    for( int i=0; i<4; i++ ) {
+        ioText->push_back( ' ' );
+        appendInt( ioText, inReader->readInt() );
+        }
+
+    // death reason, with its own leading space
+    inReader->readString( ioText );
+
+    ioText->push_back( '\n' );
+    }
+
+
+
+char *decodeBinaryMessage( const unsigned char *inData, int inLength ) {
+    ByteReader reader( inData, inLength );
+
+    unsigned char kind = reader.readByte();
+    unsigned int numLines = reader.readUInt();
+
+    SimpleVector<char> text;
+
+    if( kind == BINARY_MAP_CHANGE ) {
+        text.appendArray( (char*)"MX\n", 3 );
+
+        for( unsigned int i=0; i<numLines && ! reader.hadError(); i++ ) {
+            mapChangeLineToText( &reader, &text );
+            }
+        }
+    else if( kind == BINARY_PLAYER_UPDATE ) {
+        text.appendArray( (char*)"PU\n", 3 );
+
+        for( unsigned int i=0; i<numLines && ! reader.hadError(); i++ ) {
+            playerUpdateLineToText( &reader, &text );
+            }
+        }
+    else {
+        return NULL;
+        }
+
+    if( reader.hadError() ) {
+        return NULL;
+        }
+
+    return text.getElementString();
+    }
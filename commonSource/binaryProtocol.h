@@ -0,0 +1,218 @@
+#ifndef BINARY_PROTOCOL_H_INCLUDED
+#define BINARY_PROTOCOL_H_INCLUDED
+
+
+#include "minorGems/util/SimpleVector.h"
+
+
+// Binary encoding of MC, MX, and PU messages, shared by client and server.
+//
+// The server offers it by adding a line with BINARY_PROTOCOL_VERSION to
+// the end of the SN message.  A client that understands it adds
+// BINARY_PROTOCOL_LOGIN_TOKEN to the end of its LOGIN message.  Old
+// clients ignore the extra SN line, and never send the token.
+//
+// Numbers are varints, 7 bits per byte, low bits first, with the high bit
+// set on every byte but the last.  Signed numbers are zig-zag encoded
+// first, so small negative numbers stay short.  Fractional numbers are
+// sent as signed fixed-point values, and strings as a length followed by
+// their bytes.
+//
+// MC messages keep their text header, but their compressed cell data
+// is binary cells (see readBinaryChunkCell) instead of text.
+//
+// MX and PU lines are sent in BM messages:
+//
+//    BM
+//    raw_size compressed_size
+//    #
+//
+// followed by compressed_size bytes of zipped data, or, if compressed_size
+// is 0, raw_size bytes of unzipped data.  The data starts with
+// BINARY_MAP_CHANGE or BINARY_PLAYER_UPDATE, then the number of lines,
+// then the lines.  decodeBinaryMessage turns it back into the matching
+// text message.
+
+#define BINARY_PROTOCOL_VERSION 1
+
+#define BINARY_PROTOCOL_LOGIN_TOKEN "BIN1"
+
+
+#define BINARY_MAP_CHANGE 'X'
+#define BINARY_PLAYER_UPDATE 'U'
+
+
+// scale for fixed-point values sent in place of %.2f text
+#define BINARY_HUNDREDTHS 100
+
+// scale for fixed-point values sent in place of %f text
+#define BINARY_MILLIONTHS 1000000
+
+
+
+// Appends encoded values to a byte buffer that is kept between uses, so
+// messages can be built over and over without allocating.
+class ByteWriter {
+
+    public:
+
+        ByteWriter();
+
+        ~ByteWriter();
+
+
+        // empties buffer, keeping its memory
+        void reset() {
+            mSize = 0;
+            }
+
+
+        void writeByte( unsigned char inByte );
+
+        void writeUInt( unsigned int inValue );
+
+        // zig-zag encoded
+        void writeInt( int inValue );
+
+        // rounded to nearest 1/inScale
+        void writeFixed( double inValue, int inScale );
+
+        void writeBytes( const unsigned char *inBytes, int inLength );
+
+        // length, then bytes, without terminating \0
+        void writeString( const char *inString );
+
+
+        // pointer to bytes written so far
+        // valid until next write
+        unsigned char *getBytes() {
+            return mBytes;
+            }
+
+        int getSize() {
+            return mSize;
+            }
+
+
+    private:
+
+        unsigned char *mBytes;
+        int mSize;
+        int mCapacity;
+
+        void makeRoom( int inNumBytes );
+    };
+
+
+
+// Reads values written by ByteWriter.
+//
+// Reading past the end, or a malformed varint, sets an error flag and
+// returns 0 from then on, so callers can read a whole record and then
+// check hadError once.
+class ByteReader {
+
+    public:
+
+        ByteReader( const unsigned char *inBytes, int inLength );
+
+
+        unsigned char readByte();
+
+        unsigned int readUInt();
+
+        int readInt();
+
+        double readFixed( int inScale );
+
+        // appends string to ioText
+        void readString( SimpleVector<char> *ioText );
+
+
+        char hadError() {
+            return mError;
+            }
+
+        char isAtEnd() {
+            return mPosition >= mLength;
+            }
+
+
+    private:
+
+        const unsigned char *mBytes;
+        int mLength;
+        int mPosition;
+
+        char mError;
+    };
+
+
+
+// MX line:
+//    x, y, 1 if old coordinates follow or 0 if not, old x, old y, then
+//    body:  floor, object as in writeBinaryObject, responsible player,
+//    and speed in millionths if old coordinates were given
+//
+// PU line:
+//    1 if positions follow or 0 for a deleted player, then action target
+//    x, y, held origin x, y, and position x, y, then
+//    body:  id, display ID, facing override, action attempt, holding
+//    string, held origin valid, held transition source ID, heat in
+//    hundredths, done moving, forced, age, age rate, and move speed in
+//    hundredths, clothing string, just ate, just ate ID, responsible
+//    player, held yum, and death reason string
+//
+// bodies don't change from player to player, so the server encodes them
+// once, and only writes the positions, which are relative to each
+// player's birth position, per player
+
+
+
+// object ID, number of contained items, and for each contained item, its
+// ID, number of sub-contained items, and their IDs
+//
+// inSubContained can be NULL if nothing is sub-contained, and
+// inSubContained[i] can be NULL if item i contains nothing
+void writeBinaryObject( ByteWriter *inWriter, int inID,
+                        int inNumContained, int *inContained,
+                        int *inNumSubContained, int **inSubContained );
+
+
+
+// one map cell, as sent in binary MC data:
+//    biome, floor, then object as in writeBinaryObject
+void writeBinaryChunkCell( ByteWriter *inWriter,
+                           int inBiome, int inFloor, int inID,
+                           int inNumContained, int *inContained,
+                           int *inNumSubContained, int **inSubContained );
+
+
+// reads one cell written by writeBinaryChunkCell
+//
+// outContained and outSubContained are cleared first, and get one
+// element per contained item
+//
+// returns false on error
+char readBinaryChunkCell( ByteReader *inReader,
+                          int *outBiome, int *outFloor, int *outID,
+                          SimpleVector<int> *outContained,
+                          SimpleVector< SimpleVector<int> > *outSubContained );
+
+
+// reads one cell, and appends it to ioText the way text MC data has it,
+// as in 12:0:345,3,4:5
+//
+// returns false on error
+char binaryChunkCellToText( ByteReader *inReader, SimpleVector<char> *ioText );
+
+
+
+// turns data from a BM message (after unzipping) into text message with
+// same content, without terminating #
+//
+// returns NULL on error
+char *decodeBinaryMessage( const unsigned char *inData, int inLength );
+
+
+#endif
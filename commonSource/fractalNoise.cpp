@@ -140,3 +140,171 @@ double getXYFractal( int inX, int inY, double inRoughness, double inScale ) {
     
     return sum * oneOverIntMax;
     }
+
+
+
+void getXYRandomRegion( int inX, int inY, int inWidth, int inHeight,
+                        double *outValues ) {
+    for( int y=0; y<inHeight; y++ ) {
+        double *row = &( outValues[ y * inWidth ] );
+        
+        uint32_t cellY = inY + y;
+        
+        for( int x=0; x<inWidth; x++ ) {
+            row[x] = xxTweakedHash2D( inX + x, cellY ) * oneOverIntMax;
+            }
+        }
+    }
+
+
+
+// for one axis of one octave, lattice point below each cell and the
+// cell's offset from it, along with the sorted list of lattice points
+// needed by the cells, so the hash of each lattice point is computed
+// only once
+//
+// outLatticeIndex[i] is the index in outLattice of cell i's lattice point,
+// and the point above it is always at outLatticeIndex[i] + 1
+//
+// returns number of lattice points
+static int getRegionLattice( int inStart, int inLength, double inDivisor,
+                             int *outLatticeIndex, double *outOffset,
+                             int *outLattice ) {
+    int numLattice = 0;
+    
+    for( int i=0; i<inLength; i++ ) {
+        // same steps as getXYRandomBN
+        double v = ( inStart + i ) / inDivisor;
+        
+        int floorV = lrint( floor( v ) );
+        
+        outOffset[i] = v - floorV;
+        
+        // cells are in increasing order, so lattice points are too,
+        // and floorV is either past end of list, or one of last two
+        if( numLattice == 0 || outLattice[ numLattice - 1 ] < floorV ) {
+            outLattice[ numLattice ] = floorV;
+            numLattice++;
+            }
+        if( outLattice[ numLattice - 1 ] == floorV ) {
+            outLattice[ numLattice ] = floorV + 1;
+            numLattice++;
+            }
+        
+        outLatticeIndex[i] = numLattice - 2;
+        }
+    
+    return numLattice;
+    }
+
+
+
+// adds in one octave, as in getXYRandomBN, for whole region
+//
+// ioValues hold the octaves above this one, combined as in getXYFractal
+// if inFirst is false
+static void addFractalOctave( int inX, int inY, int inWidth, int inHeight,
+                              double inDivisor,
+                              double inA, double inB, char inFirst,
+                              double *ioValues ) {
+
+    // two lattice points per cell at most
+    int *colLatticeIndex = new int[ inWidth ];
+    double *colOffset = new double[ inWidth ];
+    int *colLattice = new int[ inWidth * 2 ];
+
+    int *rowLatticeIndex = new int[ inHeight ];
+    double *rowOffset = new double[ inHeight ];
+    int *rowLattice = new int[ inHeight * 2 ];
+    
+    int numCols = getRegionLattice( inX, inWidth, inDivisor,
+                                    colLatticeIndex, colOffset, colLattice );
+    int numRows = getRegionLattice( inY, inHeight, inDivisor,
+                                    rowLatticeIndex, rowOffset, rowLattice );
+    
+
+    // corner values, as doubles, for every lattice point used
+    double *corners = new double[ numCols * numRows ];
+    
+    for( int r=0; r<numRows; r++ ) {
+        double *cornerRow = &( corners[ r * numCols ] );
+        uint32_t latticeY = rowLattice[r];
+        
+        for( int c=0; c<numCols; c++ ) {
+            cornerRow[c] = xxTweakedHash2D( colLattice[c], latticeY );
+            }
+        }
+    
+
+    for( int y=0; y<inHeight; y++ ) {
+        double *cornersA = &( corners[ rowLatticeIndex[y] * numCols ] );
+        double *cornersB = cornersA + numCols;
+        
+        double yOffset = rowOffset[y];
+        
+        double *row = &( ioValues[ y * inWidth ] );
+
+        for( int x=0; x<inWidth; x++ ) {
+            int c = colLatticeIndex[x];
+            double xOffset = colOffset[x];
+
+            // same operations in same order as getXYRandomBN
+            double topBlend = 
+                cornersA[ c + 1 ] * xOffset + ( 1 - xOffset ) * cornersA[c];
+    
+            double bottomBlend = 
+                cornersB[ c + 1 ] * xOffset + ( 1 - xOffset ) * cornersB[c];
+    
+            double value = 
+                bottomBlend * yOffset + ( 1 - yOffset ) * topBlend;
+            
+            if( inFirst ) {
+                row[x] = value;
+                }
+            else {
+                row[x] = inA * value + inB * row[x];
+                }
+            }
+        }
+    
+    delete [] corners;
+
+    delete [] colLatticeIndex;
+    delete [] colOffset;
+    delete [] colLattice;
+
+    delete [] rowLatticeIndex;
+    delete [] rowOffset;
+    delete [] rowLattice;
+    }
+
+
+
+void getXYFractalRegion( int inX, int inY, int inWidth, int inHeight,
+                         double inRoughness, double inScale,
+                         double *outValues ) {
+    
+    double b = inRoughness;
+    double a = 1 - b;
+    
+    // getXYFractal nests octaves with finest innermost, so combine them
+    // from finest to coarsest, which gives same rounding
+    addFractalOctave( inX, inY, inWidth, inHeight, inScale, 
+                      a, b, true, outValues );
+    addFractalOctave( inX, inY, inWidth, inHeight, 2 * inScale, 
+                      a, b, false, outValues );
+    addFractalOctave( inX, inY, inWidth, inHeight, 4 * inScale, 
+                      a, b, false, outValues );
+    addFractalOctave( inX, inY, inWidth, inHeight, 8 * inScale, 
+                      a, b, false, outValues );
+    addFractalOctave( inX, inY, inWidth, inHeight, 16 * inScale, 
+                      a, b, false, outValues );
+    addFractalOctave( inX, inY, inWidth, inHeight, 32 * inScale, 
+                      a, b, false, outValues );
+    
+    int numCells = inWidth * inHeight;
+    
+    for( int i=0; i<numCells; i++ ) {
+        outValues[i] *= oneOverIntMax;
+        }
+    }
@@ -15,3 +15,17 @@ double getXYRandom( int inX, int inY );
 // BUT can be larger than 1 sometimes
 double getXYFractal( int inX, int inY, double inRoughness, double inScale );
 
+
+
+
+// same values as calling getXYRandom or getXYFractal for every cell in
+// a inWidth x inHeight rectangle with bottom-left corner at inX,inY,
+// bit-for-bit, but much faster than calling them one cell at a time
+//
+// outValues must hold inWidth * inHeight values, filled row by row
+void getXYRandomRegion( int inX, int inY, int inWidth, int inHeight,
+                        double *outValues );
+
+void getXYFractalRegion( int inX, int inY, int inWidth, int inHeight,
+                         double inRoughness, double inScale,
+                         double *outValues );
@@ -0,0 +1,318 @@
+#include "streamCompression.h"
+
+#include <string.h>
+
+
+
+#define STREAM_HASH_BITS 14
+#define STREAM_HASH_SIZE ( 1 << STREAM_HASH_BITS )
+
+
+
+// drops all but last window of history, and makes room to append
+// inLength more bytes
+//
+// returns number of bytes dropped from front
+static int makeHistoryRoom( unsigned char **ioHistory, int *ioSize,
+                            int *ioCapacity, int inLength ) {
+    int dropped = 0;
+
+    if( *ioSize > STREAM_WINDOW_SIZE ) {
+        dropped = *ioSize - STREAM_WINDOW_SIZE;
+
+        memmove( *ioHistory, &( ( *ioHistory )[ dropped ] ),
+                 STREAM_WINDOW_SIZE );
+        *ioSize = STREAM_WINDOW_SIZE;
+        }
+
+    if( *ioSize + inLength > *ioCapacity ) {
+        int newCapacity = 2 * STREAM_WINDOW_SIZE;
+
+        while( newCapacity < *ioSize + inLength ) {
+            newCapacity *= 2;
+            }
+
+        unsigned char *newHistory = new unsigned char[ newCapacity ];
+
+        if( *ioHistory != NULL ) {
+            memcpy( newHistory, *ioHistory, *ioSize );
+            delete [] *ioHistory;
+            }
+
+        *ioHistory = newHistory;
+        *ioCapacity = newCapacity;
+        }
+
+    return dropped;
+    }
+
+
+
+static inline unsigned int hashFour( const unsigned char *inBytes ) {
+    unsigned int v =
+        (unsigned int)inBytes[0] |
+        (unsigned int)inBytes[1] << 8 |
+        (unsigned int)inBytes[2] << 16 |
+        (unsigned int)inBytes[3] << 24;
+
+    return ( v * 2654435761U ) >> ( 32 - STREAM_HASH_BITS );
+    }
+
+
+
+StreamCompressor::StreamCompressor()
+        : mHistory( NULL ),
+          mHistorySize( 0 ),
+          mHistoryCapacity( 0 ),
+          mHistoryBase( 0 ),
+          mHashTable( new unsigned int[ STREAM_HASH_SIZE ] ) {
+
+    memset( mHashTable, 0, STREAM_HASH_SIZE * sizeof( unsigned int ) );
+    }
+
+
+
+StreamCompressor::~StreamCompressor() {
+    if( mHistory != NULL ) {
+        delete [] mHistory;
+        }
+    delete [] mHashTable;
+    }
+
+
+
+void StreamCompressor::compressBlock( const unsigned char *inData,
+                                      int inLength,
+                                      ByteWriter *outWriter ) {
+
+    mHistoryBase += makeHistoryRoom( &mHistory, &mHistorySize,
+                                     &mHistoryCapacity, inLength );
+
+    int start = mHistorySize;
+
+    memcpy( &( mHistory[ start ] ), inData, inLength );
+    mHistorySize += inLength;
+
+    int end = mHistorySize;
+
+
+    mSequences.reset();
+
+    int anchor = start;
+    int i = start;
+
+    while( i + STREAM_MIN_MATCH <= end ) {
+        unsigned int h = hashFour( &( mHistory[i] ) );
+
+        unsigned int pos = mHistoryBase + i;
+
+        unsigned int candidate = mHashTable[h];
+        mHashTable[h] = pos + 1;
+
+        if( candidate == 0 ) {
+            i++;
+            continue;
+            }
+
+        // unsigned, so wrapping of stream positions doesn't matter
+        unsigned int distance = pos - ( candidate - 1 );
+
+        if( distance == 0 || distance > STREAM_WINDOW_SIZE ||
+            distance > (unsigned int)i ) {
+            // too old
+            i++;
+            continue;
+            }
+
+        int c = i - distance;
+
+        if( memcmp( &( mHistory[c] ), &( mHistory[i] ),
+                    STREAM_MIN_MATCH ) != 0 ) {
+            i++;
+            continue;
+            }
+
+        // match can run into bytes it is copying, like RLE
+        int length = STREAM_MIN_MATCH;
+
+        while( i + length < end && mHistory[ c + length ] ==
+               mHistory[ i + length ] ) {
+            length++;
+            }
+
+        mSequences.writeUInt( i - anchor );
+        mSequences.writeBytes( &( mHistory[ anchor ] ), i - anchor );
+        mSequences.writeUInt( length - STREAM_MIN_MATCH + 1 );
+        mSequences.writeUInt( distance );
+
+        // remember places inside match too, so later matches can
+        // start there
+        int matchEnd = i + length;
+
+        for( int j=i+1; j < matchEnd && j + STREAM_MIN_MATCH <= end; j++ ) {
+            mHashTable[ hashFour( &( mHistory[j] ) ) ] =
+                mHistoryBase + j + 1;
+            }
+
+        i = matchEnd;
+        anchor = i;
+        }
+
+    mSequences.writeUInt( end - anchor );
+    mSequences.writeBytes( &( mHistory[ anchor ] ), end - anchor );
+    mSequences.writeUInt( 0 );
+
+
+    outWriter->writeUInt( inLength );
+    outWriter->writeUInt( mSequences.getSize() );
+    outWriter->writeBytes( mSequences.getBytes(), mSequences.getSize() );
+    }
+
+
+
+
+StreamDecompressor::StreamDecompressor()
+        : mHistory( NULL ),
+          mHistorySize( 0 ),
+          mHistoryCapacity( 0 ) {
+    }
+
+
+
+StreamDecompressor::~StreamDecompressor() {
+    if( mHistory != NULL ) {
+        delete [] mHistory;
+        }
+    }
+
+
+
+char StreamDecompressor::addBytes( const unsigned char *inBytes,
+                                   int inLength,
+                                   SimpleVector<unsigned char> *ioData ) {
+
+    mPending.appendArray( (unsigned char*)inBytes, inLength );
+
+    while( true ) {
+        int result = decodeNextBlock( ioData );
+
+        if( result == -1 ) {
+            return false;
+            }
+        if( result == 0 ) {
+            return true;
+            }
+        }
+    }
+
+
+
+int StreamDecompressor::decodeNextBlock(
+    SimpleVector<unsigned char> *ioData ) {
+
+    int numPending = mPending.size();
+
+    if( numPending == 0 ) {
+        return 0;
+        }
+
+    unsigned char *pending = mPending.getElement( 0 );
+
+    ByteReader header( pending, numPending );
+
+    unsigned int rawSize = header.readUInt();
+    unsigned int compSize = header.readUInt();
+
+    if( header.hadError() ) {
+        if( numPending >= 10 ) {
+            // two varints never take more than 10 bytes
+            return -1;
+            }
+        // rest of header not here yet
+        return 0;
+        }
+
+    if( rawSize > STREAM_MAX_BLOCK_SIZE ||
+        compSize > 2 * STREAM_MAX_BLOCK_SIZE ) {
+        return -1;
+        }
+
+    // varints take 1 byte for each 7 bits
+    int headerSize = 1;
+    while( rawSize >> ( 7 * headerSize ) != 0 ) {
+        headerSize++;
+        }
+    int compSizeBytes = 1;
+    while( compSize >> ( 7 * compSizeBytes ) != 0 ) {
+        compSizeBytes++;
+        }
+    headerSize += compSizeBytes;
+
+    if( (unsigned int)( numPending - headerSize ) < compSize ) {
+        // rest of block not here yet
+        return 0;
+        }
+
+
+    makeHistoryRoom( &mHistory, &mHistorySize, &mHistoryCapacity, rawSize );
+
+    int start = mHistorySize;
+    int end = start + rawSize;
+    int out = start;
+
+    ByteReader reader( &( pending[ headerSize ] ), compSize );
+
+    while( true ) {
+        unsigned int numLiterals = reader.readUInt();
+
+        if( reader.hadError() || numLiterals > (unsigned int)( end - out ) ) {
+            return -1;
+            }
+
+        for( unsigned int l=0; l<numLiterals; l++ ) {
+            mHistory[ out ] = reader.readByte();
+            out++;
+            }
+
+        unsigned int code = reader.readUInt();
+
+        if( reader.hadError() ) {
+            return -1;
+            }
+
+        if( code == 0 ) {
+            break;
+            }
+
+        unsigned int length = code + STREAM_MIN_MATCH - 1;
+        unsigned int distance = reader.readUInt();
+
+        if( reader.hadError() ||
+            length > (unsigned int)( end - out ) ||
+            distance == 0 || distance > STREAM_WINDOW_SIZE ||
+            distance > (unsigned int)out ) {
+            return -1;
+            }
+
+        // byte by byte, since match can overlap bytes it writes
+        unsigned char *dest = &( mHistory[ out ] );
+        unsigned char *source = dest - distance;
+
+        for( unsigned int b=0; b<length; b++ ) {
+            dest[b] = source[b];
+            }
+        out += length;
+        }
+
+    if( out != end || ! reader.isAtEnd() ) {
+        return -1;
+        }
+
+    mHistorySize = end;
+
+    ioData->appendArray( &( mHistory[ start ] ), rawSize );
+
+    mPending.deleteStartElements( headerSize + compSize );
+
+    return 1;
+    }
@@ -0,0 +1,117 @@
+#ifndef STREAM_COMPRESSION_H_INCLUDED
+#define STREAM_COMPRESSION_H_INCLUDED
+
+
+#include "minorGems/util/SimpleVector.h"
+
+#include "binaryProtocol.h"
+
+
+// Compression of everything the server sends to one client, with history
+// that carries over from message to message.
+//
+// zipCompress starts from nothing for every message, so small messages
+// aren't worth compressing at all, and larger ones never get to point
+// back at the object IDs and player lines that the last message just
+// sent.  Here both ends keep the last STREAM_WINDOW_SIZE bytes of the
+// stream, and each block can copy from anywhere in that window.
+//
+// The server offers it with a line holding STREAM_COMPRESSION_VERSION
+// after the binary protocol line at the end of the SN message.  A client
+// that wants it adds STREAM_COMPRESSION_LOGIN_TOKEN to the end of its
+// LOGIN message.  Every byte that the server sends after ACCEPTED is then
+// part of a block:
+//
+//    raw size, compressed size, then compressed size bytes of sequences
+//
+// Each sequence is a literal count, that many literal bytes, and a
+// match length code.  Code 0 ends the block.  Otherwise a distance
+// follows, and ( code + STREAM_MIN_MATCH - 1 ) bytes are copied from
+// that far back in the stream.  Numbers are varints, as in
+// binaryProtocol.h.
+//
+// Each block holds whatever the server handed to the socket in one send,
+// so the client can decode it as soon as it has arrived.
+
+#define STREAM_COMPRESSION_VERSION 1
+
+#define STREAM_COMPRESSION_LOGIN_TOKEN "STR1"
+
+
+#define STREAM_WINDOW_SIZE 65536
+
+#define STREAM_MIN_MATCH 4
+
+// blocks that claim to be larger than this are treated as corrupt
+#define STREAM_MAX_BLOCK_SIZE 16777216
+
+
+
+class StreamCompressor {
+
+    public:
+
+        StreamCompressor();
+
+        ~StreamCompressor();
+
+
+        // appends one block holding inData to outWriter
+        void compressBlock( const unsigned char *inData, int inLength,
+                            ByteWriter *outWriter );
+
+
+    private:
+
+        // last window of stream, followed by block being compressed
+        unsigned char *mHistory;
+        int mHistorySize;
+        int mHistoryCapacity;
+
+        // stream position of mHistory[0]
+        unsigned int mHistoryBase;
+
+        // stream position + 1 of last place each hash was seen, 0 if none
+        unsigned int *mHashTable;
+
+        // sequences for block being compressed
+        ByteWriter mSequences;
+    };
+
+
+
+class StreamDecompressor {
+
+    public:
+
+        StreamDecompressor();
+
+        ~StreamDecompressor();
+
+
+        // takes stream bytes as they arrive, and appends data of each
+        // block that is complete to ioData
+        //
+        // returns false if stream is corrupt
+        char addBytes( const unsigned char *inBytes, int inLength,
+                       SimpleVector<unsigned char> *ioData );
+
+
+    private:
+
+        // bytes of a block that hasn't fully arrived yet
+        SimpleVector<unsigned char> mPending;
+
+        unsigned char *mHistory;
+        int mHistorySize;
+        int mHistoryCapacity;
+
+
+        // returns 1 if a block was decoded, 0 if next block isn't
+        // complete yet, or -1 on error
+        int decodeNextBlock( SimpleVector<unsigned char> *ioData );
+    };
+
+
+
+#endif
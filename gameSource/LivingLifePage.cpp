@@ -23,6 +23,8 @@
 #include "liveAnimationTriggers.h"
 
 #include "../commonSource/fractalNoise.h"
+#include "../commonSource/binaryProtocol.h"
+#include "../commonSource/streamCompression.h"
 
 #include "minorGems/util/SimpleVector.h"
 #include "minorGems/util/MinPriorityQueue.h"
@@ -659,6 +661,16 @@ static void replaceLastMessageSent( char *inNewMessage ) {
 
 SimpleVector<unsigned char> serverSocketBuffer;
 
+// true if we asked for stream compression in LOGIN
+static char streamCompressionRequested = false;
+
+// non-NULL once server has accepted us with stream compression
+// turns bytes read from socket into serverSocketBuffer contents
+// see streamCompression.h
+static StreamDecompressor *serverStreamDecompressor = NULL;
+
+static char serverStreamCorrupt = false;
+
 static char serverSocketConnected = false;
 static float connectionMessageFade = 1.0f;
 static double connectedTime = 0;
@@ -670,6 +682,10 @@ static char readServerSocketFull( int inServerSocket ) {
 
     unsigned char buffer[512];
     
+    if( serverStreamCorrupt ) {
+        return false;
+        }
+    
     int numRead = readFromSocket( inServerSocket, buffer, 512 );
     
     
@@ -679,7 +695,17 @@ static char readServerSocketFull( int inServerSocket ) {
             connectedTime = game_getCurrentTime();
             }
         
-        serverSocketBuffer.appendArray( buffer, numRead );
+        if( serverStreamDecompressor != NULL ) {
+            if( ! serverStreamDecompressor->addBytes( buffer, numRead,
+                                                      &serverSocketBuffer ) ) {
+                printf( "Corrupt compressed stream from server\n" );
+                serverStreamCorrupt = true;
+                return false;
+                }
+            }
+        else {
+            serverSocketBuffer.appendArray( buffer, numRead );
+            }
         numServerBytesRead += numRead;
         bytesInCount += numRead;
         
@@ -925,6 +951,7 @@ typedef enum messageType {
     FORCED_SHUTDOWN,
     PONG,
     COMPRESSED_MESSAGE,
+    BINARY_MESSAGE,
     UNKNOWN
     } messageType;
 
@@ -962,6 +989,9 @@ messageType getMessageType( char *inMessage ) {
     else if( strcmp( copy, "CM" ) == 0 ) {
         returnValue = COMPRESSED_MESSAGE;
         }
+    else if( strcmp( copy, "BM" ) == 0 ) {
+        returnValue = BINARY_MESSAGE;
+        }
     else if( strcmp( copy, "MC" ) == 0 ) {
         returnValue = MAP_CHUNK;
         }
@@ -1074,6 +1104,16 @@ char pendingCMData = false;
 int pendingCMCompressedSize = 0;
 int pendingCMDecompressedSize = 0;
 
+// BM data waiting after header, zipped unless pendingBMCompressedSize is 0
+char pendingBMData = false;
+int pendingBMCompressedSize = 0;
+int pendingBMRawSize = 0;
+
+
+// true if server accepted our offer to use binary MC, MX, and PU
+// see binaryProtocol.h
+static char binaryProtocolInUse = false;
+
 
 SimpleVector<char*> readyPendingReceivedMessages;
 
@@ -1150,6 +1190,55 @@ char *getNextServerMessageRaw() {
             }
         }
     
+    if( pendingBMData ) {
+        int dataSize = pendingBMCompressedSize;
+        
+        if( dataSize == 0 ) {
+            dataSize = pendingBMRawSize;
+            }
+        
+        if( serverSocketBuffer.size() >= dataSize ) {
+            pendingBMData = false;
+            
+            unsigned char *data = new unsigned char[ dataSize ];
+            
+            for( int i=0; i<dataSize; i++ ) {
+                data[i] = serverSocketBuffer.getElementDirect( i );
+                }
+            serverSocketBuffer.deleteStartElements( dataSize );
+            
+            if( pendingBMCompressedSize > 0 ) {
+                unsigned char *rawData =
+                    zipDecompress( data, 
+                                   pendingBMCompressedSize,
+                                   pendingBMRawSize );
+                delete [] data;
+                
+                if( rawData == NULL ) {
+                    printf( "Decompressing BM message failed\n" );
+                    return NULL;
+                    }
+                data = rawData;
+                }
+            
+            char *textMessage = decodeBinaryMessage( data, pendingBMRawSize );
+            
+            delete [] data;
+            
+            if( textMessage == NULL ) {
+                printf( "Decoding BM message failed\n" );
+                return NULL;
+                }
+            
+            messagesInCount++;
+            return textMessage;
+            }
+        else {
+            // wait for more data to arrive
+            return NULL;
+            }
+        }
+    
 
 
     // find first terminal character #
@@ -1203,6 +1292,15 @@ char *getNextServerMessageRaw() {
         sscanf( message, "CM\n%d %d\n", 
                 &pendingCMDecompressedSize, &pendingCMCompressedSize );
 
+        delete [] message;
+        return NULL;
+        }
+    else if( getMessageType( message ) == BINARY_MESSAGE ) {
+        pendingBMData = true;
+        
+        sscanf( message, "BM\n%d %d\n", 
+                &pendingBMRawSize, &pendingBMCompressedSize );
+
         delete [] message;
         return NULL;
         }
@@ -10839,12 +10937,19 @@ void LivingLifePage::step() {
             int maxPlayers = 0;
             mRequiredVersion = versionNumber;
             
+            // older servers don't send these lines
+            int serverBinaryVersion = 0;
+            int serverStreamVersion = 0;
+
             sscanf( message, 
                     "SN\n"
                     "%d/%d\n"
                     "%199s\n"
+                    "%d\n"
+                    "%d\n"
                     "%d\n", &currentPlayers, &maxPlayers, challengeString, 
-                    &mRequiredVersion );
+                    &mRequiredVersion, &serverBinaryVersion,
+                    &serverStreamVersion );
             
 
             if( mRequiredVersion > versionNumber ||
@@ -10912,6 +11017,30 @@ void LivingLifePage::step() {
             else {
                 twinExtra = stringDuplicate( "" );
                 }
+            
+            binaryProtocolInUse = false;
+            
+            if( serverBinaryVersion >= BINARY_PROTOCOL_VERSION ) {
+                // binary token always last, after any twin tokens
+                char *temp = autoSprintf( "%s %s", twinExtra,
+                                          BINARY_PROTOCOL_LOGIN_TOKEN );
+                delete [] twinExtra;
+                twinExtra = temp;
+                
+                binaryProtocolInUse = true;
+                }
+            
+            streamCompressionRequested = false;
+            
+            if( serverStreamVersion >= STREAM_COMPRESSION_VERSION ) {
+                // stream token always last, after binary token
+                char *temp = autoSprintf( "%s %s", twinExtra,
+                                          STREAM_COMPRESSION_LOGIN_TOKEN );
+                delete [] twinExtra;
+                twinExtra = temp;
+                
+                streamCompressionRequested = true;
+                }
                                          
 
             char *outMessage;
@@ -10962,6 +11091,28 @@ void LivingLifePage::step() {
             
             // subsequent messages should all be part of FRAME batches
             waitForFrameMessages = true;
+            
+            if( streamCompressionRequested && 
+                serverStreamDecompressor == NULL ) {
+                // everything server sent after ACCEPTED is compressed,
+                // including what we've already read
+                serverStreamDecompressor = new StreamDecompressor();
+                
+                int numWaiting = serverSocketBuffer.size();
+                
+                if( numWaiting > 0 ) {
+                    unsigned char *waiting = 
+                        serverSocketBuffer.getElementArray();
+                    serverSocketBuffer.deleteAll();
+                    
+                    if( ! serverStreamDecompressor->addBytes( 
+                            waiting, numWaiting, &serverSocketBuffer ) ) {
+                        printf( "Corrupt compressed stream from server\n" );
+                        serverStreamCorrupt = true;
+                        }
+                    delete [] waiting;
+                    }
+                }
 
             SettingsManager::setSetting( "loginSuccess", 1 );
 
@@ -11664,114 +11815,165 @@ void LivingLifePage::step() {
                 printf( "Decompressing chunk failed\n" );
                 }
             else {
+                if( binaryProtocolInUse ) {
+                    ByteReader reader( decompressedChunk, binarySize );
                 
-                unsigned char *binaryChunk = 
-                    new unsigned char[ binarySize + 1 ];
+                    SimpleVector<int> contained;
+                    SimpleVector< SimpleVector<int> > subContained;
+                
+                    int numCells = sizeX * sizeY;
+                
+                    for( int i=0; i<numCells; i++ ) {
+                        int biome, floor, id;
+                    
+                        if( ! readBinaryChunkCell( &reader, 
+                                                   &biome, &floor, &id,
+                                                   &contained, 
+                                                   &subContained ) ) {
+                            printf( "Reading binary chunk failed at cell %d\n",
+                                    i );
+                            break;
+                            }
+                    
+                        int cX = i % sizeX;
+                        int cY = i / sizeX;
+                        
+                        int mapX = cX + x - mMapOffsetX + mMapD / 2;
+                        int mapY = cY + y - mMapOffsetY + mMapD / 2;
+                        
+                        if( mapX >= 0 && mapX < mMapD
+                            &&
+                            mapY >= 0 && mapY < mMapD ) {
+                        
+                            int mapI = mapY * mMapD + mapX;
+                        
+                            if( mMap[mapI] != id ) {
+                                // our placement status cleared
+                                mMapPlayerPlacedFlags[mapI] = false;
+                                }
+                        
+                            mMapBiomes[mapI] = biome;
+                            mMapFloors[mapI] = floor;
+                            mMap[mapI] = id;
+                        
+                            // assign, so copy constructors are invoked
+                            mMapContainedStacks[mapI] = contained;
+                            mMapSubContainedStacks[mapI] = subContained;
+                            }
+                        }
+                
+                    delete [] decompressedChunk;
+                    }
+                else {
+                
+                    unsigned char *binaryChunk = 
+                        new unsigned char[ binarySize + 1 ];
             
-                memcpy( binaryChunk, decompressedChunk, binarySize );
+                    memcpy( binaryChunk, decompressedChunk, binarySize );
             
-                delete [] decompressedChunk;
+                    delete [] decompressedChunk;
  
             
-                // for now, binary chunk is actually just ASCII
-                binaryChunk[ binarySize ] = '\0';
+                    // without binary protocol, chunk is just ASCII
+                    binaryChunk[ binarySize ] = '\0';
             
                 
-                SimpleVector<char *> *tokens = 
-                    tokenizeString( (char*)binaryChunk );
+                    SimpleVector<char *> *tokens = 
+                        tokenizeString( (char*)binaryChunk );
             
-                delete [] binaryChunk;
+                    delete [] binaryChunk;
 
 
-                int numCells = sizeX * sizeY;
+                    int numCells = sizeX * sizeY;
                 
-                if( tokens->size() == numCells ) {
+                    if( tokens->size() == numCells ) {
                     
-                    for( int i=0; i<tokens->size(); i++ ) {
-                        int cX = i % sizeX;
-                        int cY = i / sizeX;
+                        for( int i=0; i<tokens->size(); i++ ) {
+                            int cX = i % sizeX;
+                            int cY = i / sizeX;
                         
-                        int mapX = cX + x - mMapOffsetX + mMapD / 2;
-                        int mapY = cY + y - mMapOffsetY + mMapD / 2;
+                            int mapX = cX + x - mMapOffsetX + mMapD / 2;
+                            int mapY = cY + y - mMapOffsetY + mMapD / 2;
                         
-                        if( mapX >= 0 && mapX < mMapD
-                            &&
-                            mapY >= 0 && mapY < mMapD ) {
+                            if( mapX >= 0 && mapX < mMapD
+                                &&
+                                mapY >= 0 && mapY < mMapD ) {
                             
                             
-                            int mapI = mapY * mMapD + mapX;
-                            int oldMapID = mMap[mapI];
+                                int mapI = mapY * mMapD + mapX;
+                                int oldMapID = mMap[mapI];
                             
-                            sscanf( tokens->getElementDirect(i),
-                                    "%d:%d:%d", 
-                                    &( mMapBiomes[mapI] ),
-                                    &( mMapFloors[mapI] ),
-                                    &( mMap[mapI] ) );
+                                sscanf( tokens->getElementDirect(i),
+                                        "%d:%d:%d", 
+                                        &( mMapBiomes[mapI] ),
+                                        &( mMapFloors[mapI] ),
+                                        &( mMap[mapI] ) );
                             
-                            if( mMap[mapI] != oldMapID ) {
-                                // our placement status cleared
-                                mMapPlayerPlacedFlags[mapI] = false;
-                                }
+                                if( mMap[mapI] != oldMapID ) {
+                                    // our placement status cleared
+                                    mMapPlayerPlacedFlags[mapI] = false;
+                                    }
 
-                            mMapContainedStacks[mapI].deleteAll();
-                            mMapSubContainedStacks[mapI].deleteAll();
+                                mMapContainedStacks[mapI].deleteAll();
+                                mMapSubContainedStacks[mapI].deleteAll();
                             
-                            if( strstr( tokens->getElementDirect(i), "," ) 
-                                != NULL ) {
+                                if( strstr( tokens->getElementDirect(i), "," ) 
+                                    != NULL ) {
                                 
-                                int numInts;
-                                char **ints = 
-                                    split( tokens->getElementDirect(i), 
-                                           ",", &numInts );
+                                    int numInts;
+                                    char **ints = 
+                                        split( tokens->getElementDirect(i), 
+                                               ",", &numInts );
                                 
-                                delete [] ints[0];
+                                    delete [] ints[0];
                                 
-                                int numContained = numInts - 1;
+                                    int numContained = numInts - 1;
                                 
-                                for( int c=0; c<numContained; c++ ) {
-                                    SimpleVector<int> newSubStack;
+                                    for( int c=0; c<numContained; c++ ) {
+                                        SimpleVector<int> newSubStack;
                                     
-                                    mMapSubContainedStacks[mapI].push_back(
-                                        newSubStack );
+                                        mMapSubContainedStacks[mapI].push_back(
+                                            newSubStack );
                                     
-                                    int contained = atoi( ints[ c + 1 ] );
-                                    mMapContainedStacks[mapI].push_back( 
-                                        contained );
+                                        int contained = atoi( ints[ c + 1 ] );
+                                        mMapContainedStacks[mapI].push_back( 
+                                            contained );
                                     
-                                    if( strstr( ints[c + 1], ":" ) != NULL ) {
-                                        // sub-container items
+                                        if( strstr( ints[c + 1], ":" ) != NULL ) {
+                                            // sub-container items
                                 
-                                        int numSubInts;
-                                        char **subInts = 
-                                            split( ints[c + 1], 
-                                                   ":", &numSubInts );
+                                            int numSubInts;
+                                            char **subInts = 
+                                                split( ints[c + 1], 
+                                                       ":", &numSubInts );
                                 
-                                        delete [] subInts[0];
-                                        int numSubCont = numSubInts - 1;
+                                            delete [] subInts[0];
+                                            int numSubCont = numSubInts - 1;
 
-                                        SimpleVector<int> *subStack =
-                                            mMapSubContainedStacks[mapI].
-                                            getElement(c);
+                                            SimpleVector<int> *subStack =
+                                                mMapSubContainedStacks[mapI].
+                                                getElement(c);
 
-                                        for( int s=0; s<numSubCont; s++ ) {
-                                            subStack->push_back(
-                                                atoi( subInts[ s + 1 ] ) );
-                                            delete [] subInts[ s + 1 ];
+                                            for( int s=0; s<numSubCont; s++ ) {
+                                                subStack->push_back(
+                                                    atoi( subInts[ s + 1 ] ) );
+                                                delete [] subInts[ s + 1 ];
+                                                }
+
+                                            delete [] subInts;
                                             }
 
-                                        delete [] subInts;
+                                        delete [] ints[ c + 1 ];
                                         }
-
-                                    delete [] ints[ c + 1 ];
+                                    delete [] ints;
                                     }
-                                delete [] ints;
                                 }
                             }
-                        }
-                    }   
+                        }   
                 
-                tokens->deallocateStringElements();
-                delete tokens;
+                    tokens->deallocateStringElements();
+                    delete tokens;
+                    }
                 
                 if( !( mFirstServerMessagesReceived & 1 ) ) {
                     // first map chunk just recieved
@@ -17683,6 +17885,16 @@ void LivingLifePage::makeActive( char inFresh ) {
         pendingMapChunkMessage = NULL;
         }
     pendingCMData = false;
+    pendingBMData = false;
+    binaryProtocolInUse = false;
+    
+    streamCompressionRequested = false;
+    serverStreamCorrupt = false;
+    
+    if( serverStreamDecompressor != NULL ) {
+        delete serverStreamDecompressor;
+        serverStreamDecompressor = NULL;
+        }
     
 
     clearLiveObjects();
@@ -5,6 +5,7 @@ git pull
 
 
 sh makePrintLifeLogStatsHTML
+sh makeIngestLogs
 
 
 
@@ -36,4 +37,8 @@ done <  <( grep "" ~/www/reflector/remoteServerList.ini )
 
 
 
+# parse only new and changed logs into logStore, which stats tools read
+/home/jcr15/checkout/OneLifeWorking/server/ingestLogs /home/jcr15/checkout/OneLife/server
+
+
 /home/jcr15/checkout/OneLifeWorking/server/printLifeLogStatsHTML /home/jcr15/checkout/OneLife/server /home/jcr15/public_html/lifeStats.php
@@ -0,0 +1,318 @@
+#ifndef FLAT_HASH_TABLE_H_INCLUDED
+#define FLAT_HASH_TABLE_H_INCLUDED
+
+
+#include <stddef.h>
+
+
+
+// Drop-in replacement for HashTable, keyed by four ints, that keeps
+// all entries in one flat array with open addressing (linear probing).
+//
+// A lookup hashes to a slot and walks forward through neighboring slots
+// until it finds the key or an empty slot, so it touches one array
+// instead of chasing a pointer to each of five per-bin vectors.
+//
+// The table doubles in size whenever it gets more than half full.
+//
+// Removal shifts later entries in the same probe run back into the
+// freed slot, so there are no tombstones, and lookups never slow down
+// after many inserts and removes.
+template <class Type>
+class FlatHashTable {
+
+    public:
+
+        // inSize is starting number of slots, rounded up to a power of 2
+        //
+        // note that inDefaultValue MUST be provided
+        // for any Type that cannot have a value of NULL (example: a struct)
+        FlatHashTable( int inSize,
+                       Type inDefaultValue = (Type)NULL );
+
+        ~FlatHashTable();
+
+        Type lookup( int inKeyA, int inKeyB, int inKeyC, int inKeyD,
+                     char *outFound );
+
+        // pointer to entry
+        // valid until next insert or remove
+        Type *lookupPointer( int inKeyA, int inKeyB, int inKeyC, int inKeyD );
+
+        void insert( int inKeyA, int inKeyB, int inKeyC, int inKeyD,
+                     Type inItem );
+
+        void remove( int inKeyA, int inKeyB, int inKeyC, int inKeyD );
+
+
+        int getNumElements() {
+            return mNumElements;
+            }
+
+        // flush all entries from table
+        void clear();
+
+    private:
+
+        typedef struct Slot {
+                int keyA, keyB, keyC, keyD;
+                Type item;
+                char used;
+            } Slot;
+
+        // always a power of 2
+        int mSize;
+
+        int mNumElements;
+
+        Type mDefaultValue;
+
+        Slot *mSlots;
+
+        int computeHash( int inKeyA, int inKeyB, int inKeyC, int inKeyD );
+
+        // returns slot index, or -1 if not found
+        int findSlot( int inKeyA, int inKeyB, int inKeyC, int inKeyD );
+
+        void grow();
+    };
+
+
+
+template <class Type>
+FlatHashTable<Type>::FlatHashTable( int inSize, Type inDefaultValue )
+        : mSize( 16 ),
+          mNumElements( 0 ),
+          mDefaultValue( inDefaultValue ) {
+
+    while( mSize < inSize ) {
+        mSize *= 2;
+        }
+
+    mSlots = new Slot[ mSize ];
+
+    for( int i=0; i<mSize; i++ ) {
+        mSlots[i].used = false;
+        }
+    }
+
+
+
+template <class Type>
+FlatHashTable<Type>::~FlatHashTable() {
+    delete [] mSlots;
+    }
+
+
+
+template <class Type>
+inline int FlatHashTable<Type>::computeHash( int inKeyA, int inKeyB,
+                                             int inKeyC, int inKeyD ) {
+    // we index with the low bits only, so mix well (the murmur3
+    // finalizer) after combining keys
+    unsigned int h =
+        (unsigned int)inKeyA * 734727U +
+        (unsigned int)inKeyB * 263471U +
+        (unsigned int)inKeyC * 2753U +
+        (unsigned int)inKeyD * 948731U;
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+
+    return (int)( h & (unsigned int)( mSize - 1 ) );
+    }
+
+
+
+template <class Type>
+int FlatHashTable<Type>::findSlot( int inKeyA, int inKeyB, int inKeyC,
+                                   int inKeyD ) {
+
+    int mask = mSize - 1;
+
+    int i = computeHash( inKeyA, inKeyB, inKeyC, inKeyD );
+
+    while( mSlots[i].used ) {
+        Slot *s = &( mSlots[i] );
+
+        if( s->keyA == inKeyA &&
+            s->keyB == inKeyB &&
+            s->keyC == inKeyC &&
+            s->keyD == inKeyD ) {
+            return i;
+            }
+        i = ( i + 1 ) & mask;
+        }
+
+    return -1;
+    }
+
+
+
+template <class Type>
+void FlatHashTable<Type>::grow() {
+    Slot *oldSlots = mSlots;
+    int oldSize = mSize;
+
+    mSize *= 2;
+    mSlots = new Slot[ mSize ];
+
+    for( int i=0; i<mSize; i++ ) {
+        mSlots[i].used = false;
+        }
+
+    int mask = mSize - 1;
+
+    for( int i=0; i<oldSize; i++ ) {
+        Slot *s = &( oldSlots[i] );
+
+        if( s->used ) {
+            int j = computeHash( s->keyA, s->keyB, s->keyC, s->keyD );
+
+            while( mSlots[j].used ) {
+                j = ( j + 1 ) & mask;
+                }
+            mSlots[j] = *s;
+            }
+        }
+
+    delete [] oldSlots;
+    }
+
+
+
+template <class Type>
+Type FlatHashTable<Type>::lookup( int inKeyA, int inKeyB, int inKeyC,
+                                  int inKeyD,
+                                  char *outFound ) {
+
+    int i = findSlot( inKeyA, inKeyB, inKeyC, inKeyD );
+
+    if( i != -1 ) {
+        *outFound = true;
+        return mSlots[i].item;
+        }
+
+    *outFound = false;
+
+    // else return an undefined item (okay, since outFound is false);
+    return mDefaultValue;
+    }
+
+
+
+template <class Type>
+Type *FlatHashTable<Type>::lookupPointer( int inKeyA, int inKeyB, int inKeyC,
+                                          int inKeyD ) {
+
+    int i = findSlot( inKeyA, inKeyB, inKeyC, inKeyD );
+
+    if( i != -1 ) {
+        return &( mSlots[i].item );
+        }
+
+    return NULL;
+    }
+
+
+
+template <class Type>
+void FlatHashTable<Type>::insert( int inKeyA, int inKeyB, int inKeyC,
+                                  int inKeyD,
+                                  Type inItem ) {
+
+    int i = findSlot( inKeyA, inKeyB, inKeyC, inKeyD );
+
+    if( i != -1 ) {
+        // replace
+        mSlots[i].item = inItem;
+        return;
+        }
+
+    if( ( mNumElements + 1 ) * 2 > mSize ) {
+        grow();
+        }
+
+    int mask = mSize - 1;
+
+    i = computeHash( inKeyA, inKeyB, inKeyC, inKeyD );
+
+    while( mSlots[i].used ) {
+        i = ( i + 1 ) & mask;
+        }
+
+    Slot *s = &( mSlots[i] );
+
+    s->keyA = inKeyA;
+    s->keyB = inKeyB;
+    s->keyC = inKeyC;
+    s->keyD = inKeyD;
+    s->item = inItem;
+    s->used = true;
+
+    mNumElements++;
+    }
+
+
+
+template <class Type>
+void FlatHashTable<Type>::remove( int inKeyA, int inKeyB, int inKeyC,
+                                  int inKeyD ) {
+
+    int hole = findSlot( inKeyA, inKeyB, inKeyC, inKeyD );
+
+    if( hole == -1 ) {
+        return;
+        }
+
+    int mask = mSize - 1;
+
+    // walk rest of probe run, moving back any entry that could not
+    // otherwise be found past the hole
+    int j = hole;
+
+    while( true ) {
+        j = ( j + 1 ) & mask;
+
+        Slot *s = &( mSlots[j] );
+
+        if( ! s->used ) {
+            break;
+            }
+
+        int home = computeHash( s->keyA, s->keyB, s->keyC, s->keyD );
+
+        // distance from home to the hole and to s, wrapping around
+        int holeDist = ( hole - home ) & mask;
+        int sDist = ( j - home ) & mask;
+
+        if( holeDist < sDist ) {
+            // hole is between s's home and s
+            mSlots[ hole ] = *s;
+            hole = j;
+            }
+        }
+
+    mSlots[ hole ].used = false;
+
+    mNumElements--;
+    }
+
+
+
+template <class Type>
+void FlatHashTable<Type>::clear() {
+
+    for( int i=0; i<mSize; i++ ) {
+        mSlots[i].used = false;
+        }
+
+    mNumElements = 0;
+    }
+
+
+
+#endif
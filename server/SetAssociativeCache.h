@@ -0,0 +1,268 @@
+#ifndef SET_ASSOCIATIVE_CACHE_H_INCLUDED
+#define SET_ASSOCIATIVE_CACHE_H_INCLUDED
+
+
+#include <stddef.h>
+
+
+// Fixed-size cache of values keyed by four ints.
+//
+// Entries are grouped into sets of inWays entries.  A key can only live
+// in the set that it hashes to, but can take any entry in that set, so
+// up to inWays hot keys that hash to the same set don't evict each other.
+//
+// When a set is full, an entry is evicted with the CLOCK algorithm:
+// each entry has a referenced flag that is set on every hit, and the
+// set's clock hand passes over (and clears) referenced entries while
+// looking for one to evict.  New entries start unreferenced, so a
+// one-time sweep over many cells doesn't push out entries that are
+// used over and over.
+//
+// Counts hits, misses, and evictions, for tuning the size.
+template <class Type>
+class SetAssociativeCache {
+
+    public:
+
+        // inNumEntries is rounded up to a whole number of sets
+        SetAssociativeCache( int inNumEntries, int inWays );
+
+        ~SetAssociativeCache();
+
+        // returns pointer to cached value, or NULL on miss
+        // pointer is valid until next insert or clear
+        Type *lookup( int inKeyA, int inKeyB, int inKeyC, int inKeyD );
+
+        // replaces value if key already present
+        void insert( int inKeyA, int inKeyB, int inKeyC, int inKeyD,
+                     Type inItem );
+
+        void remove( int inKeyA, int inKeyB, int inKeyC, int inKeyD );
+
+        // flush all entries from cache (stats are untouched)
+        void clear();
+
+
+        int getNumEntries() {
+            return mNumSets * mWays;
+            }
+
+        unsigned int getHits() {
+            return mHits;
+            }
+
+        unsigned int getMisses() {
+            return mMisses;
+            }
+
+        unsigned int getEvictions() {
+            return mEvictions;
+            }
+
+        void resetStats() {
+            mHits = 0;
+            mMisses = 0;
+            mEvictions = 0;
+            }
+
+
+    private:
+
+        typedef struct Entry {
+                int keyA, keyB, keyC, keyD;
+                Type item;
+                char valid;
+                char referenced;
+            } Entry;
+
+        int mNumSets;
+        int mWays;
+
+        // mNumSets * mWays, set s starts at index s * mWays
+        Entry *mEntries;
+
+        // position of clock hand in each set
+        int *mHands;
+
+        unsigned int mHits;
+        unsigned int mMisses;
+        unsigned int mEvictions;
+
+
+        // returns first entry of set for key
+        Entry *getSet( int inKeyA, int inKeyB, int inKeyC, int inKeyD );
+
+        // returns NULL if not found
+        Entry *findEntry( Entry *inSet,
+                          int inKeyA, int inKeyB, int inKeyC, int inKeyD );
+
+    };
+
+
+
+template <class Type>
+SetAssociativeCache<Type>::SetAssociativeCache( int inNumEntries,
+                                                int inWays )
+        : mNumSets( ( inNumEntries + inWays - 1 ) / inWays ),
+          mWays( inWays ),
+          mHits( 0 ),
+          mMisses( 0 ),
+          mEvictions( 0 ) {
+
+    if( mNumSets < 1 ) {
+        mNumSets = 1;
+        }
+
+    mEntries = new Entry[ mNumSets * mWays ];
+    mHands = new int[ mNumSets ];
+
+    clear();
+    }
+
+
+
+template <class Type>
+SetAssociativeCache<Type>::~SetAssociativeCache() {
+    delete [] mEntries;
+    delete [] mHands;
+    }
+
+
+
+template <class Type>
+inline typename SetAssociativeCache<Type>::Entry *
+SetAssociativeCache<Type>::getSet( int inKeyA, int inKeyB, int inKeyC,
+                                   int inKeyD ) {
+
+    // unsigned, so overflow wraps instead of going negative
+    unsigned int hashKey =
+        (unsigned int)inKeyA * 776509273U +
+        (unsigned int)inKeyB * 904124281U +
+        (unsigned int)inKeyC * 528383237U +
+        (unsigned int)inKeyD * 148497157U;
+
+    return &( mEntries[ ( hashKey % mNumSets ) * mWays ] );
+    }
+
+
+
+template <class Type>
+inline typename SetAssociativeCache<Type>::Entry *
+SetAssociativeCache<Type>::findEntry( Entry *inSet,
+                                      int inKeyA, int inKeyB, int inKeyC,
+                                      int inKeyD ) {
+    for( int i=0; i<mWays; i++ ) {
+        Entry *e = &( inSet[i] );
+
+        if( e->valid &&
+            e->keyA == inKeyA &&
+            e->keyB == inKeyB &&
+            e->keyC == inKeyC &&
+            e->keyD == inKeyD ) {
+            return e;
+            }
+        }
+    return NULL;
+    }
+
+
+
+template <class Type>
+Type *SetAssociativeCache<Type>::lookup( int inKeyA, int inKeyB, int inKeyC,
+                                         int inKeyD ) {
+
+    Entry *e = findEntry( getSet( inKeyA, inKeyB, inKeyC, inKeyD ),
+                          inKeyA, inKeyB, inKeyC, inKeyD );
+
+    if( e == NULL ) {
+        mMisses++;
+        return NULL;
+        }
+
+    mHits++;
+    e->referenced = true;
+
+    return &( e->item );
+    }
+
+
+
+template <class Type>
+void SetAssociativeCache<Type>::insert( int inKeyA, int inKeyB, int inKeyC,
+                                        int inKeyD, Type inItem ) {
+
+    Entry *set = getSet( inKeyA, inKeyB, inKeyC, inKeyD );
+
+    Entry *e = findEntry( set, inKeyA, inKeyB, inKeyC, inKeyD );
+
+    if( e != NULL ) {
+        // replace
+        e->item = inItem;
+        return;
+        }
+
+    for( int i=0; i<mWays; i++ ) {
+        if( ! set[i].valid ) {
+            e = &( set[i] );
+            break;
+            }
+        }
+
+    if( e == NULL ) {
+        // set full, run clock hand to find an entry to evict
+        int *hand = &( mHands[ ( set - mEntries ) / mWays ] );
+
+        while( set[ *hand ].referenced ) {
+            // second chance
+            set[ *hand ].referenced = false;
+            *hand = ( *hand + 1 ) % mWays;
+            }
+
+        e = &( set[ *hand ] );
+        *hand = ( *hand + 1 ) % mWays;
+
+        mEvictions++;
+        }
+
+    e->keyA = inKeyA;
+    e->keyB = inKeyB;
+    e->keyC = inKeyC;
+    e->keyD = inKeyD;
+    e->item = inItem;
+    e->valid = true;
+    e->referenced = false;
+    }
+
+
+
+template <class Type>
+void SetAssociativeCache<Type>::remove( int inKeyA, int inKeyB, int inKeyC,
+                                        int inKeyD ) {
+
+    Entry *e = findEntry( getSet( inKeyA, inKeyB, inKeyC, inKeyD ),
+                          inKeyA, inKeyB, inKeyC, inKeyD );
+
+    if( e != NULL ) {
+        e->valid = false;
+        e->referenced = false;
+        }
+    }
+
+
+
+template <class Type>
+void SetAssociativeCache<Type>::clear() {
+
+    for( int i=0; i<mNumSets * mWays; i++ ) {
+        mEntries[i].valid = false;
+        mEntries[i].referenced = false;
+        }
+
+    for( int i=0; i<mNumSets; i++ ) {
+        mHands[i] = 0;
+        }
+    }
+
+
+
+#endif
@@ -0,0 +1,175 @@
+#include "SpatialGrid.h"
+
+#include <stdlib.h>
+
+
+
+SpatialGrid::SpatialGrid( int inCellShift )
+        : mCellShift( inCellShift ),
+          mCellHeads( 256, -1 ) {
+    clear();
+    }
+
+
+
+void SpatialGrid::clear() {
+    if( mEntries.size() > 0 ) {
+        mCellHeads.clear();
+        mEntries.deleteAll();
+        }
+    mGlobals.deleteAll();
+
+    mMinCellX = 0;
+    mMinCellY = 0;
+    mMaxCellX = -1;
+    mMaxCellY = -1;
+    }
+
+
+
+void SpatialGrid::addToCell( int inIndex, int inCellX, int inCellY ) {
+    char found;
+    int head = mCellHeads.lookup( inCellX, inCellY, 0, 0, &found );
+
+    if( ! found ) {
+        head = -1;
+        }
+
+    Entry e = { inIndex, head };
+    mEntries.push_back( e );
+
+    mCellHeads.insert( inCellX, inCellY, 0, 0, mEntries.size() - 1 );
+
+    if( mMaxCellX < mMinCellX ) {
+        mMinCellX = inCellX;
+        mMaxCellX = inCellX;
+        mMinCellY = inCellY;
+        mMaxCellY = inCellY;
+        }
+    else {
+        if( inCellX < mMinCellX ) mMinCellX = inCellX;
+        if( inCellX > mMaxCellX ) mMaxCellX = inCellX;
+        if( inCellY < mMinCellY ) mMinCellY = inCellY;
+        if( inCellY > mMaxCellY ) mMaxCellY = inCellY;
+        }
+    }
+
+
+
+void SpatialGrid::add( int inIndex, int inX, int inY ) {
+    addToCell( inIndex, inX >> mCellShift, inY >> mCellShift );
+    }
+
+
+
+void SpatialGrid::addRect( int inIndex,
+                           int inXA, int inYA, int inXB, int inYB ) {
+    if( inXB < inXA ) {
+        int temp = inXA;
+        inXA = inXB;
+        inXB = temp;
+        }
+    if( inYB < inYA ) {
+        int temp = inYA;
+        inYA = inYB;
+        inYB = temp;
+        }
+
+    int cellXA = inXA >> mCellShift;
+    int cellYA = inYA >> mCellShift;
+    int cellXB = inXB >> mCellShift;
+    int cellYB = inYB >> mCellShift;
+
+    if( ( cellXB - cellXA + 1 ) * ( cellYB - cellYA + 1 ) > 64 ) {
+        // too big to be worth filing cell by cell
+        addGlobal( inIndex );
+        return;
+        }
+
+    for( int y=cellYA; y<=cellYB; y++ ) {
+        for( int x=cellXA; x<=cellXB; x++ ) {
+            addToCell( inIndex, x, y );
+            }
+        }
+    }
+
+
+
+void SpatialGrid::addGlobal( int inIndex ) {
+    mGlobals.push_back( inIndex );
+    }
+
+
+
+static int compareInts( const void *inA, const void *inB ) {
+    int a = *( (const int*)inA );
+    int b = *( (const int*)inB );
+
+    if( a < b ) {
+        return -1;
+        }
+    if( a > b ) {
+        return 1;
+        }
+    return 0;
+    }
+
+
+
+void SpatialGrid::getNearby( int inX, int inY, int inRadius,
+                             SimpleVector<int> *outIndices ) {
+    outIndices->deleteAll();
+
+    outIndices->push_back_other( &mGlobals );
+
+    if( mEntries.size() > 0 ) {
+
+        int cellXA = ( inX - inRadius ) >> mCellShift;
+        int cellYA = ( inY - inRadius ) >> mCellShift;
+        int cellXB = ( inX + inRadius ) >> mCellShift;
+        int cellYB = ( inY + inRadius ) >> mCellShift;
+
+        // don't walk cells outside of those that have entries
+        if( cellXA < mMinCellX ) cellXA = mMinCellX;
+        if( cellYA < mMinCellY ) cellYA = mMinCellY;
+        if( cellXB > mMaxCellX ) cellXB = mMaxCellX;
+        if( cellYB > mMaxCellY ) cellYB = mMaxCellY;
+
+        for( int y=cellYA; y<=cellYB; y++ ) {
+            for( int x=cellXA; x<=cellXB; x++ ) {
+                char found;
+                int e = mCellHeads.lookup( x, y, 0, 0, &found );
+
+                if( ! found ) {
+                    continue;
+                    }
+
+                while( e != -1 ) {
+                    Entry *entry = mEntries.getElement( e );
+                    outIndices->push_back( entry->index );
+                    e = entry->next;
+                    }
+                }
+            }
+        }
+
+
+    int numFound = outIndices->size();
+
+    if( numFound > 1 ) {
+        int *indices = outIndices->getElement( 0 );
+
+        qsort( indices, numFound, sizeof( int ), compareInts );
+
+        // remove duplicates left by items in more than one cell
+        int numKept = 1;
+        for( int i=1; i<numFound; i++ ) {
+            if( indices[i] != indices[ numKept - 1 ] ) {
+                indices[ numKept ] = indices[i];
+                numKept++;
+                }
+            }
+
+        outIndices->shrink( numKept );
+        }
+    }
@@ -0,0 +1,86 @@
+#ifndef SPATIAL_GRID_H_INCLUDED
+#define SPATIAL_GRID_H_INCLUDED
+
+
+#include "minorGems/util/SimpleVector.h"
+
+#include "FlatHashTable.h"
+
+
+
+// Buckets item indices by coarse square cells of the map, so a range
+// query only looks at the items in cells near the query point instead of
+// at every item.
+//
+// Meant to be rebuilt from a list (of players, of changes made this
+// step) whenever that list is used for range queries, not kept up to
+// date as the list changes.
+//
+// Queries return a superset of the items in range, so callers still
+// check the exact distance.  Results are sorted by index with no
+// duplicates, so callers that walk them send things in the same order
+// as walking the whole list.
+class SpatialGrid {
+
+    public:
+
+        // cells are ( 1 << inCellShift ) tiles on a side
+        SpatialGrid( int inCellShift = 5 );
+
+
+        // removes all items
+        void clear();
+
+
+        // adds item at one spot
+        void add( int inIndex, int inX, int inY );
+
+        // adds item that covers a rectangle of spots, inclusive
+        void addRect( int inIndex, int inXA, int inYA, int inXB, int inYB );
+
+        // adds item that is in every query result, whatever its position
+        void addGlobal( int inIndex );
+
+
+        // appends indices of items that might be within inRadius of
+        // inX,inY (using either distance on the map) to outIndices,
+        // which is cleared first
+        void getNearby( int inX, int inY, int inRadius,
+                        SimpleVector<int> *outIndices );
+
+
+        // true if no items have been added since clear
+        char isEmpty() {
+            return mEntries.size() == 0 && mGlobals.size() == 0;
+            }
+
+
+    private:
+
+        typedef struct Entry {
+                int index;
+
+                // next entry in same cell, -1 at end
+                int next;
+            } Entry;
+
+
+        int mCellShift;
+
+        // maps cell x,y to index of first entry in cell in mEntries
+        FlatHashTable<int> mCellHeads;
+
+        SimpleVector<Entry> mEntries;
+
+        SimpleVector<int> mGlobals;
+
+        // bounds of cells that have entries
+        int mMinCellX, mMinCellY, mMaxCellX, mMaxCellY;
+
+
+        void addToCell( int inIndex, int inCellX, int inCellY );
+    };
+
+
+
+#endif
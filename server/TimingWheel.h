@@ -0,0 +1,501 @@
+#ifndef TIMING_WHEEL_H_INCLUDED
+#define TIMING_WHEEL_H_INCLUDED
+
+
+#include <math.h>
+#include <stdint.h>
+
+#include "minorGems/system/Time.h"
+#include "minorGems/util/SimpleVector.h"
+
+#include "FlatHashTable.h"
+
+
+
+// Schedules items to come due at ETA times, keyed by four ints.  Each key
+// has at most one item scheduled, so scheduling a key again moves it
+// instead of adding a duplicate.
+//
+// Items are kept in a hierarchical timing wheel with one-second ticks.
+// Level 0 has a bucket per second for the next 256 seconds.  Levels 1,
+// 2, and 3 each have 64 buckets, each covering 64 times as many seconds
+// as the level below.  Items are filed in the lowest level that reaches
+// their ETA, and move down a level ("cascade") when the wheel turns to
+// their bucket.
+//
+// schedule, cancel, and lookups are O(1).  Popping an item costs O(1)
+// plus one step per second that has passed since the last pop.
+template <class Type>
+class TimingWheel {
+
+    public:
+
+        TimingWheel();
+
+
+        // schedules item for key, replacing any item already scheduled
+        // for key
+        //
+        // inCurTime is the current time on the clock that ETAs and
+        // popExpired use, which starts the wheel turning if it hasn't yet
+        void schedule( int inKeyA, int inKeyB, int inKeyC, int inKeyD,
+                       timeSec_t inETA, Type inItem, timeSec_t inCurTime );
+
+        // does nothing if nothing scheduled for key
+        void cancel( int inKeyA, int inKeyB, int inKeyC, int inKeyD );
+
+        // returns ETA of item scheduled for key
+        // outFound set to false if nothing scheduled
+        timeSec_t getETA( int inKeyA, int inKeyB, int inKeyC, int inKeyD,
+                          char *outFound );
+
+
+        // removes one item with ETA at or before inCurTime, and returns it
+        // in outItem
+        // returns false if no such items
+        char popExpired( timeSec_t inCurTime, Type *outItem );
+
+
+        // gets a time at or before the earliest ETA of any scheduled item,
+        // which is exact to the second for items due in the next 256
+        // seconds
+        // returns false if nothing scheduled
+        char getNextETA( timeSec_t *outTime );
+
+
+        int size() {
+            return mKeyIndex.getNumElements();
+            }
+
+        void clear();
+
+
+    private:
+
+        typedef struct Node {
+                int keyA, keyB, keyC, keyD;
+                timeSec_t eta;
+                Type item;
+
+                // index of bucket node is in, in mHeads
+                int bucket;
+
+                // -1 at ends of list
+                int prev, next;
+            } Node;
+
+
+        // 256 + 64 + 64 + 64 bucket list heads, level 0 first
+        // -1 if bucket is empty
+        int mHeads[ 448 ];
+
+        // one bit per bucket, set if bucket is non-empty
+        uint64_t mLevel0Bits[4];
+        uint64_t mUpperBits[3];
+
+        // current tick, all items with earlier ticks have been popped
+        // -1 if not started
+        int64_t mNow;
+
+        SimpleVector<Node> mNodes;
+
+        // indices of unused nodes in mNodes
+        SimpleVector<int> mFreeNodes;
+
+        // maps key to index in mNodes
+        FlatHashTable<int> mKeyIndex;
+
+
+        static int64_t getTick( timeSec_t inTime ) {
+            return (int64_t)floor( inTime );
+            }
+
+        int getBucket( int64_t inTick );
+
+        void setBucketBit( int inBucket, char inNonEmpty );
+
+        void link( int inNodeIndex );
+
+        void unlink( int inNodeIndex );
+
+        void freeNode( int inNodeIndex );
+
+        // moves all nodes in bucket to buckets for their ETAs relative
+        // to mNow
+        void cascade( int inBucket );
+
+        void advanceOneTick();
+
+        // finds first set bit, at or after inStart and wrapping around,
+        // in a bitmap of inNumBits bits
+        // returns offset from inStart, or -1 if none set
+        static int findNextBit( uint64_t *inBits, int inNumBits,
+                                int inStart );
+    };
+
+
+
+template <class Type>
+TimingWheel<Type>::TimingWheel()
+        : mNow( -1 ),
+          mKeyIndex( 1024, -1 ) {
+    clear();
+    }
+
+
+
+template <class Type>
+void TimingWheel<Type>::clear() {
+    for( int i=0; i<448; i++ ) {
+        mHeads[i] = -1;
+        }
+    for( int i=0; i<4; i++ ) {
+        mLevel0Bits[i] = 0;
+        }
+    for( int i=0; i<3; i++ ) {
+        mUpperBits[i] = 0;
+        }
+
+    mNodes.deleteAll();
+    mFreeNodes.deleteAll();
+    mKeyIndex.clear();
+
+    mNow = -1;
+    }
+
+
+
+// bucket for a tick, relative to mNow
+template <class Type>
+int TimingWheel<Type>::getBucket( int64_t inTick ) {
+    int64_t delta = inTick - mNow;
+
+    if( delta < 0 ) {
+        // already due
+        inTick = mNow;
+        delta = 0;
+        }
+
+    if( delta < 256 ) {
+        return (int)( inTick & 255 );
+        }
+    if( delta < ( 1 << 14 ) ) {
+        return 256 + (int)( ( inTick >> 8 ) & 63 );
+        }
+    if( delta < ( 1 << 20 ) ) {
+        return 256 + 64 + (int)( ( inTick >> 14 ) & 63 );
+        }
+    if( delta >= ( 1 << 26 ) ) {
+        // farther than top level reaches
+        // file at far end, and we'll re-file it when it cascades
+        inTick = mNow + ( 1 << 26 ) - 1;
+        }
+    return 256 + 128 + (int)( ( inTick >> 20 ) & 63 );
+    }
+
+
+
+template <class Type>
+void TimingWheel<Type>::setBucketBit( int inBucket, char inNonEmpty ) {
+    uint64_t *word;
+    int bit;
+
+    if( inBucket < 256 ) {
+        word = &( mLevel0Bits[ inBucket / 64 ] );
+        bit = inBucket % 64;
+        }
+    else {
+        word = &( mUpperBits[ ( inBucket - 256 ) / 64 ] );
+        bit = ( inBucket - 256 ) % 64;
+        }
+
+    if( inNonEmpty ) {
+        *word |= ( (uint64_t)1 << bit );
+        }
+    else {
+        *word &= ~( (uint64_t)1 << bit );
+        }
+    }
+
+
+
+template <class Type>
+void TimingWheel<Type>::link( int inNodeIndex ) {
+    Node *n = mNodes.getElement( inNodeIndex );
+
+    int b = getBucket( getTick( n->eta ) );
+
+    n->bucket = b;
+    n->prev = -1;
+    n->next = mHeads[b];
+
+    if( mHeads[b] != -1 ) {
+        mNodes.getElement( mHeads[b] )->prev = inNodeIndex;
+        }
+    else {
+        setBucketBit( b, true );
+        }
+    mHeads[b] = inNodeIndex;
+    }
+
+
+
+template <class Type>
+void TimingWheel<Type>::unlink( int inNodeIndex ) {
+    Node *n = mNodes.getElement( inNodeIndex );
+
+    if( n->prev != -1 ) {
+        mNodes.getElement( n->prev )->next = n->next;
+        }
+    else {
+        mHeads[ n->bucket ] = n->next;
+
+        if( n->next == -1 ) {
+            setBucketBit( n->bucket, false );
+            }
+        }
+
+    if( n->next != -1 ) {
+        mNodes.getElement( n->next )->prev = n->prev;
+        }
+
+    n->prev = -1;
+    n->next = -1;
+    }
+
+
+
+template <class Type>
+void TimingWheel<Type>::freeNode( int inNodeIndex ) {
+    Node *n = mNodes.getElement( inNodeIndex );
+
+    mKeyIndex.remove( n->keyA, n->keyB, n->keyC, n->keyD );
+
+    mFreeNodes.push_back( inNodeIndex );
+    }
+
+
+
+template <class Type>
+void TimingWheel<Type>::schedule( int inKeyA, int inKeyB, int inKeyC,
+                                  int inKeyD,
+                                  timeSec_t inETA, Type inItem,
+                                  timeSec_t inCurTime ) {
+    if( mNow == -1 ) {
+        // not started yet, start at caller's current time
+        mNow = getTick( inCurTime );
+        }
+
+    int *existing = mKeyIndex.lookupPointer( inKeyA, inKeyB, inKeyC, inKeyD );
+
+    int index;
+
+    if( existing != NULL ) {
+        // reschedule
+        index = *existing;
+        unlink( index );
+        }
+    else if( mFreeNodes.size() > 0 ) {
+        index = mFreeNodes.getElementDirect( mFreeNodes.size() - 1 );
+        mFreeNodes.deleteElement( mFreeNodes.size() - 1 );
+
+        mKeyIndex.insert( inKeyA, inKeyB, inKeyC, inKeyD, index );
+        }
+    else {
+        Node n;
+        mNodes.push_back( n );
+        index = mNodes.size() - 1;
+
+        mKeyIndex.insert( inKeyA, inKeyB, inKeyC, inKeyD, index );
+        }
+
+    Node *n = mNodes.getElement( index );
+
+    n->keyA = inKeyA;
+    n->keyB = inKeyB;
+    n->keyC = inKeyC;
+    n->keyD = inKeyD;
+    n->eta = inETA;
+    n->item = inItem;
+
+    link( index );
+    }
+
+
+
+template <class Type>
+void TimingWheel<Type>::cancel( int inKeyA, int inKeyB, int inKeyC,
+                                int inKeyD ) {
+    char found;
+    int index = mKeyIndex.lookup( inKeyA, inKeyB, inKeyC, inKeyD, &found );
+
+    if( found ) {
+        unlink( index );
+        freeNode( index );
+        }
+    }
+
+
+
+template <class Type>
+timeSec_t TimingWheel<Type>::getETA( int inKeyA, int inKeyB, int inKeyC,
+                                     int inKeyD,
+                                     char *outFound ) {
+
+    int index = mKeyIndex.lookup( inKeyA, inKeyB, inKeyC, inKeyD, outFound );
+
+    if( *outFound ) {
+        return mNodes.getElement( index )->eta;
+        }
+    return 0;
+    }
+
+
+
+template <class Type>
+void TimingWheel<Type>::cascade( int inBucket ) {
+    int index = mHeads[ inBucket ];
+
+    mHeads[ inBucket ] = -1;
+    setBucketBit( inBucket, false );
+
+    while( index != -1 ) {
+        int next = mNodes.getElement( index )->next;
+
+        link( index );
+
+        index = next;
+        }
+    }
+
+
+
+template <class Type>
+void TimingWheel<Type>::advanceOneTick() {
+    mNow++;
+
+    if( ( mNow & 255 ) != 0 ) {
+        return;
+        }
+
+    // crossed into a new level 0 rotation
+    // cascade higher levels first, so that what they drop into lower
+    // levels gets cascaded further right away
+    if( ( mNow & ( ( 1 << 14 ) - 1 ) ) == 0 ) {
+        if( ( mNow & ( ( 1 << 20 ) - 1 ) ) == 0 ) {
+            cascade( 256 + 128 + (int)( ( mNow >> 20 ) & 63 ) );
+            }
+        cascade( 256 + 64 + (int)( ( mNow >> 14 ) & 63 ) );
+        }
+    cascade( 256 + (int)( ( mNow >> 8 ) & 63 ) );
+    }
+
+
+
+template <class Type>
+char TimingWheel<Type>::popExpired( timeSec_t inCurTime, Type *outItem ) {
+    int64_t target = getTick( inCurTime );
+
+    if( size() == 0 ) {
+        // nothing to step through
+        if( target > mNow ) {
+            mNow = target;
+            }
+        return false;
+        }
+
+    while( true ) {
+        int b = (int)( mNow & 255 );
+
+        // items in the current bucket are due this second, or earlier
+        // only the ones due this second need their fractional ETA checked
+        int index = mHeads[b];
+
+        while( index != -1 ) {
+            Node *n = mNodes.getElement( index );
+
+            if( n->eta <= inCurTime ) {
+                *outItem = n->item;
+
+                unlink( index );
+                freeNode( index );
+                return true;
+                }
+            index = n->next;
+            }
+
+        if( mNow >= target ) {
+            return false;
+            }
+
+        advanceOneTick();
+        }
+    }
+
+
+
+template <class Type>
+int TimingWheel<Type>::findNextBit( uint64_t *inBits, int inNumBits,
+                                    int inStart ) {
+    for( int i=0; i<inNumBits; i++ ) {
+        int b = ( inStart + i ) % inNumBits;
+
+        if( ( b % 64 ) == 0 && inBits[ b / 64 ] == 0 &&
+            i + 64 <= inNumBits ) {
+            // skip whole empty word
+            i += 63;
+            continue;
+            }
+
+        if( ( inBits[ b / 64 ] >> ( b % 64 ) ) & 1 ) {
+            return i;
+            }
+        }
+    return -1;
+    }
+
+
+
+template <class Type>
+char TimingWheel<Type>::getNextETA( timeSec_t *outTime ) {
+    if( size() == 0 ) {
+        return false;
+        }
+
+    int64_t best = -1;
+
+    int offset = findNextBit( mLevel0Bits, 256, (int)( mNow & 255 ) );
+
+    if( offset != -1 ) {
+        best = mNow + offset;
+        }
+
+    // upper levels can hold items due before some of level 0's, when
+    // level 0 reaches past the end of the current rotation
+
+    for( int l=0; l<3; l++ ) {
+        int shift = 8 + l * 6;
+
+        // bucket for current rotation at this level has already been
+        // cascaded, so anything there is one whole turn away
+        int cur = (int)( ( mNow >> shift ) & 63 );
+
+        offset = findNextBit( &( mUpperBits[l] ), 64, ( cur + 1 ) % 64 );
+
+        if( offset != -1 ) {
+            // start of that bucket
+            int64_t t = ( ( mNow >> shift ) + 1 + offset ) << shift;
+
+            if( best == -1 || t < best ) {
+                best = t;
+                }
+            }
+        }
+
+    *outTime = (timeSec_t)best;
+    return true;
+    }
+
+
+
+#endif
@@ -0,0 +1,513 @@
+#include "asyncLog.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+
+#include "minorGems/util/SettingsManager.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/system/Thread.h"
+
+#include "minorGems/util/log/AppLog.h"
+
+
+
+#define MAX_ASYNC_LOG_TYPES 32
+
+#define PAD_RECORD_TYPE -1
+
+
+typedef struct AsyncLogType {
+        AsyncLogFormatter formatter;
+        AsyncLogFlusher flusher;
+    } AsyncLogType;
+
+
+static AsyncLogType logTypes[ MAX_ASYNC_LOG_TYPES ];
+static int numLogTypes = 0;
+
+
+
+// record as stored in ring, followed by int list, then strings with
+// their terminators, padded to a multiple of 8 bytes
+typedef struct RingRecordHeader {
+        // whole record, including header
+        unsigned int length;
+
+        int type;
+
+        double timeSec;
+
+        int ints[ ASYNC_LOG_INTS ];
+        double doubles[ ASYNC_LOG_DOUBLES ];
+
+        // -1 if NULL
+        int stringLengths[ ASYNC_LOG_STRINGS ];
+        int intListLength;
+    } RingRecordHeader;
+
+
+// doubles, so records are aligned for their doubles
+static double *ringMemory = NULL;
+static unsigned char *ring = NULL;
+static unsigned int ringSize = 0;
+
+// byte counts since start, never wrapped
+// head only moved by main thread, tail only by writer thread
+static unsigned long long ringHead = 0;
+static unsigned long long ringTail = 0;
+
+static unsigned int numDropped = 0;
+
+
+
+// writer thread's copy of server output
+static int serverOutPipe = -1;
+static FILE *serverOutFile = NULL;
+static char *serverOutFileName = NULL;
+static long serverOutBytes = 0;
+static long serverOutMaxBytes = 20000000;
+
+
+
+class AsyncLogWriter : public Thread {
+    public:
+
+        AsyncLogWriter( int inFlushMS )
+                : mFlushMS( inFlushMS ), mStop( false ) {
+            start();
+            }
+
+        // writes everything queued so far, then returns
+        ~AsyncLogWriter() {
+            __atomic_store_n( &mStop, true, __ATOMIC_RELEASE );
+            join();
+            }
+
+        virtual void run();
+
+    protected:
+        int mFlushMS;
+        char mStop;
+    };
+
+
+static AsyncLogWriter *writer = NULL;
+
+
+
+static unsigned int roundUp8( unsigned int inLength ) {
+    return ( inLength + 7 ) & ~7u;
+    }
+
+
+
+static void drainRing() {
+    unsigned long long head = __atomic_load_n( &ringHead, __ATOMIC_ACQUIRE );
+
+    unsigned long long tail = ringTail;
+
+    char flushType[ MAX_ASYNC_LOG_TYPES ];
+    memset( flushType, false, sizeof( flushType ) );
+
+    while( tail < head ) {
+        RingRecordHeader *h =
+            (RingRecordHeader *)&( ring[ tail % ringSize ] );
+
+        if( h->type != PAD_RECORD_TYPE ) {
+            AsyncLogRecord r;
+
+            r.timeSec = h->timeSec;
+            memcpy( r.ints, h->ints, sizeof( r.ints ) );
+            memcpy( r.doubles, h->doubles, sizeof( r.doubles ) );
+
+            unsigned char *payload = (unsigned char *)&( h[1] );
+
+            r.intList = NULL;
+            r.intListLength = 0;
+
+            if( h->intListLength != -1 ) {
+                r.intList = (int *)payload;
+                r.intListLength = h->intListLength;
+                payload += h->intListLength * sizeof( int );
+                }
+
+            for( int s=0; s<ASYNC_LOG_STRINGS; s++ ) {
+                r.strings[s] = NULL;
+
+                if( h->stringLengths[s] != -1 ) {
+                    r.strings[s] = (char *)payload;
+                    payload += h->stringLengths[s] + 1;
+                    }
+                }
+
+            logTypes[ h->type ].formatter( &r );
+            flushType[ h->type ] = true;
+            }
+
+        tail += h->length;
+
+        // let main thread reuse space as we go
+        __atomic_store_n( &ringTail, tail, __ATOMIC_RELEASE );
+        }
+
+    for( int t=0; t<numLogTypes; t++ ) {
+        if( flushType[t] && logTypes[t].flusher != NULL ) {
+            logTypes[t].flusher();
+            }
+        }
+
+    unsigned int dropped =
+        __atomic_exchange_n( &numDropped, 0, __ATOMIC_RELAXED );
+
+    if( dropped > 0 ) {
+        AppLog::errorF( "Log buffer full, dropped %u log records", dropped );
+        }
+    }
+
+
+
+static void drainServerOut() {
+    if( serverOutPipe == -1 ) {
+        return;
+        }
+
+    char buffer[ 65536 ];
+
+    char wroteAny = false;
+
+    while( true ) {
+        int numRead = read( serverOutPipe, buffer, sizeof( buffer ) );
+
+        if( numRead <= 0 ) {
+            if( numRead == -1 && errno == EINTR ) {
+                continue;
+                }
+            break;
+            }
+
+        if( serverOutFile == NULL ) {
+            // drop it, like output to /dev/null
+            continue;
+            }
+
+        fwrite( buffer, 1, numRead, serverOutFile );
+        serverOutBytes += numRead;
+        wroteAny = true;
+
+        if( serverOutBytes > serverOutMaxBytes ) {
+            fclose( serverOutFile );
+
+            char *bakName = autoSprintf( "%s.bak", serverOutFileName );
+            rename( serverOutFileName, bakName );
+            delete [] bakName;
+
+            serverOutFile = fopen( serverOutFileName, "w" );
+            serverOutBytes = 0;
+            wroteAny = false;
+            }
+        }
+
+    if( wroteAny ) {
+        fflush( serverOutFile );
+        }
+    }
+
+
+
+void AsyncLogWriter::run() {
+    while( ! __atomic_load_n( &mStop, __ATOMIC_ACQUIRE ) ) {
+        Thread::staticSleep( mFlushMS );
+
+        drainServerOut();
+        drainRing();
+        }
+
+    // last of everything
+    drainServerOut();
+    drainRing();
+    }
+
+
+
+// sends stdout and stderr to writer thread, if settings ask for it
+static void startServerOut() {
+    if( isatty( STDOUT_FILENO ) ) {
+        // someone is watching
+        return;
+        }
+
+    char *fileName =
+        SettingsManager::getStringSetting( "serverOutFile", "" );
+
+    if( strcmp( fileName, "" ) == 0 ) {
+        delete [] fileName;
+        return;
+        }
+
+    int pipeFDs[2];
+
+    if( pipe( pipeFDs ) != 0 ) {
+        AppLog::errorF( "Failed to make pipe for server output, errno %d",
+                        errno );
+        delete [] fileName;
+        return;
+        }
+
+#ifdef F_SETPIPE_SZ
+    // room for output between writer batches
+    fcntl( pipeFDs[0], F_SETPIPE_SZ, 1048576 );
+#endif
+
+    fcntl( pipeFDs[0], F_SETFL,
+           fcntl( pipeFDs[0], F_GETFL, 0 ) | O_NONBLOCK );
+
+    serverOutFileName = fileName;
+    serverOutMaxBytes =
+        SettingsManager::getIntSetting( "serverOutMaxBytes", 20000000 );
+
+    struct stat fileInfo;
+    serverOutBytes = 0;
+
+    if( stat( serverOutFileName, &fileInfo ) == 0 ) {
+        serverOutBytes = fileInfo.st_size;
+        }
+
+    serverOutFile = fopen( serverOutFileName, "a" );
+
+    if( serverOutFile == NULL ) {
+        AppLog::errorF( "Failed to open server output file %s",
+                        serverOutFileName );
+        }
+    else {
+        AppLog::infoF( "Sending server output to %s", serverOutFileName );
+        }
+
+    fflush( stdout );
+    fflush( stderr );
+
+    dup2( pipeFDs[1], STDOUT_FILENO );
+    dup2( pipeFDs[1], STDERR_FILENO );
+    close( pipeFDs[1] );
+
+    // like unbuffer did, so little is lost on a crash
+    setvbuf( stdout, NULL, _IOLBF, 0 );
+
+    serverOutPipe = pipeFDs[0];
+    }
+
+
+
+// after writer thread has stopped
+// later output goes straight to file
+static void stopServerOut() {
+    if( serverOutPipe == -1 ) {
+        return;
+        }
+
+    if( serverOutFile != NULL ) {
+        fclose( serverOutFile );
+        serverOutFile = NULL;
+        }
+
+    int fd = open( serverOutFileName, O_WRONLY | O_APPEND | O_CREAT, 0644 );
+
+    if( fd != -1 ) {
+        dup2( fd, STDOUT_FILENO );
+        dup2( fd, STDERR_FILENO );
+        close( fd );
+        }
+
+    close( serverOutPipe );
+    serverOutPipe = -1;
+
+    delete [] serverOutFileName;
+    serverOutFileName = NULL;
+    }
+
+
+
+void initAsyncLog() {
+    freeAsyncLog();
+
+    int bufferBytes =
+        SettingsManager::getIntSetting( "asyncLogBufferBytes", 4194304 );
+
+    if( bufferBytes < 65536 ) {
+        bufferBytes = 65536;
+        }
+
+    ringSize = roundUp8( bufferBytes );
+    ringMemory = new double[ ringSize / 8 ];
+    ring = (unsigned char *)ringMemory;
+
+    ringHead = 0;
+    ringTail = 0;
+    numDropped = 0;
+
+    startServerOut();
+
+    int flushMS =
+        SettingsManager::getIntSetting( "asyncLogFlushMilliseconds", 50 );
+
+    writer = new AsyncLogWriter( flushMS );
+    }
+
+
+
+void freeAsyncLog() {
+    if( writer == NULL ) {
+        return;
+        }
+
+    fflush( stdout );
+    fflush( stderr );
+
+    // waits for writer to finish queue
+    delete writer;
+    writer = NULL;
+
+    stopServerOut();
+
+    delete [] ringMemory;
+    ringMemory = NULL;
+    ring = NULL;
+    ringSize = 0;
+    }
+
+
+
+int addAsyncLogType( AsyncLogFormatter inFormatter,
+                     AsyncLogFlusher inFlusher ) {
+    if( numLogTypes >= MAX_ASYNC_LOG_TYPES ) {
+        AppLog::error( "Too many async log types" );
+        return -1;
+        }
+
+    logTypes[ numLogTypes ].formatter = inFormatter;
+    logTypes[ numLogTypes ].flusher = inFlusher;
+
+    numLogTypes++;
+
+    return numLogTypes - 1;
+    }
+
+
+
+void clearAsyncLogRecord( AsyncLogRecord *inRecord ) {
+    memset( inRecord, 0, sizeof( AsyncLogRecord ) );
+    }
+
+
+
+char asyncLog( int inType, AsyncLogRecord *inRecord ) {
+    if( inType < 0 || inType >= numLogTypes ) {
+        return false;
+        }
+
+    inRecord->timeSec = Time::timeSec();
+
+    if( writer == NULL ) {
+        // no writer thread to hand it to
+        logTypes[ inType ].formatter( inRecord );
+
+        if( logTypes[ inType ].flusher != NULL ) {
+            logTypes[ inType ].flusher();
+            }
+        return true;
+        }
+
+
+    int stringLengths[ ASYNC_LOG_STRINGS ];
+
+    unsigned int length = sizeof( RingRecordHeader );
+
+    for( int s=0; s<ASYNC_LOG_STRINGS; s++ ) {
+        stringLengths[s] = -1;
+
+        if( inRecord->strings[s] != NULL ) {
+            stringLengths[s] = strlen( inRecord->strings[s] );
+            length += stringLengths[s] + 1;
+            }
+        }
+
+    if( inRecord->intList != NULL ) {
+        length += inRecord->intListLength * sizeof( int );
+        }
+
+    length = roundUp8( length );
+
+
+    unsigned long long head = ringHead;
+    unsigned long long tail = __atomic_load_n( &ringTail, __ATOMIC_ACQUIRE );
+
+    unsigned int pos = head % ringSize;
+    unsigned int roomToEnd = ringSize - pos;
+
+    // records don't wrap around end of ring
+    unsigned int needed = length;
+
+    if( roomToEnd < length ) {
+        needed += roomToEnd;
+        }
+
+    if( length > ringSize / 4 ||
+        head + needed - tail > ringSize ) {
+        __atomic_add_fetch( &numDropped, 1, __ATOMIC_RELAXED );
+        return false;
+        }
+
+    if( roomToEnd < length ) {
+        RingRecordHeader *pad = (RingRecordHeader *)&( ring[ pos ] );
+
+        // room to end is a multiple of 8, enough for these two fields
+        pad->length = roomToEnd;
+        pad->type = PAD_RECORD_TYPE;
+
+        head += roomToEnd;
+        pos = 0;
+        }
+
+
+    RingRecordHeader *h = (RingRecordHeader *)&( ring[ pos ] );
+
+    h->length = length;
+    h->type = inType;
+    h->timeSec = inRecord->timeSec;
+
+    memcpy( h->ints, inRecord->ints, sizeof( h->ints ) );
+    memcpy( h->doubles, inRecord->doubles, sizeof( h->doubles ) );
+    memcpy( h->stringLengths, stringLengths, sizeof( h->stringLengths ) );
+
+    unsigned char *payload = (unsigned char *)&( h[1] );
+
+    h->intListLength = -1;
+
+    if( inRecord->intList != NULL ) {
+        h->intListLength = inRecord->intListLength;
+
+        int listBytes = inRecord->intListLength * sizeof( int );
+
+        memcpy( payload, inRecord->intList, listBytes );
+        payload += listBytes;
+        }
+
+    for( int s=0; s<ASYNC_LOG_STRINGS; s++ ) {
+        if( stringLengths[s] != -1 ) {
+            memcpy( payload, inRecord->strings[s], stringLengths[s] + 1 );
+            payload += stringLengths[s] + 1;
+            }
+        }
+
+    head += length;
+
+    // publish record to writer
+    __atomic_store_n( &ringHead, head, __ATOMIC_RELEASE );
+
+    return true;
+    }
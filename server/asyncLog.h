@@ -0,0 +1,78 @@
+// Moves log formatting and file writes off the main thread.
+//
+// The main thread copies each log event, unformatted, into a ring buffer.
+// A writer thread formats queued events in batches, every
+// asyncLogFlushMilliseconds.ini, and flushes files once per batch.  The
+// ring is lock-free, with a single producer:  only the main thread can
+// queue events.
+//
+// Each kind of event has a formatter, added with addAsyncLogType, which
+// is called in the writer thread.  Files a formatter writes to belong to
+// the writer thread once it has started.
+//
+// If the ring is full (asyncLogBufferBytes.ini), events are dropped and
+// counted, rather than making the main thread wait.  Before initAsyncLog
+// and after freeAsyncLog, events are formatted right away by the caller.
+//
+// Server output:
+//
+// When stdout isn't a terminal and serverOutFile.ini names a file, stdout
+// and stderr are sent through a pipe to the writer thread, which appends
+// them to that file and moves it to <file>.bak whenever it grows past
+// serverOutMaxBytes.ini.  This replaces piping server output through
+// logRotator.
+
+
+
+#define ASYNC_LOG_INTS 8
+#define ASYNC_LOG_DOUBLES 2
+#define ASYNC_LOG_STRINGS 3
+
+
+typedef struct AsyncLogRecord {
+        // Time::timeSec when event was queued, filled in by asyncLog
+        double timeSec;
+
+        int ints[ ASYNC_LOG_INTS ];
+        double doubles[ ASYNC_LOG_DOUBLES ];
+
+        // NULL if not used
+        const char *strings[ ASYNC_LOG_STRINGS ];
+
+        // NULL if not used
+        const int *intList;
+        int intListLength;
+    } AsyncLogRecord;
+
+
+// record and its strings and list only valid during call
+typedef void (*AsyncLogFormatter)( AsyncLogRecord *inRecord );
+
+// called at end of each batch that formatted one of type's records
+typedef void (*AsyncLogFlusher)();
+
+
+
+void initAsyncLog();
+
+// formats everything still queued, and stops writer thread
+// call before freeing modules whose files formatters write to
+void freeAsyncLog();
+
+
+// returns type to pass to asyncLog
+// inFlusher can be NULL
+int addAsyncLogType( AsyncLogFormatter inFormatter,
+                     AsyncLogFlusher inFlusher );
+
+
+// clears a record for filling in
+void clearAsyncLogRecord( AsyncLogRecord *inRecord );
+
+
+// copies record, including strings and list, into ring
+//
+// main thread only
+//
+// returns false if ring was full and record was dropped
+char asyncLog( int inType, AsyncLogRecord *inRecord );
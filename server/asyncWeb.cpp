@@ -0,0 +1,1118 @@
+#include "asyncWeb.h"
+#include "socketEvents.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+
+#include "minorGems/util/SettingsManager.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+
+#include "minorGems/util/log/AppLog.h"
+
+
+
+// cached lookups are redone after this long
+#define HOST_LOOKUP_SECONDS 600
+#define FAILED_LOOKUP_SECONDS 10
+
+// how often to check on lookups running in background, and on connections
+// if socketEvents can't watch them
+#define CHECK_SECONDS 0.01
+
+#define RECEIVE_CHUNK_BYTES 4096
+
+
+
+class HostLookupThread;
+
+
+typedef struct WebHost {
+        char *name;
+        int port;
+
+        char lookupDone;
+        char lookupFailed;
+        double lookupTime;
+
+        struct sockaddr_in address;
+
+        // NULL if not looking up now
+        HostLookupThread *lookupThread;
+
+        SimpleVector<struct WebConnection*> idleConnections;
+    } WebHost;
+
+
+typedef struct WebConnection {
+        int fd;
+        WebHost *host;
+
+        // has served a request before
+        char reused;
+
+        double idleStartTime;
+    } WebConnection;
+
+
+
+enum AsyncWebStatus {
+    WEB_WAITING_HOST = 0,
+    WEB_CONNECTING,
+    WEB_SENDING,
+    WEB_RECEIVING,
+    WEB_DONE,
+    WEB_FAILED
+    };
+
+
+struct AsyncWebState {
+        AsyncWebRequest *request;
+
+        AsyncWebStatus status;
+
+        WebHost *host;
+        char *path;
+
+        WebConnection *connection;
+
+        // already retried on a new connection
+        char retried;
+
+        char *requestText;
+        int requestLength;
+        int numSent;
+
+        SimpleVector<char> response;
+
+        int statusCode;
+        char *body;
+
+        double deadline;
+
+        AsyncWebCallback callback;
+        void *callbackData;
+    };
+
+
+
+static SimpleVector<WebHost*> hosts;
+
+static SimpleVector<AsyncWebState*> activeRequests;
+
+static double defaultTimeoutSeconds = 10;
+static double idleSeconds = 30;
+
+// true once socketEvents has refused to watch a connection
+static char pollingConnections = false;
+
+
+
+class HostLookupThread : public Thread {
+    public:
+
+        HostLookupThread( const char *inName )
+                : mName( stringDuplicate( inName ) ),
+                  mDone( false ), mFailed( false ) {
+            start();
+            }
+
+        ~HostLookupThread() {
+            join();
+            delete [] mName;
+            }
+
+
+        // returns true when lookup is done, and fills in outAddress if it
+        // worked
+        char isDone( char *outFailed, struct in_addr *outAddress ) {
+            mLock.lock();
+            char done = mDone;
+            *outFailed = mFailed;
+            *outAddress = mAddress;
+            mLock.unlock();
+            return done;
+            }
+
+
+        virtual void run() {
+            struct addrinfo hints;
+            memset( &hints, 0, sizeof( hints ) );
+            hints.ai_family = AF_INET;
+            hints.ai_socktype = SOCK_STREAM;
+
+            struct addrinfo *result = NULL;
+
+            int error = getaddrinfo( mName, NULL, &hints, &result );
+
+            mLock.lock();
+
+            if( error != 0 || result == NULL ) {
+                mFailed = true;
+                }
+            else {
+                mAddress =
+                    ( (struct sockaddr_in *)( result->ai_addr ) )->sin_addr;
+                }
+            mDone = true;
+
+            mLock.unlock();
+
+            if( result != NULL ) {
+                freeaddrinfo( result );
+                }
+            }
+
+
+    protected:
+        char *mName;
+
+        MutexLock mLock;
+        char mDone;
+        char mFailed;
+        struct in_addr mAddress;
+    };
+
+
+
+static void startConnection( AsyncWebState *inState );
+
+
+
+static WebHost *getHost( const char *inName, int inPort ) {
+    for( int i=0; i<hosts.size(); i++ ) {
+        WebHost *h = hosts.getElementDirect( i );
+
+        if( h->port == inPort && strcmp( h->name, inName ) == 0 ) {
+            return h;
+            }
+        }
+
+    WebHost *h = new WebHost;
+
+    h->name = stringDuplicate( inName );
+    h->port = inPort;
+    h->lookupDone = false;
+    h->lookupFailed = false;
+    h->lookupTime = 0;
+    h->lookupThread = NULL;
+
+    memset( &( h->address ), 0, sizeof( h->address ) );
+    h->address.sin_family = AF_INET;
+    h->address.sin_port = htons( (unsigned short)inPort );
+
+    hosts.push_back( h );
+
+    return h;
+    }
+
+
+
+// starts lookup if host has none cached
+// returns true if host address is ready to use
+static char lookUpHost( WebHost *inHost ) {
+    double curTime = Time::getCurrentTime();
+
+    if( inHost->lookupThread != NULL ) {
+        char failed;
+        struct in_addr address;
+
+        if( ! inHost->lookupThread->isDone( &failed, &address ) ) {
+            // keep using old address, if any, while looking up again
+            return inHost->lookupDone && ! inHost->lookupFailed;
+            }
+
+        delete inHost->lookupThread;
+        inHost->lookupThread = NULL;
+
+        inHost->lookupDone = true;
+        inHost->lookupFailed = failed;
+        inHost->lookupTime = curTime;
+
+        if( failed ) {
+            AppLog::errorF( "Looking up web host %s failed", inHost->name );
+            }
+        else {
+            inHost->address.sin_addr = address;
+            }
+        return ! failed;
+        }
+
+    double cacheSeconds = HOST_LOOKUP_SECONDS;
+
+    if( inHost->lookupFailed ) {
+        // try again soon
+        cacheSeconds = FAILED_LOOKUP_SECONDS;
+        }
+
+    if( inHost->lookupDone &&
+        curTime - inHost->lookupTime < cacheSeconds ) {
+        return ! inHost->lookupFailed;
+        }
+
+    struct in_addr address;
+
+    if( inet_pton( AF_INET, inHost->name, &address ) == 1 ) {
+        inHost->address.sin_addr = address;
+        inHost->lookupDone = true;
+        inHost->lookupFailed = false;
+        // never needs redoing
+        inHost->lookupTime = curTime + 1e9;
+        return true;
+        }
+
+    inHost->lookupThread = new HostLookupThread( inHost->name );
+
+    return inHost->lookupDone && ! inHost->lookupFailed;
+    }
+
+
+
+static void closeConnection( WebConnection *inConnection ) {
+    removeFDFromEvents( inConnection->fd );
+    close( inConnection->fd );
+    delete inConnection;
+    }
+
+
+
+static void finishRequest( AsyncWebState *inState,
+                           AsyncWebStatus inStatus ) {
+    inState->status = inStatus;
+
+    activeRequests.deleteElementEqualTo( inState );
+
+    if( inState->callback != NULL ) {
+        inState->callback( inState->request, inState->callbackData );
+        }
+    }
+
+
+
+static void failRequest( AsyncWebState *inState, const char *inReason ) {
+    AppLog::infoF( "Web request to %s:%d%s failed:  %s",
+                   inState->host->name, inState->host->port,
+                   inState->path, inReason );
+
+    if( inState->connection != NULL ) {
+        closeConnection( inState->connection );
+        inState->connection = NULL;
+        }
+
+    finishRequest( inState, WEB_FAILED );
+    }
+
+
+
+// connection failed before any of response arrived
+static void connectionLost( AsyncWebState *inState, const char *inReason ) {
+    if( inState->connection != NULL &&
+        inState->connection->reused &&
+        inState->response.size() == 0 &&
+        ! inState->retried ) {
+
+        // server probably closed kept-alive connection while it was idle
+        closeConnection( inState->connection );
+        inState->connection = NULL;
+
+        inState->retried = true;
+
+        startConnection( inState );
+        return;
+        }
+
+    if( inState->connection != NULL && ! inState->connection->reused ) {
+        // maybe host moved
+        inState->host->lookupTime = 0;
+        }
+
+    failRequest( inState, inReason );
+    }
+
+
+
+// finds header in response headers, case insensitive
+// returns pointer to value, or NULL
+static const char *findHeader( const char *inHeaders, int inHeaderLength,
+                               const char *inName ) {
+    int nameLength = strlen( inName );
+
+    const char *line = inHeaders;
+    const char *end = inHeaders + inHeaderLength;
+
+    while( line < end ) {
+        const char *lineEnd = strstr( line, "\r\n" );
+
+        if( lineEnd == NULL || lineEnd > end ) {
+            lineEnd = end;
+            }
+
+        if( lineEnd - line > nameLength &&
+            strncasecmp( line, inName, nameLength ) == 0 &&
+            line[ nameLength ] == ':' ) {
+
+            const char *value = &( line[ nameLength + 1 ] );
+
+            while( *value == ' ' || *value == '\t' ) {
+                value++;
+                }
+            return value;
+            }
+
+        line = lineEnd + 2;
+        }
+
+    return NULL;
+    }
+
+
+
+// returns true if header value starts with inValue, case insensitive
+static char headerIs( const char *inHeaderValue, const char *inValue ) {
+    return inHeaderValue != NULL &&
+        strncasecmp( inHeaderValue, inValue, strlen( inValue ) ) == 0;
+    }
+
+
+
+// finds CRLF at or after inPos
+// returns its position, or -1 if not found
+static int findLineEnd( const char *inData, int inLength, int inPos ) {
+    for( int i=inPos; i<inLength - 1; i++ ) {
+        if( inData[i] == '\r' && inData[i+1] == '\n' ) {
+            return i;
+            }
+        }
+    return -1;
+    }
+
+
+
+// decodes chunked body
+// outUsed set to number of bytes of inData that body took up, through the
+// blank line that ends its trailers, if complete
+// returns 1 if complete, 0 if more data needed, -1 if malformed
+static int decodeChunkedBody( const char *inData, int inLength,
+                              SimpleVector<char> *outBody, int *outUsed ) {
+    int pos = 0;
+
+    while( true ) {
+        int lineEnd = findLineEnd( inData, inLength, pos );
+
+        if( lineEnd == -1 ) {
+            return 0;
+            }
+
+        char *sizeEnd;
+        long size = strtol( &( inData[pos] ), &sizeEnd, 16 );
+
+        if( sizeEnd == &( inData[pos] ) || size < 0 ) {
+            return -1;
+            }
+
+        pos = lineEnd + 2;
+
+        if( size == 0 ) {
+            break;
+            }
+
+        if( inLength - pos < size + 2 ) {
+            return 0;
+            }
+
+        outBody->appendArray( (char *)&( inData[pos] ), (int)size );
+
+        pos += size + 2;
+        }
+
+    // skip any trailers, up through blank line that ends them
+    // must read that far, or leftover bytes will be taken as start of
+    // next response on a kept-alive connection
+    while( true ) {
+        int lineEnd = findLineEnd( inData, inLength, pos );
+
+        if( lineEnd == -1 ) {
+            return 0;
+            }
+
+        char blank = ( lineEnd == pos );
+
+        pos = lineEnd + 2;
+
+        if( blank ) {
+            *outUsed = pos;
+            return 1;
+            }
+        }
+    }
+
+
+
+// returns true if response complete
+// inAtEOF is true if server has closed connection
+static char parseResponse( AsyncWebState *inState, char inAtEOF,
+                           char *outKeepAlive ) {
+    *outKeepAlive = false;
+
+    int length = inState->response.size();
+
+    if( length == 0 ) {
+        return false;
+        }
+
+    // terminate, so string functions can't run off end
+    inState->response.push_back( '\0' );
+    char *data = inState->response.getElementArray();
+    inState->response.deleteElement( length );
+
+    char complete = false;
+
+    char *headerEnd = strstr( data, "\r\n\r\n" );
+
+    if( headerEnd == NULL ) {
+        delete [] data;
+        return false;
+        }
+
+    int headerLength = headerEnd - data;
+    int bodyStart = headerLength + 4;
+
+    int minorVersion = 0;
+    int statusCode = -1;
+
+    if( sscanf( data, "HTTP/1.%d %d", &minorVersion, &statusCode ) != 2 ) {
+        delete [] data;
+        inState->statusCode = -1;
+        // caller fails request
+        return true;
+        }
+
+    const char *connectionHeader =
+        findHeader( data, headerLength, "Connection" );
+
+    char keepAlive;
+    if( minorVersion >= 1 ) {
+        keepAlive = ! headerIs( connectionHeader, "close" );
+        }
+    else {
+        keepAlive = headerIs( connectionHeader, "keep-alive" );
+        }
+
+    const char *lengthHeader =
+        findHeader( data, headerLength, "Content-Length" );
+    const char *encodingHeader =
+        findHeader( data, headerLength, "Transfer-Encoding" );
+
+    SimpleVector<char> body;
+
+    // where response ends in data, if complete
+    int responseEnd = length;
+
+    if( statusCode == 204 || statusCode == 304 ) {
+        complete = true;
+        responseEnd = bodyStart;
+        }
+    else if( headerIs( encodingHeader, "chunked" ) ) {
+        int used = 0;
+        int result = decodeChunkedBody( &( data[ bodyStart ] ),
+                                        length - bodyStart, &body, &used );
+        if( result == -1 ) {
+            statusCode = -1;
+            complete = true;
+            }
+        else if( result == 1 ) {
+            complete = true;
+            responseEnd = bodyStart + used;
+            }
+        }
+    else if( lengthHeader != NULL ) {
+        int bodyLength = atoi( lengthHeader );
+
+        if( length - bodyStart >= bodyLength ) {
+            body.appendArray( &( data[ bodyStart ] ), bodyLength );
+            complete = true;
+            responseEnd = bodyStart + bodyLength;
+            }
+        }
+    else {
+        // body runs until server closes connection
+        keepAlive = false;
+
+        if( inAtEOF ) {
+            body.appendArray( &( data[ bodyStart ] ), length - bodyStart );
+            complete = true;
+            }
+        }
+
+    delete [] data;
+
+    if( complete && responseEnd < length ) {
+        // server sent more than this response
+        // can't tell where next one would start, so don't reuse connection
+        keepAlive = false;
+        }
+
+    if( complete ) {
+        inState->statusCode = statusCode;
+
+        body.push_back( '\0' );
+        inState->body = body.getElementArray();
+
+        *outKeepAlive = keepAlive;
+        }
+
+    return complete;
+    }
+
+
+
+static void receiveResponse( AsyncWebState *inState ) {
+    char buffer[ RECEIVE_CHUNK_BYTES ];
+
+    while( inState->status == WEB_RECEIVING ) {
+        int numRead = recv( inState->connection->fd, buffer,
+                            sizeof( buffer ), 0 );
+
+        if( numRead < 0 ) {
+            if( errno == EINTR ) {
+                continue;
+                }
+            if( errno == EAGAIN || errno == EWOULDBLOCK ) {
+                return;
+                }
+            connectionLost( inState, "Receive failed" );
+            return;
+            }
+
+        char atEOF = ( numRead == 0 );
+
+        inState->response.appendArray( buffer, numRead );
+
+        char keepAlive;
+
+        if( parseResponse( inState, atEOF, &keepAlive ) ) {
+            if( inState->statusCode == -1 ) {
+                failRequest( inState, "Bad response" );
+                return;
+                }
+
+            WebConnection *c = inState->connection;
+            inState->connection = NULL;
+
+            if( keepAlive && ! atEOF ) {
+                removeFDFromEvents( c->fd );
+
+                c->reused = true;
+                c->idleStartTime = Time::getCurrentTime();
+                c->host->idleConnections.push_back( c );
+                }
+            else {
+                closeConnection( c );
+                }
+
+            finishRequest( inState, WEB_DONE );
+            return;
+            }
+
+        if( atEOF ) {
+            connectionLost( inState, "Connection closed early" );
+            return;
+            }
+        }
+    }
+
+
+
+static void sendRequest( AsyncWebState *inState ) {
+    while( inState->numSent < inState->requestLength ) {
+        int numSent = send( inState->connection->fd,
+                            &( inState->requestText[ inState->numSent ] ),
+                            inState->requestLength - inState->numSent,
+                            MSG_NOSIGNAL );
+
+        if( numSent < 0 ) {
+            if( errno == EINTR ) {
+                continue;
+                }
+            if( errno == EAGAIN || errno == EWOULDBLOCK ) {
+                setFDWantWritable( inState->connection->fd, true );
+                return;
+                }
+            connectionLost( inState, "Send failed" );
+            return;
+            }
+
+        inState->numSent += numSent;
+        }
+
+    setFDWantWritable( inState->connection->fd, false );
+
+    inState->status = WEB_RECEIVING;
+
+    // response may already be waiting
+    receiveResponse( inState );
+    }
+
+
+
+// moves request along as far as it can go without blocking
+static void advanceRequest( AsyncWebState *inState,
+                            char inReadable, char inWritable ) {
+
+    if( inState->status == WEB_CONNECTING ) {
+        if( ! inWritable && ! inReadable ) {
+            return;
+            }
+
+        int error = 0;
+        socklen_t errorLength = sizeof( error );
+
+        if( getsockopt( inState->connection->fd, SOL_SOCKET, SO_ERROR,
+                        &error, &errorLength ) != 0 || error != 0 ) {
+            connectionLost( inState, "Connect failed" );
+            return;
+            }
+
+        inState->status = WEB_SENDING;
+        }
+
+    if( inState->status == WEB_SENDING ) {
+        sendRequest( inState );
+        }
+    else if( inState->status == WEB_RECEIVING && inReadable ) {
+        receiveResponse( inState );
+        }
+    }
+
+
+
+static void connectionEvent( void *inData,
+                             char inReadable, char inWritable ) {
+    advanceRequest( (AsyncWebState *)inData, inReadable, inWritable );
+    }
+
+
+
+static void watchConnection( int inFD, char inWantWritable,
+                             AsyncWebState *inState ) {
+    if( ! addFDToEvents( inFD, inWantWritable, connectionEvent, inState ) ) {
+        pollingConnections = true;
+        }
+    }
+
+
+
+static void startConnection( AsyncWebState *inState ) {
+    WebHost *host = inState->host;
+
+    inState->numSent = 0;
+    inState->response.deleteAll();
+
+    // newest idle connection is least likely to have been closed
+    while( host->idleConnections.size() > 0 ) {
+        int last = host->idleConnections.size() - 1;
+
+        WebConnection *c = host->idleConnections.getElementDirect( last );
+        host->idleConnections.deleteElement( last );
+
+        if( Time::getCurrentTime() - c->idleStartTime > idleSeconds ) {
+            closeConnection( c );
+            continue;
+            }
+
+        inState->connection = c;
+        inState->status = WEB_SENDING;
+
+        watchConnection( c->fd, false, inState );
+
+        sendRequest( inState );
+        return;
+        }
+
+    int fd = socket( AF_INET, SOCK_STREAM, 0 );
+
+    if( fd == -1 ) {
+        failRequest( inState, "Creating socket failed" );
+        return;
+        }
+
+    fcntl( fd, F_SETFL, fcntl( fd, F_GETFL, 0 ) | O_NONBLOCK );
+
+    int flag = 1;
+    setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof( flag ) );
+
+    WebConnection *c = new WebConnection;
+    c->fd = fd;
+    c->host = host;
+    c->reused = false;
+    c->idleStartTime = 0;
+
+    inState->connection = c;
+
+    int result = connect( fd, (struct sockaddr *)&( host->address ),
+                          sizeof( host->address ) );
+
+    if( result == -1 && errno != EINPROGRESS ) {
+        connectionLost( inState, "Connect failed" );
+        return;
+        }
+
+    watchConnection( fd, true, inState );
+
+    if( result == 0 ) {
+        inState->status = WEB_SENDING;
+        sendRequest( inState );
+        }
+    else {
+        inState->status = WEB_CONNECTING;
+        }
+    }
+
+
+
+// polls request's connection without waiting, for when socketEvents can't
+// watch it for us
+static void pollRequest( AsyncWebState *inState ) {
+    if( inState->connection == NULL ) {
+        return;
+        }
+
+    struct pollfd p;
+    p.fd = inState->connection->fd;
+    p.events = POLLIN;
+    p.revents = 0;
+
+    if( inState->status == WEB_CONNECTING ||
+        inState->status == WEB_SENDING ) {
+        p.events |= POLLOUT;
+        }
+
+    if( poll( &p, 1, 0 ) <= 0 ) {
+        return;
+        }
+
+    char readable = ( p.revents & ( POLLIN | POLLHUP | POLLERR ) ) != 0;
+    char writable = ( p.revents & POLLOUT ) != 0;
+
+    advanceRequest( inState, readable, writable );
+    }
+
+
+
+void initAsyncWeb() {
+    defaultTimeoutSeconds =
+        SettingsManager::getFloatSetting( "webRequestTimeoutSeconds", 10 );
+
+    idleSeconds =
+        SettingsManager::getFloatSetting( "webConnectionIdleSeconds", 30 );
+    }
+
+
+
+void freeAsyncWeb() {
+    while( activeRequests.size() > 0 ) {
+        failRequest( activeRequests.getElementDirect( 0 ), "Shutting down" );
+        }
+
+    for( int i=0; i<hosts.size(); i++ ) {
+        WebHost *h = hosts.getElementDirect( i );
+
+        for( int j=0; j<h->idleConnections.size(); j++ ) {
+            closeConnection( h->idleConnections.getElementDirect( j ) );
+            }
+
+        if( h->lookupThread != NULL ) {
+            // waits for lookup to finish
+            delete h->lookupThread;
+            }
+
+        delete [] h->name;
+        delete h;
+        }
+    hosts.deleteAll();
+    }
+
+
+
+void stepAsyncWeb() {
+    double curTime = Time::getCurrentTime();
+
+    // copy, because requests leave list as they finish
+    SimpleVector<AsyncWebState*> requests;
+    requests.push_back_other( &activeRequests );
+
+    for( int i=0; i<requests.size(); i++ ) {
+        AsyncWebState *s = requests.getElementDirect( i );
+
+        if( pollingConnections ) {
+            pollRequest( s );
+            }
+
+        if( s->status == WEB_WAITING_HOST ) {
+            if( lookUpHost( s->host ) ) {
+                startConnection( s );
+                }
+            else if( s->host->lookupThread == NULL ) {
+                failRequest( s, "Host lookup failed" );
+                }
+            }
+
+        if( s->status < WEB_DONE && curTime > s->deadline ) {
+            failRequest( s, "Timed out" );
+            }
+        }
+
+    for( int i=0; i<hosts.size(); i++ ) {
+        WebHost *h = hosts.getElementDirect( i );
+
+        for( int j=0; j<h->idleConnections.size(); j++ ) {
+            WebConnection *c = h->idleConnections.getElementDirect( j );
+
+            if( curTime - c->idleStartTime > idleSeconds ) {
+                closeConnection( c );
+                h->idleConnections.deleteElement( j );
+                j--;
+                }
+            }
+        }
+    }
+
+
+
+double getAsyncWebWaitLimit() {
+    if( activeRequests.size() == 0 ) {
+        return -1;
+        }
+
+    double curTime = Time::getCurrentTime();
+
+    double limit = -1;
+
+    for( int i=0; i<activeRequests.size(); i++ ) {
+        AsyncWebState *s = activeRequests.getElementDirect( i );
+
+        double wait = s->deadline - curTime;
+
+        if( ( s->status == WEB_WAITING_HOST || pollingConnections ) &&
+            wait > CHECK_SECONDS ) {
+            wait = CHECK_SECONDS;
+            }
+
+        if( wait < 0 ) {
+            wait = 0;
+            }
+
+        if( limit == -1 || wait < limit ) {
+            limit = wait;
+            }
+        }
+
+    return limit;
+    }
+
+
+
+AsyncWebRequest::AsyncWebRequest( const char *inMethod, const char *inURL,
+                                  const char *inBody,
+                                  double inTimeoutSeconds ) {
+    AsyncWebState *s = new AsyncWebState;
+    mState = s;
+
+    s->request = this;
+    s->status = WEB_WAITING_HOST;
+    s->host = NULL;
+    s->path = NULL;
+    s->connection = NULL;
+    s->retried = false;
+    s->requestText = NULL;
+    s->requestLength = 0;
+    s->numSent = 0;
+    s->statusCode = -1;
+    s->body = NULL;
+    s->callback = NULL;
+    s->callbackData = NULL;
+
+    if( inTimeoutSeconds <= 0 ) {
+        inTimeoutSeconds = defaultTimeoutSeconds;
+        }
+    s->deadline = Time::getCurrentTime() + inTimeoutSeconds;
+
+
+    // split URL into host, port, and path
+    const char *prefix = "http://";
+    int prefixLength = strlen( prefix );
+
+    if( strncasecmp( inURL, prefix, prefixLength ) != 0 ) {
+        AppLog::errorF( "Web request URL not supported:  %s", inURL );
+        s->status = WEB_FAILED;
+        return;
+        }
+
+    const char *hostStart = &( inURL[ prefixLength ] );
+    const char *pathStart = strchr( hostStart, '/' );
+
+    if( pathStart == NULL ) {
+        pathStart = &( hostStart[ strlen( hostStart ) ] );
+        }
+
+    int hostLength = pathStart - hostStart;
+
+    char *hostName = new char[ hostLength + 1 ];
+    memcpy( hostName, hostStart, hostLength );
+    hostName[ hostLength ] = '\0';
+
+    int port = 80;
+
+    char *colon = strchr( hostName, ':' );
+    if( colon != NULL ) {
+        sscanf( &( colon[1] ), "%d", &port );
+        colon[0] = '\0';
+        }
+
+    s->host = getHost( hostName, port );
+
+    if( pathStart[0] == '\0' ) {
+        s->path = stringDuplicate( "/" );
+        }
+    else {
+        s->path = stringDuplicate( pathStart );
+        }
+
+
+    char *bodyHeaders;
+
+    if( inBody != NULL ) {
+        bodyHeaders = autoSprintf(
+            "Content-Type: application/x-www-form-urlencoded\r\n"
+            "Content-Length: %d\r\n",
+            (int)strlen( inBody ) );
+        }
+    else {
+        bodyHeaders = stringDuplicate( "" );
+        }
+
+    char *hostHeader;
+
+    if( port == 80 ) {
+        hostHeader = stringDuplicate( hostName );
+        }
+    else {
+        hostHeader = autoSprintf( "%s:%d", hostName, port );
+        }
+
+    s->requestText = autoSprintf(
+        "%s %s HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "User-Agent: OneLifeServer\r\n"
+        "Connection: keep-alive\r\n"
+        "%s"
+        "\r\n"
+        "%s",
+        inMethod, s->path, hostHeader, bodyHeaders,
+        ( inBody != NULL ) ? inBody : "" );
+
+    s->requestLength = strlen( s->requestText );
+
+    delete [] hostHeader;
+    delete [] bodyHeaders;
+    delete [] hostName;
+
+
+    activeRequests.push_back( s );
+
+    if( lookUpHost( s->host ) ) {
+        startConnection( s );
+        }
+    // else stepAsyncWeb starts it when lookup finishes
+    }
+
+
+
+AsyncWebRequest::~AsyncWebRequest() {
+    AsyncWebState *s = mState;
+
+    activeRequests.deleteElementEqualTo( s );
+
+    if( s->connection != NULL ) {
+        closeConnection( s->connection );
+        }
+
+    if( s->path != NULL ) {
+        delete [] s->path;
+        }
+    if( s->requestText != NULL ) {
+        delete [] s->requestText;
+        }
+    if( s->body != NULL ) {
+        delete [] s->body;
+        }
+
+    delete s;
+    }
+
+
+
+void AsyncWebRequest::setCallback( AsyncWebCallback inCallback,
+                                   void *inData ) {
+    mState->callback = inCallback;
+    mState->callbackData = inData;
+    }
+
+
+
+int AsyncWebRequest::step() {
+    AsyncWebState *s = mState;
+
+    if( s->status < WEB_DONE ) {
+        // usually socketEvents has already moved it along
+        pollRequest( s );
+        }
+
+    if( s->status < WEB_DONE &&
+        Time::getCurrentTime() > s->deadline ) {
+        failRequest( s, "Timed out" );
+        }
+
+    switch( s->status ) {
+        case WEB_DONE:
+            return 1;
+        case WEB_FAILED:
+            return -1;
+        default:
+            return 0;
+        }
+    }
+
+
+
+char *AsyncWebRequest::getResult() {
+    if( mState->status != WEB_DONE ) {
+        return NULL;
+        }
+    return stringDuplicate( mState->body );
+    }
+
+
+
+int AsyncWebRequest::getStatusCode() {
+    if( mState->status != WEB_DONE ) {
+        return -1;
+        }
+    return mState->statusCode;
+    }
@@ -0,0 +1,93 @@
+#ifndef ASYNC_WEB_H_INCLUDED
+#define ASYNC_WEB_H_INCLUDED
+
+
+// Non-blocking HTTP client for calls to the ticket, curse, and reflector
+// servers, driven by the main loop's event wait (see socketEvents.h).
+//
+// Requests never block the main loop.  Their sockets are watched along
+// with client sockets, so an answer wakes waitForSocketEvents, and the
+// request reads it right then, instead of the main loop spinning to step
+// requests that have nothing to do.
+//
+// Connections are kept open after a request, one idle pool per host:port,
+// and reused by the next request to that host.  A request that finds its
+// reused connection closed by the server tries once more on a new one.
+// Host names are looked up in a background thread, and lookups are cached.
+//
+// Only plain http:// URLs are supported.
+//
+// webRequestTimeoutSeconds.ini:  default time limit for a request, from
+//    construction to complete response
+//
+// webConnectionIdleSeconds.ini:  idle kept-alive connections are closed
+//    after this long
+
+
+// called once, when request finishes or fails
+// request can't be deleted from inside callback
+class AsyncWebRequest;
+typedef void (*AsyncWebCallback)( AsyncWebRequest *inRequest, void *inData );
+
+
+// call after initSocketEvents
+void initAsyncWeb();
+
+// fails any requests still running
+// call before freeSocketEvents
+void freeAsyncWeb();
+
+
+// fails requests that have run out of time, closes stale idle connections,
+// and starts connections for requests whose host lookup finished
+void stepAsyncWeb();
+
+
+// how long the main loop can wait before stepAsyncWeb has something to do,
+// in seconds
+// -1 if it can wait forever
+double getAsyncWebWaitLimit();
+
+
+
+// stands in for minorGems WebRequest
+class AsyncWebRequest {
+    public:
+
+        // inMethod is GET or POST
+        // inBody is sent as form data, can be NULL
+        // inTimeoutSeconds of 0 uses webRequestTimeoutSeconds setting
+        //
+        // params copied internally
+        AsyncWebRequest( const char *inMethod, const char *inURL,
+                         const char *inBody,
+                         double inTimeoutSeconds = 0 );
+
+        // closes connection if request is still running
+        ~AsyncWebRequest();
+
+
+        void setCallback( AsyncWebCallback inCallback, void *inData );
+
+
+        // returns 1 if response is complete, -1 on failure, 0 if
+        // still running
+        //
+        // never blocks
+        int step();
+
+
+        // body of response, or NULL if not complete
+        // result destroyed by caller
+        char *getResult();
+
+        // HTTP status, or -1 if not complete
+        int getStatusCode();
+
+
+        // internal state, defined in asyncWeb.cpp
+        struct AsyncWebState *mState;
+    };
+
+
+#endif
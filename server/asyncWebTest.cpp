@@ -0,0 +1,320 @@
+// Runs AsyncWebRequest against a stub HTTP server on this machine
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "asyncWeb.h"
+#include "socketEvents.h"
+
+#include "minorGems/network/SocketServer.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/SimpleVector.h"
+
+
+#define STUB_PORT 18777
+#define EVENT_PORT 18778
+
+
+static int numConnectionsAccepted = 0;
+
+
+
+// answers one connection
+// path picks response:
+//    /length   Content-Length body, kept alive
+//    /chunked  chunked body, sent in two parts, kept alive
+//    /lateEnd  chunked body, final CRLF sent separately, kept alive
+//    /close    HTTP/1.0 body ended by close
+//    /drop     kept-alive answer, then server closes while idle
+//    /slow     never answers
+class StubConnection : public Thread {
+    public:
+        StubConnection( int inFD )
+                : mFD( inFD ) {
+            start();
+            }
+
+        ~StubConnection() {
+            join();
+            }
+
+        virtual void run() {
+            SimpleVector<char> request;
+            char buffer[1024];
+
+            while( true ) {
+                int numRead = read( mFD, buffer, sizeof( buffer ) );
+
+                if( numRead <= 0 ) {
+                    break;
+                    }
+                request.appendArray( buffer, numRead );
+
+                request.push_back( '\0' );
+                char *text = request.getElementArray();
+                request.deleteElement( request.size() - 1 );
+
+                char *end = strstr( text, "\r\n\r\n" );
+
+                if( end == NULL ) {
+                    delete [] text;
+                    continue;
+                    }
+                // client doesn't send bodies or pipeline requests
+                request.deleteAll();
+
+                char done = answer( text );
+
+                delete [] text;
+
+                if( done ) {
+                    break;
+                    }
+                }
+            close( mFD );
+            }
+
+
+    protected:
+        int mFD;
+
+        void sendString( const char *inString ) {
+            write( mFD, inString, strlen( inString ) );
+            }
+
+        // returns true if connection should close
+        char answer( const char *inRequest ) {
+            if( strstr( inRequest, " /length " ) != NULL ) {
+                sendString( "HTTP/1.1 200 OK\r\n"
+                            "Content-Length: 6\r\n\r\nVALID\n" );
+                }
+            else if( strstr( inRequest, " /chunked " ) != NULL ) {
+                sendString( "HTTP/1.1 200 OK\r\n"
+                            "Transfer-Encoding: chunked\r\n\r\n"
+                            "3\r\nOK \r\n" );
+                Thread::staticSleep( 50 );
+                sendString( "3\r\n12\n\r\n0\r\n\r\n" );
+                }
+            else if( strstr( inRequest, " /lateEnd " ) != NULL ) {
+                sendString( "HTTP/1.1 200 OK\r\n"
+                            "Transfer-Encoding: chunked\r\n\r\n"
+                            "4\r\nlate\r\n0\r\n" );
+                Thread::staticSleep( 50 );
+                sendString( "\r\n" );
+                }
+            else if( strstr( inRequest, " /close " ) != NULL ) {
+                sendString( "HTTP/1.0 200 OK\r\n\r\nclosed" );
+                return true;
+                }
+            else if( strstr( inRequest, " /drop " ) != NULL ) {
+                sendString( "HTTP/1.1 200 OK\r\n"
+                            "Content-Length: 4\r\n\r\ndrop" );
+                Thread::staticSleep( 100 );
+                return true;
+                }
+            else if( strstr( inRequest, " /slow " ) != NULL ) {
+                Thread::staticSleep( 2000 );
+                return true;
+                }
+            return false;
+            }
+    };
+
+
+
+class StubServer : public Thread {
+    public:
+        StubServer( int inListenFD )
+                : mListenFD( inListenFD ) {
+            start();
+            }
+
+        virtual void run() {
+            while( true ) {
+                int fd = accept( mListenFD, NULL, NULL );
+
+                if( fd == -1 ) {
+                    return;
+                    }
+                numConnectionsAccepted++;
+
+                // test exits without cleaning these up
+                new StubConnection( fd );
+                }
+            }
+
+    protected:
+        int mListenFD;
+    };
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inName ) {
+    printf( "%s:  %s\n", inName, inPassed ? "passed" : "FAILED" );
+
+    if( ! inPassed ) {
+        numFailed++;
+        }
+    }
+
+
+
+// steps request the way server's main loop does
+// returns final step result
+static int runRequest( AsyncWebRequest *inRequest ) {
+    int result = 0;
+
+    while( ( result = inRequest->step() ) == 0 ) {
+        double limit = getAsyncWebWaitLimit();
+
+        int waitMS = 1000;
+
+        if( limit != -1 ) {
+            waitMS = (int)( limit * 1000 ) + 1;
+            }
+        waitForSocketEvents( waitMS );
+
+        stepAsyncWeb();
+        }
+
+    return result;
+    }
+
+
+
+// runs request and checks its body
+static void checkRequest( const char *inURL, const char *inExpected,
+                          const char *inName ) {
+    AsyncWebRequest r( "GET", inURL, NULL );
+
+    int result = runRequest( &r );
+
+    char *body = r.getResult();
+
+    check( result == 1 && body != NULL && strcmp( body, inExpected ) == 0,
+           inName );
+
+    if( body != NULL ) {
+        delete [] body;
+        }
+    }
+
+
+
+static int numCallbacks = 0;
+
+static void countCallback( AsyncWebRequest *inRequest, void *inData ) {
+    numCallbacks++;
+    }
+
+
+
+int main() {
+    int listenFD = socket( AF_INET, SOCK_STREAM, 0 );
+
+    int reuse = 1;
+    setsockopt( listenFD, SOL_SOCKET, SO_REUSEADDR,
+                &reuse, sizeof( reuse ) );
+
+    struct sockaddr_in address;
+    memset( &address, 0, sizeof( address ) );
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    address.sin_port = htons( STUB_PORT );
+
+    if( bind( listenFD, (struct sockaddr *)&address,
+              sizeof( address ) ) != 0 ||
+        listen( listenFD, 16 ) != 0 ) {
+        printf( "Stub server failed to listen on port %d\n", STUB_PORT );
+        return 1;
+        }
+
+    StubServer stub( listenFD );
+
+    SocketServer eventServer( EVENT_PORT, 16 );
+
+    initSocketEvents( &eventServer );
+    initAsyncWeb();
+
+
+    // answer should arrive by waiting on events alone, without stepping
+    AsyncWebRequest *r =
+        new AsyncWebRequest( "GET", "http://127.0.0.1:18777/length", NULL );
+    r->setCallback( countCallback, NULL );
+
+    double startTime = Time::getCurrentTime();
+
+    while( numCallbacks == 0 && Time::getCurrentTime() - startTime < 5 ) {
+        waitForSocketEvents( 1000 );
+        }
+    check( numCallbacks == 1 && r->getStatusCode() == 200,
+           "Answer wakes event wait" );
+    delete r;
+
+
+    checkRequest( "http://localhost:18777/chunked", "OK 12\n",
+                  "Chunked body" );
+
+    int numBefore = numConnectionsAccepted;
+    checkRequest( "http://localhost:18777/length", "VALID\n",
+                  "Content-Length body" );
+    check( numConnectionsAccepted == numBefore, "Connection reused" );
+
+
+    // body must not end until final CRLF arrives, or that CRLF is left
+    // to be read as start of next answer on same connection
+    checkRequest( "http://localhost:18777/lateEnd", "late",
+                  "Chunked body with late final CRLF" );
+
+    numBefore = numConnectionsAccepted;
+    checkRequest( "http://localhost:18777/length", "VALID\n",
+                  "Request after late final CRLF" );
+    check( numConnectionsAccepted == numBefore, 
+           "Connection reused after late final CRLF" );
+
+
+    checkRequest( "http://127.0.0.1:18777/drop", "drop", "Before drop" );
+    Thread::staticSleep( 300 );
+
+    numBefore = numConnectionsAccepted;
+    checkRequest( "http://127.0.0.1:18777/length", "VALID\n",
+                  "Retry after server closed idle connection" );
+    check( numConnectionsAccepted == numBefore + 1, "One new connection" );
+
+
+    checkRequest( "http://127.0.0.1:18777/close", "closed",
+                  "Body ended by close" );
+
+
+    startTime = Time::getCurrentTime();
+
+    AsyncWebRequest slow( "GET", "http://127.0.0.1:18777/slow", NULL, 0.5 );
+    int result = runRequest( &slow );
+    double seconds = Time::getCurrentTime() - startTime;
+
+    check( result == -1 && seconds > 0.45 && seconds < 1,
+           "Timeout" );
+
+
+    AsyncWebRequest refused( "GET", "http://127.0.0.1:1/", NULL );
+    check( runRequest( &refused ) == -1, "Connection refused" );
+
+
+    freeAsyncWeb();
+    freeSocketEvents();
+
+    printf( "%d checks failed\n", numFailed );
+
+    fflush( stdout );
+
+    // without waiting for stub server threads, which are still blocked
+    _exit( numFailed );
+    }
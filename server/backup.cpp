@@ -1,11 +1,16 @@
 #include "backup.h"
+#include "mapJournal.h"
 
 
 
 #include "minorGems/util/SettingsManager.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/stringUtils.h"
 #include "minorGems/io/file/File.h"
 #include "minorGems/io/file/Directory.h"
 #include "minorGems/system/Time.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
 
 #include "minorGems/util/log/AppLog.h"
 
@@ -13,12 +18,318 @@
 static timeSec_t lastBackupTime = 0;
 static int targetHour = 8;
 
+
+
+// Incremental backups
+//
+// A chain starts with a base, which is a plain copy of the DB file named
+// like a normal full backup:
+//    backups/mapTiles_2018_10_17__08_00_00.db
+//
+// Deltas follow, named after their base plus their own time:
+//    backups/mapTiles_2018_10_17__08_00_00__2018_10_17__09_00_00.delta
+//
+// Delta format (native byte order, like lineardb3 header):
+//    4-byte magic "Ld3d"
+//    uint32 key size
+//    uint32 value size
+//    uint32 number of records in DB when delta was started
+//    then, to end of file, records as:
+//       uint32 record number, key, value
+//
+// lineardb3 never moves or removes records, so writing each delta's
+// records at their record numbers, in order, over a copy of the base
+// rebuilds the DB as of that delta.  See dbRestoreBackup.
+//
+// Base files are copied by the writer thread while the server keeps
+// writing to the DB, so a base can hold a torn record.  Anything written
+// after the base is started is in the first delta, which fixes that.
+//
+// Each delta holds every record written before it was started, each
+// as of some moment while the delta was being captured.
+
+static char incrementalBackupsOn = false;
+
+static int incrementalBackupMinutes = 60;
+
+static timeSec_t lastDeltaTime = 0;
+
+
+// main thread copies records out of the DB for this long per checkBackup
+#define INCREMENTAL_BACKUP_STEP_SECONDS 0.005
+
+// records are handed to writer thread in chunks of about this size
+#define INCREMENTAL_BACKUP_CHUNK_BYTES 1048576
+
+// main thread stops copying records when this many bytes are waiting
+// to be written (while a big base is copied, for example)
+#define INCREMENTAL_BACKUP_MAX_PENDING_BYTES 67108864
+
+
+
+typedef struct IncrementalBackupDB {
+        char *prefix;
+        LINEARDB3 *db;
+
+        // true if next delta can't be used, and a new base is needed
+        char needsBase;
+
+        // like mapTiles_2018_10_17__08_00_00, NULL if no base yet
+        char *chainName;
+
+        // dirty records being copied into current delta, or NULL
+        uint32_t *captureList;
+        uint32_t numToCapture;
+        uint32_t nextToCapture;
+
+        char *deltaTempPath;
+        char *deltaFinalPath;
+    } IncrementalBackupDB;
+
+
+static SimpleVector<IncrementalBackupDB> incrementalDBs;
+
+
+
+// one job for the writer thread
+//
+// if copyFromPath is set, its first copyBytes bytes are copied to tempPath
+// if data is set, it is appended to tempPath
+// then, if finalPath is set, tempPath is renamed to finalPath
+typedef struct BackupWriteJob {
+        char *copyFromPath;
+        uint64_t copyBytes;
+
+        unsigned char *data;
+        int dataLength;
+
+        char *tempPath;
+        char *finalPath;
+    } BackupWriteJob;
+
+
+// guards everything below, shared with writer thread
+static MutexLock backupWriteLock;
+
+static SimpleVector<BackupWriteJob> backupWriteJobs;
+
+static uint64_t pendingWriteBytes = 0;
+
+// set by writer thread when a job fails, cleared by main thread
+static char backupWriteFailed = false;
+
+static char stopBackupWriter = false;
+
+
+
+static char runBackupWriteJob( BackupWriteJob *inJob ) {
+    FILE *outFile = fopen( inJob->tempPath,
+                           ( inJob->copyFromPath != NULL ) ? "wb" : "ab" );
+
+    if( outFile == NULL ) {
+        return false;
+        }
+
+    char ok = true;
+
+    if( inJob->copyFromPath != NULL ) {
+        FILE *inFile = fopen( inJob->copyFromPath, "rb" );
+
+        if( inFile == NULL ) {
+            ok = false;
+            }
+        else {
+            unsigned char *buffer =
+                new unsigned char[ INCREMENTAL_BACKUP_CHUNK_BYTES ];
+
+            uint64_t bytesLeft = inJob->copyBytes;
+
+            while( ok && bytesLeft > 0 ) {
+                int numToRead = INCREMENTAL_BACKUP_CHUNK_BYTES;
+
+                if( bytesLeft < (uint64_t)numToRead ) {
+                    numToRead = (int)bytesLeft;
+                    }
+
+                if( fread( buffer, numToRead, 1, inFile ) != 1 ||
+                    fwrite( buffer, numToRead, 1, outFile ) != 1 ) {
+                    ok = false;
+                    }
+                bytesLeft -= numToRead;
+                }
+
+            delete [] buffer;
+            fclose( inFile );
+            }
+        }
+
+    if( ok && inJob->data != NULL ) {
+        if( fwrite( inJob->data, inJob->dataLength, 1, outFile ) != 1 ) {
+            ok = false;
+            }
+        }
+
+    if( fclose( outFile ) != 0 ) {
+        ok = false;
+        }
+
+    if( ok && inJob->finalPath != NULL ) {
+        if( rename( inJob->tempPath, inJob->finalPath ) != 0 ) {
+            ok = false;
+            }
+        }
+
+    return ok;
+    }
+
+
+
+class BackupWriterThread : public Thread {
+    public:
+
+        BackupWriterThread() {
+            start();
+            }
+
+        ~BackupWriterThread() {
+            join();
+            }
+
+        virtual void run() {
+            while( true ) {
+                backupWriteLock.lock();
+
+                if( backupWriteJobs.size() == 0 ) {
+                    char stop = stopBackupWriter;
+
+                    backupWriteLock.unlock();
+
+                    if( stop ) {
+                        return;
+                        }
+
+                    Thread::staticSleep( 50 );
+                    continue;
+                    }
+
+                BackupWriteJob job = backupWriteJobs.getElementDirect( 0 );
+                backupWriteJobs.deleteElement( 0 );
+
+                backupWriteLock.unlock();
+
+
+                char ok = runBackupWriteJob( &job );
+
+
+                backupWriteLock.lock();
+
+                pendingWriteBytes -= job.dataLength + job.copyBytes;
+
+                if( ! ok ) {
+                    backupWriteFailed = true;
+                    }
+
+                backupWriteLock.unlock();
+
+                if( job.copyFromPath != NULL ) {
+                    delete [] job.copyFromPath;
+                    }
+                if( job.data != NULL ) {
+                    delete [] job.data;
+                    }
+                delete [] job.tempPath;
+                if( job.finalPath != NULL ) {
+                    delete [] job.finalPath;
+                    }
+                }
+            }
+    };
+
+
+static BackupWriterThread *backupWriter = NULL;
+
+
+
+// takes ownership of strings and data in inJob
+static void addBackupWriteJob( BackupWriteJob inJob ) {
+    if( backupWriter == NULL ) {
+        backupWriter = new BackupWriterThread();
+        }
+
+    backupWriteLock.lock();
+
+    backupWriteJobs.push_back( inJob );
+    pendingWriteBytes += inJob.dataLength + inJob.copyBytes;
+
+    backupWriteLock.unlock();
+    }
+
+
+
+static BackupWriteJob makeBackupWriteJob( char *inTempPath,
+                                          char *inFinalPath ) {
+    BackupWriteJob job;
+
+    job.copyFromPath = NULL;
+    job.copyBytes = 0;
+    job.data = NULL;
+    job.dataLength = 0;
+    job.tempPath = inTempPath;
+    job.finalPath = inFinalPath;
+
+    return job;
+    }
+
+
+
+
+// result destroyed by caller
+static char *getTimeFileNamePart( time_t inTime ) {
+    struct tm timeStruct;
+    struct tm *gmTM = gmtime( &inTime );
+
+    // other calls overwrite it
+    memcpy( &timeStruct, gmTM, sizeof( timeStruct ) );
+
+    return autoSprintf( "%d_%02d_%02d__%02d_%02d_%02d",
+                        timeStruct.tm_year + 1900,
+                        timeStruct.tm_mon + 1,
+                        timeStruct.tm_mday,
+                        timeStruct.tm_hour,
+                        timeStruct.tm_min,
+                        timeStruct.tm_sec );
+    }
+
+
+
+static void readIncrementalSettings() {
+    incrementalBackupMinutes =
+        SettingsManager::getIntSetting( "incrementalBackupMinutes",
+                                        incrementalBackupMinutes );
+
+    if( incrementalBackupMinutes < 1 ) {
+        incrementalBackupMinutes = 1;
+        }
+    }
+
+
+
 void initBackup() {
     lastBackupTime = SettingsManager::getTimeSetting( "lastBackupTimeUTC",
                                                       lastBackupTime );
 
     targetHour = SettingsManager::getIntSetting( "backupHourUTC",
                                                  targetHour );
+
+    // only read at startup, since DBs are only tracked if this is on when
+    // they are added
+    incrementalBackupsOn =
+        SettingsManager::getIntSetting( "saveBackups", 0 ) &&
+        SettingsManager::getIntSetting( "incrementalBackups", 0 );
+
+    readIncrementalSettings();
+
+    lastDeltaTime = Time::timeSec();
     
 
     time_t t = time( NULL );
@@ -31,18 +342,396 @@ void initBackup() {
     memcpy( &timeStruct, gmTM, sizeof( timeStruct ) );
     
     AppLog::infoF( "Backup system inited.  Backups on = %d, "
+                   "incremental = %d (every %d minutes), "
                    "target hour UTC = %d, current hour UTC = %d, "
                    "last backup was %f hours ago",
                    SettingsManager::getIntSetting( "saveBackups", 0 ),
+                   incrementalBackupsOn,
+                   incrementalBackupMinutes,
                    targetHour,
                    timeStruct.tm_hour,
                    ( Time::timeSec() - lastBackupTime ) / 3600.0 );
     }
 
 
+
+static void stopCapture( IncrementalBackupDB *inR ) {
+    if( inR->captureList != NULL ) {
+        delete [] inR->captureList;
+        inR->captureList = NULL;
+        }
+    inR->numToCapture = 0;
+    inR->nextToCapture = 0;
+
+    if( inR->deltaTempPath != NULL ) {
+        delete [] inR->deltaTempPath;
+        inR->deltaTempPath = NULL;
+        }
+    if( inR->deltaFinalPath != NULL ) {
+        delete [] inR->deltaFinalPath;
+        inR->deltaFinalPath = NULL;
+        }
+    }
+
+
+
+static void freeIncrementalBackupDB( IncrementalBackupDB *inR ) {
+    stopCapture( inR );
+
+    delete [] inR->prefix;
+
+    if( inR->chainName != NULL ) {
+        delete [] inR->chainName;
+        }
+    }
+
+
+
+void freeBackup() {
+    for( int i=0; i<incrementalDBs.size(); i++ ) {
+        freeIncrementalBackupDB( incrementalDBs.getElement( i ) );
+        }
+    incrementalDBs.deleteAll();
+
+    if( backupWriter != NULL ) {
+        backupWriteLock.lock();
+        stopBackupWriter = true;
+        backupWriteLock.unlock();
+
+        // finishes all jobs before returning
+        delete backupWriter;
+        backupWriter = NULL;
+
+        stopBackupWriter = false;
+        }
+    }
+
+
+
+void addIncrementalBackupDB( const char *inFileNamePrefix,
+                             LINEARDB3 *inDB ) {
+    if( ! incrementalBackupsOn ) {
+        // nothing would ever take its dirty records
+        // leave it to be copied whole with other DB files
+        return;
+        }
+
+    IncrementalBackupDB r;
+
+    r.prefix = stringDuplicate( inFileNamePrefix );
+    r.db = inDB;
+    r.needsBase = true;
+    r.chainName = NULL;
+    r.captureList = NULL;
+    r.numToCapture = 0;
+    r.nextToCapture = 0;
+    r.deltaTempPath = NULL;
+    r.deltaFinalPath = NULL;
+
+    LINEARDB3_trackDirtyRecords( inDB );
+
+    incrementalDBs.push_back( r );
+    }
+
+
+
+void removeIncrementalBackupDB( LINEARDB3 *inDB ) {
+    for( int i=0; i<incrementalDBs.size(); i++ ) {
+        IncrementalBackupDB *r = incrementalDBs.getElement( i );
+
+        if( r->db == inDB ) {
+            if( r->captureList != NULL ) {
+                AppLog::infoF( "%s closed while saving delta backup, "
+                               "dropping %d unsaved records from delta",
+                               r->prefix,
+                               r->numToCapture - r->nextToCapture );
+                }
+
+            freeIncrementalBackupDB( r );
+            incrementalDBs.deleteElement( i );
+            return;
+            }
+        }
+    }
+
+
+
+static IncrementalBackupDB *getIncrementalBackupDB(
+    const char *inFileNamePrefix ) {
+
+    for( int i=0; i<incrementalDBs.size(); i++ ) {
+        IncrementalBackupDB *r = incrementalDBs.getElement( i );
+
+        if( strcmp( r->prefix, inFileNamePrefix ) == 0 ) {
+            return r;
+            }
+        }
+    return NULL;
+    }
+
+
+
+static uint64_t getDBFileBytes( LINEARDB3 *inDB ) {
+    return
+        LINEARDB3_getHeaderSize() +
+        (uint64_t)LINEARDB3_getNumRecords( inDB ) *
+        ( inDB->keySize + inDB->valueSize );
+    }
+
+
+
+// starts new chain with a base copy made in the background
+// any dirty records so far are in the base
+static void startBackupChain( IncrementalBackupDB *inR,
+                              char *inTimeFileNamePart ) {
+    if( inR->captureList != NULL ) {
+        // wait for delta to finish, so we don't start a base partway
+        // through old chain's delta
+        inR->needsBase = true;
+        return;
+        }
+
+    if( LINEARDB3_flush( inR->db ) != 0 ) {
+        AppLog::errorF( "Failed to flush %s.db for base backup", inR->prefix );
+        inR->needsBase = true;
+        return;
+        }
+
+    uint32_t numDirty;
+    uint32_t *dirty = LINEARDB3_takeDirtyRecords( inR->db, &numDirty );
+
+    if( dirty != NULL ) {
+        delete [] dirty;
+        }
+
+
+    if( inR->chainName != NULL ) {
+        delete [] inR->chainName;
+        }
+    inR->chainName = autoSprintf( "%s_%s", inR->prefix, inTimeFileNamePart );
+
+    BackupWriteJob job =
+        makeBackupWriteJob(
+            autoSprintf( "backups/%s.db.temp", inR->chainName ),
+            autoSprintf( "backups/%s.db", inR->chainName ) );
+
+    job.copyFromPath = autoSprintf( "%s.db", inR->prefix );
+    job.copyBytes = getDBFileBytes( inR->db );
+
+    addBackupWriteJob( job );
+
+    inR->needsBase = false;
+
+    AppLog::infoF( "Started base backup %s.db in background "
+                   "(%.1f MiB)", inR->chainName,
+                   job.copyBytes / 1048576.0 );
+    }
+
+
+
+static void startBackupDelta( IncrementalBackupDB *inR,
+                              char *inTimeFileNamePart ) {
+    if( inR->chainName == NULL || inR->captureList != NULL ) {
+        return;
+        }
+
+    uint32_t numDirty;
+    uint32_t *dirty = LINEARDB3_takeDirtyRecords( inR->db, &numDirty );
+
+    if( dirty == NULL ) {
+        // nothing changed, no delta needed
+        return;
+        }
+
+    inR->captureList = dirty;
+    inR->numToCapture = numDirty;
+    inR->nextToCapture = 0;
+
+    inR->deltaFinalPath = autoSprintf( "backups/%s__%s.delta",
+                                       inR->chainName, inTimeFileNamePart );
+    inR->deltaTempPath = autoSprintf( "%s.temp", inR->deltaFinalPath );
+
+
+    BackupWriteJob job =
+        makeBackupWriteJob( stringDuplicate( inR->deltaTempPath ), NULL );
+
+    job.dataLength = 16;
+    job.data = new unsigned char[ job.dataLength ];
+
+    uint32_t header[3] = { inR->db->keySize,
+                           inR->db->valueSize,
+                           LINEARDB3_getNumRecords( inR->db ) };
+
+    memcpy( job.data, "Ld3d", 4 );
+    memcpy( &( job.data[4] ), header, 12 );
+
+    // fresh file
+    remove( inR->deltaTempPath );
+
+    addBackupWriteJob( job );
+    }
+
+
+
+// copies dirty records into chunks for writer, until out of time
+// returns true if time ran out
+static char stepBackupDelta( IncrementalBackupDB *inR, double inEndTime ) {
+    LINEARDB3 *db = inR->db;
+
+    int entryBytes = 4 + db->keySize + db->valueSize;
+
+    int maxEntries = INCREMENTAL_BACKUP_CHUNK_BYTES / entryBytes;
+
+    if( maxEntries < 1 ) {
+        maxEntries = 1;
+        }
+
+    while( inR->nextToCapture < inR->numToCapture ) {
+
+        if( Time::getCurrentTime() >= inEndTime ) {
+            return true;
+            }
+
+        int numEntries = inR->numToCapture - inR->nextToCapture;
+
+        if( numEntries > maxEntries ) {
+            numEntries = maxEntries;
+            }
+
+        BackupWriteJob job =
+            makeBackupWriteJob( stringDuplicate( inR->deltaTempPath ), NULL );
+
+        job.dataLength = numEntries * entryBytes;
+        job.data = new unsigned char[ job.dataLength ];
+
+        for( int i=0; i<numEntries; i++ ) {
+            unsigned char *entry = &( job.data[ i * entryBytes ] );
+
+            uint32_t recordNumber =
+                inR->captureList[ inR->nextToCapture + i ];
+
+            memcpy( entry, &recordNumber, 4 );
+
+            if( LINEARDB3_getRecord( db, recordNumber,
+                                     &( entry[4] ),
+                                     &( entry[ 4 + db->keySize ] ) ) != 0 ) {
+
+                AppLog::errorF( "Failed to read record %u from %s.db "
+                                "for delta backup, starting a new base",
+                                recordNumber, inR->prefix );
+                delete [] job.data;
+                delete [] job.tempPath;
+
+                stopCapture( inR );
+                inR->needsBase = true;
+                return false;
+                }
+            }
+
+        inR->nextToCapture += numEntries;
+
+        addBackupWriteJob( job );
+        }
+
+    // all records captured
+    addBackupWriteJob(
+        makeBackupWriteJob( stringDuplicate( inR->deltaTempPath ),
+                            stringDuplicate( inR->deltaFinalPath ) ) );
+
+    AppLog::infoF( "Saved %d changed records from %s.db to %s",
+                   inR->numToCapture, inR->prefix, inR->deltaFinalPath );
+
+    stopCapture( inR );
+    return false;
+    }
+
+
+
+static void stepIncrementalBackups() {
+    if( ! incrementalBackupsOn || incrementalDBs.size() == 0 ) {
+        return;
+        }
+
+    backupWriteLock.lock();
+
+    char failed = backupWriteFailed;
+    backupWriteFailed = false;
+
+    uint64_t pendingBytes = pendingWriteBytes;
+
+    backupWriteLock.unlock();
+
+    if( failed ) {
+        // can't tell which chain lost a file, so restart them all
+        AppLog::error( "Failed to write a background backup file, "
+                       "starting new base backups" );
+
+        for( int i=0; i<incrementalDBs.size(); i++ ) {
+            incrementalDBs.getElement( i )->needsBase = true;
+            }
+        }
+
+
+    File backupFolder( NULL, "backups" );
+
+    if( ! backupFolder.exists() ) {
+        Directory::makeDirectory( &backupFolder );
+        }
+
+
+    timeSec_t curTime = Time::timeSec();
+
+    char startDeltas = false;
+
+    if( curTime - lastDeltaTime >= incrementalBackupMinutes * 60 ||
+        curTime < lastDeltaTime ) {
+        startDeltas = true;
+        lastDeltaTime = curTime;
+        }
+
+    char *timeFileNamePart = getTimeFileNamePart( (time_t)curTime );
+
+    double endTime = Time::getCurrentTime() + INCREMENTAL_BACKUP_STEP_SECONDS;
+
+    for( int i=0; i<incrementalDBs.size(); i++ ) {
+        IncrementalBackupDB *r = incrementalDBs.getElement( i );
+
+        if( r->needsBase ) {
+            startBackupChain( r, timeFileNamePart );
+            }
+        else if( startDeltas ) {
+            startBackupDelta( r, timeFileNamePart );
+            }
+
+        if( r->captureList != NULL &&
+            pendingBytes < INCREMENTAL_BACKUP_MAX_PENDING_BYTES ) {
+
+            if( stepBackupDelta( r, endTime ) ) {
+                // out of time, pick up here next step
+                break;
+                }
+            }
+        }
+
+    delete [] timeFileNamePart;
+    }
+
+
+
 // call with "map" or "eve" for example
 void backupDBFile( const char *inFileNamePrefix, char *inTimeFileNamePart,
                    File *inBackupFolder ) {
+
+    if( incrementalBackupsOn ) {
+        IncrementalBackupDB *r = getIncrementalBackupDB( inFileNamePrefix );
+
+        if( r != NULL ) {
+            // fresh base for this DB instead, saved in background
+            startBackupChain( r, inTimeFileNamePart );
+            return;
+            }
+        }
+
     char *fileName = autoSprintf( "%s.db", inFileNamePrefix );
     
     File dbFile( NULL, fileName );
@@ -71,6 +760,8 @@ void backupDBFile( const char *inFileNamePrefix, char *inTimeFileNamePart,
 // makes a new backup if needed
 // also handles deleting old backups
 void checkBackup() {
+    stepIncrementalBackups();
+
     timeSec_t curTime = Time::timeSec();
     
     if( curTime - lastBackupTime > 12 * 3600 
@@ -96,21 +787,18 @@ void checkBackup() {
             if( SettingsManager::getIntSetting( "saveBackups", 0 ) ) {
                 
                 AppLog::info( 
-                    "Saving a backup of map.db, mapTime.db, and biome.db "
-                    "floor.db, floorTime.db, playerStats.db, and eve.db ..." );
+                    "Saving a backup of mapTiles.db, mapContained.db, "
+                    "biome.db, playerStats.db, "
+                    "and eve.db ..." );
                 
                 char backupsSaved = false;
                 
+                // recent map changes may only be in journal
+                flushMapJournal();
+
                 // save a backup now
 
-                char *timeFileNamePart = 
-                    autoSprintf( "%d_%02d_%02d__%02d_%02d_%02d",
-                                 timeStruct.tm_year + 1900,
-                                 timeStruct.tm_mon + 1,
-                                 timeStruct.tm_mday,
-                                 timeStruct.tm_hour,
-                                 timeStruct.tm_min,
-                                 timeStruct.tm_sec );
+                char *timeFileNamePart = getTimeFileNamePart( curTimeT );
 
                 File backupFolder( NULL, "backups" );
                 
@@ -122,19 +810,16 @@ void checkBackup() {
                     
                     backupDBFile( "lookTime", timeFileNamePart, &backupFolder );
 
-                    backupDBFile( "map", timeFileNamePart, &backupFolder );
-                    
-                    backupDBFile( "mapTime", timeFileNamePart, &backupFolder );
+                    backupDBFile( "mapTiles", timeFileNamePart, 
+                                  &backupFolder );
+
+                    backupDBFile( "mapContained", timeFileNamePart, 
+                                  &backupFolder );
                     
                     backupDBFile( "biome", timeFileNamePart, &backupFolder );
                     
                     backupDBFile( "eve", timeFileNamePart, &backupFolder );
                     
-                    backupDBFile( "floor", timeFileNamePart, &backupFolder );
-                    
-                    backupDBFile( "floorTime", timeFileNamePart, 
-                                  &backupFolder );
-                    
                     backupDBFile( "playerStats", 
                                   timeFileNamePart, &backupFolder );
 
@@ -202,6 +887,8 @@ void checkBackup() {
                 // check if target hour has changed
                 targetHour = SettingsManager::getIntSetting( "backupHourUTC",
                                                              targetHour );
+
+                readIncrementalSettings();
                 }
             else {
                 // push ahead, so we don't keep cheking the saveBackups setting
@@ -214,4 +901,3 @@ void checkBackup() {
         }
     
     }
-
@@ -1,8 +1,35 @@
+#include "lineardb3.h"
 
 
 void initBackup();
 
 
+// waits for any backup files still being written in the background
+void freeBackup();
+
+
 // makes a new backup if needed
 // also handles deleting old backups
+//
+// with incrementalBackups.ini on, also copies changed records out of
+// DBs added with addIncrementalBackupDB a few at a time, handing them
+// to a background thread to write
 void checkBackup();
+
+
+
+// with incrementalBackups.ini on, inDB is backed up as a full base copy
+// (written in the background) followed by delta files holding only the
+// records that changed since the previous delta
+//
+// without it, inDB is copied whole at backupHourUTC like other DB files,
+// and its writes aren't tracked
+//
+// incrementalBackups.ini (and saveBackups.ini) are read once, in
+// initBackup, which must be called before this
+//
+// call with "mapTiles" for mapTiles.db, for example
+// inDB must stay open until removeIncrementalBackupDB is called
+void addIncrementalBackupDB( const char *inFileNamePrefix, LINEARDB3 *inDB );
+
+void removeIncrementalBackupDB( LINEARDB3 *inDB );
@@ -0,0 +1,310 @@
+#include "chunkWorkers.h"
+
+#include <stdlib.h>
+
+
+#include "minorGems/util/SettingsManager.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/formats/encodingUtils.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/BinarySemaphore.h"
+
+#include "minorGems/util/log/AppLog.h"
+
+
+
+#define MAX_CHUNK_WORKERS 32
+
+
+struct ChunkJob {
+        unsigned char *rawData;
+        int rawSize;
+
+        unsigned char *compressedData;
+        int compressedSize;
+
+        char started;
+        char done;
+
+        double addTime;
+    };
+
+
+
+// guards everything below, shared with worker threads
+static MutexLock chunkJobLock;
+
+// jobs not started yet, oldest first
+static SimpleVector<ChunkJob*> chunkJobQueue;
+
+static char stopChunkWorkers = false;
+
+
+// signaled when a job is added, or workers should stop
+// a worker that wakes to find more jobs waiting, or stops, signals it
+// again to wake another
+static BinarySemaphore chunkJobAddedSemaphore;
+
+// signaled by a worker when it finishes a job
+static BinarySemaphore chunkJobDoneSemaphore;
+
+
+// stats since last logChunkWorkerStats
+static int statJobs = 0;
+static int statMaxQueueDepth = 0;
+static double statTotalLatency = 0;
+static double statMaxLatency = 0;
+// jobs that main thread compressed itself because no worker got to them
+static int statJobsRunByMain = 0;
+// time main thread spent waiting for workers to finish jobs
+static double statMainWaitTime = 0;
+
+
+
+static void compressChunkJob( ChunkJob *inJob ) {
+    inJob->compressedData = zipCompress( inJob->rawData, inJob->rawSize,
+                                         &( inJob->compressedSize ) );
+
+    delete [] inJob->rawData;
+    inJob->rawData = NULL;
+    }
+
+
+
+// call with chunkJobLock locked
+static void recordJobDone( ChunkJob *inJob ) {
+    inJob->done = true;
+
+    double latency = Time::getCurrentTime() - inJob->addTime;
+
+    statJobs++;
+    statTotalLatency += latency;
+
+    if( latency > statMaxLatency ) {
+        statMaxLatency = latency;
+        }
+    }
+
+
+
+class ChunkWorkerThread : public Thread {
+    public:
+
+        ChunkWorkerThread() {
+            start();
+            }
+
+        ~ChunkWorkerThread() {
+            join();
+            }
+
+        virtual void run() {
+            while( true ) {
+                chunkJobLock.lock();
+
+                if( chunkJobQueue.size() == 0 ) {
+                    char stop = stopChunkWorkers;
+
+                    chunkJobLock.unlock();
+
+                    if( stop ) {
+                        // pass on to next worker
+                        chunkJobAddedSemaphore.signal();
+                        return;
+                        }
+
+                    chunkJobAddedSemaphore.wait();
+                    continue;
+                    }
+
+                ChunkJob *job = chunkJobQueue.getElementDirect( 0 );
+                chunkJobQueue.deleteElement( 0 );
+
+                job->started = true;
+
+                char moreJobs = ( chunkJobQueue.size() > 0 );
+
+                chunkJobLock.unlock();
+
+                if( moreJobs ) {
+                    chunkJobAddedSemaphore.signal();
+                    }
+
+
+                compressChunkJob( job );
+
+
+                chunkJobLock.lock();
+
+                recordJobDone( job );
+
+                chunkJobLock.unlock();
+
+                chunkJobDoneSemaphore.signal();
+                }
+            }
+    };
+
+
+static ChunkWorkerThread *chunkWorkers[ MAX_CHUNK_WORKERS ];
+
+static int numChunkWorkers = 0;
+
+
+
+void initChunkWorkers() {
+    if( numChunkWorkers > 0 ) {
+        freeChunkWorkers();
+        }
+    
+    numChunkWorkers =
+        SettingsManager::getIntSetting( "chunkWorkerThreads", 2 );
+
+    if( numChunkWorkers < 0 ) {
+        numChunkWorkers = 0;
+        }
+    if( numChunkWorkers > MAX_CHUNK_WORKERS ) {
+        numChunkWorkers = MAX_CHUNK_WORKERS;
+        }
+
+    stopChunkWorkers = false;
+
+    for( int i=0; i<numChunkWorkers; i++ ) {
+        chunkWorkers[i] = new ChunkWorkerThread();
+        }
+
+    AppLog::infoF( "Compressing map chunks on %d worker threads",
+                   numChunkWorkers );
+    }
+
+
+
+void freeChunkWorkers() {
+    // workers only stop once queue is empty
+    chunkJobLock.lock();
+    stopChunkWorkers = true;
+    chunkJobLock.unlock();
+
+    chunkJobAddedSemaphore.signal();
+
+    for( int i=0; i<numChunkWorkers; i++ ) {
+        delete chunkWorkers[i];
+        }
+    numChunkWorkers = 0;
+
+    stopChunkWorkers = false;
+
+    logChunkWorkerStats();
+    }
+
+
+
+ChunkJob *addChunkJob( unsigned char *inRawData, int inRawSize ) {
+    ChunkJob *job = new ChunkJob;
+
+    job->rawData = inRawData;
+    job->rawSize = inRawSize;
+    job->compressedData = NULL;
+    job->compressedSize = 0;
+    job->started = false;
+    job->done = false;
+    job->addTime = Time::getCurrentTime();
+
+    if( numChunkWorkers == 0 ) {
+        job->started = true;
+        compressChunkJob( job );
+        recordJobDone( job );
+        return job;
+        }
+
+    chunkJobLock.lock();
+
+    chunkJobQueue.push_back( job );
+
+    if( chunkJobQueue.size() > statMaxQueueDepth ) {
+        statMaxQueueDepth = chunkJobQueue.size();
+        }
+
+    chunkJobLock.unlock();
+
+    chunkJobAddedSemaphore.signal();
+
+    return job;
+    }
+
+
+
+unsigned char *finishChunkJob( ChunkJob *inJob, int *outCompressedSize ) {
+
+    chunkJobLock.lock();
+
+    if( ! inJob->started ) {
+        // no worker has it yet, faster to do it ourselves than to wait
+        // for the jobs ahead of it
+        chunkJobQueue.deleteElementEqualTo( inJob );
+        inJob->started = true;
+
+        chunkJobLock.unlock();
+
+        compressChunkJob( inJob );
+
+        chunkJobLock.lock();
+
+        recordJobDone( inJob );
+        statJobsRunByMain++;
+        }
+    else if( ! inJob->done ) {
+        double startTime = Time::getCurrentTime();
+
+        while( ! inJob->done ) {
+            chunkJobLock.unlock();
+
+            // may wake for another job finishing, so check again
+            chunkJobDoneSemaphore.wait();
+
+            chunkJobLock.lock();
+            }
+
+        statMainWaitTime += Time::getCurrentTime() - startTime;
+        }
+
+    chunkJobLock.unlock();
+
+
+    unsigned char *data = inJob->compressedData;
+    *outCompressedSize = inJob->compressedSize;
+
+    delete inJob;
+
+    return data;
+    }
+
+
+
+void logChunkWorkerStats() {
+    chunkJobLock.lock();
+
+    double aveLatency = 0;
+
+    if( statJobs > 0 ) {
+        aveLatency = statTotalLatency / statJobs;
+        }
+
+    AppLog::infoF( "chunkWorkers: %d jobs, max queue depth %d, "
+                   "latency %.2f ms average, %.2f ms max, "
+                   "%d run on main thread, %.2f ms main thread waiting",
+                   statJobs, statMaxQueueDepth,
+                   aveLatency * 1000, statMaxLatency * 1000,
+                   statJobsRunByMain, statMainWaitTime * 1000 );
+
+    statJobs = 0;
+    statMaxQueueDepth = chunkJobQueue.size();
+    statTotalLatency = 0;
+    statMaxLatency = 0;
+    statJobsRunByMain = 0;
+    statMainWaitTime = 0;
+
+    chunkJobLock.unlock();
+    }
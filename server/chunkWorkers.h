@@ -0,0 +1,39 @@
+
+
+// Worker threads that compress map chunk data off of the main thread
+//
+// Cells for a chunk are read from the map on the main thread, since map
+// reads can apply decays and share caches.  The raw cell data is then
+// handed to a worker to be zipped, while the main thread goes on reading
+// other chunks and sending other messages.
+//
+// chunkWorkerThreads.ini sets the number of workers.  With 0, jobs are
+// compressed right away on the main thread.
+
+
+void initChunkWorkers();
+
+// finishes any jobs left, and stops workers
+void freeChunkWorkers();
+
+
+
+typedef struct ChunkJob ChunkJob;
+
+
+// takes ownership of inRawData
+ChunkJob *addChunkJob( unsigned char *inRawData, int inRawSize );
+
+
+// waits for job to be done, returns compressed data, destroyed by caller
+//
+// if no worker has started the job yet, it is compressed here instead
+// of waiting
+//
+// job is destroyed
+unsigned char *finishChunkJob( ChunkJob *inJob, int *outCompressedSize );
+
+
+
+// logs queue depth and job latencies since last call, and resets them
+void logChunkWorkerStats();
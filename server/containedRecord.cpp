@@ -0,0 +1,195 @@
+#include "containedRecord.h"
+#include "dbCommon.h"
+
+#include <string.h>
+
+
+
+ContainedLevel *getContainedLevel( ContainedTree *inTree, int inLevel ) {
+    while( inTree->levels.size() <= inLevel ) {
+        ContainedLevel l;
+        l.noDecayFlag = -1;
+        inTree->levels.push_back( l );
+        }
+    return inTree->levels.getElement( inLevel );
+    }
+
+
+
+void resizeContainedLevel( ContainedLevel *inLevel, int inNumSlots ) {
+    if( inNumSlots < 0 ) {
+        inNumSlots = 0;
+        }
+    
+    int oldNum = inLevel->ids.size();
+    
+    if( inNumSlots < oldNum ) {
+        inLevel->ids.shrink( inNumSlots );
+        inLevel->etas.shrink( inNumSlots );
+        }
+    
+    for( int i=oldNum; i<inNumSlots; i++ ) {
+        inLevel->ids.push_back( 0 );
+        inLevel->etas.push_back( 0 );
+        }
+    }
+
+
+
+char isContainedTreeEmpty( ContainedTree *inTree ) {
+    for( int b=0; b<inTree->levels.size(); b++ ) {
+        ContainedLevel *l = inTree->levels.getElement( b );
+        
+        if( l->ids.size() > 0 || l->noDecayFlag != -1 ) {
+            return false;
+            }
+        }
+    return true;
+    }
+
+
+
+// encoded tree:
+// int numLevels
+// then for each level:
+//    int numSlots
+//    int noDecayFlag
+//    numSlots ints, ids
+//    numSlots 8-byte times, etas
+static int getEncodedLength( ContainedTree *inTree ) {
+    int length = 4;
+    
+    for( int b=0; b<inTree->levels.size(); b++ ) {
+        length += 8 + 12 * inTree->levels.getElement( b )->ids.size();
+        }
+    return length;
+    }
+
+
+
+unsigned char *encodeContainedRecord( ContainedTree *inTree, 
+                                      int *outNumPages ) {
+    int length = getEncodedLength( inTree );
+    
+    // room for length header on page 0
+    int numPages = 
+        ( 4 + length + CONTAINED_RECORD_PAGE_BYTES - 1 ) / 
+        CONTAINED_RECORD_PAGE_BYTES;
+    
+    int numBytes = numPages * CONTAINED_RECORD_PAGE_BYTES;
+
+    unsigned char *pages = new unsigned char[ numBytes ];
+    
+    memset( pages, 0, numBytes );
+    
+    unsigned char *p = pages;
+    
+    intToValue( length, p );
+    p += 4;
+    
+    intToValue( inTree->levels.size(), p );
+    p += 4;
+    
+    for( int b=0; b<inTree->levels.size(); b++ ) {
+        ContainedLevel *l = inTree->levels.getElement( b );
+
+        int num = l->ids.size();
+        
+        intToValue( num, p );
+        p += 4;
+        
+        intToValue( l->noDecayFlag, p );
+        p += 4;
+        
+        for( int i=0; i<num; i++ ) {
+            intToValue( l->ids.getElementDirect( i ), p );
+            p += 4;
+            }
+        for( int i=0; i<num; i++ ) {
+            timeToValue( l->etas.getElementDirect( i ), p );
+            p += 8;
+            }
+        }
+    
+    *outNumPages = numPages;
+    
+    return pages;
+    }
+
+
+
+int getContainedRecordNumPages( unsigned char *inFirstPage ) {
+    int length = valueToInt( inFirstPage );
+    
+    if( length < 0 ) {
+        return 1;
+        }
+    
+    return 
+        ( 4 + length + CONTAINED_RECORD_PAGE_BYTES - 1 ) / 
+        CONTAINED_RECORD_PAGE_BYTES;
+    }
+
+
+
+ContainedTree *decodeContainedRecord( unsigned char *inPages, 
+                                      int inNumPages ) {
+    
+    unsigned char *end = 
+        &( inPages[ inNumPages * CONTAINED_RECORD_PAGE_BYTES ] );
+    
+    int length = valueToInt( inPages );
+    
+    unsigned char *p = &( inPages[4] );
+    
+    if( length < 4 || p + length > end ) {
+        return NULL;
+        }
+    
+    end = p + length;
+    
+    int numLevels = valueToInt( p );
+    p += 4;
+    
+    ContainedTree *tree = new ContainedTree;
+    
+    for( int b=0; b<numLevels; b++ ) {
+        if( p + 8 > end ) {
+            delete tree;
+            return NULL;
+            }
+        
+        int num = valueToInt( p );
+        p += 4;
+        
+        ContainedLevel *l = getContainedLevel( tree, b );
+        
+        l->noDecayFlag = valueToInt( p );
+        p += 4;
+        
+        if( num < 0 || p + 12 * num > end ) {
+            delete tree;
+            return NULL;
+            }
+        
+        for( int i=0; i<num; i++ ) {
+            l->ids.push_back( valueToInt( p ) );
+            p += 4;
+            }
+        for( int i=0; i<num; i++ ) {
+            l->etas.push_back( valueToTime( p ) );
+            p += 8;
+            }
+        }
+    
+    return tree;
+    }
+
+
+
+void containedRecordKey( int inX, int inY, int inPage, 
+                         unsigned char *outKey ) {
+    intToValue( inX, &( outKey[0] ) );
+    intToValue( inY, &( outKey[4] ) );
+    intToValue( inPage, &( outKey[8] ) );
+    }
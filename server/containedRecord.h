@@ -0,0 +1,91 @@
+#ifndef CONTAINED_RECORD_H_INCLUDED
+#define CONTAINED_RECORD_H_INCLUDED
+
+
+#include "minorGems/system/Time.h"
+#include "minorGems/util/SimpleVector.h"
+
+
+
+// Storage format for a map cell's whole container tree (contained IDs,
+// sub-contained IDs, and their decay ETAs) as one variable-length record
+// in mapContained.db, instead of one record per slot in map.db and
+// mapTime.db.
+//
+// The record is split into fixed-size pages, because our DBs only support
+// fixed-size values.  Page p of the record at x,y is stored under key
+// x,y,p (three 32-bit ints).  Nearly all containers fit in page 0, so
+// reading a cell's whole tree is a single DB_get.
+//
+// Page 0 starts with a 32-bit byte length of the encoded tree that follows.
+// Pages past the end of that length are stale and ignored.
+#define CONTAINED_RECORD_PAGE_BYTES 256
+
+#define CONTAINED_RECORD_KEY_BYTES 12
+
+
+
+typedef struct ContainedLevel {
+        // -1 if never set
+        // 0 if none of the slots have ETA decay
+        // 1 if some of the slots might have ETA decay
+        int noDecayFlag;
+        
+        // negative IDs sub-contain the objects in level (slot + 1)
+        SimpleVector<int> ids;
+
+        // same length as ids, 0 for no decay
+        SimpleVector<timeSec_t> etas;
+    } ContainedLevel;
+
+
+
+// level 0 is the main container at x,y
+// level b > 0 is the sub-container in slot b-1 of level 0
+typedef struct ContainedTree {
+        SimpleVector<ContainedLevel> levels;
+    } ContainedTree;
+
+
+
+// makes sure inTree has a level inLevel, adding empty levels as needed
+// returns pointer to level, which is valid until levels are added again
+ContainedLevel *getContainedLevel( ContainedTree *inTree, int inLevel );
+
+
+// sets number of slots in level, truncating or adding 0-ID slots with
+// 0 ETAs
+void resizeContainedLevel( ContainedLevel *inLevel, int inNumSlots );
+
+
+// true if tree has no contained objects and no flags set, and thus
+// doesn't need to be stored at all
+char isContainedTreeEmpty( ContainedTree *inTree );
+
+
+
+// encodes tree into a whole number of pages, ready to be stored
+// under keys x,y,0 through x,y,(outNumPages - 1)
+// result destroyed by caller
+unsigned char *encodeContainedRecord( ContainedTree *inTree, 
+                                      int *outNumPages );
+
+
+// gets number of pages in a stored record, given its page 0
+int getContainedRecordNumPages( unsigned char *inFirstPage );
+
+
+// decodes a record from inNumPages pages laid end to end in inPages
+// returns NULL if record is corrupt
+// result destroyed by caller
+ContainedTree *decodeContainedRecord( unsigned char *inPages, 
+                                      int inNumPages );
+
+
+
+// packs x,y,page into a CONTAINED_RECORD_KEY_BYTES key
+void containedRecordKey( int inX, int inY, int inPage, 
+                         unsigned char *outKey );
+
+
+#endif
@@ -0,0 +1 @@
+./dbConvertContainers
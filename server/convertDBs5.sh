@@ -0,0 +1 @@
+./dbConvertTiles
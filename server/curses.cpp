@@ -10,7 +10,7 @@
 #include "minorGems/system/Time.h"
 
 
-#include "minorGems/network/web/WebRequest.h"
+#include "asyncWeb.h"
 #include "minorGems/network/web/URLUtils.h"
 
 #include "minorGems/crypto/hashes/sha1.h"
@@ -53,7 +53,7 @@ typedef struct RemoteUpdateRecord {
 
         // -1 if not fetched from server yet
         int sequenceNumber;
-        WebRequest *request;
+        AsyncWebRequest *request;
     } RemoteUpdateRecord;
 
     
@@ -68,7 +68,7 @@ typedef struct RemoteCurseRecord {
         
         int excessCursePoints;
         
-        WebRequest *request;
+        AsyncWebRequest *request;
     } RemoteCurseRecord;
     
 
@@ -662,7 +662,7 @@ CurseStatus getCurseLevel( char *inPlayerEmail ) {
         delete [] encodedEmail;
         delete [] hash;
 
-        r.request = new WebRequest( "GET", url, NULL );
+        r.request = new AsyncWebRequest( "GET", url, NULL );
         printf( "Starting new web request for %s\n", url );
                     
         delete [] url;
@@ -748,7 +748,7 @@ void stepCurseServerRequests() {
                     
             delete [] encodedEmail;
 
-            r->request = new WebRequest( "GET", url, NULL );
+            r->request = new AsyncWebRequest( "GET", url, NULL );
             printf( "Starting new web request for %s\n", url );
             
             delete [] url;
@@ -822,7 +822,7 @@ void stepCurseServerRequests() {
                 delete [] encodedEmail;
                 delete [] hash;
 
-                r->request = new WebRequest( "GET", url, NULL );
+                r->request = new AsyncWebRequest( "GET", url, NULL );
                 printf( "Starting new web request for %s\n", url );
                     
                 delete [] url;
@@ -1,6 +1,7 @@
 #include "dbCommon.h"
 
 #include <string.h>
+#include <stdint.h>
 
 
 
@@ -31,3 +32,37 @@ void emailToKey( const char *inEmail, unsigned char *outKey ) {
     
     memcpy( outKey, inEmail, len );
     }
+
+
+
+// one timeSec_t to an 8-byte double value
+void timeToValue( timeSec_t inT, unsigned char *outValue ) {
+    
+
+    // pack double time into 8 bytes in whatever endian order the
+    // double is stored on this platform
+
+    union{ timeSec_t doubleTime; uint64_t intTime; };
+
+    doubleTime = inT;
+    
+    for( int i=0; i<8; i++ ) {
+        outValue[i] = ( intTime >> (i * 8) ) & 0xFF;
+        }    
+    }
+
+
+timeSec_t valueToTime( unsigned char *inValue ) {
+
+    union{ timeSec_t doubleTime; uint64_t intTime; };
+
+    // get bytes back out in same order they were put in
+    intTime = 
+        (uint64_t)inValue[7] << 56 | (uint64_t)inValue[6] << 48 | 
+        (uint64_t)inValue[5] << 40 | (uint64_t)inValue[4] << 32 | 
+        (uint64_t)inValue[3] << 24 | (uint64_t)inValue[2] << 16 | 
+        (uint64_t)inValue[1] << 8  | (uint64_t)inValue[0];
+    
+    // caste back to timeSec_t
+    return doubleTime;
+    }
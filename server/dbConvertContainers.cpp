@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#include "minorGems/util/SimpleVector.h"
+
+#include "lineardb3.h"
+#include "dbCommon.h"
+#include "containedRecord.h"
+
+
+
+// Moves containers out of the old one-record-per-slot layout in map.db
+// and mapTime.db and into mapContained.db, one record per x,y.
+//
+// Must be run in the server folder while the server is stopped.
+//
+// map.db and mapTime.db are rewritten without their container slots.
+
+
+// these must match the slot numbers used in map.cpp
+#define DECAY_SLOT 1
+#define NUM_CONT_SLOT 2
+#define FIRST_CONT_SLOT 3
+#define NO_DECAY_SLOT -1
+
+
+
+void usage() {
+    printf( "Usage:\n" );
+    printf( "dbConvertContainers\n\n" );
+
+    printf( "Run in server folder, with map.db and mapTime.db present.\n\n" );
+
+    exit( 1 );
+    }
+
+
+
+// four ints to a 16-byte key
+void intQuadToKey( int inX, int inY, int inSlot, int inB,
+                   unsigned char *outKey ) {
+    for( int i=0; i<4; i++ ) {
+        int offset = i * 8;
+        outKey[i] = ( inX >> offset ) & 0xFF;
+        outKey[i+4] = ( inY >> offset ) & 0xFF;
+        outKey[i+8] = ( inSlot >> offset ) & 0xFF;
+        outKey[i+12] = ( inB >> offset ) & 0xFF;
+        }
+    }
+
+
+
+static LINEARDB3 mapDB;
+static LINEARDB3 mapTimeDB;
+
+
+
+// returns -1 if not found
+static int slotGet( int inX, int inY, int inSlot, int inB ) {
+    unsigned char key[16];
+    unsigned char value[4];
+
+    intQuadToKey( inX, inY, inSlot, inB, key );
+
+    if( LINEARDB3_get( &mapDB, key, value ) == 0 ) {
+        return valueToInt( value );
+        }
+    return -1;
+    }
+
+
+
+// returns 0 if not found
+static timeSec_t slotTimeGet( int inX, int inY, int inSlot, int inB ) {
+    unsigned char key[16];
+    unsigned char value[8];
+
+    intQuadToKey( inX, inY, inSlot, inB, key );
+
+    if( LINEARDB3_get( &mapTimeDB, key, value ) == 0 ) {
+        return valueToTime( value );
+        }
+    return 0;
+    }
+
+
+
+// fills one level of tree from old slots
+// returns number of slots in level
+static int readLevel( int inX, int inY, int inB, ContainedTree *inTree ) {
+    int num = slotGet( inX, inY, NUM_CONT_SLOT, inB );
+
+    if( num < 0 ) {
+        num = 0;
+        }
+
+    ContainedLevel *l = getContainedLevel( inTree, inB );
+
+    l->noDecayFlag = slotGet( inX, inY, NO_DECAY_SLOT, inB );
+
+    for( int i=0; i<num; i++ ) {
+        int id = slotGet( inX, inY, FIRST_CONT_SLOT + i, inB );
+
+        if( id == -1 ) {
+            id = 0;
+            }
+
+        l->ids.push_back( id );
+
+        // decay slots follow contained slots
+        l->etas.push_back(
+            slotTimeGet( inX, inY, FIRST_CONT_SLOT + num + i, inB ) );
+        }
+
+    return num;
+    }
+
+
+
+// copies all records except container slots into a temp file, then
+// replaces inFileName with it
+// closes inDB
+static char rewriteWithoutContainers( LINEARDB3 *inDB, 
+                                      const char *inFileName,
+                                      unsigned int inKeySize, 
+                                      unsigned int inValueSize,
+                                      int *outNumKept, int *outNumDropped ) {
+
+    char tempFileName[1000];
+
+    sprintf( tempFileName, "%s.temp", inFileName );
+
+    remove( tempFileName );
+
+    unsigned char *keyBuff = new unsigned char[ inKeySize ];
+    unsigned char *valueBuff = new unsigned char[ inValueSize ];
+
+    LINEARDB3_Iterator dbi;
+
+    // count first so temp db starts at right size
+    int numKept = 0;
+    int numDropped = 0;
+
+    LINEARDB3_Iterator_init( inDB, &dbi );
+
+    while( LINEARDB3_Iterator_next( &dbi, keyBuff, valueBuff ) > 0 ) {
+        int s = valueToInt( &( keyBuff[8] ) );
+        int b = valueToInt( &( keyBuff[12] ) );
+
+        if( s >= 0 && s < NUM_CONT_SLOT && b == 0 ) {
+            numKept++;
+            }
+        else {
+            numDropped++;
+            }
+        }
+
+    LINEARDB3 dbNew;
+
+    int error = LINEARDB3_open( &dbNew,
+                                tempFileName,
+                                0,
+                                LINEARDB3_getShrinkSize( inDB, numKept ),
+                                inKeySize,
+                                inValueSize );
+    if( error ) {
+        printf( "dbConvertContainers: Failed to open %s\n", tempFileName );
+        delete [] keyBuff;
+        delete [] valueBuff;
+        return false;
+        }
+
+    LINEARDB3_Iterator_init( inDB, &dbi );
+
+    while( LINEARDB3_Iterator_next( &dbi, keyBuff, valueBuff ) > 0 ) {
+        int s = valueToInt( &( keyBuff[8] ) );
+        int b = valueToInt( &( keyBuff[12] ) );
+
+        if( s >= 0 && s < NUM_CONT_SLOT && b == 0 ) {
+            LINEARDB3_put( &dbNew, keyBuff, valueBuff );
+            }
+        }
+
+    LINEARDB3_close( &dbNew );
+    LINEARDB3_close( inDB );
+
+    delete [] keyBuff;
+    delete [] valueBuff;
+
+    if( rename( tempFileName, inFileName ) != 0 ) {
+        printf( "dbConvertContainers: Failed to move temp file %s to "
+                "%s\n", tempFileName, inFileName );
+        return false;
+        }
+
+    *outNumKept = numKept;
+    *outNumDropped = numDropped;
+
+    return true;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    if( inNumArgs != 1 ) {
+        usage();
+        }
+
+    FILE *contFile = fopen( "mapContained.db", "rb" );
+
+    if( contFile != NULL ) {
+        fclose( contFile );
+        printf( "dbConvertContainers: mapContained.db already exists, "
+                "map has already been converted\n" );
+        exit( 1 );
+        }
+
+    LINEARDB3_setMaxLoad( 0.80 );
+
+    int error = LINEARDB3_open( &mapDB, "map.db", 0, 80000, 16, 4 );
+
+    if( error ) {
+        printf( "dbConvertContainers: Failed to open map.db\n" );
+        exit( 1 );
+        }
+
+    error = LINEARDB3_open( &mapTimeDB, "mapTime.db", 0, 80000, 16, 8 );
+
+    if( error ) {
+        printf( "dbConvertContainers: Failed to open mapTime.db\n" );
+        LINEARDB3_close( &mapDB );
+        exit( 1 );
+        }
+
+
+    // find all top-level containers
+    SimpleVector<int> xCont;
+    SimpleVector<int> yCont;
+
+    unsigned char key[16];
+    unsigned char value[4];
+
+    LINEARDB3_Iterator dbi;
+    LINEARDB3_Iterator_init( &mapDB, &dbi );
+
+    while( LINEARDB3_Iterator_next( &dbi, key, value ) > 0 ) {
+        int s = valueToInt( &( key[8] ) );
+        int b = valueToInt( &( key[12] ) );
+
+        if( s == NUM_CONT_SLOT && b == 0 && valueToInt( value ) > 0 ) {
+            xCont.push_back( valueToInt( key ) );
+            yCont.push_back( valueToInt( &( key[4] ) ) );
+            }
+        }
+
+    printf( "Found %d containers in map.db\n", xCont.size() );
+
+
+    LINEARDB3 contDB;
+
+    // left over from an earlier run that failed part way
+    remove( "mapContained.db.temp" );
+
+    error = LINEARDB3_open( &contDB, "mapContained.db.temp", 0,
+                            LINEARDB3_getPerfectTableSize( 0.80,
+                                                           xCont.size() ),
+                            CONTAINED_RECORD_KEY_BYTES,
+                            CONTAINED_RECORD_PAGE_BYTES );
+    if( error ) {
+        printf( "dbConvertContainers: Failed to open mapContained.db.temp\n" );
+        LINEARDB3_close( &mapDB );
+        LINEARDB3_close( &mapTimeDB );
+        exit( 1 );
+        }
+
+    int numSubContainers = 0;
+    int numPagesWritten = 0;
+
+    for( int i=0; i<xCont.size(); i++ ) {
+        int x = xCont.getElementDirect( i );
+        int y = yCont.getElementDirect( i );
+
+        ContainedTree tree;
+
+        int num = readLevel( x, y, 0, &tree );
+
+        for( int c=0; c<num; c++ ) {
+            if( tree.levels.getElement( 0 )->ids.getElementDirect( c ) < 0 ) {
+                readLevel( x, y, c + 1, &tree );
+                numSubContainers++;
+                }
+            }
+
+        int numPages;
+        unsigned char *pages = encodeContainedRecord( &tree, &numPages );
+
+        unsigned char contKey[ CONTAINED_RECORD_KEY_BYTES ];
+
+        for( int p=0; p<numPages; p++ ) {
+            containedRecordKey( x, y, p, contKey );
+
+            LINEARDB3_put( &contDB, contKey,
+                           &( pages[ p * CONTAINED_RECORD_PAGE_BYTES ] ) );
+            }
+        numPagesWritten += numPages;
+
+        delete [] pages;
+        }
+
+    LINEARDB3_close( &contDB );
+
+    printf( "Wrote %d containers (%d sub-containers) in %d pages to "
+            "mapContained.db\n",
+            xCont.size(), numSubContainers, numPagesWritten );
+
+    // only present once all containers have been written
+    // server refuses to start with a map.db but no mapContained.db
+    if( rename( "mapContained.db.temp", "mapContained.db" ) != 0 ) {
+        printf( "dbConvertContainers: Failed to move temp file "
+                "mapContained.db.temp to mapContained.db\n" );
+        LINEARDB3_close( &mapDB );
+        LINEARDB3_close( &mapTimeDB );
+        exit( 1 );
+        }
+
+    // old container slots are ignored by the server from here on, so it's
+    // safe to stop at any point below and leave them in place
+
+
+    int numKept, numDropped;
+
+    if( ! rewriteWithoutContainers( &mapDB, "map.db", 16, 4,
+                                    &numKept, &numDropped ) ) {
+        LINEARDB3_close( &mapTimeDB );
+        exit( 1 );
+        }
+    printf( "Kept %d records in map.db, dropped %d container slots\n",
+            numKept, numDropped );
+
+    if( ! rewriteWithoutContainers( &mapTimeDB, "mapTime.db", 16, 8,
+                                    &numKept, &numDropped ) ) {
+        exit( 1 );
+        }
+    printf( "Kept %d records in mapTime.db, dropped %d container slots\n",
+            numKept, numDropped );
+
+
+    printf( "Done\n" );
+
+    return 0;
+    }
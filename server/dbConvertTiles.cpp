@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#include "lineardb3.h"
+#include "dbCommon.h"
+#include "containedRecord.h"
+#include "mapTile.h"
+
+
+
+// Moves base objects, floors, and their decay ETAs out of the old
+// one-record-per-cell layout in map.db, mapTime.db, floor.db, and
+// floorTime.db and into mapTiles.db, one record per tile of cells.
+//
+// Must be run in the server folder while the server is stopped, after
+// dbConvertContainers.
+//
+// The old DB files are left in place, renamed with a .preTiles suffix.
+
+
+// these must match the slot numbers used in map.cpp
+#define DECAY_SLOT 1
+
+
+
+void usage() {
+    printf( "Usage:\n" );
+    printf( "dbConvertTiles\n\n" );
+
+    printf( "Run in server folder, with map.db, mapTime.db, floor.db, "
+            "floorTime.db, and mapContained.db present.\n\n" );
+
+    exit( 1 );
+    }
+
+
+
+static LINEARDB3 tileDB;
+
+
+// last tile touched, because neighboring records often land in the
+// same tile
+static MapTile tile;
+static char tileLoaded = false;
+
+
+
+static void storeTile() {
+    if( ! tileLoaded ) {
+        return;
+        }
+
+    unsigned char key[ MAP_TILE_KEY_BYTES ];
+    unsigned char value[ MAP_TILE_BYTES ];
+
+    mapTileKey( tile.originX, tile.originY, key );
+    encodeMapTile( &tile, value );
+
+    LINEARDB3_put( &tileDB, key, value );
+    }
+
+
+
+// returns cell index of x,y in loaded tile
+static int loadTile( int inX, int inY ) {
+    int originX = getMapTileOrigin( inX );
+    int originY = getMapTileOrigin( inY );
+
+    if( ! tileLoaded ||
+        tile.originX != originX || tile.originY != originY ) {
+
+        storeTile();
+
+        unsigned char key[ MAP_TILE_KEY_BYTES ];
+        unsigned char value[ MAP_TILE_BYTES ];
+
+        mapTileKey( inX, inY, key );
+
+        if( LINEARDB3_get( &tileDB, key, value ) == 0 ) {
+            decodeMapTile( value, inX, inY, &tile );
+            }
+        else {
+            clearMapTile( &tile, inX, inY );
+            }
+        tileLoaded = true;
+        }
+
+    return getMapTileCellIndex( inX, inY );
+    }
+
+
+
+// returns number of cells copied, or -1 on failure
+static int copyCells( const char *inFileName,
+                      unsigned int inKeySize, unsigned int inValueSize ) {
+
+    LINEARDB3 oldDB;
+
+    int error = LINEARDB3_open( &oldDB, inFileName, 0, 80000,
+                                inKeySize, inValueSize );
+
+    if( error ) {
+        printf( "dbConvertTiles: Failed to open %s\n", inFileName );
+        return -1;
+        }
+
+    unsigned char *key = new unsigned char[ inKeySize ];
+    unsigned char *value = new unsigned char[ inValueSize ];
+
+    int numCopied = 0;
+
+    LINEARDB3_Iterator dbi;
+    LINEARDB3_Iterator_init( &oldDB, &dbi );
+
+    while( LINEARDB3_Iterator_next( &dbi, key, value ) > 0 ) {
+        int x = valueToInt( key );
+        int y = valueToInt( &( key[4] ) );
+
+        if( inKeySize == 16 ) {
+            // map.db or mapTime.db, xysb
+            int s = valueToInt( &( key[8] ) );
+            int b = valueToInt( &( key[12] ) );
+
+            if( b != 0 ) {
+                continue;
+                }
+
+            if( inValueSize == 4 && s == 0 ) {
+                tile.objects[ loadTile( x, y ) ] = valueToInt( value );
+                numCopied++;
+                }
+            else if( inValueSize == 8 && s == DECAY_SLOT ) {
+                tile.objectEtas[ loadTile( x, y ) ] = valueToTime( value );
+                numCopied++;
+                }
+            }
+        else if( inKeySize == 8 ) {
+            // floor.db or floorTime.db, xy
+            if( inValueSize == 4 ) {
+                tile.floors[ loadTile( x, y ) ] = valueToInt( value );
+                }
+            else {
+                tile.floorEtas[ loadTile( x, y ) ] = valueToTime( value );
+                }
+            numCopied++;
+            }
+        else if( inKeySize == CONTAINED_RECORD_KEY_BYTES ) {
+            // mapContained.db, xyp
+            int page = valueToInt( &( key[8] ) );
+
+            if( page == 0 ) {
+                tile.contained[ loadTile( x, y ) ] = true;
+                numCopied++;
+                }
+            }
+        }
+
+    LINEARDB3_close( &oldDB );
+
+    delete [] key;
+    delete [] value;
+
+    return numCopied;
+    }
+
+
+
+static const char *oldFileNames[4] = { "map.db", "mapTime.db",
+                                       "floor.db", "floorTime.db" };
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    if( inNumArgs != 1 ) {
+        usage();
+        }
+
+    FILE *f = fopen( "mapTiles.db", "rb" );
+
+    if( f != NULL ) {
+        fclose( f );
+        printf( "dbConvertTiles: mapTiles.db already exists, "
+                "map has already been converted\n" );
+        exit( 1 );
+        }
+
+    f = fopen( "mapContained.db", "rb" );
+
+    if( f == NULL ) {
+        printf( "dbConvertTiles: mapContained.db missing, "
+                "run dbConvertContainers first\n" );
+        exit( 1 );
+        }
+    fclose( f );
+
+
+    LINEARDB3_setMaxLoad( 0.80 );
+
+    // left over from an earlier run that failed part way
+    remove( "mapTiles.db.temp" );
+
+    int error = LINEARDB3_open( &tileDB, "mapTiles.db.temp", 0, 80000,
+                                MAP_TILE_KEY_BYTES, MAP_TILE_BYTES );
+
+    if( error ) {
+        printf( "dbConvertTiles: Failed to open mapTiles.db.temp\n" );
+        exit( 1 );
+        }
+
+    int numObjects = copyCells( "map.db", 16, 4 );
+    int numObjectEtas = copyCells( "mapTime.db", 16, 8 );
+    int numFloors = copyCells( "floor.db", 8, 4 );
+    int numFloorEtas = copyCells( "floorTime.db", 8, 8 );
+    int numContained = copyCells( "mapContained.db",
+                                  CONTAINED_RECORD_KEY_BYTES,
+                                  CONTAINED_RECORD_PAGE_BYTES );
+
+    storeTile();
+
+    int numTiles = LINEARDB3_getNumRecords( &tileDB );
+
+    LINEARDB3_close( &tileDB );
+
+    if( numObjects < 0 || numObjectEtas < 0 ||
+        numFloors < 0 || numFloorEtas < 0 || numContained < 0 ) {
+        remove( "mapTiles.db.temp" );
+        exit( 1 );
+        }
+
+    printf( "Wrote %d objects, %d object ETAs, %d floors, %d floor ETAs, "
+            "and %d container flags in %d tiles to mapTiles.db\n",
+            numObjects, numObjectEtas, numFloors, numFloorEtas,
+            numContained, numTiles );
+
+    // only present once all cells have been written
+    // server refuses to start with a map.db but no mapTiles.db
+    if( rename( "mapTiles.db.temp", "mapTiles.db" ) != 0 ) {
+        printf( "dbConvertTiles: Failed to move temp file "
+                "mapTiles.db.temp to mapTiles.db\n" );
+        exit( 1 );
+        }
+
+    // server ignores old files from here on
+    for( int i=0; i<4; i++ ) {
+        char newName[1000];
+
+        sprintf( newName, "%s.preTiles", oldFileNames[i] );
+
+        if( rename( oldFileNames[i], newName ) != 0 ) {
+            printf( "dbConvertTiles: Failed to move %s to %s\n",
+                    oldFileNames[i], newName );
+            }
+        }
+
+    printf( "Done\n" );
+
+    return 0;
+    }
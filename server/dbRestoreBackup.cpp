@@ -0,0 +1,345 @@
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+
+#include "lineardb3.h"
+
+
+
+// Rebuilds a DB from an incremental backup chain (see backup.cpp):
+// copies the base, then writes records from each of its delta files
+// over the copy, oldest first.
+//
+// With a time given, stops after the last delta saved at or before that
+// time.
+
+
+
+void usage() {
+    printf( "Usage:\n" );
+    printf( "dbRestoreBackup base_backup.db out.db [up_to_time]\n\n" );
+
+    printf( "Example:\n" );
+    printf( "dbRestoreBackup backups/mapTiles_2018_10_17__08_00_00.db "
+            "mapTiles.db 2018_10_17__13_30_00\n\n" );
+
+    printf( "Applies all deltas for the base if up_to_time is left off.\n"
+            "out.db must not exist already.\n\n" );
+
+    exit( 1 );
+    }
+
+
+
+static int compareNames( const void *inA, const void *inB ) {
+    return strcmp( *(char**)inA, *(char**)inB );
+    }
+
+
+
+static char copyFile( const char *inFromPath, const char *inToPath ) {
+    FILE *inFile = fopen( inFromPath, "rb" );
+
+    if( inFile == NULL ) {
+        return false;
+        }
+
+    FILE *outFile = fopen( inToPath, "wb" );
+
+    if( outFile == NULL ) {
+        fclose( inFile );
+        return false;
+        }
+
+    char ok = true;
+
+    unsigned char buffer[ 65536 ];
+
+    while( true ) {
+        size_t numRead = fread( buffer, 1, sizeof( buffer ), inFile );
+
+        if( numRead == 0 ) {
+            break;
+            }
+        if( fwrite( buffer, 1, numRead, outFile ) != numRead ) {
+            ok = false;
+            break;
+            }
+        }
+
+    fclose( inFile );
+
+    if( fclose( outFile ) != 0 ) {
+        ok = false;
+        }
+    return ok;
+    }
+
+
+
+// returns number of records written, or -1 on failure
+static int applyDelta( const char *inDeltaPath, FILE *inDBFile,
+                       uint32_t inKeySize, uint32_t inValueSize,
+                       uint32_t *outNumRecordsInDB ) {
+
+    FILE *deltaFile = fopen( inDeltaPath, "rb" );
+
+    if( deltaFile == NULL ) {
+        printf( "Failed to open %s\n", inDeltaPath );
+        return -1;
+        }
+
+    char magic[5];
+    uint32_t header[3];
+
+    magic[4] = '\0';
+
+    if( fread( magic, 4, 1, deltaFile ) != 1 ||
+        strcmp( magic, "Ld3d" ) != 0 ||
+        fread( header, sizeof( uint32_t ), 3, deltaFile ) != 3 ) {
+
+        printf( "%s is not a delta file\n", inDeltaPath );
+        fclose( deltaFile );
+        return -1;
+        }
+
+    if( header[0] != inKeySize || header[1] != inValueSize ) {
+        printf( "%s has key/value sizes %u/%u, but base has %u/%u\n",
+                inDeltaPath, header[0], header[1], inKeySize, inValueSize );
+        fclose( deltaFile );
+        return -1;
+        }
+
+    *outNumRecordsInDB = header[2];
+
+    uint32_t recordSize = inKeySize + inValueSize;
+
+    unsigned char *record = new unsigned char[ recordSize ];
+
+    int numWritten = 0;
+
+    while( true ) {
+        uint32_t recordNumber;
+
+        if( fread( &recordNumber, sizeof( uint32_t ), 1, deltaFile ) != 1 ) {
+            // end of delta
+            break;
+            }
+
+        if( fread( record, recordSize, 1, deltaFile ) != 1 ) {
+            printf( "%s ends partway through a record\n", inDeltaPath );
+            numWritten = -1;
+            break;
+            }
+
+        if( fseeko( inDBFile,
+                    LINEARDB3_getHeaderSize() +
+                    (uint64_t)recordNumber * recordSize,
+                    SEEK_SET ) != 0 ||
+            fwrite( record, recordSize, 1, inDBFile ) != 1 ) {
+
+            printf( "Failed to write record %u\n", recordNumber );
+            numWritten = -1;
+            break;
+            }
+
+        numWritten++;
+        }
+
+    delete [] record;
+    fclose( deltaFile );
+
+    return numWritten;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    if( inNumArgs != 3 && inNumArgs != 4 ) {
+        usage();
+        }
+
+    const char *basePath = inArgs[1];
+    const char *outPath = inArgs[2];
+
+    const char *upToTime = NULL;
+
+    if( inNumArgs == 4 ) {
+        upToTime = inArgs[3];
+        }
+
+
+    int baseLen = strlen( basePath );
+
+    if( baseLen < 4 || strcmp( &( basePath[ baseLen - 3 ] ), ".db" ) != 0 ) {
+        usage();
+        }
+
+    FILE *f = fopen( outPath, "rb" );
+
+    if( f != NULL ) {
+        fclose( f );
+        printf( "%s already exists, not overwriting it\n", outPath );
+        return 1;
+        }
+
+
+    // split base path into folder and chain name
+    char *folder = strdup( basePath );
+    const char *baseName = basePath;
+
+    char *slash = strrchr( folder, '/' );
+
+    if( slash != NULL ) {
+        *slash = '\0';
+        baseName = &( basePath[ slash - folder + 1 ] );
+        }
+    else {
+        free( folder );
+        folder = strdup( "." );
+        }
+
+    // deltas are named chain__time.delta
+    char deltaPrefix[1000];
+    snprintf( deltaPrefix, sizeof( deltaPrefix ), "%.*s__",
+              (int)strlen( baseName ) - 3, baseName );
+
+    int prefixLen = strlen( deltaPrefix );
+
+
+    DIR *dir = opendir( folder );
+
+    if( dir == NULL ) {
+        printf( "Failed to open folder %s\n", folder );
+        return 1;
+        }
+
+    int numDeltas = 0;
+    int maxDeltas = 64;
+    char **deltaNames = (char**)malloc( maxDeltas * sizeof( char* ) );
+
+    struct dirent *entry;
+
+    while( ( entry = readdir( dir ) ) != NULL ) {
+        const char *name = entry->d_name;
+        int nameLen = strlen( name );
+
+        if( strncmp( name, deltaPrefix, prefixLen ) != 0 ||
+            nameLen < prefixLen + 6 ||
+            strcmp( &( name[ nameLen - 6 ] ), ".delta" ) != 0 ) {
+            // not a finished delta for this base
+            continue;
+            }
+
+        if( upToTime != NULL &&
+            strncmp( &( name[ prefixLen ] ), upToTime,
+                     nameLen - 6 - prefixLen ) > 0 ) {
+            // too new
+            continue;
+            }
+
+        if( numDeltas == maxDeltas ) {
+            maxDeltas *= 2;
+            deltaNames =
+                (char**)realloc( deltaNames, maxDeltas * sizeof( char* ) );
+            }
+        deltaNames[ numDeltas++ ] = strdup( name );
+        }
+
+    closedir( dir );
+
+    // time stamps in names sort oldest first
+    qsort( deltaNames, numDeltas, sizeof( char* ), compareNames );
+
+
+
+    char tempPath[1000];
+    snprintf( tempPath, sizeof( tempPath ), "%s.temp", outPath );
+
+    if( ! copyFile( basePath, tempPath ) ) {
+        printf( "Failed to copy base %s to %s\n", basePath, tempPath );
+        return 1;
+        }
+
+    FILE *dbFile = fopen( tempPath, "r+b" );
+
+    if( dbFile == NULL ) {
+        printf( "Failed to open %s\n", tempPath );
+        return 1;
+        }
+
+    // header is 3-byte magic string, then key and value sizes
+    char magic[3];
+    uint32_t sizes[2];
+
+    if( fread( magic, 3, 1, dbFile ) != 1 ||
+        fread( sizes, sizeof( uint32_t ), 2, dbFile ) != 2 ) {
+        printf( "Failed to read lineardb3 header from %s\n", basePath );
+        fclose( dbFile );
+        return 1;
+        }
+
+    uint32_t numRecordsInDB = 0;
+
+    for( int i=0; i<numDeltas; i++ ) {
+        char deltaPath[2000];
+        snprintf( deltaPath, sizeof( deltaPath ), "%s/%s",
+                  folder, deltaNames[i] );
+
+        int numWritten = applyDelta( deltaPath, dbFile, sizes[0], sizes[1],
+                                     &numRecordsInDB );
+
+        if( numWritten < 0 ) {
+            fclose( dbFile );
+            remove( tempPath );
+            return 1;
+            }
+
+        printf( "Applied %d records from %s\n", numWritten, deltaNames[i] );
+
+        free( deltaNames[i] );
+        }
+
+    free( deltaNames );
+    free( folder );
+
+    if( fclose( dbFile ) != 0 ) {
+        printf( "Failed to finish writing %s\n", tempPath );
+        return 1;
+        }
+
+
+    // make sure result opens as a DB
+    LINEARDB3 db;
+
+    if( LINEARDB3_open( &db, tempPath, 0, 80000, sizes[0], sizes[1] ) != 0 ) {
+        printf( "Restored file %s fails to open as a DB\n", tempPath );
+        return 1;
+        }
+
+    uint32_t numRecords = LINEARDB3_getNumRecords( &db );
+
+    LINEARDB3_close( &db );
+
+    if( numRecords < numRecordsInDB ) {
+        printf( "Restored file %s has %u records, but last delta expects "
+                "at least %u\n", tempPath, numRecords, numRecordsInDB );
+        return 1;
+        }
+
+
+    if( rename( tempPath, outPath ) != 0 ) {
+        printf( "Failed to move %s to %s\n", tempPath, outPath );
+        return 1;
+        }
+
+    printf( "Restored %u records from base and %d deltas into %s\n",
+            numRecords, numDeltas, outPath );
+
+    return 0;
+    }
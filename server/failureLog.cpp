@@ -13,19 +13,35 @@
 
 #include "../gameSource/objectBank.h"
 
+#include "asyncLog.h"
 
+
+// only touched by async log writer, once it has started
 static FILE *logFile;
 
 static int currentYear;
 static int currentDay;
+
+// main thread's
+static char logOpen = false;
 static int currentHour;
 
+// don't check for hour change before this
+static time_t nextHourCheckTime = 0;
 
 
-static FILE *openCurrentLogFile() {
-    time_t t = time( NULL );
-    struct tm *timeStruct = localtime( &t );
-    
+static int logType = -1;
+
+// what each record holds, in ints[ ASYNC_LOG_INTS - 1 ]
+enum HourlyLogLine {
+    HOUR_START = 0,
+    HOUR_ENTRY,
+    HOUR_END
+    };
+
+
+
+static FILE *openCurrentLogFile( struct tm *timeStruct ) {
     char fileName[100];
     
     strftime( fileName, 99, "%Y_%m%B_%d_%A.txt", timeStruct );
@@ -89,18 +105,71 @@ static void clearTallies() {
 
 
 
+static void flushLog() {
+    if( logFile != NULL ) {
+        fflush( logFile );
+        }
+    }
+
+
+
+// called by async log writer
+static void formatLine( AsyncLogRecord *inRecord ) {
+    switch( inRecord->ints[ ASYNC_LOG_INTS - 1 ] ) {
+        case HOUR_START:
+            if( logFile != NULL ) {
+                fprintf( logFile, "hour=%d\n", inRecord->ints[0] );
+                }
+            break;
+        case HOUR_ENTRY:
+            if( logFile != NULL ) {
+                fprintf( 
+                    logFile, 
+                    "%d + %d  count=%d\n",
+                    inRecord->ints[0],
+                    inRecord->ints[1],
+                    inRecord->ints[2] );
+                }
+            break;
+        case HOUR_END: {
+            time_t t = (time_t)( inRecord->timeSec );
+
+            struct tm timeStruct;
+            localtime_r( &t, &timeStruct );
+
+            if( timeStruct.tm_year != currentYear ||
+                timeStruct.tm_yday != currentDay ) {
+
+                if( logFile != NULL ) {
+                    fclose( logFile );
+                    }
+        
+                logFile = openCurrentLogFile( &timeStruct );
+                }
+            break;
+            }
+        }
+    }
+
+
+
 void initFailureLog() {
     AppLog::info( "failureLog starting up" );
     
     time_t t = time( NULL );
-    struct tm *timeStruct = localtime( &t );
+    struct tm timeStruct;
+    localtime_r( &t, &timeStruct );
     
-    currentYear = timeStruct->tm_year;
-    currentDay = timeStruct->tm_yday;
-    currentHour = timeStruct->tm_hour;
+    currentYear = timeStruct.tm_year;
+    currentDay = timeStruct.tm_yday;
+    currentHour = timeStruct.tm_hour;
     
 
-    logFile = openCurrentLogFile();
+    logFile = openCurrentLogFile( &timeStruct );
+
+    logOpen = ( logFile != NULL );
+
+    logType = addAsyncLogType( formatLine, flushLog );
     
     maxObjectID = getMaxObjectID();
     
@@ -120,13 +189,29 @@ void initFailureLog() {
 
 static void stepLog( char inForceOutput ) {
     time_t t = time( NULL );
-    struct tm *timeStruct = localtime( &t );
+
+    if( t < nextHourCheckTime && ! inForceOutput ) {
+        return;
+        }
+
+    struct tm timeStruct;
+    localtime_r( &t, &timeStruct );
+
+    // start of next hour
+    nextHourCheckTime = 
+        t + ( 60 - timeStruct.tm_min ) * 60 - timeStruct.tm_sec;
     
-    if( timeStruct->tm_hour != currentHour || inForceOutput ) {
+    if( timeStruct.tm_hour != currentHour || inForceOutput ) {
         // hour change
         // add latest data averages to file
         
-        fprintf( logFile, "hour=%d\n", currentHour );
+        AsyncLogRecord line;
+        clearAsyncLogRecord( &line );
+
+        line.ints[ ASYNC_LOG_INTS - 1 ] = HOUR_START;
+        line.ints[0] = currentHour;
+        
+        asyncLog( logType, &line );
 
         for( int i=0; i<=maxSeenObjectID; i++ ) {
             
@@ -136,53 +221,53 @@ static void stepLog( char inForceOutput ) {
                     
                     FailureRecord *r = failureLists[i].getElement( j );
                     
-                    fprintf( 
-                        logFile, 
-                        "%d + %d  count=%d\n",
-                        r->actorID,
-                        r->targetID,
-                        r->failureCount );
+                    clearAsyncLogRecord( &line );
+                    line.ints[ ASYNC_LOG_INTS - 1 ] = HOUR_ENTRY;
+
+                    line.ints[0] = r->actorID;
+                    line.ints[1] = r->targetID;
+                    line.ints[2] = r->failureCount;
+                    
+                    asyncLog( logType, &line );
                     }
                 
                 failureLists[i].deleteAll();
                 }
             }
         
-        fflush( logFile );
+        // new day's file is opened after this hour's lines
+        clearAsyncLogRecord( &line );
+        line.ints[ ASYNC_LOG_INTS - 1 ] = HOUR_END;
+        
+        asyncLog( logType, &line );
 
         maxSeenObjectID = 0;        
-        currentHour = timeStruct->tm_hour;
+        currentHour = timeStruct.tm_hour;
         }
-    
-
-    if( timeStruct->tm_year != currentYear ||
-        timeStruct->tm_yday != currentDay ) {
-
-        if( logFile != NULL ) {
-            fclose( logFile );
-            }
-        
-        logFile = openCurrentLogFile();
-        }    
     }
 
 
 
 void freeFailureLog() {
     
-    if( logFile != NULL ) {
+    if( logOpen ) {
         // final output
+        // after freeAsyncLog, so this is written right away
         stepLog( true );
-        
+        }
+
+    if( logFile != NULL ) {
         fclose( logFile );
+        logFile = NULL;
         }
+    logOpen = false;
     delete [] failureLists;
     }
 
 
 
 void stepFailureLog() {
-    if( logFile != NULL ) {
+    if( logOpen ) {
         stepLog( false );
         }
     }
@@ -191,7 +276,7 @@ void stepFailureLog() {
 
 
 void logTransitionFailure( int inActorID, int inTargetID ) {
-    if( logFile != NULL ) {
+    if( logOpen ) {
         stepLog( false );
         }
 
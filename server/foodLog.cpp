@@ -12,19 +12,35 @@
 
 #include "../gameSource/objectBank.h"
 
+#include "asyncLog.h"
 
+
+// only touched by async log writer, once it has started
 static FILE *logFile;
 
 static int currentYear;
 static int currentDay;
+
+// main thread's
+static char logOpen = false;
 static int currentHour;
 
+// don't check for hour change before this
+static time_t nextHourCheckTime = 0;
 
 
-static FILE *openCurrentLogFile() {
-    time_t t = time( NULL );
-    struct tm *timeStruct = localtime( &t );
-    
+static int logType = -1;
+
+// what each record holds, in ints[ ASYNC_LOG_INTS - 1 ]
+enum HourlyLogLine {
+    HOUR_START = 0,
+    HOUR_ENTRY,
+    HOUR_END
+    };
+
+
+
+static FILE *openCurrentLogFile( struct tm *timeStruct ) {
     char fileName[100];
     
     strftime( fileName, 99, "%Y_%m%B_%d_%A.txt", timeStruct );
@@ -87,18 +103,72 @@ static void clearTallies() {
 
 
 
+static void flushLog() {
+    if( logFile != NULL ) {
+        fflush( logFile );
+        }
+    }
+
+
+
+// called by async log writer
+static void formatLine( AsyncLogRecord *inRecord ) {
+    switch( inRecord->ints[ ASYNC_LOG_INTS - 1 ] ) {
+        case HOUR_START:
+            if( logFile != NULL ) {
+                fprintf( logFile, "hour=%d\n", inRecord->ints[0] );
+                }
+            break;
+        case HOUR_ENTRY:
+            if( logFile != NULL ) {
+                fprintf( 
+                    logFile, 
+                    "id=%d count=%d value=%d av_age=%f "
+                    "av_mapX=%d av_mapY=%d\n",
+                    inRecord->ints[0], inRecord->ints[1], inRecord->ints[2],
+                    inRecord->doubles[0],
+                    inRecord->ints[3], inRecord->ints[4] );
+                }
+            break;
+        case HOUR_END: {
+            time_t t = (time_t)( inRecord->timeSec );
+
+            struct tm timeStruct;
+            localtime_r( &t, &timeStruct );
+
+            if( timeStruct.tm_year != currentYear ||
+                timeStruct.tm_yday != currentDay ) {
+
+                if( logFile != NULL ) {
+                    fclose( logFile );
+                    }
+        
+                logFile = openCurrentLogFile( &timeStruct );
+                }
+            break;
+            }
+        }
+    }
+
+
+
 void initFoodLog() {
     AppLog::info( "foodLog starting up" );
     
     time_t t = time( NULL );
-    struct tm *timeStruct = localtime( &t );
+    struct tm timeStruct;
+    localtime_r( &t, &timeStruct );
     
-    currentYear = timeStruct->tm_year;
-    currentDay = timeStruct->tm_yday;
-    currentHour = timeStruct->tm_hour;
+    currentYear = timeStruct.tm_year;
+    currentDay = timeStruct.tm_yday;
+    currentHour = timeStruct.tm_hour;
     
 
-    logFile = openCurrentLogFile();
+    logFile = openCurrentLogFile( &timeStruct );
+
+    logOpen = ( logFile != NULL );
+
+    logType = addAsyncLogType( formatLine, flushLog );
     
     maxObjectID = getMaxObjectID();
     
@@ -121,26 +191,47 @@ void initFoodLog() {
 
 static void stepLog( char inForceOutput ) {
     time_t t = time( NULL );
-    struct tm *timeStruct = localtime( &t );
+
+    if( t < nextHourCheckTime && ! inForceOutput ) {
+        return;
+        }
+
+    struct tm timeStruct;
+    localtime_r( &t, &timeStruct );
+
+    // start of next hour
+    nextHourCheckTime = 
+        t + ( 60 - timeStruct.tm_min ) * 60 - timeStruct.tm_sec;
     
-    if( timeStruct->tm_hour != currentHour || inForceOutput ) {
+    if( timeStruct.tm_hour != currentHour || inForceOutput ) {
         // hour change
         // add latest data averages to file
         
-        fprintf( logFile, "hour=%d\n", currentHour );
+        AsyncLogRecord line;
+        clearAsyncLogRecord( &line );
+
+        line.ints[ ASYNC_LOG_INTS - 1 ] = HOUR_START;
+        line.ints[0] = currentHour;
+        
+        asyncLog( logType, &line );
 
         for( int i=0; i<=maxSeenObjectID; i++ ) {
             
             if( eatFoodCounts[i] > 0 ) {
                 
-                fprintf( 
-                    logFile, 
-                    "id=%d count=%d value=%d av_age=%f "
-                    "av_mapX=%d av_mapY=%d\n",
-                    i, eatFoodCounts[i], eatFoodValueCounts[i],
-                    eaterAgeSums[i] / eatFoodCounts[i],
-                    (int)lrint( mapLocationSums[i].x / eatFoodCounts[i] ),
-                    (int)lrint( mapLocationSums[i].y / eatFoodCounts[i] ) );
+                clearAsyncLogRecord( &line );
+                line.ints[ ASYNC_LOG_INTS - 1 ] = HOUR_ENTRY;
+
+                line.ints[0] = i;
+                line.ints[1] = eatFoodCounts[i];
+                line.ints[2] = eatFoodValueCounts[i];
+                line.doubles[0] = eaterAgeSums[i] / eatFoodCounts[i];
+                line.ints[3] = 
+                    (int)lrint( mapLocationSums[i].x / eatFoodCounts[i] );
+                line.ints[4] =
+                    (int)lrint( mapLocationSums[i].y / eatFoodCounts[i] );
+                
+                asyncLog( logType, &line );
                 
                 
                 eatFoodCounts[i] = 0;
@@ -151,34 +242,32 @@ static void stepLog( char inForceOutput ) {
                 }
             }
         
-        fflush( logFile );
+        // new day's file is opened after this hour's lines
+        clearAsyncLogRecord( &line );
+        line.ints[ ASYNC_LOG_INTS - 1 ] = HOUR_END;
+        
+        asyncLog( logType, &line );
 
         maxSeenObjectID = 0;        
-        currentHour = timeStruct->tm_hour;
+        currentHour = timeStruct.tm_hour;
         }
-    
-
-    if( timeStruct->tm_year != currentYear ||
-        timeStruct->tm_yday != currentDay ) {
-
-        if( logFile != NULL ) {
-            fclose( logFile );
-            }
-        
-        logFile = openCurrentLogFile();
-        }    
     }
 
 
 
 void freeFoodLog() {
     
-    if( logFile != NULL ) {
+    if( logOpen ) {
         // final output
+        // after freeAsyncLog, so this is written right away
         stepLog( true );
-        
+        }
+
+    if( logFile != NULL ) {
         fclose( logFile );
+        logFile = NULL;
         }
+    logOpen = false;
     delete [] eatFoodCounts;
     delete [] eatFoodValueCounts;
     delete [] eaterAgeSums;
@@ -188,7 +277,7 @@ void freeFoodLog() {
 
 
 void stepFoodLog() {
-    if( logFile != NULL ) {
+    if( logOpen ) {
         stepLog( false );
         }
     }
@@ -199,7 +288,7 @@ void stepFoodLog() {
 void logEating( int inFoodID, int inFoodValue, double inEaterAge,
                 int inMapX, int inMapY ) {
     
-    if( logFile != NULL ) {
+    if( logOpen ) {
         stepLog( false );
         }
 
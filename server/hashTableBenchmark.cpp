@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#include "minorGems/system/Time.h"
+#include "minorGems/util/random/CustomRandomSource.h"
+
+#include "HashTable.h"
+#include "FlatHashTable.h"
+
+
+
+// Compares HashTable against FlatHashTable on a workload shaped like
+// live decay tracking in map.cpp:  tables start at 1024 bins, and keys
+// are x,y cells in a busy area with a few slots and sub-container
+// slots each.
+//
+// Also checks that both tables give the same answers.
+
+
+static CustomRandomSource randSource( 3487 );
+
+
+#define NUM_KEYS 60000
+
+static int keysA[ NUM_KEYS ];
+static int keysB[ NUM_KEYS ];
+static int keysC[ NUM_KEYS ];
+static int keysD[ NUM_KEYS ];
+
+
+// value found, to keep compiler from optimizing lookups away
+static double checkSum = 0;
+
+
+
+template <class Table>
+static double runWorkload( Table *inTable, int inNumRounds ) {
+
+    double startTime = Time::getCurrentTime();
+
+    for( int r=0; r<inNumRounds; r++ ) {
+
+        for( int i=0; i<NUM_KEYS; i++ ) {
+            inTable->insert( keysA[i], keysB[i], keysC[i], keysD[i],
+                             (double)i );
+            }
+
+        // lookups, half of them misses
+        for( int i=0; i<NUM_KEYS; i++ ) {
+            char found;
+
+            checkSum += inTable->lookup( keysA[i], keysB[i],
+                                         keysC[i], keysD[i], &found );
+
+            inTable->lookup( keysA[i], keysB[i] + 100000,
+                             keysC[i], keysD[i], &found );
+
+            if( found ) {
+                printf( "Unexpected hit\n" );
+                }
+            }
+
+        // update in place, like lookAtRegion
+        for( int i=0; i<NUM_KEYS; i++ ) {
+            double *p = inTable->lookupPointer( keysA[i], keysB[i],
+                                                keysC[i], keysD[i] );
+            if( p != NULL ) {
+                *p += 1;
+                }
+            }
+
+        // remove every other key, then check again
+        for( int i=0; i<NUM_KEYS; i+=2 ) {
+            inTable->remove( keysA[i], keysB[i], keysC[i], keysD[i] );
+            }
+
+        for( int i=0; i<NUM_KEYS; i++ ) {
+            char found;
+
+            checkSum += inTable->lookup( keysA[i], keysB[i],
+                                         keysC[i], keysD[i], &found );
+            }
+
+        inTable->clear();
+        }
+
+    return Time::getCurrentTime() - startTime;
+    }
+
+
+
+static int checkSame( HashTable<double> *inA, FlatHashTable<double> *inB ) {
+    int numBad = 0;
+
+    for( int i=0; i<NUM_KEYS * 4; i++ ) {
+        int k = randSource.getRandomBoundedInt( 0, NUM_KEYS - 1 );
+        int op = randSource.getRandomBoundedInt( 0, 2 );
+
+        if( op == 0 ) {
+            double v = randSource.getRandomDouble();
+
+            inA->insert( keysA[k], keysB[k], keysC[k], keysD[k], v );
+            inB->insert( keysA[k], keysB[k], keysC[k], keysD[k], v );
+            }
+        else if( op == 1 ) {
+            inA->remove( keysA[k], keysB[k], keysC[k], keysD[k] );
+            inB->remove( keysA[k], keysB[k], keysC[k], keysD[k] );
+            }
+
+        char foundA, foundB;
+
+        double vA = inA->lookup( keysA[k], keysB[k], keysC[k], keysD[k],
+                                 &foundA );
+        double vB = inB->lookup( keysA[k], keysB[k], keysC[k], keysD[k],
+                                 &foundB );
+
+        if( foundA != foundB || ( foundA && vA != vB ) ||
+            inA->getNumElements() != inB->getNumElements() ) {
+            numBad++;
+            }
+        }
+
+    return numBad;
+    }
+
+
+
+int main() {
+
+    for( int i=0; i<NUM_KEYS; i++ ) {
+        keysA[i] = randSource.getRandomBoundedInt( -400, 400 );
+        keysB[i] = randSource.getRandomBoundedInt( -400, 400 );
+        keysC[i] = randSource.getRandomBoundedInt( 0, 6 );
+        keysD[i] = randSource.getRandomBoundedInt( 0, 2 );
+        }
+
+    int numRounds = 20;
+
+    HashTable<double> oldTable( 1024, 0 );
+    FlatHashTable<double> newTable( 1024, 0 );
+
+    int numBad = checkSame( &oldTable, &newTable );
+
+    printf( "%d mismatches between HashTable and FlatHashTable\n", numBad );
+
+    oldTable.clear();
+    newTable.clear();
+
+    double oldTime = runWorkload( &oldTable, numRounds );
+    double newTime = runWorkload( &newTable, numRounds );
+
+    printf( "%d rounds of %d keys:\n", numRounds, NUM_KEYS );
+    printf( "    HashTable:      %.3f sec\n", oldTime );
+    printf( "    FlatHashTable:  %.3f sec  (%.1fx)\n", newTime,
+            oldTime / newTime );
+
+    printf( "(checksum %f)\n", checkSum );
+
+    return numBad;
+    }
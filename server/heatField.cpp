@@ -0,0 +1,292 @@
+#include "heatField.h"
+#include "SetAssociativeCache.h"
+#include "map.h"
+
+#include "minorGems/util/SettingsManager.h"
+#include "minorGems/util/log/AppLog.h"
+
+#include "../gameSource/objectBank.h"
+
+
+
+// tiles are 16x16 cells
+#define HEAT_TILE_SHIFT 4
+#define HEAT_TILE_D ( 1 << HEAT_TILE_SHIFT )
+#define HEAT_TILE_MASK ( HEAT_TILE_D - 1 )
+
+// default number of tiles cached, overridden by the heatFieldCacheSize
+// setting
+// 14 MB of RAM at this size
+#define HEAT_TILE_CACHE_SIZE 4096
+
+#define HEAT_TILE_CACHE_WAYS 4
+
+
+typedef struct HeatFieldTile {
+        // stamp of last change to any cell in tile
+        unsigned int stamp;
+
+        HeatFieldCell cells[ HEAT_TILE_D * HEAT_TILE_D ];
+
+        // false for cells not read from map yet, or changed since
+        char valid[ HEAT_TILE_D * HEAT_TILE_D ];
+    } HeatFieldTile;
+
+
+
+static SetAssociativeCache<HeatFieldTile> *heatTileCache = NULL;
+
+// moves forward on every cell change, even in tiles not cached, so that
+// areas with tiles that have dropped out of cache always look changed
+static unsigned int heatFieldStamp = 0;
+
+static char heatFromContained = true;
+
+// stats since last logHeatFieldStats
+static unsigned int statCellHits = 0;
+static unsigned int statCellMisses = 0;
+
+
+
+void initHeatField() {
+    freeHeatField();
+
+    int size = SettingsManager::getIntSetting( "heatFieldCacheSize",
+                                               HEAT_TILE_CACHE_SIZE );
+
+    if( size < HEAT_TILE_CACHE_WAYS ) {
+        size = HEAT_TILE_CACHE_WAYS;
+        }
+
+    heatTileCache = new SetAssociativeCache<HeatFieldTile>(
+        size, HEAT_TILE_CACHE_WAYS );
+
+    heatFromContained =
+        SettingsManager::getIntSetting( "heatFromContained", 1 );
+
+    AppLog::infoF( "Heat field caches %d tiles of %dx%d cells, "
+                   "heat from contained items %s",
+                   heatTileCache->getNumEntries(), HEAT_TILE_D, HEAT_TILE_D,
+                   heatFromContained ? "on" : "off" );
+    }
+
+
+
+void freeHeatField() {
+    if( heatTileCache != NULL ) {
+        logHeatFieldStats();
+
+        delete heatTileCache;
+        heatTileCache = NULL;
+        }
+    }
+
+
+
+void heatFieldCellChanged( int inX, int inY ) {
+    heatFieldStamp++;
+
+    if( heatTileCache == NULL ) {
+        return;
+        }
+
+    HeatFieldTile *t = heatTileCache->lookup( inX >> HEAT_TILE_SHIFT,
+                                              inY >> HEAT_TILE_SHIFT, 0, 0 );
+
+    if( t != NULL ) {
+        t->valid[ ( inY & HEAT_TILE_MASK ) * HEAT_TILE_D +
+                  ( inX & HEAT_TILE_MASK ) ] = false;
+        t->stamp = heatFieldStamp;
+        }
+    }
+
+
+
+// heat from items in container at inX, inY, shielded by container
+static float getContainedHeat( int inX, int inY, ObjectRecord *inContainer ) {
+    float heat = 0;
+
+    // contained can produce heat shielded by container r value
+    double oRFactor = 1 - inContainer->rValue;
+
+    int numCont;
+    int *cont = getContained( inX, inY, &numCont );
+
+    if( cont == NULL ) {
+        return heat;
+        }
+
+    for( int c=0; c<numCont; c++ ) {
+
+        int cID = cont[c];
+        char hasSub = false;
+        if( cID < 0 ) {
+            hasSub = true;
+            cID = -cID;
+            }
+
+        ObjectRecord *cO = getObject( cID );
+        heat += cO->heatValue * oRFactor;
+
+        if( hasSub ) {
+            double cRFactor = 1 - cO->rValue;
+
+            int numSub;
+            int *sub = getContained( inX, inY, &numSub, c + 1 );
+
+            if( sub != NULL ) {
+                for( int s=0; s<numSub; s++ ) {
+                    ObjectRecord *sO = getObject( sub[s] );
+
+                    heat += sO->heatValue * cRFactor * oRFactor;
+                    }
+                delete [] sub;
+                }
+            }
+        }
+    delete [] cont;
+
+    return heat;
+    }
+
+
+
+static HeatFieldCell readHeatFieldCell( int inX, int inY ) {
+    HeatFieldCell cell = { 0, 0, 0 };
+
+    // call Raw version for better performance
+    // we don't care if object decayed since we last looked at it
+    ObjectRecord *o = getObject( getMapObjectRaw( inX, inY ) );
+
+    if( o != NULL ) {
+        cell.heatOutput += o->heatValue;
+
+        if( o->permanent ) {
+            // loose objects sitting on ground don't
+            // contribute to r-value (like dropped clothing)
+            cell.objectR = o->rValue;
+            }
+
+        if( heatFromContained && o->numSlots > 0 ) {
+            cell.heatOutput += getContainedHeat( inX, inY, o );
+            }
+        }
+
+    // floor can insulate or produce heat too
+    ObjectRecord *fO = getObject( getMapFloor( inX, inY ) );
+
+    if( fO != NULL ) {
+        cell.heatOutput += fO->heatValue;
+        cell.floorR = fO->rValue;
+        }
+
+    return cell;
+    }
+
+
+
+static HeatFieldCell getHeatFieldCell( int inX, int inY ) {
+    int tileX = inX >> HEAT_TILE_SHIFT;
+    int tileY = inY >> HEAT_TILE_SHIFT;
+
+    int i = ( inY & HEAT_TILE_MASK ) * HEAT_TILE_D + ( inX & HEAT_TILE_MASK );
+
+    HeatFieldTile *t = heatTileCache->lookup( tileX, tileY, 0, 0 );
+
+    if( t != NULL && t->valid[i] ) {
+        statCellHits++;
+        return t->cells[i];
+        }
+
+    statCellMisses++;
+
+    // reading cell can apply decays, which change cell and can
+    // touch tile, so read first and look tile up again after
+    HeatFieldCell cell = readHeatFieldCell( inX, inY );
+
+    t = heatTileCache->lookup( tileX, tileY, 0, 0 );
+
+    if( t == NULL ) {
+        // zeroed, nothing valid
+        static HeatFieldTile blankTile;
+
+        blankTile.stamp = heatFieldStamp;
+
+        heatTileCache->insert( tileX, tileY, 0, 0, blankTile );
+
+        t = heatTileCache->lookup( tileX, tileY, 0, 0 );
+        }
+
+    t->cells[i] = cell;
+    t->valid[i] = true;
+
+    return cell;
+    }
+
+
+
+unsigned int getHeatFieldCells( int inX, int inY, int inWidth, int inHeight,
+                                HeatFieldCell *outCells ) {
+
+    for( int y=0; y<inHeight; y++ ) {
+        for( int x=0; x<inWidth; x++ ) {
+            outCells[ y * inWidth + x ] =
+                getHeatFieldCell( inX + x, inY + y );
+            }
+        }
+
+    return getHeatFieldStamp( inX, inY, inWidth, inHeight );
+    }
+
+
+
+unsigned int getHeatFieldStamp( int inX, int inY, int inWidth,
+                                int inHeight ) {
+
+    unsigned int stamp = 0;
+
+    int tileXA = inX >> HEAT_TILE_SHIFT;
+    int tileYA = inY >> HEAT_TILE_SHIFT;
+    int tileXB = ( inX + inWidth - 1 ) >> HEAT_TILE_SHIFT;
+    int tileYB = ( inY + inHeight - 1 ) >> HEAT_TILE_SHIFT;
+
+    for( int y=tileYA; y<=tileYB; y++ ) {
+        for( int x=tileXA; x<=tileXB; x++ ) {
+            HeatFieldTile *t = heatTileCache->lookup( x, y, 0, 0 );
+
+            if( t == NULL ) {
+                // can't know what changed while tile was out of cache
+                return heatFieldStamp;
+                }
+
+            if( t->stamp > stamp ) {
+                stamp = t->stamp;
+                }
+            }
+        }
+
+    return stamp;
+    }
+
+
+
+void logHeatFieldStats() {
+    if( heatTileCache == NULL ) {
+        return;
+        }
+
+    unsigned int total = statCellHits + statCellMisses;
+
+    double hitPercent = 0;
+    if( total > 0 ) {
+        hitPercent = 100.0 * statCellHits / total;
+        }
+
+    AppLog::infoF( "heatField: %u cell reads, %.1f%% hits, "
+                   "%u tiles evicted",
+                   total, hitPercent, heatTileCache->getEvictions() );
+
+    statCellHits = 0;
+    statCellMisses = 0;
+    heatTileCache->resetStats();
+    }
@@ -0,0 +1,55 @@
+
+
+// Shared world-space cache of what each map cell adds to player heat
+//
+// Cells are read from the map the first time some player's heat map
+// covers them, and kept until something in the cell changes, so players
+// standing near each other, or near where they stood a moment ago, don't
+// read the same cells over and over.
+//
+// Cells are kept in square tiles, each with a stamp that moves forward
+// whenever one of its cells changes, so callers can tell when an area
+// needs a fresh look.
+//
+// heatFieldCacheSize.ini sets the number of tiles kept.
+// heatFromContained.ini turns on heat from items inside containers.
+
+
+typedef struct HeatFieldCell {
+        // heat from object, its contained items, and floor
+        float heatOutput;
+
+        // r-value of permanent object in cell, 0 if none
+        float objectR;
+
+        // r-value of floor, 0 if none
+        float floorR;
+    } HeatFieldCell;
+
+
+
+void initHeatField();
+
+void freeHeatField();
+
+
+// called whenever anything stored for a cell changes
+void heatFieldCellChanged( int inX, int inY );
+
+
+// fills outCells with inWidth * inHeight cells, row by row, starting
+// at (inX, inY), with y increasing from row to row
+//
+// returns stamp for area, as getHeatFieldStamp would right after
+unsigned int getHeatFieldCells( int inX, int inY, int inWidth, int inHeight,
+                                HeatFieldCell *outCells );
+
+
+// stamp that is different whenever a cell in area may have changed
+// since last stamp was taken
+unsigned int getHeatFieldStamp( int inX, int inY, int inWidth, int inHeight );
+
+
+
+// logs cell hits and misses since last call, and resets them
+void logHeatFieldStats();
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+
+
+#include "minorGems/io/file/File.h"
+#include "minorGems/util/stringUtils.h"
+
+#include "logQuery.h"
+
+
+void usage() {
+    printf( "Usage:\n" );
+    printf( "ingestLogs path_to_server_dir [num_threads]\n\n" );
+    
+    printf( "Builds or updates store files in path_to_server_dir/logStore\n" );
+    printf( "for every lifeLog, foodLog, failureLog and curseLog dir\n" );
+    printf( "(lifeLog, lifeLog_server2, etc.)\n\n" );
+
+    printf( "num_threads defaults to one per processor\n\n" );
+
+    printf( "Example:\n" );
+    printf( "ingestLogs "
+            "~/checkout/OneLife/server 8\n\n" );
+    
+    exit( 1 );
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    if( inNumArgs != 2 && inNumArgs != 3 ) {
+        usage();
+        }
+    
+    char *path = inArgs[1];
+    
+    int numThreads = 0;
+    
+    if( inNumArgs == 3 ) {
+        sscanf( inArgs[2], "%d", &numThreads );
+        }
+    
+    if( path[strlen(path) - 1] == '/' ) {
+        path[strlen(path) - 1] = '\0';
+        }
+    
+    File mainDir( NULL, path );
+    
+    if( ! mainDir.exists() || ! mainDir.isDirectory() ) {
+        usage();
+        }
+    
+    int totalLoaded = 0;
+    int totalRebuilt = 0;
+    
+    for( int k=0; k<NUM_LOG_KINDS; k++ ) {
+        
+        SimpleVector<char*> folders;
+        getLogFolders( path, (LogKind)k, &folders );
+        
+        for( int i=0; i<folders.size(); i++ ) {
+            char *folderName = folders.getElementDirect( i );
+            
+            SimpleVector<char*> logs;
+            getLogFileNames( path, folderName, &logs );
+            
+            int numRebuilt;
+            
+            // loading stale tables is what rebuilds them
+            int numLoaded = 
+                runLogQuery( path, folderName, (LogKind)k, &logs, 
+                             numThreads, NULL, NULL, NULL, &numRebuilt );
+            
+            printf( "%s:  %d logs, %d store files rebuilt\n",
+                    folderName, numLoaded, numRebuilt );
+            
+            totalLoaded += numLoaded;
+            totalRebuilt += numRebuilt;
+            
+            logs.deallocateStringElements();
+            }
+        folders.deallocateStringElements();
+        }
+    
+    printf( "Ingested %d logs, %d store files rebuilt\n", 
+            totalLoaded, totalRebuilt );
+    
+    return 0;
+    }
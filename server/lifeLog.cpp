@@ -6,6 +6,7 @@
 #include "lineageLog.h"
 
 #include "curses.h"
+#include "asyncLog.h"
 
 
 
@@ -17,6 +18,7 @@
 
 #include "minorGems/system/Time.h"
 
+// files only touched by async log writer, once it has started
 static FILE *logFile;
 static FILE *nameLogFile;
 
@@ -24,16 +26,26 @@ static int currentYear;
 static int currentDay;
 
 
+static int birthLogType = -1;
+static int deathLogType = -1;
+static int nameLogType = -1;
+
+
+enum DeathCause {
+    DEATH_DISCONNECT = 0,
+    DEATH_OLD_AGE,
+    DEATH_HUNGER,
+    DEATH_KILLER
+    };
+
+
 static int deadYoungEveCount = 0;
 
 
 extern double forceDeathAge;
 
 
-static void openCurrentLogFiles() {
-    time_t t = time( NULL );
-    struct tm *timeStruct = localtime( &t );
-    
+static void openCurrentLogFiles( struct tm *timeStruct ) {
     char fileName[100];
 
     File logDir( NULL, "lifeLog" );
@@ -91,38 +103,68 @@ static void openCurrentLogFiles() {
 
 
 
+static void formatBirth( AsyncLogRecord *inRecord );
+static void formatDeath( AsyncLogRecord *inRecord );
+static void formatName( AsyncLogRecord *inRecord );
+static void flushLifeLog();
+
+
+
 void initLifeLog() {
     AppLog::info( "lifeLog starting up" );
     
     time_t t = time( NULL );
-    struct tm *timeStruct = localtime( &t );
+    struct tm timeStruct;
+    localtime_r( &t, &timeStruct );
     
-    currentYear = timeStruct->tm_year;
-    currentDay = timeStruct->tm_yday;
+    currentYear = timeStruct.tm_year;
+    currentDay = timeStruct.tm_yday;
     
 
-    openCurrentLogFiles();
+    openCurrentLogFiles( &timeStruct );
+
+    birthLogType = addAsyncLogType( formatBirth, flushLifeLog );
+    deathLogType = addAsyncLogType( formatDeath, flushLifeLog );
+    nameLogType = addAsyncLogType( formatName, flushLifeLog );
     }
 
 
 
+// after freeAsyncLog
 void freeLifeLog() {
     if( logFile != NULL ) {
         fclose( logFile );
+        logFile = NULL;
         }
     if( nameLogFile != NULL ) {
         fclose( nameLogFile );
+        nameLogFile = NULL;
         }
     }
 
 
 
-static void stepLog() {
-    time_t t = time( NULL );
-    struct tm *timeStruct = localtime( &t );
+static void flushLifeLog() {
+    if( logFile != NULL ) {
+        fflush( logFile );
+        }
+    if( nameLogFile != NULL ) {
+        fflush( nameLogFile );
+        }
+    }
+
+
+
+// switches files if record is from a new day
+static void stepLog( double inTimeSec ) {
+    time_t t = (time_t)inTimeSec;
+
+    // not localtime, which writer thread can't share with main thread
+    struct tm timeStruct;
+    localtime_r( &t, &timeStruct );
     
-    if( timeStruct->tm_year != currentYear ||
-        timeStruct->tm_yday != currentDay ) {
+    if( timeStruct.tm_year != currentYear ||
+        timeStruct.tm_yday != currentDay ) {
 
         if( logFile != NULL ) {
             fclose( logFile );
@@ -133,12 +175,107 @@ static void stepLog() {
             nameLogFile = NULL;
             }
         
-        openCurrentLogFiles();
+        openCurrentLogFiles( &timeStruct );
         }    
     }
 
 
 
+static void formatBirth( AsyncLogRecord *inRecord ) {
+    if( logFile == NULL ) {
+        return;
+        }
+
+    stepLog( inRecord->timeSec );
+
+    if( logFile == NULL ) {
+        return;
+        }
+
+    char *parentString;
+            
+    if( inRecord->strings[1] == NULL ) {
+        parentString = stringDuplicate( "noParent" );
+        }
+    else {
+        parentString = autoSprintf( "parent=%d,%s",
+                                    inRecord->ints[1], inRecord->strings[1] );
+        }
+
+    char genderChar = 'F';
+    if( inRecord->ints[2] ) {
+        genderChar = 'M';
+        }
+
+    fprintf( logFile, "B %.f %d %s %c (%d,%d) %s pop=%d chain=%d\n",
+             inRecord->timeSec,
+             inRecord->ints[0], inRecord->strings[0], genderChar,
+             inRecord->ints[3], inRecord->ints[4],
+             parentString,
+             inRecord->ints[5], inRecord->ints[6] );
+
+    delete [] parentString;
+    }
+
+
+
+static void formatDeath( AsyncLogRecord *inRecord ) {
+    if( logFile == NULL ) {
+        return;
+        }
+
+    stepLog( inRecord->timeSec );
+
+    if( logFile == NULL ) {
+        return;
+        }
+
+    char *causeString;
+
+    switch( inRecord->ints[5] ) {
+        case DEATH_DISCONNECT:
+            causeString = stringDuplicate( "disconnect" );
+            break;
+        case DEATH_OLD_AGE:
+            causeString = stringDuplicate( "oldAge" );
+            break;
+        case DEATH_HUNGER:
+            causeString = stringDuplicate( "hunger" );
+            break;
+        default:
+            causeString = autoSprintf( "killer_%d_%s",
+                                       inRecord->ints[6],
+                                       inRecord->strings[1] );
+            break;
+        }
+
+    char genderChar = 'F';
+    if( inRecord->ints[1] ) {
+        genderChar = 'M';
+        }
+
+    fprintf( logFile, "D %.0f %d %s age=%.2f %c (%d,%d) %s pop=%d\n",
+             inRecord->timeSec,
+             inRecord->ints[0], inRecord->strings[0], 
+             inRecord->doubles[0], genderChar,
+             inRecord->ints[2], inRecord->ints[3],
+             causeString,
+             inRecord->ints[4] );
+
+    delete [] causeString;
+    }
+
+
+
+static void formatName( AsyncLogRecord *inRecord ) {
+    if( nameLogFile != NULL ) {
+        fprintf( nameLogFile, "%d %s\n",
+                 inRecord->ints[0], inRecord->strings[0] );
+        }
+    }
+
+
+
 
 void logBirth( int inPlayerID, char *inPlayerEmail,
                int inParentID, char *inParentEmail,
@@ -149,37 +286,21 @@ void logBirth( int inPlayerID, char *inPlayerEmail,
     
     cursesLogBirth( inPlayerEmail );
     
-    if( logFile != NULL ) {
-        stepLog();
-
-        if( logFile != NULL ) {
-        
-            char *parentString;
-            
-            if( inParentEmail == NULL ) {
-                parentString = stringDuplicate( "noParent" );
-                }
-            else {
-                parentString = autoSprintf( "parent=%d,%s",
-                                            inParentID, inParentEmail );
-                }
+    AsyncLogRecord r;
+    clearAsyncLogRecord( &r );
 
-            char genderChar = 'F';
-            if( inIsMale ) {
-                genderChar = 'M';
-                }
+    r.ints[0] = inPlayerID;
+    r.ints[1] = inParentID;
+    r.ints[2] = inIsMale;
+    r.ints[3] = inMapX;
+    r.ints[4] = inMapY;
+    r.ints[5] = inTotalPopulation;
+    r.ints[6] = inParentChainLength;
 
-            fprintf( logFile, "B %.f %d %s %c (%d,%d) %s pop=%d chain=%d\n",
-                     Time::timeSec(),
-                     inPlayerID, inPlayerEmail, genderChar, inMapX, inMapY, 
-                     parentString,
-                     inTotalPopulation, inParentChainLength );
-            
-            fflush( logFile );
+    r.strings[0] = inPlayerEmail;
+    r.strings[1] = inParentEmail;
 
-            delete [] parentString;
-            }
-        }
+    asyncLog( birthLogType, &r );
     }
 
 
@@ -225,48 +346,38 @@ void logDeath( int inPlayerID, char *inPlayerEmail,
         }
 
 
-    if( logFile != NULL ) {
-        stepLog();
-
-        if( logFile != NULL ) {
-            
-            char *causeString;
-        
-            if( inKillerEmail == NULL ) {
-                if( inDisconnect ) {
-                    causeString = stringDuplicate( "disconnect" );
-                    }
-                else {
-                    if( inAge >= forceDeathAge ) {
-                        causeString = stringDuplicate( "oldAge" );
-                        }
-                    else {
-                        causeString = stringDuplicate( "hunger" );
-                        }
-                    }
-                }
-            else {
-                causeString = autoSprintf( "killer_%d_%s",
-                                           inKillerID, inKillerEmail );
-                }
+    AsyncLogRecord r;
+    clearAsyncLogRecord( &r );
 
-            char genderChar = 'F';
-            if( inIsMale ) {
-                genderChar = 'M';
-                }
+    r.ints[0] = inPlayerID;
+    r.ints[1] = inIsMale;
+    r.ints[2] = inMapX;
+    r.ints[3] = inMapY;
+    r.ints[4] = inTotalRemainingPopulation;
 
-            fprintf( logFile, "D %.0f %d %s age=%.2f %c (%d,%d) %s pop=%d\n",
-                     Time::timeSec(),
-                     inPlayerID, inPlayerEmail, 
-                     inAge, genderChar,
-                     inMapX, inMapY,
-                     causeString,
-                     inTotalRemainingPopulation );
-            fflush( logFile );
-            
-            delete [] causeString;
+    // cause decided here, where forceDeathAge can be read
+    if( inKillerEmail == NULL ) {
+        if( inDisconnect ) {
+            r.ints[5] = DEATH_DISCONNECT;
             }
+        else if( inAge >= forceDeathAge ) {
+            r.ints[5] = DEATH_OLD_AGE;
+            }
+        else {
+            r.ints[5] = DEATH_HUNGER;
+            }
+        }
+    else {
+        r.ints[5] = DEATH_KILLER;
+        r.ints[6] = inKillerID;
         }
+
+    r.doubles[0] = inAge;
+
+    r.strings[0] = inPlayerEmail;
+    r.strings[1] = inKillerEmail;
+
+    asyncLog( deathLogType, &r );
     }
 
 
@@ -275,9 +386,14 @@ void logDeath( int inPlayerID, char *inPlayerEmail,
 
 void logName( int inPlayerID, char *inEmail, char *inName,
               int inLineageEveID ) {
-    if( nameLogFile != NULL ) {
-        fprintf( nameLogFile, "%d %s\n", inPlayerID, inName );
-        }
+    AsyncLogRecord r;
+    clearAsyncLogRecord( &r );
+
+    r.ints[0] = inPlayerID;
+    r.strings[0] = inName;
+
+    asyncLog( nameLogType, &r );
+
     logPlayerNameForCurses( inEmail, inName, inLineageEveID );
     }
 
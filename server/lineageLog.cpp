@@ -5,7 +5,9 @@
 #include "minorGems/util/SettingsManager.h"
 #include "minorGems/util/SimpleVector.h"
 
-#include "minorGems/network/web/WebRequest.h"
+#include "minorGems/util/stringUtils.h"
+
+#include "asyncWeb.h"
 #include "minorGems/network/web/URLUtils.h"
 
 #include "minorGems/crypto/hashes/sha1.h"
@@ -29,7 +31,7 @@ typedef struct LineageRecord {
         char *lastSay;
         char male;
         
-        WebRequest *request;
+        AsyncWebRequest *request;
         // -1 until first request gets it
         int sequenceNumber;
     } LineageRecord;
@@ -100,7 +102,7 @@ void recordPlayerLineage( char *inEmail, double inAge,
             }
         
         
-        WebRequest *request;
+        AsyncWebRequest *request;
         
         char *encodedEmail = URLUtils::urlEncode( inEmail );
 
@@ -112,7 +114,7 @@ void recordPlayerLineage( char *inEmail, double inAge,
         
         delete [] encodedEmail;
         
-        request = new WebRequest( "GET", url, NULL );
+        request = new AsyncWebRequest( "GET", url, NULL );
         printf( "Starting new web request for %s\n", url );
         
         delete [] url;
@@ -223,7 +225,7 @@ void stepLineageLog() {
                     delete [] encodedLastSay;
                     delete [] hash;
 
-                    r->request = new WebRequest( "GET", url, NULL );
+                    r->request = new AsyncWebRequest( "GET", url, NULL );
                     printf( "Starting new web request for %s\n", url );
                     
                     delete [] url;
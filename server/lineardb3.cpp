@@ -9,6 +9,11 @@
 #ifdef _WIN32
 #define fseeko fseeko64
 #define ftello ftello64
+#include <io.h>
+#else
+#define LINEARDB3_MMAP_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 
@@ -32,6 +37,17 @@ void LINEARDB3_setMaxLoad( double inMaxLoad ) {
 
 
 
+static char useMmapForOpenCalls = false;
+
+
+void LINEARDB3_setUseMmap( char inUseMmap ) {
+#ifdef LINEARDB3_MMAP_SUPPORTED
+    useMmapForOpenCalls = inUseMmap;
+#endif
+    }
+
+
+
 
 #include "murmurhash2_64.cpp"
 
@@ -364,6 +380,114 @@ static int getRecordSizeBytes( int inKeySize, int inValueSize ) {
     }
 
 
+
+
+// makes sure that mapping covers the first inFileSize bytes of the file,
+// growing it to the next whole extent past inFileSize if needed
+//
+// returns 0 on success, -1 on error
+static int growMapping( LINEARDB3 *inDB, uint64_t inFileSize ) {
+#ifdef LINEARDB3_MMAP_SUPPORTED
+    if( inDB->mapBase != NULL && inFileSize <= inDB->mapSize ) {
+        return 0;
+        }
+    
+    // leave a whole extent of room past the current end of the file
+    // pages past the end of the file are never touched, but they reserve
+    // address space so that a series of appends doesn't re-map every time
+    uint64_t newMapSize = 
+        ( inFileSize / LINEARDB3_MMAP_EXTENT_BYTES + 1 ) * 
+        LINEARDB3_MMAP_EXTENT_BYTES;
+    
+    // map new size before giving up old mapping, so that a failed grow
+    // leaves the old mapping in place, still covering the records it
+    // covered before
+    void *newMap = mmap( NULL, newMapSize, PROT_READ | PROT_WRITE, 
+                         MAP_SHARED, fileno( inDB->file ), 0 );
+    
+    if( newMap == MAP_FAILED ) {
+        printf( "lineardb3 failed to mmap %.0f bytes of data file\n",
+                (double)newMapSize );
+        return -1;
+        }
+    
+    if( inDB->mapBase != NULL ) {
+        munmap( inDB->mapBase, inDB->mapSize );
+        }
+    
+    inDB->mapBase = (uint8_t*)newMap;
+    inDB->mapSize = newMapSize;
+    
+    return 0;
+#else
+    return -1;
+#endif
+    }
+
+
+
+// pointer to record at inFilePosRec in mapping
+// a record appended while a grow failed may lie past the end of the
+// mapping, so retry the grow before handing out a pointer to it
+//
+// returns NULL if record can't be mapped
+static uint8_t *getMappedRecord( LINEARDB3 *inDB, uint64_t inFilePosRec ) {
+    if( inFilePosRec + inDB->recordSizeBytes > inDB->mapSize ) {
+        if( growMapping( inDB, inFilePosRec + inDB->recordSizeBytes ) 
+            != 0 ) {
+            return NULL;
+            }
+        }
+    return &( inDB->mapBase[ inFilePosRec ] );
+    }
+
+
+
+static void freeMapping( LINEARDB3 *inDB ) {
+#ifdef LINEARDB3_MMAP_SUPPORTED
+    if( inDB->mapBase != NULL ) {
+        munmap( inDB->mapBase, inDB->mapSize );
+        }
+#endif
+    inDB->mapBase = NULL;
+    inDB->mapSize = 0;
+    }
+
+
+
+// appends a record to the end of a file opened in mmap mode
+// inFilePosRec must be the current end of the file
+//
+// returns 0 on success, -1 on error
+static int appendMappedRecord( LINEARDB3 *inDB, uint64_t inFilePosRec,
+                               const void *inKey, const void *inValue ) {
+#ifdef LINEARDB3_MMAP_SUPPORTED
+    if( inFilePosRec != inDB->fileSize ) {
+        return -1;
+        }
+    
+    // key and value together, so that the file grows by one whole record
+    // in a single call
+    memcpy( inDB->recordBuffer, inKey, inDB->keySize );
+    memcpy( &( inDB->recordBuffer[ inDB->keySize ] ), inValue, 
+            inDB->valueSize );
+    
+    ssize_t numWritten = pwrite( fileno( inDB->file ), inDB->recordBuffer, 
+                                 inDB->recordSizeBytes, inFilePosRec );
+    
+    if( numWritten != (ssize_t)( inDB->recordSizeBytes ) ) {
+        return -1;
+        }
+    
+    inDB->fileSize += inDB->recordSizeBytes;
+    
+    return growMapping( inDB, inDB->fileSize );
+#else
+    return -1;
+#endif
+    }
+
+
 static void recomputeFingerprintMod( LINEARDB3 *inDB ) {
     inDB->fingerprintMod = inDB->hashTableSizeA;
     
@@ -422,6 +546,18 @@ int LINEARDB3_open(
     inDB->recordBuffer = NULL;
     inDB->maxOverflowDepth = 0;
 
+    inDB->trackDirty = false;
+    inDB->dirtyBits = NULL;
+    inDB->dirtyBitsBytes = 0;
+    inDB->dirtyList = NULL;
+    inDB->numDirty = 0;
+    inDB->dirtyListSize = 0;
+
+    inDB->useMmap = useMmapForOpenCalls;
+    inDB->mapBase = NULL;
+    inDB->mapSize = 0;
+    inDB->fileSize = 0;
+
     inDB->numRecords = 0;
     
     inDB->maxLoad = maxLoadForOpenCalls;
@@ -485,6 +621,18 @@ int LINEARDB3_open(
         
         initPageManager( inDB->hashTable, inDB->hashTableSizeA );
         initPageManager( inDB->overflowBuckets, 2 );
+
+        if( inDB->useMmap ) {
+            // header must be in file before we map it
+            if( fflush( inDB->file ) != 0 ) {
+                return 1;
+                }
+            inDB->fileSize = LINEARDB3_HEADER_SIZE;
+            
+            if( growMapping( inDB, inDB->fileSize ) != 0 ) {
+                return 1;
+                }
+            }
         }
     else {
         // read header
@@ -659,26 +807,45 @@ int LINEARDB3_open(
         initPageManager( inDB->overflowBuckets, 2 );
 
 
-        if( fseeko( inDB->file, LINEARDB3_HEADER_SIZE, SEEK_SET ) ) {
+        if( inDB->useMmap ) {
+            inDB->fileSize = 
+                LINEARDB3_HEADER_SIZE + 
+                numRecordsInFile * inDB->recordSizeBytes;
+            
+            if( growMapping( inDB, inDB->fileSize ) != 0 ) {
+                return 1;
+                }
+            }
+        else if( fseeko( inDB->file, LINEARDB3_HEADER_SIZE, SEEK_SET ) ) {
             return 1;
             }
         
         for( uint64_t i=0; i<numRecordsInFile; i++ ) {
-            int numRead = fread( inDB->recordBuffer, 
-                                 inDB->recordSizeBytes, 1, inDB->file );
             
-            if( numRead != 1 ) {
-                printf( "Failed to read record from lineardb3 file\n" );
-                return 1;
+            uint8_t *record = inDB->recordBuffer;
+            
+            if( inDB->useMmap ) {
+                // read straight out of mapping
+                record = &( inDB->mapBase[ LINEARDB3_HEADER_SIZE +
+                                           i * inDB->recordSizeBytes ] );
                 }
-
+            else {
+                int numRead = fread( inDB->recordBuffer, 
+                                     inDB->recordSizeBytes, 1, inDB->file );
+            
+                if( numRead != 1 ) {
+                    printf( "Failed to read record from lineardb3 file\n" );
+                    return 1;
+                    }
+                }
+            
             // put only in RAM part of table
             // note that this assumes that each key in the file is unique
             // (it should be, because we generated the file on a previous run)
             int result = 
                 LINEARDB3_getOrPut( inDB,
-                                    &( inDB->recordBuffer[0] ),
-                                    &( inDB->recordBuffer[inDB->keySize] ),
+                                    &( record[0] ),
+                                    &( record[inDB->keySize] ),
                                     true, 
                                     // ignore data file
                                     // update ram only
@@ -709,6 +876,18 @@ void LINEARDB3_close( LINEARDB3 *inDB ) {
         }    
 
 
+    freeMapping( inDB );
+
+    if( inDB->dirtyBits != NULL ) {
+        delete [] inDB->dirtyBits;
+        inDB->dirtyBits = NULL;
+        }
+    if( inDB->dirtyList != NULL ) {
+        delete [] inDB->dirtyList;
+        inDB->dirtyList = NULL;
+        }
+    inDB->trackDirty = false;
+
     freePageManager( inDB->hashTable );
     freePageManager( inDB->overflowBuckets );
     
@@ -962,6 +1141,66 @@ static uint64_t getBinNumber( LINEARDB3 *inDB, const void *inKey,
 
 
 
+// notes that a record is about to be written, if tracking dirty records
+static void markRecordDirty( LINEARDB3 *inDB, uint32_t inRecordNumber ) {
+    if( ! inDB->trackDirty ) {
+        return;
+        }
+    
+    uint32_t byteIndex = inRecordNumber / 8;
+    uint8_t bit = (uint8_t)( 1 << ( inRecordNumber % 8 ) );
+    
+    if( byteIndex >= inDB->dirtyBitsBytes ) {
+        // grow to cover new record, with room for more appends
+        uint32_t newBytes = inDB->dirtyBitsBytes * 2;
+        
+        if( newBytes <= byteIndex ) {
+            newBytes = byteIndex + 1024;
+            }
+        
+        uint8_t *newBits = new uint8_t[ newBytes ];
+        
+        memset( newBits, 0, newBytes );
+        
+        if( inDB->dirtyBits != NULL ) {
+            memcpy( newBits, inDB->dirtyBits, inDB->dirtyBitsBytes );
+            delete [] inDB->dirtyBits;
+            }
+        inDB->dirtyBits = newBits;
+        inDB->dirtyBitsBytes = newBytes;
+        }
+    
+    if( inDB->dirtyBits[ byteIndex ] & bit ) {
+        // already listed
+        return;
+        }
+    
+    inDB->dirtyBits[ byteIndex ] |= bit;
+    
+    if( inDB->numDirty == inDB->dirtyListSize ) {
+        uint32_t newSize = inDB->dirtyListSize * 2;
+        
+        if( newSize == 0 ) {
+            newSize = 1024;
+            }
+        
+        uint32_t *newList = new uint32_t[ newSize ];
+        
+        if( inDB->dirtyList != NULL ) {
+            memcpy( newList, inDB->dirtyList, 
+                    inDB->numDirty * sizeof( uint32_t ) );
+            delete [] inDB->dirtyList;
+            }
+        inDB->dirtyList = newList;
+        inDB->dirtyListSize = newSize;
+        }
+    
+    inDB->dirtyList[ inDB->numDirty ] = inRecordNumber;
+    inDB->numDirty++;
+    }
+
+
+
 // Consider getting/putting from inBucket at inRecIndex
 //
 // returns 0 if handled and done
@@ -1017,8 +1256,41 @@ static int LINEARDB3_considerFingerprintBucket( LINEARDB3 *inDB,
             
         uint64_t filePosRec = 
             LINEARDB3_HEADER_SIZE +
-            inBucket->fileIndex[ i ] * 
+            (uint64_t)( inBucket->fileIndex[ i ] ) * 
             inDB->recordSizeBytes;
+        
+        if( inDB->useMmap ) {
+            if( emptyRec ) {
+                markRecordDirty( inDB, inBucket->fileIndex[ i ] );
+                
+                return appendMappedRecord( inDB, filePosRec, 
+                                           inKey, inOutValue );
+                }
+
+            uint8_t *record = getMappedRecord( inDB, filePosRec );
+            
+            if( record == NULL ) {
+                return -1;
+                }
+            
+            if( ! keyComp( inDB->keySize, record, inKey ) ) {
+                // false match on non-empty rec because of fingerprint
+                // collision
+                return 2;
+                }
+            
+            if( inPut ) {
+                markRecordDirty( inDB, inBucket->fileIndex[ i ] );
+                
+                memcpy( &( record[ inDB->keySize ] ), inOutValue, 
+                        inDB->valueSize );
+                }
+            else {
+                memcpy( inOutValue, &( record[ inDB->keySize ] ), 
+                        inDB->valueSize );
+                }
+            return 0;
+            }
             
         if( !emptyRec ) {
             
@@ -1046,6 +1318,8 @@ static int LINEARDB3_considerFingerprintBucket( LINEARDB3 *inDB,
 
             
         if( inPut ) {
+            markRecordDirty( inDB, inBucket->fileIndex[ i ] );
+            
             if( emptyRec ) {
 
                 // don't seek unless we have to
@@ -1208,11 +1482,18 @@ int LINEARDB3_getOrPut( LINEARDB3 *inDB, const void *inKey, void *inOutValue,
         inDB->numRecords++;
         
         if( ! inIgnoreDataFile ) {
+            
+            markRecordDirty( inDB, newBucket->fileIndex[0] );
 
             uint64_t filePosRec = 
                 LINEARDB3_HEADER_SIZE +
-                newBucket->fileIndex[0] * 
+                (uint64_t)( newBucket->fileIndex[0] ) * 
                 inDB->recordSizeBytes;
+            
+            if( inDB->useMmap ) {
+                return appendMappedRecord( inDB, filePosRec, 
+                                           inKey, inOutValue );
+                }
 
             // don't seek unless we have to
             if( ftello( inDB->file ) != (signed)filePosRec ) {
@@ -1304,8 +1585,21 @@ int LINEARDB3_Iterator_next( LINEARDB3_Iterator *inDBi,
         
         uint64_t fileRecPos = 
             LINEARDB3_HEADER_SIZE + 
-            inDBi->nextRecordIndex * db->recordSizeBytes;
+            (uint64_t)( inDBi->nextRecordIndex ) * db->recordSizeBytes;
         
+        if( db->useMmap ) {
+            uint8_t *record = getMappedRecord( db, fileRecPos );
+            
+            if( record == NULL ) {
+                return -1;
+                }
+            
+            memcpy( outKey, record, db->keySize );
+            memcpy( outValue, &( record[ db->keySize ] ), db->valueSize );
+            
+            inDBi->nextRecordIndex++;
+            return 1;
+            }
                     
         if( ftello( db->file ) != (signed)fileRecPos ) {    
             if( fseeko( db->file, fileRecPos, SEEK_SET ) ) {
@@ -1359,3 +1653,103 @@ unsigned int LINEARDB3_getShrinkSize( LINEARDB3 *inDB,
 
     return minTableBuckets;
     }
+
+
+
+
+void LINEARDB3_trackDirtyRecords( LINEARDB3 *inDB ) {
+    inDB->trackDirty = true;
+    }
+
+
+
+uint32_t *LINEARDB3_takeDirtyRecords( LINEARDB3 *inDB, 
+                                      uint32_t *outNumDirty ) {
+    *outNumDirty = inDB->numDirty;
+    
+    if( inDB->numDirty == 0 ) {
+        return NULL;
+        }
+    
+    uint32_t *list = inDB->dirtyList;
+    
+    // clear only the bits of listed records, instead of whole bit field
+    for( uint32_t i=0; i<inDB->numDirty; i++ ) {
+        uint32_t r = list[i];
+        
+        inDB->dirtyBits[ r / 8 ] &= (uint8_t)~( 1 << ( r % 8 ) );
+        }
+    
+    // caller takes list, start fresh one
+    inDB->dirtyList = NULL;
+    inDB->numDirty = 0;
+    inDB->dirtyListSize = 0;
+    
+    return list;
+    }
+
+
+
+int LINEARDB3_getRecord( LINEARDB3 *inDB, uint32_t inRecordNumber,
+                         void *outKey, void *outValue ) {
+    if( inRecordNumber >= inDB->numRecords ) {
+        return -1;
+        }
+
+    // same as one step of iterator
+    LINEARDB3_Iterator dbi;
+    
+    LINEARDB3_Iterator_init( inDB, &dbi );
+    dbi.nextRecordIndex = inRecordNumber;
+    
+    if( LINEARDB3_Iterator_next( &dbi, outKey, outValue ) != 1 ) {
+        return -1;
+        }
+    return 0;
+    }
+
+
+
+int LINEARDB3_flush( LINEARDB3 *inDB ) {
+    if( inDB->useMmap ) {
+        // puts go straight to mapping, and appends use pwrite, so there's
+        // nothing in file's stdio buffer
+        return 0;
+        }
+    
+    if( fflush( inDB->file ) != 0 ) {
+        return -1;
+        }
+    return 0;
+    }
+
+
+
+int LINEARDB3_sync( LINEARDB3 *inDB ) {
+    if( LINEARDB3_flush( inDB ) != 0 ) {
+        return -1;
+        }
+
+#ifdef LINEARDB3_MMAP_SUPPORTED
+    if( inDB->useMmap && inDB->mapBase != NULL ) {
+        if( msync( inDB->mapBase, inDB->fileSize, MS_SYNC ) != 0 ) {
+            return -1;
+            }
+        }
+    
+    if( fsync( fileno( inDB->file ) ) != 0 ) {
+        return -1;
+        }
+#else
+    if( _commit( _fileno( inDB->file ) ) != 0 ) {
+        return -1;
+        }
+#endif
+    return 0;
+    }
+
+
+
+unsigned int LINEARDB3_getHeaderSize() {
+    return LINEARDB3_HEADER_SIZE;
+    }
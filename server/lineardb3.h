@@ -1,3 +1,6 @@
+#ifndef LINEARDB3_H_INCLUDED
+#define LINEARDB3_H_INCLUDED
+
 
 
 // some compilers require this to access UINT64_MAX
@@ -13,6 +16,11 @@
 #define LINEARDB3_RECORDS_PER_BUCKET 8
 
 
+// in mmap mode, the file mapping is grown in steps of this many bytes
+// as records are appended, so that we're not re-mapping on every insert
+#define LINEARDB3_MMAP_EXTENT_BYTES 67108864
+
+
 
 typedef struct {
         // index of another FingerprintBucket in the overflow array,
@@ -83,6 +91,22 @@ typedef struct {
 
         FILE *file;        
 
+        // true if this DB was opened in mmap mode
+        // (see LINEARDB3_setUseMmap)
+        // in that case, records are read from and written to mapBase
+        // directly, and new records are appended with pwrite on file's
+        // descriptor, never through file's stdio buffer
+        char useMmap;
+        
+        uint8_t *mapBase;
+        
+        // bytes currently mapped (a whole number of extents, can be
+        // larger than the file)
+        uint64_t mapSize;
+        
+        // bytes of file that contain header and records
+        uint64_t fileSize;
+
         // equal to the largest possible 32-bit table size, given
         // our current table size
         // used as mod for computing 32-bit hash fingerprints
@@ -103,6 +127,20 @@ typedef struct {
         LINEARDB3_PageManager *overflowBuckets;
         
 
+        // true after LINEARDB3_trackDirtyRecords
+        char trackDirty;
+        
+        // one bit per record number, set for records in dirtyList
+        uint8_t *dirtyBits;
+        uint32_t dirtyBitsBytes;
+        
+        // record numbers written since last LINEARDB3_takeDirtyRecords,
+        // in the order they were first written
+        uint32_t *dirtyList;
+        uint32_t numDirty;
+        uint32_t dirtyListSize;
+
+
     } LINEARDB3;
 
 
@@ -136,6 +174,28 @@ void LINEARDB3_setMaxLoad( double inMaxLoad );
 
 
 
+/**
+ * Set whether all subsequent calls to LINEARDB3_open use a memory-mapped
+ * view of the data file instead of stdio seek/read/write.
+ *
+ * Defaults to false.
+ *
+ * The file format is identical in both modes, so a file written in one
+ * mode can be opened in the other.
+ *
+ * In mmap mode, a get is a fingerprint check plus a memcmp against the
+ * mapping, with no syscalls.  Appended records are written with pwrite,
+ * and the mapping is grown in LINEARDB3_MMAP_EXTENT_BYTES steps.
+ *
+ * Ignored on platforms without mmap (Windows).
+ *
+ * Like maxLoad, a given DB remembers the mode that was set when it was
+ * opened.
+ */
+void LINEARDB3_setUseMmap( char inUseMmap );
+
+
+
 
 /**
  * Open database
@@ -290,3 +350,76 @@ uint32_t LINEARDB3_getPerfectTableSize( double inMaxLoad,
  */
 unsigned int LINEARDB3_getShrinkSize( LINEARDB3 *inDB,
                                       unsigned int inNewNumRecords );
+
+
+
+
+/**
+ * Start keeping a list of records that are written by put calls, for
+ * incremental backups.
+ *
+ * Tracking stays on until the DB is closed.  Records already in the
+ * file when this is called start out clean.
+ */
+void LINEARDB3_trackDirtyRecords( LINEARDB3 *inDB );
+
+
+
+/**
+ * Gets record numbers that have been written since tracking started
+ * or since the last call to this function, and starts a new, empty list.
+ *
+ * Record numbers are positions in the data file, and they never change
+ * while the DB is open, because records are never moved or removed.
+ * They can be read back with LINEARDB3_getRecord.
+ *
+ * @param outNumDirty pointer to where number of records should be
+ *   returned.
+ * @return array of record numbers, or NULL if none are dirty.
+ *   Destroyed by caller.
+ */
+uint32_t *LINEARDB3_takeDirtyRecords( LINEARDB3 *inDB, 
+                                      uint32_t *outNumDirty );
+
+
+
+/**
+ * Reads a record by its number in the data file.
+ *
+ * @param inRecordNumber must be less than LINEARDB3_getNumRecords.
+ * @return 0 on success, -1 on error
+ */
+int LINEARDB3_getRecord( LINEARDB3 *inDB, uint32_t inRecordNumber,
+                         void *outKey, void *outValue );
+
+
+
+/**
+ * Pushes any buffered writes out to the data file, so that another
+ * reader of the file sees every put made so far.
+ *
+ * @return 0 on success, -1 on error
+ */
+int LINEARDB3_flush( LINEARDB3 *inDB );
+
+
+
+/**
+ * Like LINEARDB3_flush, but also waits until the operating system has
+ * written every put made so far to disk, so that they survive a crash.
+ *
+ * @return 0 on success, -1 on error
+ */
+int LINEARDB3_sync( LINEARDB3 *inDB );
+
+
+
+/**
+ * Size of the header at the start of the data file.  Record number n
+ * starts at byte header size + n * ( key size + value size ).
+ */
+unsigned int LINEARDB3_getHeaderSize();
+
+
+
+#endif
@@ -0,0 +1,1554 @@
+// Drives a server with many bots at once, and measures how long the server
+// takes to answer each kind of request.
+//
+// Bots are split between worker threads.  Each worker polls all of its
+// sockets at once, so one slow bot never holds up the others.
+//
+// Each bot follows a behavior profile:
+//
+//    explore   walks in random straight lines
+//    craft     stays near its birth place, using and dropping things there
+//    chat      talks, with an occasional short walk
+//    eat       picks things up and tries to eat them
+//    shuffle   takes things out of a nearby container and puts them back
+//
+// A bot has at most one request waiting for an answer at a time, like the
+// real client.  Latency is measured from sending a request to the first
+// message about that bot that answers it:
+//
+//    LOGIN              first PU
+//    MOVE               PM or PU
+//    USE, DROP, REMV    PU or MX
+//    SELF               PU
+//    SAY                PS
+//
+// Requests with no answer after the response timeout are counted as
+// timeouts instead.
+//
+// A summary is printed every report interval, and at the end, an
+// HdrHistogram-style percentile distribution for each request type.
+//
+// Bots log in with "aaaa" as password and key hash, like
+// stressTestClient, so the server must not require client passwords or
+// tickets.  Bots that die or lose their connection log in again.
+//
+// Bots ack forced moves with FORCE, like the real client, since the server
+// ignores a player's actions until the ack arrives (requireClientForceAck).
+//
+// Each bot holds a socket open, so for thousands of bots, raise the open
+// file limit first (ulimit -n).
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+
+
+#include "minorGems/network/SocketClient.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/util/random/JenkinsRandomSource.h"
+#include "minorGems/formats/encodingUtils.h"
+
+
+
+void usage() {
+    printf( "Usage:\n" );
+    printf( "loadGenerator server_address server_port email_prefix "
+            "num_bots [num_threads] [profiles] [seconds]\n\n" );
+
+    printf( "profiles is a comma-separated list of name:weight, with names\n"
+            "from explore, craft, chat, eat, shuffle  (default explore)\n\n" );
+
+    printf( "seconds is how long to run, 0 to run forever (default 0)\n\n" );
+
+    printf( "Example:\n" );
+    printf( "loadGenerator localhost 8005 dummy 2000 8 "
+            "explore:50,craft:20,chat:10,eat:10,shuffle:10 600\n\n" );
+
+    exit( 1 );
+    }
+
+
+
+// how often summary is printed
+#define REPORT_SECONDS 10
+
+// requests with no answer after this long count as timeouts
+#define RESPONSE_TIMEOUT_SECONDS 5.0
+
+// new connections each worker makes per loop, so thousands of bots
+// don't all hit the server in the same instant
+#define CONNECTS_PER_STEP 4
+
+#define RECONNECT_DELAY_SECONDS 2.0
+
+// time between polls when worker has no sockets to poll
+#define IDLE_POLL_MS 10
+
+
+
+typedef enum RequestType {
+    REQUEST_LOGIN = 0,
+    REQUEST_MOVE,
+    REQUEST_USE,
+    REQUEST_DROP,
+    REQUEST_REMV,
+    REQUEST_SELF,
+    REQUEST_SAY,
+    NUM_REQUEST_TYPES
+    } RequestType;
+
+
+static const char *requestNames[ NUM_REQUEST_TYPES ] = {
+    "LOGIN",
+    "MOVE",
+    "USE",
+    "DROP",
+    "REMV",
+    "SELF",
+    "SAY" };
+
+
+
+typedef enum BehaviorProfile {
+    BEHAVIOR_EXPLORE = 0,
+    BEHAVIOR_CRAFT,
+    BEHAVIOR_CHAT,
+    BEHAVIOR_EAT,
+    BEHAVIOR_SHUFFLE,
+    NUM_BEHAVIORS
+    } BehaviorProfile;
+
+
+static const char *behaviorNames[ NUM_BEHAVIORS ] = {
+    "explore",
+    "craft",
+    "chat",
+    "eat",
+    "shuffle" };
+
+
+
+// messages that can answer a request
+#define ANSWER_PU 1
+#define ANSWER_PM 2
+#define ANSWER_MX 4
+#define ANSWER_PS 8
+
+
+
+// 16 buckets for each power of 2 microseconds, up to 2^32, so
+// percentiles are accurate to within about 6%
+#define LATENCY_SUB_BITS 4
+#define LATENCY_SUB_BUCKETS ( 1 << LATENCY_SUB_BITS )
+#define NUM_LATENCY_BUCKETS ( LATENCY_SUB_BUCKETS * 29 )
+
+
+typedef struct LatencyHistogram {
+        unsigned int count;
+        unsigned int timeouts;
+        double totalSeconds;
+        double maxSeconds;
+
+        unsigned int buckets[ NUM_LATENCY_BUCKETS ];
+    } LatencyHistogram;
+
+
+
+typedef struct LoadStats {
+        LatencyHistogram latency[ NUM_REQUEST_TYPES ];
+
+        unsigned int connects;
+        unsigned int connectFailures;
+        unsigned int disconnects;
+        unsigned int deaths;
+
+        unsigned int messagesReceived;
+        double bytesReceived;
+        double bytesSent;
+    } LoadStats;
+
+
+
+static int getLatencyBucket( double inSeconds ) {
+    double micro = inSeconds * 1000000;
+
+    if( micro < LATENCY_SUB_BUCKETS ) {
+        if( micro < 0 ) {
+            return 0;
+            }
+        return (int)micro;
+        }
+    if( micro >= 4294967295.0 ) {
+        return NUM_LATENCY_BUCKETS - 1;
+        }
+
+    unsigned int v = (unsigned int)micro;
+
+    // highest bit set
+    int e = 31;
+    while( ( v & ( 1u << e ) ) == 0 ) {
+        e--;
+        }
+
+    // next bits pick the bucket within this power of 2
+    int sub = ( v >> ( e - LATENCY_SUB_BITS ) ) & ( LATENCY_SUB_BUCKETS - 1 );
+
+    return LATENCY_SUB_BUCKETS * ( e - LATENCY_SUB_BITS + 1 ) + sub;
+    }
+
+
+
+// top of range covered by bucket, in seconds
+static double getLatencyBucketTop( int inBucket ) {
+    if( inBucket < LATENCY_SUB_BUCKETS ) {
+        return ( inBucket + 1 ) / 1000000.0;
+        }
+
+    int e = inBucket / LATENCY_SUB_BUCKETS + LATENCY_SUB_BITS - 1;
+    int sub = inBucket % LATENCY_SUB_BUCKETS;
+
+    double width = (double)( 1u << ( e - LATENCY_SUB_BITS ) );
+    double bottom = ( LATENCY_SUB_BUCKETS + sub ) * width;
+
+    return ( bottom + width ) / 1000000.0;
+    }
+
+
+
+static void recordLatency( LatencyHistogram *inHist, double inSeconds ) {
+    inHist->count++;
+    inHist->totalSeconds += inSeconds;
+
+    if( inSeconds > inHist->maxSeconds ) {
+        inHist->maxSeconds = inSeconds;
+        }
+
+    inHist->buckets[ getLatencyBucket( inSeconds ) ]++;
+    }
+
+
+
+static void addStats( LoadStats *inTo, LoadStats *inFrom ) {
+    for( int r=0; r<NUM_REQUEST_TYPES; r++ ) {
+        LatencyHistogram *to = &( inTo->latency[r] );
+        LatencyHistogram *from = &( inFrom->latency[r] );
+
+        to->count += from->count;
+        to->timeouts += from->timeouts;
+        to->totalSeconds += from->totalSeconds;
+
+        if( from->maxSeconds > to->maxSeconds ) {
+            to->maxSeconds = from->maxSeconds;
+            }
+
+        for( int b=0; b<NUM_LATENCY_BUCKETS; b++ ) {
+            to->buckets[b] += from->buckets[b];
+            }
+        }
+
+    inTo->connects += inFrom->connects;
+    inTo->connectFailures += inFrom->connectFailures;
+    inTo->disconnects += inFrom->disconnects;
+    inTo->deaths += inFrom->deaths;
+    inTo->messagesReceived += inFrom->messagesReceived;
+    inTo->bytesReceived += inFrom->bytesReceived;
+    inTo->bytesSent += inFrom->bytesSent;
+    }
+
+
+
+// never more than max seen, since top of bucket can be past it
+//
+// outCountAtOrBelow, if not NULL, is set to number of samples in buckets
+// up to the one returned
+static double getLatencyPercentile( LatencyHistogram *inHist,
+                                    double inFraction,
+                                    unsigned int *outCountAtOrBelow = NULL ) {
+    if( outCountAtOrBelow != NULL ) {
+        *outCountAtOrBelow = inHist->count;
+        }
+
+    if( inHist->count == 0 ) {
+        return 0;
+        }
+
+    unsigned int target = (unsigned int)( inFraction * inHist->count );
+
+    if( target >= inHist->count ) {
+        target = inHist->count - 1;
+        }
+
+    unsigned int seen = 0;
+
+    for( int b=0; b<NUM_LATENCY_BUCKETS; b++ ) {
+        seen += inHist->buckets[b];
+
+        if( seen > target ) {
+            if( outCountAtOrBelow != NULL ) {
+                *outCountAtOrBelow = seen;
+                }
+
+            double top = getLatencyBucketTop( b );
+
+            if( top > inHist->maxSeconds ) {
+                top = inHist->maxSeconds;
+                }
+            return top;
+            }
+        }
+
+    return inHist->maxSeconds;
+    }
+
+
+
+typedef struct Bot {
+        int i;
+
+        char *email;
+
+        BehaviorProfile behavior;
+
+        // NULL if not connected
+        Socket *sock;
+        int fd;
+
+        SimpleVector<unsigned char> buffer;
+
+        int skipCompressedData;
+
+        char pendingCMData;
+        int pendingCMCompressedSize;
+        int pendingCMDecompressedSize;
+
+        // -1 until first PU arrives
+        int id;
+        int x, y;
+        int baseX, baseY;
+
+        int holdingID;
+        char moving;
+        int moveSeqNum;
+
+        // adjacent cell that shuffle bots use as their container
+        int shuffleXOffset, shuffleYOffset;
+
+        char pending;
+        RequestType pendingType;
+        int pendingAnswers;
+        double pendingStartTime;
+
+        double nextActionTime;
+        double reconnectTime;
+    } Bot;
+
+
+
+static char *serverAddress = NULL;
+static int serverPort = 8005;
+
+
+
+static int getSocketFD( Socket *inSock ) {
+    return ( (int *)( inSock->mNativeObjectPointer ) )[0];
+    }
+
+
+
+static void resetBot( Bot *inBot ) {
+    inBot->buffer.deleteAll();
+    inBot->skipCompressedData = 0;
+    inBot->pendingCMData = false;
+    inBot->id = -1;
+    inBot->x = 0;
+    inBot->y = 0;
+    inBot->baseX = 0;
+    inBot->baseY = 0;
+    inBot->holdingID = 0;
+    inBot->moving = false;
+    inBot->moveSeqNum = 2;
+    inBot->pending = false;
+    }
+
+
+
+// NULL if no whole message in buffer
+//
+// only looks at bytes already received
+static char *getNextMessage( Bot *inBot ) {
+
+    if( inBot->skipCompressedData > 0 ) {
+        int numToDelete = inBot->skipCompressedData;
+
+        if( numToDelete > inBot->buffer.size() ) {
+            numToDelete = inBot->buffer.size();
+            }
+
+        inBot->buffer.deleteStartElements( numToDelete );
+        inBot->skipCompressedData -= numToDelete;
+
+        if( inBot->skipCompressedData > 0 ) {
+            return NULL;
+            }
+        }
+
+
+    if( inBot->pendingCMData ) {
+        if( inBot->buffer.size() < inBot->pendingCMCompressedSize ) {
+            // wait for more data to arrive
+            return NULL;
+            }
+
+        inBot->pendingCMData = false;
+
+        unsigned char *decompressedMessage =
+            zipDecompress( inBot->buffer.getElement( 0 ),
+                           inBot->pendingCMCompressedSize,
+                           inBot->pendingCMDecompressedSize );
+
+        inBot->buffer.deleteStartElements( inBot->pendingCMCompressedSize );
+
+        if( decompressedMessage == NULL ) {
+            printf( "Bot %d failed to decompress CM message\n", inBot->i );
+            return NULL;
+            }
+
+        char *textMessage = new char[ inBot->pendingCMDecompressedSize + 1 ];
+        memcpy( textMessage, decompressedMessage,
+                inBot->pendingCMDecompressedSize );
+        textMessage[ inBot->pendingCMDecompressedSize ] = '\0';
+
+        delete [] decompressedMessage;
+
+        // drop terminal character, if it was compressed too
+        char *end = strchr( textMessage, '#' );
+        if( end != NULL ) {
+            end[0] = '\0';
+            }
+
+        return textMessage;
+        }
+
+
+    // find first terminal character #
+    int index = inBot->buffer.getElementIndex( '#' );
+
+    if( index == -1 ) {
+        return NULL;
+        }
+
+    char *message = new char[ index + 1 ];
+
+    // all but terminal character
+    memcpy( message, inBot->buffer.getElement( 0 ), index );
+    message[ index ] = '\0';
+
+    // delete from buffer, including terminal character
+    inBot->buffer.deleteStartElements( index + 1 );
+
+
+    if( strstr( message, "CM" ) == message ) {
+        inBot->pendingCMData = true;
+
+        sscanf( message, "CM\n%d %d\n",
+                &( inBot->pendingCMDecompressedSize ),
+                &( inBot->pendingCMCompressedSize ) );
+
+        delete [] message;
+
+        // data may already be here
+        return getNextMessage( inBot );
+        }
+
+    if( strstr( message, "MC" ) == message ) {
+        // bots don't look at map, skip chunk data
+        int sizeX, sizeY, x, y, binarySize, compSize;
+        compSize = 0;
+        sscanf( message, "MC\n%d %d %d %d\n%d %d\n",
+                &sizeX, &sizeY, &x, &y, &binarySize, &compSize );
+
+        inBot->skipCompressedData = compSize;
+        }
+
+    return message;
+    }
+
+
+
+class BotWorker : public Thread {
+
+    public:
+
+        // bots are not destroyed by worker
+        BotWorker( Bot *inBots, int inNumBots, unsigned int inSeed );
+
+        ~BotWorker();
+
+
+        void stop();
+
+
+        // adds stats since last call to ioStats
+        void takeStats( LoadStats *ioStats );
+
+        // bots logged in, and bots connected but not yet logged in
+        void getBotCounts( int *outLive, int *outConnecting );
+
+
+        virtual void run();
+
+
+    private:
+
+        Bot *mBots;
+        int mNumBots;
+
+        JenkinsRandomSource mRandSource;
+
+        // stats since last merged into mSharedStats
+        LoadStats mLocalStats;
+
+        MutexLock mLock;
+
+        // rest protected by mLock
+        LoadStats mSharedStats;
+        int mNumLive;
+        int mNumConnecting;
+        char mStopped;
+
+
+        char isStopped();
+
+        void connectBot( Bot *inBot, double inCurrentTime );
+
+        void disconnectBot( Bot *inBot, double inCurrentTime );
+
+        // false if connection lost
+        char sendMessage( Bot *inBot, const char *inMessage );
+
+        void sendRequest( Bot *inBot, RequestType inType, int inAnswers,
+                          const char *inMessage, double inCurrentTime );
+
+        void answer( Bot *inBot, int inAnswer, double inCurrentTime );
+
+        void readBot( Bot *inBot, double inCurrentTime );
+
+        void handleMessage( Bot *inBot, char *inMessage,
+                            double inCurrentTime );
+
+        void parseOwnPlayerUpdate( Bot *inBot,
+                                   SimpleVector<char*> *inTokens,
+                                   double inCurrentTime );
+
+        void stepBot( Bot *inBot, double inCurrentTime );
+
+        void sendMove( Bot *inBot, int inXDelt, int inYDelt, int inSteps,
+                       double inCurrentTime );
+
+        void sendRandomMove( Bot *inBot, int inMaxSteps,
+                             double inCurrentTime );
+
+        void pickAdjacent( int *outXOffset, int *outYOffset );
+    };
+
+
+
+BotWorker::BotWorker( Bot *inBots, int inNumBots, unsigned int inSeed )
+        : mBots( inBots ), mNumBots( inNumBots ),
+          mRandSource( inSeed ),
+          mNumLive( 0 ), mNumConnecting( 0 ),
+          mStopped( false ) {
+
+    memset( &mLocalStats, 0, sizeof( LoadStats ) );
+    memset( &mSharedStats, 0, sizeof( LoadStats ) );
+    }
+
+
+
+BotWorker::~BotWorker() {
+    for( int i=0; i<mNumBots; i++ ) {
+        if( mBots[i].sock != NULL ) {
+            delete mBots[i].sock;
+            mBots[i].sock = NULL;
+            }
+        }
+    }
+
+
+
+void BotWorker::stop() {
+    mLock.lock();
+    mStopped = true;
+    mLock.unlock();
+    }
+
+
+
+char BotWorker::isStopped() {
+    mLock.lock();
+    char stopped = mStopped;
+    mLock.unlock();
+
+    return stopped;
+    }
+
+
+
+void BotWorker::takeStats( LoadStats *ioStats ) {
+    mLock.lock();
+    addStats( ioStats, &mSharedStats );
+    memset( &mSharedStats, 0, sizeof( LoadStats ) );
+    mLock.unlock();
+    }
+
+
+
+void BotWorker::getBotCounts( int *outLive, int *outConnecting ) {
+    mLock.lock();
+    *outLive = mNumLive;
+    *outConnecting = mNumConnecting;
+    mLock.unlock();
+    }
+
+
+
+void BotWorker::connectBot( Bot *inBot, double inCurrentTime ) {
+    resetBot( inBot );
+
+    HostAddress a( stringDuplicate( serverAddress ), serverPort );
+
+    char timeout = false;
+    inBot->sock = SocketClient::connectToServer( &a, 5000, &timeout );
+
+    if( timeout && inBot->sock != NULL ) {
+        delete inBot->sock;
+        inBot->sock = NULL;
+        }
+
+    if( inBot->sock == NULL ) {
+        mLocalStats.connectFailures++;
+        inBot->reconnectTime = inCurrentTime + RECONNECT_DELAY_SECONDS;
+        return;
+        }
+
+    inBot->fd = getSocketFD( inBot->sock );
+
+    mLocalStats.connects++;
+
+    // LOGIN is sent once SN arrives, but count time from here, since
+    // that's what a player waits through
+    inBot->pending = true;
+    inBot->pendingType = REQUEST_LOGIN;
+    inBot->pendingAnswers = ANSWER_PU;
+    inBot->pendingStartTime = inCurrentTime;
+    }
+
+
+
+void BotWorker::disconnectBot( Bot *inBot, double inCurrentTime ) {
+    delete inBot->sock;
+    inBot->sock = NULL;
+
+    inBot->reconnectTime = inCurrentTime + RECONNECT_DELAY_SECONDS;
+
+    resetBot( inBot );
+    }
+
+
+
+char BotWorker::sendMessage( Bot *inBot, const char *inMessage ) {
+    int len = strlen( inMessage );
+
+    int numSent =
+        inBot->sock->send( (unsigned char*)inMessage, len, true, false );
+
+    if( numSent != len ) {
+        return false;
+        }
+
+    mLocalStats.bytesSent += len;
+    return true;
+    }
+
+
+
+void BotWorker::sendRequest( Bot *inBot, RequestType inType, int inAnswers,
+                             const char *inMessage, double inCurrentTime ) {
+    if( ! sendMessage( inBot, inMessage ) ) {
+        mLocalStats.disconnects++;
+        disconnectBot( inBot, inCurrentTime );
+        return;
+        }
+
+    inBot->pending = true;
+    inBot->pendingType = inType;
+    inBot->pendingAnswers = inAnswers;
+    inBot->pendingStartTime = inCurrentTime;
+    }
+
+
+
+void BotWorker::answer( Bot *inBot, int inAnswer, double inCurrentTime ) {
+    if( ! inBot->pending || ( inBot->pendingAnswers & inAnswer ) == 0 ) {
+        return;
+        }
+
+    recordLatency( &( mLocalStats.latency[ inBot->pendingType ] ),
+                   inCurrentTime - inBot->pendingStartTime );
+
+    inBot->pending = false;
+    }
+
+
+
+void BotWorker::readBot( Bot *inBot, double inCurrentTime ) {
+    unsigned char buffer[4096];
+
+    int numRead = inBot->sock->receive( buffer, sizeof( buffer ), 0 );
+
+    while( numRead > 0 ) {
+        inBot->buffer.appendArray( buffer, numRead );
+        mLocalStats.bytesReceived += numRead;
+
+        numRead = inBot->sock->receive( buffer, sizeof( buffer ), 0 );
+        }
+
+    char lost = ( numRead == -1 );
+
+    char *message = getNextMessage( inBot );
+
+    while( message != NULL ) {
+        mLocalStats.messagesReceived++;
+
+        handleMessage( inBot, message, inCurrentTime );
+        delete [] message;
+
+        if( inBot->sock == NULL ) {
+            // message ended connection
+            return;
+            }
+
+        message = getNextMessage( inBot );
+        }
+
+    if( lost ) {
+        mLocalStats.disconnects++;
+        disconnectBot( inBot, inCurrentTime );
+        }
+    }
+
+
+
+void BotWorker::parseOwnPlayerUpdate( Bot *inBot,
+                                      SimpleVector<char*> *inTokens,
+                                      double inCurrentTime ) {
+
+    if( strcmp( inTokens->getElementDirect(14), "X" ) == 0 ) {
+        mLocalStats.deaths++;
+        disconnectBot( inBot, inCurrentTime );
+        return;
+        }
+
+    sscanf( inTokens->getElementDirect(6), "%d", &( inBot->holdingID ) );
+
+    sscanf( inTokens->getElementDirect(14), "%d", &( inBot->x ) );
+    sscanf( inTokens->getElementDirect(15), "%d", &( inBot->y ) );
+
+    int doneMoving = 0;
+    sscanf( inTokens->getElementDirect(12), "%d", &doneMoving );
+
+    int forced = 0;
+    sscanf( inTokens->getElementDirect(13), "%d", &forced );
+
+    if( doneMoving > 0 || forced ) {
+        inBot->moving = false;
+        }
+
+    if( forced ) {
+        // ack, like the real client, or server ignores our actions
+        char *force = autoSprintf( "FORCE %d %d#", inBot->x, inBot->y );
+
+        char sent = sendMessage( inBot, force );
+        delete [] force;
+
+        if( ! sent ) {
+            mLocalStats.disconnects++;
+            disconnectBot( inBot, inCurrentTime );
+            return;
+            }
+        }
+
+    answer( inBot, ANSWER_PU, inCurrentTime );
+    }
+
+
+
+void BotWorker::handleMessage( Bot *inBot, char *inMessage,
+                               double inCurrentTime ) {
+
+    if( strstr( inMessage, "SN" ) == inMessage ) {
+        char *login = autoSprintf( "LOGIN %s aaaa aaaa#", inBot->email );
+
+        if( ! sendMessage( inBot, login ) ) {
+            mLocalStats.disconnects++;
+            disconnectBot( inBot, inCurrentTime );
+            }
+        delete [] login;
+        return;
+        }
+
+    if( strstr( inMessage, "REJECTED" ) == inMessage ||
+        strstr( inMessage, "SERVER_FULL" ) == inMessage ||
+        strstr( inMessage, "SHUTDOWN" ) == inMessage ) {
+
+        printf( "Bot %d turned away by server:  %s\n", inBot->i, inMessage );
+
+        mLocalStats.disconnects++;
+        disconnectBot( inBot, inCurrentTime );
+        return;
+        }
+
+
+    int answerType = 0;
+
+    if( strstr( inMessage, "PU" ) == inMessage ) {
+        answerType = ANSWER_PU;
+        }
+    else if( strstr( inMessage, "PM" ) == inMessage ) {
+        answerType = ANSWER_PM;
+        }
+    else if( strstr( inMessage, "MX" ) == inMessage ) {
+        answerType = ANSWER_MX;
+        }
+    else if( strstr( inMessage, "PS" ) == inMessage ) {
+        answerType = ANSWER_PS;
+        }
+
+    if( answerType == 0 ) {
+        return;
+        }
+
+
+    int numLines;
+    char **lines = split( inMessage, "\n", &numLines );
+
+    if( answerType == ANSWER_PU && inBot->id == -1 && numLines > 1 ) {
+        // first PU, last line describes us
+        int id = -1;
+        sscanf( lines[ numLines - 1 ], "%d", &id );
+
+        if( id == -1 && numLines > 2 ) {
+            // message ended with newline
+            sscanf( lines[ numLines - 2 ], "%d", &id );
+            }
+        inBot->id = id;
+        }
+
+    for( int p=1; p<numLines && inBot->sock != NULL; p++ ) {
+
+        if( answerType == ANSWER_PS ) {
+            // p_id/isCurse text
+            int id = -1;
+            sscanf( lines[p], "%d", &id );
+
+            if( id == inBot->id ) {
+                answer( inBot, ANSWER_PS, inCurrentTime );
+                }
+            continue;
+            }
+
+        SimpleVector<char*> *tokens = tokenizeString( lines[p] );
+
+        if( answerType == ANSWER_PU ) {
+            if( tokens->size() > 16 ) {
+                int id = -1;
+                sscanf( tokens->getElementDirect(0), "%d", &id );
+
+                if( id == inBot->id ) {
+                    char firstUpdate = ( inBot->pending &&
+                                         inBot->pendingType ==
+                                         REQUEST_LOGIN );
+
+                    parseOwnPlayerUpdate( inBot, tokens, inCurrentTime );
+
+                    if( firstUpdate && inBot->sock != NULL ) {
+                        inBot->baseX = inBot->x;
+                        inBot->baseY = inBot->y;
+                        pickAdjacent( &( inBot->shuffleXOffset ),
+                                      &( inBot->shuffleYOffset ) );
+                        inBot->nextActionTime = inCurrentTime;
+                        }
+                    }
+                }
+            }
+        else if( answerType == ANSWER_PM ) {
+            if( tokens->size() > 0 ) {
+                int id = -1;
+                sscanf( tokens->getElementDirect(0), "%d", &id );
+
+                if( id == inBot->id ) {
+                    answer( inBot, ANSWER_PM, inCurrentTime );
+                    }
+                }
+            }
+        else if( answerType == ANSWER_MX ) {
+            // x y new_floor_id new_id p_id
+            if( tokens->size() > 4 ) {
+                int id = -1;
+                sscanf( tokens->getElementDirect(4), "%d", &id );
+
+                if( id == inBot->id ) {
+                    answer( inBot, ANSWER_MX, inCurrentTime );
+                    }
+                }
+            }
+
+        tokens->deallocateStringElements();
+        delete tokens;
+        }
+
+    for( int p=0; p<numLines; p++ ) {
+        delete [] lines[p];
+        }
+    delete [] lines;
+    }
+
+
+
+void BotWorker::pickAdjacent( int *outXOffset, int *outYOffset ) {
+    *outXOffset = 0;
+    *outYOffset = 0;
+
+    while( *outXOffset == 0 && *outYOffset == 0 ) {
+        *outXOffset = mRandSource.getRandomBoundedInt( -1, 1 );
+        *outYOffset = mRandSource.getRandomBoundedInt( -1, 1 );
+        }
+    }
+
+
+
+// straight line of inSteps steps of inXDelt, inYDelt
+void BotWorker::sendMove( Bot *inBot, int inXDelt, int inYDelt, int inSteps,
+                          double inCurrentTime ) {
+
+    SimpleVector<char> message;
+
+    char *start = autoSprintf( "MOVE %d %d @%d", inBot->x, inBot->y,
+                               inBot->moveSeqNum );
+    message.appendElementString( start );
+    delete [] start;
+
+    for( int s=1; s<=inSteps; s++ ) {
+        char *step = autoSprintf( " %d %d", s * inXDelt, s * inYDelt );
+        message.appendElementString( step );
+        delete [] step;
+        }
+    message.push_back( '#' );
+
+    char *text = message.getElementString();
+
+    inBot->moveSeqNum++;
+    inBot->moving = true;
+
+    sendRequest( inBot, REQUEST_MOVE, ANSWER_PM | ANSWER_PU, text,
+                 inCurrentTime );
+
+    delete [] text;
+    }
+
+
+
+void BotWorker::sendRandomMove( Bot *inBot, int inMaxSteps,
+                                double inCurrentTime ) {
+    int xDelt, yDelt;
+    pickAdjacent( &xDelt, &yDelt );
+
+    sendMove( inBot, xDelt, yDelt,
+              mRandSource.getRandomBoundedInt( 1, inMaxSteps ),
+              inCurrentTime );
+    }
+
+
+
+static int sign( int inX ) {
+    if( inX > 0 ) {
+        return 1;
+        }
+    if( inX < 0 ) {
+        return -1;
+        }
+    return 0;
+    }
+
+
+
+void BotWorker::stepBot( Bot *inBot, double inCurrentTime ) {
+    if( inBot->pending ) {
+        if( inCurrentTime - inBot->pendingStartTime >
+            RESPONSE_TIMEOUT_SECONDS ) {
+
+            mLocalStats.latency[ inBot->pendingType ].timeouts++;
+            inBot->pending = false;
+
+            if( inBot->pendingType == REQUEST_MOVE ) {
+                // PU that ends move may have been lost in the shuffle
+                inBot->moving = false;
+                }
+            }
+        return;
+        }
+
+    if( inBot->id == -1 || inCurrentTime < inBot->nextActionTime ) {
+        return;
+        }
+
+    // actions other than SAY are ignored by server during moves
+    if( inBot->moving && inBot->behavior != BEHAVIOR_CHAT ) {
+        return;
+        }
+
+
+    int xOff, yOff;
+    pickAdjacent( &xOff, &yOff );
+
+    int x = inBot->x + xOff;
+    int y = inBot->y + yOff;
+
+    char *message = NULL;
+    RequestType type = REQUEST_USE;
+    int answers = ANSWER_PU | ANSWER_MX;
+
+    double minThink = 1;
+    double maxThink = 3;
+
+    switch( inBot->behavior ) {
+        case BEHAVIOR_EXPLORE:
+            sendRandomMove( inBot, 8, inCurrentTime );
+            minThink = 0.25;
+            maxThink = 1;
+            break;
+
+        case BEHAVIOR_CRAFT: {
+            int xDist = inBot->baseX - inBot->x;
+            int yDist = inBot->baseY - inBot->y;
+
+            if( abs( xDist ) > 5 || abs( yDist ) > 5 ) {
+                // wandered too far from base, head back
+                int steps = abs( xDist );
+                if( abs( yDist ) > steps ) {
+                    steps = abs( yDist );
+                    }
+                if( steps > 4 ) {
+                    steps = 4;
+                    }
+                sendMove( inBot, sign( xDist ), sign( yDist ), steps,
+                          inCurrentTime );
+                }
+            else if( mRandSource.getRandomBoundedInt( 0, 5 ) == 0 ) {
+                sendRandomMove( inBot, 2, inCurrentTime );
+                }
+            else if( inBot->holdingID != 0 &&
+                     mRandSource.getRandomBoolean() ) {
+                type = REQUEST_DROP;
+                message = autoSprintf( "DROP %d %d -1#", x, y );
+                }
+            else {
+                message = autoSprintf( "USE %d %d#", x, y );
+                }
+            break;
+            }
+
+        case BEHAVIOR_CHAT:
+            if( ! inBot->moving &&
+                mRandSource.getRandomBoundedInt( 0, 3 ) == 0 ) {
+                sendRandomMove( inBot, 3, inCurrentTime );
+                }
+            else {
+                static const char *phrases[] = {
+                    "HELLO", "HI THERE", "I NEED FOOD", "WHERE IS MOM",
+                    "LOOK AT THIS", "FOLLOW ME", "GOOD BYE" };
+
+                type = REQUEST_SAY;
+                answers = ANSWER_PS;
+                message = autoSprintf(
+                    "SAY 0 0 %s#",
+                    phrases[ mRandSource.getRandomBoundedInt( 0, 6 ) ] );
+                }
+            minThink = 2;
+            maxThink = 6;
+            break;
+
+        case BEHAVIOR_EAT:
+            if( inBot->holdingID > 0 ) {
+                type = REQUEST_SELF;
+                answers = ANSWER_PU;
+                message = autoSprintf( "SELF %d %d -1#",
+                                       inBot->x, inBot->y );
+                }
+            else if( mRandSource.getRandomBoundedInt( 0, 3 ) == 0 ) {
+                sendRandomMove( inBot, 4, inCurrentTime );
+                }
+            else {
+                message = autoSprintf( "USE %d %d#", x, y );
+                }
+            break;
+
+        case BEHAVIOR_SHUFFLE: {
+            if( mRandSource.getRandomBoundedInt( 0, 9 ) == 0 ) {
+                // try a different neighbor as the container
+                pickAdjacent( &( inBot->shuffleXOffset ),
+                              &( inBot->shuffleYOffset ) );
+                }
+
+            int cX = inBot->x + inBot->shuffleXOffset;
+            int cY = inBot->y + inBot->shuffleYOffset;
+
+            if( inBot->holdingID != 0 ) {
+                type = REQUEST_DROP;
+                message = autoSprintf( "DROP %d %d -1#", cX, cY );
+                }
+            else {
+                type = REQUEST_REMV;
+                message = autoSprintf( "REMV %d %d -1#", cX, cY );
+                }
+            break;
+            }
+
+        default:
+            break;
+        }
+
+    if( message != NULL ) {
+        sendRequest( inBot, type, answers, message, inCurrentTime );
+        delete [] message;
+        }
+
+    inBot->nextActionTime =
+        inCurrentTime + mRandSource.getRandomBoundedDouble( minThink,
+                                                            maxThink );
+    }
+
+
+
+void BotWorker::run() {
+    struct pollfd *fds = new struct pollfd[ mNumBots ];
+    Bot **fdBots = new Bot*[ mNumBots ];
+
+    double lastShareTime = 0;
+
+    while( ! isStopped() ) {
+        double currentTime = Time::getCurrentTime();
+
+        int connectsLeft = CONNECTS_PER_STEP;
+        int numFDs = 0;
+
+        for( int i=0; i<mNumBots; i++ ) {
+            Bot *b = &( mBots[i] );
+
+            if( b->sock == NULL ) {
+                if( connectsLeft == 0 || currentTime < b->reconnectTime ) {
+                    continue;
+                    }
+                connectsLeft--;
+
+                connectBot( b, currentTime );
+
+                if( b->sock == NULL ) {
+                    continue;
+                    }
+                }
+
+            fds[ numFDs ].fd = b->fd;
+            fds[ numFDs ].events = POLLIN;
+            fds[ numFDs ].revents = 0;
+            fdBots[ numFDs ] = b;
+            numFDs++;
+            }
+
+
+        int pollMS = 1;
+        if( numFDs == 0 ) {
+            pollMS = IDLE_POLL_MS;
+            }
+
+        int numReady = poll( fds, numFDs, pollMS );
+
+        currentTime = Time::getCurrentTime();
+
+        for( int f=0; f<numFDs && numReady > 0; f++ ) {
+            if( fds[f].revents != 0 ) {
+                numReady--;
+                readBot( fdBots[f], currentTime );
+                }
+            }
+
+
+        int numLive = 0;
+        int numConnecting = 0;
+
+        for( int i=0; i<mNumBots; i++ ) {
+            Bot *b = &( mBots[i] );
+
+            if( b->sock == NULL ) {
+                continue;
+                }
+
+            stepBot( b, currentTime );
+
+            if( b->sock == NULL ) {
+                continue;
+                }
+
+            if( b->id == -1 ) {
+                numConnecting++;
+                }
+            else {
+                numLive++;
+                }
+            }
+
+
+        // share stats with main thread now and then, not on every step,
+        // to keep lock traffic down
+        if( currentTime - lastShareTime > 0.1 ) {
+            mLock.lock();
+            addStats( &mSharedStats, &mLocalStats );
+            mNumLive = numLive;
+            mNumConnecting = numConnecting;
+            mLock.unlock();
+
+            memset( &mLocalStats, 0, sizeof( LoadStats ) );
+            lastShareTime = currentTime;
+            }
+        }
+
+    mLock.lock();
+    addStats( &mSharedStats, &mLocalStats );
+    mLock.unlock();
+
+    memset( &mLocalStats, 0, sizeof( LoadStats ) );
+
+    delete [] fds;
+    delete [] fdBots;
+    }
+
+
+
+static void printSummary( LoadStats *inStats, double inSeconds,
+                          int inNumLive, int inNumConnecting,
+                          int inNumBots ) {
+
+    printf( "\n[%.0fs] %d live, %d connecting, of %d bots.  "
+            "%u connects (%u failed), %u disconnects, %u deaths\n",
+            inSeconds, inNumLive, inNumConnecting, inNumBots,
+            inStats->connects, inStats->connectFailures,
+            inStats->disconnects, inStats->deaths );
+
+    printf( "    %u messages in, %.1f KiB/s in, %.1f KiB/s out\n",
+            inStats->messagesReceived,
+            inStats->bytesReceived / 1024 / REPORT_SECONDS,
+            inStats->bytesSent / 1024 / REPORT_SECONDS );
+
+    printf( "    %-6s %8s %9s %9s %9s %9s %9s\n",
+            "type", "count", "p50_ms", "p90_ms", "p99_ms", "max_ms",
+            "timeouts" );
+
+    for( int r=0; r<NUM_REQUEST_TYPES; r++ ) {
+        LatencyHistogram *h = &( inStats->latency[r] );
+
+        if( h->count == 0 && h->timeouts == 0 ) {
+            continue;
+            }
+
+        printf( "    %-6s %8u %9.2f %9.2f %9.2f %9.2f %9u\n",
+                requestNames[r], h->count,
+                getLatencyPercentile( h, 0.5 ) * 1000,
+                getLatencyPercentile( h, 0.9 ) * 1000,
+                getLatencyPercentile( h, 0.99 ) * 1000,
+                h->maxSeconds * 1000,
+                h->timeouts );
+        }
+    fflush( stdout );
+    }
+
+
+
+// same layout as HdrHistogram's percentile output, so its plotting
+// tools can read it
+static void printDistribution( const char *inName,
+                               LatencyHistogram *inHist ) {
+    static const double percentiles[] = {
+        0.0, 0.5, 0.75, 0.875, 0.9, 0.95, 0.99, 0.995, 0.999, 0.9999, 1.0 };
+
+    int numPercentiles = sizeof( percentiles ) / sizeof( double );
+
+    printf( "\n# %s latency in ms, %u timeouts\n", inName, inHist->timeouts );
+
+    printf( "%12s %14s %10s %14s\n\n",
+            "Value", "Percentile", "TotalCount", "1/(1-Percentile)" );
+
+    for( int p=0; p<numPercentiles; p++ ) {
+        unsigned int countAtOrBelow;
+
+        double value = getLatencyPercentile( inHist, percentiles[p],
+                                             &countAtOrBelow );
+
+        if( percentiles[p] < 1.0 ) {
+            printf( "%12.3f %14.12f %10u %14.2f\n",
+                    value * 1000, percentiles[p], countAtOrBelow,
+                    1.0 / ( 1.0 - percentiles[p] ) );
+            }
+        else {
+            printf( "%12.3f %14.12f %10u\n",
+                    value * 1000, percentiles[p], countAtOrBelow );
+            }
+        }
+
+    double mean = 0;
+    if( inHist->count > 0 ) {
+        mean = inHist->totalSeconds / inHist->count;
+        }
+
+    printf( "#[Mean    = %12.3f, Max     = %12.3f]\n",
+            mean * 1000, inHist->maxSeconds * 1000 );
+    printf( "#[Total count    = %12u]\n", inHist->count );
+    }
+
+
+
+// profiles are name:weight pairs, weight optional
+//
+// fills inWeights, returns false on bad list
+static char parseProfiles( const char *inList, int *inWeights ) {
+    for( int b=0; b<NUM_BEHAVIORS; b++ ) {
+        inWeights[b] = 0;
+        }
+
+    int numParts;
+    char **parts = split( inList, ",", &numParts );
+
+    char good = true;
+
+    for( int p=0; p<numParts; p++ ) {
+        char *colon = strchr( parts[p], ':' );
+
+        int weight = 1;
+
+        if( colon != NULL ) {
+            colon[0] = '\0';
+            sscanf( &( colon[1] ), "%d", &weight );
+            }
+
+        char found = false;
+
+        for( int b=0; b<NUM_BEHAVIORS; b++ ) {
+            if( strcmp( parts[p], behaviorNames[b] ) == 0 ) {
+                inWeights[b] += weight;
+                found = true;
+                }
+            }
+
+        if( ! found ) {
+            printf( "Unknown profile:  %s\n", parts[p] );
+            good = false;
+            }
+
+        delete [] parts[p];
+        }
+    delete [] parts;
+
+    int total = 0;
+    for( int b=0; b<NUM_BEHAVIORS; b++ ) {
+        total += inWeights[b];
+        }
+
+    if( total <= 0 ) {
+        good = false;
+        }
+
+    return good;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    if( inNumArgs < 5 || inNumArgs > 8 ) {
+        usage();
+        }
+
+    serverAddress = inArgs[1];
+
+    sscanf( inArgs[2], "%d", &serverPort );
+
+    char *emailPrefix = inArgs[3];
+
+    int numBots = 1;
+    sscanf( inArgs[4], "%d", &numBots );
+
+    int numThreads = 4;
+    if( inNumArgs > 5 ) {
+        sscanf( inArgs[5], "%d", &numThreads );
+        }
+
+    const char *profileList = "explore";
+    if( inNumArgs > 6 ) {
+        profileList = inArgs[6];
+        }
+
+    int runSeconds = 0;
+    if( inNumArgs > 7 ) {
+        sscanf( inArgs[7], "%d", &runSeconds );
+        }
+
+    if( numBots < 1 ) {
+        numBots = 1;
+        }
+    if( numThreads < 1 ) {
+        numThreads = 1;
+        }
+    if( numThreads > numBots ) {
+        numThreads = numBots;
+        }
+
+    int weights[ NUM_BEHAVIORS ];
+
+    if( ! parseProfiles( profileList, weights ) ) {
+        usage();
+        }
+
+    int totalWeight = 0;
+    for( int b=0; b<NUM_BEHAVIORS; b++ ) {
+        totalWeight += weights[b];
+        }
+
+
+    // spread profiles evenly through bots, so each thread gets the
+    // same mix
+    Bot *bots = new Bot[ numBots ];
+
+    int behaviorCounts[ NUM_BEHAVIORS ];
+    memset( behaviorCounts, 0, sizeof( behaviorCounts ) );
+
+    for( int i=0; i<numBots; i++ ) {
+        Bot *b = &( bots[i] );
+
+        b->i = i;
+        b->email = autoSprintf( "%s_%d@dummy.com", emailPrefix, i );
+        b->sock = NULL;
+        b->fd = -1;
+        b->reconnectTime = 0;
+        b->nextActionTime = 0;
+        resetBot( b );
+
+        int pick = ( i * 7919 ) % totalWeight;
+
+        b->behavior = BEHAVIOR_EXPLORE;
+
+        for( int p=0; p<NUM_BEHAVIORS; p++ ) {
+            if( pick < weights[p] ) {
+                b->behavior = (BehaviorProfile)p;
+                break;
+                }
+            pick -= weights[p];
+            }
+        behaviorCounts[ b->behavior ]++;
+        }
+
+    printf( "Running %d bots on %d threads against %s:%d\n",
+            numBots, numThreads, serverAddress, serverPort );
+
+    for( int p=0; p<NUM_BEHAVIORS; p++ ) {
+        if( behaviorCounts[p] > 0 ) {
+            printf( "    %d %s\n", behaviorCounts[p], behaviorNames[p] );
+            }
+        }
+
+
+    BotWorker **workers = new BotWorker*[ numThreads ];
+
+    unsigned int seed = (unsigned int)Time::timeSec();
+
+    int nextBot = 0;
+
+    for( int t=0; t<numThreads; t++ ) {
+        int numForThread = numBots / numThreads;
+        if( t < numBots % numThreads ) {
+            numForThread++;
+            }
+
+        workers[t] = new BotWorker( &( bots[ nextBot ] ), numForThread,
+                                    seed + t );
+        nextBot += numForThread;
+
+        workers[t]->start();
+        }
+
+
+    LoadStats *totalStats = new LoadStats;
+    LoadStats *intervalStats = new LoadStats;
+    memset( totalStats, 0, sizeof( LoadStats ) );
+
+    double startTime = Time::getCurrentTime();
+
+    while( runSeconds == 0 ||
+           Time::getCurrentTime() - startTime < runSeconds ) {
+
+        Thread::staticSleep( REPORT_SECONDS * 1000 );
+
+        memset( intervalStats, 0, sizeof( LoadStats ) );
+
+        int numLive = 0;
+        int numConnecting = 0;
+
+        for( int t=0; t<numThreads; t++ ) {
+            workers[t]->takeStats( intervalStats );
+
+            int live, connecting;
+            workers[t]->getBotCounts( &live, &connecting );
+            numLive += live;
+            numConnecting += connecting;
+            }
+
+        addStats( totalStats, intervalStats );
+
+        printSummary( intervalStats, Time::getCurrentTime() - startTime,
+                      numLive, numConnecting, numBots );
+        }
+
+
+    for( int t=0; t<numThreads; t++ ) {
+        workers[t]->stop();
+        }
+    for( int t=0; t<numThreads; t++ ) {
+        workers[t]->join();
+        workers[t]->takeStats( totalStats );
+        delete workers[t];
+        }
+    delete [] workers;
+
+
+    printf( "\n\nTotals over %.0f seconds:\n",
+            Time::getCurrentTime() - startTime );
+
+    for( int r=0; r<NUM_REQUEST_TYPES; r++ ) {
+        printDistribution( requestNames[r], &( totalStats->latency[r] ) );
+        }
+
+
+    for( int i=0; i<numBots; i++ ) {
+        delete [] bots[i].email;
+        }
+    delete [] bots;
+
+    delete totalStats;
+    delete intervalStats;
+
+    return 0;
+    }
@@ -0,0 +1,244 @@
+#include "logQuery.h"
+
+#include <unistd.h>
+
+
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/BinarySemaphore.h"
+
+
+
+#define MAX_QUERY_THREADS 64
+
+// tables each worker may load ahead of ordered function
+#define TABLES_AHEAD_PER_THREAD 4
+
+
+
+typedef struct QueryState {
+        const char *serverDir;
+        const char *folderName;
+        LogKind kind;
+
+        SimpleVector<char*> *fileNames;
+
+        LogTableFunction parallel;
+        void *data;
+
+        int window;
+
+        // guards everything below, shared with worker threads
+        MutexLock lock;
+
+        int nextToLoad;
+
+        // tables before this have been handed to ordered function
+        int nextOrdered;
+
+        // one per file, set when loaded
+        LogTable **tables;
+        char *loaded;
+
+        int numRebuilt;
+
+        // signaled when nextOrdered advances
+        // a worker that wakes and finds room left for others, or finds no
+        // files left, signals it again to wake another
+        BinarySemaphore orderedSemaphore;
+
+        // signaled when a table is loaded
+        BinarySemaphore loadedSemaphore;
+    } QueryState;
+
+
+
+class QueryWorkerThread : public Thread {
+    public:
+
+        QueryWorkerThread( QueryState *inState )
+                : mState( inState ) {
+            start();
+            }
+
+        ~QueryWorkerThread() {
+            join();
+            }
+
+        virtual void run() {
+            QueryState *s = mState;
+
+            int numFiles = s->fileNames->size();
+
+            while( true ) {
+                s->lock.lock();
+
+                if( s->nextToLoad >= numFiles ) {
+                    s->lock.unlock();
+
+                    // pass on to any worker still waiting
+                    s->orderedSemaphore.signal();
+                    return;
+                    }
+
+                if( s->nextToLoad >= s->nextOrdered + s->window ) {
+                    // far enough ahead, wait for ordered function
+                    s->lock.unlock();
+
+                    s->orderedSemaphore.wait();
+                    continue;
+                    }
+
+                int i = s->nextToLoad;
+                s->nextToLoad++;
+
+                char roomLeft =
+                    s->nextToLoad < s->nextOrdered + s->window;
+
+                s->lock.unlock();
+
+                if( roomLeft ) {
+                    s->orderedSemaphore.signal();
+                    }
+
+
+                char rebuilt;
+
+                LogTable *table =
+                    loadLogTable( s->serverDir, s->folderName,
+                                  s->fileNames->getElementDirect( i ),
+                                  s->kind, &rebuilt );
+
+                if( table != NULL && s->parallel != NULL ) {
+                    s->parallel( table, i, s->data );
+                    }
+
+
+                s->lock.lock();
+
+                s->tables[i] = table;
+                s->loaded[i] = true;
+
+                if( rebuilt ) {
+                    s->numRebuilt++;
+                    }
+
+                s->lock.unlock();
+
+                s->loadedSemaphore.signal();
+                }
+            }
+
+    protected:
+        QueryState *mState;
+    };
+
+
+
+int runLogQuery( const char *inServerDir, const char *inFolderName,
+                 LogKind inKind,
+                 SimpleVector<char*> *inFileNames,
+                 int inNumThreads,
+                 LogTableFunction inParallel,
+                 LogTableFunction inOrdered,
+                 void *inData,
+                 int *outNumRebuilt ) {
+
+    int numFiles = inFileNames->size();
+
+    if( inNumThreads <= 0 ) {
+        inNumThreads = sysconf( _SC_NPROCESSORS_ONLN );
+        }
+    if( inNumThreads < 1 ) {
+        inNumThreads = 1;
+        }
+    if( inNumThreads > MAX_QUERY_THREADS ) {
+        inNumThreads = MAX_QUERY_THREADS;
+        }
+    if( inNumThreads > numFiles ) {
+        inNumThreads = numFiles;
+        }
+
+
+    QueryState *s = new QueryState;
+
+    s->serverDir = inServerDir;
+    s->folderName = inFolderName;
+    s->kind = inKind;
+    s->fileNames = inFileNames;
+    s->parallel = inParallel;
+    s->data = inData;
+    s->window = inNumThreads * TABLES_AHEAD_PER_THREAD;
+
+    s->nextToLoad = 0;
+    s->nextOrdered = 0;
+    s->numRebuilt = 0;
+
+    s->tables = new LogTable*[ numFiles ];
+    s->loaded = new char[ numFiles ];
+
+    for( int i=0; i<numFiles; i++ ) {
+        s->tables[i] = NULL;
+        s->loaded[i] = false;
+        }
+
+
+    QueryWorkerThread *workers[ MAX_QUERY_THREADS ];
+
+    for( int t=0; t<inNumThreads; t++ ) {
+        workers[t] = new QueryWorkerThread( s );
+        }
+
+
+    int numLoaded = 0;
+
+    for( int i=0; i<numFiles; i++ ) {
+
+        // wait for table i
+        while( true ) {
+            s->lock.lock();
+            char loaded = s->loaded[i];
+            s->lock.unlock();
+
+            if( loaded ) {
+                break;
+                }
+
+            // may wake for a later table loading, so check again
+            s->loadedSemaphore.wait();
+            }
+
+        LogTable *table = s->tables[i];
+
+        if( table != NULL ) {
+            numLoaded++;
+
+            if( inOrdered != NULL ) {
+                inOrdered( table, i, inData );
+                }
+            freeLogTable( table );
+            s->tables[i] = NULL;
+            }
+
+        s->lock.lock();
+        s->nextOrdered = i + 1;
+        s->lock.unlock();
+
+        s->orderedSemaphore.signal();
+        }
+
+
+    for( int t=0; t<inNumThreads; t++ ) {
+        delete workers[t];
+        }
+
+    if( outNumRebuilt != NULL ) {
+        *outNumRebuilt = s->numRebuilt;
+        }
+
+    delete [] s->tables;
+    delete [] s->loaded;
+    delete s;
+
+    return numLoaded;
+    }
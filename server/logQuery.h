@@ -0,0 +1,42 @@
+// Runs a query over a folder's worth of log tables, loading (and, where
+// their stores are stale, parsing) tables on worker threads.
+//
+// A query is made of two optional functions:
+//
+// inParallel is called on worker threads, right after each table loads,
+// with tables in any order.  It must only touch state that belongs to its
+// own file index, such as one slot in an array of per-file results.
+//
+// inOrdered is called on the calling thread, with tables in file order,
+// so it can carry state from one day's log to the next.  Workers keep
+// loading later tables while it runs.
+//
+// Each table is freed after both functions have seen it.  Workers load at
+// most a few tables ahead of inOrdered, to bound memory.
+
+
+#include "logStore.h"
+
+
+// inFileIndex is table's index in inFileNames
+typedef void (*LogTableFunction)( LogTable *inTable, int inFileIndex,
+                                  void *inData );
+
+
+// inFileNames are names of logs in <inServerDir>/<inFolderName>
+//
+// inNumThreads of 0 uses one worker per processor
+//
+// logs that can't be read are skipped, without calling either function
+//
+// outNumRebuilt, if not NULL, set to number of store files rewritten
+//
+// returns number of tables loaded
+int runLogQuery( const char *inServerDir, const char *inFolderName,
+                 LogKind inKind,
+                 SimpleVector<char*> *inFileNames,
+                 int inNumThreads,
+                 LogTableFunction inParallel,
+                 LogTableFunction inOrdered,
+                 void *inData,
+                 int *outNumRebuilt = NULL );
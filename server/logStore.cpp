@@ -0,0 +1,982 @@
+#include "logStore.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+#include "minorGems/io/file/File.h"
+#include "minorGems/io/file/Directory.h"
+#include "minorGems/util/stringUtils.h"
+
+
+
+#define STORE_FOLDER_NAME "logStore"
+
+#define STORE_VERSION 1
+
+
+static const char *logFolderPrefixes[ NUM_LOG_KINDS ] = {
+    "lifeLog",
+    "foodLog",
+    "failureLog",
+    "curseLog" };
+
+
+static int intColumnCounts[ NUM_LOG_KINDS ] = {
+    LIFE_INT_COLUMNS,
+    FOOD_INT_COLUMNS,
+    FAILURE_INT_COLUMNS,
+    CURSE_INT_COLUMNS };
+
+static int doubleColumnCounts[ NUM_LOG_KINDS ] = {
+    LIFE_DOUBLE_COLUMNS,
+    FOOD_DOUBLE_COLUMNS,
+    FAILURE_DOUBLE_COLUMNS,
+    CURSE_DOUBLE_COLUMNS };
+
+
+
+// store file is this header, then double columns, then int columns, then
+// strings with their terminators
+//
+// size is a multiple of 8, so double columns that follow are aligned
+typedef struct StoreHeader {
+        char magic[4];
+        int version;
+        int kind;
+        int numRows;
+
+        // of text log that store was made from
+        long long sourceLength;
+        long long sourceModTime;
+
+        double dayStartTime;
+
+        int numIntColumns;
+        int numDoubleColumns;
+
+        int numStrings;
+        int stringBytes;
+
+        int hourRows[25];
+
+        int unused;
+    } StoreHeader;
+
+
+
+struct LogDictionary {
+        SimpleVector<char*> strings;
+
+        // open addressing, each slot holds string index + 1, or 0 if empty
+        // number of slots is always a power of 2
+        int *slots;
+        int numSlots;
+    };
+
+
+
+static unsigned int hashString( const char *inString ) {
+    // FNV-1a
+    unsigned int h = 2166136261U;
+
+    while( *inString != '\0' ) {
+        h ^= (unsigned char)( *inString );
+        h *= 16777619U;
+        inString++;
+        }
+    return h;
+    }
+
+
+
+LogDictionary *newLogDictionary() {
+    LogDictionary *d = new LogDictionary;
+
+    d->numSlots = 1024;
+    d->slots = new int[ d->numSlots ];
+    memset( d->slots, 0, d->numSlots * sizeof( int ) );
+
+    return d;
+    }
+
+
+
+void freeLogDictionary( LogDictionary *inDictionary ) {
+    inDictionary->strings.deallocateStringElements();
+
+    delete [] inDictionary->slots;
+    delete inDictionary;
+    }
+
+
+
+// returns slot holding string, or empty slot where it would go
+static int findSlot( LogDictionary *inDictionary, const char *inString ) {
+    int mask = inDictionary->numSlots - 1;
+
+    int i = hashString( inString ) & mask;
+
+    while( inDictionary->slots[i] != 0 ) {
+        const char *s =
+            inDictionary->strings.getElementDirect(
+                inDictionary->slots[i] - 1 );
+
+        if( strcmp( s, inString ) == 0 ) {
+            return i;
+            }
+        i = ( i + 1 ) & mask;
+        }
+    return i;
+    }
+
+
+
+static void growDictionary( LogDictionary *inDictionary ) {
+    delete [] inDictionary->slots;
+
+    inDictionary->numSlots *= 2;
+    inDictionary->slots = new int[ inDictionary->numSlots ];
+    memset( inDictionary->slots, 0, inDictionary->numSlots * sizeof( int ) );
+
+    for( int i=0; i<inDictionary->strings.size(); i++ ) {
+        int slot = findSlot( inDictionary,
+                             inDictionary->strings.getElementDirect( i ) );
+        inDictionary->slots[ slot ] = i + 1;
+        }
+    }
+
+
+
+int addToLogDictionary( LogDictionary *inDictionary, const char *inString ) {
+    int slot = findSlot( inDictionary, inString );
+
+    if( inDictionary->slots[ slot ] != 0 ) {
+        return inDictionary->slots[ slot ] - 1;
+        }
+
+    inDictionary->strings.push_back( stringDuplicate( inString ) );
+
+    int index = inDictionary->strings.size() - 1;
+
+    inDictionary->slots[ slot ] = index + 1;
+
+    if( inDictionary->strings.size() * 2 > inDictionary->numSlots ) {
+        growDictionary( inDictionary );
+        }
+
+    return index;
+    }
+
+
+
+int findInLogDictionary( LogDictionary *inDictionary,
+                         const char *inString ) {
+    int slot = findSlot( inDictionary, inString );
+
+    return inDictionary->slots[ slot ] - 1;
+    }
+
+
+
+int getLogDictionarySize( LogDictionary *inDictionary ) {
+    return inDictionary->strings.size();
+    }
+
+
+
+const char *getLogDictionaryString( LogDictionary *inDictionary,
+                                    int inIndex ) {
+    return inDictionary->strings.getElementDirect( inIndex );
+    }
+
+
+
+int *mapLogTableStrings( LogTable *inTable, LogDictionary *inDictionary ) {
+    int *map = new int[ inTable->numStrings ];
+
+    for( int i=0; i<inTable->numStrings; i++ ) {
+        map[i] = addToLogDictionary( inDictionary, inTable->strings[i] );
+        }
+    return map;
+    }
+
+
+
+static int compareNames( const void *inA, const void *inB ) {
+    return strcmp( *(char**)inA, *(char**)inB );
+    }
+
+
+
+// names of children of a directory, sorted
+static void getChildNames( const char *inPath, char inWantDirectories,
+                           SimpleVector<char*> *outNames ) {
+    File dir( NULL, inPath );
+
+    if( ! dir.exists() || ! dir.isDirectory() ) {
+        return;
+        }
+
+    int numChildFiles;
+    File **childFiles = dir.getChildFiles( &numChildFiles );
+
+    SimpleVector<char*> names;
+
+    for( int i=0; i<numChildFiles; i++ ) {
+        if( childFiles[i]->isDirectory() == inWantDirectories ) {
+            names.push_back( childFiles[i]->getFileName() );
+            }
+        delete childFiles[i];
+        }
+    delete [] childFiles;
+
+    char **nameArray = names.getElementArray();
+
+    qsort( nameArray, names.size(), sizeof( char* ), compareNames );
+
+    outNames->appendArray( nameArray, names.size() );
+
+    delete [] nameArray;
+    }
+
+
+
+char getLogFolderKind( const char *inFolderName, LogKind *outKind ) {
+    for( int k=0; k<NUM_LOG_KINDS; k++ ) {
+        const char *prefix = logFolderPrefixes[k];
+
+        if( strncmp( inFolderName, prefix, strlen( prefix ) ) == 0 ) {
+            *outKind = (LogKind)k;
+            return true;
+            }
+        }
+    return false;
+    }
+
+
+
+void getLogFolders( const char *inServerDir, LogKind inKind,
+                    SimpleVector<char*> *outFolderNames ) {
+    SimpleVector<char*> names;
+
+    getChildNames( inServerDir, true, &names );
+
+    for( int i=0; i<names.size(); i++ ) {
+        char *name = names.getElementDirect( i );
+
+        LogKind kind;
+
+        if( getLogFolderKind( name, &kind ) && kind == inKind ) {
+            outFolderNames->push_back( name );
+            }
+        else {
+            delete [] name;
+            }
+        }
+    }
+
+
+
+void getLogFileNames( const char *inServerDir, const char *inFolderName,
+                      SimpleVector<char*> *outFileNames ) {
+    char *folderPath = autoSprintf( "%s/%s", inServerDir, inFolderName );
+
+    SimpleVector<char*> names;
+
+    getChildNames( folderPath, false, &names );
+
+    delete [] folderPath;
+
+    for( int i=0; i<names.size(); i++ ) {
+        char *name = names.getElementDirect( i );
+
+        if( getLogFileDayStart( name ) != -1 &&
+            strstr( name, "_names" ) == NULL ) {
+            outFileNames->push_back( name );
+            }
+        else {
+            delete [] name;
+            }
+        }
+    }
+
+
+
+double getLogFileDayStart( const char *inFileName ) {
+    int fileYear, fileMonth, fileDay;
+
+    char monthName[100];
+
+    if( sscanf( inFileName, "%d_%d%99[^_]_%d",
+                &fileYear, &fileMonth, monthName, &fileDay ) != 4 ) {
+        return -1;
+        }
+
+    struct tm fileTimeStruct;
+    memset( &fileTimeStruct, 0, sizeof( fileTimeStruct ) );
+
+    fileTimeStruct.tm_year = fileYear - 1900;
+    fileTimeStruct.tm_mon = fileMonth - 1;
+    fileTimeStruct.tm_mday = fileDay;
+
+    // let mktime figure out daylight saving time
+    fileTimeStruct.tm_isdst = -1;
+
+    return (double)mktime( &fileTimeStruct );
+    }
+
+
+
+
+// columns for a table, as they are parsed
+typedef struct TableBuilder {
+        LogKind kind;
+        double dayStartTime;
+
+        SimpleVector<int> intColumns[ MAX_LOG_INT_COLUMNS ];
+        SimpleVector<double> doubleColumns[ MAX_LOG_DOUBLE_COLUMNS ];
+
+        // hour of day for each row
+        SimpleVector<int> rowHours;
+
+        // for foodLog and failureLog, which list entries under each hour
+        int currentHour;
+
+        LogDictionary *strings;
+    } TableBuilder;
+
+
+
+static int clampHour( int inHour ) {
+    if( inHour < 0 ) {
+        return 0;
+        }
+    if( inHour > 23 ) {
+        return 23;
+        }
+    return inHour;
+    }
+
+
+
+static int getHourOfDay( TableBuilder *inBuilder, double inTime ) {
+    if( inBuilder->dayStartTime == -1 ) {
+        return 0;
+        }
+    return clampHour( (int)floor(
+                          ( inTime - inBuilder->dayStartTime ) / 3600 ) );
+    }
+
+
+
+static void addRow( TableBuilder *inBuilder, int *inInts, double *inDoubles,
+                    int inHour ) {
+    for( int c=0; c<intColumnCounts[ inBuilder->kind ]; c++ ) {
+        inBuilder->intColumns[c].push_back( inInts[c] );
+        }
+    for( int c=0; c<doubleColumnCounts[ inBuilder->kind ]; c++ ) {
+        inBuilder->doubleColumns[c].push_back( inDoubles[c] );
+        }
+    inBuilder->rowHours.push_back( inHour );
+    }
+
+
+
+static void lowerCase( char *inString ) {
+    while( *inString != '\0' ) {
+        *inString = tolower( *inString );
+        inString++;
+        }
+    }
+
+
+
+static void parseLifeLine( TableBuilder *inBuilder, char *inLine ) {
+    int ints[ LIFE_INT_COLUMNS ];
+    double doubles[ LIFE_DOUBLE_COLUMNS ];
+
+    memset( ints, 0, sizeof( ints ) );
+    memset( doubles, 0, sizeof( doubles ) );
+
+    char email[1000];
+    char gender = 'F';
+
+    email[0] = '\0';
+
+    if( inLine[0] == 'B' ) {
+        char parent[1000];
+        parent[0] = '\0';
+
+        // not logged by old servers
+        ints[ LIFE_CHAIN ] = 1;
+
+        int numRead =
+            sscanf( inLine, "B %lf %d %999s %c (%d,%d) %999s pop=%d chain=%d",
+                    &( doubles[ LIFE_TIME ] ), &( ints[ LIFE_ID ] ),
+                    email, &gender,
+                    &( ints[ LIFE_X ] ), &( ints[ LIFE_Y ] ),
+                    parent,
+                    &( ints[ LIFE_POP ] ), &( ints[ LIFE_CHAIN ] ) );
+
+        if( numRead < 3 ) {
+            return;
+            }
+
+        ints[ LIFE_EVENT ] = LIFE_BIRTH;
+        ints[ LIFE_PARENT_EMAIL ] = -1;
+        ints[ LIFE_DEATH_CAUSE ] = -1;
+
+        if( strcmp( parent, "noParent" ) == 0 ) {
+            ints[ LIFE_PARENT_ID ] = -1;
+            }
+        else if( sscanf( parent, "parent=%d",
+                         &( ints[ LIFE_PARENT_ID ] ) ) == 1 ) {
+            char *comma = strstr( parent, "," );
+
+            if( comma != NULL ) {
+                lowerCase( &( comma[1] ) );
+                ints[ LIFE_PARENT_EMAIL ] =
+                    addToLogDictionary( inBuilder->strings, &( comma[1] ) );
+                }
+            }
+        }
+    else if( inLine[0] == 'D' ) {
+        char cause[1000];
+        cause[0] = '\0';
+
+        int numRead =
+            sscanf( inLine, "D %lf %d %999s age=%lf %c (%d,%d) %999s pop=%d",
+                    &( doubles[ LIFE_TIME ] ), &( ints[ LIFE_ID ] ),
+                    email, &( doubles[ LIFE_AGE ] ), &gender,
+                    &( ints[ LIFE_X ] ), &( ints[ LIFE_Y ] ),
+                    cause, &( ints[ LIFE_POP ] ) );
+
+        if( numRead < 3 ) {
+            return;
+            }
+
+        ints[ LIFE_EVENT ] = LIFE_DEATH;
+        ints[ LIFE_PARENT_ID ] = 0;
+        ints[ LIFE_PARENT_EMAIL ] = -1;
+        ints[ LIFE_CHAIN ] = 0;
+        ints[ LIFE_DEATH_CAUSE ] = -1;
+
+        if( cause[0] != '\0' ) {
+            ints[ LIFE_DEATH_CAUSE ] =
+                addToLogDictionary( inBuilder->strings, cause );
+            }
+        }
+    else {
+        return;
+        }
+
+    lowerCase( email );
+
+    ints[ LIFE_EMAIL ] = addToLogDictionary( inBuilder->strings, email );
+    ints[ LIFE_MALE ] = ( gender == 'M' );
+
+    addRow( inBuilder, ints, doubles,
+            getHourOfDay( inBuilder, doubles[ LIFE_TIME ] ) );
+    }
+
+
+
+static void parseFoodLine( TableBuilder *inBuilder, char *inLine ) {
+    int ints[ FOOD_INT_COLUMNS ];
+    double doubles[ FOOD_DOUBLE_COLUMNS ];
+
+    int hour;
+
+    if( sscanf( inLine, "hour=%d", &hour ) == 1 ) {
+        inBuilder->currentHour = hour;
+        return;
+        }
+
+    ints[ FOOD_HOUR ] = inBuilder->currentHour;
+
+    int numRead =
+        sscanf( inLine, "id=%d count=%d value=%d av_age=%lf "
+                "av_mapX=%d av_mapY=%d",
+                &( ints[ FOOD_ID ] ), &( ints[ FOOD_COUNT ] ),
+                &( ints[ FOOD_VALUE ] ), &( doubles[ FOOD_AVE_AGE ] ),
+                &( ints[ FOOD_MAP_X ] ), &( ints[ FOOD_MAP_Y ] ) );
+
+    if( numRead == 6 ) {
+        addRow( inBuilder, ints, doubles, clampHour( inBuilder->currentHour ) );
+        }
+    }
+
+
+
+static void parseFailureLine( TableBuilder *inBuilder, char *inLine ) {
+    int ints[ FAILURE_INT_COLUMNS ];
+
+    int hour;
+
+    if( sscanf( inLine, "hour=%d", &hour ) == 1 ) {
+        inBuilder->currentHour = hour;
+        return;
+        }
+
+    ints[ FAILURE_HOUR ] = inBuilder->currentHour;
+
+    int numRead =
+        sscanf( inLine, "%d + %d  count=%d",
+                &( ints[ FAILURE_ACTOR ] ), &( ints[ FAILURE_TARGET ] ),
+                &( ints[ FAILURE_COUNT ] ) );
+
+    if( numRead == 3 ) {
+        addRow( inBuilder, ints, NULL, clampHour( inBuilder->currentHour ) );
+        }
+    }
+
+
+
+static void parseCurseLine( TableBuilder *inBuilder, char *inLine ) {
+    int ints[ CURSE_INT_COLUMNS ];
+    double doubles[ CURSE_DOUBLE_COLUMNS ];
+
+    ints[ CURSE_ID ] = -1;
+    ints[ CURSE_EMAIL ] = -1;
+    ints[ CURSE_TARGET_EMAIL ] = -1;
+    ints[ CURSE_SCORE ] = 0;
+
+    char email[1000];
+    char targetEmail[1000];
+
+    if( sscanf( inLine, "START %lf", &( doubles[ CURSE_TIME ] ) ) == 1 ) {
+        ints[ CURSE_EVENT ] = CURSE_START;
+        }
+    else if( sscanf( inLine, "STOP %lf", &( doubles[ CURSE_TIME ] ) ) == 1 ) {
+        ints[ CURSE_EVENT ] = CURSE_STOP;
+        }
+    else if( sscanf( inLine, "C %lf %d %999s => %999s",
+                     &( doubles[ CURSE_TIME ] ), &( ints[ CURSE_ID ] ),
+                     email, targetEmail ) == 4 ) {
+        ints[ CURSE_EVENT ] = CURSE_CURSE;
+
+        lowerCase( email );
+        lowerCase( targetEmail );
+
+        ints[ CURSE_EMAIL ] = addToLogDictionary( inBuilder->strings, email );
+        ints[ CURSE_TARGET_EMAIL ] =
+            addToLogDictionary( inBuilder->strings, targetEmail );
+        }
+    else if( sscanf( inLine, "S %lf %999s %d",
+                     &( doubles[ CURSE_TIME ] ), email,
+                     &( ints[ CURSE_SCORE ] ) ) == 3 ) {
+        ints[ CURSE_EVENT ] = CURSE_SCORE_CHANGE;
+
+        lowerCase( email );
+
+        ints[ CURSE_EMAIL ] = addToLogDictionary( inBuilder->strings, email );
+        }
+    else {
+        return;
+        }
+
+    addRow( inBuilder, ints, doubles,
+            getHourOfDay( inBuilder, doubles[ CURSE_TIME ] ) );
+    }
+
+
+
+// whole file, with terminator added, destroyed by caller
+// NULL on failure
+static char *readWholeFile( const char *inPath, int *outLength ) {
+    FILE *f = fopen( inPath, "rb" );
+
+    if( f == NULL ) {
+        return NULL;
+        }
+
+    fseek( f, 0, SEEK_END );
+    long length = ftell( f );
+    fseek( f, 0, SEEK_SET );
+
+    if( length < 0 ) {
+        fclose( f );
+        return NULL;
+        }
+
+    char *contents = new char[ length + 1 ];
+
+    int numRead = fread( contents, 1, length, f );
+    fclose( f );
+
+    contents[ numRead ] = '\0';
+    *outLength = numRead;
+
+    return contents;
+    }
+
+
+
+// sets table's pointers into its data
+// returns false if data is not a valid store for this kind
+static char attachTable( LogTable *inTable, int inDataLength,
+                         LogKind inKind ) {
+    StoreHeader *h = (StoreHeader *)( inTable->data );
+
+    if( inDataLength < (int)sizeof( StoreHeader ) ||
+        memcmp( h->magic, "OLLS", 4 ) != 0 ||
+        h->version != STORE_VERSION ||
+        h->kind != inKind ||
+        h->numIntColumns != intColumnCounts[ inKind ] ||
+        h->numDoubleColumns != doubleColumnCounts[ inKind ] ||
+        h->numRows < 0 || h->numStrings < 0 || h->stringBytes < 0 ) {
+        return false;
+        }
+
+    long long length =
+        sizeof( StoreHeader ) +
+        (long long)h->numRows * h->numDoubleColumns * sizeof( double ) +
+        (long long)h->numRows * h->numIntColumns * sizeof( int ) +
+        h->stringBytes;
+
+    if( length > inDataLength ) {
+        return false;
+        }
+
+    inTable->kind = inKind;
+    inTable->dayStartTime = h->dayStartTime;
+    inTable->numRows = h->numRows;
+    inTable->numIntColumns = h->numIntColumns;
+    inTable->numDoubleColumns = h->numDoubleColumns;
+
+    memcpy( inTable->hourRows, h->hourRows, sizeof( inTable->hourRows ) );
+
+    unsigned char *next = (unsigned char *)&( h[1] );
+
+    for( int c=0; c<inTable->numDoubleColumns; c++ ) {
+        inTable->doubleColumns[c] = (double *)next;
+        next += inTable->numRows * sizeof( double );
+        }
+    for( int c=0; c<inTable->numIntColumns; c++ ) {
+        inTable->intColumns[c] = (int *)next;
+        next += inTable->numRows * sizeof( int );
+        }
+
+    const char *stringData = (const char *)next;
+
+    if( h->stringBytes > 0 && stringData[ h->stringBytes - 1 ] != '\0' ) {
+        return false;
+        }
+
+    inTable->numStrings = h->numStrings;
+    inTable->strings = new const char*[ h->numStrings ];
+
+    int pos = 0;
+
+    for( int i=0; i<h->numStrings; i++ ) {
+        if( pos >= h->stringBytes ) {
+            delete [] inTable->strings;
+            inTable->strings = NULL;
+            return false;
+            }
+        inTable->strings[i] = &( stringData[ pos ] );
+        pos += strlen( inTable->strings[i] ) + 1;
+        }
+
+    return true;
+    }
+
+
+
+// data for a store file holding builder's columns
+// result destroyed by caller
+static double *makeStoreData( TableBuilder *inBuilder,
+                              long long inSourceLength,
+                              long long inSourceModTime,
+                              int *outLength ) {
+    int numRows = inBuilder->rowHours.size();
+
+    int numIntColumns = intColumnCounts[ inBuilder->kind ];
+    int numDoubleColumns = doubleColumnCounts[ inBuilder->kind ];
+
+    int numStrings = getLogDictionarySize( inBuilder->strings );
+
+    int stringBytes = 0;
+
+    for( int i=0; i<numStrings; i++ ) {
+        stringBytes +=
+            strlen( getLogDictionaryString( inBuilder->strings, i ) ) + 1;
+        }
+
+    int length =
+        sizeof( StoreHeader ) +
+        numRows * numDoubleColumns * sizeof( double ) +
+        numRows * numIntColumns * sizeof( int ) +
+        stringBytes;
+
+    int numDoubles = ( length + 7 ) / 8;
+
+    double *data = new double[ numDoubles ];
+    memset( data, 0, numDoubles * sizeof( double ) );
+
+    StoreHeader *h = (StoreHeader *)data;
+
+    memcpy( h->magic, "OLLS", 4 );
+    h->version = STORE_VERSION;
+    h->kind = inBuilder->kind;
+    h->numRows = numRows;
+    h->sourceLength = inSourceLength;
+    h->sourceModTime = inSourceModTime;
+    h->dayStartTime = inBuilder->dayStartTime;
+    h->numIntColumns = numIntColumns;
+    h->numDoubleColumns = numDoubleColumns;
+    h->numStrings = numStrings;
+    h->stringBytes = stringBytes;
+
+    // first row at or after each hour
+    int r = 0;
+    for( int hour=0; hour<24; hour++ ) {
+        while( r < numRows &&
+               inBuilder->rowHours.getElementDirect( r ) < hour ) {
+            r++;
+            }
+        h->hourRows[ hour ] = r;
+        }
+    h->hourRows[24] = numRows;
+
+
+    unsigned char *next = (unsigned char *)&( h[1] );
+
+    for( int c=0; c<numDoubleColumns; c++ ) {
+        if( numRows > 0 ) {
+            memcpy( next, inBuilder->doubleColumns[c].getElement( 0 ),
+                    numRows * sizeof( double ) );
+            }
+        next += numRows * sizeof( double );
+        }
+    for( int c=0; c<numIntColumns; c++ ) {
+        if( numRows > 0 ) {
+            memcpy( next, inBuilder->intColumns[c].getElement( 0 ),
+                    numRows * sizeof( int ) );
+            }
+        next += numRows * sizeof( int );
+        }
+
+    for( int i=0; i<numStrings; i++ ) {
+        const char *s = getLogDictionaryString( inBuilder->strings, i );
+        int sLength = strlen( s ) + 1;
+
+        memcpy( next, s, sLength );
+        next += sLength;
+        }
+
+    *outLength = length;
+    return data;
+    }
+
+
+
+static void makeDirectoryIfMissing( const char *inPath ) {
+    File dir( NULL, inPath );
+
+    if( ! dir.exists() ) {
+        // another tool or thread may beat us to it, which is fine
+        Directory::makeDirectory( &dir );
+        }
+    }
+
+
+
+// writes to a temp file first, so readers never see half a store
+static void writeStoreFile( const char *inServerDir,
+                            const char *inFolderName,
+                            const char *inStorePath,
+                            double *inData, int inLength ) {
+    char *storeRoot = autoSprintf( "%s/%s", inServerDir, STORE_FOLDER_NAME );
+    char *storeFolder = autoSprintf( "%s/%s", storeRoot, inFolderName );
+
+    makeDirectoryIfMissing( storeRoot );
+    makeDirectoryIfMissing( storeFolder );
+
+    delete [] storeRoot;
+    delete [] storeFolder;
+
+    char *tempPath = autoSprintf( "%s.%d.temp", inStorePath, (int)getpid() );
+
+    FILE *f = fopen( tempPath, "wb" );
+
+    if( f == NULL ) {
+        printf( "Failed to open log store file %s for writing\n", tempPath );
+        delete [] tempPath;
+        return;
+        }
+
+    int numWritten = fwrite( inData, 1, inLength, f );
+
+    fclose( f );
+
+    if( numWritten != inLength ||
+        rename( tempPath, inStorePath ) != 0 ) {
+        printf( "Failed to write log store file %s\n", inStorePath );
+        remove( tempPath );
+        }
+
+    delete [] tempPath;
+    }
+
+
+
+LogTable *loadLogTable( const char *inServerDir, const char *inFolderName,
+                        const char *inFileName, LogKind inKind,
+                        char *outRebuilt ) {
+    if( outRebuilt != NULL ) {
+        *outRebuilt = false;
+        }
+
+    char *logPath = autoSprintf( "%s/%s/%s",
+                                 inServerDir, inFolderName, inFileName );
+
+    struct stat logInfo;
+
+    if( stat( logPath, &logInfo ) != 0 ) {
+        delete [] logPath;
+        return NULL;
+        }
+
+    long long sourceLength = logInfo.st_size;
+    long long sourceModTime = logInfo.st_mtime;
+
+
+    char *storePath = autoSprintf( "%s/%s/%s/%s.bin",
+                                   inServerDir, STORE_FOLDER_NAME,
+                                   inFolderName, inFileName );
+
+    LogTable *table = new LogTable;
+    table->strings = NULL;
+    table->data = NULL;
+
+
+    // try existing store first
+    FILE *f = fopen( storePath, "rb" );
+
+    if( f != NULL ) {
+        fseek( f, 0, SEEK_END );
+        long length = ftell( f );
+        fseek( f, 0, SEEK_SET );
+
+        if( length >= (long)sizeof( StoreHeader ) ) {
+            table->data = new double[ ( length + 7 ) / 8 ];
+
+            int numRead = fread( table->data, 1, length, f );
+
+            StoreHeader *h = (StoreHeader *)( table->data );
+
+            if( numRead == length &&
+                attachTable( table, length, inKind ) &&
+                h->sourceLength == sourceLength &&
+                h->sourceModTime == sourceModTime ) {
+
+                fclose( f );
+                delete [] logPath;
+                delete [] storePath;
+                return table;
+                }
+
+            // stale or damaged
+            if( table->strings != NULL ) {
+                delete [] table->strings;
+                table->strings = NULL;
+                }
+            delete [] table->data;
+            table->data = NULL;
+            }
+        fclose( f );
+        }
+
+
+    // parse text log
+    int textLength;
+    char *text = readWholeFile( logPath, &textLength );
+
+    delete [] logPath;
+
+    if( text == NULL ) {
+        delete [] storePath;
+        delete table;
+        return NULL;
+        }
+
+    TableBuilder *builder = new TableBuilder;
+
+    builder->kind = inKind;
+    builder->dayStartTime = getLogFileDayStart( inFileName );
+    builder->strings = newLogDictionary();
+    builder->currentHour = 0;
+
+    char *line = text;
+
+    while( line < text + textLength ) {
+        char *end = strstr( line, "\n" );
+
+        if( end != NULL ) {
+            *end = '\0';
+            }
+
+        switch( inKind ) {
+            case LIFE_LOG:
+                parseLifeLine( builder, line );
+                break;
+            case FOOD_LOG:
+                parseFoodLine( builder, line );
+                break;
+            case FAILURE_LOG:
+                parseFailureLine( builder, line );
+                break;
+            default:
+                parseCurseLine( builder, line );
+                break;
+            }
+
+        if( end == NULL ) {
+            break;
+            }
+        line = &( end[1] );
+        }
+
+    delete [] text;
+
+
+    int dataLength;
+    table->data = makeStoreData( builder, sourceLength, sourceModTime,
+                                 &dataLength );
+
+    freeLogDictionary( builder->strings );
+    delete builder;
+
+    attachTable( table, dataLength, inKind );
+
+    writeStoreFile( inServerDir, inFolderName, storePath,
+                    table->data, dataLength );
+
+    delete [] storePath;
+
+    if( outRebuilt != NULL ) {
+        *outRebuilt = true;
+        }
+
+    return table;
+    }
+
+
+
+void freeLogTable( LogTable *inTable ) {
+    if( inTable->strings != NULL ) {
+        delete [] inTable->strings;
+        }
+    if( inTable->data != NULL ) {
+        delete [] inTable->data;
+        }
+    delete inTable;
+    }
@@ -0,0 +1,229 @@
+// Compact binary copies of the server's daily text logs (lifeLog, foodLog,
+// failureLog, curseLog), for the stats tools.
+//
+// Each text log gets one store file, holding its lines already parsed into
+// columns of ints and doubles.  Emails and other strings are kept once each
+// in the store's string dictionary, and columns refer to them by index.
+//
+// Store files live in <serverDir>/logStore/<logFolderName>/, out of the way
+// of rsync and of scripts that copy whole log folders.
+//
+// A store file records the size and modification time of the text log it
+// came from, and is rebuilt when they change.  So today's log, which the
+// server is still adding to, is reparsed on every run, while older days are
+// parsed only once.
+//
+// Store files are a local cache, in this machine's byte order.
+
+
+#include "minorGems/util/SimpleVector.h"
+
+
+
+typedef enum LogKind {
+    LIFE_LOG = 0,
+    FOOD_LOG,
+    FAILURE_LOG,
+    CURSE_LOG,
+    NUM_LOG_KINDS
+    } LogKind;
+
+
+
+// columns for each kind of log
+
+// emails are lower case, since every reader compared them that way
+enum LifeLogIntColumn {
+    // LIFE_BIRTH or LIFE_DEATH
+    LIFE_EVENT = 0,
+    LIFE_ID,
+    // string index
+    LIFE_EMAIL,
+    LIFE_MALE,
+    LIFE_X,
+    LIFE_Y,
+    // -1 for Eve
+    LIFE_PARENT_ID,
+    // string index, -1 for Eve
+    LIFE_PARENT_EMAIL,
+    LIFE_POP,
+    // 1 in old logs that didn't record it
+    LIFE_CHAIN,
+    // string index, as logged ("hunger", "killer_123_email"),
+    // -1 for births
+    LIFE_DEATH_CAUSE,
+    LIFE_INT_COLUMNS
+    };
+
+enum LifeLogDoubleColumn {
+    LIFE_TIME = 0,
+    // 0 for births
+    LIFE_AGE,
+    LIFE_DOUBLE_COLUMNS
+    };
+
+enum LifeLogEvent {
+    LIFE_BIRTH = 0,
+    LIFE_DEATH
+    };
+
+
+enum FoodLogIntColumn {
+    FOOD_HOUR = 0,
+    FOOD_ID,
+    FOOD_COUNT,
+    FOOD_VALUE,
+    FOOD_MAP_X,
+    FOOD_MAP_Y,
+    FOOD_INT_COLUMNS
+    };
+
+enum FoodLogDoubleColumn {
+    FOOD_AVE_AGE = 0,
+    FOOD_DOUBLE_COLUMNS
+    };
+
+
+enum FailureLogIntColumn {
+    FAILURE_HOUR = 0,
+    FAILURE_ACTOR,
+    FAILURE_TARGET,
+    FAILURE_COUNT,
+    FAILURE_INT_COLUMNS
+    };
+
+#define FAILURE_DOUBLE_COLUMNS 0
+
+
+enum CurseLogIntColumn {
+    // CURSE_START, etc.
+    CURSE_EVENT = 0,
+    // -1 if not logged
+    CURSE_ID,
+    // string index, -1 for start and stop
+    CURSE_EMAIL,
+    // string index, -1 unless a curse
+    CURSE_TARGET_EMAIL,
+    // 0 unless a score
+    CURSE_SCORE,
+    CURSE_INT_COLUMNS
+    };
+
+enum CurseLogDoubleColumn {
+    CURSE_TIME = 0,
+    CURSE_DOUBLE_COLUMNS
+    };
+
+enum CurseLogEvent {
+    CURSE_START = 0,
+    CURSE_STOP,
+    CURSE_CURSE,
+    CURSE_SCORE_CHANGE
+    };
+
+
+#define MAX_LOG_INT_COLUMNS 16
+#define MAX_LOG_DOUBLE_COLUMNS 4
+
+
+
+// one text log's lines, as columns
+typedef struct LogTable {
+        LogKind kind;
+
+        // local midnight at start of day in log's file name
+        // -1 if file name has no date
+        double dayStartTime;
+
+        // rows are in log order, which is time order
+        int numRows;
+
+        int numIntColumns;
+        int numDoubleColumns;
+
+        int *intColumns[ MAX_LOG_INT_COLUMNS ];
+        double *doubleColumns[ MAX_LOG_DOUBLE_COLUMNS ];
+
+        // time index
+        // rows from hour h of the day are hourRows[h] up to hourRows[h+1]
+        // hourRows[24] is numRows
+        int hourRows[25];
+
+        int numStrings;
+        const char **strings;
+
+        // one allocation that all columns and strings point into
+        double *data;
+    } LogTable;
+
+
+
+// kind of logs that a folder holds, by its name
+// ("lifeLog", "lifeLog_server2", etc.)
+// returns false if not a log folder
+char getLogFolderKind( const char *inFolderName, LogKind *outKind );
+
+
+// names of log folders of a kind in server dir, sorted
+// result strings destroyed by caller
+void getLogFolders( const char *inServerDir, LogKind inKind,
+                    SimpleVector<char*> *outFolderNames );
+
+
+// names of dated text logs in a log folder, sorted, which is oldest first
+// skips _names logs and checkpoint files
+// result strings destroyed by caller
+void getLogFileNames( const char *inServerDir, const char *inFolderName,
+                      SimpleVector<char*> *outFileNames );
+
+
+// local midnight at start of day in log file name
+// ("2019_03March_05_Tuesday.txt"), or -1 if it has no date
+double getLogFileDayStart( const char *inFileName );
+
+
+
+// loads table for one text log, from its store file if that is current,
+// or else by parsing the text log and rewriting its store file
+//
+// safe to call from several threads at once, for different logs
+//
+// outRebuilt, if not NULL, set to true if store file was rewritten
+//
+// returns NULL if text log can't be read
+LogTable *loadLogTable( const char *inServerDir, const char *inFolderName,
+                        const char *inFileName, LogKind inKind,
+                        char *outRebuilt = NULL );
+
+
+void freeLogTable( LogTable *inTable );
+
+
+
+// strings numbered in the order they were first added
+typedef struct LogDictionary LogDictionary;
+
+
+LogDictionary *newLogDictionary();
+
+void freeLogDictionary( LogDictionary *inDictionary );
+
+
+// returns index of string, adding a copy of it if it is new
+int addToLogDictionary( LogDictionary *inDictionary, const char *inString );
+
+// returns -1 if not found
+int findInLogDictionary( LogDictionary *inDictionary, const char *inString );
+
+int getLogDictionarySize( LogDictionary *inDictionary );
+
+const char *getLogDictionaryString( LogDictionary *inDictionary,
+                                    int inIndex );
+
+
+// adds all of a table's strings to a dictionary
+// so that string indices from different tables can be compared
+//
+// returns array mapping table's string indices to dictionary indices,
+// with inTable->numStrings entries, destroyed by caller
+int *mapLogTableStrings( LogTable *inTable, LogDictionary *inDictionary );
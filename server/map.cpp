@@ -1,5 +1,6 @@
 #include "map.h"
-#include "HashTable.h"
+#include "FlatHashTable.h"
+#include "SetAssociativeCache.h"
 #include "monument.h"
 
 // cell pixel dimension on client
@@ -15,6 +16,8 @@
 #include "minorGems/util/log/AppLog.h"
 
 #include "minorGems/system/Time.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
 
 #include "minorGems/formats/encodingUtils.h"
 
@@ -23,6 +26,18 @@
 //#include "lineardb.h"
 #include "lineardb3.h"
 
+#include "containedRecord.h"
+#include "mapTile.h"
+#include "backup.h"
+#include "mapJournal.h"
+#include "mapTrace.h"
+#include "serverClock.h"
+#include "chunkWorkers.h"
+#include "recentChunks.h"
+#include "heatField.h"
+#include "tickProfiler.h"
+#include "settingsCache.h"
+
 
 /*
 #define DB KISSDB
@@ -153,7 +168,8 @@ timeSec_t slowTime() {
 
 // can replace with frozenTime to freeze time
 // or slowTime to slow it down
-#define MAP_TIMESEC Time::timeSec()
+// getServerTimeSec is Time::timeSec, except during session replay
+#define MAP_TIMESEC getServerTimeSec()
 //#define MAP_TIMESEC frozenTime()
 //#define MAP_TIMESEC fastTime()
 //#define MAP_TIMESEC slowTime()
@@ -259,23 +275,27 @@ static char lookTimeDBOpen = false;
 
 
 
+// base object, floor, and their ETAs, grouped into square tiles
+// see mapTile.h
 static DB db;
 static char dbOpen = false;
 
 
-static DB timeDB;
-static char timeDBOpen = false;
-
+// whole container tree for each x,y (contained and sub-contained IDs
+// and ETAs) stored as one variable-length record
+// see containedRecord.h
+static DB contDB;
+static char contDBOpen = false;
 
-static DB biomeDB;
-static char biomeDBOpen = false;
 
+// puts to db and contDB go through write-ahead journal
+// see mapJournal.h
+static int tileJournalID = 0;
+static int contJournalID = 1;
 
-static DB floorDB;
-static char floorDBOpen = false;
 
-static DB floorTimeDB;
-static char floorTimeDBOpen = false;
+static DB biomeDB;
+static char biomeDBOpen = false;
 
 
 static DB graveDB;
@@ -298,6 +318,12 @@ static CustomRandomSource randSource( randSeed );
 
 
 
+void reseedMapRandomSource( unsigned int inSeed ) {
+    randSource.reseed( inSeed );
+    }
+
+
+
 #define DECAY_SLOT 1
 #define NUM_CONT_SLOT 2
 #define FIRST_CONT_SLOT 3
@@ -340,20 +366,15 @@ typedef struct LiveDecayRecord {
 
 
 
-#include "minorGems/util/MinPriorityQueue.h"
-
-static MinPriorityQueue<LiveDecayRecord> liveDecayQueue;
-
+#include "TimingWheel.h"
 
-// for quick lookup of existing records in liveDecayQueue
-// store the eta time here
-// before storing a new record in the queue, we can check this hash
-// table to see whether it already exists
-static HashTable<timeSec_t> liveDecayRecordPresentHashTable( 1024 );
+// indexed as x, y, slot, subCont
+// at most one record per cell or slot, re-tracking replaces the old one
+static TimingWheel<LiveDecayRecord> liveDecayQueue;
 
 // times in seconds that a tracked live decay map cell or slot
 // was last looked at
-static HashTable<timeSec_t> liveDecayRecordLastLookTimeHashTable( 1024 );
+static FlatHashTable<timeSec_t> liveDecayRecordLastLookTimeHashTable( 1024 );
 
 
 typedef struct ContRecord {
@@ -368,7 +389,7 @@ static ContRecord defaultContRecord = { 0, 0 };
 // this allows us to update last look times without getting contained count
 // from map
 // indexed as x, y, 0, 0
-static HashTable<ContRecord> 
+static FlatHashTable<ContRecord> 
 liveDecayRecordLastLookTimeMaxContainedHashTable( 1024, defaultContRecord );
 
 
@@ -381,11 +402,9 @@ typedef struct MovementRecord {
     } MovementRecord;
 
 
-// clock time in fractional seconds of destination ETA
-// indexed as x, y, 0
-static HashTable<double> liveMovementEtaTimes( 1024, 0 );
-
-static MinPriorityQueue<MovementRecord> liveMovements;
+// scheduled at clock time in fractional seconds of destination ETA
+// indexed as x, y, 0, 0
+static TimingWheel<MovementRecord> liveMovements;
 
 
 
@@ -463,41 +482,6 @@ void intPairToKey( int inX, int inY, unsigned char *outKey ) {
 
 
 
-// one timeSec_t to an 8-byte double value
-void timeToValue( timeSec_t inT, unsigned char *outValue ) {
-    
-
-    // pack double time into 8 bytes in whatever endian order the
-    // double is stored on this platform
-
-    union{ timeSec_t doubleTime; uint64_t intTime; };
-
-    doubleTime = inT;
-    
-    for( int i=0; i<8; i++ ) {
-        outValue[i] = ( intTime >> (i * 8) ) & 0xFF;
-        }    
-    }
-
-
-timeSec_t valueToTime( unsigned char *inValue ) {
-
-    union{ timeSec_t doubleTime; uint64_t intTime; };
-
-    // get bytes back out in same order they were put in
-    intTime = 
-        (uint64_t)inValue[7] << 56 | (uint64_t)inValue[6] << 48 | 
-        (uint64_t)inValue[5] << 40 | (uint64_t)inValue[4] << 32 | 
-        (uint64_t)inValue[3] << 24 | (uint64_t)inValue[2] << 16 | 
-        (uint64_t)inValue[1] << 8  | (uint64_t)inValue[0];
-    
-    // caste back to timeSec_t
-    return doubleTime;
-    }
-
-
-
-
 timeSec_t dbLookTimeGet( int inX, int inY );
 void dbLookTimePut( int inX, int inY, timeSec_t inTime );
 
@@ -732,6 +716,34 @@ static void biomePutCached( int inX, int inY, int inBiome, int inSecondPlace,
 
 
 
+// one step of picking top two biomes, for biome index inIndex, which has
+// fractal value inValue
+//
+// call for each biome in order, with ioPicked starting at -1, ioSecondPlace
+// at -1, ioSecondPlaceGap at 0, and ioMaxValue at -DBL_MAX
+static void stepBiomePick( int inIndex, double inValue, 
+                           double *ioMaxValue, int *ioPicked,
+                           int *ioSecondPlace, double *ioSecondPlaceGap ) {
+    if( inValue > *ioMaxValue ) {
+        // a new first place
+        
+        // old first moves into second
+        *ioSecondPlace = *ioPicked;
+        *ioSecondPlaceGap = inValue - *ioMaxValue;
+        
+        
+        *ioMaxValue = inValue;
+        *ioPicked = inIndex;
+        }
+    else if( inValue > *ioMaxValue - *ioSecondPlaceGap ) {
+        // a better second place
+        *ioSecondPlace = inIndex;
+        *ioSecondPlaceGap = *ioMaxValue - inValue;
+        }
+    }
+
+
+
 static int computeMapBiomeIndex( int inX, int inY, 
                                  int *outSecondPlaceIndex = NULL,
                                  double *outSecondPlaceGap = NULL ) {
@@ -773,22 +785,8 @@ static int computeMapBiomeIndex( int inX, int inY,
                                         0.55, 
                                         0.83332 + 0.08333 * numBiomes );
         
-        if( randVal > maxValue ) {
-            // a new first place
-            
-            // old first moves into second
-            secondPlace = pickedBiome;
-            secondPlaceGap = randVal - maxValue;
-            
-
-            maxValue = randVal;
-            pickedBiome = i;
-            }
-        else if( randVal > maxValue - secondPlaceGap ) {
-            // a better second place
-            secondPlace = i;
-            secondPlaceGap = maxValue - randVal;
-            }
+        stepBiomePick( i, randVal, &maxValue, &pickedBiome,
+                       &secondPlace, &secondPlaceGap );
         }
     
     biomePutCached( inX, inY, pickedBiome, secondPlace, secondPlaceGap );
@@ -981,6 +979,156 @@ static void mapCacheInsert( int inX, int inY, int inID ) {
 static int getBaseMapCallCount = 0;
 
 
+// rest of getBaseMap for a spot that has an object, once biomes are
+// picked
+static int pickBaseMapObject( int inX, int inY, int pickedBiome,
+                              int secondPlace, double secondPlaceGap ) {
+    
+    if( pickedBiome == -1 ) {
+        mapCacheInsert( inX, inY, 0 );
+        return 0;
+        }
+    
+    // only override if it's not already set
+    // if it's already set, then we're calling getBaseMap for neighboring
+    // map cells (wide, tall, moving objects, etc.)
+    // getBaseMap is always called for our cell in question first
+    // before examining neighboring cells if needed
+    if( lastCheckedBiome == -1 ) {    
+        lastCheckedBiome = biomes[pickedBiome];
+        }
+    
+
+    
+    // randomly let objects from second place biome peek through
+    
+    // if gap is 0, this should happen 50 percent of the time
+
+    // if gap is 1.0, it should never happen
+
+    // larger values make second place less likely
+    double secondPlaceReduction = 10.0;
+
+    //printf( "Second place gap = %f, random(%d,%d)=%f\n", secondPlaceGap,
+    //        inX, inY, getXYRandom( 2087 + inX, 793 + inY ) );
+    
+    setXYRandomSeed( 348763 );
+    
+    if( getXYRandom( inX, inY ) > 
+        .5 + secondPlaceReduction * secondPlaceGap ) {
+    
+        // note that lastCheckedBiome is NOT changed, so ground
+        // shows the true, first-place biome, but object placement
+        // follows the second place biome
+        pickedBiome = secondPlace;
+        }
+    
+
+    int numObjects = naturalMapIDs[pickedBiome].size();
+
+    if( numObjects == 0  ) {
+        mapCacheInsert( inX, inY, 0 );
+        return 0;
+        }
+
+
+  
+    // something present here
+
+    
+    // special object in this region is 10x more common than it 
+    // would be otherwise
+
+
+    int specialObjectIndex = -1;
+    double maxValue = -DBL_MAX;
+    
+
+    for( int i=0; i<numObjects; i++ ) {
+        
+        setXYRandomSeed( 793 * i + 123 );
+    
+        double randVal = getXYFractal(  inX, 
+                                        inY, 
+                                        0.3, 
+                                        0.15 + 0.016666 * numObjects );
+
+        if( randVal > maxValue ) {
+            maxValue = randVal;
+            specialObjectIndex = i;
+            }
+        }
+
+
+
+    float oldSpecialChance = 
+        naturalMapChances[pickedBiome].getElementDirect( 
+            specialObjectIndex );
+    
+    float newSpecialChance = oldSpecialChance * 10;
+    
+    *( naturalMapChances[pickedBiome].getElement( specialObjectIndex ) )
+        = newSpecialChance;
+    
+    float oldTotalChanceWeight = totalChanceWeight[pickedBiome];
+    
+    totalChanceWeight[pickedBiome] -= oldSpecialChance;
+    totalChanceWeight[pickedBiome] += newSpecialChance;
+    
+
+    // pick one of our natural objects at random
+
+    // pick value between 0 and total weight
+    
+    setXYRandomSeed( 4593873 );
+    
+    double randValue = 
+        totalChanceWeight[pickedBiome] * getXYRandom( inX, inY );
+
+    // walk through objects, summing weights, until one crosses threshold
+    int i = 0;
+    float weightSum = 0;        
+    
+    while( weightSum < randValue && i < numObjects ) {
+        weightSum += naturalMapChances[pickedBiome].getElementDirect( i );
+        i++;
+        }
+    
+    i--;
+    
+
+    // restore chance of special object
+    *( naturalMapChances[pickedBiome].getElement( specialObjectIndex ) )
+        = oldSpecialChance;
+
+    totalChanceWeight[pickedBiome] = oldTotalChanceWeight;
+
+    if( i >= 0 ) {
+        int returnID = naturalMapIDs[pickedBiome].getElementDirect( i );
+        
+        if( pickedBiome == secondPlace ) {
+            // object peeking through from second place biome
+
+            // make sure it's not a moving object (animal)
+            // those are locked to their target biome only
+            TransRecord *t = getPTrans( -1, returnID );
+            if( t != NULL && t->move != 0 ) {
+                // put empty tile there instead
+                returnID = 0;
+                }
+            }
+
+        mapCacheInsert( inX, inY, returnID );
+        return returnID;
+        }
+    else {
+        mapCacheInsert( inX, inY, 0 );
+        return 0;
+        }
+    }
+
+
+
 static int getBaseMap( int inX, int inY ) {
     
     if( inX > xLimit || inX < -xLimit ||
@@ -1025,153 +1173,151 @@ static int getBaseMap( int inX, int inY ) {
         int pickedBiome = getMapBiomeIndex( inX, inY, &secondPlace,
                                             &secondPlaceGap );
         
-        if( pickedBiome == -1 ) {
-            mapCacheInsert( inX, inY, 0 );
-            return 0;
-            }
-        
-        // only override if it's not already set
-        // if it's already set, then we're calling getBaseMap for neighboring
-        // map cells (wide, tall, moving objects, etc.)
-        // getBaseMap is always called for our cell in question first
-        // before examining neighboring cells if needed
-        if( lastCheckedBiome == -1 ) {    
-            lastCheckedBiome = biomes[pickedBiome];
-            }
-        
-
-        
-        // randomly let objects from second place biome peek through
-        
-        // if gap is 0, this should happen 50 percent of the time
+        return pickBaseMapObject( inX, inY, pickedBiome, 
+                                  secondPlace, secondPlaceGap );
+        }
+    else {
+        mapCacheInsert( inX, inY, 0 );
+        return 0;
+        }
+    
+    }
 
-        // if gap is 1.0, it should never happen
 
-        // larger values make second place less likely
-        double secondPlaceReduction = 10.0;
 
-        //printf( "Second place gap = %f, random(%d,%d)=%f\n", secondPlaceGap,
-        //        inX, inY, getXYRandom( 2087 + inX, 793 + inY ) );
-        
-        setXYRandomSeed( 348763 );
-        
-        if( getXYRandom( inX, inY ) > 
-            .5 + secondPlaceReduction * secondPlaceGap ) {
-        
-            // note that lastCheckedBiome is NOT changed, so ground
-            // shows the true, first-place biome, but object placement
-            // follows the second place biome
-            pickedBiome = secondPlace;
-            }
-        
 
-        int numObjects = naturalMapIDs[pickedBiome].size();
+// fills base map cache, and biome cache along the way, for a whole
+// rectangle at once, with the same results as getBaseMap
+//
+// fractals are computed for the whole rectangle with getXYFractalRegion,
+// which is much faster than computing them one cell at a time, so call
+// this before calling getBaseMap on each cell of an area
+static void getBaseMapRegion( int inX, int inY, int inWidth, int inHeight ) {
+    
+    if( inWidth <= 0 || inHeight <= 0 ||
+        inWidth > BASE_MAP_CACHE_SIZE || inHeight > BASE_MAP_CACHE_SIZE ) {
+        // region would overwrite itself in cache
+        return;
+        }
 
-        if( numObjects == 0  ) {
-            mapCacheInsert( inX, inY, 0 );
-            return 0;
-            }
+    int endX = inX + inWidth - 1;
+    int endY = inY + inHeight - 1;
 
+    if( inX < -xLimit || endX > xLimit ||
+        inY < -yLimit || endY > yLimit ) {
+        // leave edge to getBaseMap
+        return;
+        }
     
-  
-        // something present here
-
-        
-        // special object in this region is 10x more common than it 
-        // would be otherwise
-
-
-        int specialObjectIndex = -1;
-        double maxValue = -DBL_MAX;
-        
-
-        for( int i=0; i<numObjects; i++ ) {
-            
-            setXYRandomSeed( 793 * i + 123 );
-        
-            double randVal = getXYFractal(  inX, 
-                                            inY, 
-                                            0.3, 
-                                            0.15 + 0.016666 * numObjects );
-
-            if( randVal > maxValue ) {
-                maxValue = randVal;
-                specialObjectIndex = i;
+    if( anyBiomesInDB && 
+        endX >= minBiomeXLoc && inX <= maxBiomeXLoc &&
+        endY >= minBiomeYLoc && inY <= maxBiomeYLoc ) {
+        // some biomes come from biome DB, leave them to getBaseMap
+        return;
+        }
+    
+    
+    int numCells = inWidth * inHeight;
+    
+    int numMissing = 0;
+    
+    for( int y=0; y<inHeight; y++ ) {
+        for( int x=0; x<inWidth; x++ ) {
+            if( mapCacheLookup( inX + x, inY + y ) == -1 ) {
+                numMissing++;
                 }
             }
+        }
+    
+    if( numMissing * 4 < numCells ) {
+        // mostly cached already, whole-region fractals not worth it
+        return;
+        }
+    
 
+    double *density = new double[ numCells ];
+    double *presentRand = new double[ numCells ];
+    
+    setXYRandomSeed( 5379 );
+    getXYFractalRegion( inX, inY, inWidth, inHeight, 0.1, 0.25, density );
+    
+    setXYRandomSeed( 9877 );
+    getXYRandomRegion( inX, inY, inWidth, inHeight, presentRand );
+    
 
-
-        float oldSpecialChance = 
-            naturalMapChances[pickedBiome].getElementDirect( 
-                specialObjectIndex );
-        
-        float newSpecialChance = oldSpecialChance * 10;
-        
-        *( naturalMapChances[pickedBiome].getElement( specialObjectIndex ) )
-            = newSpecialChance;
-        
-        float oldTotalChanceWeight = totalChanceWeight[pickedBiome];
-        
-        totalChanceWeight[pickedBiome] -= oldSpecialChance;
-        totalChanceWeight[pickedBiome] += newSpecialChance;
-        
-
-        // pick one of our natural objects at random
-
-        // pick value between 0 and total weight
-        
-        setXYRandomSeed( 4593873 );
+    // biomes for whole region, since ground needs them even where there
+    // are no objects
+    double *biomeValues = new double[ numBiomes * numCells ];
+    
+    for( int i=0; i<numBiomes; i++ ) {
+        setXYRandomSeed( biomes[i] * 263 + 723 );
         
-        double randValue = 
-            totalChanceWeight[pickedBiome] * getXYRandom( inX, inY );
+        getXYFractalRegion( inX, inY, inWidth, inHeight,
+                            0.55, 
+                            0.83332 + 0.08333 * numBiomes,
+                            &( biomeValues[ i * numCells ] ) );
+        }
+    
 
-        // walk through objects, summing weights, until one crosses threshold
-        int i = 0;
-        float weightSum = 0;        
-        
-        while( weightSum < randValue && i < numObjects ) {
-            weightSum += naturalMapChances[pickedBiome].getElementDirect( i );
-            i++;
-            }
-        
-        i--;
-        
+    // picking objects can set it
+    int oldLastCheckedBiome = lastCheckedBiome;
 
-        // restore chance of special object
-        *( naturalMapChances[pickedBiome].getElement( specialObjectIndex ) )
-            = oldSpecialChance;
+    for( int y=0; y<inHeight; y++ ) {
+        for( int x=0; x<inWidth; x++ ) {
+            int cellX = inX + x;
+            int cellY = inY + y;
+            int c = y * inWidth + x;
 
-        totalChanceWeight[pickedBiome] = oldTotalChanceWeight;
+            int secondPlace = -1;
+            double secondPlaceGap = 0;
 
-        if( i >= 0 ) {
-            int returnID = naturalMapIDs[pickedBiome].getElementDirect( i );
+            int pickedBiome = biomeGetCached( cellX, cellY, 
+                                              &secondPlace, 
+                                              &secondPlaceGap );
             
-            if( pickedBiome == secondPlace ) {
-                // object peeking through from second place biome
-
-                // make sure it's not a moving object (animal)
-                // those are locked to their target biome only
-                TransRecord *t = getPTrans( -1, returnID );
-                if( t != NULL && t->move != 0 ) {
-                    // put empty tile there instead
-                    returnID = 0;
+            if( pickedBiome == -2 ) {
+                pickedBiome = -1;
+                secondPlace = -1;
+                secondPlaceGap = 0;
+                
+                double maxValue = -DBL_MAX;
+                
+                for( int i=0; i<numBiomes; i++ ) {
+                    stepBiomePick( i, biomeValues[ i * numCells + c ],
+                                   &maxValue, &pickedBiome,
+                                   &secondPlace, &secondPlaceGap );
                     }
+                
+                biomePutCached( cellX, cellY, pickedBiome, 
+                                secondPlace, secondPlaceGap );
+                }
+            
+            
+            if( mapCacheLookup( cellX, cellY ) != -1 ) {
+                continue;
+                }
+            
+            getBaseMapCallCount ++;
+            
+            // same steps as getBaseMap
+            double cellDensity = sigmoid( density[c], 0.1 );
+            cellDensity *= .4;
+            
+            if( presentRand[c] < cellDensity ) {
+                pickBaseMapObject( cellX, cellY, pickedBiome, 
+                                   secondPlace, secondPlaceGap );
+                }
+            else {
+                mapCacheInsert( cellX, cellY, 0 );
                 }
-
-            mapCacheInsert( inX, inY, returnID );
-            return returnID;
-            }
-        else {
-            mapCacheInsert( inX, inY, 0 );
-            return 0;
             }
         }
-    else {
-        mapCacheInsert( inX, inY, 0 );
-        return 0;
-        }
     
+    lastCheckedBiome = oldLastCheckedBiome;
+    
+    delete [] density;
+    delete [] presentRand;
+    delete [] biomeValues;
     }
 
 
@@ -1484,112 +1630,356 @@ void printBiomeSamples() {
 // optimization:
 // cache dbGet results in RAM
 
-// 2.6 MB of RAM for this.
+// default number of entries in each cache, overridden by the
+// mapDBCacheSize setting
+// 2.6 MB of RAM for dbCache at this size.
 #define DB_CACHE_SIZE 131072
 
-typedef struct DBCacheRecord {
-        int x, y, slot, subCont;
-        int value;
-    } DBCacheRecord;
-    
-static DBCacheRecord dbCache[ DB_CACHE_SIZE ];
-
+// entries per set
+#define DB_CACHE_WAYS 8
 
+// how often hit/miss/eviction counts are written to log
+#define DB_CACHE_STATS_INTERVAL_SECONDS 600
 
-static int computeDBCacheHash( int inKeyA, int inKeyB, 
-                               int inKeyC, int inKeyD ) {
-    
-    int hashKey = ( inKeyA * CACHE_PRIME_A + 
-                    inKeyB * CACHE_PRIME_B + 
-                    inKeyC * CACHE_PRIME_C +
-                    inKeyD * CACHE_PRIME_D ) % DB_CACHE_SIZE;
-    if( hashKey < 0 ) {
-        hashKey += DB_CACHE_SIZE;
-        }
-    return hashKey;
-    }
+static SetAssociativeCache<int> *dbCache = NULL;
 
+static SetAssociativeCache<timeSec_t> *dbTimeCache = NULL;
 
+static SetAssociativeCache<char> *blockingCache = NULL;
 
-
-typedef struct DBTimeCacheRecord {
-        int x, y, slot, subCont;
-        timeSec_t timeVal;
-    } DBTimeCacheRecord;
-    
-static DBTimeCacheRecord dbTimeCache[ DB_CACHE_SIZE ];
+static double lastDBCacheStatsTime = 0;
 
 
 
-typedef struct BlockingCacheRecord {
-        int x, y;
-        // -1 if not present
-        char blocking;
-    } BlockingCacheRecord;
+static void logDBCacheStats( const char *inName, 
+                             unsigned int inHits, unsigned int inMisses,
+                             unsigned int inEvictions ) {
+    unsigned int total = inHits + inMisses;
     
-static BlockingCacheRecord blockingCache[ DB_CACHE_SIZE ];
-
-
+    double hitPercent = 0;
+    
+    if( total > 0 ) {
+        hitPercent = 100.0 * inHits / total;
+        }
+    
+    AppLog::infoF( "%s: %u hits, %u misses (%.1f%% hit rate), "
+                   "%u evictions",
+                   inName, inHits, inMisses, hitPercent, inEvictions );
+    }
 
 
 
-static void initDBCaches() {
-    DBCacheRecord blankRecord = { 0, 0, 0, 0, -2 };
-    for( int i=0; i<DB_CACHE_SIZE; i++ ) {
-        dbCache[i] = blankRecord;
-        }
-    // 1 for empty (because 0 is a valid value)
-    DBTimeCacheRecord blankTimeRecord = { 0, 0, 0, 0, 1 };
-    for( int i=0; i<DB_CACHE_SIZE; i++ ) {
-        dbTimeCache[i] = blankTimeRecord;
-        }
-    // -1 for empty
-    BlockingCacheRecord blankBlockingRecord = { 0, 0, -1 };
-    for( int i=0; i<DB_CACHE_SIZE; i++ ) {
-        blockingCache[i] = blankBlockingRecord;
+// logs counts since last call, and resets them
+static void logDBCachesStats() {
+    if( dbCache == NULL ) {
+        return;
         }
+    
+    logDBCacheStats( "dbCache", 
+                     dbCache->getHits(), dbCache->getMisses(),
+                     dbCache->getEvictions() );
+    logDBCacheStats( "dbTimeCache", 
+                     dbTimeCache->getHits(), dbTimeCache->getMisses(),
+                     dbTimeCache->getEvictions() );
+    logDBCacheStats( "blockingCache", 
+                     blockingCache->getHits(), blockingCache->getMisses(),
+                     blockingCache->getEvictions() );
+    
+    dbCache->resetStats();
+    dbTimeCache->resetStats();
+    blockingCache->resetStats();
+    
+    lastDBCacheStatsTime = Time::getCurrentTime();
     }
 
-    
 
 
-// returns -2 on miss
-static int dbGetCached( int inX, int inY, int inSlot, int inSubCont ) {
-    DBCacheRecord r =
-        dbCache[ computeDBCacheHash( inX, inY, inSlot, inSubCont ) ];
+static void freeDBCaches() {
+    if( dbCache != NULL ) {
+        logDBCachesStats();
+        
+        delete dbCache;
+        delete dbTimeCache;
+        delete blockingCache;
 
-    if( r.x == inX && r.y == inY && 
-        r.slot == inSlot && r.subCont == inSubCont &&
-        r.value != -2 ) {
-        return r.value;
-        }
-    else {
-        return -2;
+        dbCache = NULL;
+        dbTimeCache = NULL;
+        blockingCache = NULL;
         }
     }
 
 
 
-static void dbPutCached( int inX, int inY, int inSlot, int inSubCont, 
-                        int inValue ) {
-    DBCacheRecord r = { inX, inY, inSlot, inSubCont, inValue };
+static void initDBCaches() {
+    freeDBCaches();
     
-    dbCache[ computeDBCacheHash( inX, inY, inSlot, inSubCont ) ] = r;
+    int size = getCachedIntSetting( "mapDBCacheSize", 
+                                    DB_CACHE_SIZE );
+    
+    if( size < DB_CACHE_WAYS ) {
+        size = DB_CACHE_WAYS;
+        }
+    
+    dbCache = new SetAssociativeCache<int>( size, DB_CACHE_WAYS );
+    dbTimeCache = new SetAssociativeCache<timeSec_t>( size, DB_CACHE_WAYS );
+    blockingCache = new SetAssociativeCache<char>( size, DB_CACHE_WAYS );
+    
+    AppLog::infoF( "Map DB caches have %d entries each, in %d-way sets",
+                   dbCache->getNumEntries(), DB_CACHE_WAYS );
+
+    lastDBCacheStatsTime = Time::getCurrentTime();
     }
 
 
 
+// optimization:
+// cache each map cell as sent in MC messages, so chunks around the same
+// spot (family members logging in, everyone after a restart) can be put
+// together without fetching every cell again
+//
+// cells are kept in binary protocol format, which is turned into text
+// for clients that don't use it
 
+// cells that take more bytes (big containers) are rebuilt every time
+#define CHUNK_TILE_BYTES 40
 
-// returns 1 on miss
-static int dbTimeGetCached( int inX, int inY, int inSlot, int inSubCont ) {
-    DBTimeCacheRecord r =
-        dbTimeCache[ computeDBCacheHash( inX, inY, inSlot, inSubCont ) ];
+// default number of cells cached, overridden by the mapChunkCacheSize
+// setting
+// 9 MB of RAM at this size
+#define CHUNK_TILE_CACHE_SIZE 131072
 
-    if( r.x == inX && r.y == inY && 
-        r.slot == inSlot && r.subCont == inSubCont &&
-        r.timeVal != 1 ) {
-        return r.timeVal;
+
+typedef struct ChunkTile {
+        // time when some decay in cell is due, and text goes stale
+        // 0 if nothing in cell decays
+        timeSec_t expiry;
+        
+        int length;
+        unsigned char bytes[ CHUNK_TILE_BYTES ];
+    } ChunkTile;
+
+
+// chunk message with cells read, waiting to be compressed
+struct ChunkMessageJob {
+        int x, y, width, height;
+        
+        GridPos relativeToPos;
+        
+        char binary;
+        
+        timeSec_t expiry;
+        
+        int rawSize;
+        
+        // NULL if cells came already compressed from a recent chunk
+        ChunkJob *compressJob;
+        
+        // copy of recent chunk's data, if compressJob is NULL
+        unsigned char *compressedData;
+        int compressedSize;
+        
+        // NULL if cells came from a recent chunk
+        RecentChunkBuild *recentBuild;
+    };
+
+
+static SetAssociativeCache<ChunkTile> *chunkTileCache = NULL;
+
+
+
+// called whenever anything stored for a cell changes, including
+// decay times
+static void chunkCacheCellChanged( int inX, int inY ) {
+    heatFieldCellChanged( inX, inY );
+    
+    if( chunkTileCache == NULL ) {
+        return;
+        }
+    
+    chunkTileCache->remove( inX, inY, 0, 0 );
+    
+    recentChunkCellChanged( inX, inY );
+    }
+
+
+
+// logs counts since last call, and resets them
+static void logChunkCacheStats() {
+    if( chunkTileCache == NULL ) {
+        return;
+        }
+    
+    logDBCacheStats( "chunkTileCache", 
+                     chunkTileCache->getHits(), 
+                     chunkTileCache->getMisses(),
+                     chunkTileCache->getEvictions() );
+    
+    chunkTileCache->resetStats();
+    }
+
+
+
+static void freeChunkCache() {
+    if( chunkTileCache != NULL ) {
+        logChunkCacheStats();
+        
+        delete chunkTileCache;
+        chunkTileCache = NULL;
+        }
+    
+    freeRecentChunks();
+    }
+
+
+
+static void initChunkCache() {
+    freeChunkCache();
+    
+    int size = getCachedIntSetting( "mapChunkCacheSize", 
+                                    CHUNK_TILE_CACHE_SIZE );
+    
+    if( size < DB_CACHE_WAYS ) {
+        size = DB_CACHE_WAYS;
+        }
+    
+    chunkTileCache = 
+        new SetAssociativeCache<ChunkTile>( size, DB_CACHE_WAYS );
+    
+    initRecentChunks();
+    }
+
+
+
+// access trace for traceBenchmark, see mapTrace.h
+// recorded while recordMapTraceSeconds.ini is set, which is checked
+// every MAP_TRACE_SETTING_CHECK_SECONDS, so it can be switched on while
+// the server is running
+static FILE *mapTraceFile = NULL;
+
+static double mapTraceStartTime = 0;
+static double mapTraceEndTime = 0;
+static int mapTraceNumRecords = 0;
+
+static double lastMapTraceSettingCheckTime = 0;
+
+#define MAP_TRACE_SETTING_CHECK_SECONDS 10
+
+
+
+static void stopMapTrace() {
+    if( mapTraceFile == NULL ) {
+        return;
+        }
+    
+    fclose( mapTraceFile );
+    mapTraceFile = NULL;
+    
+    AppLog::infoF( "Stopped recording map trace after %d accesses",
+                   mapTraceNumRecords );
+    }
+
+
+
+static void checkMapTraceSetting() {
+    double curTime = Time::getCurrentTime();
+    
+    if( mapTraceFile != NULL && curTime >= mapTraceEndTime ) {
+        stopMapTrace();
+        }
+    
+    if( curTime - lastMapTraceSettingCheckTime < 
+        MAP_TRACE_SETTING_CHECK_SECONDS ) {
+        return;
+        }
+    lastMapTraceSettingCheckTime = curTime;
+    
+    if( mapTraceFile != NULL ) {
+        return;
+        }
+
+    int seconds = 
+        getCachedIntSetting( "recordMapTraceSeconds", 0 );
+    
+    if( seconds <= 0 ) {
+        return;
+        }
+    
+    // one trace per setting change
+    setCachedSetting( "recordMapTraceSeconds", 0 );
+
+    char *fileName = autoSprintf( "mapTrace_%.0f.trace", Time::timeSec() );
+    
+    mapTraceFile = fopen( fileName, "wb" );
+    
+    if( mapTraceFile == NULL ) {
+        AppLog::errorF( "Failed to open %s for map trace", fileName );
+        delete [] fileName;
+        return;
+        }
+    
+    fwrite( MAP_TRACE_MAGIC, 4, 1, mapTraceFile );
+
+    mapTraceStartTime = curTime;
+    mapTraceEndTime = curTime + seconds;
+    mapTraceNumRecords = 0;
+    
+    AppLog::infoF( "Recording map trace to %s for %d seconds", 
+                   fileName, seconds );
+    
+    delete [] fileName;
+    }
+
+
+
+static void recordMapTrace( MapTraceOp inOp, int inX, int inY, 
+                            int inSlot, int inSubCont, 
+                            double inValue = 0 ) {
+    MapTraceRecord r = { (unsigned char)inOp, inX, inY, inSlot, inSubCont,
+                         Time::getCurrentTime() - mapTraceStartTime,
+                         inValue };
+    
+    unsigned char bytes[ MAP_TRACE_RECORD_BYTES ];
+    
+    encodeMapTraceRecord( &r, bytes );
+    
+    fwrite( bytes, MAP_TRACE_RECORD_BYTES, 1, mapTraceFile );
+
+    mapTraceNumRecords++;
+    }
+
+    
+
+
+// returns -2 on miss
+static int dbGetCached( int inX, int inY, int inSlot, int inSubCont ) {
+    int *value = dbCache->lookup( inX, inY, inSlot, inSubCont );
+
+    if( value != NULL ) {
+        return *value;
+        }
+    else {
+        return -2;
+        }
+    }
+
+
+
+static void dbPutCached( int inX, int inY, int inSlot, int inSubCont, 
+                        int inValue ) {
+    dbCache->insert( inX, inY, inSlot, inSubCont, inValue );
+    }
+
+
+
+
+
+// returns 1 on miss
+static timeSec_t dbTimeGetCached( int inX, int inY, int inSlot, 
+                                  int inSubCont ) {
+    timeSec_t *timeVal = dbTimeCache->lookup( inX, inY, inSlot, inSubCont );
+
+    if( timeVal != NULL ) {
+        return *timeVal;
         }
     else {
         return 1;
@@ -1600,9 +1990,7 @@ static int dbTimeGetCached( int inX, int inY, int inSlot, int inSubCont ) {
 
 static void dbTimePutCached( int inX, int inY, int inSlot, int inSubCont, 
                          timeSec_t inValue ) {
-    DBTimeCacheRecord r = { inX, inY, inSlot, inSubCont, inValue };
-    
-    dbTimeCache[ computeDBCacheHash( inX, inY, inSlot, inSubCont ) ] = r;
+    dbTimeCache->insert( inX, inY, inSlot, inSubCont, inValue );
     }
 
 
@@ -1611,12 +1999,10 @@ static void dbTimePutCached( int inX, int inY, int inSlot, int inSubCont,
 
 // returns -1 on miss
 static char blockingGetCached( int inX, int inY ) {
-    BlockingCacheRecord r =
-        blockingCache[ computeXYCacheHash( inX, inY ) ];
+    char *blocking = blockingCache->lookup( inX, inY, 0, 0 );
 
-    if( r.x == inX && r.y == inY &&
-        r.blocking != -1 ) {
-        return r.blocking;
+    if( blocking != NULL ) {
+        return *blocking;
         }
     else {
         return -1;
@@ -1626,32 +2012,746 @@ static char blockingGetCached( int inX, int inY ) {
 
 
 static void blockingPutCached( int inX, int inY, char inBlocking ) {
-    BlockingCacheRecord r = { inX, inY, inBlocking };
-    
-    blockingCache[ computeXYCacheHash( inX, inY ) ] = r;
+    blockingCache->insert( inX, inY, 0, 0, inBlocking );
     }
 
 
 static void blockingClearCached( int inX, int inY ) {
+    blockingCache->remove( inX, inY, 0, 0 );
+    }
+
+
+
+
+// optimization:
+// cache decoded tiles from db in RAM
+// every change is written through to db right away, so cache slots
+// can be dropped at any time
+// 6.3 MB of RAM for this.
+#define MAP_TILE_CACHE_SIZE 1024
+
+typedef struct MapTileCacheRecord {
+        MapTile tile;
+        
+        // false if cache slot empty
+        char valid;
+    } MapTileCacheRecord;
+
+static MapTileCacheRecord mapTileCache[ MAP_TILE_CACHE_SIZE ];
+
+
+
+static void initMapTileCache() {
+    for( int i=0; i<MAP_TILE_CACHE_SIZE; i++ ) {
+        mapTileCache[i].valid = false;
+        }
+    }
+
+
+
+// loads tile containing x,y from db into cache if needed
+// returned tile is owned by cache, and valid until next mapTileGet call
+static MapTile *mapTileGet( int inX, int inY ) {
+    int originX = getMapTileOrigin( inX );
+    int originY = getMapTileOrigin( inY );
+    
+    // hash tile coordinates, not cell coordinates, so that neighboring
+    // tiles land in different cache slots
+    MapTileCacheRecord *r = 
+        &( mapTileCache[ computeXYCacheHash( originX / MAP_TILE_D, 
+                                             originY / MAP_TILE_D ) %
+                         MAP_TILE_CACHE_SIZE ] );
+    
+    if( r->valid && 
+        r->tile.originX == originX && r->tile.originY == originY ) {
+        return &( r->tile );
+        }
+    
+    unsigned char key[ MAP_TILE_KEY_BYTES ];
+    unsigned char value[ MAP_TILE_BYTES ];
+    
+    mapTileKey( inX, inY, key );
+    
+    if( mapJournalGet( tileJournalID, key, value ) == 0 ) {
+        decodeMapTile( value, inX, inY, &( r->tile ) );
+        }
+    else {
+        clearMapTile( &( r->tile ), inX, inY );
+        }
+    
+    r->valid = true;
+    
+    return &( r->tile );
+    }
+
+
+
+// writes tile through to db
+static void mapTileStore( MapTile *inTile ) {
+    unsigned char key[ MAP_TILE_KEY_BYTES ];
+    unsigned char value[ MAP_TILE_BYTES ];
+    
+    mapTileKey( inTile->originX, inTile->originY, key );
+    encodeMapTile( inTile, value );
+    
+    mapJournalPut( tileJournalID, key, value );
+    }
+
+
+
+
+// optimization:
+// cache decoded container trees from contDB in RAM
+// walking all the slots of a container, including its sub-containers,
+// costs at most one DB_get
+#define CONT_TREE_CACHE_SIZE 16384
+
+typedef struct ContTreeCacheRecord {
+        int x, y;
+        
+        // NULL if cache slot empty
+        ContainedTree *tree;
+        
+        // true if a record for x,y exists in contDB
+        char stored;
+    } ContTreeCacheRecord;
+
+static ContTreeCacheRecord contTreeCache[ CONT_TREE_CACHE_SIZE ];
+
+
+
+static void initContTreeCache() {
+    for( int i=0; i<CONT_TREE_CACHE_SIZE; i++ ) {
+        contTreeCache[i].x = 0;
+        contTreeCache[i].y = 0;
+        contTreeCache[i].tree = NULL;
+        contTreeCache[i].stored = false;
+        }
+    }
+
+
+
+static void freeContTreeCache() {
+    for( int i=0; i<CONT_TREE_CACHE_SIZE; i++ ) {
+        if( contTreeCache[i].tree != NULL ) {
+            delete contTreeCache[i].tree;
+            contTreeCache[i].tree = NULL;
+            }
+        }
+    }
+
+
+
+static ContTreeCacheRecord *contTreeCacheLookup( int inX, int inY ) {
+    return &( contTreeCache[ computeXYCacheHash( inX, inY ) % 
+                             CONT_TREE_CACHE_SIZE ] );
+    }
+
+
+
+// loads tree from contDB into cache if needed
+// returned tree is owned by cache, and valid until next contTreeGet call
+static ContTreeCacheRecord *contTreeGet( int inX, int inY ) {
+    ContTreeCacheRecord *r = contTreeCacheLookup( inX, inY );
+    
+    if( r->tree != NULL && r->x == inX && r->y == inY ) {
+        return r;
+        }
+
+    if( r->tree != NULL ) {
+        // evict
+        delete r->tree;
+        r->tree = NULL;
+        }
+    
+    r->x = inX;
+    r->y = inY;
+    r->stored = false;
+
+    unsigned char key[ CONTAINED_RECORD_KEY_BYTES ];
+    unsigned char firstPage[ CONTAINED_RECORD_PAGE_BYTES ];
+    
+    containedRecordKey( inX, inY, 0, key );
+    
+    // tile tells us whether a record can exist here, which saves a 
+    // contDB lookup for the vast majority of cells
+    char mayBeStored = 
+        mapTileGet( inX, inY )->contained[ 
+            getMapTileCellIndex( inX, inY ) ];
+    
+    if( mayBeStored && 
+        mapJournalGet( contJournalID, key, firstPage ) == 0 ) {
+        r->stored = true;
+        
+        int numPages = getContainedRecordNumPages( firstPage );
+        
+        if( numPages == 1 ) {
+            r->tree = decodeContainedRecord( firstPage, 1 );
+            }
+        else {
+            unsigned char *pages = 
+                new unsigned char[ numPages * CONTAINED_RECORD_PAGE_BYTES ];
+            
+            memcpy( pages, firstPage, CONTAINED_RECORD_PAGE_BYTES );
+            
+            char pagesFound = true;
+
+            for( int p=1; p<numPages; p++ ) {
+                containedRecordKey( inX, inY, p, key );
+            
+                if( mapJournalGet( 
+                        contJournalID, key, 
+                        &( pages[ p * CONTAINED_RECORD_PAGE_BYTES ] ) ) 
+                    != 0 ) {
+                    pagesFound = false;
+                    break;
+                    }
+                }
+            
+            if( pagesFound ) {
+                r->tree = decodeContainedRecord( pages, numPages );
+                }
+            delete [] pages;
+            }
+        
+        if( r->tree == NULL ) {
+            AppLog::errorF( "Corrupt container record at (%d,%d) in "
+                            "mapContained.db, treating as empty",
+                            inX, inY );
+            }
+        }
+    
+    if( r->tree == NULL ) {
+        r->tree = new ContainedTree;
+        }
+    
+    return r;
+    }
+
+
+
+// writes cached tree for x,y through to contDB
+// must call contTreeGet on x,y first
+static void contTreeStore( ContTreeCacheRecord *inRecord ) {
+    if( ! inRecord->stored && isContainedTreeEmpty( inRecord->tree ) ) {
+        // never need to store empty trees for cells that have never
+        // had a container
+        return;
+        }
+    
+    int numPages;
+    unsigned char *pages = encodeContainedRecord( inRecord->tree, &numPages );
+
+    unsigned char key[ CONTAINED_RECORD_KEY_BYTES ];
+    
+    for( int p=0; p<numPages; p++ ) {
+        containedRecordKey( inRecord->x, inRecord->y, p, key );
+        
+        mapJournalPut( contJournalID, key, 
+                       &( pages[ p * CONTAINED_RECORD_PAGE_BYTES ] ) );
+        }
+    
+    delete [] pages;
+
+    inRecord->stored = true;
+    
+    // flag set after record is written, so a crash in between leaves
+    // a record that initMap will find and flag
+    MapTile *tile = mapTileGet( inRecord->x, inRecord->y );
+    int cell = getMapTileCellIndex( inRecord->x, inRecord->y );
+    
+    if( ! tile->contained[ cell ] ) {
+        tile->contained[ cell ] = true;
+        mapTileStore( tile );
+        }
+    }
+
+
+
+// true if slot is part of a container tree (stored in contDB), rather
+// than a base map object or decay slot (stored in tiles in db)
+static char isContainerSlot( int inSlot, int inSubCont ) {
+    return 
+        inSubCont > 0 || 
+        inSlot >= NUM_CONT_SLOT || 
+        inSlot == NO_DECAY_SLOT;
+    }
+
+
+
+// these work on the same slot numbering as dbGet and dbPut do
+// (see the comments about map.db in initMap) 
+
+// returns -1 if not found
+static int contSlotGet( int inX, int inY, int inSlot, int inSubCont ) {
+    ContainedTree *tree = contTreeGet( inX, inY )->tree;
+    
+    if( inSubCont >= tree->levels.size() ) {
+        return -1;
+        }
+    
+    ContainedLevel *l = tree->levels.getElement( inSubCont );
+    
+    if( inSlot == NUM_CONT_SLOT ) {
+        return l->ids.size();
+        }
+    else if( inSlot == NO_DECAY_SLOT ) {
+        return l->noDecayFlag;
+        }
+    
+    int i = inSlot - FIRST_CONT_SLOT;
+    
+    if( i >= 0 && i < l->ids.size() ) {
+        return l->ids.getElementDirect( i );
+        }
+    return -1;
+    }
+
+
+
+static void contSlotPut( int inX, int inY, int inSlot, int inSubCont,
+                         int inValue ) {
+    ContTreeCacheRecord *r = contTreeGet( inX, inY );
+    
+    if( inSubCont >= r->tree->levels.size() &&
+        inSlot == NUM_CONT_SLOT && inValue == 0 ) {
+        // emptying a level that doesn't exist
+        return;
+        }
+
+    ContainedLevel *l = getContainedLevel( r->tree, inSubCont );
+    
+    if( inSlot == NUM_CONT_SLOT ) {
+        resizeContainedLevel( l, inValue );
+        }
+    else if( inSlot == NO_DECAY_SLOT ) {
+        l->noDecayFlag = inValue;
+        }
+    else {
+        int i = inSlot - FIRST_CONT_SLOT;
+    
+        if( i < 0 || i >= l->ids.size() ) {
+            // slots past count aren't stored
+            return;
+            }
+        *( l->ids.getElement( i ) ) = inValue;
+        }
+    
+    contTreeStore( r );
+    }
+
+
+
+// decay slots follow the contained slots, so slot numbers depend
+// on the current number of contained items
+// returns 0 if not found
+static timeSec_t contSlotTimeGet( int inX, int inY, int inSlot, 
+                                  int inSubCont ) {
+    ContainedTree *tree = contTreeGet( inX, inY )->tree;
+    
+    if( inSubCont >= tree->levels.size() ) {
+        return 0;
+        }
+    
+    ContainedLevel *l = tree->levels.getElement( inSubCont );
+    
+    int i = inSlot - FIRST_CONT_SLOT - l->ids.size();
+    
+    if( i >= 0 && i < l->etas.size() ) {
+        return l->etas.getElementDirect( i );
+        }
+    return 0;
+    }
+
+
+
+static void contSlotTimePut( int inX, int inY, int inSlot, int inSubCont,
+                             timeSec_t inTime ) {
+    ContTreeCacheRecord *r = contTreeGet( inX, inY );
+    
+    if( inSubCont >= r->tree->levels.size() ) {
+        return;
+        }
+
+    ContainedLevel *l = r->tree->levels.getElement( inSubCont );
+    
+    int i = inSlot - FIRST_CONT_SLOT - l->ids.size();
+    
+    if( i < 0 || i >= l->etas.size() ) {
+        return;
+        }
+    
+    *( l->etas.getElement( i ) ) = inTime;
+
+    contTreeStore( r );
+    }
+
+
+
+
+
+char lookTimeDBEmpty = false;
+char skipLookTimeCleanup = 0;
+char skipRemovedObjectCleanup = 0;
+
+// if lookTimeDBEmpty, then we init all map cell look times to NOW
+int cellsLookedAtToInit = 0;
+
+
+
+// look times are tracked for 100x100 regions
+//
+// while shrinking DBs, look times are read from this table, loaded from
+// lookTimeDB up front, so that shrink threads never touch lookTimeDB
+static FlatHashTable<timeSec_t> *shrinkLookTimes = NULL;
+
+
+static void loadShrinkLookTimes() {
+    shrinkLookTimes = new FlatHashTable<timeSec_t>( 4096, 0 );
+
+    DB_Iterator dbi;
+    DB_Iterator_init( &lookTimeDB, &dbi );
+    
+    unsigned char key[8];
+    unsigned char value[8];
+    
+    while( DB_Iterator_next( &dbi, key, value ) > 0 ) {
+        int regionX = valueToInt( key );
+        int regionY = valueToInt( &( key[4] ) );
+        
+        shrinkLookTimes->insert( regionX, regionY, 0, 0, 
+                                 valueToTime( value ) );
+        }
+    }
+
+
+static void freeShrinkLookTimes() {
+    if( shrinkLookTimes != NULL ) {
+        delete shrinkLookTimes;
+        shrinkLookTimes = NULL;
+        }
+    }
+
+
+
+// same regions as dbLookTimeGet
+static char shrinkLookTimeExists( int inX, int inY ) {
+    char found;
+    
+    timeSec_t t = shrinkLookTimes->lookup( inX / 100, inY / 100, 0, 0, 
+                                           &found );
+    
+    return found && t > 0;
+    }
+
+
+
+// checking the corners of a smaller square covers every region that it 
+// touches
+static char anyLookTime( int inX, int inY, int inCellSpan ) {
+    int far = inCellSpan - 1;
+    
+    return 
+        shrinkLookTimeExists( inX, inY ) ||
+        shrinkLookTimeExists( inX + far, inY ) ||
+        shrinkLookTimeExists( inX, inY + far ) ||
+        shrinkLookTimeExists( inX + far, inY + far );
+    }
+
+
+
+// one DB file to rebuild without its stale records
+typedef struct TimeShrinkJob {
+        const char *path;
+        unsigned long keySize;
+        unsigned long valueSize;
+        int cellSpan;
+
+        // progress, guarded by timeShrinkLock
+        // numRecords is 0 if DB can't count its records
+        int numRead;
+        int numRecords;
+        char done;
+
+        // results, valid once done
+        int error;
+        int total;
+        int stale;
+        double seconds;
+    } TimeShrinkJob;
+
+
+static MutexLock timeShrinkLock;
+
+
+static void initTimeShrinkJob( TimeShrinkJob *inJob, const char *inPath,
+                               unsigned long inKeySize, 
+                               unsigned long inValueSize,
+                               int inCellSpan = 1 ) {
+    inJob->path = inPath;
+    inJob->keySize = inKeySize;
+    inJob->valueSize = inValueSize;
+    inJob->cellSpan = inCellSpan;
+    
+    inJob->numRead = 0;
+    inJob->numRecords = 0;
+    inJob->done = false;
+    
+    inJob->error = 0;
+    inJob->total = 0;
+    inJob->stale = 0;
+    inJob->seconds = 0;
+    }
+
+
+
+// copies non-stale records from inJob->path into a temp DB in one pass,
+// then renames the temp file over the original
+//
+// Safe to run for several different DBs at once, because it only reads
+// shrinkLookTimes, and only touches its own job through timeShrinkLock.
+// Doesn't log, leaving that to the caller.
+static void runTimeShrinkJob( TimeShrinkJob *inJob ) {
+    double startTime = Time::getCurrentTime();
+
+    const char *path = inJob->path;
+    
+    char *dbTempName = autoSprintf( "%s.temp", path );
+    File dbTempFile( NULL, dbTempName );
+    
+    if( dbTempFile.exists() ) {
+        dbTempFile.remove();
+        }
+    
+    DB oldDB;
+    DB tempDB;
+    
+    int error = 0;
+    
+    if( dbTempFile.exists() ) {
+        error = 1;
+        }
+    else {
+        error = DB_open( &oldDB, 
+                         path, 
+                         KISSDB_OPEN_MODE_RWCREAT,
+                         80000,
+                         inJob->keySize,
+                         inJob->valueSize );
+        }
+    
+    if( error ) {
+        delete [] dbTempName;
+        
+        timeShrinkLock.lock();
+        inJob->error = error;
+        inJob->seconds = Time::getCurrentTime() - startTime;
+        inJob->done = true;
+        timeShrinkLock.unlock();
+        return;
+        }
+    
+    int numRecords = DB_getNumRecords( &oldDB );
+
+    // we don't know how many records are stale until we've seen all of
+    // them, so size temp DB as if all are kept
+    // (it's reopened at the right size after the rename)
+    unsigned int newSize = DB_getCurrentSize( &oldDB );
+    
+    if( numRecords > 0 ) {
+        newSize = DB_getShrinkSize( &oldDB, numRecords );
+        }
+    
+    timeShrinkLock.lock();
+    inJob->numRecords = numRecords;
+    timeShrinkLock.unlock();
+
+    error = DB_open( &tempDB, 
+                     dbTempName, 
+                     KISSDB_OPEN_MODE_RWCREAT,
+                     newSize,
+                     inJob->keySize,
+                     inJob->valueSize );
+
+    int total = 0;
+    int stale = 0;
+
+    if( ! error ) {
+        DB_Iterator dbi;
+        DB_Iterator_init( &oldDB, &dbi );
+        
+        // key size that is big enough to handle all of our DB
+        unsigned char key[16];
+        
+        unsigned char *value = new unsigned char[ inJob->valueSize ];
+
+        while( DB_Iterator_next( &dbi, key, value ) > 0 ) {
+            total++;
+
+            int x = valueToInt( key );
+            int y = valueToInt( &( key[4] ) );
+            
+            if( anyLookTime( x, y, inJob->cellSpan ) ) {
+                // keep
+                DB_put_new( &tempDB, key, value );
+                }
+            else {
+                stale++;
+                }
+            
+            if( total % 4096 == 0 ) {
+                timeShrinkLock.lock();
+                inJob->numRead = total;
+                timeShrinkLock.unlock();
+                }
+            }
+        
+        delete [] value;
+        
+        DB_close( &tempDB );
+        }
+    
+    DB_close( &oldDB );
+    
+    if( ! error ) {
+        // old file stays whole until this point, so a crash mid-shrink
+        // leaves only a stale temp file behind
+        if( rename( dbTempName, path ) != 0 ) {
+            // some platforms won't rename over an existing file
+            remove( path );
+            
+            if( rename( dbTempName, path ) != 0 ) {
+                error = 1;
+                }
+            }
+        }
+    else {
+        dbTempFile.remove();
+        }
+
+    delete [] dbTempName;
+
+    timeShrinkLock.lock();
+    inJob->numRead = total;
+    inJob->error = error;
+    inJob->total = total;
+    inJob->stale = stale;
+    inJob->seconds = Time::getCurrentTime() - startTime;
+    inJob->done = true;
+    timeShrinkLock.unlock();
+    }
+
+
+
+static void logTimeShrinkResult( TimeShrinkJob *inJob ) {
+    if( inJob->error ) {
+        AppLog::errorF( "Failed to shrink DB file %s, leaving it as is",
+                        inJob->path );
+        return;
+        }
+    
+    AppLog::infoF( "Cleaned %d / %d stale map cells from %s in %.3f sec", 
+                   inJob->stale, inJob->total, inJob->path, inJob->seconds );
+    }
+
+
+
+class TimeShrinkThread : public Thread {
+    public:
+        
+        TimeShrinkThread( TimeShrinkJob *inJob )
+                : mJob( inJob ) {
+            start();
+            }
+        
+        ~TimeShrinkThread() {
+            join();
+            }
+        
+        virtual void run() {
+            runTimeShrinkJob( mJob );
+            }
+        
+    private:
+        TimeShrinkJob *mJob;
+    };
+
+
+
+// shrinks several DBs at once, one thread each, logging progress 
+// every second from the calling thread
+// lookTimeDB MUST be open before calling this, and the DBs must not be
+static void runTimeShrinkJobs( TimeShrinkJob *inJobs, int inNumJobs ) {
+    double startTime = Time::getCurrentTime();
+    
+    loadShrinkLookTimes();
+    
+    TimeShrinkThread **threads = new TimeShrinkThread*[ inNumJobs ];
+    
+    for( int i=0; i<inNumJobs; i++ ) {
+        threads[i] = new TimeShrinkThread( &( inJobs[i] ) );
+        }
+    
+    double lastLogTime = startTime;
+    
+    char allDone = false;
+    
+    while( ! allDone ) {
+        Thread::staticSleep( 100 );
+
+        double curTime = Time::getCurrentTime();
+        
+        char logNow = ( curTime - lastLogTime >= 1 );
+        
+        if( logNow ) {
+            lastLogTime = curTime;
+            }
+        
+        allDone = true;
+        
+        timeShrinkLock.lock();
+        
+        for( int i=0; i<inNumJobs; i++ ) {
+            TimeShrinkJob *j = &( inJobs[i] );
+            
+            if( ! j->done ) {
+                allDone = false;
+                
+                if( logNow ) {
+                    if( j->numRecords > 0 ) {
+                        AppLog::infoF( "Shrinking %s, %d%% done", 
+                                       j->path,
+                                       ( 100 * j->numRead ) / 
+                                       j->numRecords );
+                        }
+                    else {
+                        AppLog::infoF( "Shrinking %s, %d records read", 
+                                       j->path, j->numRead );
+                        }
+                    }
+                }
+            }
+        
+        timeShrinkLock.unlock();
+        }
+    
+    for( int i=0; i<inNumJobs; i++ ) {
+        delete threads[i];
+        
+        logTimeShrinkResult( &( inJobs[i] ) );
+        }
+    delete [] threads;
     
-    BlockingCacheRecord *r =
-        &( blockingCache[ computeXYCacheHash( inX, inY ) ] );
+    freeShrinkLookTimes();
 
-    if( r->x == inX && r->y == inY ) {
-        r->blocking = -1;
-        }
+    AppLog::infoF( "Shrinking %d map DBs took %.3f sec", 
+                   inNumJobs, Time::getCurrentTime() - startTime );
     }
 
 
 
-
-
-char lookTimeDBEmpty = false;
-char skipLookTimeCleanup = 0;
-char skipRemovedObjectCleanup = 0;
-
-// if lookTimeDBEmpty, then we init all map cell look times to NOW
-int cellsLookedAtToInit = 0;
+// set while opening DBs that runTimeShrinkJobs already handled
+static char dbsAlreadyTimeShrunk = false;
 
 
 
@@ -1663,19 +2763,25 @@ int cellsLookedAtToInit = 0;
 // If lookTimeDBEmpty, this call just opens the target DB normally without
 // shrinking it.
 //
-// Can handle max key and value size of 16 and 12 bytes
+// Can handle max key size of 16 bytes
 // Assumes that first 8 bytes of key are xy as 32-bit ints
+//
+// For DBs where each record covers a square of cells (like map tiles),
+// inCellSpan is the width of that square, with xy being its lowest corner.
+// The record is kept if any of its cells has a look time.
 int DB_open_timeShrunk(
 	DB *db,
 	const char *path,
 	int mode,
 	unsigned long hash_table_size,
 	unsigned long key_size,
-	unsigned long value_size) {
+	unsigned long value_size,
+	int inCellSpan = 1 ) {
 
     File dbFile( NULL, path );
     
-    if( ! dbFile.exists() || lookTimeDBEmpty || skipLookTimeCleanup ) {
+    if( ! dbFile.exists() || lookTimeDBEmpty || skipLookTimeCleanup ||
+        dbsAlreadyTimeShrunk ) {
 
         if( lookTimeDBEmpty ) {
             AppLog::infoF( "No lookTimes present, not cleaning %s", path );
@@ -1688,7 +2794,7 @@ int DB_open_timeShrunk(
                                  key_size,
                                  value_size );
 
-        if( ! error && ! skipLookTimeCleanup ) {
+        if( ! error && ! skipLookTimeCleanup && ! dbsAlreadyTimeShrunk ) {
             // add look time for cells in this DB to present
             // essentially resetting all look times to NOW
             
@@ -1697,11 +2803,13 @@ int DB_open_timeShrunk(
     
             DB_Iterator_init( db, &dbi );
     
-            // key and value size that are big enough to handle all of our DB
+            // key size that is big enough to handle all of our DB
             unsigned char key[16];
     
-            unsigned char value[12];
+            unsigned char *value = new unsigned char[ value_size ];
     
+            int far = inCellSpan - 1;
+
             while( DB_Iterator_next( &dbi, key, value ) > 0 ) {
                 int x = valueToInt( key );
                 int y = valueToInt( &( key[4] ) );
@@ -1709,147 +2817,31 @@ int DB_open_timeShrunk(
                 cellsLookedAtToInit++;
                 
                 dbLookTimePut( x, y, MAP_TIMESEC );
+
+                if( far > 0 ) {
+                    dbLookTimePut( x + far, y, MAP_TIMESEC );
+                    dbLookTimePut( x, y + far, MAP_TIMESEC );
+                    dbLookTimePut( x + far, y + far, MAP_TIMESEC );
+                    }
                 }
+            
+            delete [] value;
             }
         return error;
         }
     
-    char *dbTempName = autoSprintf( "%s.temp", path );
-    File dbTempFile( NULL, dbTempName );
-    
-    if( dbTempFile.exists() ) {
-        dbTempFile.remove();
-        }
-    
-    if( dbTempFile.exists() ) {
-        AppLog::errorF( "Failed to remove temp DB file %s", dbTempName );
-
-        delete [] dbTempName;
-
-        return DB_open( db, 
-                            path, 
-                            mode,
-                            hash_table_size,
-                            key_size,
-                            value_size );
-        }
-    
-    DB oldDB;
-    
-    int error = DB_open( &oldDB, 
-                             path, 
-                             mode,
-                             hash_table_size,
-                             key_size,
-                             value_size );
-    if( error ) {
-        AppLog::errorF( "Failed to open DB file %s in DB_open_timeShrunk",
-                        path );
-        delete [] dbTempName;
-
-        return error;
-        }
-
-    
-
-    
 
+    TimeShrinkJob job;
+    initTimeShrinkJob( &job, path, key_size, value_size, inCellSpan );
     
-    DB_Iterator dbi;
-    
-    
-    DB_Iterator_init( &oldDB, &dbi );
-    
-    // key and value size that are big enough to handle all of our DB
-    unsigned char key[16];
-    
-    unsigned char value[12];
-    
-    int total = 0;
-    int stale = 0;
-    int nonStale = 0;
-    
-    // first, just count
-    while( DB_Iterator_next( &dbi, key, value ) > 0 ) {
-        total++;
-
-        int x = valueToInt( key );
-        int y = valueToInt( &( key[4] ) );
-
-        if( dbLookTimeGet( x, y ) > 0 ) {
-            // keep
-            nonStale++;
-            }
-        else {
-            // stale
-            // ignore
-            stale++;
-            }
-        }
-
-
-
-    // optimial size for DB of remaining elements
-    unsigned int newSize = DB_getShrinkSize( &oldDB, nonStale );
-
-    AppLog::infoF( "Shrinking hash table in %s from %d down to %d", 
-                   path, 
-                   DB_getCurrentSize( &oldDB ), 
-                   newSize );
-
-
-    DB tempDB;
+    loadShrinkLookTimes();
     
-    error = DB_open( &tempDB, 
-                         dbTempName, 
-                         mode,
-                         newSize,
-                         key_size,
-                         value_size );
-    if( error ) {
-        AppLog::errorF( "Failed to open DB file %s in DB_open_timeShrunk",
-                        dbTempName );
-        delete [] dbTempName;
-        DB_close( &oldDB );
-        return error;
-        }
-
-
-    // now that we have new temp db properly sized,
-    // iterate again and insert, but don't count
-    DB_Iterator_init( &oldDB, &dbi );
-
-    while( DB_Iterator_next( &dbi, key, value ) > 0 ) {
-        int x = valueToInt( key );
-        int y = valueToInt( &( key[4] ) );
+    runTimeShrinkJob( &job );
 
-        if( dbLookTimeGet( x, y ) > 0 ) {
-            // keep
-            // insert it in temp
-            DB_put_new( &tempDB, key, value );
-            }
-        else {
-            // stale
-            // ignore
-            }
-        }
+    freeShrinkLookTimes();
 
-
-    
-    AppLog::infoF( "Cleaned %d / %d stale map cells from %s", stale, total,
-                   path );
-
-    printf( "\n" );
+    logTimeShrinkResult( &job );
     
-    
-    DB_close( &tempDB );
-    DB_close( &oldDB );
-
-    dbTempFile.copy( &dbFile );
-    dbTempFile.remove();
-
-    delete [] dbTempName;
-
     // now open new, shrunk file
     return DB_open( db, 
                         path, 
@@ -1905,15 +2897,20 @@ int cleanMap() {
     
     skipTrackingMapChanges = true;
     
+    // iterating reads DB files directly
+    flushMapJournal();
+
     DB_Iterator dbi;
     
     
     DB_Iterator_init( &db, &dbi );
     
-    unsigned char key[16];
+    unsigned char key[ MAP_TILE_KEY_BYTES ];
     
-    unsigned char value[4];
+    unsigned char *value = new unsigned char[ MAP_TILE_BYTES ];
 
+    MapTile tile;
+    
 
     // keep list of x,y coordinates in map that need clearing
     SimpleVector<int> xToClear;
@@ -1933,11 +2930,11 @@ int cleanMap() {
     while( DB_Iterator_next( &dbi, key, value ) > 0 ) {
         totalDBRecordCount++;
         
-        int s = valueToInt( &( key[8] ) );
-        int b = valueToInt( &( key[12] ) );
+        decodeMapTile( value, valueToInt( key ), valueToInt( &( key[4] ) ),
+                       &tile );
        
-        if( s == 0 ) {
-            int id = valueToInt( value );
+        for( int c=0; c<MAP_TILE_CELLS; c++ ) {
+            int id = tile.objects[c];
             
             if( id > 0 ) {
                 totalSetCount++;
@@ -1963,24 +2960,43 @@ int cleanMap() {
 
                     numClearedCount++;
                     
-                    int x = valueToInt( key );
-                    int y = valueToInt( &( key[4] ) );
+                    int x = tile.originX + c % MAP_TILE_D;
+                    int y = tile.originY + c / MAP_TILE_D;
                     
                     xToClear.push_back( x );
                     yToClear.push_back( y );
                     }
                 }
             }
-        if( s == 2 && b == 0 ) {
-            int numSlots = valueToInt( value );
-            if( numSlots > 0 ) {
-                totalNumContained += numSlots;
-                
-                int x = valueToInt( key );
-                int y = valueToInt( &( key[4] ) );
-                xContToCheck.push_back( x );
-                yContToCheck.push_back( y );
-                }
+        }
+    
+
+    delete [] value;
+    
+
+    // containers are stored separately, one record per x,y
+    DB_Iterator_init( &contDB, &dbi );
+    
+    unsigned char contKey[ CONTAINED_RECORD_KEY_BYTES ];
+    unsigned char contValue[ CONTAINED_RECORD_PAGE_BYTES ];
+
+    while( DB_Iterator_next( &dbi, contKey, contValue ) > 0 ) {
+        int page = valueToInt( &( contKey[8] ) );
+        
+        if( page != 0 ) {
+            continue;
+            }
+        
+        int x = valueToInt( contKey );
+        int y = valueToInt( &( contKey[4] ) );
+
+        int numSlots = contSlotGet( x, y, NUM_CONT_SLOT, 0 );
+        
+        if( numSlots > 0 ) {
+            totalNumContained += numSlots;
+
+            xContToCheck.push_back( x );
+            yContToCheck.push_back( y );
             }
         }
     
@@ -2133,7 +3149,7 @@ int cleanMap() {
     AppLog::infoF( 
         "...%d contained objects present, and %d needed to be cleared.",
         totalNumContained, numContainedCleared );
-    AppLog::infoF( "...%d database records total (%d max hash bin depth).", 
+    AppLog::infoF( "...%d map tiles total (%d max hash bin depth).", 
                    totalDBRecordCount, DB_maxStack );
     
     printf( "\n" );
@@ -2396,14 +3412,18 @@ char initMap() {
 
 
     initDBCaches();
+    initChunkCache();
+    initChunkWorkers();
+    initHeatField();
+    initContTreeCache();
     initBiomeCache();
 
     mapCacheClear();
     
-    edgeObjectID = SettingsManager::getIntSetting( "edgeObject", 0 );
+    edgeObjectID = getCachedIntSetting( "edgeObject", 0 );
     
     minEveCampRespawnAge = 
-        SettingsManager::getFloatSetting( "minEveCampRespawnAge", 60.0f );
+        getCachedFloatSetting( "minEveCampRespawnAge", 60.0f );
     
 
     for( int i=0; i<NUM_RECENT_PLACEMENTS; i++ ) {
@@ -2476,7 +3496,7 @@ char initMap() {
             int longX = 0;
             int longY = 0;
             
-            timeSec_t curTime = Time::timeSec();
+            timeSec_t curTime = MAP_TIMESEC;
 
             int secInDay = 3600 * 24;
             
@@ -2538,7 +3558,7 @@ char initMap() {
 
 
     if( lookTimeDBFile.exists() &&
-        SettingsManager::getIntSetting( "flushLookTimes", 0 ) ) {
+        getCachedIntSetting( "flushLookTimes", 0 ) ) {
         
         AppLog::info( "flushLookTimes.ini set, deleting lookTime.db" );
         
@@ -2555,7 +3575,7 @@ char initMap() {
 
 
     skipLookTimeCleanup = 
-        SettingsManager::getIntSetting( "skipLookTimeCleanup", 0 );
+        getCachedIntSetting( "skipLookTimeCleanup", 0 );
 
 
     if( skipLookTimeCleanup ) {
@@ -2565,6 +3585,17 @@ char initMap() {
 
     LINEARDB3_setMaxLoad( 0.80 );
     
+    // read map records straight out of memory-mapped files instead of
+    // seeking and reading through stdio for each DB_get
+    char useMmapDB = getCachedIntSetting( "useMmapDB", 1 );
+    
+    LINEARDB3_setUseMmap( useMmapDB );
+
+    if( useMmapDB ) {
+        AppLog::info( "useMmapDB.ini flag set, "
+                      "opening map databases in mmap mode." );
+        }
+    
     if( ! skipLookTimeCleanup ) {
         DB lookTimeDB_old;
         
@@ -2585,7 +3616,7 @@ char initMap() {
     
 
         int staleSec = 
-            SettingsManager::getIntSetting( "mapCellForgottenSeconds", 0 );
+            getCachedIntSetting( "mapCellForgottenSeconds", 0 );
     
         if( lookTimeDBExists && staleSec > 0 ) {
             AppLog::info( "\nCleaning stale look times from map..." );
@@ -2718,88 +3749,203 @@ char initMap() {
     
     lookTimeDBOpen = true;
     
+    addIncrementalBackupDB( "lookTime", &lookTimeDB );
+    
+    
+
+
+    File mapDBFile( NULL, "map.db" );
+    File contDBFile( NULL, "mapContained.db" );
+    
+    if( mapDBFile.exists() && ! contDBFile.exists() ) {
+        AppLog::error( 
+            "map.db exists without mapContained.db, so containers are still "
+            "stored one record per slot in map.db and mapTime.db.  "
+            "Run dbConvertContainers (see convertDBs4.sh) before starting "
+            "the server." );
+        return false;
+        }
+    
+
+    File tileDBFile( NULL, "mapTiles.db" );
+    
+    if( mapDBFile.exists() && ! tileDBFile.exists() ) {
+        AppLog::error( 
+            "map.db exists without mapTiles.db, so objects and floors are "
+            "still stored one record per cell in map.db, mapTime.db, "
+            "floor.db, and floorTime.db.  "
+            "Run dbConvertTiles (see convertDBs5.sh) before starting "
+            "the server." );
+        return false;
+        }
     
 
+    // put back any map changes that were only in the journal when the
+    // server went down, before DB files are shrunk or opened
+    tileJournalID = addMapJournalDB( "mapTiles.db", 
+                                     MAP_TILE_KEY_BYTES, MAP_TILE_BYTES );
+    contJournalID = addMapJournalDB( "mapContained.db",
+                                     CONTAINED_RECORD_KEY_BYTES, 
+                                     CONTAINED_RECORD_PAGE_BYTES );
+    
+    if( ! replayMapJournal() ) {
+        return false;
+        }
+    
 
-    // note that the various decay ETA slots in map.db 
-    // are define but unused, because we store times separately
-    // in mapTime.db
+    if( ! lookTimeDBEmpty && ! skipLookTimeCleanup ) {
+        // shrink all map DBs at once, instead of one by one as each is
+        // opened below
+        TimeShrinkJob shrinkJobs[3];
+        int numShrinkJobs = 0;
+        
+        if( tileDBFile.exists() ) {
+            initTimeShrinkJob( &( shrinkJobs[ numShrinkJobs++ ] ),
+                               "mapTiles.db", 
+                               MAP_TILE_KEY_BYTES, MAP_TILE_BYTES,
+                               MAP_TILE_D );
+            }
+        if( contDBFile.exists() ) {
+            initTimeShrinkJob( &( shrinkJobs[ numShrinkJobs++ ] ),
+                               "mapContained.db", 
+                               CONTAINED_RECORD_KEY_BYTES, 
+                               CONTAINED_RECORD_PAGE_BYTES );
+            }
+        
+        File biomeDBFile( NULL, "biome.db" );
+
+        if( biomeDBFile.exists() ) {
+            initTimeShrinkJob( &( shrinkJobs[ numShrinkJobs++ ] ),
+                               "biome.db", 8, 12 );
+            }
+        
+        if( numShrinkJobs > 0 ) {
+            runTimeShrinkJobs( shrinkJobs, numShrinkJobs );
+            }
+        
+        dbsAlreadyTimeShrunk = true;
+        }
+    
+
+    // each record holds a MAP_TILE_D x MAP_TILE_D tile of cells, with the
+    // base object (slot 0 in dbGet/dbPut), its decay ETA (DECAY_SLOT in 
+    // dbTimeGet/dbTimePut), the floor, and the floor decay ETA for each
+    // cell (see mapTile.h)
+    //
+    // contained slots (s >= 2 or b > 0, see below) are stored in 
+    // mapContained.db
+    //
+    // slot numbering on the dbGet/dbPut level:
+    // s is the slot number 
+    // s=0 for base object
+    // s=1 decay ETA seconds (wall clock time)
+    // s=2 for count of contained objects
+    // s=3 first contained object
+    // s=4 second contained object
+    // s=... remaining contained objects
+    // Then decay ETA for each slot, in order,
+    //   after that.
+    // s = -1
+    //  is a special flag slot set to 0 if NONE
+    //  of the contained items have ETA decay
+    //  or 1 if some of the contained items might 
+    //  have ETA decay.
+    //  (this saves us from having to check each
+    //   one)
+    // If a contained object id is negative,
+    // that indicates that it sub-contains
+    // other objects in its corresponding b slot
+    //
+    // b is for indexing sub-container slots
+    // b=0 is the main object 
+    // b=1 is the first sub-slot, etc.
     error = DB_open_timeShrunk( &db, 
-                         "map.db", 
+                         "mapTiles.db", 
                          KISSDB_OPEN_MODE_RWCREAT,
                          80000,
-                         16, // four 32-bit ints, xysb
-                             // s is the slot number 
-                             // s=0 for base object
-                             // s=1 decay ETA seconds (wall clock time)
-                             // s=2 for count of contained objects
-                             // s=3 first contained object
-                             // s=4 second contained object
-                             // s=... remaining contained objects
-                             // Then decay ETA for each slot, in order,
-                             //   after that.
-                             // s = -1
-                             //  is a special flag slot set to 0 if NONE
-                             //  of the contained items have ETA decay
-                             //  or 1 if some of the contained items might 
-                             //  have ETA decay.
-                             //  (this saves us from having to check each
-                             //   one)
-                             // If a contained object id is negative,
-                             // that indicates that it sub-contains
-                             // other objects in its corresponding b slot
-                             //
-                             // b is for indexing sub-container slots
-                             // b=0 is the main object 
-                             // b=1 is the first sub-slot, etc.
-                         4 // one int, object ID at x,y in slot (s-3)
-                           // OR contained count if s=2
+                         MAP_TILE_KEY_BYTES, 
+                         // two 32-bit ints, xy of tile's origin cell
+                         MAP_TILE_BYTES,
+                         // all cells in tile
+                         MAP_TILE_D
                          );
     
     if( error ) {
-        AppLog::errorF( "Error %d opening map KissDB", error );
+        AppLog::errorF( "Error %d opening map tile KissDB", error );
         return false;
         }
     
     dbOpen = true;
 
+    addIncrementalBackupDB( "mapTiles", &db );
 
+    initMapTileCache();
 
-    // this DB uses the same slot numbers as the map.db
-    // however, only times are stored here, because they require 8 bytes
-    // so, slot 0 and 2 are never used, for example
-    error = DB_open_timeShrunk( &timeDB, 
-                         "mapTime.db", 
+
+
+    error = DB_open_timeShrunk( &contDB, 
+                         "mapContained.db", 
                          KISSDB_OPEN_MODE_RWCREAT,
                          80000,
-                         16, // four 32-bit ints, xysb
-                         // s is the slot number 
-                         // s=0 for base object
-                         // s=1 decay ETA seconds (wall clock time)
-                         // s=2 for count of contained objects
-                         // s=3 first contained object
-                         // s=4 second contained object
-                         // s=... remaining contained objects
-                         // Then decay ETA for each slot, in order,
-                         //   after that.
-                             // If a contained object id is negative,
-                             // that indicates that it sub-contains
-                             // other objects in its corresponding b slot
-                             //
-                             // b is for indexing sub-container slots
-                             // b=0 is the main object 
-                             // b=1 is the first sub-slot, etc.
-                         8 // one 64-bit double, representing an ETA time
-                           // in whatever binary format and byte order
-                           // "double" on the server platform uses
+                         CONTAINED_RECORD_KEY_BYTES, 
+                         // three 32-bit ints, xyp
+                         // p is page number of the record for x,y
+                         CONTAINED_RECORD_PAGE_BYTES
+                         // one page of the encoded container tree
+                         // at x,y (see containedRecord.h)
                          );
     
     if( error ) {
-        AppLog::errorF( "Error %d opening map time KissDB", error );
+        AppLog::errorF( "Error %d opening map contained KissDB", error );
         return false;
         }
     
-    timeDBOpen = true;
+    contDBOpen = true;
+
+    addIncrementalBackupDB( "mapContained", &contDB );
+
+    LINEARDB3 *journalDBs[2];
+    journalDBs[ tileJournalID ] = &db;
+    journalDBs[ contJournalID ] = &contDB;
+    
+    initMapJournal( journalDBs );
+
+    
+    // make sure tiles flag every cell that has a container record
+    // flags can be missing if server crashed between writing a record
+    // and its flag
+    DB_Iterator contDBi;
+    DB_Iterator_init( &contDB, &contDBi );
+    
+    unsigned char contKey[ CONTAINED_RECORD_KEY_BYTES ];
+    unsigned char contValue[ CONTAINED_RECORD_PAGE_BYTES ];
+    
+    int numContFlagsFixed = 0;
+
+    while( DB_Iterator_next( &contDBi, contKey, contValue ) > 0 ) {
+        int page = valueToInt( &( contKey[8] ) );
+        
+        if( page != 0 ) {
+            continue;
+            }
+
+        int x = valueToInt( contKey );
+        int y = valueToInt( &( contKey[4] ) );
+        
+        MapTile *tile = mapTileGet( x, y );
+        int cell = getMapTileCellIndex( x, y );
+        
+        if( ! tile->contained[ cell ] ) {
+            tile->contained[ cell ] = true;
+            mapTileStore( tile );
+            numContFlagsFixed++;
+            }
+        }
+    
+    if( numContFlagsFixed > 0 ) {
+        AppLog::infoF( "Flagged %d container records missing from map tiles",
+                       numContFlagsFixed );
+        }
 
 
 
@@ -2825,6 +3971,10 @@ char initMap() {
     
     biomeDBOpen = true;
 
+    addIncrementalBackupDB( "biome", &biomeDB );
+
+    dbsAlreadyTimeShrunk = false;
+
 
 
     // see if any biomes are listed in DB
@@ -2864,42 +4014,6 @@ char initMap() {
             
 
 
-    error = DB_open_timeShrunk( &floorDB, 
-                         "floor.db", 
-                         KISSDB_OPEN_MODE_RWCREAT,
-                         80000,
-                         8, // two 32-bit ints, xy
-                         4 // one int, the floor object ID at x,y 
-                         );
-    
-    if( error ) {
-        AppLog::errorF( "Error %d opening floor KissDB", error );
-        return false;
-        }
-    
-    floorDBOpen = true;
-
-
-
-    error = DB_open_timeShrunk( &floorTimeDB, 
-                         "floorTime.db", 
-                         KISSDB_OPEN_MODE_RWCREAT,
-                         80000,
-                         8, // two 32-bit ints, xy
-                         8 // one 64-bit double, representing an ETA time
-                           // in whatever binary format and byte order
-                           // "double" on the server platform uses
-                         );
-    
-    if( error ) {
-        AppLog::errorF( "Error %d opening floor time KissDB", error );
-        return false;
-        }
-    
-    floorTimeDBOpen = true;
-
-
-
     // ALWAYS delete old grave DB at each server startup
     // grave info is only player ID, and server only remembers players
     // live, in RAM, while it is still running
@@ -3075,7 +4189,7 @@ char initMap() {
 
     
     skipRemovedObjectCleanup = 
-        SettingsManager::getIntSetting( "skipRemovedObjectCleanup", 0 );
+        getCachedIntSetting( "skipRemovedObjectCleanup", 0 );
 
 
 
@@ -3187,7 +4301,7 @@ char initMap() {
 
 
 
-    useTestMap = SettingsManager::getIntSetting( "useTestMap", 0 );
+    useTestMap = getCachedIntSetting( "useTestMap", 0 );
     
 
     if( useTestMap ) {        
@@ -3317,12 +4431,22 @@ void freeMap( char inSkipCleanup ) {
 
     skipTrackingMapChanges = true;
     
+    stopMapTrace();
+
     if( lookTimeDBOpen ) {
+        removeIncrementalBackupDB( &lookTimeDB );
         DB_close( &lookTimeDB );
         lookTimeDBOpen = false;
         }
 
 
+    if( dbOpen ) {
+        removeIncrementalBackupDB( &db );
+        }
+
+    // cleanup below reads and writes DB files directly
+    freeMapJournal();
+
     if( dbOpen && ! inSkipCleanup ) {
         
         AppLog::infoF( "Cleaning up map database on server shutdown." );
@@ -3338,10 +4462,12 @@ void freeMap( char inSkipCleanup ) {
     
         DB_Iterator_init( &db, &dbi );
     
-        unsigned char key[16];
+        unsigned char key[ MAP_TILE_KEY_BYTES ];
     
-        unsigned char value[4];
+        unsigned char *value = new unsigned char[ MAP_TILE_BYTES ];
 
+        MapTile tile;
+        
 
         // keep list of x,y coordinates in map that need replacing
         SimpleVector<int> xToPlace;
@@ -3357,7 +4483,7 @@ void freeMap( char inSkipCleanup ) {
         
         
         int skipUseDummyCleanup = 
-            SettingsManager::getIntSetting( "skipUseDummyCleanup", 0 );
+            getCachedIntSetting( "skipUseDummyCleanup", 0 );
         
         
 
@@ -3368,21 +4494,22 @@ void freeMap( char inSkipCleanup ) {
             
             while( DB_Iterator_next( &dbi, key, value ) > 0 ) {
         
-                int s = valueToInt( &( key[8] ) );
-                int b = valueToInt( &( key[12] ) );
+                decodeMapTile( value, 
+                               valueToInt( key ), valueToInt( &( key[4] ) ),
+                               &tile );
        
-                if( s == 0 ) {
-                    int id = valueToInt( value );
+                for( int c=0; c<MAP_TILE_CELLS; c++ ) {
+                    int id = tile.objects[c];
             
                     if( id > 0 ) {
                     
                         ObjectRecord *mapO = getObject( id );
                     
+                        int x = tile.originX + c % MAP_TILE_D;
+                        int y = tile.originY + c / MAP_TILE_D;
                     
                         if( mapO != NULL ) {
                             if( mapO->isUseDummy ) {
-                                int x = valueToInt( key );
-                                int y = valueToInt( &( key[4] ) );
                     
                                 xToPlace.push_back( x );
                                 yToPlace.push_back( y );
@@ -3391,9 +4518,6 @@ void freeMap( char inSkipCleanup ) {
                                 rememberDummy( dummyFile, x, y, mapO );
                                 }
                             else if( mapO->isVariableDummy ) {
-                                int x = valueToInt( key );
-                                int y = valueToInt( &( key[4] ) );
-                            
                                 xToPlace.push_back( x );
                                 yToPlace.push_back( y );
                                 idToPlace.push_back( 
@@ -3404,11 +4528,31 @@ void freeMap( char inSkipCleanup ) {
                             }
                         }
                     }
-                else if( s == 2 ) {
-                    int numSlots = valueToInt( value );
+                }
+            
+            
+            // containers are stored separately, one record per x,y
+            DB_Iterator_init( &contDB, &dbi );
+    
+            unsigned char contKey[ CONTAINED_RECORD_KEY_BYTES ];
+            unsigned char contValue[ CONTAINED_RECORD_PAGE_BYTES ];
+
+            while( DB_Iterator_next( &dbi, contKey, contValue ) > 0 ) {
+                int page = valueToInt( &( contKey[8] ) );
+                
+                if( page != 0 ) {
+                    continue;
+                    }
+                
+                int x = valueToInt( contKey );
+                int y = valueToInt( &( contKey[4] ) );
+
+                int numLevels = contTreeGet( x, y )->tree->levels.size();
+                
+                for( int b=0; b<numLevels; b++ ) {
+                    int numSlots = contSlotGet( x, y, NUM_CONT_SLOT, b );
+                    
                     if( numSlots > 0 ) {
-                        int x = valueToInt( key );
-                        int y = valueToInt( &( key[4] ) );
                         xContToCheck.push_back( x );
                         yContToCheck.push_back( y );
                         bContToCheck.push_back( b );
@@ -3497,6 +4641,8 @@ void freeMap( char inSkipCleanup ) {
             AppLog::info( "Skipping use dummy cleanup." );
             }
         
+        delete [] value;
+        
         printf( "\n" );
 
         if( ! skipRemovedObjectCleanup ) {
@@ -3517,28 +4663,26 @@ void freeMap( char inSkipCleanup ) {
         dbOpen = false;
         }
     
-    if( timeDBOpen ) {
-        DB_close( &timeDB );
-        timeDBOpen = false;
+    if( contDBOpen ) {
+        removeIncrementalBackupDB( &contDB );
+        DB_close( &contDB );
+        contDBOpen = false;
         }
+    
+    freeContTreeCache();
+    
+    freeHeatField();
+    freeChunkWorkers();
+    freeChunkCache();
+    freeDBCaches();
 
     if( biomeDBOpen ) {
+        removeIncrementalBackupDB( &biomeDB );
         DB_close( &biomeDB );
         biomeDBOpen = false;
         }
 
 
-    if( floorDBOpen ) {
-        DB_close( &floorDB );
-        floorDBOpen = false;
-        }
-
-    if( floorTimeDBOpen ) {
-        DB_close( &floorTimeDB );
-        floorTimeDBOpen = false;
-        }
-
-
     if( graveDBOpen ) {
         DB_close( &graveDB );
         graveDBOpen = false;
@@ -3569,9 +4713,7 @@ void freeMap( char inSkipCleanup ) {
     allNaturalMapIDs.deleteAll();
 
     liveDecayQueue.clear();
-    liveDecayRecordPresentHashTable.clear();
     liveDecayRecordLastLookTimeHashTable.clear();
-    liveMovementEtaTimes.clear();
 
     liveMovements.clear();
     
@@ -3604,6 +4746,9 @@ void wipeMapFiles() {
     deleteFileByName( "lookTime.db" );
     deleteFileByName( "map.db" );
     deleteFileByName( "mapTime.db" );
+    deleteFileByName( "mapContained.db" );
+    deleteFileByName( "mapTiles.db" );
+    deleteMapJournalFiles();
     deleteFileByName( "playerStats.db" );
     deleteFileByName( "meta.db" );
     }
@@ -3617,33 +4762,32 @@ void wipeMapFiles() {
 // returns -1 if not found
 static int dbGet( int inX, int inY, int inSlot, int inSubCont = 0 ) {
     
+    if( mapTraceFile != NULL ) {
+        recordMapTrace( MAP_TRACE_GET, inX, inY, inSlot, inSubCont );
+        }
+
+    if( isContainerSlot( inSlot, inSubCont ) ) {
+        return contSlotGet( inX, inY, inSlot, inSubCont );
+        }
+
+    addProfileCount( PROFILE_DB_GETS );
+    
     int cachedVal = dbGetCached( inX, inY, inSlot, inSubCont );
     if( cachedVal != -2 ) {
+        addProfileCount( PROFILE_DB_CACHE_HITS );
         
         return cachedVal;
         }
     
 
-    unsigned char key[16];
-    unsigned char value[4];
-
-    // look for changes to default in database
-    intQuadToKey( inX, inY, inSlot, inSubCont, key );
-    
-    int result = DB_get( &db, key, value );
+    int returnVal = -1;
     
-    
-    
-    int returnVal;
-    
-    if( result == 0 ) {
-        // found
-        returnVal = valueToInt( value );
-        }
-    else {
-        returnVal = -1;
+    if( inSlot == 0 ) {
+        // look for changes to default in database
+        returnVal = 
+            mapTileGet( inX, inY )->objects[ getMapTileCellIndex( inX, inY ) ];
         }
-
+    
     dbPutCached( inX, inY, inSlot, inSubCont, returnVal );
     
     return returnVal;
@@ -3655,6 +4799,14 @@ static int dbGet( int inX, int inY, int inSlot, int inSubCont = 0 ) {
 // returns 0 if not found
 static timeSec_t dbTimeGet( int inX, int inY, int inSlot, int inSubCont = 0 ) {
 
+    if( mapTraceFile != NULL ) {
+        recordMapTrace( MAP_TRACE_TIME_GET, inX, inY, inSlot, inSubCont );
+        }
+
+    if( isContainerSlot( inSlot, inSubCont ) ) {
+        return contSlotTimeGet( inX, inY, inSlot, inSubCont );
+        }
+
     timeSec_t cachedVal = dbTimeGetCached( inX, inY, inSlot, inSubCont );
     if( cachedVal != 1 ) {
         
@@ -3662,69 +4814,41 @@ static timeSec_t dbTimeGet( int inX, int inY, int inSlot, int inSubCont = 0 ) {
         }
 
     
-    unsigned char key[16];
-    unsigned char value[8];
-
-    // look for changes to default in database
-    intQuadToKey( inX, inY, inSlot, inSubCont, key );
-    
-    int result = DB_get( &timeDB, key, value );
-    
-    timeSec_t timeVal;
-    
-    if( result == 0 ) {
-        // found
-        timeVal = valueToTime( value );
-        }
-    else {
-        timeVal = 0;
-        }
-
-    dbTimePutCached( inX, inY, inSlot, inSubCont, timeVal );
-    
-    return timeVal;
-    }
-
-
-
-static int dbFloorGet( int inX, int inY ) {
-    unsigned char key[9];
-    unsigned char value[4];
-
-    // look for changes to default in database
-    intPairToKey( inX, inY, key );
-    
-    int result = DB_get( &floorDB, key, value );
+    timeSec_t timeVal = 0;
     
-    if( result == 0 ) {
-        // found
-        int returnVal = valueToInt( value );
-        
-        return returnVal;
+    if( inSlot == DECAY_SLOT ) {
+        // look for changes to default in database
+        timeVal = 
+            mapTileGet( inX, inY )->
+            objectEtas[ getMapTileCellIndex( inX, inY ) ];
         }
-    else {
-        return -1;
+
+    dbTimePutCached( inX, inY, inSlot, inSubCont, timeVal );
+    
+    return timeVal;
+    }
+
+
+
+// returns -1 if not found
+static int dbFloorGet( int inX, int inY ) {
+    if( mapTraceFile != NULL ) {
+        recordMapTrace( MAP_TRACE_FLOOR_GET, inX, inY, 0, 0 );
         }
+
+    return mapTileGet( inX, inY )->floors[ getMapTileCellIndex( inX, inY ) ];
     }
 
 
 
 // returns 0 if not found
 static timeSec_t dbFloorTimeGet( int inX, int inY ) {
-    unsigned char key[8];
-    unsigned char value[8];
-
-    intPairToKey( inX, inY, key );
-    
-    int result = DB_get( &floorTimeDB, key, value );
-    
-    if( result == 0 ) {
-        // found
-        return valueToTime( value );
-        }
-    else {
-        return 0;
+    if( mapTraceFile != NULL ) {
+        recordMapTrace( MAP_TRACE_FLOOR_TIME_GET, inX, inY, 0, 0 );
         }
+
+    return 
+        mapTileGet( inX, inY )->floorEtas[ getMapTileCellIndex( inX, inY ) ];
     }
 
 
@@ -3753,12 +4877,20 @@ timeSec_t dbLookTimeGet( int inX, int inY ) {
 static void dbPut( int inX, int inY, int inSlot, int inValue, 
                    int inSubCont ) {
     
+    if( mapTraceFile != NULL ) {
+        recordMapTrace( MAP_TRACE_PUT, inX, inY, inSlot, inSubCont, inValue );
+        }
+
+    addProfileCount( PROFILE_DB_PUTS );
+
     if( inSlot == 0 && inSubCont == 0 ) {
         // object has changed
         // clear blocking cache
         blockingClearCached( inX, inY );
         }
     
+    chunkCacheCellChanged( inX, inY );
+    
 
     if( ! skipTrackingMapChanges ) {
         
@@ -3814,15 +4946,21 @@ static void dbPut( int inX, int inY, int inSlot, int inValue,
     
     
 
-    unsigned char key[16];
-    unsigned char value[4];
-    
+    if( isContainerSlot( inSlot, inSubCont ) ) {
+        contSlotPut( inX, inY, inSlot, inSubCont, inValue );
+        return;
+        }
 
-    intQuadToKey( inX, inY, inSlot, inSubCont, key );
-    intToValue( inValue, value );
-            
-    
-    DB_put( &db, key, value );
+
+    if( inSlot == 0 ) {
+        MapTile *tile = mapTileGet( inX, inY );
+        int cell = getMapTileCellIndex( inX, inY );
+        
+        if( tile->objects[ cell ] != inValue ) {
+            tile->objects[ cell ] = inValue;
+            mapTileStore( tile );
+            }
+        }
 
     dbPutCached( inX, inY, inSlot, inSubCont, inValue );
     }
@@ -3835,15 +4973,27 @@ static void dbTimePut( int inX, int inY, int inSlot, timeSec_t inTime,
                        int inSubCont = 0 ) {
     // ETA decay changes don't get reported as map changes    
     
-    unsigned char key[16];
-    unsigned char value[8];
+    if( mapTraceFile != NULL ) {
+        recordMapTrace( MAP_TRACE_TIME_PUT, inX, inY, inSlot, inSubCont, 
+                        inTime );
+        }
     
-
-    intQuadToKey( inX, inY, inSlot, inSubCont, key );
-    timeToValue( inTime, value );
-            
+    chunkCacheCellChanged( inX, inY );
     
-    DB_put( &timeDB, key, value );
+    if( isContainerSlot( inSlot, inSubCont ) ) {
+        contSlotTimePut( inX, inY, inSlot, inSubCont, inTime );
+        return;
+        }
+
+    if( inSlot == DECAY_SLOT ) {
+        MapTile *tile = mapTileGet( inX, inY );
+        int cell = getMapTileCellIndex( inX, inY );
+        
+        if( tile->objectEtas[ cell ] != inTime ) {
+            tile->objectEtas[ cell ] = inTime;
+            mapTileStore( tile );
+            }
+        }
 
     dbTimePutCached( inX, inY, inSlot, inSubCont, inTime );
     }
@@ -3853,6 +5003,11 @@ static void dbTimePut( int inX, int inY, int inSlot, timeSec_t inTime,
 
 static void dbFloorPut( int inX, int inY, int inValue ) {
     
+    if( mapTraceFile != NULL ) {
+        recordMapTrace( MAP_TRACE_FLOOR_PUT, inX, inY, 0, 0, inValue );
+        }
+
+    chunkCacheCellChanged( inX, inY );
 
     if( ! skipTrackingMapChanges ) {
         
@@ -3878,15 +5033,13 @@ static void dbFloorPut( int inX, int inY, int inValue ) {
         }
     
     
-    unsigned char key[8];
-    unsigned char value[4];
-    
-
-    intPairToKey( inX, inY, key );
-    intToValue( inValue, value );
-            
+    MapTile *tile = mapTileGet( inX, inY );
+    int cell = getMapTileCellIndex( inX, inY );
     
-    DB_put( &floorDB, key, value );
+    if( tile->floors[ cell ] != inValue ) {
+        tile->floors[ cell ] = inValue;
+        mapTileStore( tile );
+        }
     }
 
 
@@ -3894,15 +5047,19 @@ static void dbFloorPut( int inX, int inY, int inValue ) {
 static void dbFloorTimePut( int inX, int inY, timeSec_t inTime ) {
     // ETA decay changes don't get reported as map changes    
     
-    unsigned char key[8];
-    unsigned char value[8];
+    if( mapTraceFile != NULL ) {
+        recordMapTrace( MAP_TRACE_FLOOR_TIME_PUT, inX, inY, 0, 0, inTime );
+        }
     
-
-    intPairToKey( inX, inY, key );
-    timeToValue( inTime, value );
-            
+    chunkCacheCellChanged( inX, inY );
+    
+    MapTile *tile = mapTileGet( inX, inY );
+    int cell = getMapTileCellIndex( inX, inY );
     
-    DB_put( &floorTimeDB, key, value );
+    if( tile->floorEtas[ cell ] != inTime ) {
+        tile->floorEtas[ cell ] = inTime;
+        mapTileStore( tile );
+        }
     }
 
 
@@ -3948,25 +5105,20 @@ static void trackETA( int inX, int inY, int inSlot, timeSec_t inETA,
     if( timeLeft < maxSecondsForActiveDecayTracking ) {
         // track it live
             
-        // duplicates okay
-        // we'll deal with them when they ripen
-        // (we check the true ETA stored in map before acting
+        // replaces any record already tracked for this cell or slot
+        // (we still check the true ETA stored in map before acting
         //   on one stored in this queue)
         LiveDecayRecord r = { inX, inY, inSlot, inETA, inSubCont, 
                               inApplicableTrans };
             
         char exists;
         timeSec_t existingETA =
-            liveDecayRecordPresentHashTable.lookup( inX, inY, inSlot,
-                                                    inSubCont,
-                                                    &exists );
+            liveDecayQueue.getETA( inX, inY, inSlot, inSubCont, &exists );
 
         if( !exists || existingETA != inETA ) {
             
-            liveDecayQueue.insert( r, inETA );
-            
-            liveDecayRecordPresentHashTable.insert( inX, inY, inSlot, 
-                                                    inSubCont, inETA );
+            liveDecayQueue.schedule( inX, inY, inSlot, inSubCont, inETA, r,
+                                     MAP_TIMESEC );
 
             char exists;
             
@@ -4682,13 +5834,14 @@ int checkDecayObject( int inX, int inY, int inID ) {
                     
                     double moveTime = moveDist / speed;
                     
-                    double etaTime = Time::getCurrentTime() + moveTime;
+                    double curTime = getServerTime();
                     
-                    MovementRecord moveRec = { newX, newY, etaTime };
+                    double etaTime = curTime + moveTime;
                     
-                    liveMovementEtaTimes.insert( newX, newY, 0, 0, etaTime );
+                    MovementRecord moveRec = { newX, newY, etaTime };
                     
-                    liveMovements.insert( moveRec, etaTime );
+                    liveMovements.schedule( newX, newY, 0, 0, etaTime, 
+                                            moveRec, curTime );
                     
 
                     // now patch up change record marking this as a move
@@ -5155,10 +6308,10 @@ char isMapObjectInTransit( int inX, int inY ) {
     char found;
     
     double etaTime = 
-        liveMovementEtaTimes.lookup( inX, inY, 0, 0, &found );
+        liveMovements.getETA( inX, inY, 0, 0, &found );
     
     if( found ) {
-        if( etaTime > Time::getCurrentTime() ) {
+        if( etaTime > getServerTime() ) {
             return true;
             }
         }
@@ -5175,206 +6328,336 @@ int getMapBiome( int inX, int inY ) {
 
 
 
-// returns properly formatted chunk message for chunk centered
-// around x,y
-unsigned char *getChunkMessage( int inStartX, int inStartY, 
-                                int inWidth, int inHeight,
-                                GridPos inRelativeToPos,
-                                int *outMessageLength ) {
+// keeps earliest non-zero time in ioExpiry
+static void mergeChunkExpiry( timeSec_t *ioExpiry, timeSec_t inETA ) {
+    if( inETA == 0 ) {
+        return;
+        }
     
-    int chunkCells = inWidth * inHeight;
+    // decays are checked against whole seconds
+    inETA = floor( inETA );
     
-    int *chunk = new int[chunkCells];
+    if( *ioExpiry == 0 || inETA < *ioExpiry ) {
+        *ioExpiry = inETA;
+        }
+    }
 
-    int *chunkBiomes = new int[chunkCells];
-    int *chunkFloors = new int[chunkCells];
-    
-    int *containedStackSizes = new int[ chunkCells ];
-    int **containedStacks = new int*[ chunkCells ];
 
-    int **subContainedStackSizes = new int*[chunkCells];
-    int ***subContainedStacks = new int**[chunkCells];
-    
 
-    int endY = inStartY + inHeight;
-    int endX = inStartX + inWidth;
+// reused for binary encoding of each cell
+static ByteWriter chunkCellWriter;
 
-    timeSec_t curTime = MAP_TIMESEC;
 
-    // look at four corners of chunk whenever we fetch one
-    dbLookTimePut( inStartX, inStartY, curTime );
-    dbLookTimePut( inStartX, endY, curTime );
-    dbLookTimePut( endX, inStartY, curTime );
-    dbLookTimePut( endX, endY, curTime );
+// appends one cell of MC message data to ioBuffer, as text or in binary
+// protocol format, and lowers ioExpiry to the time when that cell goes
+// stale, if sooner
+static void appendChunkCell( int inX, int inY, timeSec_t inCurTime,
+                             char inBinary,
+                             SimpleVector<char> *ioBuffer,
+                             timeSec_t *ioExpiry ) {
     
-    for( int y=inStartY; y<endY; y++ ) {
-        int chunkY = y - inStartY;
-        
+    unsigned char *cellBytes;
+    int cellLength;
+    timeSec_t expiry;
 
-        for( int x=inStartX; x<endX; x++ ) {
-            int chunkX = x - inStartX;
-            
-            int cI = chunkY * inWidth + chunkX;
-            
-            lastCheckedBiome = -1;
+    ChunkTile *cached = chunkTileCache->lookup( inX, inY, 0, 0 );
+    
+    if( cached != NULL && 
+        ( cached->expiry == 0 || inCurTime < cached->expiry ) ) {
+        
+        // same look that fetching cell would do
+        lookAtRegion( inX, inY, inX, inY );
+        
+        cellBytes = cached->bytes;
+        cellLength = cached->length;
+        expiry = cached->expiry;
+        }
+    else {
+        lastCheckedBiome = -1;
             
-            chunk[cI] = getMapObject( x, y );
+        int id = getMapObject( inX, inY );
 
-            if( lastCheckedBiome == -1 ) {
-                // biome wasn't checked in order to compute
-                // getMapObject
+        if( lastCheckedBiome == -1 ) {
+            // biome wasn't checked in order to compute
+            // getMapObject
 
-                // get it ourselves
-                
-                lastCheckedBiome = biomes[getMapBiomeIndex( x, y )];
-                }
-            chunkBiomes[ cI ] = lastCheckedBiome;
+            // get it ourselves
+        
+            lastCheckedBiome = biomes[getMapBiomeIndex( inX, inY )];
+            }
+        int biome = lastCheckedBiome;
 
-            chunkFloors[cI] = getMapFloor( x, y );
-            
+        int floorID = getMapFloor( inX, inY );
+    
+
+        // fetching can apply decays, so look at decay times after
+        expiry = 0;
+    
+        mergeChunkExpiry( &expiry, getEtaDecay( inX, inY ) );
+        mergeChunkExpiry( &expiry, getFloorEtaDecay( inX, inY ) );
+    
 
-            int numContained;
-            int *contained = NULL;
+        int numContained = 0;
+        int *contained = NULL;
 
-            if( chunk[cI] > 0 && getObject( chunk[cI] )->numSlots > 0 ) {
-                contained = getContained( x, y, &numContained );
-                }
+        if( id > 0 && getObject( id )->numSlots > 0 ) {
+            contained = getContained( inX, inY, &numContained );
+            }
+
+        int *numSubContained = NULL;
+        int **subContained = NULL;
+    
+        if( contained != NULL ) {
+            numSubContained = new int[ numContained ];
+            subContained = new int*[ numContained ];
+            
+            // 0 for main container, then slot + 1 for each sub container
+            SimpleVector<int> subConts;
+            subConts.push_back( 0 );
+        
+            for( int c=0; c<numContained; c++ ) {
             
-            if( contained != NULL ) {
-                containedStackSizes[cI] = numContained;
-                containedStacks[cI] = contained;
+                numSubContained[c] = 0;
+                subContained[c] = NULL;
+            
+                if( contained[c] < 0 ) {
+                    // a sub container
+                    contained[c] *= -1;
                 
-                subContainedStackSizes[cI] = new int[numContained];
-                subContainedStacks[cI] = new int*[numContained];
-
-                for( int i=0; i<numContained; i++ ) {
-                    subContainedStackSizes[cI][i] = 0;
-                    subContainedStacks[cI][i] = NULL;
+                    subContained[c] = getContained( inX, inY, 
+                                                    &( numSubContained[c] ),
+                                                    c + 1 );
+                    subConts.push_back( c + 1 );
                     
-                    if( containedStacks[cI][i] < 0 ) {
-                        // a sub container
-                        containedStacks[cI][i] *= -1;
-                        
-                        int numSubContained;
-                        int *subContained = getContained( x, y, 
-                                                          &numSubContained,
-                                                          i + 1 );
-                        if( subContained != NULL ) {
-                            subContainedStackSizes[cI][i] = numSubContained;
-                            subContainedStacks[cI][i] = subContained;
-                            }
+                    for( int s=0; s<numSubContained[c]; s++ ) {
+                        subContained[c][s] = 
+                            hideIDForClient( subContained[c][s] );
                         }
                     }
+                
+                contained[c] = hideIDForClient( contained[c] );
                 }
-            else {
-                containedStackSizes[cI] = 0;
-                containedStacks[cI] = NULL;
-                subContainedStackSizes[cI] = NULL;
-                subContainedStacks[cI] = NULL;
+        
+        
+            for( int i=0; i<subConts.size(); i++ ) {
+                int sub = subConts.getElementDirect( i );
+            
+                if( getSlotItemsNoDecay( inX, inY, sub ) ) {
+                    continue;
+                    }
+            
+                int numETAs;
+                timeSec_t *etas = getContainedEtaDecay( inX, inY, &numETAs, 
+                                                        sub );
+                if( etas != NULL ) {
+                    for( int e=0; e<numETAs; e++ ) {
+                        mergeChunkExpiry( &expiry, etas[e] );
+                        }
+                    delete [] etas;
+                    }
+                }
+            }
+        
+        
+        chunkCellWriter.reset();
+        
+        writeBinaryChunkCell( &chunkCellWriter, biome,
+                              hideIDForClient( floorID ), 
+                              hideIDForClient( id ),
+                              numContained, contained,
+                              numSubContained, subContained );
+        
+        if( contained != NULL ) {
+            for( int c=0; c<numContained; c++ ) {
+                if( subContained[c] != NULL ) {
+                    delete [] subContained[c];
+                    }
                 }
+            delete [] numSubContained;
+            delete [] subContained;
+            
+            delete [] contained;
+            }
+        
+        cellBytes = chunkCellWriter.getBytes();
+        cellLength = chunkCellWriter.getSize();
+
+        if( cellLength <= CHUNK_TILE_BYTES ) {
+            ChunkTile t;
+            t.expiry = expiry;
+            t.length = cellLength;
+            memcpy( t.bytes, cellBytes, cellLength );
+            
+            chunkTileCache->insert( inX, inY, 0, 0, t );
             }
+        }
+    
+
+    if( inBinary ) {
+        ioBuffer->appendArray( (char*)cellBytes, cellLength );
+        }
+    else {
+        ByteReader reader( cellBytes, cellLength );
         
+        binaryChunkCellToText( &reader, ioBuffer );
         }
+    
+    mergeChunkExpiry( ioExpiry, expiry );
+    }
 
 
 
-    SimpleVector<unsigned char> chunkDataBuffer;
+ChunkMessageJob *startChunkMessage( int inStartX, int inStartY, 
+                                    int inWidth, int inHeight,
+                                    GridPos inRelativeToPos,
+                                    char inBinaryCells ) {
+    
+    int endY = inStartY + inHeight;
+    int endX = inStartX + inWidth;
 
-    for( int i=0; i<chunkCells; i++ ) {
-        
-        if( i > 0 ) {
-            chunkDataBuffer.appendArray( (unsigned char*)" ", 1 );
-            }
-        
+    timeSec_t curTime = MAP_TIMESEC;
 
-        char *cell = autoSprintf( "%d:%d:%d", chunkBiomes[i],
-                                  hideIDForClient( chunkFloors[i] ), 
-                                  hideIDForClient( chunk[i] ) );
-        
-        chunkDataBuffer.appendArray( (unsigned char*)cell, strlen(cell) );
-        delete [] cell;
+    // look at four corners of chunk whenever we fetch one
+    dbLookTimePut( inStartX, inStartY, curTime );
+    dbLookTimePut( inStartX, endY, curTime );
+    dbLookTimePut( endX, inStartY, curTime );
+    dbLookTimePut( endX, endY, curTime );
+    
+
+    ChunkMessageJob *job = new ChunkMessageJob;
+    
+    job->x = inStartX;
+    job->y = inStartY;
+    job->width = inWidth;
+    job->height = inHeight;
+    job->relativeToPos = inRelativeToPos;
+    job->binary = inBinaryCells;
+    job->compressJob = NULL;
+    job->compressedData = NULL;
+    job->compressedSize = 0;
+    job->recentBuild = NULL;
+    
 
-        if( containedStacks[i] != NULL ) {
-            for( int c=0; c<containedStackSizes[i]; c++ ) {
-                char *containedString = 
-                    autoSprintf( ",%d", 
-                                 hideIDForClient( containedStacks[i][c] ) );
+    // cell data doesn't depend on inRelativeToPos, only header does,
+    // so chunk sent to one player can be sent as-is to another
+    job->compressedData = 
+        getRecentChunk( inStartX, inStartY, inWidth, inHeight,
+                        inBinaryCells, curTime,
+                        &( job->compressedSize ), &( job->rawSize ),
+                        &( job->expiry ) );
+    
+    if( job->compressedData != NULL ) {
+        // same look that fetching cells would do
+        lookAtRegion( inStartX, inStartY, endX - 1, endY - 1 );
         
-                chunkDataBuffer.appendArray( (unsigned char*)containedString, 
-                                             strlen( containedString ) );
-                delete [] containedString;
+        return job;
+        }
+    
 
-                if( subContainedStacks[i][c] != NULL ) {
-                    
-                    for( int s=0; s<subContainedStackSizes[i][c]; s++ ) {
-                        
-                        char *subContainedString = 
-                            autoSprintf( ":%d", 
-                                         hideIDForClient( 
-                                             subContainedStacks[i][c][s] ) );
-        
-                        chunkDataBuffer.appendArray( 
-                            (unsigned char*)subContainedString, 
-                            strlen( subContainedString ) );
-                        delete [] subContainedString;
-                        }
-                    delete [] subContainedStacks[i][c];
-                    }
-                }
+    // before reading any cells, since reading them can apply decays
+    // that change cells already read
+    job->recentBuild = startRecentChunkBuild( inStartX, inStartY,
+                                              inWidth, inHeight,
+                                              inBinaryCells );
+    
 
-            delete [] subContainedStackSizes[i];
-            delete [] subContainedStacks[i];
+    // procedural map for whole chunk at once, for cells not seen lately
+    getBaseMapRegion( inStartX, inStartY, inWidth, inHeight );
+    
 
-            delete [] containedStacks[i];
+    SimpleVector<char> chunkDataBuffer;
+    
+    timeSec_t expiry = 0;
+    
+    for( int y=inStartY; y<endY; y++ ) {
+        for( int x=inStartX; x<endX; x++ ) {
+            
+            if( ! inBinaryCells && ( y > inStartY || x > inStartX ) ) {
+                chunkDataBuffer.push_back( ' ' );
+                }
+            
+            appendChunkCell( x, y, curTime, inBinaryCells,
+                             &chunkDataBuffer, &expiry );
             }
         }
     
-    delete [] chunk;
-    delete [] chunkBiomes;
-    delete [] chunkFloors;
-
-    delete [] containedStackSizes;
-    delete [] containedStacks;
-
-    delete [] subContainedStackSizes;
-    delete [] subContainedStacks;
+    job->expiry = expiry;
+    job->rawSize = chunkDataBuffer.size();
     
+    job->compressJob = 
+        addChunkJob( (unsigned char*)chunkDataBuffer.getElementArray(),
+                     chunkDataBuffer.size() );
     
+    return job;
+    }
 
-    unsigned char *chunkData = chunkDataBuffer.getElementArray();
-    
-    int compressedSize;
-    unsigned char *compressedChunkData =
-        zipCompress( chunkData, chunkDataBuffer.size(),
-                     &compressedSize );
 
 
+unsigned char *finishChunkMessage( ChunkMessageJob *inJob,
+                                   int *outMessageLength ) {
+    
+    if( inJob->compressJob != NULL ) {
+        inJob->compressedData = finishChunkJob( inJob->compressJob,
+                                                &( inJob->compressedSize ) );
+        inJob->compressJob = NULL;
+        }
+    
 
     char *header = autoSprintf( "MC\n%d %d %d %d\n%d %d\n#", 
-                                inWidth, inHeight,
-                                inStartX - inRelativeToPos.x, 
-                                inStartY - inRelativeToPos.y, 
-                                chunkDataBuffer.size(),
-                                compressedSize );
+                                inJob->width, inJob->height,
+                                inJob->x - inJob->relativeToPos.x, 
+                                inJob->y - inJob->relativeToPos.y, 
+                                inJob->rawSize,
+                                inJob->compressedSize );
     
     SimpleVector<unsigned char> buffer;
     buffer.appendArray( (unsigned char*)header, strlen( header ) );
     delete [] header;
 
     
-    buffer.appendArray( compressedChunkData, compressedSize );
-    
-    delete [] chunkData;
-    delete [] compressedChunkData;
+    buffer.appendArray( inJob->compressedData, inJob->compressedSize );
     
 
+    // keep it for repeated sends of same area, unless a cell changed
+    // while it was being built
+    if( inJob->recentBuild == NULL ||
+        ! finishRecentChunkBuild( inJob->recentBuild,
+                                  inJob->compressedData, 
+                                  inJob->compressedSize,
+                                  inJob->rawSize, inJob->expiry ) ) {
+        delete [] inJob->compressedData;
+        }
     
+    delete inJob;
+    
+
     *outMessageLength = buffer.size();
     return buffer.getElementArray();
     }
 
 
 
+// returns properly formatted chunk message for chunk centered
+// around x,y
+unsigned char *getChunkMessage( int inStartX, int inStartY, 
+                                int inWidth, int inHeight,
+                                GridPos inRelativeToPos,
+                                int *outMessageLength,
+                                char inBinaryCells ) {
+    
+    ChunkMessageJob *job = startChunkMessage( inStartX, inStartY,
+                                              inWidth, inHeight,
+                                              inRelativeToPos,
+                                              inBinaryCells );
+
+    // finished right away
+    // compressed here if no worker has started on it yet, or else waits
+    // for the worker that has
+    return finishChunkMessage( job, outMessageLength );
+    }
+
+
+
 
 
 
@@ -6188,6 +7471,10 @@ void shrinkContainer( int inX, int inY, int inNumNewSlots, int inSubCont ) {
 
 
 
+// reused for binary body of each map change record
+static ByteWriter mapChangeBodyWriter;
+
+
 MapChangeRecord getMapChangeRecord( ChangePosition inPos ) {
 
     MapChangeRecord r;
@@ -6199,19 +7486,18 @@ MapChangeRecord getMapChangeRecord( ChangePosition inPos ) {
     SimpleVector<char> buffer;
     
 
-    char *header = autoSprintf( "%%d %%d %d ", 
-                                hideIDForClient( 
-                                    getMapFloor( inPos.x, inPos.y ) ) );
+    int floorID = hideIDForClient( getMapFloor( inPos.x, inPos.y ) );
+    
+    char *header = autoSprintf( "%%d %%d %d ", floorID );
     
     buffer.appendElementString( header );
     
     delete [] header;
     
 
-    char *idString = autoSprintf( "%d", 
-                                  hideIDForClient( 
-                                      getMapObjectNoLook( 
-                                          inPos.x, inPos.y ) ) );
+    int id = hideIDForClient( getMapObjectNoLook( inPos.x, inPos.y ) );
+    
+    char *idString = autoSprintf( "%d", id );
     
     buffer.appendElementString( idString );
     
@@ -6221,17 +7507,30 @@ MapChangeRecord getMapChangeRecord( ChangePosition inPos ) {
     int numContained;
     int *contained = getContainedNoLook( inPos.x, inPos.y, &numContained );
 
+    int *numSubContained = NULL;
+    int **subContained = NULL;
+    
+    if( numContained > 0 ) {
+        numSubContained = new int[ numContained ];
+        subContained = new int*[ numContained ];
+        }
+
     for( int i=0; i<numContained; i++ ) {
 
         char subCont = false;
         
+        numSubContained[i] = 0;
+        subContained[i] = NULL;
+
         if( contained[i] < 0 ) {
             subCont = true;
             contained[i] *= -1;
             
             }
         
-        char *idString = autoSprintf( ",%d", hideIDForClient( contained[i] ) );
+        contained[i] = hideIDForClient( contained[i] );
+
+        char *idString = autoSprintf( ",%d", contained[i] );
         
         buffer.appendElementString( idString );
         
@@ -6239,27 +7538,45 @@ MapChangeRecord getMapChangeRecord( ChangePosition inPos ) {
 
         if( subCont ) {
             
-            int numSubContained;
-            int *subContained = getContainedNoLook( inPos.x, inPos.y, 
-                                                    &numSubContained,
-                                                    i + 1 );
-            for( int s=0; s<numSubContained; s++ ) {
+            subContained[i] = getContainedNoLook( inPos.x, inPos.y, 
+                                                  &( numSubContained[i] ),
+                                                  i + 1 );
+            for( int s=0; s<numSubContained[i]; s++ ) {
 
-                idString = autoSprintf( ":%d", 
-                                        hideIDForClient( subContained[s] ) );
+                subContained[i][s] = hideIDForClient( subContained[i][s] );
+
+                idString = autoSprintf( ":%d", subContained[i][s] );
         
                 buffer.appendElementString( idString );
         
                 delete [] idString;
                 }
-            if( subContained != NULL ) {
-                delete [] subContained;
-                }
             }
         
         }
     
+
+    // same contents for binary protocol, see binaryProtocol.h
+    mapChangeBodyWriter.reset();
+    
+    mapChangeBodyWriter.writeInt( floorID );
+    
+    writeBinaryObject( &mapChangeBodyWriter, id, 
+                       numContained, contained,
+                       numSubContained, subContained );
+    
+    mapChangeBodyWriter.writeInt( inPos.responsiblePlayerID );
+    
+
     if( contained != NULL ) {
+        for( int i=0; i<numContained; i++ ) {
+            if( subContained[i] != NULL ) {
+                delete [] subContained[i];
+                }
+            }
+        delete [] numSubContained;
+        delete [] subContained;
+        
         delete [] contained;
         }
     
@@ -6282,11 +7599,18 @@ MapChangeRecord getMapChangeRecord( ChangePosition inPos ) {
         buffer.appendElementString( moveString );
     
         delete [] moveString;
+        
+        mapChangeBodyWriter.writeFixed( inPos.speed, BINARY_MILLIONTHS );
         }
 
     buffer.appendElementString( "\n" );
 
     r.formatString = buffer.getElementString();
+    
+    r.binaryBodyLength = mapChangeBodyWriter.getSize();
+    r.binaryBody = new unsigned char[ r.binaryBodyLength ];
+    memcpy( r.binaryBody, mapChangeBodyWriter.getBytes(), 
+            r.binaryBodyLength );
 
     return r;
     }
@@ -6301,6 +7625,7 @@ char *getMapChangeLineString( ChangePosition inPos ) {
     char *lineString = getMapChangeLineString( &r, 0, 0 );
     
     delete [] r.formatString;
+    delete [] r.binaryBody;
     
     return lineString;
     }
@@ -6331,6 +7656,25 @@ char *getMapChangeLineString( MapChangeRecord *inRecord,
 
 
 
+void writeBinaryMapChangeLine( ByteWriter *inWriter,
+                               MapChangeRecord *inRecord,
+                               int inRelativeToX, int inRelativeToY ) {
+    
+    inWriter->writeInt( inRecord->absoluteX - inRelativeToX );
+    inWriter->writeInt( inRecord->absoluteY - inRelativeToY );
+    
+    inWriter->writeByte( inRecord->oldCoordsUsed );
+
+    if( inRecord->oldCoordsUsed ) {
+        inWriter->writeInt( inRecord->absoluteOldX - inRelativeToX );
+        inWriter->writeInt( inRecord->absoluteOldY - inRelativeToY );
+        }
+    
+    inWriter->writeBytes( inRecord->binaryBody, inRecord->binaryBodyLength );
+    }
+
+
+
 
 
 int getMapFloor( int inX, int inY ) {
@@ -6410,13 +7754,13 @@ timeSec_t getFloorEtaDecay( int inX, int inY ) {
 
 
 int getNextDecayDelta() {
-    if( liveDecayQueue.size() == 0 ) {
+    timeSec_t minTime;
+    
+    if( ! liveDecayQueue.getNextETA( &minTime ) ) {
         return -1;
         }
     
     timeSec_t curTime = MAP_TIMESEC;
-
-    timeSec_t minTime = liveDecayQueue.checkMinPriority();
     
     
     if( minTime <= curTime ) {
@@ -6478,53 +7822,54 @@ static void cleanMaxContainedHashTable( int inX, int inY ) {
 void stepMap( SimpleVector<MapChangeRecord> *inMapChanges, 
               SimpleVector<ChangePosition> *inChangePosList ) {
     
+    if( Time::getCurrentTime() - lastDBCacheStatsTime > 
+        DB_CACHE_STATS_INTERVAL_SECONDS ) {
+        logChunkCacheStats();
+        logChunkWorkerStats();
+        logHeatFieldStats();
+        logDBCachesStats();
+        }
+
+    checkMapTraceSetting();
+
+    stepMapJournal();
+
     timeSec_t curTime = MAP_TIMESEC;
 
-    while( liveDecayQueue.size() > 0 && 
-           liveDecayQueue.checkMinPriority() <= curTime ) {
+    LiveDecayRecord r;
+    
+    while( liveDecayQueue.popExpired( curTime, &r ) ) {
         
         // another expired
-
-        LiveDecayRecord r = liveDecayQueue.removeMin();        
+        // (popping it stops tracking it)
 
         char storedFound;
-        timeSec_t storedETA =
-            liveDecayRecordPresentHashTable.lookup( r.x, r.y, r.slot,
-                                                    r.subCont,
-                                                    &storedFound );
-        
-        if( storedFound && storedETA == r.etaTimeSeconds ) {
-            
-            liveDecayRecordPresentHashTable.remove( r.x, r.y, r.slot,
-                                                    r.subCont );
 
-                    
-            timeSec_t lastLookTime =
-                liveDecayRecordLastLookTimeHashTable.lookup( r.x, r.y, r.slot,
-                                                             r.subCont,
-                                                             &storedFound );
+        timeSec_t lastLookTime =
+            liveDecayRecordLastLookTimeHashTable.lookup( r.x, r.y, r.slot,
+                                                         r.subCont,
+                                                         &storedFound );
 
-            if( storedFound ) {
+        if( storedFound ) {
 
-                if( MAP_TIMESEC - lastLookTime > 
-                    maxSecondsNoLookDecayTracking 
-                    &&
-                    ! isDecayTransAlwaysLiveTracked( r.applicableTrans ) ) {
-                    
-                    // this cell or slot hasn't been looked at in too long
-                    // AND it's not a trans that's live tracked even when
-                    // not watched
-
-                    // don't even apply this decay now
-                    liveDecayRecordLastLookTimeHashTable.remove( 
-                        r.x, r.y, r.slot, r.subCont );
-                    cleanMaxContainedHashTable( r.x, r.y );
-                    continue;
-                    }
-                // else keep lastlook time around in case
-                // this cell will decay further and we're still tracking it
-                // (but maybe delete it if cell is no longer tracked, below)
+            if( MAP_TIMESEC - lastLookTime > 
+                maxSecondsNoLookDecayTracking 
+                &&
+                ! isDecayTransAlwaysLiveTracked( r.applicableTrans ) ) {
+                
+                // this cell or slot hasn't been looked at in too long
+                // AND it's not a trans that's live tracked even when
+                // not watched
+
+                // don't even apply this decay now
+                liveDecayRecordLastLookTimeHashTable.remove( 
+                    r.x, r.y, r.slot, r.subCont );
+                cleanMaxContainedHashTable( r.x, r.y );
+                continue;
                 }
+            // else keep lastlook time around in case
+            // this cell will decay further and we're still tracking it
+            // (but maybe delete it if cell is no longer tracked, below)
             }
 
         if( r.slot == 0 ) {
@@ -6548,8 +7893,7 @@ void stepMap( SimpleVector<MapChangeRecord> *inMapChanges,
         
         
         char stillExists;
-        liveDecayRecordPresentHashTable.lookup( r.x, r.y, r.slot, r.subCont,
-                                                &stillExists );
+        liveDecayQueue.getETA( r.x, r.y, r.slot, r.subCont, &stillExists );
         
         if( !stillExists ) {
             // cell or slot no longer tracked
@@ -6562,10 +7906,10 @@ void stepMap( SimpleVector<MapChangeRecord> *inMapChanges,
         }
     
 
-    while( liveMovements.size() > 0 && 
-           liveMovements.checkMinPriority() <= curTime ) {
-        MovementRecord r = liveMovements.removeMin();    
-        liveMovementEtaTimes.remove( r.x, r.y, 0, 0 );
+    MovementRecord moveRec;
+    
+    while( liveMovements.popExpired( curTime, &moveRec ) ) {
+        // arrived, popping it stops tracking it
         }
     
         
@@ -6763,7 +8107,7 @@ void getEvePosition( const char *inEmail, int *outX, int *outY,
         GridPos eveLocToUse = eveLocation;
         
         maxEveLocationUsage = 
-            SettingsManager::getIntSetting( "maxEveStartupLocationUsage", 10 );
+            getCachedIntSetting( "maxEveStartupLocationUsage", 10 );
 
         if( eveLocationUsage < maxEveLocationUsage ) {
             eveLocationUsage++;
@@ -6786,7 +8130,7 @@ void getEvePosition( const char *inEmail, int *outX, int *outY,
                 eveLocToUse.y = 0;
                 }
             
-            int jump = SettingsManager::getIntSetting( "nextEveJump", 2000 );
+            int jump = getCachedIntSetting( "nextEveJump", 2000 );
             
             // advance eve angle along spiral
             // approximate recursive form
@@ -7,6 +7,7 @@
 
 #include "../gameSource/GridPos.h"
 #include "../gameSource/transitionBank.h"
+#include "../commonSource/binaryProtocol.h"
 
 #include "minorGems/game/doublePair.h"
 
@@ -46,6 +47,11 @@ void wipeMapFiles();
 
 
 
+// for repeatable session replays
+void reseedMapRandomSource( unsigned int inSeed );
+
+
+
 // make Eve placement radius bigger
 void doubleEveRadius();
 
@@ -72,10 +78,29 @@ void mapEveDeath( const char *inEmail, double inAge, GridPos inDeathMapPos );
 // with bottom-left corner at x,y
 // coordinates in message will be relative to inRelativeToPos
 // note that inStartX,Y are absolute world coordinates
+// inBinaryCells sends cell data in binary protocol format
 unsigned char *getChunkMessage( int inStartX, int inStartY, 
                                 int inWidth, int inHeight,
                                 GridPos inRelativeToPos,
-                                int *outMessageLength );
+                                int *outMessageLength,
+                                char inBinaryCells = false );
+
+
+typedef struct ChunkMessageJob ChunkMessageJob;
+
+// same as getChunkMessage, but only reads cells now, and compresses them
+// on a worker thread (see chunkWorkers.h) while caller does other work
+//
+// message must be picked up with finishChunkMessage
+ChunkMessageJob *startChunkMessage( int inStartX, int inStartY, 
+                                    int inWidth, int inHeight,
+                                    GridPos inRelativeToPos,
+                                    char inBinaryCells = false );
+
+// waits for message started by startChunkMessage
+// job is destroyed
+unsigned char *finishChunkMessage( ChunkMessageJob *inJob,
+                                   int *outMessageLength );
 
 
 // sets the player responsible for subsequent map changes
@@ -178,11 +203,15 @@ typedef struct MapChangeRecord {
         
         char oldCoordsUsed;
         int absoluteOldX, absoluteOldY;
+
+        // line for binary protocol, minus positions
+        unsigned char *binaryBody;
+        int binaryBodyLength;
     } MapChangeRecord;
 
 
 
-// formatString in returned record destroyed by caller
+// formatString and binaryBody in returned record destroyed by caller
 MapChangeRecord getMapChangeRecord( ChangePosition inPos );
 
 
@@ -194,6 +223,12 @@ char *getMapChangeLineString( MapChangeRecord *inRecord,
                               int inRelativeToX, int inRelativeToY );
 
 
+// same line for binary protocol
+void writeBinaryMapChangeLine( ByteWriter *inWriter,
+                               MapChangeRecord *inRecord,
+                               int inRelativeToX, int inRelativeToY );
+
+
 
 // returns number of seconds from now until when next decay is supposed
 // to happen
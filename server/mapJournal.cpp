@@ -0,0 +1,1113 @@
+#include "mapJournal.h"
+
+#include "FlatHashTable.h"
+#include "kissdb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+
+#include "minorGems/util/SettingsManager.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/io/file/File.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/BinarySemaphore.h"
+
+#include "minorGems/util/log/AppLog.h"
+
+
+
+static const char *journalPath = "mapJournal.log";
+
+// log set aside while its puts are written to DB files
+static const char *checkpointPath = "mapJournal.checkpoint.log";
+
+
+
+// Batch format (native byte order, like lineardb3 header):
+//    4-byte magic "MJB1"
+//    uint32 number of records
+//    uint32 bytes of records
+//    records, each as:
+//       1-byte DB ID, key, value
+//    uint32 checksum of record bytes
+//
+// A batch that is cut off or fails its checksum was being written when
+// the server went down.  Replay stops there.
+#define MAP_JOURNAL_BATCH_MAGIC "MJB1"
+
+#define MAP_JOURNAL_BATCH_HEADER_BYTES 12
+
+
+#define MAP_JOURNAL_MAX_KEY_BYTES 12
+
+#define MAP_JOURNAL_MAX_DBS 8
+
+
+// main thread writes checkpointed values to DBs for this long per step
+#define MAP_JOURNAL_CHECKPOINT_STEP_SECONDS 0.005
+
+// but always at least this many, so a checkpoint finishes on an idle
+// server that steps rarely
+#define MAP_JOURNAL_CHECKPOINT_STEP_MIN_RECORDS 64
+
+// checkpoint starts early when values held in RAM pass this size, and
+// is finished in one go when they pass twice this size
+#define MAP_JOURNAL_MAX_PENDING_BYTES 67108864
+
+// writer thread waits this long before trying a failed DB sync again
+#define MAP_JOURNAL_SYNC_RETRY_MILLISECONDS 1000
+
+
+
+typedef struct JournalDB {
+        char *path;
+        unsigned int keySize;
+        unsigned int valueSize;
+
+        // NULL until initMapJournal
+        LINEARDB3 *db;
+    } JournalDB;
+
+
+static JournalDB journalDBs[ MAP_JOURNAL_MAX_DBS ];
+
+static int numJournalDBs = 0;
+
+
+static char journalOn = false;
+
+// fsync log after each batch, or only hand it to the OS
+static char syncEachBatch = true;
+
+static double checkpointSeconds = 30;
+
+
+
+// latest value put for one key
+typedef struct JournalEntry {
+        int dbID;
+        unsigned char key[ MAP_JOURNAL_MAX_KEY_BYTES ];
+        int keyInts[3];
+
+        unsigned char *value;
+
+        // checkpoint generation of latest put
+        int generation;
+
+        // batch that latest put went into, and where its record starts
+        // in batchData, so repeated puts in one step share a record
+        int batchSerial;
+        int batchOffset;
+    } JournalEntry;
+
+
+static FlatHashTable<JournalEntry*> *journalEntries = NULL;
+
+static uint64_t journalEntryBytes = 0;
+
+static int currentGeneration = 0;
+
+// entries put in current generation, each once
+static SimpleVector<JournalEntry*> currentGenerationEntries;
+
+
+
+// records put since last stepMapJournal
+static unsigned char *batchData = NULL;
+static int batchLength = 0;
+static int batchSize = 0;
+static int batchNumRecords = 0;
+static int batchSerial = 0;
+
+
+
+enum CheckpointState {
+    CHECKPOINT_NONE = 0,
+    CHECKPOINT_APPLYING,
+    CHECKPOINT_SYNCING
+    };
+
+static CheckpointState checkpointState = CHECKPOINT_NONE;
+
+static double lastCheckpointTime = 0;
+
+static int checkpointGeneration = 0;
+
+// sorted by DB, then key
+static JournalEntry **checkpointEntries = NULL;
+static int numCheckpointEntries = 0;
+static int nextCheckpointEntry = 0;
+
+
+
+
+static void getKeyInts( int inDBID, const void *inKey, int outInts[3] ) {
+    outInts[0] = 0;
+    outInts[1] = 0;
+    outInts[2] = 0;
+
+    memcpy( outInts, inKey, journalDBs[ inDBID ].keySize );
+    }
+
+
+
+static uint32_t batchChecksum( const unsigned char *inData, int inLength ) {
+    // FNV-1a
+    uint32_t h = 2166136261U;
+
+    for( int i=0; i<inLength; i++ ) {
+        h ^= inData[i];
+        h *= 16777619U;
+        }
+    return h;
+    }
+
+
+
+static int compareEntries( const void *inA, const void *inB ) {
+    JournalEntry *a = *(JournalEntry**)inA;
+    JournalEntry *b = *(JournalEntry**)inB;
+
+    if( a->dbID != b->dbID ) {
+        return a->dbID < b->dbID ? -1 : 1;
+        }
+    for( int i=0; i<3; i++ ) {
+        if( a->keyInts[i] != b->keyInts[i] ) {
+            return a->keyInts[i] < b->keyInts[i] ? -1 : 1;
+            }
+        }
+    return 0;
+    }
+
+
+
+
+// one job for the writer thread
+//
+// if data is set, it is appended to the log
+// then, if rotate is set, the log is set aside as the checkpoint log
+// and a new log is started
+// then, if finishCheckpoint is set, DB files are synced and the
+// checkpoint log is deleted, retrying the sync until it works
+typedef struct JournalWriteJob {
+        unsigned char *data;
+        int dataLength;
+
+        char rotate;
+        char finishCheckpoint;
+    } JournalWriteJob;
+
+
+// guards everything below, shared with writer thread
+static MutexLock journalWriteLock;
+
+static SimpleVector<JournalWriteJob> journalWriteJobs;
+
+// set by writer thread when a job fails, cleared by main thread
+static char journalWriteFailed = false;
+
+// set by writer thread after a finishCheckpoint job
+static char checkpointFinished = false;
+
+// set by writer thread each time syncing DBs for a checkpoint fails
+static char checkpointSyncFailed = false;
+
+static char stopJournalWriter = false;
+
+
+// signaled when a job is added, or writer should stop
+static BinarySemaphore journalJobSemaphore;
+
+// signaled by writer thread when a checkpoint finishes, or its sync fails
+static BinarySemaphore checkpointSyncSemaphore;
+
+
+// only touched by writer thread while it is running
+static FILE *journalFile = NULL;
+
+// checkpoint log holds puts that aren't synced to DB files yet
+// only touched by writer thread while it is running
+static char checkpointSyncPending = false;
+
+static double lastCheckpointSyncTryTime = 0;
+
+
+
+static char syncFile( FILE *inFile, char inForce ) {
+    if( fflush( inFile ) != 0 ) {
+        return false;
+        }
+
+    if( ! syncEachBatch && ! inForce ) {
+        return true;
+        }
+
+#ifdef _WIN32
+    return ( _commit( _fileno( inFile ) ) == 0 );
+#else
+    return ( fsync( fileno( inFile ) ) == 0 );
+#endif
+    }
+
+
+
+// syncing through any descriptor flushes everything written to the file,
+// including writes made by the main thread through its own descriptor
+// or mapping
+static char syncPath( const char *inPath ) {
+    FILE *f = fopen( inPath, "r+b" );
+
+    if( f == NULL ) {
+        return false;
+        }
+
+    char ok = syncFile( f, true );
+
+    fclose( f );
+
+    return ok;
+    }
+
+
+
+// returns true if DB files synced and checkpoint log removed
+static char syncCheckpoint() {
+    for( int d=0; d<numJournalDBs; d++ ) {
+        if( ! syncPath( journalDBs[d].path ) ) {
+            return false;
+            }
+        }
+
+    remove( checkpointPath );
+    checkpointSyncPending = false;
+
+    return true;
+    }
+
+
+
+static char runJournalWriteJobs( SimpleVector<JournalWriteJob> *inJobs,
+                                 char *outCheckpointFinished,
+                                 char *outCheckpointSyncFailed ) {
+    char ok = true;
+
+    char needSync = false;
+
+    for( int i=0; i<inJobs->size(); i++ ) {
+        JournalWriteJob *job = inJobs->getElement( i );
+
+        if( job->data != NULL ) {
+            if( journalFile == NULL ||
+                fwrite( job->data, job->dataLength, 1, journalFile ) != 1 ) {
+                ok = false;
+                }
+            needSync = true;
+
+            delete [] job->data;
+            }
+
+        if( job->rotate && checkpointSyncPending ) {
+            // main thread waits for checkpoint before starting another,
+            // so this shouldn't happen
+            // but setting log aside now would replace the only record of
+            // puts that aren't in DB files yet, so keep adding to log
+            ok = false;
+            }
+        else if( job->rotate ) {
+            if( journalFile != NULL ) {
+                if( ! syncFile( journalFile, false ) ) {
+                    ok = false;
+                    }
+                fclose( journalFile );
+                }
+            needSync = false;
+
+            if( rename( journalPath, checkpointPath ) != 0 ) {
+                // can't rename over existing file on some platforms
+                remove( checkpointPath );
+
+                if( rename( journalPath, checkpointPath ) != 0 ) {
+                    ok = false;
+                    }
+                }
+
+            journalFile = fopen( journalPath, "wb" );
+
+            if( journalFile == NULL ) {
+                ok = false;
+                }
+            }
+
+        if( job->finishCheckpoint ) {
+            checkpointSyncPending = true;
+
+            // try right away
+            lastCheckpointSyncTryTime = 0;
+            }
+        }
+
+    if( checkpointSyncPending &&
+        Time::getCurrentTime() - lastCheckpointSyncTryTime >=
+        MAP_JOURNAL_SYNC_RETRY_MILLISECONDS / 1000.0 ) {
+
+        // new, or still waiting after a failed sync
+        lastCheckpointSyncTryTime = Time::getCurrentTime();
+
+        if( syncCheckpoint() ) {
+            *outCheckpointFinished = true;
+            }
+        else {
+            *outCheckpointSyncFailed = true;
+            ok = false;
+            }
+        }
+
+    if( needSync && journalFile != NULL ) {
+        // one sync covers every batch handed over since the last one
+        if( ! syncFile( journalFile, false ) ) {
+            ok = false;
+            }
+        }
+
+    return ok;
+    }
+
+
+
+class JournalWriterThread : public Thread {
+    public:
+
+        JournalWriterThread() {
+            start();
+            }
+
+        ~JournalWriterThread() {
+            join();
+            }
+
+        virtual void run() {
+            SimpleVector<JournalWriteJob> jobs;
+
+            while( true ) {
+                journalWriteLock.lock();
+
+                // take every job that's waiting, so that batches from
+                // several steps can share one sync
+                for( int i=0; i<journalWriteJobs.size(); i++ ) {
+                    jobs.push_back( journalWriteJobs.getElementDirect( i ) );
+                    }
+                journalWriteJobs.deleteAll();
+
+                // main thread adds no jobs after setting this
+                char stop = stopJournalWriter;
+
+                journalWriteLock.unlock();
+
+
+                if( jobs.size() > 0 || checkpointSyncPending ) {
+                    char finished = false;
+                    char syncFailed = false;
+
+                    char ok = runJournalWriteJobs( &jobs, &finished,
+                                                   &syncFailed );
+
+                    jobs.deleteAll();
+
+
+                    journalWriteLock.lock();
+
+                    if( ! ok ) {
+                        journalWriteFailed = true;
+                        }
+                    if( finished ) {
+                        checkpointFinished = true;
+                        }
+                    if( syncFailed ) {
+                        checkpointSyncFailed = true;
+                        }
+
+                    journalWriteLock.unlock();
+
+                    if( finished || syncFailed ) {
+                        checkpointSyncSemaphore.signal();
+                        }
+                    }
+
+                if( stop ) {
+                    // a checkpoint log that still isn't synced is left
+                    // for replay on next startup
+                    return;
+                    }
+
+                if( checkpointSyncPending ) {
+                    journalJobSemaphore.wait(
+                        MAP_JOURNAL_SYNC_RETRY_MILLISECONDS );
+                    }
+                else {
+                    journalJobSemaphore.wait();
+                    }
+                }
+            }
+    };
+
+
+static JournalWriterThread *journalWriter = NULL;
+
+
+
+// takes ownership of inData
+static void addJournalWriteJob( unsigned char *inData, int inDataLength,
+                                char inRotate, char inFinishCheckpoint ) {
+    JournalWriteJob job = { inData, inDataLength,
+                            inRotate, inFinishCheckpoint };
+
+    journalWriteLock.lock();
+
+    journalWriteJobs.push_back( job );
+
+    journalWriteLock.unlock();
+
+    journalJobSemaphore.signal();
+    }
+
+
+
+static void checkJournalWriteFailed() {
+    journalWriteLock.lock();
+
+    char failed = journalWriteFailed;
+    journalWriteFailed = false;
+
+    journalWriteLock.unlock();
+
+    if( failed ) {
+        AppLog::error( "Failed to write or sync map journal, "
+                       "crash recovery may lose recent map changes" );
+        }
+    }
+
+
+
+
+int addMapJournalDB( const char *inPath,
+                     unsigned int inKeySize, unsigned int inValueSize ) {
+
+    if( numJournalDBs >= MAP_JOURNAL_MAX_DBS ||
+        inKeySize > MAP_JOURNAL_MAX_KEY_BYTES ) {
+        AppLog::errorF( "Can't add %s to map journal", inPath );
+        return -1;
+        }
+
+    JournalDB *d = &( journalDBs[ numJournalDBs ] );
+
+    d->path = stringDuplicate( inPath );
+    d->keySize = inKeySize;
+    d->valueSize = inValueSize;
+    d->db = NULL;
+
+    return numJournalDBs++;
+    }
+
+
+
+
+// returns number of records replayed, or -1 if a DB put fails
+static int replayJournalFile( const char *inPath, LINEARDB3 *inDBs ) {
+    FILE *f = fopen( inPath, "rb" );
+
+    if( f == NULL ) {
+        return 0;
+        }
+
+    int numRecords = 0;
+    int numBatches = 0;
+
+    char partial = false;
+    char failed = false;
+
+    while( ! failed ) {
+        unsigned char header[ MAP_JOURNAL_BATCH_HEADER_BYTES ];
+
+        size_t numRead = fread( header, 1, sizeof( header ), f );
+
+        if( numRead == 0 ) {
+            // clean end
+            break;
+            }
+
+        uint32_t batchRecords;
+        uint32_t batchBytes;
+
+        memcpy( &batchRecords, &( header[4] ), 4 );
+        memcpy( &batchBytes, &( header[8] ), 4 );
+
+        if( numRead != sizeof( header ) ||
+            memcmp( header, MAP_JOURNAL_BATCH_MAGIC, 4 ) != 0 ||
+            batchBytes > 0x7FFFFFFF ) {
+            partial = true;
+            break;
+            }
+
+        unsigned char *data = new unsigned char[ batchBytes ];
+        uint32_t checksum;
+
+        if( fread( data, 1, batchBytes, f ) != batchBytes ||
+            fread( &checksum, sizeof( checksum ), 1, f ) != 1 ||
+            checksum != batchChecksum( data, batchBytes ) ) {
+            delete [] data;
+            partial = true;
+            break;
+            }
+
+        // check that records fit exactly before putting any of them
+        uint32_t pos = 0;
+
+        for( uint32_t r=0; r<batchRecords; r++ ) {
+            if( pos >= batchBytes || data[pos] >= numJournalDBs ) {
+                partial = true;
+                break;
+                }
+            JournalDB *d = &( journalDBs[ data[pos] ] );
+
+            pos += 1 + d->keySize + d->valueSize;
+            }
+
+        if( partial || pos != batchBytes ) {
+            delete [] data;
+            partial = true;
+            break;
+            }
+
+        pos = 0;
+
+        for( uint32_t r=0; r<batchRecords; r++ ) {
+            int id = data[pos];
+            JournalDB *d = &( journalDBs[ id ] );
+
+            unsigned char *key = &( data[ pos + 1 ] );
+            unsigned char *value = &( key[ d->keySize ] );
+
+            if( LINEARDB3_put( &( inDBs[id] ), key, value ) != 0 ) {
+                AppLog::errorF( "Failed to replay map journal record "
+                                "into %s", d->path );
+                failed = true;
+                break;
+                }
+
+            pos += 1 + d->keySize + d->valueSize;
+            numRecords++;
+            }
+
+        delete [] data;
+
+        numBatches++;
+        }
+
+    fclose( f );
+
+    if( failed ) {
+        return -1;
+        }
+
+    AppLog::infoF( "Replayed %d records in %d batches from %s",
+                   numRecords, numBatches, inPath );
+
+    if( partial ) {
+        AppLog::warningF( "%s ends with a partial batch, ignoring it",
+                          inPath );
+        }
+
+    return numRecords;
+    }
+
+
+
+char replayMapJournal() {
+    File checkpointFile( NULL, checkpointPath );
+    File logFile( NULL, journalPath );
+
+    if( ! checkpointFile.exists() && ! logFile.exists() ) {
+        return true;
+        }
+
+    AppLog::info( "\nReplaying map journal left by last run..." );
+
+    LINEARDB3 dbs[ MAP_JOURNAL_MAX_DBS ];
+
+    for( int i=0; i<numJournalDBs; i++ ) {
+        JournalDB *d = &( journalDBs[i] );
+
+        int error = LINEARDB3_open( &( dbs[i] ), d->path,
+                                    KISSDB_OPEN_MODE_RWCREAT,
+                                    80000, d->keySize, d->valueSize );
+        if( error ) {
+            AppLog::errorF( "Error %d opening %s to replay map journal",
+                            error, d->path );
+
+            for( int j=0; j<i; j++ ) {
+                LINEARDB3_close( &( dbs[j] ) );
+                }
+            return false;
+            }
+        }
+
+    // set-aside log is older than current one
+    char ok =
+        replayJournalFile( checkpointPath, dbs ) >= 0 &&
+        replayJournalFile( journalPath, dbs ) >= 0;
+
+    for( int i=0; i<numJournalDBs; i++ ) {
+        if( LINEARDB3_sync( &( dbs[i] ) ) != 0 ) {
+            AppLog::errorF( "Failed to sync %s after replaying map journal",
+                            journalDBs[i].path );
+            ok = false;
+            }
+        LINEARDB3_close( &( dbs[i] ) );
+        }
+
+    if( ! ok ) {
+        return false;
+        }
+
+    checkpointFile.remove();
+    logFile.remove();
+
+    return true;
+    }
+
+
+
+void initMapJournal( LINEARDB3 **inDBs ) {
+    for( int i=0; i<numJournalDBs; i++ ) {
+        journalDBs[i].db = inDBs[i];
+        }
+
+    journalOn = SettingsManager::getIntSetting( "mapJournal", 1 );
+
+    if( ! journalOn ) {
+        return;
+        }
+
+    syncEachBatch = SettingsManager::getIntSetting( "mapJournalSync", 1 );
+
+    checkpointSeconds =
+        SettingsManager::getFloatSetting( "mapJournalCheckpointSeconds",
+                                          30.0f );
+
+    journalFile = fopen( journalPath, "wb" );
+
+    if( journalFile == NULL ) {
+        AppLog::errorF( "Failed to open %s, writing map changes straight "
+                        "to databases", journalPath );
+        journalOn = false;
+        return;
+        }
+
+    journalEntries = new FlatHashTable<JournalEntry*>( 4096 );
+    journalEntryBytes = 0;
+
+    checkpointState = CHECKPOINT_NONE;
+    lastCheckpointTime = Time::getCurrentTime();
+
+    journalWriter = new JournalWriterThread();
+
+    AppLog::infoF( "mapJournal.ini set, batching map changes in %s, "
+                   "checkpointing every %.0f seconds%s",
+                   journalPath, checkpointSeconds,
+                   syncEachBatch ? "" : ", without syncing each batch" );
+    }
+
+
+
+
+int mapJournalGet( int inDBID, const void *inKey, void *outValue ) {
+    JournalDB *d = &( journalDBs[ inDBID ] );
+
+    if( journalOn ) {
+        int k[3];
+        getKeyInts( inDBID, inKey, k );
+
+        char found;
+        JournalEntry *e =
+            journalEntries->lookup( inDBID, k[0], k[1], k[2], &found );
+
+        if( found ) {
+            memcpy( outValue, e->value, d->valueSize );
+            return 0;
+            }
+        }
+
+    return LINEARDB3_get( d->db, inKey, outValue );
+    }
+
+
+
+void mapJournalPut( int inDBID, const void *inKey, const void *inValue ) {
+    JournalDB *d = &( journalDBs[ inDBID ] );
+
+    if( ! journalOn ) {
+        LINEARDB3_put( d->db, inKey, inValue );
+        return;
+        }
+
+    int k[3];
+    getKeyInts( inDBID, inKey, k );
+
+    char found;
+    JournalEntry *e =
+        journalEntries->lookup( inDBID, k[0], k[1], k[2], &found );
+
+    if( ! found ) {
+        e = new JournalEntry;
+
+        e->dbID = inDBID;
+        memcpy( e->key, inKey, d->keySize );
+        memcpy( e->keyInts, k, sizeof( k ) );
+        e->value = new unsigned char[ d->valueSize ];
+        e->generation = -1;
+        e->batchSerial = -1;
+        e->batchOffset = 0;
+
+        journalEntries->insert( inDBID, k[0], k[1], k[2], e );
+        journalEntryBytes += d->valueSize;
+        }
+
+    memcpy( e->value, inValue, d->valueSize );
+
+    if( e->generation != currentGeneration ) {
+        e->generation = currentGeneration;
+        currentGenerationEntries.push_back( e );
+        }
+
+    int recordLength = 1 + d->keySize + d->valueSize;
+
+    if( e->batchSerial == batchSerial ) {
+        // already in this batch, replace value there
+        memcpy( &( batchData[ e->batchOffset + 1 + d->keySize ] ),
+                inValue, d->valueSize );
+        return;
+        }
+
+    if( batchLength + recordLength > batchSize ) {
+        int newSize = batchSize * 2;
+
+        if( newSize < batchLength + recordLength ) {
+            newSize = batchLength + recordLength + 65536;
+            }
+        unsigned char *newData = new unsigned char[ newSize ];
+
+        if( batchData != NULL ) {
+            memcpy( newData, batchData, batchLength );
+            delete [] batchData;
+            }
+        batchData = newData;
+        batchSize = newSize;
+        }
+
+    e->batchSerial = batchSerial;
+    e->batchOffset = batchLength;
+
+    unsigned char *record = &( batchData[ batchLength ] );
+
+    record[0] = (unsigned char)inDBID;
+    memcpy( &( record[1] ), inKey, d->keySize );
+    memcpy( &( record[ 1 + d->keySize ] ), inValue, d->valueSize );
+
+    batchLength += recordLength;
+    batchNumRecords++;
+    }
+
+
+
+
+static void commitBatch() {
+    if( batchNumRecords == 0 ) {
+        return;
+        }
+
+    int length = MAP_JOURNAL_BATCH_HEADER_BYTES + batchLength + 4;
+
+    unsigned char *data = new unsigned char[ length ];
+
+    uint32_t numRecords = batchNumRecords;
+    uint32_t numBytes = batchLength;
+    uint32_t checksum = batchChecksum( batchData, batchLength );
+
+    memcpy( data, MAP_JOURNAL_BATCH_MAGIC, 4 );
+    memcpy( &( data[4] ), &numRecords, 4 );
+    memcpy( &( data[8] ), &numBytes, 4 );
+    memcpy( &( data[ MAP_JOURNAL_BATCH_HEADER_BYTES ] ),
+            batchData, batchLength );
+    memcpy( &( data[ MAP_JOURNAL_BATCH_HEADER_BYTES + batchLength ] ),
+            &checksum, 4 );
+
+    addJournalWriteJob( data, length, false, false );
+
+    batchLength = 0;
+    batchNumRecords = 0;
+
+    // entries holding offsets into the old batch no longer match
+    batchSerial++;
+    }
+
+
+
+static void startCheckpoint() {
+    commitBatch();
+
+    // puts made so far are all in the log that is being set aside
+    addJournalWriteJob( NULL, 0, true, false );
+
+    numCheckpointEntries = currentGenerationEntries.size();
+    nextCheckpointEntry = 0;
+    checkpointEntries = currentGenerationEntries.getElementArray();
+    currentGenerationEntries.deleteAll();
+
+    // neighboring keys were usually created together, so they sit near
+    // each other in the DB files
+    qsort( checkpointEntries, numCheckpointEntries, sizeof( JournalEntry* ),
+           compareEntries );
+
+    checkpointGeneration = currentGeneration;
+    currentGeneration++;
+
+    checkpointState = CHECKPOINT_APPLYING;
+    lastCheckpointTime = Time::getCurrentTime();
+    }
+
+
+
+// inSeconds of -1 applies all remaining entries
+static void applyCheckpoint( double inSeconds ) {
+    double startTime = Time::getCurrentTime();
+
+    int numApplied = 0;
+
+    while( nextCheckpointEntry < numCheckpointEntries ) {
+
+        if( inSeconds >= 0 &&
+            numApplied >= MAP_JOURNAL_CHECKPOINT_STEP_MIN_RECORDS &&
+            Time::getCurrentTime() - startTime > inSeconds ) {
+            return;
+            }
+
+        JournalEntry *e = checkpointEntries[ nextCheckpointEntry++ ];
+        JournalDB *d = &( journalDBs[ e->dbID ] );
+
+        if( LINEARDB3_put( d->db, e->key, e->value ) != 0 ) {
+            AppLog::errorF( "Failed to write journaled record to %s",
+                            d->path );
+            }
+        numApplied++;
+
+        if( e->generation == checkpointGeneration ) {
+            // no puts since checkpoint started, DB has latest value
+            journalEntries->remove( e->dbID, e->keyInts[0], e->keyInts[1],
+                                    e->keyInts[2] );
+            journalEntryBytes -= d->valueSize;
+
+            delete [] e->value;
+            delete e;
+            }
+        // else entry is in current generation too, and stays in RAM
+        }
+
+    delete [] checkpointEntries;
+    checkpointEntries = NULL;
+    numCheckpointEntries = 0;
+    nextCheckpointEntry = 0;
+
+    for( int i=0; i<numJournalDBs; i++ ) {
+        LINEARDB3_flush( journalDBs[i].db );
+        }
+
+    addJournalWriteJob( NULL, 0, false, true );
+
+    checkpointState = CHECKPOINT_SYNCING;
+    }
+
+
+
+static void checkCheckpointFinished() {
+    journalWriteLock.lock();
+
+    if( checkpointFinished ) {
+        checkpointFinished = false;
+        checkpointState = CHECKPOINT_NONE;
+        }
+
+    journalWriteLock.unlock();
+    }
+
+
+
+// returns false if a try at syncing DBs fails while waiting
+// checkpoint then stays in syncing state, and writer thread keeps trying
+static char waitForCheckpointSync() {
+    if( checkpointState != CHECKPOINT_SYNCING ) {
+        return true;
+        }
+
+    // only count failures from here on
+    journalWriteLock.lock();
+    checkpointSyncFailed = false;
+    journalWriteLock.unlock();
+
+    while( true ) {
+        checkCheckpointFinished();
+
+        if( checkpointState != CHECKPOINT_SYNCING ) {
+            return true;
+            }
+
+        journalWriteLock.lock();
+        char failed = checkpointSyncFailed;
+        journalWriteLock.unlock();
+
+        if( failed ) {
+            return false;
+            }
+
+        checkpointSyncSemaphore.wait();
+        }
+    }
+
+
+
+void stepMapJournal() {
+    if( ! journalOn ) {
+        return;
+        }
+
+    commitBatch();
+
+    checkJournalWriteFailed();
+
+    if( checkpointState == CHECKPOINT_SYNCING ) {
+        checkCheckpointFinished();
+        }
+
+    if( checkpointState == CHECKPOINT_NONE &&
+        currentGenerationEntries.size() > 0 &&
+        ( Time::getCurrentTime() - lastCheckpointTime >= checkpointSeconds ||
+          journalEntryBytes > MAP_JOURNAL_MAX_PENDING_BYTES ) ) {
+        startCheckpoint();
+        }
+
+    if( checkpointState == CHECKPOINT_APPLYING ) {
+        if( journalEntryBytes > 2 * MAP_JOURNAL_MAX_PENDING_BYTES ) {
+            // puts are outrunning checkpoint
+            applyCheckpoint( -1 );
+            }
+        else {
+            applyCheckpoint( MAP_JOURNAL_CHECKPOINT_STEP_SECONDS );
+            }
+        }
+    }
+
+
+
+void flushMapJournal() {
+    if( ! journalOn ) {
+        return;
+        }
+
+    commitBatch();
+
+    if( checkpointState == CHECKPOINT_APPLYING ) {
+        applyCheckpoint( -1 );
+        }
+
+    if( currentGenerationEntries.size() > 0 ) {
+        // new checkpoint can't set log aside until last one is synced
+        if( ! waitForCheckpointSync() ) {
+            AppLog::error( "Failed to sync map databases, latest map "
+                           "changes are only in map journal" );
+            return;
+            }
+
+        startCheckpoint();
+        applyCheckpoint( -1 );
+        }
+    }
+
+
+
+void freeMapJournal() {
+    if( journalOn ) {
+        flushMapJournal();
+
+        char synced = waitForCheckpointSync() &&
+            currentGenerationEntries.size() == 0;
+
+        journalWriteLock.lock();
+        stopJournalWriter = true;
+        journalWriteLock.unlock();
+
+        journalJobSemaphore.signal();
+
+        delete journalWriter;
+        journalWriter = NULL;
+
+        stopJournalWriter = false;
+        checkpointFinished = false;
+        checkpointSyncFailed = false;
+        checkpointSyncPending = false;
+
+        checkJournalWriteFailed();
+
+        if( journalFile != NULL ) {
+            fclose( journalFile );
+            journalFile = NULL;
+            }
+
+        if( synced ) {
+            // everything in log is synced to DBs now
+            remove( journalPath );
+            }
+        else {
+            AppLog::error( "Map journal not fully checkpointed, leaving it "
+                           "to be replayed on next startup" );
+            }
+
+        // every entry was checkpointed by flush above, unless sync failed,
+        // and then they are in logs left for replay
+        delete journalEntries;
+        journalEntries = NULL;
+        journalEntryBytes = 0;
+
+        currentGenerationEntries.deleteAll();
+        checkpointState = CHECKPOINT_NONE;
+
+        if( batchData != NULL ) {
+            delete [] batchData;
+            batchData = NULL;
+            }
+        batchSize = 0;
+
+        journalOn = false;
+        }
+
+    for( int i=0; i<numJournalDBs; i++ ) {
+        delete [] journalDBs[i].path;
+        }
+    numJournalDBs = 0;
+    }
+
+
+
+void deleteMapJournalFiles() {
+    remove( journalPath );
+    remove( checkpointPath );
+    }
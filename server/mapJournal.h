@@ -0,0 +1,73 @@
+#include "lineardb3.h"
+
+
+// Write-ahead journal for map DB puts
+//
+// With mapJournal.ini on, puts to journaled DBs don't go to the DB file
+// right away.  The latest value for each key is kept in RAM, where gets
+// find it, and the puts made during each server step are appended to
+// mapJournal.log together, as one batch.
+//
+// Every mapJournalCheckpointSeconds, the log is set aside and the values
+// it holds are written to the DB files, sorted by key, a few at a time
+// over the next steps.  Once the DB files are synced, the set-aside log
+// is deleted.
+//
+// After a crash, replayMapJournal puts everything in the logs back into
+// the DB files, up to the last whole batch.
+
+
+// inKeySize can be at most 12 bytes
+//
+// call for each DB before replayMapJournal, in the same order every run,
+// because batches refer to DBs by the order they were added in
+//
+// returns DB's ID in the journal, starting from 0
+int addMapJournalDB( const char *inPath,
+                     unsigned int inKeySize, unsigned int inValueSize );
+
+
+// writes puts left in journal files by an earlier run into the DB files
+//
+// must be called before the DBs are opened
+//
+// returns false on failure
+char replayMapJournal();
+
+
+// starts journaling puts, if mapJournal.ini is on
+//
+// inDBs are the open DBs, in the order they were added
+void initMapJournal( LINEARDB3 **inDBs );
+
+
+// writes any journaled puts through to the DBs, syncs them, and stops
+// journaling
+//
+// after this, puts go straight to the DBs, which can then be closed
+void freeMapJournal();
+
+
+
+// same as LINEARDB3_get and LINEARDB3_put, through the journal
+int mapJournalGet( int inDBID, const void *inKey, void *outValue );
+
+void mapJournalPut( int inDBID, const void *inKey, const void *inValue );
+
+
+
+// writes puts made since last call as one batch, and moves any
+// checkpoint along
+//
+// call once per server step
+void stepMapJournal();
+
+
+// writes every journaled put through to the DBs
+//
+// must be called before iterating through a journaled DB directly
+void flushMapJournal();
+
+
+// delete journal files along with DB files when wiping map
+void deleteMapJournalFiles();
@@ -0,0 +1,97 @@
+#include "mapTile.h"
+#include "dbCommon.h"
+
+#include <string.h>
+
+
+
+int getMapTileOrigin( int inV ) {
+    int offset = inV % MAP_TILE_D;
+
+    if( offset < 0 ) {
+        // round toward negative infinity, not toward 0
+        offset += MAP_TILE_D;
+        }
+    return inV - offset;
+    }
+
+
+
+int getMapTileCellIndex( int inX, int inY ) {
+    return
+        ( inY - getMapTileOrigin( inY ) ) * MAP_TILE_D +
+        ( inX - getMapTileOrigin( inX ) );
+    }
+
+
+
+void clearMapTile( MapTile *inTile, int inX, int inY ) {
+    inTile->originX = getMapTileOrigin( inX );
+    inTile->originY = getMapTileOrigin( inY );
+
+    for( int i=0; i<MAP_TILE_CELLS; i++ ) {
+        inTile->objects[i] = -1;
+        inTile->floors[i] = -1;
+        inTile->objectEtas[i] = 0;
+        inTile->floorEtas[i] = 0;
+        inTile->contained[i] = false;
+        }
+    }
+
+
+
+#define OBJECTS_OFFSET 0
+#define FLOORS_OFFSET ( OBJECTS_OFFSET + MAP_TILE_CELLS * 4 )
+#define OBJECT_ETAS_OFFSET ( FLOORS_OFFSET + MAP_TILE_CELLS * 4 )
+#define FLOOR_ETAS_OFFSET ( OBJECT_ETAS_OFFSET + MAP_TILE_CELLS * 8 )
+#define CONTAINED_OFFSET ( FLOOR_ETAS_OFFSET + MAP_TILE_CELLS * 8 )
+
+
+
+void encodeMapTile( MapTile *inTile, unsigned char *outValue ) {
+    memset( &( outValue[ CONTAINED_OFFSET ] ), 0, MAP_TILE_CELLS / 8 );
+
+    for( int i=0; i<MAP_TILE_CELLS; i++ ) {
+        intToValue( inTile->objects[i],
+                    &( outValue[ OBJECTS_OFFSET + i * 4 ] ) );
+        intToValue( inTile->floors[i],
+                    &( outValue[ FLOORS_OFFSET + i * 4 ] ) );
+        timeToValue( inTile->objectEtas[i],
+                     &( outValue[ OBJECT_ETAS_OFFSET + i * 8 ] ) );
+        timeToValue( inTile->floorEtas[i],
+                     &( outValue[ FLOOR_ETAS_OFFSET + i * 8 ] ) );
+
+        if( inTile->contained[i] ) {
+            outValue[ CONTAINED_OFFSET + i / 8 ] |= ( 1 << ( i % 8 ) );
+            }
+        }
+    }
+
+
+
+void decodeMapTile( unsigned char *inValue, int inX, int inY,
+                    MapTile *outTile ) {
+    outTile->originX = getMapTileOrigin( inX );
+    outTile->originY = getMapTileOrigin( inY );
+
+    for( int i=0; i<MAP_TILE_CELLS; i++ ) {
+        outTile->objects[i] =
+            valueToInt( &( inValue[ OBJECTS_OFFSET + i * 4 ] ) );
+        outTile->floors[i] =
+            valueToInt( &( inValue[ FLOORS_OFFSET + i * 4 ] ) );
+        outTile->objectEtas[i] =
+            valueToTime( &( inValue[ OBJECT_ETAS_OFFSET + i * 8 ] ) );
+        outTile->floorEtas[i] =
+            valueToTime( &( inValue[ FLOOR_ETAS_OFFSET + i * 8 ] ) );
+
+        outTile->contained[i] =
+            ( inValue[ CONTAINED_OFFSET + i / 8 ] >> ( i % 8 ) ) & 1;
+        }
+    }
+
+
+
+void mapTileKey( int inX, int inY, unsigned char *outKey ) {
+    intToValue( getMapTileOrigin( inX ), outKey );
+    intToValue( getMapTileOrigin( inY ), &( outKey[4] ) );
+    }
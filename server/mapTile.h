@@ -0,0 +1,79 @@
+#ifndef MAP_TILE_H_INCLUDED
+#define MAP_TILE_H_INCLUDED
+
+
+#include "minorGems/system/Time.h"
+
+
+
+// Storage format for mapTiles.db, which holds the base object, floor,
+// and their decay ETAs for a whole square tile of map cells in one
+// fixed-size record.
+//
+// A chunk sent to a client covers only a handful of tiles, so reading it
+// costs a handful of DB_gets instead of several random DB_gets per cell.
+//
+// The tile at x,y is stored under the key of its origin cell (the cell
+// in the tile with the lowest x and y), as two 32-bit ints.
+#define MAP_TILE_D 16
+
+#define MAP_TILE_CELLS ( MAP_TILE_D * MAP_TILE_D )
+
+#define MAP_TILE_KEY_BYTES 8
+
+// objects, floors, object ETAs, floor ETAs, then one contained bit
+// per cell
+#define MAP_TILE_BYTES ( MAP_TILE_CELLS * ( 4 + 4 + 8 + 8 ) + \
+                         MAP_TILE_CELLS / 8 )
+
+
+
+// cells are indexed by ( y - originY ) * MAP_TILE_D + ( x - originX )
+typedef struct MapTile {
+        int originX, originY;
+
+        // -1 if not set (use base map)
+        int objects[ MAP_TILE_CELLS ];
+
+        // -1 if not set
+        int floors[ MAP_TILE_CELLS ];
+
+        // 0 if not set
+        timeSec_t objectEtas[ MAP_TILE_CELLS ];
+        timeSec_t floorEtas[ MAP_TILE_CELLS ];
+
+        // true if mapContained.db may have a record for this cell
+        // (false means there is definitely no record there, so we don't
+        //  need to look)
+        char contained[ MAP_TILE_CELLS ];
+    } MapTile;
+
+
+
+// origin of the tile containing coordinate inV, along either axis
+int getMapTileOrigin( int inV );
+
+
+// index of cell x,y in the tile containing it
+int getMapTileCellIndex( int inX, int inY );
+
+
+// sets inTile to a tile with no cells set, with origin of tile containing
+// x,y
+void clearMapTile( MapTile *inTile, int inX, int inY );
+
+
+// outValue must be MAP_TILE_BYTES
+void encodeMapTile( MapTile *inTile, unsigned char *outValue );
+
+
+// inX,inY can be any cell in the tile
+void decodeMapTile( unsigned char *inValue, int inX, int inY,
+                    MapTile *outTile );
+
+
+// packs origin of tile containing x,y into a MAP_TILE_KEY_BYTES key
+void mapTileKey( int inX, int inY, unsigned char *outKey );
+
+
+#endif
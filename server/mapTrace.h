@@ -0,0 +1,74 @@
+#ifndef MAP_TRACE_H_INCLUDED
+#define MAP_TRACE_H_INCLUDED
+
+
+#include <string.h>
+
+
+// Trace of map DB accesses (dbGet, dbPut, dbTimeGet, dbFloorGet, etc.),
+// recorded by map.cpp while recordMapTraceSeconds.ini is set, and
+// replayed against each DB backend by traceBenchmark.
+//
+// File starts with the 4-byte MAP_TRACE_MAGIC, followed by records of
+// MAP_TRACE_RECORD_BYTES each, in native byte order:
+//    1 byte op
+//    4 ints x, y, slot, subCont
+//    double seconds since trace started
+//    double value put (int value, or ETA for time puts), 0 for gets
+
+
+#define MAP_TRACE_MAGIC "OLt1"
+
+#define MAP_TRACE_RECORD_BYTES 33
+
+
+enum MapTraceOp {
+    MAP_TRACE_GET = 0,
+    MAP_TRACE_PUT,
+    MAP_TRACE_TIME_GET,
+    MAP_TRACE_TIME_PUT,
+    MAP_TRACE_FLOOR_GET,
+    MAP_TRACE_FLOOR_PUT,
+    MAP_TRACE_FLOOR_TIME_GET,
+    MAP_TRACE_FLOOR_TIME_PUT,
+    MAP_TRACE_NUM_OPS
+    };
+
+
+typedef struct MapTraceRecord {
+        unsigned char op;
+        int x, y;
+        int slot, subCont;
+        double time;
+        double value;
+    } MapTraceRecord;
+
+
+
+inline void encodeMapTraceRecord( MapTraceRecord *inR,
+                                  unsigned char *outBytes ) {
+    outBytes[0] = inR->op;
+    memcpy( &( outBytes[1] ), &( inR->x ), 4 );
+    memcpy( &( outBytes[5] ), &( inR->y ), 4 );
+    memcpy( &( outBytes[9] ), &( inR->slot ), 4 );
+    memcpy( &( outBytes[13] ), &( inR->subCont ), 4 );
+    memcpy( &( outBytes[17] ), &( inR->time ), 8 );
+    memcpy( &( outBytes[25] ), &( inR->value ), 8 );
+    }
+
+
+
+inline void decodeMapTraceRecord( unsigned char *inBytes,
+                                  MapTraceRecord *outR ) {
+    outR->op = inBytes[0];
+    memcpy( &( outR->x ), &( inBytes[1] ), 4 );
+    memcpy( &( outR->y ), &( inBytes[5] ), 4 );
+    memcpy( &( outR->slot ), &( inBytes[9] ), 4 );
+    memcpy( &( outR->subCont ), &( inBytes[13] ), 4 );
+    memcpy( &( outR->time ), &( inBytes[17] ), 8 );
+    memcpy( &( outR->value ), &( inBytes[25] ), 8 );
+    }
+
+
+
+#endif
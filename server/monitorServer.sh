@@ -13,7 +13,11 @@ do
 
 	cpuPerPlayer=`bc <<< "scale=2; $cpu / $numPlayers"`
 
-	echo "$i $numPlayers $cpu $cpuPerPlayer"
+	# main loop step time from last minute, rewritten by server
+	# p50 and p99 in ms
+	stepTimes=`grep "^phase step " tickProfile.txt 2>/dev/null | awk '{print \$4, \$5}'`
+
+	echo "$i $numPlayers $cpu $cpuPerPlayer $stepTimes"
 
 	sleep 5
 
@@ -7,7 +7,9 @@
 #include "minorGems/util/SettingsManager.h"
 #include "minorGems/util/SimpleVector.h"
 
-#include "minorGems/network/web/WebRequest.h"
+#include "minorGems/util/stringUtils.h"
+
+#include "asyncWeb.h"
 #include "minorGems/network/web/URLUtils.h"
 
 #include "minorGems/crypto/hashes/sha1.h"
@@ -26,7 +28,7 @@ static char *statsServerSharedSecret = NULL;
 typedef struct StatRecord {
         char *email;
         int numGameSeconds;
-        WebRequest *request;
+        AsyncWebRequest *request;
         // -1 until first request gets it
         int sequenceNumber;
     } StatRecord;
@@ -145,7 +147,7 @@ void recordPlayerLifeStats( char *inEmail, int inNumSecondsLived ) {
 
     if( useStatsServer ) {
         
-        WebRequest *request;
+        AsyncWebRequest *request;
         
         char *encodedEmail = URLUtils::urlEncode( inEmail );
 
@@ -157,7 +159,7 @@ void recordPlayerLifeStats( char *inEmail, int inNumSecondsLived ) {
         
         delete [] encodedEmail;
         
-        request = new WebRequest( "GET", url, NULL );
+        request = new AsyncWebRequest( "GET", url, NULL );
         printf( "Starting new web request for %s\n", url );
         
         delete [] url;
@@ -230,7 +232,7 @@ void stepPlayerStats() {
                     delete [] encodedEmail;
                     delete [] hash;
 
-                    r->request = new WebRequest( "GET", url, NULL );
+                    r->request = new AsyncWebRequest( "GET", url, NULL );
                     printf( "Starting new web request for %s\n", url );
                     
                     delete [] url;
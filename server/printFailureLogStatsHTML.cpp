@@ -4,6 +4,9 @@
 #include "minorGems/io/file/File.h"
 #include "minorGems/util/stringUtils.h"
 
+#include "logQuery.h"
+#include "FlatHashTable.h"
+
 
 void usage() {
     printf( "Usage:\n" );
@@ -29,12 +32,25 @@ typedef struct FailureRec {
         int count;
     } FailureRec;
 
+
+
+typedef struct FailureRecList {
+        SimpleVector<FailureRec> records;
+
+        // index in records for each actor and target
+        FlatHashTable<int> indexByIDs;
+        
+        FailureRecList()
+                : indexByIDs( 256, -1 ) {
+            }
+    } FailureRecList;
+
     
-SimpleVector<FailureRec> monthRecords;
-SimpleVector<FailureRec> weekRecords;
-SimpleVector<FailureRec> todayRecords;
-SimpleVector<FailureRec> yesterdayRecords;
-SimpleVector<FailureRec> hourRecords;
+FailureRecList monthRecords;
+FailureRecList weekRecords;
+FailureRecList todayRecords;
+FailureRecList yesterdayRecords;
+FailureRecList hourRecords;
 
 
 // to sort with largest value at the top
@@ -72,21 +88,21 @@ void sortRecList( SimpleVector<FailureRec> *inRecList ) {
 
 
 
-FailureRec *findExistingRect( SimpleVector<FailureRec> *inRecList, 
+FailureRec *findExistingRect( FailureRecList *inRecList, 
                               int inActorID, int inTargetID ) {
-    for( int i=0; i<inRecList->size(); i++ ) {
-        FailureRec *r = inRecList->getElement( i );
-        
-        if( r->actorID == inActorID && r->targetID == inTargetID ) {
-            return r;
-            }
+    char found;
+    int i = inRecList->indexByIDs.lookup( inActorID, inTargetID, 0, 0, 
+                                          &found );
+    
+    if( found ) {
+        return inRecList->records.getElement( i );
         }
     return NULL;
     }
 
 
 
-void addCount( SimpleVector<FailureRec> *inRecList, int inActorID,
+void addCount( FailureRecList *inRecList, int inActorID,
                int inTargetID, int inCount ) {
 
     FailureRec *r = findExistingRect( inRecList, inActorID, inTargetID );
@@ -96,23 +112,46 @@ void addCount( SimpleVector<FailureRec> *inRecList, int inActorID,
         }
     else {
         FailureRec rNew = { inActorID, inTargetID, inCount };
-        inRecList->push_back( rNew );
+        inRecList->records.push_back( rNew );
+        inRecList->indexByIDs.insert( inActorID, inTargetID, 0, 0,
+                                      inRecList->records.size() - 1 );
         }
     }
 
 
 
-void processLogFile( File *inFile ) {
-    
-    char *path = inFile->getFullFileName();
+void addAll( FailureRecList *inRecList, FailureRecList *inOtherList ) {
+    for( int i=0; i<inOtherList->records.size(); i++ ) {
+        FailureRec *r = inOtherList->records.getElement( i );
+        
+        addCount( inRecList, r->actorID, r->targetID, r->count );
+        }
+    }
+
+
+
+typedef struct LogFileQuery {
+        char isThisWeek;
+        char isToday;
+        char isYesterday;
+        int currentHour;
 
+        // totals from log, filled in on worker thread
+        FailureRecList *fileRecords;
+        // rows from this hour and last, if today
+        FailureRecList *fileHourRecords;
+    } LogFileQuery;
+
+
+
+// which stats a log counts toward, from the date in its name
+void getFileDates( char *inFileName, LogFileQuery *outQuery ) {
+    
     char isThisWeek = false;
     char isToday = false;
     char isYesterday = false;
-    char isThisHour = false;
-    
 
-    char *name = inFile->getFileName();
+    char *name = inFileName;
     
     int fileYear, fileMonth, fileDay;
 
@@ -201,78 +240,74 @@ void processLogFile( File *inFile ) {
             isYesterday = true;
             }
         }
-    
 
-    delete [] name;
-    
+    outQuery->isThisWeek = isThisWeek;
+    outQuery->isToday = isToday;
+    outQuery->isYesterday = isYesterday;
+    outQuery->currentHour = currentHour;
+    }
+
 
+
+// called on worker threads
+void sumLogTable( LogTable *inTable, int inFileIndex, void *inData ) {
+    LogFileQuery *q = &( ( (LogFileQuery *)inData )[ inFileIndex ] );
+    
+    if( ! q->isThisWeek ) {
+        // no stats for it
+        return;
+        }
     
-    FILE *f = fopen( path, "r" );
+    int *actors = inTable->intColumns[ FAILURE_ACTOR ];
+    int *targets = inTable->intColumns[ FAILURE_TARGET ];
+    int *counts = inTable->intColumns[ FAILURE_COUNT ];
     
-    if( f != NULL ) {
-        char scannedLine = true;
+    if( q->isToday || q->isYesterday ) {
+        for( int r=0; r<inTable->numRows; r++ ) {
+            addCount( q->fileRecords, actors[r], targets[r], counts[r] );
+            }
+        }
+    
+    if( q->isToday ) {
+        // if server running, this hour's data not recorded yet
+        // so include last hour too
+        int startHour = q->currentHour - 1;
         
-        while( scannedLine ) {
-            scannedLine = false;
-            
-            int hour = 0;
-            int lastScannedHour = 0;
-            
-            // process empty hours until next line is not an hour line
-            while( hour != -1 ) {
-                hour = -1;
-                fscanf( f, "hour=%d\n", &hour );
-                
-                if( hour != -1 ) {
-                    lastScannedHour = hour;
-                    }
-                }
-            
-            if( lastScannedHour != -1 && 
-                isToday &&
-                ( lastScannedHour == currentHour ||
-                  lastScannedHour == currentHour - 1 ) ) {
-                // if server running, this hour's data not recorded yet
-                isThisHour = true;
-                }
-            
-
-
-            int actorID, targetID, count;
-            
-            int numScanned = 
-                fscanf( f, "%d + %d  count=%d\n",
-                        &actorID, &targetID, &count);
-            
-            if( numScanned == 3 ) {
-
-                // skip this for now, to reduce CPU
-                // addCount( &monthRecords, actorID, targetID, count );
-
-                if( isThisWeek ) {
-                    
-                    // skip this for now, to reduce CPU
-                    // addCount( &weekRecords, actorID, targetID, count );
-                    
-                    if( isToday ) {
-                        addCount( &todayRecords, actorID, targetID, count );
-                        if( isThisHour ) {
-                            addCount( &hourRecords, actorID, targetID, count );
-                            }
-                        }
-                    else if( isYesterday ) {
-                        addCount( &yesterdayRecords, actorID, targetID, count );
-                        }
-                    }
-
-                scannedLine = true;
-                }
+        if( startHour < 0 ) {
+            startHour = 0;
             }
         
+        for( int r = inTable->hourRows[ startHour ]; 
+             r < inTable->hourRows[ q->currentHour + 1 ]; r++ ) {
+            addCount( q->fileHourRecords, actors[r], targets[r], counts[r] );
+            }
+        }
+    }
+
+
 
-        fclose( f );
+// called in file order
+void addLogTable( LogTable *inTable, int inFileIndex, void *inData ) {
+    LogFileQuery *q = &( ( (LogFileQuery *)inData )[ inFileIndex ] );
+    
+    // skip month and week for now, to reduce CPU
+    
+    if( q->isThisWeek ) {
+        
+        if( q->isToday ) {
+            addAll( &todayRecords, q->fileRecords );
+            addAll( &hourRecords, q->fileHourRecords );
+            }
+        else if( q->isYesterday ) {
+            addAll( &yesterdayRecords, q->fileRecords );
+            }
         }
-    delete [] path;
+    
+    delete q->fileRecords;
+    delete q->fileHourRecords;
+    
+    q->fileRecords = NULL;
+    q->fileHourRecords = NULL;
     }
 
 
@@ -355,10 +390,12 @@ void printTable( const char *inName, File *inObjectDir, FILE *inFile,
 
 
 
-void processFailureLogFolder( File *inFolder ) {
-    int numFiles;
+void processFailureLogFolder( char *inServerDir, char *inFolderName ) {
+    SimpleVector<char*> allLogs;
+    
+    getLogFileNames( inServerDir, inFolderName, &allLogs );
     
-    File **logs = inFolder->getChildFilesSorted( &numFiles );
+    int numFiles = allLogs.size();
     
     // only process last X files, if there are more than X
     int startI = 0;
@@ -373,15 +410,42 @@ void processFailureLogFolder( File *inFolder ) {
         startI = numFiles - maxNumFiles;
         }
 
-    for( int i=startI; i<numFiles; i++ ) {
-        processLogFile( logs[i] );
-        }
+    SimpleVector<char*> logs;
     
     for( int i=0; i<numFiles; i++ ) {
-        delete logs[i];
+        char *name = allLogs.getElementDirect( i );
+        
+        if( i >= startI ) {
+            logs.push_back( name );
+            }
+        else {
+            delete [] name;
+            }
         }
     
-    delete [] logs;
+    LogFileQuery *queries = new LogFileQuery[ logs.size() ];
+    
+    for( int i=0; i<logs.size(); i++ ) {
+        getFileDates( logs.getElementDirect( i ), &( queries[i] ) );
+        
+        queries[i].fileRecords = new FailureRecList;
+        queries[i].fileHourRecords = new FailureRecList;
+        }
+    
+    // sums each log on worker threads, then adds sums up in order
+    runLogQuery( inServerDir, inFolderName, FAILURE_LOG, &logs, 0,
+                 sumLogTable, addLogTable, queries );
+    
+    for( int i=0; i<logs.size(); i++ ) {
+        // left for logs that couldn't be read
+        if( queries[i].fileRecords != NULL ) {
+            delete queries[i].fileRecords;
+            delete queries[i].fileHourRecords;
+            }
+        }
+    delete [] queries;
+    
+    logs.deallocateStringElements();
     }
 
 
@@ -411,33 +475,22 @@ int main( int inNumArgs, char **inArgs ) {
     if( mainDir.exists() && mainDir.isDirectory() &&
         objDir.exists() && objDir.isDirectory() ) {
 
-        int numChildFiles;
-        File **childFiles = mainDir.getChildFiles( &numChildFiles );
+        // failureLog, failureLog_server2, etc.
+        SimpleVector<char*> folders;
+        getLogFolders( path, FAILURE_LOG, &folders );
         
-        for( int i=0; i<numChildFiles; i++ ) {
-        
-            if( childFiles[i]->isDirectory() ) {
-                
-                char *name = childFiles[i]->getFileName();
-                
-                if( strstr( name, "failureLog" ) == name ) {
-                    // file name starts with failureLog
-                    processFailureLogFolder( childFiles[i] );
-                    }
-                delete [] name;
-                }
-            
-            delete childFiles[i];
+        for( int i=0; i<folders.size(); i++ ) {
+            processFailureLogFolder( path, folders.getElementDirect( i ) );
             }
-        delete [] childFiles;
+        folders.deallocateStringElements();
 
         
 
-        sortRecList( &monthRecords );
-        sortRecList( &weekRecords );
-        sortRecList( &todayRecords );
-        sortRecList( &yesterdayRecords );
-        sortRecList( &hourRecords );
+        sortRecList( &( monthRecords.records ) );
+        sortRecList( &( weekRecords.records ) );
+        sortRecList( &( todayRecords.records ) );
+        sortRecList( &( yesterdayRecords.records ) );
+        sortRecList( &( hourRecords.records ) );
 
         FILE *outFile = fopen( outPath, "w" );
         
@@ -445,21 +498,21 @@ int main( int inNumArgs, char **inArgs ) {
         if( outFile != NULL ) {
             
             printTable( "Past Hour",
-                        &objDir, outFile, &hourRecords );
+                        &objDir, outFile, &( hourRecords.records ) );
             
             printTable( "Today (so far)",
-                        &objDir, outFile, &todayRecords );
+                        &objDir, outFile, &( todayRecords.records ) );
             
             printTable( "Yesterday",
-                        &objDir, outFile, &yesterdayRecords );
+                        &objDir, outFile, &( yesterdayRecords.records ) );
             /*
               // for now, don't show results for week or month
               // too CPU intensive to compute it
             printTable( "Past week",
-                        &objDir, outFile, &weekRecords );
+                        &objDir, outFile, &( weekRecords.records ) );
 
             printTable( "Past month",
-                        &objDir, outFile, &monthRecords );
+                        &objDir, outFile, &( monthRecords.records ) );
             */
             fclose( outFile );
             }
@@ -4,6 +4,9 @@
 #include "minorGems/io/file/File.h"
 #include "minorGems/util/stringUtils.h"
 
+#include "logQuery.h"
+#include "FlatHashTable.h"
+
 
 void usage() {
     printf( "Usage:\n" );
@@ -29,12 +32,25 @@ typedef struct FoodRec {
         int value;
     } FoodRec;
 
+
+
+typedef struct FoodRecList {
+        SimpleVector<FoodRec> records;
+
+        // index in records for each object ID
+        FlatHashTable<int> indexByID;
+        
+        FoodRecList()
+                : indexByID( 256, -1 ) {
+            }
+    } FoodRecList;
+
     
-SimpleVector<FoodRec> monthRecords;
-SimpleVector<FoodRec> weekRecords;
-SimpleVector<FoodRec> todayRecords;
-SimpleVector<FoodRec> yesterdayRecords;
-SimpleVector<FoodRec> hourRecords;
+FoodRecList monthRecords;
+FoodRecList weekRecords;
+FoodRecList todayRecords;
+FoodRecList yesterdayRecords;
+FoodRecList hourRecords;
 
 
 // to sort with largest value at the top
@@ -72,20 +88,19 @@ void sortRecList( SimpleVector<FoodRec> *inRecList ) {
 
 
 
-FoodRec *findExistingRect( SimpleVector<FoodRec> *inRecList, int inID ) {
-    for( int i=0; i<inRecList->size(); i++ ) {
-        FoodRec *r = inRecList->getElement( i );
-        
-        if( r->id == inID ) {
-            return r;
-            }
+FoodRec *findExistingRect( FoodRecList *inRecList, int inID ) {
+    char found;
+    int i = inRecList->indexByID.lookup( inID, 0, 0, 0, &found );
+    
+    if( found ) {
+        return inRecList->records.getElement( i );
         }
     return NULL;
     }
 
 
 
-void addCountAndValue( SimpleVector<FoodRec> *inRecList, int inID,
+void addCountAndValue( FoodRecList *inRecList, int inID,
                        int inCount, int inValue ) {
 
     FoodRec *r = findExistingRect( inRecList, inID );
@@ -96,23 +111,46 @@ void addCountAndValue( SimpleVector<FoodRec> *inRecList, int inID,
         }
     else {
         FoodRec rNew = { inID, inCount, inValue };
-        inRecList->push_back( rNew );
+        inRecList->records.push_back( rNew );
+        inRecList->indexByID.insert( inID, 0, 0, 0,
+                                     inRecList->records.size() - 1 );
         }
     }
 
 
 
-void processLogFile( File *inFile ) {
-    
-    char *path = inFile->getFullFileName();
+void addAll( FoodRecList *inRecList, FoodRecList *inOtherList ) {
+    for( int i=0; i<inOtherList->records.size(); i++ ) {
+        FoodRec *r = inOtherList->records.getElement( i );
+        
+        addCountAndValue( inRecList, r->id, r->count, r->value );
+        }
+    }
+
+
+
+typedef struct LogFileQuery {
+        char isThisWeek;
+        char isToday;
+        char isYesterday;
+        int currentHour;
 
+        // totals from log, filled in on worker thread
+        FoodRecList *fileRecords;
+        // rows from this hour and last, if today
+        FoodRecList *fileHourRecords;
+    } LogFileQuery;
+
+
+
+// which stats a log counts toward, from the date in its name
+void getFileDates( char *inFileName, LogFileQuery *outQuery ) {
+    
     char isThisWeek = false;
     char isToday = false;
     char isYesterday = false;
-    char isThisHour = false;
-    
 
-    char *name = inFile->getFileName();
+    char *name = inFileName;
     
     int fileYear, fileMonth, fileDay;
 
@@ -200,79 +238,70 @@ void processLogFile( File *inFile ) {
             isYesterday = true;
             }
         }
-    
 
-    delete [] name;
-    
+    outQuery->isThisWeek = isThisWeek;
+    outQuery->isToday = isToday;
+    outQuery->isYesterday = isYesterday;
+    outQuery->currentHour = currentHour;
+    }
+
+
 
+// called on worker threads
+void sumLogTable( LogTable *inTable, int inFileIndex, void *inData ) {
+    LogFileQuery *q = &( ( (LogFileQuery *)inData )[ inFileIndex ] );
     
-    FILE *f = fopen( path, "r" );
+    int *ids = inTable->intColumns[ FOOD_ID ];
+    int *counts = inTable->intColumns[ FOOD_COUNT ];
+    int *values = inTable->intColumns[ FOOD_VALUE ];
     
-    if( f != NULL ) {
-        char scannedLine = true;
+    for( int r=0; r<inTable->numRows; r++ ) {
+        addCountAndValue( q->fileRecords, ids[r], counts[r], values[r] );
+        }
+    
+    if( q->isToday ) {
+        // if server running, this hour's data not recorded yet
+        // so include last hour too
+        int startHour = q->currentHour - 1;
         
-        while( scannedLine ) {
-            scannedLine = false;
-            
-            int hour = 0;
-            int lastScannedHour = 0;
-            
-            // process empty hours until next line is not an hour line
-            while( hour != -1 ) {
-                hour = -1;
-                fscanf( f, "hour=%d\n", &hour );
-                
-                if( hour != -1 ) {
-                    lastScannedHour = hour;
-                    }
-                }
-            
-            if( lastScannedHour != -1 && 
-                isToday &&
-                ( lastScannedHour == currentHour ||
-                  lastScannedHour == currentHour - 1 ) ) {
-                // if server running, this hour's data not recorded yet
-                isThisHour = true;
-                }
-            
-
-
-            int id, count, value;
-            double aveAge;
-            int aveMapX, aveMapY;
-            
-            int numScanned = 
-                fscanf( f, "id=%d count=%d value=%d av_age=%lf "
-                        "av_mapX=%d av_mapY=%d\n",
-                        &id, &count, &value, &aveAge, &aveMapX, &aveMapY );
-            
-            if( numScanned == 6 ) {
-
-                addCountAndValue( &monthRecords, id, count, value );
-
-                if( isThisWeek ) {
-                    
-                    addCountAndValue( &weekRecords, id, count, value );
-                    
-                    if( isToday ) {
-                        addCountAndValue( &todayRecords, id, count, value );
-                        if( isThisHour ) {
-                            addCountAndValue( &hourRecords, id, count, value );
-                            }
-                        }
-                    else if( isYesterday ) {
-                        addCountAndValue( &yesterdayRecords, id, count, value );
-                        }
-                    }
-
-                scannedLine = true;
-                }
+        if( startHour < 0 ) {
+            startHour = 0;
             }
         
+        for( int r = inTable->hourRows[ startHour ]; 
+             r < inTable->hourRows[ q->currentHour + 1 ]; r++ ) {
+            addCountAndValue( q->fileHourRecords, 
+                              ids[r], counts[r], values[r] );
+            }
+        }
+    }
+
+
 
-        fclose( f );
+// called in file order
+void addLogTable( LogTable *inTable, int inFileIndex, void *inData ) {
+    LogFileQuery *q = &( ( (LogFileQuery *)inData )[ inFileIndex ] );
+    
+    addAll( &monthRecords, q->fileRecords );
+    
+    if( q->isThisWeek ) {
+        
+        addAll( &weekRecords, q->fileRecords );
+        
+        if( q->isToday ) {
+            addAll( &todayRecords, q->fileRecords );
+            addAll( &hourRecords, q->fileHourRecords );
+            }
+        else if( q->isYesterday ) {
+            addAll( &yesterdayRecords, q->fileRecords );
+            }
         }
-    delete [] path;
+    
+    delete q->fileRecords;
+    delete q->fileHourRecords;
+    
+    q->fileRecords = NULL;
+    q->fileHourRecords = NULL;
     }
 
 
@@ -325,10 +354,12 @@ void printTable( const char *inName, File *inObjectDir, FILE *inFile,
 
 
 
-void processFoodLogFolder( File *inFolder ) {
-    int numFiles;
+void processFoodLogFolder( char *inServerDir, char *inFolderName ) {
+    SimpleVector<char*> allLogs;
+    
+    getLogFileNames( inServerDir, inFolderName, &allLogs );
     
-    File **logs = inFolder->getChildFilesSorted( &numFiles );
+    int numFiles = allLogs.size();
     
     // only process last 30 files, if there are more than 30
     int startI = 0;
@@ -337,15 +368,42 @@ void processFoodLogFolder( File *inFolder ) {
         startI = numFiles - 30;
         }
 
-    for( int i=startI; i<numFiles; i++ ) {
-        processLogFile( logs[i] );
-        }
+    SimpleVector<char*> logs;
     
     for( int i=0; i<numFiles; i++ ) {
-        delete logs[i];
+        char *name = allLogs.getElementDirect( i );
+        
+        if( i >= startI ) {
+            logs.push_back( name );
+            }
+        else {
+            delete [] name;
+            }
+        }
+    
+    LogFileQuery *queries = new LogFileQuery[ logs.size() ];
+    
+    for( int i=0; i<logs.size(); i++ ) {
+        getFileDates( logs.getElementDirect( i ), &( queries[i] ) );
+        
+        queries[i].fileRecords = new FoodRecList;
+        queries[i].fileHourRecords = new FoodRecList;
         }
     
-    delete [] logs;
+    // sums each log on worker threads, then adds sums up in order
+    runLogQuery( inServerDir, inFolderName, FOOD_LOG, &logs, 0,
+                 sumLogTable, addLogTable, queries );
+    
+    for( int i=0; i<logs.size(); i++ ) {
+        // left for logs that couldn't be read
+        if( queries[i].fileRecords != NULL ) {
+            delete queries[i].fileRecords;
+            delete queries[i].fileHourRecords;
+            }
+        }
+    delete [] queries;
+    
+    logs.deallocateStringElements();
     }
 
 
@@ -375,33 +433,22 @@ int main( int inNumArgs, char **inArgs ) {
     if( mainDir.exists() && mainDir.isDirectory() &&
         objDir.exists() && objDir.isDirectory() ) {
 
-        int numChildFiles;
-        File **childFiles = mainDir.getChildFiles( &numChildFiles );
-        
-        for( int i=0; i<numChildFiles; i++ ) {
+        // foodLog, foodLog_server2, etc.
+        SimpleVector<char*> folders;
+        getLogFolders( path, FOOD_LOG, &folders );
         
-            if( childFiles[i]->isDirectory() ) {
-                
-                char *name = childFiles[i]->getFileName();
-                
-                if( strstr( name, "foodLog" ) == name ) {
-                    // file name starts with foodLog
-                    processFoodLogFolder( childFiles[i] );
-                    }
-                delete [] name;
-                }
-            
-            delete childFiles[i];
+        for( int i=0; i<folders.size(); i++ ) {
+            processFoodLogFolder( path, folders.getElementDirect( i ) );
             }
-        delete [] childFiles;
+        folders.deallocateStringElements();
 
         
 
-        sortRecList( &monthRecords );
-        sortRecList( &weekRecords );
-        sortRecList( &todayRecords );
-        sortRecList( &yesterdayRecords );
-        sortRecList( &hourRecords );
+        sortRecList( &( monthRecords.records ) );
+        sortRecList( &( weekRecords.records ) );
+        sortRecList( &( todayRecords.records ) );
+        sortRecList( &( yesterdayRecords.records ) );
+        sortRecList( &( hourRecords.records ) );
 
         FILE *outFile = fopen( outPath, "w" );
         
@@ -409,19 +456,19 @@ int main( int inNumArgs, char **inArgs ) {
         if( outFile != NULL ) {
             
             printTable( "Past Hour",
-                        &objDir, outFile, &hourRecords );
+                        &objDir, outFile, &( hourRecords.records ) );
             
             printTable( "Today (so far)",
-                        &objDir, outFile, &todayRecords );
+                        &objDir, outFile, &( todayRecords.records ) );
             
             printTable( "Yesterday",
-                        &objDir, outFile, &yesterdayRecords );
+                        &objDir, outFile, &( yesterdayRecords.records ) );
             
             printTable( "Past week",
-                        &objDir, outFile, &weekRecords );
+                        &objDir, outFile, &( weekRecords.records ) );
 
             printTable( "Past month",
-                        &objDir, outFile, &monthRecords );
+                        &objDir, outFile, &( monthRecords.records ) );
         
             fclose( outFile );
             }
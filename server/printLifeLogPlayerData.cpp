@@ -4,6 +4,9 @@
 #include "minorGems/io/file/File.h"
 #include "minorGems/util/stringUtils.h"
 
+#include "logQuery.h"
+#include "FlatHashTable.h"
+
 
 void usage() {
     printf( "Usage:\n" );
@@ -22,172 +25,141 @@ void usage() {
 
 // used to keep track of hours passing
 double startTime = 1262304000;
-double maxTime = startTime;
 
 int hoursPassed = 0;
-    
-SimpleVector<char *> uniqueEmails;
+
+
+// emails from all logs
+LogDictionary *allStrings;
+
+
+// emails seen since last hour record, as indices in allStrings
+SimpleVector<int> uniqueEmails;
+FlatHashTable<char> uniqueEmailSet( 1024, false );
 
 
 typedef struct HourRecord {
         double time;
         int uniquePlayers;
-        SimpleVector<char *> uniqueEmails;
     } HourRecord;
     
 
 SimpleVector<HourRecord> hourRecords;
 
+// index in hourRecords for each hour since startTime
+FlatHashTable<int> hourRecordIndex( 1024, -1 );
+
+// emails in each hour record, by record index and email
+FlatHashTable<char> hourRecordEmails( 4096, false );
+
         
 
 
 
-// destroyed internally
-void addEmail( char *inEmail, SimpleVector<char*> *inUniqueEmails ) {
-    for( int i=0; i< inUniqueEmails->size(); i++ ) {
-        if( strcmp( inEmail, inUniqueEmails->getElementDirect( i ) ) == 0 ) {
-            delete [] inEmail;
-            return;
-            }
+void addEmail( int inEmail ) {
+    char found;
+    uniqueEmailSet.lookup( inEmail, 0, 0, 0, &found );
+    
+    if( ! found ) {
+        uniqueEmailSet.insert( inEmail, 0, 0, 0, true );
+        uniqueEmails.push_back( inEmail );
         }
-    inUniqueEmails->push_back( inEmail );
     }
 
 
-void addHourRecord( double inTime, SimpleVector<char*> *inUniqueEmails ) {
-    for( int i=0; i<hourRecords.size(); i++ ) {
-        if( hourRecords.getElementDirect( i ).time == inTime ) {        
-            HourRecord *r = hourRecords.getElement( i );
-            
-            for( int j=0; j<inUniqueEmails->size(); j++ ) {
-                addEmail( inUniqueEmails->getElementDirect( j ),
-                          &( r->uniqueEmails ) );
-                }
-            inUniqueEmails->deleteAll();
-            return;
-            }
-        }
-    HourRecord r;
+void addHourRecord( int inHoursPassed ) {
+    char found;
+    int index = hourRecordIndex.lookup( inHoursPassed, 0, 0, 0, &found );
     
-    hourRecords.push_back( r );
-    
-    HourRecord *rPointer = hourRecords.getElement( hourRecords.size() - 1 );
+    if( ! found ) {
+        HourRecord r;
+        r.time = inHoursPassed * 3600 + startTime;
+        r.uniquePlayers = 0;
+        
+        hourRecords.push_back( r );
+        
+        index = hourRecords.size() - 1;
+        hourRecordIndex.insert( inHoursPassed, 0, 0, 0, index );
+        }
     
-    rPointer->time = inTime;
-    rPointer->uniqueEmails.push_back_other( inUniqueEmails );
+    HourRecord *r = hourRecords.getElement( index );
     
-    inUniqueEmails->deleteAll();
+    for( int j=0; j<uniqueEmails.size(); j++ ) {
+        int email = uniqueEmails.getElementDirect( j );
+        
+        hourRecordEmails.lookup( index, email, 0, 0, &found );
+        
+        if( ! found ) {
+            hourRecordEmails.insert( index, email, 0, 0, true );
+            r->uniquePlayers++;
+            }
+        uniqueEmailSet.remove( email, 0, 0, 0 );
+        }
+    uniqueEmails.deleteAll();
     }
 
 
 
-void processLogFile( File *inFile ) {
+// called in file order
+void processLogTable( LogTable *inTable, int inFileIndex, void *inData ) {
     hoursPassed = 0;
     
-    char *path = inFile->getFullFileName();
-
+    int *emailMap = mapLogTableStrings( inTable, allStrings );
     
-    FILE *f = fopen( path, "r" );
+    int *events = inTable->intColumns[ LIFE_EVENT ];
+    int *emails = inTable->intColumns[ LIFE_EMAIL ];
+    double *times = inTable->doubleColumns[ LIFE_TIME ];
     
-    if( f != NULL ) {
-        char scannedLine = true;
+    for( int r=0; r<inTable->numRows; r++ ) {
         
-        while( scannedLine ) {
+        if( events[r] == LIFE_BIRTH ) {
+            double deltaTime = times[r] - startTime;
             
-            char event = 'X';
-            double time = 0;
-            int id = 0;
-            char email[1000];
-            char gender = 'F';
-            double age = 0;
-            int locX, locY;
-            char parent[1000];
-            char deathReason[1000];
-        
-            email[0] = '\0';
-            parent[0] = '\0';
-            deathReason[0] = '\0';        
+            addEmail( emailMap[ emails[r] ] );
 
-            int pop = 0;
-            int parentChain = 1;
-        
-            fscanf( f, "%c ", &event );
-        
-        
-            if( event == 'B' ) {
-                fscanf( f, "%lf %d %999s %c (%d,%d) %999s pop=%d chain=%d\n",
-                        &time, &id, email, &gender, 
-                        &locX, &locY, parent, &pop, &parentChain );
+            if( floor( deltaTime / 3600 ) > hoursPassed ) {
+                hoursPassed = lrint( floor( deltaTime / 3600 ) );
                 
-                if( time > maxTime ) {
-                    maxTime = time;
-                    }
-                
-                double deltaTime = time - startTime;
-                
-                char *lowerEmail = stringToLowerCase( email );
-                
-                
-                addEmail( lowerEmail, &uniqueEmails );
-
-                if( floor( deltaTime / 3600 ) > hoursPassed ) {
-                    hoursPassed = lrint( floor( deltaTime / 3600 ) );
-                    
-                    double hourTime = hoursPassed * 3600 + startTime;
-                    
-                    addHourRecord( hourTime, &uniqueEmails );
-                    }
-                }
-            else if( event == 'D' ) {
-                fscanf( f, "%lf %d %999s age=%lf %c (%d,%d) %999s pop=%d\n",
-                        &time, &id, email, &age, &gender, &locX, &locY, 
-                        deathReason, &pop );            
-                }
-            else {
-                scannedLine = false;
+                addHourRecord( hoursPassed );
                 }
             }
-        
-
-        fclose( f );
         }
-    delete [] path;
+    
+    delete [] emailMap;
     }
 
 
 
-
-const char *checkpointFileName = "statsCheckpoint.txt";
-
-
-
 // returns num files processed
-int processLifeLogFolder( File *inFolder ) {        
+int processLifeLogFolder( char *inServerDir, char *inFolderName ) {        
         
-    int numFilesProcessed = 0;
-        
-    int numFiles;
+    SimpleVector<char*> logs;
+    
+    getLogFileNames( inServerDir, inFolderName, &logs );
+    
+    // loads logs on worker threads, and processes them here, in order
+    int numFilesProcessed =
+        runLogQuery( inServerDir, inFolderName, LIFE_LOG, &logs, 0,
+                     NULL, processLogTable, NULL );
+    
+    logs.deallocateStringElements();
 
-    File **logs = inFolder->getChildFilesSorted( &numFiles );
-        
-    for( int i=0; i<numFiles; i++ ) {
+    return numFilesProcessed;
+    }
 
-        char *name = logs[i]->getFileName();
-            
-        if( strcmp( name, checkpointFileName ) != 0 ) {
-            
-            processLogFile( logs[i] );
-                    
-            numFilesProcessed++;
-            }
-        
-        delete [] name;
 
-        delete logs[i];
-        }
-    delete [] logs;
 
-    return numFilesProcessed;
+int compareHourRecords( const void *inA, const void *inB ) {
+    HourRecord *a = (HourRecord*)inA;
+    HourRecord *b = (HourRecord*)inB;
+    
+    if( a->time < b->time ) {
+        return -1;
+        }
+    if( a->time > b->time ) {
+        return 1;
+        }
+    return 0;
     }
 
 
@@ -213,28 +185,19 @@ int main( int inNumArgs, char **inArgs ) {
     
     if( mainDir.exists() && mainDir.isDirectory() ) {
         
+        allStrings = newLogDictionary();
         
         int numFilesProcessed = 0;
         
-        int numChildFiles;
-        File **childFiles = mainDir.getChildFiles( &numChildFiles );
+        // lifeLog, lifeLog_server2, etc.
+        SimpleVector<char*> folders;
+        getLogFolders( path, LIFE_LOG, &folders );
         
-        for( int i=0; i<numChildFiles; i++ ) {
-        
-            if( childFiles[i]->isDirectory() ) {
-                
-                char *name = childFiles[i]->getFileName();
-                
-                if( strstr( name, "lifeLog" ) == name ) {
-                    // file name starts with lifeLog
-                    numFilesProcessed += processLifeLogFolder( childFiles[i] );
-                    }
-                delete [] name;
-                }
-            
-            delete childFiles[i];
+        for( int i=0; i<folders.size(); i++ ) {
+            numFilesProcessed += 
+                processLifeLogFolder( path, folders.getElementDirect( i ) );
             }
-        delete [] childFiles;
+        folders.deallocateStringElements();
         
 
         
@@ -249,33 +212,22 @@ int main( int inNumArgs, char **inArgs ) {
 
             int numRecords = hourRecords.size();
             
+            if( numRecords > 0 ) {
+                qsort( hourRecords.getElement( 0 ), numRecords,
+                       sizeof( HourRecord ), compareHourRecords );
+                }
+            
             for( int j=0; j<numRecords; j++ ) {
-                
-                int minI = -1;
-                double minTime = maxTime + 1;
-                
-                for( int i=0; i<hourRecords.size(); i++ ) {
-                    HourRecord *r = hourRecords.getElement( i );
-                    
-                    if( r->time < minTime ) {
-                        minTime = r->time;
-                        minI = i;
-                        }
-                    }
-                
-                HourRecord *r = hourRecords.getElement( minI );
-
-                
+                HourRecord *r = hourRecords.getElement( j );
 
                 fprintf( outFile, "%.0f %d\n",
-                         r->time, r->uniqueEmails.size() );
-                r->uniqueEmails.deallocateStringElements();
-
-                hourRecords.deleteElement( minI );
+                         r->time, r->uniquePlayers );
                 }
             
             fclose( outFile );
             }
+        
+        freeLogDictionary( allStrings );
         }
     else {
         usage();
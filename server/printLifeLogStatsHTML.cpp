@@ -4,6 +4,9 @@
 #include "minorGems/io/file/File.h"
 #include "minorGems/util/stringUtils.h"
 
+#include "logQuery.h"
+#include "FlatHashTable.h"
+
 
 void usage() {
     printf( "Usage:\n" );
@@ -25,15 +28,39 @@ typedef struct Living {
         double birthAge;
         int parentChainLength;
         double birthTime;
-        char *email;
+
+        // index in allStrings
+        int email;
+
+        // in birth order
+        Living *prev;
+        Living *next;
+
+        // earlier birth with same id and email that is still living
+        Living *prevSameKey;
+
+        // births with same id, in birth order
+        Living *prevSameID;
+        Living *nextSameID;
     } Living;
 
-    
-SimpleVector<Living> currentLiving;
+
+// oldest birth first
+Living *firstLiving = NULL;
+Living *lastLiving = NULL;
+
+// most recent living birth for each id and email
+FlatHashTable<Living*> livingByKey( 4096 );
+
+// oldest and most recent living births for each id
+FlatHashTable<Living*> firstLivingByID( 4096 );
+FlatHashTable<Living*> lastLivingByID( 4096 );
+
 
 
 typedef struct Player {
-        char *email;
+        // index in allStrings
+        int email;
         int gameCount;
         int gameTotalSeconds;
         double firstGameTime;
@@ -43,6 +70,13 @@ typedef struct Player {
 
 SimpleVector<Player> allPlayers;
 
+// index in allPlayers for each email
+FlatHashTable<int> playerIndexByEmail( 4096, -1 );
+
+
+// emails from all logs
+LogDictionary *allStrings;
+
         
 
 // stats
@@ -61,33 +95,33 @@ int folderOver55Count = 0;
 
 
 
-void addPlayerGame( char *inEmail, 
+void addPlayerGame( int inEmail, 
                     double inGameStartTime, double inGameEndTime ) {
 
     Player *thisPlayer;
-    char found = false;
+    char found;
     
-    for( int i=0; i < allPlayers.size(); i++ ) {
-        thisPlayer = allPlayers.getElement( i );
-        
-        if( strcmp( thisPlayer->email, inEmail ) == 0 ) {
-            found = true;
-            break;
-            }
-        }
+    int index = playerIndexByEmail.lookup( inEmail, 0, 0, 0, &found );
     
-    if( !found ) {    
+    if( found ) {
+        thisPlayer = allPlayers.getElement( index );
+        }
+    else {    
         // else add a new one
         Player newPlayer;
 
-        newPlayer.email = stringDuplicate( inEmail );
+        newPlayer.email = inEmail;
         newPlayer.gameCount = 0;
         newPlayer.gameTotalSeconds = 0;
         newPlayer.firstGameTime = inGameEndTime;
         
         allPlayers.push_back( newPlayer );
         
-        thisPlayer = allPlayers.getElement( allPlayers.size() - 1 );
+        index = allPlayers.size() - 1;
+        
+        playerIndexByEmail.insert( inEmail, 0, 0, 0, index );
+        
+        thisPlayer = allPlayers.getElement( index );
         }
     
     int gameSeconds = lrint( inGameEndTime - inGameStartTime );
@@ -100,138 +134,207 @@ void addPlayerGame( char *inEmail,
 
 
 
-void processLogFile( File *inFile ) {
+void addLiving( Living *inLiving ) {
+    inLiving->prev = lastLiving;
+    inLiving->next = NULL;
     
-    char *path = inFile->getFullFileName();
+    if( lastLiving != NULL ) {
+        lastLiving->next = inLiving;
+        }
+    else {
+        firstLiving = inLiving;
+        }
+    lastLiving = inLiving;
+    
+    char found;
+    
+    // NULL if not found
+    inLiving->prevSameKey = 
+        livingByKey.lookup( inLiving->id, inLiving->email, 0, 0, &found );
+    
+    livingByKey.insert( inLiving->id, inLiving->email, 0, 0, inLiving );
+    
+    inLiving->prevSameID = 
+        lastLivingByID.lookup( inLiving->id, 0, 0, 0, &found );
+    inLiving->nextSameID = NULL;
+    
+    if( found ) {
+        inLiving->prevSameID->nextSameID = inLiving;
+        }
+    else {
+        firstLivingByID.insert( inLiving->id, 0, 0, 0, inLiving );
+        }
+    lastLivingByID.insert( inLiving->id, 0, 0, 0, inLiving );
+    }
+
+
 
+// inLiving must be most recent birth with its id and email
+void removeLiving( Living *inLiving ) {
+    if( inLiving->prev != NULL ) {
+        inLiving->prev->next = inLiving->next;
+        }
+    else {
+        firstLiving = inLiving->next;
+        }
     
-    FILE *f = fopen( path, "r" );
+    if( inLiving->next != NULL ) {
+        inLiving->next->prev = inLiving->prev;
+        }
+    else {
+        lastLiving = inLiving->prev;
+        }
     
-    if( f != NULL ) {
-        char scannedLine = true;
-        
-        while( scannedLine ) {
-            
-            char event = 'X';
-            double time = 0;
-            int id = 0;
-            char email[1000];
-            char gender = 'F';
-            double age = 0;
-            int locX, locY;
-            char parent[1000];
-            char deathReason[1000];
-        
-            email[0] = '\0';
-            parent[0] = '\0';
-            deathReason[0] = '\0';        
+    if( inLiving->prevSameKey != NULL ) {
+        livingByKey.insert( inLiving->id, inLiving->email, 0, 0,
+                            inLiving->prevSameKey );
+        }
+    else {
+        livingByKey.remove( inLiving->id, inLiving->email, 0, 0 );
+        }
+    
+    if( inLiving->prevSameID != NULL ) {
+        inLiving->prevSameID->nextSameID = inLiving->nextSameID;
+        }
+    else if( inLiving->nextSameID != NULL ) {
+        firstLivingByID.insert( inLiving->id, 0, 0, 0, 
+                                inLiving->nextSameID );
+        }
+    else {
+        firstLivingByID.remove( inLiving->id, 0, 0, 0 );
+        }
+    
+    if( inLiving->nextSameID != NULL ) {
+        inLiving->nextSameID->prevSameID = inLiving->prevSameID;
+        }
+    else if( inLiving->prevSameID != NULL ) {
+        lastLivingByID.insert( inLiving->id, 0, 0, 0, 
+                               inLiving->prevSameID );
+        }
+    else {
+        lastLivingByID.remove( inLiving->id, 0, 0, 0 );
+        }
+    
+    delete inLiving;
+    }
 
-            int pop = 0;
-            int parentChain = 1;
-        
-            fscanf( f, "%c ", &event );
+
+
+typedef struct FolderQuery {
+        File *checkpointFile;
+        SimpleVector<char*> *fileNames;
+    } FolderQuery;
+
+
+void saveNewCheckpoint( File *inCheckpointFile,
+                        char *inLastScannedFileName );
+
+
+
+// called in file order
+void processLogTable( LogTable *inTable, int inFileIndex, void *inData ) {
+    
+    int *emailMap = mapLogTableStrings( inTable, allStrings );
+    
+    int *events = inTable->intColumns[ LIFE_EVENT ];
+    int *ids = inTable->intColumns[ LIFE_ID ];
+    int *emails = inTable->intColumns[ LIFE_EMAIL ];
+    int *parentIDs = inTable->intColumns[ LIFE_PARENT_ID ];
+    int *chains = inTable->intColumns[ LIFE_CHAIN ];
+    double *times = inTable->doubleColumns[ LIFE_TIME ];
+    double *ages = inTable->doubleColumns[ LIFE_AGE ];
+    
+    for( int r=0; r<inTable->numRows; r++ ) {
         
+        int id = ids[r];
+        int email = emailMap[ emails[r] ];
+        double time = times[r];
         
-            if( event == 'B' ) {
-                fscanf( f, "%lf %d %999s %c (%d,%d) %999s pop=%d chain=%d\n",
-                        &time, &id, email, &gender, 
-                        &locX, &locY, parent, &pop, &parentChain );
+        if( events[r] == LIFE_BIRTH ) {
             
-                Living l;
-                l.id = id;
+            Living *l = new Living;
+            l->id = id;
             
-                l.birthAge = 0;
-                l.parentChainLength = parentChain;
-
-                l.birthTime = time;
-                l.email = stringToLowerCase( email );
-
-                if( strcmp( parent, "noParent" ) == 0 ) {
-                    l.birthAge = 14;
-                    }
-                else if( l.parentChainLength == 1 ) {
-                    // parent chain length not recorded in log
-                    // (old-style record)
-                    
-                    // try recomputing it from scratch
-                    int parentID = 0;
-                
-                    sscanf( parent, "parent=%d,", &parentID );
-                
-                    for( int i=0; i<currentLiving.size(); i++ ) {
-                        Living lp = currentLiving.getElementDirect( i );
+            l->birthAge = 0;
+            l->parentChainLength = chains[r];
+            
+            l->birthTime = time;
+            l->email = email;
+            
+            if( parentIDs[r] == -1 ) {
+                // noParent
+                l->birthAge = 14;
+                }
+            else if( l->parentChainLength == 1 ) {
+                // parent chain length not recorded in log
+                // (old-style record)
                     
-                        if( lp.id == parentID ) {
-                            l.parentChainLength = lp.parentChainLength + 1;
-                            break;
-                            }
-                        }
-                    }
-                currentLiving.push_back( l );
-                totalLives ++;
-                folderTotalLives ++;
+                // try recomputing it from scratch
+                // oldest living birth with parent's ID
+                char found;
+                Living *lp = firstLivingByID.lookup( parentIDs[r], 0, 0, 0,
+                                                     &found );
                 
-                if( l.parentChainLength > longestFamilyChain ) {
-                    longestFamilyChain = l.parentChainLength;
-                    }
-                if( l.parentChainLength > folderLongestFamilyChain ) {
-                    folderLongestFamilyChain = l.parentChainLength;
+                if( found ) {
+                    l->parentChainLength = lp->parentChainLength + 1;
                     }
                 }
-            else if( event == 'D' ) {
-                fscanf( f, "%lf %d %999s age=%lf %c (%d,%d) %999s pop=%d\n",
-                        &time, &id, email, &age, &gender, &locX, &locY, 
-                        deathReason, &pop );            
+            addLiving( l );
+            totalLives ++;
+            folderTotalLives ++;
             
-                double yearsLived = age;
-                
-                char *lowerEmail = stringToLowerCase( email );
-
-                // walk backwards, finding most recent birth that matches
-                // thus, we don't consider orphaned births (from server crashes)
-                // by accident
-                char foundBirth = false;
-                for( int i=currentLiving.size() - 1; i>=0; i-- ) {
-                    Living l = currentLiving.getElementDirect( i );
-                    
-                    if( l.id == id && strcmp( l.email, lowerEmail ) == 0 ) {
-                        yearsLived -= l.birthAge;
-                        
-                        addPlayerGame( l.email, l.birthTime, time );
-
-                        delete [] l.email;
-                        currentLiving.deleteElement( i );
-                        foundBirth = true;
-                        break;
-                        }
-                    }
+            if( l->parentChainLength > longestFamilyChain ) {
+                longestFamilyChain = l->parentChainLength;
+                }
+            if( l->parentChainLength > folderLongestFamilyChain ) {
+                folderLongestFamilyChain = l->parentChainLength;
+                }
+            }
+        else if( events[r] == LIFE_DEATH ) {
+            double age = ages[r];
             
-                if( foundBirth ) {    
-                    totalAge += yearsLived;
-                    folderTotalAge += yearsLived;
-                    
-                    if( age >= 55 ) {
-                        over55Count++;
-                        folderOver55Count++;
-                        }
-                    }
-                else {
-                    printf( "Orphaned death that had no matching birth:  "
-                            "%.0f %d %s\n",
-                            time, id, lowerEmail );
-                    }
+            double yearsLived = age;
+            
+            // find most recent birth that matches
+            // thus, we don't consider orphaned births (from server crashes)
+            // by accident
+            char found;
+            Living *l = livingByKey.lookup( id, email, 0, 0, &found );
+            
+            if( found ) {
+                yearsLived -= l->birthAge;
+                
+                addPlayerGame( l->email, l->birthTime, time );
+                
+                removeLiving( l );
 
-                delete [] lowerEmail;
+                totalAge += yearsLived;
+                folderTotalAge += yearsLived;
+                
+                if( age >= 55 ) {
+                    over55Count++;
+                    folderOver55Count++;
+                    }
                 }
             else {
-                scannedLine = false;
+                printf( "Orphaned death that had no matching birth:  "
+                        "%.0f %d %s\n",
+                        time, id, getLogDictionaryString( allStrings, email ) );
                 }
             }
-        
-
-        fclose( f );
         }
-    delete [] path;
+    
+    delete [] emailMap;
+    
+    
+    FolderQuery *q = (FolderQuery *)inData;
+    
+    if( inFileIndex < q->fileNames->size() - 1 ) {
+        // last file may still be getting filled by server
+        saveNewCheckpoint( 
+            q->checkpointFile, 
+            q->fileNames->getElementDirect( inFileIndex ) );
+        }
     }
 
 
@@ -259,14 +362,20 @@ void saveNewCheckpoint( File *inCheckpointFile,
 
 
 // returns num files processed
-int processLifeLogFolder( File *inFolder ) {
+int processLifeLogFolder( char *inServerDir, char *inFolderName ) {
 
     folderTotalAge = 0;
     folderTotalLives = 0;
     folderLongestFamilyChain = 0;
     folderOver55Count = 0;
     
-    File *checkpointFile = inFolder->getChildFile( checkpointFileName );
+    char *folderPath = autoSprintf( "%s/%s", inServerDir, inFolderName );
+    
+    File folder( NULL, folderPath );
+    
+    delete [] folderPath;
+    
+    File *checkpointFile = folder.getChildFile( checkpointFileName );
         
     char lastScannedFileName[200];
     lastScannedFileName[0] = '\0';
@@ -298,68 +407,41 @@ int processLifeLogFolder( File *inFolder ) {
         
 
     char checkpointReached = false;
-        
-        
-    int numFilesProcessed = 0;
-        
-    int numFiles;
-
-    File **allFiles = inFolder->getChildFilesSorted( &numFiles );
-
-    // filter to have only log files
-    SimpleVector<File*> logs;
-
-    for( int i=0; i<numFiles; i++ ) {
-
-        char *name = allFiles[i]->getFileName();
-            
-        if( strcmp( name, checkpointFileName ) != 0 &&
-            strstr( name, "_names" ) == NULL ) {
-            // the checkpoint file or a _names log.
-            logs.push_back( allFiles[i] );
-            }
-        else {
-            delete allFiles[i];
-            }
-        delete [] name;
-        }
-
-    delete [] allFiles;
     
-    numFiles = logs.size();
+    // logs sorted by date, skipping _names logs and checkpoint file
+    SimpleVector<char*> allLogs;
     
-    for( int i=0; i<numFiles; i++ ) {
-        File *logFile = logs.getElementDirect( i );
-        
-        char *name = logFile->getFileName();
-            
+    getLogFileNames( inServerDir, inFolderName, &allLogs );
+    
+    // logs after checkpoint
+    SimpleVector<char*> logs;
+    
+    for( int i=0; i<allLogs.size(); i++ ) {
+        char *name = allLogs.getElementDirect( i );
             
         if( ! checkpointFound ||
             checkpointReached ) {
-                    
-            processLogFile( logFile );
-                    
-            if( i < numFiles - 1 ) {
-                // last file may still be getting filled by server
-                saveNewCheckpoint( checkpointFile, name );
-                }
-                    
-            numFilesProcessed++;
+            
+            logs.push_back( name );
             }
-        else if( checkpointFound && ! checkpointReached ) {
-                    
+        else {
             if( strcmp( name, lastScannedFileName ) == 0 ) {
                 // this is where we got on last scan
                 checkpointReached = true;
                 }
+            delete [] name;
             }
-               
-        
-        delete [] name;
-
-        delete logFile;
         }
     
+    
+    FolderQuery q = { checkpointFile, &logs };
+    
+    // loads logs on worker threads, and processes them here, in order
+    int numFilesProcessed =
+        runLogQuery( inServerDir, inFolderName, LIFE_LOG, &logs, 0,
+                     NULL, processLogTable, &q );
+    
+    logs.deallocateStringElements();
 
     delete checkpointFile;
 
@@ -434,28 +516,19 @@ int main( int inNumArgs, char **inArgs ) {
     
     if( mainDir.exists() && mainDir.isDirectory() ) {
         
+        allStrings = newLogDictionary();
         
         int numFilesProcessed = 0;
         
-        int numChildFiles;
-        File **childFiles = mainDir.getChildFiles( &numChildFiles );
+        // lifeLog, lifeLog_server2, etc.
+        SimpleVector<char*> folders;
+        getLogFolders( path, LIFE_LOG, &folders );
         
-        for( int i=0; i<numChildFiles; i++ ) {
-        
-            if( childFiles[i]->isDirectory() ) {
-                
-                char *name = childFiles[i]->getFileName();
-                
-                if( strstr( name, "lifeLog" ) == name ) {
-                    // file name starts with lifeLog
-                    numFilesProcessed += processLifeLogFolder( childFiles[i] );
-                    }
-                delete [] name;
-                }
-            
-            delete childFiles[i];
+        for( int i=0; i<folders.size(); i++ ) {
+            numFilesProcessed += 
+                processLifeLogFolder( path, folders.getElementDirect( i ) );
             }
-        delete [] childFiles;
+        folders.deallocateStringElements();
         
 
         
@@ -483,11 +556,14 @@ int main( int inNumArgs, char **inArgs ) {
             fclose( outFile );
             }
 
-        for( int i=0; i<currentLiving.size(); i++ ) {
-            Living l = currentLiving.getElementDirect( i );
+        while( firstLiving != NULL ) {
+            Living *l = firstLiving;
             printf( "Orphaned birth that had no matching death:  %.0f %d %s\n",
-                    l.birthTime, l.id, l.email );
-            delete [] l.email;
+                    l->birthTime, l->id, 
+                    getLogDictionaryString( allStrings, l->email ) );
+            
+            firstLiving = l->next;
+            delete l;
             }
         
 
@@ -506,11 +582,12 @@ int main( int inNumArgs, char **inArgs ) {
                 "review_score=-1, review_name='', review_text='', "
                 "review_date=CURRENT_TIMESTAMP, review_game_seconds=0, "
                 "review_game_count=0, review_votes=0;\n\n",
-                p.email, p.firstGameTime, p.lastGameTime, p.lastGameSeconds,
+                getLogDictionaryString( allStrings, p.email ), 
+                p.firstGameTime, p.lastGameTime, p.lastGameSeconds,
                 p.gameCount, p.gameTotalSeconds );
-
-            delete [] p.email;
             }
+        
+        freeLogDictionary( allStrings );
         }
     else {
         usage();
@@ -0,0 +1,195 @@
+#include "recentChunks.h"
+
+#include <string.h>
+
+
+#include "minorGems/util/SimpleVector.h"
+
+
+
+// whole compressed chunks kept
+#define NUM_RECENT_CHUNKS 16
+
+
+
+typedef struct RecentChunk {
+        int x, y, width, height;
+
+        char binary;
+
+        timeSec_t expiry;
+
+        // NULL if slot unused
+        unsigned char *compressedData;
+        int compressedSize;
+
+        int rawSize;
+    } RecentChunk;
+
+
+struct RecentChunkBuild {
+        int x, y, width, height;
+
+        char binary;
+
+        // a cell in area changed since build started
+        char stale;
+    };
+
+
+
+static RecentChunk recentChunks[ NUM_RECENT_CHUNKS ];
+
+// slot replaced by next chunk kept
+static int nextRecentChunk = 0;
+
+// builds started and not finished yet
+static SimpleVector<RecentChunkBuild*> activeBuilds;
+
+
+
+static void clearRecentChunk( int inIndex ) {
+    RecentChunk *r = &( recentChunks[ inIndex ] );
+
+    if( r->compressedData != NULL ) {
+        delete [] r->compressedData;
+        r->compressedData = NULL;
+        }
+    }
+
+
+
+static char inArea( int inX, int inY,
+                    int inAreaX, int inAreaY,
+                    int inAreaWidth, int inAreaHeight ) {
+    return
+        inX >= inAreaX && inX < inAreaX + inAreaWidth &&
+        inY >= inAreaY && inY < inAreaY + inAreaHeight;
+    }
+
+
+
+void initRecentChunks() {
+    for( int i=0; i<NUM_RECENT_CHUNKS; i++ ) {
+        recentChunks[i].compressedData = NULL;
+        }
+    nextRecentChunk = 0;
+    }
+
+
+
+void freeRecentChunks() {
+    for( int i=0; i<NUM_RECENT_CHUNKS; i++ ) {
+        clearRecentChunk( i );
+        }
+    nextRecentChunk = 0;
+    }
+
+
+
+void recentChunkCellChanged( int inX, int inY ) {
+    for( int i=0; i<NUM_RECENT_CHUNKS; i++ ) {
+        RecentChunk *r = &( recentChunks[i] );
+
+        if( r->compressedData != NULL &&
+            inArea( inX, inY, r->x, r->y, r->width, r->height ) ) {
+            clearRecentChunk( i );
+            }
+        }
+
+    for( int i=0; i<activeBuilds.size(); i++ ) {
+        RecentChunkBuild *b = activeBuilds.getElementDirect( i );
+
+        if( inArea( inX, inY, b->x, b->y, b->width, b->height ) ) {
+            b->stale = true;
+            }
+        }
+    }
+
+
+
+unsigned char *getRecentChunk( int inX, int inY, int inWidth, int inHeight,
+                               char inBinary, timeSec_t inCurTime,
+                               int *outCompressedSize, int *outRawSize,
+                               timeSec_t *outExpiry ) {
+
+    for( int i=0; i<NUM_RECENT_CHUNKS; i++ ) {
+        RecentChunk *r = &( recentChunks[i] );
+
+        if( r->compressedData != NULL &&
+            r->x == inX && r->y == inY &&
+            r->width == inWidth && r->height == inHeight &&
+            r->binary == inBinary ) {
+
+            if( r->expiry != 0 && inCurTime >= r->expiry ) {
+                clearRecentChunk( i );
+                return NULL;
+                }
+
+            // copy, because slot can be replaced before caller is done
+            unsigned char *data = new unsigned char[ r->compressedSize ];
+            memcpy( data, r->compressedData, r->compressedSize );
+
+            *outCompressedSize = r->compressedSize;
+            *outRawSize = r->rawSize;
+            *outExpiry = r->expiry;
+
+            return data;
+            }
+        }
+
+    return NULL;
+    }
+
+
+
+RecentChunkBuild *startRecentChunkBuild( int inX, int inY,
+                                         int inWidth, int inHeight,
+                                         char inBinary ) {
+    RecentChunkBuild *b = new RecentChunkBuild;
+
+    b->x = inX;
+    b->y = inY;
+    b->width = inWidth;
+    b->height = inHeight;
+    b->binary = inBinary;
+    b->stale = false;
+
+    activeBuilds.push_back( b );
+
+    return b;
+    }
+
+
+
+char finishRecentChunkBuild( RecentChunkBuild *inBuild,
+                             unsigned char *inCompressedData,
+                             int inCompressedSize, int inRawSize,
+                             timeSec_t inExpiry ) {
+
+    activeBuilds.deleteElementEqualTo( inBuild );
+
+    char stale = inBuild->stale;
+
+    if( ! stale ) {
+        clearRecentChunk( nextRecentChunk );
+
+        RecentChunk *r = &( recentChunks[ nextRecentChunk ] );
+
+        nextRecentChunk = ( nextRecentChunk + 1 ) % NUM_RECENT_CHUNKS;
+
+        r->x = inBuild->x;
+        r->y = inBuild->y;
+        r->width = inBuild->width;
+        r->height = inBuild->height;
+        r->binary = inBuild->binary;
+        r->expiry = inExpiry;
+        r->rawSize = inRawSize;
+        r->compressedData = inCompressedData;
+        r->compressedSize = inCompressedSize;
+        }
+
+    delete inBuild;
+
+    return ! stale;
+    }
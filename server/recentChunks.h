@@ -0,0 +1,62 @@
+
+
+// Whole compressed chunk messages, kept for repeated sends of the exact
+// same area (family members logging in near each other, everyone after a
+// restart)
+//
+// Cell data in a chunk doesn't depend on who it is sent to, only the
+// message header does, so a kept chunk can go to anyone asking for the
+// same area.
+//
+// A chunk is tracked as a build from before its first cell is read until
+// it is finished.  Reading cells can apply decays that change other cells,
+// even ones already read (an animal moving to a neighbor cell, say).  A
+// change to any cell in the area while it is being built keeps the
+// finished chunk from being kept.
+
+
+#include "minorGems/system/Time.h"
+
+
+
+void initRecentChunks();
+
+void freeRecentChunks();
+
+
+// call whenever anything stored for a cell changes, including decay times
+void recentChunkCellChanged( int inX, int inY );
+
+
+
+// returns copy of kept compressed cell data for area, or NULL if none
+// kept, or if it has expired by inCurTime
+//
+// result destroyed by caller
+unsigned char *getRecentChunk( int inX, int inY, int inWidth, int inHeight,
+                               char inBinary, timeSec_t inCurTime,
+                               int *outCompressedSize, int *outRawSize,
+                               timeSec_t *outExpiry );
+
+
+
+typedef struct RecentChunkBuild RecentChunkBuild;
+
+
+// call before first cell of area is read
+RecentChunkBuild *startRecentChunkBuild( int inX, int inY,
+                                         int inWidth, int inHeight,
+                                         char inBinary );
+
+
+// inExpiry is time when some decay in area is due, or 0 if none
+//
+// returns true if chunk is kept, taking ownership of inCompressedData
+// returns false if a cell changed during build, and then caller still
+// owns inCompressedData
+//
+// build is destroyed
+char finishRecentChunkBuild( RecentChunkBuild *inBuild,
+                             unsigned char *inCompressedData,
+                             int inCompressedSize, int inRawSize,
+                             timeSec_t inExpiry );
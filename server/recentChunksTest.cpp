@@ -0,0 +1,140 @@
+// Checks which chunks recentChunks keeps, including ones where a cell
+// changes while the chunk is being built
+
+#include <stdio.h>
+#include <string.h>
+
+#include "recentChunks.h"
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inName ) {
+    printf( "%s:  %s\n", inName, inPassed ? "passed" : "FAILED" );
+
+    if( ! inPassed ) {
+        numFailed++;
+        }
+    }
+
+
+
+static unsigned char *makeData( int inSize ) {
+    unsigned char *data = new unsigned char[ inSize ];
+    
+    for( int i=0; i<inSize; i++ ) {
+        data[i] = (unsigned char)i;
+        }
+    return data;
+    }
+
+
+
+// builds a 10x10 chunk at inX,inY, with cell inChangeX,inChangeY changed
+// after build starts, if inChange set
+// returns true if chunk kept
+static char build( int inX, int inY, timeSec_t inExpiry,
+                   char inChange, int inChangeX, int inChangeY ) {
+    RecentChunkBuild *b = startRecentChunkBuild( inX, inY, 10, 10, false );
+    
+    if( inChange ) {
+        recentChunkCellChanged( inChangeX, inChangeY );
+        }
+    
+    unsigned char *data = makeData( 50 );
+    
+    char kept = finishRecentChunkBuild( b, data, 50, 400, inExpiry );
+    
+    if( ! kept ) {
+        delete [] data;
+        }
+    return kept;
+    }
+
+
+
+static char isKept( int inX, int inY, timeSec_t inCurTime ) {
+    int compressedSize, rawSize;
+    timeSec_t expiry;
+    
+    unsigned char *data = getRecentChunk( inX, inY, 10, 10, false, inCurTime,
+                                          &compressedSize, &rawSize, 
+                                          &expiry );
+    if( data == NULL ) {
+        return false;
+        }
+    
+    unsigned char *expected = makeData( 50 );
+    
+    char same = 
+        compressedSize == 50 && rawSize == 400 &&
+        memcmp( data, expected, 50 ) == 0;
+
+    delete [] expected;
+    delete [] data;
+    
+    return same;
+    }
+
+
+
+int main() {
+    initRecentChunks();
+    
+    check( build( 0, 0, 0, false, 0, 0 ) && isKept( 0, 0, 100 ),
+           "unchanged build kept" );
+    
+    check( isKept( 0, 0, 100 ) && ! isKept( 5, 5, 100 ),
+           "only same area found" );
+    
+    recentChunkCellChanged( 3, 4 );
+    check( ! isKept( 0, 0, 100 ), "change after build clears chunk" );
+    
+
+    // decay applied while reading a later cell moves something into
+    // a cell that was already read
+    check( ! build( 20, 0, 0, true, 20, 0 ), 
+           "change to earlier cell during build not kept" );
+    check( ! isKept( 20, 0, 100 ), "changed build not found" );
+    
+    check( build( 40, 0, 0, true, 60, 0 ) && isKept( 40, 0, 100 ),
+           "change outside area during build kept" );
+    
+
+    // two overlapping builds in flight, change hits only the first
+    RecentChunkBuild *b1 = startRecentChunkBuild( 0, 20, 10, 10, false );
+    RecentChunkBuild *b2 = startRecentChunkBuild( 5, 20, 10, 10, false );
+    recentChunkCellChanged( 2, 25 );
+    
+    unsigned char *d1 = makeData( 50 );
+    unsigned char *d2 = makeData( 50 );
+    
+    char kept1 = finishRecentChunkBuild( b1, d1, 50, 400, 0 );
+    char kept2 = finishRecentChunkBuild( b2, d2, 50, 400, 0 );
+    
+    if( ! kept1 ) {
+        delete [] d1;
+        }
+    if( ! kept2 ) {
+        delete [] d2;
+        }
+    check( ! kept1 && kept2, "change only marks builds covering cell" );
+    
+
+    check( build( 60, 0, 200, false, 0, 0 ) && isKept( 60, 0, 199 ),
+           "kept before expiry" );
+    check( ! isKept( 60, 0, 200 ), "expired chunk not found" );
+    
+    
+    // rebuilding area after change keeps it again
+    check( build( 20, 0, 0, false, 0, 0 ) && isKept( 20, 0, 100 ),
+           "rebuild of changed area kept" );
+    
+    freeRecentChunks();
+    
+    printf( "%d checks failed\n", numFailed );
+    
+    return numFailed;
+    }
@@ -1,2 +1 @@
-./makeLogRotator
-nohup catchsegv unbuffer ./OneLifeServer | ./logRotator 20000000 serverOut.txt >/dev/null &
\ No newline at end of file
+nohup catchsegv ./OneLifeServer >>serverCrash.txt 2>&1 &
\ No newline at end of file
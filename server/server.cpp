@@ -11,8 +11,6 @@
 #include "minorGems/util/SettingsManager.h"
 #include "minorGems/util/SimpleVector.h"
 #include "minorGems/network/SocketServer.h"
-#include "minorGems/network/SocketPoll.h"
-#include "minorGems/network/web/WebRequest.h"
 #include "minorGems/network/web/URLUtils.h"
 
 #include "minorGems/crypto/hashes/sha1.h"
@@ -48,6 +46,18 @@
 #include "names.h"
 #include "curses.h"
 #include "lineageLimit.h"
+#include "socketEvents.h"
+#include "SpatialGrid.h"
+#include "heatField.h"
+#include "tickProfiler.h"
+#include "serverClock.h"
+#include "sessionReplay.h"
+#include "asyncWeb.h"
+#include "settingsCache.h"
+#include "asyncLog.h"
+
+#include "../commonSource/binaryProtocol.h"
+#include "../commonSource/streamCompression.h"
 
 
 #include "minorGems/util/random/JenkinsRandomSource.h"
@@ -107,7 +117,7 @@ char postApocalypseStarted = false;
 
 double remoteApocalypseCheckInterval = 30;
 double lastRemoteApocalypseCheckTime = 0;
-WebRequest *apocalypseRequest = NULL;
+AsyncWebRequest *apocalypseRequest = NULL;
 
 
 
@@ -135,6 +145,9 @@ static unsigned int nextSequenceNumber = 1;
 
 static int requireClientPassword = 1;
 static int requireTicketServerCheck = 1;
+
+// true when clients come from a session recording, see sessionReplay.h
+static char replayingSession = false;
 static char *clientPassword = NULL;
 static char *ticketServerURL = NULL;
 static char *reflectorURL = NULL;
@@ -177,9 +190,7 @@ typedef struct FreshConnection {
         unsigned int sequenceNumber;
         char *sequenceNumberString;
         
-        WebRequest *ticketServerRequest;
-
-        double ticketServerRequestStartTime;
+        AsyncWebRequest *ticketServerRequest;
         
         char error;
         const char *errorCauseString;
@@ -198,6 +209,13 @@ typedef struct FreshConnection {
         char *twinCode;
         int twinCount;
 
+        // true if client asked for binary protocol in LOGIN
+        char binaryProtocol;
+
+        // true if client asked for stream compression in LOGIN
+        // see streamCompression.h
+        char streamCompression;
+
     } FreshConnection;
 
 
@@ -207,6 +225,13 @@ SimpleVector<FreshConnection> waitingForTwinConnections;
 
 
 
+// area of map sent in one MC message
+typedef struct ChunkRect {
+        int x, y, width, height;
+    } ChunkRect;
+
+
+
 typedef struct LiveObject {
         char *email;
         
@@ -300,6 +325,11 @@ typedef struct LiveObject {
         int lastSentMapX;
         int lastSentMapY;
         
+        // chunk messages started ahead of send loop, see startMapChunkJobs
+        int numPendingChunkJobs;
+        ChunkMessageJob *pendingChunkJobs[2];
+        ChunkRect pendingChunkRects[2];
+        
         double moveTotalSeconds;
         double moveStartTime;
         
@@ -387,6 +417,10 @@ typedef struct LiveObject {
         
         char connected;
         
+        // true if client on this connection uses binary protocol
+        // for MC, MX, and PU, see binaryProtocol.h
+        char binaryProtocol;
+        
         char error;
         const char *errorCauseString;
         
@@ -410,6 +444,11 @@ typedef struct LiveObject {
         // their local temp
         float heatMap[ HEAT_MAP_D * HEAT_MAP_D ];
 
+        // where heat map was last centered, and heat field stamp of
+        // its area then, to tell when it needs to be recomputed
+        GridPos heatMapCenter;
+        unsigned int heatFieldStamp;
+
         // net heat of environment around player
         // map is tracked in heat units (each object produces an 
         // integer amount of heat)
@@ -781,7 +820,7 @@ static SimpleVector<DeadlyMapSpot> deadlyMapSpots;
 
 
 static char wasRecentlyDeadly( GridPos inPos ) {
-    double curTime = Time::getCurrentTime();
+    double curTime = getServerTime();
     
     for( int i=0; i<deadlyMapSpots.size(); i++ ) {
         
@@ -807,7 +846,7 @@ static void addDeadlyMapSpot( GridPos inPos ) {
     // don't check for duplicates
     // we're only called to add a new deadly spot when the spot isn't
     // currently on deadly cooldown anyway
-    DeadlyMapSpot s = { inPos, Time::getCurrentTime() };
+    DeadlyMapSpot s = { inPos, getServerTime() };
     deadlyMapSpots.push_back( s );
     }
 
@@ -992,7 +1031,7 @@ void clearPlayerHeldContained( LiveObject *inPlayer ) {
 
 void transferHeldContainedToMap( LiveObject *inPlayer, int inX, int inY ) {
     if( inPlayer->numContained != 0 ) {
-        timeSec_t curTime = Time::timeSec();
+        timeSec_t curTime = getServerTimeSec();
         float stretch = 
             getObject( inPlayer->holdingID )->slotTimeStretch;
         
@@ -1278,6 +1317,10 @@ void quitCleanup() {
     
     freeCurses();
     
+    // writes out what is queued for lifeLog and others, so they can
+    // close their files
+    freeAsyncLog();
+    
     freeLifeLog();
     
     freeFoodLog();
@@ -1287,6 +1330,21 @@ void quitCleanup() {
 
     freeMap();
 
+    // after freeMap, which stops backups of map DBs
+    freeBackup();
+    
+    // fails web requests still out, so they can be deleted after
+    freeAsyncWeb();
+    
+    freeSocketEvents();
+    
+    freeTickProfiler();
+    
+    freeSessionRecording();
+    freeSessionReplay();
+    
+    freeSettingsCache();
+
     freeTransBank();
     freeCategoryBank();
     freeObjectBank();
@@ -1377,6 +1435,7 @@ char readSocketFull( Socket *inSock, SimpleVector<char> *inBuffer ) {
     int numRead = inSock->receive( (unsigned char*)buffer, 512, 0 );
     
     if( numRead == -1 ) {
+        recordSessionClose( inSock );
 
         if( ! inSock->isSocketInFDRange() ) {
             // the internal FD of this socket is out of range
@@ -1384,11 +1443,11 @@ char readSocketFull( Socket *inSock, SimpleVector<char> *inBuffer ) {
 
             // save a bug report
             int allow = 
-                SettingsManager::getIntSetting( "allowBugReports", 0 );
+                getCachedIntSetting( "allowBugReports", 0 );
 
             if( allow ) {
                 char *bugName = 
-                    autoSprintf( "bug_socket_%f", Time::getCurrentTime() );
+                    autoSprintf( "bug_socket_%f", getServerTime() );
                 
                 char *bugOutName = autoSprintf( "%s_out.txt", bugName );
                 
@@ -1410,6 +1469,8 @@ char readSocketFull( Socket *inSock, SimpleVector<char> *inBuffer ) {
     
     while( numRead > 0 ) {
         inBuffer->appendArray( buffer, numRead );
+        addProfileCount( PROFILE_BYTES_RECEIVED, numRead );
+        recordSessionData( inSock, (unsigned char*)buffer, numRead );
 
         numRead = inSock->receive( (unsigned char*)buffer, 512, 0 );
         }
@@ -1923,7 +1984,7 @@ ClientMessage parseMessage( LiveObject *inPlayer, char *inMessage ) {
 int computePartialMovePathStep( LiveObject *inPlayer ) {
     
     double fractionDone = 
-        ( Time::getCurrentTime() - 
+        ( getServerTime() - 
           inPlayer->moveStartTime )
         / inPlayer->moveTotalSeconds;
     
@@ -1997,7 +2058,7 @@ void forcePlayerAge( const char *inEmail, double inAge ) {
         if( strcmp( o->email, inEmail ) == 0 ) {
             double ageSec = inAge / getAgeRate();
             
-            o->lifeStartTimeSeconds = Time::getCurrentTime() - ageSec;
+            o->lifeStartTimeSeconds = getServerTime() - ageSec;
             o->needsUpdate = true;
             }
         }
@@ -2076,7 +2137,7 @@ void handleShutdownDeath( LiveObject *inPlayer,
 double computeAge( double inLifeStartTimeSeconds ) {
     
     double deltaSeconds = 
-        Time::getCurrentTime() - inLifeStartTimeSeconds;
+        getServerTime() - inLifeStartTimeSeconds;
     
     double age = deltaSeconds * getAgeRate();
     
@@ -2112,7 +2173,7 @@ int getSayLimit( LiveObject *inPlayer ) {
 
 int getSecondsPlayed( LiveObject *inPlayer ) {
     double deltaSeconds = 
-        Time::getCurrentTime() - inPlayer->trueStartTimeSeconds;
+        getServerTime() - inPlayer->trueStartTimeSeconds;
 
     return lrint( deltaSeconds );
     }
@@ -2473,20 +2534,8 @@ static float computeHeldHeat( LiveObject *inPlayer ) {
 
 
 
-static void recomputeHeatMap( LiveObject *inPlayer ) {
-    
-    int gridSize = HEAT_MAP_D * HEAT_MAP_D;
-
-    // what if we recompute it from scratch every time?
-    for( int i=0; i<gridSize; i++ ) {
-        inPlayer->heatMap[i] = 0;
-        }
-
-    float heatOutputGrid[ HEAT_MAP_D * HEAT_MAP_D ];
-    float rGrid[ HEAT_MAP_D * HEAT_MAP_D ];
-    float rFloorGrid[ HEAT_MAP_D * HEAT_MAP_D ];
-
-
+// heat map is centered here
+static GridPos getHeatMapCenter( LiveObject *inPlayer ) {
     GridPos pos = getPlayerPos( inPlayer );
 
 
@@ -2499,101 +2548,52 @@ static void recomputeHeatMap( LiveObject *inPlayer ) {
             }
         } 
 
-    
-    
+    return pos;
+    }
 
-    for( int y=0; y<HEAT_MAP_D; y++ ) {
-        int mapY = pos.y + y - HEAT_MAP_D / 2;
-                
-        for( int x=0; x<HEAT_MAP_D; x++ ) {
-                    
-            int mapX = pos.x + x - HEAT_MAP_D / 2;
-                    
-            int j = y * HEAT_MAP_D + x;
-            heatOutputGrid[j] = 0;
-            rGrid[j] = rAir;
-            rFloorGrid[j] = rAir;
 
 
-            // call Raw version for better performance
-            // we don't care if object decayed since we last looked at it
-            ObjectRecord *o = getObject( getMapObjectRaw( mapX, mapY ) );
-                    
-                    
-                    
+// heat map padded by one cell on each side
+#define HEAT_PAD_D ( HEAT_MAP_D + 2 )
 
-            if( o != NULL ) {
-                heatOutputGrid[j] += o->heatValue;
-                if( o->permanent ) {
-                    // loose objects sitting on ground don't
-                    // contribute to r-value (like dropped clothing)
-                    rGrid[j] = rCombine( rGrid[j], o->rValue );
-                    }
 
+// radiant heat from each heat map cell is scaled by its distance from
+// player at center
+static float radiantHeatWeights[ HEAT_MAP_D * HEAT_MAP_D ];
+static char radiantHeatWeightsReady = false;
 
-                // skip checking for heat-producing contained items
-                // for now.  Consumes too many server-side resources
-                // can still check for heat produced by stuff in
-                // held container (below).
-                        
-                if( false && o->numSlots > 0 ) {
-                    // contained can produce heat shielded by container
-                    // r value
-                    double oRFactor = 1 - o->rValue;
-                            
-                    int numCont;
-                    int *cont = getContained( mapX, mapY, &numCont );
-                            
-                    if( cont != NULL ) {
-                                
-                        for( int c=0; c<numCont; c++ ) {
-                                    
-                            int cID = cont[c];
-                            char hasSub = false;
-                            if( cID < 0 ) {
-                                hasSub = true;
-                                cID = -cID;
-                                }
 
-                            ObjectRecord *cO = getObject( cID );
-                            heatOutputGrid[j] += 
-                                cO->heatValue * oRFactor;
-                                    
-                            if( hasSub ) {
-                                double cRFactor = 1 - cO->rValue;
-                                        
-                                int numSub;
-                                int *sub = getContained( mapX, mapY, 
-                                                         &numSub, 
-                                                         c + 1 );
-                                if( sub != NULL ) {
-                                    for( int s=0; s<numSub; s++ ) {
-                                        ObjectRecord *sO = 
-                                            getObject( sub[s] );
-                                                
-                                        heatOutputGrid[j] += 
-                                            sO->heatValue * 
-                                            cRFactor * 
-                                            oRFactor;
-                                        }
-                                    delete [] sub;
-                                    }
-                                }
-                            }
-                        delete [] cont;
-                        }
-                    }
-                }
-                    
 
-            // floor can insulate or produce heat too
-            ObjectRecord *fO = getObject( getMapFloor( mapX, mapY ) );
-                    
-            if( fO != NULL ) {
-                heatOutputGrid[j] += fO->heatValue;
-                rFloorGrid[j] = rCombine( rFloorGrid[j], fO->rValue );
-                }
-            }
+static void recomputeHeatMap( LiveObject *inPlayer ) {
+    
+    int gridSize = HEAT_MAP_D * HEAT_MAP_D;
+
+    // what if we recompute it from scratch every time?
+    for( int i=0; i<gridSize; i++ ) {
+        inPlayer->heatMap[i] = 0;
+        }
+
+    float heatOutputGrid[ HEAT_MAP_D * HEAT_MAP_D ];
+    float rGrid[ HEAT_MAP_D * HEAT_MAP_D ];
+    float rFloorGrid[ HEAT_MAP_D * HEAT_MAP_D ];
+
+
+    GridPos pos = getHeatMapCenter( inPlayer );
+    
+
+    // shared heat field only reads cells from map again after they
+    // change
+    HeatFieldCell cells[ HEAT_MAP_D * HEAT_MAP_D ];
+
+    inPlayer->heatFieldStamp = 
+        getHeatFieldCells( pos.x - HEAT_MAP_D / 2, pos.y - HEAT_MAP_D / 2,
+                           HEAT_MAP_D, HEAT_MAP_D, cells );
+    inPlayer->heatMapCenter = pos;
+    
+    for( int j=0; j<gridSize; j++ ) {
+        heatOutputGrid[j] = cells[j].heatOutput;
+        rGrid[j] = rCombine( rAir, cells[j].objectR );
+        rFloorGrid[j] = rCombine( rAir, cells[j].floorR );
         }
 
 
@@ -2687,90 +2687,120 @@ static void recomputeHeatMap( LiveObject *inPlayer ) {
         airSpaceGrid[ playerMapIndex ] = false;
         }
 
-    int numInAirspace = 0;
-    for( int i=0; i<gridSize; i++ ) {
-        if( airSpaceGrid[ i ] ) {
-            numInAirspace++;
+    // copy into grids padded with air outside of airspace, so that
+    // neighbors can be summed without bounds checks, in loops that
+    // the compiler can vectorize
+    float padR[ HEAT_PAD_D * HEAT_PAD_D ];
+    float padOutside[ HEAT_PAD_D * HEAT_PAD_D ];
+    
+    for( int p=0; p<HEAT_PAD_D * HEAT_PAD_D; p++ ) {
+        // boundary off edge is air
+        padR[p] = rAir;
+        padOutside[p] = 1;
+        }
+    
+    for( int y=0; y<HEAT_MAP_D; y++ ) {
+        for( int x=0; x<HEAT_MAP_D; x++ ) {
+            int i = y * HEAT_MAP_D + x;
+            int p = ( y + 1 ) * HEAT_PAD_D + x + 1;
+            
+            padR[p] = rGrid[i];
+            padOutside[p] = airSpaceGrid[i] ? 0 : 1;
             }
         }
     
+    int padOffsets[8];
+    for( int n=0; n<numNeighbors; n++ ) {
+        padOffsets[n] = ndy[n] * HEAT_PAD_D + ndx[n];
+        }
     
-    float rBoundarySum = 0;
-    int rBoundarySize = 0;
+
+    // r-values of each cell's neighbors outside of airspace, and how
+    // many of them there are
+    float boundaryRGrid[ HEAT_MAP_D * HEAT_MAP_D ];
+    float boundaryCountGrid[ HEAT_MAP_D * HEAT_MAP_D ];
     
-    for( int i=0; i<gridSize; i++ ) {
-        if( airSpaceGrid[i] ) {
+    for( int y=0; y<HEAT_MAP_D; y++ ) {
+        for( int x=0; x<HEAT_MAP_D; x++ ) {
+            int i = y * HEAT_MAP_D + x;
+            int p = ( y + 1 ) * HEAT_PAD_D + x + 1;
             
-            int x = i % HEAT_MAP_D;
-            int y = i / HEAT_MAP_D;
+            float r = 0;
+            float count = 0;
             
             for( int n=0; n<numNeighbors; n++ ) {
-                        
-                int nx = x + ndx[n];
-                int ny = y + ndy[n];
+                int q = p + padOffsets[n];
                 
-                if( nx >= 0 && nx < HEAT_MAP_D &&
-                    ny >= 0 && ny < HEAT_MAP_D ) {
-                    
-                    int nj = ny * HEAT_MAP_D + nx;
-                    
-                    if( ! airSpaceGrid[ nj ] ) {
-                        
-                        // boundary!
-                        rBoundarySum += rGrid[ nj ];
-                        rBoundarySize ++;
-                        }
-                    }
-                else {
-                    // boundary is off edge
-                    // assume air R-value
-                    rBoundarySum += rAir;
-                    rBoundarySize ++;
-                    }
+                r += padOutside[q] * padR[q];
+                count += padOutside[q];
                 }
+            
+            boundaryRGrid[i] = r;
+            boundaryCountGrid[i] = count;
             }
         }
 
-    
-    // floor counts as boundary too
-    // 4x its effect (seems more important than one of 8 walls
-    
-    // count non-air floor tiles while we're at it
-    int numFloorTilesInAirspace = 0;
 
-    if( numInAirspace > 0 ) {
+    if( ! radiantHeatWeightsReady ) {
+        GridPos playerHeatMapPos = { playerMapIndex % HEAT_MAP_D, 
+                                     playerMapIndex / HEAT_MAP_D };
+        
         for( int i=0; i<gridSize; i++ ) {
-            if( airSpaceGrid[i] ) {
-                rBoundarySum += 4 * rFloorGrid[i];
-                rBoundarySize += 4;
-                
-                if( rFloorGrid[i] > rAir ) {
-                    numFloorTilesInAirspace++;
-                    }
-                }
+            GridPos heatPos = { i % HEAT_MAP_D, i / HEAT_MAP_D };
+            
+            double d = distance( playerHeatMapPos, heatPos );
+            
+            // avoid infinite heat when player standing on source
+            radiantHeatWeights[i] = 1.0 / ( 1.5 * d + 1 );
             }
+        radiantHeatWeightsReady = true;
         }
     
 
-
-    float rBoundaryAverage = rAir;
-    
-    if( rBoundarySize > 0 ) {
-        rBoundaryAverage = rBoundarySum / rBoundarySize;
-        }
-
+    int numInAirspace = 0;
     
+    float rBoundarySum = 0;
+    int rBoundarySize = 0;
     
-
-
+    // count non-air floor tiles while we're at it
+    int numFloorTilesInAirspace = 0;
 
     float airSpaceHeatSum = 0;
+
+    float radiantAirSpaceHeatVal = 0;
     
     for( int i=0; i<gridSize; i++ ) {
         if( airSpaceGrid[i] ) {
+            numInAirspace++;
+            
+            rBoundarySum += boundaryRGrid[i];
+            rBoundarySize += (int)boundaryCountGrid[i];
+            
+            // floor counts as boundary too
+            // 4x its effect (seems more important than one of 8 walls
+            rBoundarySum += 4 * rFloorGrid[i];
+            rBoundarySize += 4;
+            
+            if( rFloorGrid[i] > rAir ) {
+                numFloorTilesInAirspace++;
+                }
+            
             airSpaceHeatSum += heatOutputGrid[i];
+            
+            if( heatOutputGrid[i] > 0 ) {
+                radiantAirSpaceHeatVal += 
+                    heatOutputGrid[i] * radiantHeatWeights[i];
+                }
             }
         }
+    
+
+
+    float rBoundaryAverage = rAir;
+    
+    if( rBoundarySize > 0 ) {
+        rBoundaryAverage = rBoundarySum / rBoundarySize;
+        }
 
 
     float airSpaceHeatVal = 0;
@@ -2784,33 +2814,6 @@ static void recomputeHeatMap( LiveObject *inPlayer ) {
     
 
 
-    float radiantAirSpaceHeatVal = 0;
-
-    GridPos playerHeatMapPos = { playerMapIndex % HEAT_MAP_D, 
-                                 playerMapIndex / HEAT_MAP_D };
-    
-
-    int numRadiantHeatSources = 0;
-    
-    for( int i=0; i<gridSize; i++ ) {
-        if( airSpaceGrid[i] && heatOutputGrid[i] > 0 ) {
-            
-            int x = i % HEAT_MAP_D;
-            int y = i / HEAT_MAP_D;
-            
-            GridPos heatPos = { x, y };
-            
-
-            double d = distance( playerHeatMapPos, heatPos );
-            
-            // avoid infinite heat when player standing on source
-
-            radiantAirSpaceHeatVal += heatOutputGrid[ i ] / ( 1.5 * d + 1 );
-            numRadiantHeatSources ++;
-            }
-        }
-    
-
     float biomeHeatWeight = 1;
     float radiantHeatWeight = 1;
     
@@ -2875,7 +2878,7 @@ MoveRecord getMoveRecord( LiveObject *inPlayer,
     
     // p_id xs ys xd yd fraction_done eta_sec
     
-    double deltaSec = Time::getCurrentTime() - inPlayer->moveStartTime;
+    double deltaSec = getServerTime() - inPlayer->moveStartTime;
     
     double etaSec = inPlayer->moveTotalSeconds - deltaSec;
     
@@ -3094,14 +3097,103 @@ static char equal( GridPos inA, GridPos inB ) {
 
 
 
-// returns (0,0) if no player found
-GridPos getClosestPlayerPos( int inX, int inY ) {
-    GridPos c = { inX, inY };
+// live players by map area, for position queries made while players
+// can't move, join, or leave
+//
+// only valid between buildPlayerGrid and clearPlayerGrid, and queries
+// fall back on looking at every player otherwise
+static SpatialGrid playerGrid;
+static char playerGridValid = false;
+
+// reused for results of playerGrid queries
+static SimpleVector<int> playerGridResults;
+
+
+// each player is filed under every spot they might be found at until
+// their current move ends
+static void buildPlayerGrid() {
+    playerGrid.clear();
+    
+    for( int i=0; i<players.size(); i++ ) {
+        LiveObject *o = players.getElement( i );
+        if( o->error ) {
+            continue;
+            }
+        
+        int minX = o->xs;
+        int maxX = o->xs;
+        int minY = o->ys;
+        int maxY = o->ys;
+        
+        if( o->xd < minX ) minX = o->xd;
+        if( o->xd > maxX ) maxX = o->xd;
+        if( o->yd < minY ) minY = o->yd;
+        if( o->yd > maxY ) maxY = o->yd;
+        
+        if( o->xs != o->xd || o->ys != o->yd ) {
+            for( int p=0; p<o->pathLength; p++ ) {
+                GridPos pos = o->pathToDest[p];
+                
+                if( pos.x < minX ) minX = pos.x;
+                if( pos.x > maxX ) maxX = pos.x;
+                if( pos.y < minY ) minY = pos.y;
+                if( pos.y > maxY ) maxY = pos.y;
+                }
+            }
+        
+        playerGrid.addRect( i, minX, minY, maxX, maxY );
+        }
     
+    playerGridValid = true;
+    }
+
+
+
+static void clearPlayerGrid() {
+    playerGridValid = false;
+    playerGrid.clear();
+    }
+
+
+
+// indices of players that might be within inRadius of inX,inY, or
+// NULL if player grid isn't valid now
+static SimpleVector<int> *getPlayerGridNearby( int inX, int inY, 
+                                               int inRadius ) {
+    if( ! playerGridValid ) {
+        return NULL;
+        }
+    playerGrid.getNearby( inX, inY, inRadius, &playerGridResults );
+    
+    return &playerGridResults;
+    }
+
+
+
+// how far around a spot the player grid is searched for the closest
+// player before giving up and looking at everyone
+#define CLOSEST_PLAYER_GRID_RADIUS 64
+
+
+// considers players at inIndices, or all players if NULL
+static void findClosestPlayer( GridPos inPos, SimpleVector<int> *inIndices,
+                               double *outDist, GridPos *outClosePos ) {
     double closeDist = DBL_MAX;
     GridPos closeP = { 0, 0 };
+
+    int numToCheck = players.size();
     
-    for( int i=0; i<players.size(); i++ ) {
+    if( inIndices != NULL ) {
+        numToCheck = inIndices->size();
+        }
+    
+    for( int k=0; k<numToCheck; k++ ) {
+        int i = k;
+        
+        if( inIndices != NULL ) {
+            i = inIndices->getElementDirect( k );
+            }
+        
         LiveObject *o = players.getElement( i );
         if( o->error ) {
             continue;
@@ -3117,13 +3209,42 @@ GridPos getClosestPlayerPos( int inX, int inY ) {
             p = computePartialMoveSpot( o );
             }
         
-        double d = distance( p, c );
+        double d = distance( p, inPos );
         
         if( d < closeDist ) {
             closeDist = d;
             closeP = p;
             }
         }
+    
+    *outDist = closeDist;
+    *outClosePos = closeP;
+    }
+
+
+
+// returns (0,0) if no player found
+GridPos getClosestPlayerPos( int inX, int inY ) {
+    GridPos c = { inX, inY };
+    
+    double closeDist;
+    GridPos closeP;
+    
+    SimpleVector<int> *nearby = 
+        getPlayerGridNearby( inX, inY, CLOSEST_PLAYER_GRID_RADIUS );
+    
+    if( nearby != NULL ) {
+        findClosestPlayer( c, nearby, &closeDist, &closeP );
+        
+        // every player within radius was in nearby list, so no one
+        // outside the list can be closer than this
+        if( closeDist <= CLOSEST_PLAYER_GRID_RADIUS ) {
+            return closeP;
+            }
+        }
+    
+    findClosestPlayer( c, NULL, &closeDist, &closeP );
+    
     return closeP;
     }
 
@@ -3139,10 +3260,6 @@ static int getMaxChunkDimension() {
     }
 
 
-static SocketPoll sockPoll;
-
-
-
 static void setPlayerDisconnected( LiveObject *inPlayer, 
                                    const char *inReason ) {    
     /*
@@ -3176,13 +3293,16 @@ static void setPlayerDisconnected( LiveObject *inPlayer,
         inPlayer->ys = p.y;
 
         inPlayer->birthPos = inPlayer->preVogBirthPos;
+        
+        // player jumped somewhere grid doesn't know about
+        clearPlayerGrid();
         }
     
     
     if( inPlayer->sock != NULL ) {
         // also, stop polling their socket, which will trigger constant
         // socket events from here on out, and cause us to busy-loop
-        sockPoll.removeSocket( inPlayer->sock );
+        removeSocketFromEvents( inPlayer->sock );
 
         delete inPlayer->sock;
         inPlayer->sock = NULL;
@@ -3195,6 +3315,170 @@ static void setPlayerDisconnected( LiveObject *inPlayer,
 
 
 
+// areas of map that player still needs when their chunk is centered on
+// inXD,inYD
+// returns number of rects, at most 2
+static int getMapChunkRects( LiveObject *inO, int inXD, int inYD,
+                             ChunkRect *outRects ) {
+    
+    int halfW = chunkDimensionX / 2;
+    int halfH = chunkDimensionY / 2;
+    
+    int fullStartX = inXD - halfW;
+    int fullStartY = inYD - halfH;
+    
+    if( ! inO->firstMapSent ) {
+        // send full rect centered on x,y
+        ChunkRect full = { fullStartX, fullStartY, 
+                           chunkDimensionX, chunkDimensionY };
+        outRects[0] = full;
+        return 1;
+        }
+    
+
+    // our closest previous chunk center
+    int lastX = inO->lastSentMapX;
+    int lastY = inO->lastSentMapY;
+
+
+    // split next chunk into two bars by subtracting last chunk
+    
+    int horBarStartX = fullStartX;
+    int horBarStartY = fullStartY;
+    int horBarW = chunkDimensionX;
+    int horBarH = chunkDimensionY;
+    
+    if( inYD > lastY ) {
+        // remove bottom of bar
+        horBarStartY = lastY + halfH;
+        horBarH = inYD - lastY;
+        }
+    else {
+        // remove top of bar
+        horBarH = lastY - inYD;
+        }
+    
+
+    int vertBarStartX = fullStartX;
+    int vertBarStartY = fullStartY;
+    int vertBarW = chunkDimensionX;
+    int vertBarH = chunkDimensionY;
+    
+    if( inXD > lastX ) {
+        // remove left part of bar
+        vertBarStartX = lastX + halfW;
+        vertBarW = inXD - lastX;
+        }
+    else {
+        // remove right part of bar
+        vertBarW = lastX - inXD;
+        }
+    
+    // now trim vert bar where it intersects with hor bar
+    if( inYD > lastY ) {
+        // remove top of vert bar
+        vertBarH -= horBarH;
+        }
+    else {
+        // remove bottom of vert bar
+        vertBarStartY = horBarStartY + horBarH;
+        vertBarH -= horBarH;
+        }
+    
+    
+    int numRects = 0;
+
+    // only send if non-zero width and height
+    if( horBarW > 0 && horBarH > 0 ) {
+        ChunkRect r = { horBarStartX, horBarStartY, horBarW, horBarH };
+        outRects[ numRects++ ] = r;
+        }
+    if( vertBarW > 0 && vertBarH > 0 ) {
+        ChunkRect r = { vertBarStartX, vertBarStartY, vertBarW, vertBarH };
+        outRects[ numRects++ ] = r;
+        }
+    
+    return numRects;
+    }
+
+
+
+// map spot that player's chunk is centered on
+static void getMapChunkCenter( LiveObject *inO, int *outX, int *outY ) {
+    *outX = inO->xd;
+    *outY = inO->yd;
+    
+    if( inO->heldByOther ) {
+        LiveObject *holdingPlayer = getLiveObject( inO->heldByOtherID );
+        
+        if( holdingPlayer != NULL ) {
+            *outX = holdingPlayer->xd;
+            *outY = holdingPlayer->yd;
+            }
+        }
+    }
+
+
+
+// true if player has moved far enough from center of last chunk sent to
+// need more of the map, or needs their first map again
+static char needsMapChunk( LiveObject *inO, int inXD, int inYD ) {
+    return
+        abs( inXD - inO->lastSentMapX ) > 7
+        ||
+        abs( inYD - inO->lastSentMapY ) > 8 
+        ||
+        ! inO->firstMapSent;
+    }
+
+
+
+static void discardPendingChunkJobs( LiveObject *inO ) {
+    for( int i=0; i<inO->numPendingChunkJobs; i++ ) {
+        int len;
+        delete [] finishChunkMessage( inO->pendingChunkJobs[i], &len );
+        }
+    inO->numPendingChunkJobs = 0;
+    }
+
+
+
+// reads cells that sendMapChunkMessage will send to inO, if it's called
+// with the same arguments before inO moves, so that they can be
+// compressed by workers in the meantime
+static void startMapChunkJobs( LiveObject *inO, 
+                               char inDestOverride = false,
+                               int inDestOverrideX = 0, 
+                               int inDestOverrideY = 0 ) {
+    discardPendingChunkJobs( inO );
+    
+    if( ! inO->connected ) {
+        return;
+        }
+    
+    int xd = inO->xd;
+    int yd = inO->yd;
+    
+    if( inDestOverride ) {
+        xd = inDestOverrideX;
+        yd = inDestOverrideY;
+        }
+
+    inO->numPendingChunkJobs = 
+        getMapChunkRects( inO, xd, yd, inO->pendingChunkRects );
+    
+    for( int i=0; i<inO->numPendingChunkJobs; i++ ) {
+        ChunkRect *r = &( inO->pendingChunkRects[i] );
+        
+        inO->pendingChunkJobs[i] = 
+            startChunkMessage( r->x, r->y, r->width, r->height,
+                               inO->birthPos,
+                               inO->binaryProtocol );
+        }
+    }
+
+
+
 // sets lastSentMap in inO if chunk goes through
 // returns result of send, auto-marks error in inO
 int sendMapChunkMessage( LiveObject *inO, 
@@ -3205,6 +3489,7 @@ int sendMapChunkMessage( LiveObject *inO,
     if( ! inO->connected ) {
         // act like it was a successful send so we can move on until
         // they reconnect later
+        discardPendingChunkJobs( inO );
         return 1;
         }
     
@@ -3218,123 +3503,64 @@ int sendMapChunkMessage( LiveObject *inO,
         yd = inDestOverrideY;
         }
     
+    ChunkRect rects[2];
     
-    int halfW = chunkDimensionX / 2;
-    int halfH = chunkDimensionY / 2;
+    int numRects = getMapChunkRects( inO, xd, yd, rects );
     
-    int fullStartX = xd - halfW;
-    int fullStartY = yd - halfH;
+    inO->firstMapSent = true;
     
-    int numSent = 0;
 
+    // use chunks started ahead of time only if they cover the same areas
+    char usePending = ( inO->numPendingChunkJobs == numRects );
     
-
-    if( ! inO->firstMapSent ) {
-        // send full rect centered on x,y
+    for( int i=0; i<numRects && usePending; i++ ) {
+        ChunkRect *a = &( rects[i] );
+        ChunkRect *b = &( inO->pendingChunkRects[i] );
         
-        inO->firstMapSent = true;
-        
-        unsigned char *mapChunkMessage = getChunkMessage( fullStartX,
-                                                          fullStartY,
-                                                          chunkDimensionX,
-                                                          chunkDimensionY,
-                                                          inO->birthPos,
-                                                          &messageLength );
-                
-        numSent += 
-            inO->sock->send( mapChunkMessage, 
-                             messageLength, 
-                             false, false );
-                
-        delete [] mapChunkMessage;
+        if( a->x != b->x || a->y != b->y || 
+            a->width != b->width || a->height != b->height ) {
+            usePending = false;
+            }
+        }
+    
+    if( ! usePending ) {
+        discardPendingChunkJobs( inO );
         }
-    else {
-        
-        // our closest previous chunk center
-        int lastX = inO->lastSentMapX;
-        int lastY = inO->lastSentMapY;
 
 
-        // split next chunk into two bars by subtracting last chunk
-        
-        int horBarStartX = fullStartX;
-        int horBarStartY = fullStartY;
-        int horBarW = chunkDimensionX;
-        int horBarH = chunkDimensionY;
-        
-        if( yd > lastY ) {
-            // remove bottom of bar
-            horBarStartY = lastY + halfH;
-            horBarH = yd - lastY;
-            }
-        else {
-            // remove top of bar
-            horBarH = lastY - yd;
-            }
+    int numSent = 0;
+    
+    for( int i=0; i<numRects; i++ ) {
+        ChunkRect *r = &( rects[i] );
         
-
-        int vertBarStartX = fullStartX;
-        int vertBarStartY = fullStartY;
-        int vertBarW = chunkDimensionX;
-        int vertBarH = chunkDimensionY;
+        int len;
+        unsigned char *mapChunkMessage;
         
-        if( xd > lastX ) {
-            // remove left part of bar
-            vertBarStartX = lastX + halfW;
-            vertBarW = xd - lastX;
+        if( usePending ) {
+            mapChunkMessage = 
+                finishChunkMessage( inO->pendingChunkJobs[i], &len );
             }
         else {
-            // remove right part of bar
-            vertBarW = lastX - xd;
+            mapChunkMessage = getChunkMessage( r->x, r->y,
+                                               r->width, r->height,
+                                               inO->birthPos,
+                                               &len,
+                                               inO->binaryProtocol );
             }
         
-        // now trim vert bar where it intersects with hor bar
-        if( yd > lastY ) {
-            // remove top of vert bar
-            vertBarH -= horBarH;
-            }
-        else {
-            // remove bottom of vert bar
-            vertBarStartY = horBarStartY + horBarH;
-            vertBarH -= horBarH;
-            }
+        messageLength += len;
         
+        numSent += 
+            sendToSocket( inO->sock, 
+                          mapChunkMessage, 
+                          len );
         
-        // only send if non-zero width and height
-        if( horBarW > 0 && horBarH > 0 ) {
-            int len;
-            unsigned char *mapChunkMessage = getChunkMessage( horBarStartX,
-                                                              horBarStartY,
-                                                              horBarW,
-                                                              horBarH,
-                                                              inO->birthPos,
-                                                              &len );
-            messageLength += len;
-            
-            numSent += 
-                inO->sock->send( mapChunkMessage, 
-                                 len, 
-                                 false, false );
-            
-            delete [] mapChunkMessage;
-            }
-        if( vertBarW > 0 && vertBarH > 0 ) {
-            int len;
-            unsigned char *mapChunkMessage = getChunkMessage( vertBarStartX,
-                                                              vertBarStartY,
-                                                              vertBarW,
-                                                              vertBarH,
-                                                              inO->birthPos,
-                                                              &len );
-            messageLength += len;
-            
-            numSent += 
-                inO->sock->send( mapChunkMessage, 
-                                 len, 
-                                 false, false );
-            
-            delete [] mapChunkMessage;
-            }
+        delete [] mapChunkMessage;
+        }
+    
+    if( usePending ) {
+        // all picked up
+        inO->numPendingChunkJobs = 0;
         }
     
     
@@ -3414,9 +3640,21 @@ char *getHoldingString( LiveObject *inObject ) {
 // only consider living, non-moving players
 char isMapSpotEmptyOfPlayers( int inX, int inY ) {
 
-    int numLive = players.size();
+    SimpleVector<int> *nearby = getPlayerGridNearby( inX, inY, 0 );
+
+    int numToCheck = players.size();
+    
+    if( nearby != NULL ) {
+        numToCheck = nearby->size();
+        }
     
-    for( int i=0; i<numLive; i++ ) {
+    for( int k=0; k<numToCheck; k++ ) {
+        int i = k;
+        
+        if( nearby != NULL ) {
+            i = nearby->getElementDirect( k );
+            }
+        
         LiveObject *nextPlayer = players.getElement( i );
         
         if( // not about to be deleted
@@ -3467,7 +3705,7 @@ static void setFreshEtaDecayForHeld( LiveObject *inPlayer ) {
                     
     if( newDecayT != NULL ) {
         inPlayer->holdingEtaDecay = 
-            Time::timeSec() + newDecayT->autoDecaySeconds;
+            getServerTimeSec() + newDecayT->autoDecaySeconds;
         }
     else {
         // no further decay
@@ -3575,7 +3813,7 @@ void handleMapChangeToPaths(
                             moveSpeed;
                                 
                         otherPlayer->moveStartTime = 
-                            Time::getCurrentTime() - 
+                            getServerTime() - 
                             secondsAlreadyDone;
                             
                         otherPlayer->newMove = true;
@@ -3779,6 +4017,32 @@ SimpleVector<char*> newLocationSpeech;
 SimpleVector<ChangePosition> newLocationSpeechPos;
 
 
+// change positions from this step by map area, filled right before
+// changes are sent out, so each player only looks at changes near them
+static SpatialGrid newUpdatesGrid;
+static SpatialGrid movesGrid;
+static SpatialGrid mapChangesGrid;
+static SpatialGrid newSpeechGrid;
+static SpatialGrid newLocationSpeechGrid;
+
+
+static void fillChangeGrid( SpatialGrid *inGrid, 
+                            SimpleVector<ChangePosition> *inPositions ) {
+    inGrid->clear();
+    
+    for( int u=0; u<inPositions->size(); u++ ) {
+        ChangePosition *p = inPositions->getElement( u );
+        
+        if( p->global ) {
+            inGrid->addGlobal( u );
+            }
+        else {
+            inGrid->add( u, p->x, p->y );
+            }
+        }
+    }
+
+
 
 
 char *isCurseNamingSay( char *inSaidString );
@@ -4056,7 +4320,7 @@ void handleDrop( int inX, int inY, LiveObject *inDroppingPlayer,
                     if( isFertileAge( inDroppingPlayer ) ) {    
                         // reset food decrement time
                         babyO->foodDecrementETASeconds =
-                            Time::getCurrentTime() +
+                            getServerTime() +
                             computeFoodDecrementTimeSeconds( babyO );
                         }
                     
@@ -4111,7 +4375,7 @@ void handleDrop( int inX, int inY, LiveObject *inDroppingPlayer,
             if( isFertileAge( inDroppingPlayer ) ) {    
                 // reset food decrement time
                 babyO->foodDecrementETASeconds =
-                    Time::getCurrentTime() +
+                    getServerTime() +
                     computeFoodDecrementTimeSeconds( babyO );
                 }
 
@@ -4308,6 +4572,10 @@ typedef struct UpdateRecord{
         int absolutePosX, absolutePosY;
         GridPos absoluteActionTarget;
         int absoluteHeldOriginX, absoluteHeldOriginY;
+        
+        // line for binary protocol, minus positions
+        unsigned char *binaryBody;
+        int binaryBodyLength;
     } UpdateRecord;
 
 
@@ -4354,6 +4622,43 @@ static char *getUpdateLineFromRecord(
 
 
 
+// same line for binary protocol
+static void writeBinaryUpdateLine( ByteWriter *inWriter,
+                                   UpdateRecord *inRecord, 
+                                   GridPos inRelativeToPos, 
+                                   GridPos inObserverPos ) {
+    
+    inWriter->writeByte( inRecord->posUsed );
+
+    if( inRecord->posUsed ) {
+        
+        GridPos updatePos = { inRecord->absolutePosX, inRecord->absolutePosY };
+        
+        if( distance( updatePos, inObserverPos ) > 64 ) {
+            // dummy positions for far-away player, as in text line
+            for( int i=0; i<6; i++ ) {
+                inWriter->writeInt( 1977 );
+                }
+            }
+        else {
+            inWriter->writeInt( inRecord->absoluteActionTarget.x 
+                                - inRelativeToPos.x );
+            inWriter->writeInt( inRecord->absoluteActionTarget.y 
+                                - inRelativeToPos.y );
+            inWriter->writeInt( inRecord->absoluteHeldOriginX 
+                                - inRelativeToPos.x );
+            inWriter->writeInt( inRecord->absoluteHeldOriginY 
+                                - inRelativeToPos.y );
+            inWriter->writeInt( inRecord->absolutePosX - inRelativeToPos.x );
+            inWriter->writeInt( inRecord->absolutePosY - inRelativeToPos.y );
+            }
+        }
+    
+    inWriter->writeBytes( inRecord->binaryBody, inRecord->binaryBodyLength );
+    }
+
+
+
 static char isYummy( LiveObject *inPlayer, int inObjectID ) {
     ObjectRecord *o = getObject( inObjectID );
     
@@ -4409,6 +4714,10 @@ static void updateYum( LiveObject *inPlayer, int inFoodEatenID ) {
 
 
 
+// reused for binary body of each update record
+static ByteWriter updateBodyWriter;
+
+
 static UpdateRecord getUpdateRecord( 
     LiveObject *inPlayer,
     char inDelete,
@@ -4513,6 +4822,10 @@ static UpdateRecord getUpdateRecord(
         heldYum = 1;
         }
 
+    double age = computeAge( inPlayer );
+    double ageRate = 1.0 / getAgeRate();
+    double moveSpeed = computeMoveSpeed( inPlayer );
+
 
     r.formatString = autoSprintf( 
         "%d %d %d %d %%d %%d %s %d %%d %%d %d "
@@ -4530,9 +4843,9 @@ static UpdateRecord getUpdateRecord(
         hideIDForClient( inPlayer->heldTransitionSourceID ),
         inPlayer->heat,
         posString,
-        computeAge( inPlayer ),
-        1.0 / getAgeRate(),
-        computeMoveSpeed( inPlayer ),
+        age,
+        ageRate,
+        moveSpeed,
         clothingList,
         inPlayer->justAte,
         hideIDForClient( inPlayer->justAteID ),
@@ -4540,6 +4853,44 @@ static UpdateRecord getUpdateRecord(
         heldYum,
         deathReason );
     
+
+    // same fields for binary protocol, see binaryProtocol.h
+    updateBodyWriter.reset();
+    
+    updateBodyWriter.writeInt( inPlayer->id );
+    updateBodyWriter.writeInt( inPlayer->displayID );
+    updateBodyWriter.writeInt( inPlayer->facingOverride );
+    updateBodyWriter.writeInt( inPlayer->actionAttempt );
+    updateBodyWriter.writeString( holdingString );
+    updateBodyWriter.writeInt( inPlayer->heldOriginValid );
+    updateBodyWriter.writeInt( 
+        hideIDForClient( inPlayer->heldTransitionSourceID ) );
+    updateBodyWriter.writeFixed( inPlayer->heat, BINARY_HUNDREDTHS );
+    
+    if( inDelete ) {
+        updateBodyWriter.writeInt( 0 );
+        updateBodyWriter.writeInt( 0 );
+        }
+    else {
+        updateBodyWriter.writeInt( doneMoving );
+        updateBodyWriter.writeInt( inPlayer->posForced );
+        }
+    
+    updateBodyWriter.writeFixed( age, BINARY_HUNDREDTHS );
+    updateBodyWriter.writeFixed( ageRate, BINARY_HUNDREDTHS );
+    updateBodyWriter.writeFixed( moveSpeed, BINARY_HUNDREDTHS );
+    updateBodyWriter.writeString( clothingList );
+    updateBodyWriter.writeInt( inPlayer->justAte );
+    updateBodyWriter.writeInt( hideIDForClient( inPlayer->justAteID ) );
+    updateBodyWriter.writeInt( inPlayer->responsiblePlayerID );
+    updateBodyWriter.writeInt( heldYum );
+    updateBodyWriter.writeString( deathReason );
+    
+    r.binaryBodyLength = updateBodyWriter.getSize();
+    r.binaryBody = new unsigned char[ r.binaryBodyLength ];
+    memcpy( r.binaryBody, updateBodyWriter.getBytes(), r.binaryBodyLength );
+    
+    
     delete [] deathReason;
     
 
@@ -4593,6 +4944,7 @@ static char *getUpdateLine( LiveObject *inPlayer, GridPos inRelativeToPos,
     char *line = getUpdateLineFromRecord( &r, inRelativeToPos, inObserverPos );
 
     delete [] r.formatString;
+    delete [] r.binaryBody;
     
     return line;
     }
@@ -4611,11 +4963,23 @@ static LiveObject *getHitPlayer( int inX, int inY,
                                  int *outHitIndex = NULL ) {
     GridPos targetPos = { inX, inY };
 
-    int numLive = players.size();
+    SimpleVector<int> *nearby = getPlayerGridNearby( inX, inY, 0 );
+
+    int numToCheck = players.size();
+    
+    if( nearby != NULL ) {
+        numToCheck = nearby->size();
+        }
                                     
     LiveObject *hitPlayer = NULL;
                                     
-    for( int j=0; j<numLive; j++ ) {
+    for( int k=0; k<numToCheck; k++ ) {
+        int j = k;
+        
+        if( nearby != NULL ) {
+            j = nearby->getElementDirect( k );
+            }
+        
         LiveObject *otherPlayer = 
             players.getElement( j );
         
@@ -4725,6 +5089,21 @@ static int tutorialCount = 0;
 
 
 
+// call after processLoggedInPlayer, to carry protocol from connection
+// over to player that now has its socket, new or reconnected
+static void setPlayerProtocol( FreshConnection *inConnection ) {
+    for( int i=0; i<players.size(); i++ ) {
+        LiveObject *o = players.getElement( i );
+        
+        if( o->sock == inConnection->sock ) {
+            o->binaryProtocol = inConnection->binaryProtocol;
+            return;
+            }
+        }
+    }
+
+
+
 // fill this with emails that should also affect lineage ban
 // if any twin in group is banned, all should be
 static SimpleVector<char*> tempTwinEmails;
@@ -4802,17 +5181,17 @@ int processLoggedInPlayer( Socket *inSock,
     // reload these settings every time someone new connects
     // thus, they can be changed without restarting the server
     minFoodDecrementSeconds = 
-        SettingsManager::getFloatSetting( "minFoodDecrementSeconds", 5.0f );
+        getCachedFloatSetting( "minFoodDecrementSeconds", 5.0f );
     
     maxFoodDecrementSeconds = 
-        SettingsManager::getFloatSetting( "maxFoodDecrementSeconds", 20 );
+        getCachedFloatSetting( "maxFoodDecrementSeconds", 20 );
 
     babyBirthFoodDecrement = 
-        SettingsManager::getIntSetting( "babyBirthFoodDecrement", 10 );
+        getCachedIntSetting( "babyBirthFoodDecrement", 10 );
 
 
     eatBonus = 
-        SettingsManager::getIntSetting( "eatBonus", 0 );
+        getCachedIntSetting( "eatBonus", 0 );
 
 
 
@@ -4825,8 +5204,8 @@ int processLoggedInPlayer( Socket *inSock,
     newObject.id = nextID;
     nextID++;
 
-    SettingsManager::setSetting( "nextPlayerID",
-                                 (int)nextID );
+    setCachedSetting( "nextPlayerID",
+                      (int)nextID );
 
 
     newObject.responsiblePlayerID = -1;
@@ -4841,11 +5220,11 @@ int processLoggedInPlayer( Socket *inSock,
         newObject.isTutorial = true;
         }
 
-    newObject.trueStartTimeSeconds = Time::getCurrentTime();
+    newObject.trueStartTimeSeconds = getServerTime();
     newObject.lifeStartTimeSeconds = newObject.trueStartTimeSeconds;
                             
 
-    newObject.lastSayTimeSeconds = Time::getCurrentTime();
+    newObject.lastSayTimeSeconds = getServerTime();
     
 
     newObject.heldByOther = false;
@@ -4899,7 +5278,7 @@ int processLoggedInPlayer( Socket *inSock,
             char canHaveBaby = true;
 
             
-            if( Time::timeSec() < player->birthCoolDown ) {    
+            if( getServerTimeSec() < player->birthCoolDown ) {    
                 canHaveBaby = false;
                 }
             
@@ -5006,7 +5385,7 @@ int processLoggedInPlayer( Socket *inSock,
         }
     
     
-    if( SettingsManager::getIntSetting( "forceAllPlayersEve", 0 ) ) {
+    if( getCachedIntSetting( "forceAllPlayersEve", 0 ) ) {
         parentChoices.deleteAll();
         forceParentChoices = true;
         }
@@ -5085,11 +5464,11 @@ int processLoggedInPlayer( Socket *inSock,
     newObject.lastBiomeHeat = targetHeat;
     newObject.heat = 0.5;
     newObject.heatUpdate = false;
-    newObject.lastHeatUpdate = Time::getCurrentTime();
+    newObject.lastHeatUpdate = getServerTime();
     
 
     newObject.foodDecrementETASeconds =
-        Time::getCurrentTime() + 
+        getServerTime() + 
         computeFoodDecrementTimeSeconds( &newObject );
                 
     newObject.foodUpdate = true;
@@ -5230,7 +5609,7 @@ int processLoggedInPlayer( Socket *inSock,
             // only set race if the spawn-near player is our mother
             // otherwise, we are a new Eve spawning next to a baby
             
-            timeSec_t curTime = Time::timeSec();
+            timeSec_t curTime = getServerTimeSec();
             
             parent->babyBirthTimes->push_back( curTime );
             parent->babyIDs->push_back( newObject.id );
@@ -5362,7 +5741,7 @@ int processLoggedInPlayer( Socket *inSock,
         tutorialCount ++;
 
         int maxPlayers = 
-            SettingsManager::getIntSetting( "maxPlayers", 200 );
+            getCachedIntSetting( "maxPlayers", 200 );
 
         if( tutorialCount > maxPlayers ) {
             // wrap back to 0 so we don't keep getting farther
@@ -5414,12 +5793,12 @@ int processLoggedInPlayer( Socket *inSock,
             }
         
 
-        if( SettingsManager::getIntSetting( "forceEveLocation", 0 ) ) {
+        if( getCachedIntSetting( "forceEveLocation", 0 ) ) {
 
             startX = 
-                SettingsManager::getIntSetting( "forceEveLocationX", 0 );
+                getCachedIntSetting( "forceEveLocationX", 0 );
             startY = 
-                SettingsManager::getIntSetting( "forceEveLocationY", 0 );
+                getCachedIntSetting( "forceEveLocationY", 0 );
             }
         
         
@@ -5458,18 +5837,18 @@ int processLoggedInPlayer( Socket *inSock,
     
     if( parent == NULL ) {
         // Eve
-        int forceID = SettingsManager::getIntSetting( "forceEveObject", 0 );
+        int forceID = getCachedIntSetting( "forceEveObject", 0 );
     
         if( forceID > 0 ) {
             newObject.displayID = forceID;
             }
         
         
-        float forceAge = SettingsManager::getFloatSetting( "forceEveAge", 0.0 );
+        float forceAge = getCachedFloatSetting( "forceEveAge", 0.0 );
         
         if( forceAge > 0 ) {
             newObject.lifeStartTimeSeconds = 
-                Time::getCurrentTime() - forceAge * ( 1.0 / getAgeRate() );
+                getServerTime() - forceAge * ( 1.0 / getAgeRate() );
             }
         }
     
@@ -5484,7 +5863,7 @@ int processLoggedInPlayer( Socket *inSock,
             newObject.displayID = id;
             
             newObject.lifeStartTimeSeconds = 
-                Time::getCurrentTime() - 
+                getServerTime() - 
                 getTriggerPlayerAge( inEmail ) * ( 1.0 / getAgeRate() );
         
             GridPos pos = getTriggerPlayerPos( inEmail );
@@ -5528,7 +5907,8 @@ int processLoggedInPlayer( Socket *inSock,
     newObject.firstMapSent = false;
     newObject.lastSentMapX = 0;
     newObject.lastSentMapY = 0;
-    newObject.moveStartTime = Time::getCurrentTime();
+    newObject.numPendingChunkJobs = 0;
+    newObject.moveStartTime = getServerTime();
     newObject.moveTotalSeconds = 0;
     newObject.facingOverride = 0;
     newObject.actionAttempt = 0;
@@ -5578,6 +5958,7 @@ int processLoggedInPlayer( Socket *inSock,
     newObject.emotFrozen = false;
 
     newObject.connected = true;
+    newObject.binaryProtocol = false;
     newObject.error = false;
     newObject.errorCauseString = "";
     
@@ -5616,6 +5997,10 @@ int processLoggedInPlayer( Socket *inSock,
     for( int i=0; i<HEAT_MAP_D * HEAT_MAP_D; i++ ) {
         newObject.heatMap[i] = 0;
         }
+    newObject.heatMapCenter.x = 0;
+    newObject.heatMapCenter.y = 0;
+    // never computed
+    newObject.heatFieldStamp = 0;
 
     
     newObject.parentID = -1;
@@ -5776,6 +6161,7 @@ static void processWaitingTwinConnection( FreshConnection inConnection ) {
                                            inConnection.email,
                                            inConnection.tutorialNumber,
                                            anyTwinCurseLevel );
+        setPlayerProtocol( &inConnection );
         tempTwinEmails.deleteAll();
         
         if( newID == -1 ) {
@@ -5851,6 +6237,7 @@ static void processWaitingTwinConnection( FreshConnection inConnection ) {
                                    parent,
                                    displayID,
                                    forcedEvePos );
+            setPlayerProtocol( nextConnection );
             
             // just added is always last object in list
             LiveObject newTwinPlayer = 
@@ -6058,7 +6445,7 @@ static char addHeldToContainer( LiveObject *inPlayer,
             inPlayer->holdingEtaDecay );
 
         if( inPlayer->numContained > 0 ) {
-            timeSec_t curTime = Time::timeSec();
+            timeSec_t curTime = getServerTimeSec();
             
             for( int c=0; c<inPlayer->numContained; c++ ) {
                 
@@ -6391,7 +6778,7 @@ static char addHeldToClothingContainer( LiveObject *inPlayer,
                 holdingEtaDecay != 0 ) {
                                                 
                 timeSec_t curTime = 
-                    Time::timeSec();
+                    getServerTimeSec();
                                             
                 timeSec_t offset = 
                     inPlayer->
@@ -6534,7 +6921,7 @@ static void removeFromClothingContainerToHold( LiveObject *inPlayer,
             clothingContainedEtaDecays[inC].
             getElementDirect( slotToRemove );
                                     
-        timeSec_t curTime = Time::timeSec();
+        timeSec_t curTime = getServerTimeSec();
 
         if( inPlayer->holdingEtaDecay != 0 ) {
                                         
@@ -6728,6 +7115,63 @@ static unsigned char *makeCompressedMessage( char *inMessage, int inLength,
 static int maxUncompressedSize = 256;
 
 
+
+// reused for lines of binary messages, and for whole messages
+static ByteWriter binaryLinesWriter;
+static ByteWriter binaryMessageWriter;
+
+
+// BM message (see binaryProtocol.h) with inNumLines lines of type inKind
+// from inLines
+//
+// zipped only if above maxUncompressedSize, like text messages
+static unsigned char *makeBinaryMessage( unsigned char inKind,
+                                         int inNumLines,
+                                         ByteWriter *inLines,
+                                         int *outLength ) {
+    binaryMessageWriter.reset();
+    
+    binaryMessageWriter.writeByte( inKind );
+    binaryMessageWriter.writeUInt( inNumLines );
+    binaryMessageWriter.writeBytes( inLines->getBytes(), inLines->getSize() );
+    
+    int rawSize = binaryMessageWriter.getSize();
+    
+    unsigned char *payload = binaryMessageWriter.getBytes();
+    int payloadSize = rawSize;
+    
+    unsigned char *compressedData = NULL;
+    int compressedSize = 0;
+    
+    if( rawSize > maxUncompressedSize ) {
+        compressedData = zipCompress( payload, rawSize, &compressedSize );
+        
+        payload = compressedData;
+        payloadSize = compressedSize;
+        }
+
+    char *header = autoSprintf( "BM\n%d %d\n#", rawSize, compressedSize );
+    int headerLength = strlen( header );
+    int fullLength = headerLength + payloadSize;
+    
+    unsigned char *fullMessage = new unsigned char[ fullLength ];
+    
+    memcpy( fullMessage, (unsigned char*)header, headerLength );
+    
+    memcpy( &( fullMessage[ headerLength ] ), payload, payloadSize );
+
+    if( compressedData != NULL ) {
+        delete [] compressedData;
+        }
+    
+    *outLength = fullLength;
+    
+    delete [] header;
+    
+    return fullMessage;
+    }
+
+
 static void sendMessageToPlayer( LiveObject *inPlayer, 
                                  char *inMessage, int inLength ) {
     if( ! inPlayer->connected ) {
@@ -6747,9 +7191,9 @@ static void sendMessageToPlayer( LiveObject *inPlayer,
         }
 
     int numSent = 
-        inPlayer->sock->send( message, 
-                              len, 
-                              false, false );
+        sendToSocket( inPlayer->sock, 
+                      message, 
+                      len );
         
     if( numSent != len ) {
         setPlayerDisconnected( inPlayer, "Socket write failed" );
@@ -6951,7 +7395,7 @@ int readIntFromFile( const char *inFileName, int inDefaultValue ) {
 
 void apocalypseStep() {
     
-    double curTime = Time::getCurrentTime();
+    double curTime = getServerTime();
 
     if( !apocalypseTriggered ) {
         
@@ -6964,9 +7408,9 @@ void apocalypseStep() {
             // don't actually send request to reflector if apocalypse
             // not possible locally
             // or if broadcast mode disabled
-            if( SettingsManager::getIntSetting( "remoteReport", 0 ) &&
-                SettingsManager::getIntSetting( "apocalypsePossible", 0 ) &&
-                SettingsManager::getIntSetting( "apocalypseBroadcast", 0 ) ) {
+            if( getCachedIntSetting( "remoteReport", 0 ) &&
+                getCachedIntSetting( "apocalypsePossible", 0 ) &&
+                getCachedIntSetting( "apocalypseBroadcast", 0 ) ) {
 
                 printf( "Checking for remote apocalypse\n" );
             
@@ -6974,7 +7418,7 @@ void apocalypseStep() {
                                          reflectorURL );
         
                 apocalypseRequest =
-                    new WebRequest( "GET", url, NULL );
+                    new AsyncWebRequest( "GET", url, NULL );
             
                 delete [] url;
                 }
@@ -7009,8 +7453,8 @@ void apocalypseStep() {
                         AppLog::infoF( 
                             "Apocalypse check:  New remote apocalypse:  %d.",
                             lastApocalypseNumber );
-                        SettingsManager::setSetting( "lastApocalypseNumber",
-                                                     lastApocalypseNumber );
+                        setCachedSetting( "lastApocalypseNumber",
+                                          lastApocalypseNumber );
                         }
                     }
                     
@@ -7030,7 +7474,7 @@ void apocalypseStep() {
 
         if( !apocalypseStarted ) {
             apocalypsePossible = 
-                SettingsManager::getIntSetting( "apocalypsePossible", 0 );
+                getCachedIntSetting( "apocalypsePossible", 0 );
 
             if( !apocalypsePossible ) {
                 // settings change since we last looked at it
@@ -7043,16 +7487,15 @@ void apocalypseStep() {
 
             // only broadcast to reflector if apocalypseBroadcast set
             if( !apocalypseRemote &&
-                SettingsManager::getIntSetting( "remoteReport", 0 ) &&
-                SettingsManager::getIntSetting( "apocalypseBroadcast", 0 ) &&
+                getCachedIntSetting( "remoteReport", 0 ) &&
+                getCachedIntSetting( "apocalypseBroadcast", 0 ) &&
                 apocalypseRequest == NULL && reflectorURL != NULL ) {
                 
                 AppLog::info( "Apocalypse broadcast set, telling reflector" );
 
                 
                 char *reflectorSharedSecret = 
-                    SettingsManager::
-                    getStringSetting( "reflectorSharedSecret" );
+                    getCachedStringSetting( "reflectorSharedSecret" );
                 
                 if( reflectorSharedSecret != NULL ) {
                     lastApocalypseNumber++;
@@ -7061,8 +7504,8 @@ void apocalypseStep() {
                         "Apocalypse trigger:  New local apocalypse:  %d.",
                         lastApocalypseNumber );
 
-                    SettingsManager::setSetting( "lastApocalypseNumber",
-                                                 lastApocalypseNumber );
+                    setCachedSetting( "lastApocalypseNumber",
+                                      lastApocalypseNumber );
 
                     int closestPlayerIndex = -1;
                     double closestDist = 999999999;
@@ -7109,7 +7552,7 @@ void apocalypseStep() {
                     printf( "Starting new web request for %s\n", url );
                     
                     apocalypseRequest =
-                        new WebRequest( "GET", url, NULL );
+                        new AsyncWebRequest( "GET", url, NULL );
                                 
                     delete [] url;
                     delete [] reflectorSharedSecret;
@@ -7126,10 +7569,9 @@ void apocalypseStep() {
                 if( !nextPlayer->error && nextPlayer->connected ) {
                     
                     int numSent = 
-                        nextPlayer->sock->send( 
-                            (unsigned char*)message, 
-                            messageLength,
-                            false, false );
+                        sendToSocket( nextPlayer->sock, 
+                                      (unsigned char*)message, 
+                                      messageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -7140,7 +7582,7 @@ void apocalypseStep() {
                     }
                 }
             
-            apocalypseStartTime = Time::getCurrentTime();
+            apocalypseStartTime = getServerTime();
             apocalypseStarted = true;
             postApocalypseStarted = false;
             }
@@ -7178,29 +7620,29 @@ void apocalypseStep() {
             }
 
         if( apocalypseRequest == NULL &&
-            Time::getCurrentTime() - apocalypseStartTime >= 7 ) {
+            getServerTime() - apocalypseStartTime >= 7 ) {
             
             if( ! postApocalypseStarted  ) {
                 AppLog::infoF( "Enough warning time, %d players still alive",
                                players.size() );
                 
                 
-                double startTime = Time::getCurrentTime();
+                double startTime = getServerTime();
                 
                 // clear map
                 freeMap( true );
 
                 AppLog::infoF( "Apocalypse freeMap took %f sec",
-                               Time::getCurrentTime() - startTime );
+                               getServerTime() - startTime );
                 wipeMapFiles();
 
                 AppLog::infoF( "Apocalypse wipeMapFiles took %f sec",
-                               Time::getCurrentTime() - startTime );
+                               getServerTime() - startTime );
                 
                 initMap();
                 
                 AppLog::infoF( "Apocalypse initMap took %f sec",
-                               Time::getCurrentTime() - startTime );
+                               getServerTime() - startTime );
                 
 
                 lastRemoteApocalypseCheckTime = curTime;
@@ -7243,10 +7685,9 @@ void apocalypseStep() {
                         if( !nextPlayer->error && nextPlayer->connected ) {
                     
                             int numSent = 
-                                nextPlayer->sock->send( 
-                                    (unsigned char*)message, 
-                                    messageLength,
-                                    false, false );
+                                sendToSocket( nextPlayer->sock, 
+                                              (unsigned char*)message, 
+                                              messageLength );
                             
                             nextPlayer->gotPartOfThisFrame = true;
                     
@@ -7297,10 +7738,9 @@ void monumentStep() {
 
 
                 int numSent = 
-                    nextPlayer->sock->send( 
-                        (unsigned char*)message, 
-                        messageLength,
-                        false, false );
+                    sendToSocket( nextPlayer->sock, 
+                                  (unsigned char*)message, 
+                                  messageLength );
                 
                 nextPlayer->gotPartOfThisFrame = true;
                 
@@ -7518,11 +7958,11 @@ static void checkSickStaggerTime( LiveObject *inPlayer ) {
         // the sickness passes
         
         int staggerTime = 
-            SettingsManager::getIntSetting(
+            getCachedIntSetting(
                 "deathStaggerTime", 20 );
         
         double currentTime = 
-            Time::getCurrentTime();
+            getServerTime();
         
         // 10x base stagger time should
         // give them enough time to either heal
@@ -7566,6 +8006,50 @@ void sanityCheckSettings(const char *inSettingName) {
 }
 
 
+
+// per-step log lines, formatted by async log writer
+static int updateListLogType = -1;
+static int sentUpdateLogType = -1;
+
+
+// "1, 2, 3, "
+static char *formatIDList( AsyncLogRecord *inRecord ) {
+    SimpleVector<char> list;
+    
+    for( int i=0; i<inRecord->intListLength; i++ ) {
+        char *idString = autoSprintf( "%d, ", inRecord->intList[i] );
+        list.appendElementString( idString );
+        delete [] idString;
+        }
+    return list.getElementString();
+    }
+
+
+
+static void formatUpdateListLog( AsyncLogRecord *inRecord ) {
+    char *listString = formatIDList( inRecord );
+
+    AppLog::infoF( "Need to send updates about these %d players: %s",
+                   inRecord->intListLength, listString );
+    
+    delete [] listString;
+    }
+
+
+
+static void formatSentUpdateLog( AsyncLogRecord *inRecord ) {
+    char *listString = formatIDList( inRecord );
+
+    AppLog::infoF( "%d/%d players were sent part of a %d-line PU: %s",
+                   inRecord->intListLength,
+                   inRecord->ints[0], inRecord->ints[1],
+                   listString );
+    
+    delete [] listString;
+    }
+
+
+
 int main() {
 
     if( checkReadOnly() ) {
@@ -7583,7 +8067,7 @@ int main() {
     
 
     nextID = 
-        SettingsManager::getIntSetting( "nextPlayerID", 2 );
+        getCachedIntSetting( "nextPlayerID", 2 );
 
 
     // make backup and delete old backup every day
@@ -7597,20 +8081,38 @@ int main() {
 
     printf( "\n" );
     
+    initSettingsCache();
+    
+    initAsyncLog();
+    
+    updateListLogType = addAsyncLogType( formatUpdateListLog, NULL );
+    sentUpdateLogType = addAsyncLogType( formatSentUpdateLog, NULL );
+    
+    
+    // before anything reads the clock
+    replayingSession = initSessionReplay();
+    
     
     
 
     nextSequenceNumber = 
-        SettingsManager::getIntSetting( "sequenceNumber", 1 );
+        getCachedIntSetting( "sequenceNumber", 1 );
 
     requireClientPassword =
-        SettingsManager::getIntSetting( "requireClientPassword", 1 );
+        getCachedIntSetting( "requireClientPassword", 1 );
     
     requireTicketServerCheck =
-        SettingsManager::getIntSetting( "requireTicketServerCheck", 1 );
+        getCachedIntSetting( "requireTicketServerCheck", 1 );
     
     clientPassword = 
-        SettingsManager::getStringSetting( "clientPassword" );
+        getCachedStringSetting( "clientPassword" );
+
+    if( replayingSession ) {
+        // recorded logins answer challenges from the original server,
+        // and were checked by it already
+        requireClientPassword = 0;
+        requireTicketServerCheck = 0;
+        }
 
 
     int dataVer = readIntFromFile( "dataVersionNumber.txt", 1 );
@@ -7630,28 +8132,28 @@ int main() {
 
 
     sanityCheckSettings( "lifespanMultiplier" );
-    lifespan_multiplier = SettingsManager::getFloatSetting( "lifespanMultiplier" , 1.0f );
-    SettingsManager::setSetting( "lifespanMultiplier" , lifespan_multiplier );
+    lifespan_multiplier = getCachedFloatSetting( "lifespanMultiplier" , 1.0f );
+    setCachedSetting( "lifespanMultiplier" , lifespan_multiplier );
     age_old = (int)( 40 * lifespan_multiplier );
     age_death = (int)( 60 * lifespan_multiplier );
     forceDeathAge = age_death;
 
     minFoodDecrementSeconds = 
-        SettingsManager::getFloatSetting( "minFoodDecrementSeconds", 5.0f );
+        getCachedFloatSetting( "minFoodDecrementSeconds", 5.0f );
 
     maxFoodDecrementSeconds = 
-        SettingsManager::getFloatSetting( "maxFoodDecrementSeconds", 20 );
+        getCachedFloatSetting( "maxFoodDecrementSeconds", 20 );
 
     babyBirthFoodDecrement = 
-        SettingsManager::getIntSetting( "babyBirthFoodDecrement", 10 );
+        getCachedIntSetting( "babyBirthFoodDecrement", 10 );
 
 
     eatBonus = 
-        SettingsManager::getIntSetting( "eatBonus", 0 );
+        getCachedIntSetting( "eatBonus", 0 );
 
 
     secondsPerYear = 
-        SettingsManager::getFloatSetting( "secondsPerYear", 60.0f );
+        getCachedFloatSetting( "secondsPerYear", 60.0f );
     
 
     if( clientPassword == NULL ) {
@@ -7660,7 +8162,7 @@ int main() {
 
 
     ticketServerURL = 
-        SettingsManager::getStringSetting( "ticketServerURL" );
+        getCachedStringSetting( "ticketServerURL" );
     
 
     if( ticketServerURL == NULL ) {
@@ -7668,21 +8170,21 @@ int main() {
         }
 
     
-    reflectorURL = SettingsManager::getStringSetting( "reflectorURL" );
+    reflectorURL = getCachedStringSetting( "reflectorURL" );
 
     apocalypsePossible = 
-        SettingsManager::getIntSetting( "apocalypsePossible", 0 );
+        getCachedIntSetting( "apocalypsePossible", 0 );
 
     lastApocalypseNumber = 
-        SettingsManager::getIntSetting( "lastApocalypseNumber", 0 );
+        getCachedIntSetting( "lastApocalypseNumber", 0 );
 
 
     childSameRaceLikelihood =
-        (double)SettingsManager::getFloatSetting( "childSameRaceLikelihood",
-                                                  0.90 );
+        (double)getCachedFloatSetting( "childSameRaceLikelihood",
+                                       0.90 );
     
     familySpan =
-        SettingsManager::getIntSetting( "familySpan", 2 );
+        getCachedIntSetting( "familySpan", 2 );
     
     
     readPhrases( "babyNamingPhrases", &nameGivingPhrases );
@@ -7696,7 +8198,7 @@ int main() {
     
 
     eveName = 
-        SettingsManager::getStringSetting( "eveName", "EVE" );
+        getCachedStringSetting( "eveName", "EVE" );
 
 
 #ifdef WIN_32
@@ -7715,7 +8217,7 @@ int main() {
     
 
     initLifeLog();
-    //initBackup();
+    initBackup();
     
     initPlayerStats();
     initLineageLog();
@@ -7748,7 +8250,7 @@ int main() {
 
     // defaults to one hour
     int epochSeconds = 
-        SettingsManager::getIntSetting( "epochSeconds", 3600 );
+        getCachedIntSetting( "epochSeconds", 3600 );
     
     setTransitionEpoch( epochSeconds );
 
@@ -7823,13 +8325,17 @@ int main() {
 
     
     int port = 
-        SettingsManager::getIntSetting( "port", 5077 );
+        getCachedIntSetting( "port", 5077 );
     
     
     
     SocketServer *server = new SocketServer( port, 256 );
     
-    sockPoll.addSocketServer( server );
+    initSocketEvents( server );
+    
+    initAsyncWeb();
+    
+    initTickProfiler();
     
     AppLog::infoF( "Listening for connection on port %d", port );
 
@@ -7839,21 +8345,50 @@ int main() {
     char someClientMessageReceived = false;
     
     
-    int shutdownMode = SettingsManager::getIntSetting( "shutdownMode", 0 );
+    int shutdownMode = getCachedIntSetting( "shutdownMode", 0 );
     int forceShutdownMode = 
-            SettingsManager::getIntSetting( "forceShutdownMode", 0 );
+            getCachedIntSetting( "forceShutdownMode", 0 );
         
 
+    if( replayingSession ) {
+        // same random state that recording started with
+        randSource.reseed( getSessionRandomSeed() );
+        reseedMapRandomSource( getSessionRandomSeed() );
+        }
+    
+
     while( !quit ) {
 
-        double curStepTime = Time::getCurrentTime();
+        double curStepTime = getServerTime();
+        
+        // real time, even during replay
+        double stepStartTime = Time::getCurrentTime();
+        
+        if( replayingSession ) {
+            if( isSessionReplayDone() ) {
+                AppLog::info( "Session replay done, quitting." );
+                logSessionReplayStats();
+                flushTickProfiler();
+                quit = true;
+                break;
+                }
+            }
+        else {
+            stepTickProfiler();
+            
+            if( stepSessionRecording() ) {
+                // so replay can start from same random state
+                randSource.reseed( getSessionRandomSeed() );
+                reseedMapRandomSource( getSessionRandomSeed() );
+                }
+            }
         
         // flush past players hourly
         if( curStepTime - lastPastPlayerFlushTime > 3600 ) {
             
             // default one week
             int pastPlayerFlushTime = 
-                SettingsManager::getIntSetting( "pastPlayerFlushTime", 604000 );
+                getCachedIntSetting( "pastPlayerFlushTime", 604000 );
             
             for( int i=0; i<pastPlayers.size(); i++ ) {
                 DeadObject *o = pastPlayers.getElement( i );
@@ -7881,9 +8416,9 @@ int main() {
         
         
         if( periodicStepThisStep ) {
-            shutdownMode = SettingsManager::getIntSetting( "shutdownMode", 0 );
+            shutdownMode = getCachedIntSetting( "shutdownMode", 0 );
             forceShutdownMode = 
-                SettingsManager::getIntSetting( "forceShutdownMode", 0 );
+                getCachedIntSetting( "forceShutdownMode", 0 );
             
             if( checkReadOnly() ) {
                 // read-only file system causes all kinds of weird 
@@ -7917,10 +8452,9 @@ int main() {
                     }
 
                 if( nextPlayer->connected ) {    
-                    nextPlayer->sock->send( 
-                        (unsigned char*)shutdownMessage, 
-                        messageLength,
-                        false, false );
+                    sendToSocket( nextPlayer->sock, 
+                                  (unsigned char*)shutdownMessage, 
+                                  messageLength );
                 
                     nextPlayer->gotPartOfThisFrame = true;
                     }
@@ -7952,11 +8486,14 @@ int main() {
         
 
         if( periodicStepThisStep ) {
+            startProfilePhase( PROFILE_PERIODIC );
             
             apocalypseStep();
             monumentStep();
             
-            //checkBackup();
+            startProfilePhase( PROFILE_BACKUP );
+            checkBackup();
+            endProfilePhase( PROFILE_BACKUP );
 
             stepFoodLog();
             stepFailureLog();
@@ -7964,6 +8501,8 @@ int main() {
             stepPlayerStats();
             stepLineageLog();
             stepCurseServerRequests();
+            
+            endProfilePhase( PROFILE_PERIODIC );
             }
         
         
@@ -7976,7 +8515,7 @@ int main() {
         // so that we wake up from listening to socket to handle it
         double minMoveTime = 999999;
         
-        double curTime = Time::getCurrentTime();
+        double curTime = getServerTime();
 
         for( int i=0; i<numLive; i++ ) {
             LiveObject *nextPlayer = players.getElement( i );
@@ -8085,8 +8624,6 @@ int main() {
             }
         
         
-        SocketOrServer *readySock =  NULL;
-
         double pollTimeout = 2;
         
         if( minMoveTime < pollTimeout ) {
@@ -8110,22 +8647,12 @@ int main() {
             }
 
         
-        char anyTicketServerRequestsOut = false;
-
-        for( int i=0; i<newConnections.size(); i++ ) {
-            
-            FreshConnection *nextConnection = newConnections.getElement( i );
-
-            if( nextConnection->ticketServerRequest != NULL ) {
-                anyTicketServerRequestsOut = true;
-                break;
-                }
-            }
+        // web requests wake us when their answers arrive, but we
+        // need to wake up for their timeouts
+        double webWaitLimit = getAsyncWebWaitLimit();
         
-        if( anyTicketServerRequestsOut ) {
-            // need to step outstanding ticket server web requests
-            // sleep a tiny amount of time to avoid cpu spin
-            pollTimeout = 0.01;
+        if( webWaitLimit != -1 && webWaitLimit < pollTimeout ) {
+            pollTimeout = webWaitLimit;
             }
 
 
@@ -8150,16 +8677,47 @@ int main() {
         // come in, and only wake up when some timed action needs to be
         // handled
         
-        readySock = sockPoll.wait( (int)( pollTimeout * 1000 ) );
+        startProfilePhase( PROFILE_WAIT );
+        
+        char serverReady;
         
+        if( replayingSession ) {
+            // jump clock ahead instead of waiting
+            serverReady = stepSessionReplay( pollTimeout );
+            
+            waitForSocketEvents( 0 );
+            }
+        else {
+            serverReady = 
+                waitForSocketEvents( (int)( pollTimeout * 1000 ) );
+            }
+        
+        double waitSeconds = endProfilePhase( PROFILE_WAIT );
+        
+        stepAsyncWeb();
+        
+        // before anything this step reads settings
+        stepSettingsCache();
+        
+        startProfilePhase( PROFILE_CONNECTIONS );
         
         
         
-        if( readySock != NULL && !readySock->isSocket ) {
+        
+        if( serverReady ) {
             // server ready
-            Socket *sock = server->acceptConnection( 0 );
+            Socket *sock;
+            
+            if( replayingSession ) {
+                sock = acceptReplayConnection();
+                }
+            else {
+                sock = server->acceptConnection( 0 );
+                }
 
             if( sock != NULL ) {
+                recordSessionConnect( sock );
+                
                 HostAddress *a = sock->getRemoteHostAddress();
                 
                 if( a == NULL ) {    
@@ -8175,7 +8733,7 @@ int main() {
                 FreshConnection newConnection;
                 
                 newConnection.connectionStartTimeSeconds = 
-                    Time::getCurrentTime();
+                    getServerTime();
 
                 newConnection.email = NULL;
 
@@ -8186,7 +8744,7 @@ int main() {
                 
 
                 char *secretString = 
-                    SettingsManager::getStringSetting( 
+                    getCachedStringSetting( 
                         "statsServerSharedSecret", "sdfmlk3490sadfm3ug9324" );
 
                 char *numberString = 
@@ -8211,16 +8769,19 @@ int main() {
                 newConnection.twinCode = NULL;
                 newConnection.twinCount = 0;
                 
+                newConnection.binaryProtocol = false;
+                newConnection.streamCompression = false;
+                
                 
                 nextSequenceNumber ++;
                 
-                SettingsManager::setSetting( "sequenceNumber",
-                                             (int)nextSequenceNumber );
+                setCachedSetting( "sequenceNumber",
+                                  (int)nextSequenceNumber );
                 
                 char *message;
                 
                 int maxPlayers = 
-                    SettingsManager::getIntSetting( "maxPlayers", 200 );
+                    getCachedIntSetting( "maxPlayers", 200 );
                 
                 int currentPlayers = players.size() + newConnections.size();
                     
@@ -8251,6 +8812,37 @@ int main() {
                     
                     newConnection.shutdownMode = true;
                     }         
+                else if( getCachedIntSetting( "binaryProtocol", 
+                                              1 ) ||
+                         getCachedIntSetting( "streamCompression",
+                                              1 ) ) {
+                    // extra lines offer binary protocol and stream
+                    // compression, 0 if not offered
+                    // older clients don't look past version line
+                    int binaryVersion = 0;
+                    int streamVersion = 0;
+                    
+                    if( getCachedIntSetting( "binaryProtocol", 
+                                             1 ) ) {
+                        binaryVersion = BINARY_PROTOCOL_VERSION;
+                        }
+                    if( getCachedIntSetting( "streamCompression", 
+                                             1 ) ) {
+                        streamVersion = STREAM_COMPRESSION_VERSION;
+                        }
+                    
+                    message = autoSprintf( "SN\n"
+                                           "%d/%d\n"
+                                           "%s\n"
+                                           "%lu\n"
+                                           "%d\n"
+                                           "%d\n#",
+                                           currentPlayers, maxPlayers,
+                                           newConnection.sequenceNumberString,
+                                           versionNumber,
+                                           binaryVersion, streamVersion );
+                    newConnection.shutdownMode = false;
+                    }
                 else {
                     message = autoSprintf( "SN\n"
                                            "%d/%d\n"
@@ -8272,9 +8864,9 @@ int main() {
                 int messageLength = strlen( message );
                 
                 int numSent = 
-                    sock->send( (unsigned char*)message, 
-                                messageLength, 
-                                false, false );
+                    sendToSocket( sock, 
+                                  (unsigned char*)message, 
+                                  messageLength );
                     
                 delete [] message;
                     
@@ -8292,7 +8884,7 @@ int main() {
                     newConnection.sockBuffer = new SimpleVector<char>();
                     
 
-                    sockPoll.addSocket( sock );
+                    addSocketToEvents( sock );
 
                     newConnections.push_back( newConnection );
                     }
@@ -8308,7 +8900,7 @@ int main() {
         
         
         // listen for messages from new connections
-        double currentTime = Time::getCurrentTime();
+        double currentTime = getServerTime();
         
         for( int i=0; i<newConnections.size(); i++ ) {
             
@@ -8332,16 +8924,7 @@ int main() {
                 }
             else if( nextConnection->ticketServerRequest != NULL ) {
                 
-                int result;
-
-                if( currentTime - nextConnection->ticketServerRequestStartTime
-                    < 8 ) {
-                    // 8-second timeout on ticket server requests
-                    result = nextConnection->ticketServerRequest->step();
-                    }
-                else {
-                    result = -1;
-                    }
+                int result = nextConnection->ticketServerRequest->step();
 
                 if( result == -1 ) {
                     AppLog::info( "Request to ticket server failed, "
@@ -8372,10 +8955,9 @@ int main() {
                         int messageLength = strlen( message );
                 
                         int numSent = 
-                            nextConnection->sock->send( 
-                                (unsigned char*)message, 
-                                messageLength, 
-                                false, false );
+                            sendToSocket( nextConnection->sock, 
+                                          (unsigned char*)message, 
+                                          messageLength );
                         
 
                         if( numSent != messageLength ) {
@@ -8392,6 +8974,12 @@ int main() {
                             
                             AppLog::info( "Got new player logged in" );
                             
+                            if( nextConnection->streamCompression ) {
+                                // everything after ACCEPTED
+                                startSocketStreamCompression( 
+                                    nextConnection->sock );
+                                }
+                            
                             delete nextConnection->ticketServerRequest;
                             nextConnection->ticketServerRequest = NULL;
 
@@ -8415,6 +9003,7 @@ int main() {
                                     nextConnection->email,
                                     nextConnection->tutorialNumber,
                                     nextConnection->curseStatus );
+                                setPlayerProtocol( nextConnection );
                                 }
                                                         
                             newConnections.deleteElement( i );
@@ -8435,15 +9024,19 @@ int main() {
                 }
             else {
 
-                double timeDelta = Time::getCurrentTime() -
+                double timeDelta = getServerTime() -
                     nextConnection->connectionStartTimeSeconds;
                 
 
                 
 
-                char result = 
-                    readSocketFull( nextConnection->sock,
-                                    nextConnection->sockBuffer );
+                char result = true;
+                
+                if( isSocketReadable( nextConnection->sock ) ) {
+                    result = readSocketFull( nextConnection->sock,
+                                             nextConnection->sockBuffer );
+                    markSocketRead( nextConnection->sock );
+                    }
                 
                 if( ! result ) {
                     AppLog::info( "Failed to read from client socket, "
@@ -8472,6 +9065,32 @@ int main() {
                         SimpleVector<char *> *tokens =
                             tokenizeString( message );
                         
+                        if( tokens->size() > 4 &&
+                            strcmp( tokens->getElementDirect( 
+                                        tokens->size() - 1 ),
+                                    STREAM_COMPRESSION_LOGIN_TOKEN ) == 0 ) {
+                            // client takes stream compression, always
+                            // last, after binary token
+                            nextConnection->streamCompression = true;
+                            
+                            delete [] tokens->getElementDirect( 
+                                tokens->size() - 1 );
+                            tokens->deleteElement( tokens->size() - 1 );
+                            }
+                        
+                        if( tokens->size() > 4 &&
+                            strcmp( tokens->getElementDirect( 
+                                        tokens->size() - 1 ),
+                                    BINARY_PROTOCOL_LOGIN_TOKEN ) == 0 ) {
+                            // client takes binary protocol, always
+                            // last, after any twin tokens
+                            nextConnection->binaryProtocol = true;
+                            
+                            delete [] tokens->getElementDirect( 
+                                tokens->size() - 1 );
+                            tokens->deleteElement( tokens->size() - 1 );
+                            }
+                        
                         if( tokens->size() == 4 || tokens->size() == 5 ||
                             tokens->size() == 7 ) {
                             
@@ -8497,7 +9116,7 @@ int main() {
                                         &( nextConnection->twinCount ) );
 
                                 int maxCount = 
-                                    SettingsManager::getIntSetting( 
+                                    getCachedIntSetting( 
                                         "maxTwinPartySize", 4 );
                                 
                                 if( nextConnection->twinCount > maxCount ) {
@@ -8583,11 +9202,11 @@ int main() {
 
                                 delete [] encodedEmail;
 
+                                // 8-second timeout on ticket server
+                                // requests
                                 nextConnection->ticketServerRequest =
-                                    new WebRequest( "GET", url, NULL );
-                                
-                                nextConnection->ticketServerRequestStartTime
-                                    = currentTime;
+                                    new AsyncWebRequest( "GET", url, NULL,
+                                                         8 );
 
                                 delete [] url;
                                 }
@@ -8600,10 +9219,9 @@ int main() {
                                 int messageLength = strlen( message );
                 
                                 int numSent = 
-                                    nextConnection->sock->send( 
-                                        (unsigned char*)message, 
-                                        messageLength, 
-                                        false, false );
+                                    sendToSocket( nextConnection->sock, 
+                                                  (unsigned char*)message, 
+                                                  messageLength );
                         
 
                                 if( numSent != messageLength ) {
@@ -8620,6 +9238,12 @@ int main() {
                             
                                     AppLog::info( "Got new player logged in" );
                                     
+                                    if( nextConnection->streamCompression ) {
+                                        // everything after ACCEPTED
+                                        startSocketStreamCompression( 
+                                            nextConnection->sock );
+                                        }
+                                    
                                     delete nextConnection->ticketServerRequest;
                                     nextConnection->ticketServerRequest = NULL;
                                     
@@ -8645,6 +9269,7 @@ int main() {
                                             nextConnection->email,
                                             nextConnection->tutorialNumber,
                                             nextConnection->curseStatus );
+                                        setPlayerProtocol( nextConnection );
                                         }
                                                                         
                                     newConnections.deleteElement( i );
@@ -8698,9 +9323,13 @@ int main() {
             FreshConnection *nextConnection = 
                 waitingForTwinConnections.getElement( i );
             
-            char result = 
-                readSocketFull( nextConnection->sock,
-                                nextConnection->sockBuffer );
+            char result = true;
+            
+            if( isSocketReadable( nextConnection->sock ) ) {
+                result = readSocketFull( nextConnection->sock,
+                                         nextConnection->sockBuffer );
+                markSocketRead( nextConnection->sock );
+                }
             
             if( ! result ) {
                 AppLog::info( "Failed to read from twin-waiting client socket, "
@@ -8731,16 +9360,16 @@ int main() {
                     // try sending REJECTED message at end
 
                     const char *message = "REJECTED\n#";
-                    nextConnection->sock->send( (unsigned char*)message,
-                                                strlen( message ), 
-                                                false, false );
+                    sendToSocket( nextConnection->sock, 
+                                  (unsigned char*)message, 
+                                  strlen( message ) );
 
                     AppLog::infoF( "Closing new connection on error "
                                    "(cause: %s)",
                                    nextConnection->errorCauseString );
 
                     if( nextConnection->sock != NULL ) {
-                        sockPoll.removeSocket( nextConnection->sock );
+                        removeSocketFromEvents( nextConnection->sock );
                         }
                     
                     deleteMembers( nextConnection );
@@ -8774,7 +9403,7 @@ int main() {
                            "%f total sec (loadID = %u )",
                            nextPlayer->email,
                            nextPlayer->tutorialLoad.stepCount,
-                           Time::getCurrentTime() - 
+                           getServerTime() - 
                            nextPlayer->tutorialLoad.startTime,
                            nextPlayer->tutorialLoad.uniqueLoadID );
 
@@ -8817,6 +9446,9 @@ int main() {
 
         
     
+        endProfilePhase( PROFILE_CONNECTIONS );
+        
+        
         someClientMessageReceived = false;
 
         numLive = players.size();
@@ -8872,7 +9504,9 @@ int main() {
 
 
         
-        timeSec_t curLookTime = Time::timeSec();
+        timeSec_t curLookTime = getServerTimeSec();
+        
+        startProfilePhase( PROFILE_MESSAGES );
         
         for( int i=0; i<numLive; i++ ) {
             LiveObject *nextPlayer = players.getElement( i );
@@ -8883,7 +9517,7 @@ int main() {
                 continue;
                 }            
 
-            double curCrossTime = Time::getCurrentTime();
+            double curCrossTime = getServerTime();
 
             char checkCrossing = true;
             
@@ -8962,11 +9596,11 @@ int main() {
                             // time set, so cutting it in half makes no sense
                         
                             int staggerTime = 
-                                SettingsManager::getIntSetting(
+                                getCachedIntSetting(
                                     "deathStaggerTime", 20 );
                         
                             double currentTime = 
-                                Time::getCurrentTime();
+                                getServerTime();
                         
                             nextPlayer->dying = true;
                             nextPlayer->dyingETA = 
@@ -8982,7 +9616,7 @@ int main() {
                         
                             // halve their remaining stagger time
                             double currentTime = 
-                                Time::getCurrentTime();
+                                getServerTime();
                         
                             double staggerTimeLeft = 
                                 nextPlayer->dyingETA - currentTime;
@@ -9092,9 +9726,26 @@ int main() {
 
             char *message = NULL;
             
-            if( nextPlayer->connected ) {    
-                char result = 
-                    readSocketFull( nextPlayer->sock, nextPlayer->sockBuffer );
+            if( nextPlayer->connected &&
+                didSocketSendFail( nextPlayer->sock ) ) {
+                // queued data couldn't be sent after all
+                setPlayerDisconnected( nextPlayer, "Socket write failed" );
+                }
+            
+            // while their outbound queue is backed up, leave their
+            // requests unread until they've received what we've already
+            // queued for them
+            if( nextPlayer->connected &&
+                ! isSocketBackedUp( nextPlayer->sock ) ) {    
+                char result = true;
+                
+                // skip sockets that haven't had data since last read
+                if( isSocketReadable( nextPlayer->sock ) ) {
+                    result = 
+                        readSocketFull( nextPlayer->sock, 
+                                        nextPlayer->sockBuffer );
+                    markSocketRead( nextPlayer->sock );
+                    }
             
                 if( ! result ) {
                     setPlayerDisconnected( nextPlayer, "Socket read failed" );
@@ -9114,6 +9765,7 @@ int main() {
                                nextPlayer->id, message );
                 
                 ClientMessage m = parseMessage( nextPlayer, message );
+                addProfileCount( PROFILE_MESSAGES_RECEIVED );
                 
                 delete [] message;
                 
@@ -9129,14 +9781,14 @@ int main() {
                 
                 if( m.type == BUG ) {
                     int allow = 
-                        SettingsManager::getIntSetting( "allowBugReports", 0 );
+                        getCachedIntSetting( "allowBugReports", 0 );
 
                     if( allow ) {
                         char *bugName = 
                             autoSprintf( "bug_%d_%d_%f",
                                          m.bug,
                                          nextPlayer->id,
-                                         Time::getCurrentTime() );
+                                         getServerTime() );
                         char *bugInfoName = autoSprintf( "%s_info.txt",
                                                          bugName );
                         char *bugOutName = autoSprintf( "%s_out.txt",
@@ -9166,7 +9818,7 @@ int main() {
                 else if( m.type == MAP ) {
                     
                     int allow = 
-                        SettingsManager::getIntSetting( "allowMapRequests", 0 );
+                        getCachedIntSetting( "allowMapRequests", 0 );
                     
 
                     if( allow ) {
@@ -9199,12 +9851,13 @@ int main() {
                                              chunkDimensionX,
                                              chunkDimensionY,
                                              nextPlayer->birthPos,
-                                             &length );
+                                             &length,
+                                             nextPlayer->binaryProtocol );
                         
                         int numSent = 
-                            nextPlayer->sock->send( mapChunkMessage, 
-                                                    length, 
-                                                    false, false );
+                            sendToSocket( nextPlayer->sock, 
+                                          mapChunkMessage, 
+                                          length );
                         
                         nextPlayer->gotPartOfThisFrame = true;
                         
@@ -9227,7 +9880,7 @@ int main() {
                     }
                 else if( m.type == VOGS ) {
                     int allow = 
-                        SettingsManager::getIntSetting( "allowVOGMode", 0 );
+                        getCachedIntSetting( "allowVOGMode", 0 );
 
                     if( allow ) {
                         
@@ -9491,7 +10144,7 @@ int main() {
                         if( adult != NULL ) {
                             
                             int babyBonesID = 
-                                SettingsManager::getIntSetting( 
+                                getCachedIntSetting( 
                                     "babyBones", -1 );
 
                             if( babyBonesID != -1 ) {
@@ -9740,9 +10393,8 @@ int main() {
                     // immediately send photo response
 
                     char *photoServerSharedSecret = 
-                        SettingsManager::
-                        getStringSetting( "photoServerSharedSecret",
-                                          "secret_phrase" );
+                        getCachedStringSetting( "photoServerSharedSecret",
+                                                "secret_phrase" );
                     
                     char *idString = autoSprintf( "%d", m.id );
                     
@@ -10279,7 +10931,7 @@ int main() {
                                         nextPlayer->moveTotalSeconds );
                                 */
                                 nextPlayer->moveStartTime = 
-                                    Time::getCurrentTime() - 
+                                    getServerTime() - 
                                     secondsAlreadyDone;
                             
                                 nextPlayer->newMove = true;
@@ -10287,12 +10939,12 @@ int main() {
                             }
                         }
                     else if( m.type == SAY && m.saidText != NULL &&
-                             Time::getCurrentTime() - 
+                             getServerTime() - 
                              nextPlayer->lastSayTimeSeconds > 
                              minSayGapInSeconds ) {
                         
                         nextPlayer->lastSayTimeSeconds = 
-                            Time::getCurrentTime();
+                            getServerTime();
 
                         unsigned int sayLimit = getSayLimit( nextPlayer );
                         
@@ -10660,11 +11312,11 @@ int main() {
                                         // if not already dying
                                         if( ! hitPlayer->dying ) {
                                             int staggerTime = 
-                                                SettingsManager::getIntSetting(
+                                                getCachedIntSetting(
                                                     "deathStaggerTime", 20 );
                                             
                                             double currentTime = 
-                                                Time::getCurrentTime();
+                                                getServerTime();
                                             
                                             hitPlayer->dying = true;
                                             hitPlayer->dyingETA = 
@@ -10685,7 +11337,7 @@ int main() {
                                              // halve their remaining 
                                              // stagger time
                                              double currentTime = 
-                                                 Time::getCurrentTime();
+                                                 getServerTime();
                                              
                                              double staggerTimeLeft = 
                                                  hitPlayer->dyingETA - 
@@ -10898,7 +11550,7 @@ int main() {
                                                 if( newDecayT != NULL ) {
                                                     hitPlayer->
                                                      embeddedWeaponEtaDecay = 
-                                                        Time::timeSec() + 
+                                                        getServerTimeSec() + 
                                                         newDecayT->
                                                         autoDecaySeconds;
                                                     }
@@ -11481,7 +12133,7 @@ int main() {
 
 
                                     nextPlayer->foodDecrementETASeconds =
-                                        Time::getCurrentTime() +
+                                        getServerTime() +
                                         computeFoodDecrementTimeSeconds( 
                                             nextPlayer );
                                     
@@ -11797,7 +12449,7 @@ int main() {
                                         
                                         // reset their food decrement time
                                         hitPlayer->foodDecrementETASeconds =
-                                            Time::getCurrentTime() +
+                                            getServerTime() +
                                             computeFoodDecrementTimeSeconds( 
                                                 hitPlayer );
 
@@ -12115,7 +12767,7 @@ int main() {
                                         targetPlayer->foodStore = cap;
                                         }
                                     targetPlayer->foodDecrementETASeconds =
-                                        Time::getCurrentTime() +
+                                        getServerTime() +
                                         computeFoodDecrementTimeSeconds( 
                                             targetPlayer );
                                     
@@ -12809,12 +13461,11 @@ int main() {
                         // ignore new EMOT requres from player if emot
                         // frozen
                         
-                        if( m.i <= SettingsManager::getIntSetting( 
+                        if( m.i <= getCachedIntSetting( 
                                 "allowedEmotRange", 6 ) ) {
                             
                             SimpleVector<int> *forbidden =
-                                SettingsManager::getIntSettingMulti( 
-                                    "forbiddenEmots" );
+                                getCachedIntSettingMulti( "forbiddenEmots" );
                             
                             if( forbidden->getElementIndex( m.i ) == -1 ) {
                                 // not forbidden
@@ -12846,6 +13497,11 @@ int main() {
 
 
         // now that messages have been processed for all
+        endProfilePhase( PROFILE_MESSAGES );
+        
+
+        startProfilePhase( PROFILE_PLAYER_STEP );
+        
         // loop over and handle all post-message checks
 
         // for example, if a player later in the list sends a message
@@ -12854,7 +13510,7 @@ int main() {
         for( int i=0; i<numLive; i++ ) {
             LiveObject *nextPlayer = players.getElement( i );
             
-            double curTime = Time::getCurrentTime();
+            double curTime = getServerTime();
             
             if( nextPlayer->dying && ! nextPlayer->error &&
                 curTime >= nextPlayer->dyingETA ) {
@@ -12929,7 +13585,7 @@ int main() {
                 nextPlayer->deleteSent = true;
                 // wait 5 seconds before closing their connection
                 // so they can get the message
-                nextPlayer->deleteSentDoneETA = Time::getCurrentTime() + 5;
+                nextPlayer->deleteSentDoneETA = getServerTime() + 5;
                 
                 if( areTriggersEnabled() ) {
                     // add extra time so that rest of triggers can be received
@@ -12946,7 +13602,7 @@ int main() {
                 else {
                     if( nextPlayer->sock != NULL ) {
                         // stop listening for activity on this socket
-                        sockPoll.removeSocket( nextPlayer->sock );
+                        removeSocketFromEvents( nextPlayer->sock );
                         }
                     }
                 
@@ -13216,7 +13872,7 @@ int main() {
                             }
                         
                         // room for what clothing contained
-                        timeSec_t curTime = Time::timeSec();
+                        timeSec_t curTime = getServerTimeSec();
                         
                         for( int c=0; c < NUM_CLOTHING_PIECES && roomLeft > 0; 
                              c++ ) {
@@ -13430,7 +14086,7 @@ int main() {
                                 
                                     if( newDecayT != NULL ) {
                                         newDecay = 
-                                            Time::timeSec() +
+                                            getServerTimeSec() +
                                             newDecayT->autoDecaySeconds /
                                             stretch;
                                         }
@@ -13495,7 +14151,7 @@ int main() {
                                 
                                         if( newSubDecayT != NULL ) {
                                             newSubDecay = 
-                                                Time::timeSec() +
+                                                getServerTimeSec() +
                                                 newSubDecayT->autoDecaySeconds /
                                                 subStretch;
                                             }
@@ -13586,7 +14242,7 @@ int main() {
                                 
                                 if( newDecayT != NULL ) {
                                     nextPlayer->clothingEtaDecay[c] = 
-                                        Time::timeSec() + 
+                                        getServerTimeSec() + 
                                         newDecayT->autoDecaySeconds;
                                     }
                                 else {
@@ -13611,7 +14267,7 @@ int main() {
                                 // truncate
                                 
                                 // drop extras onto map
-                                timeSec_t curTime = Time::timeSec();
+                                timeSec_t curTime = getServerTimeSec();
                                 float stretch = cObj->slotTimeStretch;
                                 
                                 GridPos dropPos = 
@@ -13685,7 +14341,7 @@ int main() {
                                 }
                             
                             if( oldStretch != newStretch ) {
-                                timeSec_t curTime = Time::timeSec();
+                                timeSec_t curTime = getServerTimeSec();
                                 
                                 for( int cc=0;
                                      cc < nextPlayer->
@@ -13764,7 +14420,7 @@ int main() {
                                         
                                         if( newDecayT != NULL ) {
                                             newDecay = 
-                                                Time::timeSec() +
+                                                getServerTimeSec() +
                                                 newDecayT->
                                                 autoDecaySeconds /
                                                 cObj->slotTimeStretch;
@@ -13814,7 +14470,7 @@ int main() {
                     // even if they have come to an end time-wise
                     // wait until after we've told everyone about them
                     if( ! nextPlayer->newMove && 
-                        Time::getCurrentTime() - nextPlayer->moveStartTime
+                        getServerTime() - nextPlayer->moveStartTime
                         >
                         nextPlayer->moveTotalSeconds ) {
                         
@@ -13988,7 +14644,7 @@ int main() {
                     }
                 
                 // check if we need to decrement their food
-                double curTime = Time::getCurrentTime();
+                double curTime = getServerTime();
                 
                 if( ! nextPlayer->vogMode &&
                     curTime > 
@@ -14119,29 +14775,33 @@ int main() {
 
         if( playerIndicesToSendUpdatesAbout.size() > 0 ) {
             
-            SimpleVector<char> updateList;
+            SimpleVector<int> updateIDs;
         
             for( int i=0; i<playerIndicesToSendUpdatesAbout.size(); i++ ) {
                 LiveObject *nextPlayer = players.getElement( 
                     playerIndicesToSendUpdatesAbout.getElementDirect( i ) );
                 
-                char *playerString = autoSprintf( "%d, ", nextPlayer->id );
-                updateList.appendElementString( playerString );
-                
-                delete [] playerString;
+                updateIDs.push_back( nextPlayer->id );
                 }
             
-            char *updateListString = updateList.getElementString();
+            // formatted off main thread
+            AsyncLogRecord r;
+            clearAsyncLogRecord( &r );
             
-            AppLog::infoF( "Need to send updates about these %d players: %s",
-                           playerIndicesToSendUpdatesAbout.size(),
-                           updateListString );
-            delete [] updateListString;
+            r.intList = updateIDs.getElement( 0 );
+            r.intListLength = updateIDs.size();
+            
+            asyncLog( updateListLogType, &r );
             }
         
 
 
-        double currentTimeHeat = Time::getCurrentTime();
+        endProfilePhase( PROFILE_PLAYER_STEP );
+        
+
+        startProfilePhase( PROFILE_HEAT );
+        
+        double currentTimeHeat = getServerTime();
         
         if( currentTimeHeat - lastHeatUpdateTime >= heatUpdateTimeStep ) {
             // a heat step has passed
@@ -14165,6 +14825,31 @@ int main() {
                 // start over
                 lastPlayerIndexHeatRecomputed = -1;
                 }
+            
+
+            // don't wait for turn for players that moved, or that have 
+            // something change around them
+            // (cells come from shared heat field, so this is cheap)
+            for( int i=0; i<players.size(); i++ ) {
+                LiveObject *nextPlayer = players.getElement( i );
+                
+                if( nextPlayer->error ) {
+                    continue;
+                    }
+                
+                GridPos center = getHeatMapCenter( nextPlayer );
+                
+                if( nextPlayer->heatFieldStamp == 0 ||
+                    ! equal( center, nextPlayer->heatMapCenter ) ||
+                    getHeatFieldStamp( center.x - HEAT_MAP_D / 2,
+                                       center.y - HEAT_MAP_D / 2,
+                                       HEAT_MAP_D, HEAT_MAP_D ) != 
+                    nextPlayer->heatFieldStamp ) {
+                    
+                    recomputeHeatMap( nextPlayer );
+                    }
+                }
+            
             lastHeatUpdateTime = currentTimeHeat;
             }
         
@@ -14173,7 +14858,7 @@ int main() {
 
         // update personal heat value of any player that is due
         // once every 2 seconds
-        currentTime = Time::getCurrentTime();
+        currentTime = getServerTime();
         for( int i=0; i< players.size(); i++ ) {
             LiveObject *nextPlayer = players.getElement( i );
             
@@ -14330,7 +15015,10 @@ int main() {
             nextPlayer->lastHeatUpdate = currentTime;
             }
         
+        endProfilePhase( PROFILE_HEAT );
+        
 
+        startProfilePhase( PROFILE_UPDATES );
         
         for( int i=0; i<playerIndicesToSendUpdatesAbout.size(); i++ ) {
             LiveObject *nextPlayer = players.getElement( 
@@ -14364,7 +15052,7 @@ int main() {
 
             if( nextPlayer->posForced &&
                 nextPlayer->connected &&
-                SettingsManager::getIntSetting( "requireClientForceAck", 1 ) ) {
+                getCachedIntSetting( "requireClientForceAck", 1 ) ) {
                 // block additional moves/actions from this player until
                 // we get a FORCE response, syncing them up with
                 // their forced position.
@@ -14428,7 +15116,17 @@ int main() {
 
         // add changes from auto-decays on map, 
         // mixed with player-caused changes
+        // no one moves, joins, or leaves from here until changes
+        // are sent out below
+        buildPlayerGrid();
+        
+        endProfilePhase( PROFILE_UPDATES );
+        
+        startProfilePhase( PROFILE_STEP_MAP );
         stepMap( &mapChanges, &mapChangesPos );
+        endProfilePhase( PROFILE_STEP_MAP );
+        
+        startProfilePhase( PROFILE_FORMAT );
         
         
 
@@ -14812,12 +15510,49 @@ int main() {
 
 
         
+        endProfilePhase( PROFILE_FORMAT );
+        
+        
         // send moves and updates to clients
         
+        startProfilePhase( PROFILE_SENDS );
+        
+        fillChangeGrid( &newUpdatesGrid, &newUpdatesPos );
+        fillChangeGrid( &movesGrid, &movesPos );
+        fillChangeGrid( &mapChangesGrid, &mapChangesPos );
+        fillChangeGrid( &newSpeechGrid, &newSpeechPos );
+        fillChangeGrid( &newLocationSpeechGrid, &newLocationSpeechPos );
+        
+        // indices of changes near player, reused for each player
+        SimpleVector<int> nearbyChanges;
         
         SimpleVector<int> playersReceivingPlayerUpdate;
         
 
+        // read cells of map chunks that players will be sent below now,
+        // so chunk workers can compress them while we send everything
+        // else
+        for( int i=0; i<numLive; i++ ) {
+            
+            LiveObject *nextPlayer = players.getElement(i);
+            
+            if( ! nextPlayer->firstMessageSent ) {
+                startMapChunkJobs( nextPlayer );
+                }
+            else {
+                int playerXD, playerYD;
+                getMapChunkCenter( nextPlayer, &playerXD, &playerYD );
+                
+                if( needsMapChunk( nextPlayer, playerXD, playerYD ) ) {
+                    startMapChunkJobs( nextPlayer,
+                                       nextPlayer->heldByOther,
+                                       playerXD,
+                                       playerYD );
+                    }
+                }
+            }
+        
+
         for( int i=0; i<numLive; i++ ) {
             
             LiveObject *nextPlayer = players.getElement(i);
@@ -15338,25 +16073,11 @@ int main() {
 
                 
 
-                int playerXD = nextPlayer->xd;
-                int playerYD = nextPlayer->yd;
-                
-                if( nextPlayer->heldByOther ) {
-                    LiveObject *holdingPlayer = 
-                        getLiveObject( nextPlayer->heldByOtherID );
-                
-                    if( holdingPlayer != NULL ) {
-                        playerXD = holdingPlayer->xd;
-                        playerYD = holdingPlayer->yd;
-                        }
-                    }
+                int playerXD, playerYD;
+                getMapChunkCenter( nextPlayer, &playerXD, &playerYD );
 
 
-                if( abs( playerXD - nextPlayer->lastSentMapX ) > 7
-                    ||
-                    abs( playerYD - nextPlayer->lastSentMapY ) > 8 
-                    ||
-                    ! nextPlayer->firstMapSent ) {
+                if( needsMapChunk( nextPlayer, playerXD, playerYD ) ) {
                 
                     // moving out of bounds of chunk, send update
                     // or player flagged as needing first map again
@@ -15529,10 +16250,9 @@ int main() {
                 // are holding post-wound come later                
                 if( dyingMessage != NULL && nextPlayer->connected ) {
                     int numSent = 
-                        nextPlayer->sock->send( 
-                            dyingMessage, 
-                            dyingMessageLength, 
-                            false, false );
+                        sendToSocket( nextPlayer->sock, 
+                                      dyingMessage, 
+                                      dyingMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
 
@@ -15546,10 +16266,9 @@ int main() {
                 // EVERYONE gets info about now-healed players           
                 if( healingMessage != NULL && nextPlayer->connected ) {
                     int numSent = 
-                        nextPlayer->sock->send( 
-                            healingMessage, 
-                            healingMessageLength, 
-                            false, false );
+                        sendToSocket( nextPlayer->sock, 
+                                      healingMessage, 
+                                      healingMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -15563,10 +16282,9 @@ int main() {
                 // EVERYONE gets info about emots           
                 if( emotMessage != NULL && nextPlayer->connected ) {
                     int numSent = 
-                        nextPlayer->sock->send( 
-                            emotMessage, 
-                            emotMessageLength, 
-                            false, false );
+                        sendToSocket( nextPlayer->sock, 
+                                      emotMessage, 
+                                      emotMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -15586,8 +16304,12 @@ int main() {
                     // greater than maxDis but within maxDist2
                     SimpleVector<int> middleDistancePlayerIDs;
                     
+                    newUpdatesGrid.getNearby( playerXD, playerYD, 
+                                              (int)maxDist2,
+                                              &nearbyChanges );
 
-                    for( int u=0; u<newUpdatesPos.size(); u++ ) {
+                    for( int n=0; n<nearbyChanges.size(); n++ ) {
+                        int u = nearbyChanges.getElementDirect( n );
                         ChangePosition *p = newUpdatesPos.getElement( u );
                         
                         // update messages can be global when a new
@@ -15619,7 +16341,15 @@ int main() {
                         int updateMessageLength = 0;
                         SimpleVector<char> updateChars;
                         
-                        for( int u=0; u<newUpdates.size(); u++ ) {
+                        binaryLinesWriter.reset();
+                        int numBinaryLines = 0;
+
+                        newUpdatesGrid.getNearby( playerXD, playerYD, 
+                                                  (int)maxDist,
+                                                  &nearbyChanges );
+
+                        for( int n=0; n<nearbyChanges.size(); n++ ) {
+                            int u = nearbyChanges.getElementDirect( n );
                             ChangePosition *p = newUpdatesPos.getElement( u );
                         
                             double d = intDist( p->x, p->y, 
@@ -15630,6 +16360,16 @@ int main() {
                                 continue;
                                 }
                             
+                            if( nextPlayer->binaryProtocol ) {
+                                writeBinaryUpdateLine( 
+                                    &binaryLinesWriter,
+                                    newUpdates.getElement( u ),
+                                    nextPlayer->birthPos,
+                                    getPlayerPos( nextPlayer ) );
+                                numBinaryLines++;
+                                continue;
+                                }
+
                             char *line =
                                 getUpdateLineFromRecord( 
                                     newUpdates.getElement( u ),
@@ -15641,7 +16381,12 @@ int main() {
                             }
                         
 
-                        if( updateChars.size() > 0 ) {
+                        if( numBinaryLines > 0 ) {
+                            updateMessage = makeBinaryMessage( 
+                                BINARY_PLAYER_UPDATE, numBinaryLines,
+                                &binaryLinesWriter, &updateMessageLength );
+                            }
+                        else if( updateChars.size() > 0 ) {
                             updateChars.push_back( '#' );
                             char *temp = updateChars.getElementString();
 
@@ -15669,10 +16414,9 @@ int main() {
                                 nextPlayer->id );
                             
                             int numSent = 
-                                nextPlayer->sock->send( 
-                                    updateMessage, 
-                                    updateMessageLength, 
-                                    false, false );
+                                sendToSocket( nextPlayer->sock, 
+                                              updateMessage, 
+                                              updateMessageLength );
                             
                             nextPlayer->gotPartOfThisFrame = true;
                             
@@ -15732,10 +16476,9 @@ int main() {
                             }
                         
                         int numSent = 
-                            nextPlayer->sock->send( 
-                                outOfRangeMessage, 
-                                outOfRangeMessageLength, 
-                                false, false );
+                            sendToSocket( nextPlayer->sock, 
+                                          outOfRangeMessage, 
+                                          outOfRangeMessageLength );
                         
                         nextPlayer->gotPartOfThisFrame = true;
 
@@ -15755,7 +16498,11 @@ int main() {
                     
                     double minUpdateDist = 64;
                     
-                    for( int u=0; u<movesPos.size(); u++ ) {
+                    movesGrid.getNearby( playerXD, playerYD, (int)maxDist,
+                                         &nearbyChanges );
+
+                    for( int n=0; n<nearbyChanges.size(); n++ ) {
+                        int u = nearbyChanges.getElementDirect( n );
                         ChangePosition *p = movesPos.getElement( u );
                         
                         // move messages are never global
@@ -15775,7 +16522,12 @@ int main() {
                         
                         SimpleVector<MoveRecord> closeMoves;
                         
-                        for( int u=0; u<movesPos.size(); u++ ) {
+                        movesGrid.getNearby( playerXD, playerYD, 
+                                             (int)maxDist,
+                                             &nearbyChanges );
+
+                        for( int n=0; n<nearbyChanges.size(); n++ ) {
+                            int u = nearbyChanges.getElementDirect( n );
                             ChangePosition *p = movesPos.getElement( u );
                             
                             // move messages are never global
@@ -15812,10 +16564,9 @@ int main() {
                                 }
 
                             int numSent = 
-                                nextPlayer->sock->send( 
-                                    moveMessage, 
-                                    moveMessageLength, 
-                                    false, false );
+                                sendToSocket( nextPlayer->sock, 
+                                              moveMessage, 
+                                              moveMessageLength );
                             
                             nextPlayer->gotPartOfThisFrame = true;
                             
@@ -15834,7 +16585,12 @@ int main() {
                 if( mapChanges.size() > 0 && nextPlayer->connected ) {
                     double minUpdateDist = 64;
                     
-                    for( int u=0; u<mapChangesPos.size(); u++ ) {
+                    mapChangesGrid.getNearby( playerXD, playerYD, 
+                                              (int)maxDist,
+                                              &nearbyChanges );
+
+                    for( int n=0; n<nearbyChanges.size(); n++ ) {
+                        int u = nearbyChanges.getElementDirect( n );
                         ChangePosition *p = mapChangesPos.getElement( u );
                         
                         // map changes are never global
@@ -15858,7 +16614,11 @@ int main() {
                         int mapChangeMessageLength = 0;
                         SimpleVector<char> mapChangeChars;
 
-                        for( int u=0; u<mapChanges.size(); u++ ) {
+                        binaryLinesWriter.reset();
+                        int numBinaryLines = 0;
+
+                        for( int n=0; n<nearbyChanges.size(); n++ ) {
+                            int u = nearbyChanges.getElementDirect( n );
                             ChangePosition *p = mapChangesPos.getElement( u );
                         
                             double d = intDist( p->x, p->y, 
@@ -15871,6 +16631,16 @@ int main() {
                             MapChangeRecord *r = 
                                 mapChanges.getElement( u );
                             
+                            if( nextPlayer->binaryProtocol ) {
+                                writeBinaryMapChangeLine( 
+                                    &binaryLinesWriter,
+                                    r,
+                                    nextPlayer->birthPos.x,
+                                    nextPlayer->birthPos.y );
+                                numBinaryLines++;
+                                continue;
+                                }
+
                             char *lineString =
                                 getMapChangeLineString( 
                                     r,
@@ -15882,7 +16652,12 @@ int main() {
                             }
                         
                         
-                        if( mapChangeChars.size() > 0 ) {
+                        if( numBinaryLines > 0 ) {
+                            mapChangeMessage = makeBinaryMessage( 
+                                BINARY_MAP_CHANGE, numBinaryLines,
+                                &binaryLinesWriter, &mapChangeMessageLength );
+                            }
+                        else if( mapChangeChars.size() > 0 ) {
                             mapChangeChars.push_back( '#' );
                             char *temp = mapChangeChars.getElementString();
 
@@ -15912,10 +16687,9 @@ int main() {
                         if( mapChangeMessage != NULL ) {
 
                             int numSent = 
-                                nextPlayer->sock->send( 
-                                    mapChangeMessage, 
-                                    mapChangeMessageLength, 
-                                    false, false );
+                                sendToSocket( nextPlayer->sock, 
+                                              mapChangeMessage, 
+                                              mapChangeMessageLength );
                             
                             nextPlayer->gotPartOfThisFrame = true;
                             
@@ -15931,7 +16705,12 @@ int main() {
                 if( speechMessage != NULL && nextPlayer->connected ) {
                     double minUpdateDist = 64;
                     
-                    for( int u=0; u<newSpeechPos.size(); u++ ) {
+                    newSpeechGrid.getNearby( playerXD, playerYD, 
+                                             (int)maxDist,
+                                             &nearbyChanges );
+
+                    for( int n=0; n<nearbyChanges.size(); n++ ) {
+                        int u = nearbyChanges.getElementDirect( n );
                         ChangePosition *p = newSpeechPos.getElement( u );
                         
                         // speech never global
@@ -15946,10 +16725,9 @@ int main() {
 
                     if( minUpdateDist <= maxDist ) {
                         int numSent = 
-                            nextPlayer->sock->send( 
-                                speechMessage, 
-                                speechMessageLength, 
-                                false, false );
+                            sendToSocket( nextPlayer->sock, 
+                                          speechMessage, 
+                                          speechMessageLength );
                         
                         nextPlayer->gotPartOfThisFrame = true;
                         
@@ -15964,7 +16742,12 @@ int main() {
                 if( newLocationSpeech.size() > 0 && nextPlayer->connected ) {
                     double minUpdateDist = 64;
                     
-                    for( int u=0; u<newLocationSpeechPos.size(); u++ ) {
+                    newLocationSpeechGrid.getNearby( playerXD, playerYD, 
+                                                     (int)maxDist,
+                                                     &nearbyChanges );
+
+                    for( int n=0; n<nearbyChanges.size(); n++ ) {
+                        int u = nearbyChanges.getElementDirect( n );
                         ChangePosition *p = 
                             newLocationSpeechPos.getElement( u );
                         
@@ -16019,10 +16802,9 @@ int main() {
                             }
 
                         int numSent = 
-                            nextPlayer->sock->send( 
-                                (unsigned char*)message,
-                                len, 
-                                false, false );
+                            sendToSocket( nextPlayer->sock, 
+                                          (unsigned char*)message, 
+                                          len );
                         
                         delete [] message;
                         
@@ -16045,7 +16827,28 @@ int main() {
         
                     SimpleVector<char> deleteUpdateChars;
                 
-                    for( int u=0; u<newDeleteUpdates.size(); u++ ) {
+                    if( nextPlayer->binaryProtocol &&
+                        newDeleteUpdates.size() > 0 ) {
+                        
+                        binaryLinesWriter.reset();
+
+                        for( int u=0; u<newDeleteUpdates.size(); u++ ) {
+                            writeBinaryUpdateLine( 
+                                &binaryLinesWriter,
+                                newDeleteUpdates.getElement( u ),
+                                nextPlayer->birthPos,
+                                getPlayerPos( nextPlayer ) );
+                            }
+                        
+                        deleteUpdateMessage = makeBinaryMessage( 
+                            BINARY_PLAYER_UPDATE, newDeleteUpdates.size(),
+                            &binaryLinesWriter, &deleteUpdateMessageLength );
+                        }
+
+                    for( int u=0; 
+                         u<newDeleteUpdates.size() && 
+                             deleteUpdateMessage == NULL; 
+                         u++ ) {
                     
                         char *line = getUpdateLineFromRecord(
                             newDeleteUpdates.getElement( u ),
@@ -16086,10 +16889,9 @@ int main() {
 
                     if( deleteUpdateMessage != NULL ) {
                         int numSent = 
-                            nextPlayer->sock->send( 
-                                deleteUpdateMessage, 
-                                deleteUpdateMessageLength, 
-                                false, false );
+                            sendToSocket( nextPlayer->sock, 
+                                          deleteUpdateMessage, 
+                                          deleteUpdateMessageLength );
                     
                         nextPlayer->gotPartOfThisFrame = true;
                     
@@ -16107,10 +16909,9 @@ int main() {
                 // EVERYONE gets lineage info for new babies
                 if( lineageMessage != NULL && nextPlayer->connected ) {
                     int numSent = 
-                        nextPlayer->sock->send( 
-                            lineageMessage, 
-                            lineageMessageLength, 
-                            false, false );
+                        sendToSocket( nextPlayer->sock, 
+                                      lineageMessage, 
+                                      lineageMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -16124,10 +16925,9 @@ int main() {
                 // EVERYONE gets curse info for new babies
                 if( cursesMessage != NULL && nextPlayer->connected ) {
                     int numSent = 
-                        nextPlayer->sock->send( 
-                            cursesMessage, 
-                            cursesMessageLength, 
-                            false, false );
+                        sendToSocket( nextPlayer->sock, 
+                                      cursesMessage, 
+                                      cursesMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -16140,10 +16940,9 @@ int main() {
                 // EVERYONE gets newly-given names
                 if( namesMessage != NULL && nextPlayer->connected ) {
                     int numSent = 
-                        nextPlayer->sock->send( 
-                            namesMessage, 
-                            namesMessageLength, 
-                            false, false );
+                        sendToSocket( nextPlayer->sock, 
+                                      namesMessage, 
+                                      namesMessageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -16190,10 +16989,9 @@ int main() {
                         int messageLength = strlen( foodMessage );
                         
                         int numSent = 
-                            nextPlayer->sock->send( 
-                                (unsigned char*)foodMessage, 
-                                messageLength,
-                                false, false );
+                            sendToSocket( nextPlayer->sock, 
+                                          (unsigned char*)foodMessage, 
+                                          messageLength );
                         
                         nextPlayer->gotPartOfThisFrame = true;
                         
@@ -16223,10 +17021,9 @@ int main() {
                     int messageLength = strlen( heatMessage );
                     
                     int numSent = 
-                         nextPlayer->sock->send( 
-                             (unsigned char*)heatMessage, 
-                             messageLength,
-                             false, false );
+                         sendToSocket( nextPlayer->sock, 
+                                       (unsigned char*)heatMessage, 
+                                       messageLength );
                     
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -16252,10 +17049,9 @@ int main() {
                     int messageLength = strlen( tokenMessage );
                     
                     int numSent = 
-                         nextPlayer->sock->send( 
-                             (unsigned char*)tokenMessage, 
-                             messageLength,
-                             false, false );
+                         sendToSocket( nextPlayer->sock, 
+                                       (unsigned char*)tokenMessage, 
+                                       messageLength );
 
                     nextPlayer->gotPartOfThisFrame = true;
                     
@@ -16272,6 +17068,12 @@ int main() {
             }
 
 
+        // chunks started for players that didn't end up being sent them
+        for( int i=0; i<players.size(); i++ ) {
+            discardPendingChunkJobs( players.getElement( i ) );
+            }
+        
+
         for( int u=0; u<moveList.size(); u++ ) {
             MoveRecord *r = moveList.getElement( u );
             delete [] r->formatString;
@@ -16282,40 +17084,37 @@ int main() {
         for( int u=0; u<mapChanges.size(); u++ ) {
             MapChangeRecord *r = mapChanges.getElement( u );
             delete [] r->formatString;
+            delete [] r->binaryBody;
             }
 
         if( newUpdates.size() > 0 ) {
             
-            SimpleVector<char> playerList;
+            // formatted off main thread
+            AsyncLogRecord r;
+            clearAsyncLogRecord( &r );
             
-            for( int i=0; i<playersReceivingPlayerUpdate.size(); i++ ) {
-                char *playerString = 
-                    autoSprintf( 
-                        "%d, ",
-                        playersReceivingPlayerUpdate.getElementDirect( i ) );
-                playerList.appendElementString( playerString );
-                delete [] playerString;
-                }
+            r.ints[0] = numLive;
+            r.ints[1] = newUpdates.size();
             
-            char *playerListString = playerList.getElementString();
-
-            AppLog::infoF( "%d/%d players were sent part of a %d-line PU: %s",
-                           playersReceivingPlayerUpdate.size(),
-                           numLive, newUpdates.size(),
-                           playerListString );
+            if( playersReceivingPlayerUpdate.size() > 0 ) {
+                r.intList = playersReceivingPlayerUpdate.getElement( 0 );
+                r.intListLength = playersReceivingPlayerUpdate.size();
+                }
             
-            delete [] playerListString;
+            asyncLog( sentUpdateLogType, &r );
             }
         
 
         for( int u=0; u<newUpdates.size(); u++ ) {
             UpdateRecord *r = newUpdates.getElement( u );
             delete [] r->formatString;
+            delete [] r->binaryBody;
             }
         
         for( int u=0; u<newDeleteUpdates.size(); u++ ) {
             UpdateRecord *r = newDeleteUpdates.getElement( u );
             delete [] r->formatString;
+            delete [] r->binaryBody;
             }
 
         
@@ -16344,6 +17143,8 @@ int main() {
         
         // this one is global, so we must clear it every loop
         newSpeech.deleteAll();
+        clearPlayerGrid();
+
         newSpeechPos.deleteAll();
         
         newLocationSpeech.deallocateStringElements();
@@ -16352,6 +17153,11 @@ int main() {
         newOwnerStrings.deallocateStringElements();
         
         
+        endProfilePhase( PROFILE_SENDS );
+        
+        
+        startProfilePhase( PROFILE_CLEANUP );
+        
         // handle end-of-frame for all players that need it
         const char *frameMessage = "FM\n#";
         int frameMessageLength = strlen( frameMessage );
@@ -16361,10 +17167,9 @@ int main() {
             
             if( nextPlayer->gotPartOfThisFrame && nextPlayer->connected ) {
                 int numSent = 
-                    nextPlayer->sock->send( 
-                        (unsigned char*)frameMessage, 
-                        frameMessageLength,
-                        false, false );
+                    sendToSocket( nextPlayer->sock, 
+                                  (unsigned char*)frameMessage, 
+                                  frameMessageLength );
 
                 if( numSent != frameMessageLength ) {
                     setPlayerDisconnected( nextPlayer, "Socket write failed" );
@@ -16393,7 +17198,7 @@ int main() {
             
 
             if( nextPlayer->error && nextPlayer->deleteSent &&
-                nextPlayer->deleteSentDoneETA < Time::getCurrentTime() ) {
+                nextPlayer->deleteSentDoneETA < getServerTime() ) {
                 AppLog::infoF( "Closing connection to player %d on error "
                                "(cause: %s)",
                                nextPlayer->id, nextPlayer->errorCauseString );
@@ -16404,7 +17209,7 @@ int main() {
                 addPastPlayer( nextPlayer );
 
                 if( nextPlayer->sock != NULL ) {
-                    sockPoll.removeSocket( nextPlayer->sock );
+                    removeSocketFromEvents( nextPlayer->sock );
                 
                     delete nextPlayer->sock;
                     nextPlayer->sock = NULL;
@@ -16463,6 +17268,12 @@ int main() {
                 quit = true;
                 }
             }
+        
+        endProfilePhase( PROFILE_CLEANUP );
+        
+        recordProfilePhase( PROFILE_STEP, 
+                            Time::getCurrentTime() - stepStartTime - 
+                            waitSeconds );
         }
     
     // stop listening on server socket immediately, before running
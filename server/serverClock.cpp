@@ -0,0 +1,35 @@
+#include "serverClock.h"
+
+#include <math.h>
+
+
+
+static char virtualClock = false;
+
+static double virtualTime = 0;
+
+
+
+double getServerTime() {
+    if( virtualClock ) {
+        return virtualTime;
+        }
+    return Time::getCurrentTime();
+    }
+
+
+
+timeSec_t getServerTimeSec() {
+    if( virtualClock ) {
+        // whole seconds, like Time::timeSec
+        return (timeSec_t)floor( virtualTime );
+        }
+    return Time::timeSec();
+    }
+
+
+
+void setServerVirtualTime( double inTime ) {
+    virtualClock = true;
+    virtualTime = inTime;
+    }
@@ -0,0 +1,25 @@
+#ifndef SERVER_CLOCK_H_INCLUDED
+#define SERVER_CLOCK_H_INCLUDED
+
+
+#include "minorGems/system/Time.h"
+
+
+// Clock read by game logic in server.cpp and map.cpp.
+//
+// Same as Time::getCurrentTime and Time::timeSec, except while a session
+// is being replayed (see sessionReplay.h), when it runs on virtual time
+// that the replay moves forward.
+
+
+double getServerTime();
+
+timeSec_t getServerTimeSec();
+
+
+// switches clock to virtual time, starting at inTime, in seconds since
+// the epoch, like Time::getCurrentTime
+void setServerVirtualTime( double inTime );
+
+
+#endif
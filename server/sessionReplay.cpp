@@ -0,0 +1,686 @@
+#include "sessionReplay.h"
+#include "serverClock.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+#include "minorGems/util/SettingsManager.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/system/Time.h"
+
+#include "minorGems/util/log/AppLog.h"
+
+
+#ifndef _WIN32
+
+#define SESSION_REPLAY_SOCKET_PAIRS
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#endif
+
+
+
+// op, connection number, time, data length
+#define SESSION_RECORD_HEADER_BYTES 17
+
+// records that claim more data than this are treated as corrupt
+#define SESSION_RECORD_MAX_DATA 16777216
+
+#define RECORD_SETTING_CHECK_SECONDS 10
+
+// virtual seconds that replay keeps running after last record, so that
+// server can finish handling it
+#define REPLAY_TAIL_SECONDS 10
+
+
+
+// recording
+
+typedef struct RecordedSocket {
+        Socket *sock;
+        int number;
+    } RecordedSocket;
+
+
+static FILE *recordFile = NULL;
+
+static double recordStartTime = 0;
+static double recordEndTime = 0;
+
+static int recordNumConnections = 0;
+static double recordNumBytes = 0;
+
+static double lastRecordSettingCheckTime = 0;
+
+// connections accepted since recording started
+static SimpleVector<RecordedSocket> recordedSockets;
+
+
+static unsigned int sessionRandomSeed = 0;
+
+
+
+// replay
+
+typedef struct ReplayConnection {
+        int number;
+
+        // our end of socket pair, -1 once closed
+        int clientFD;
+
+        // recorded data not yet written to socket
+        SimpleVector<unsigned char> outgoing;
+
+        // client closed connection after sending outgoing
+        char closeWhenSent;
+    } ReplayConnection;
+
+
+static FILE *replayFile = NULL;
+
+static double replayStartTime = 0;
+
+// virtual seconds since replay started
+static double replayOffset = 0;
+
+static SimpleVector<ReplayConnection*> replayConnections;
+
+// server ends of socket pairs, waiting to be accepted
+static SimpleVector<Socket*> replayAcceptQueue;
+
+
+static char replayRecordLoaded = false;
+static unsigned char replayRecordOp;
+static int replayRecordNumber;
+static double replayRecordTime;
+static SimpleVector<unsigned char> replayRecordData;
+
+static char replayRecordsDone = false;
+static double replayEndOffset = 0;
+
+static unsigned int replayTicks = 0;
+static double replayWallStartTime = 0;
+static int replayNumConnections = 0;
+static double replayBytesIn = 0;
+static double replayBytesOut = 0;
+
+
+
+static void writeSessionRecord( SessionRecordOp inOp, int inNumber,
+                                unsigned char *inData, int inLength ) {
+
+    double time = getServerTime() - recordStartTime;
+
+    unsigned char header[ SESSION_RECORD_HEADER_BYTES ];
+
+    header[0] = (unsigned char)inOp;
+    memcpy( &( header[1] ), &inNumber, 4 );
+    memcpy( &( header[5] ), &time, 8 );
+    memcpy( &( header[13] ), &inLength, 4 );
+
+    fwrite( header, SESSION_RECORD_HEADER_BYTES, 1, recordFile );
+
+    if( inLength > 0 ) {
+        fwrite( inData, inLength, 1, recordFile );
+        }
+    }
+
+
+
+static void stopSessionRecording() {
+    if( recordFile == NULL ) {
+        return;
+        }
+
+    fclose( recordFile );
+    recordFile = NULL;
+
+    recordedSockets.deleteAll();
+
+    AppLog::infoF( "Stopped recording session after %d connections, "
+                   "%.0f bytes from clients",
+                   recordNumConnections, recordNumBytes );
+    }
+
+
+
+char stepSessionRecording() {
+    if( replayFile != NULL ) {
+        // recording a replay would just make a copy of it
+        return false;
+        }
+
+    double curTime = Time::getCurrentTime();
+
+    if( recordFile != NULL && curTime >= recordEndTime ) {
+        stopSessionRecording();
+        }
+
+    if( curTime - lastRecordSettingCheckTime <
+        RECORD_SETTING_CHECK_SECONDS ) {
+        return false;
+        }
+    lastRecordSettingCheckTime = curTime;
+
+    if( recordFile != NULL ) {
+        return false;
+        }
+
+    int seconds =
+        SettingsManager::getIntSetting( "recordSessionSeconds", 0 );
+
+    if( seconds <= 0 ) {
+        return false;
+        }
+
+    // one recording per setting change
+    SettingsManager::setSetting( "recordSessionSeconds", 0 );
+
+    char *fileName = autoSprintf( "sessionRecord_%.0f.rec",
+                                  Time::timeSec() );
+
+    recordFile = fopen( fileName, "wb" );
+
+    if( recordFile == NULL ) {
+        AppLog::errorF( "Failed to open %s for session recording",
+                        fileName );
+        delete [] fileName;
+        return false;
+        }
+
+    recordStartTime = getServerTime();
+    recordEndTime = curTime + seconds;
+    recordNumConnections = 0;
+    recordNumBytes = 0;
+    recordedSockets.deleteAll();
+
+    double startTimeSec = getServerTimeSec();
+
+    sessionRandomSeed = (unsigned int)Time::timeSec();
+
+    fwrite( SESSION_RECORD_MAGIC, 4, 1, recordFile );
+    fwrite( &recordStartTime, 8, 1, recordFile );
+    fwrite( &startTimeSec, 8, 1, recordFile );
+    fwrite( &sessionRandomSeed, 4, 1, recordFile );
+
+    AppLog::infoF( "Recording session to %s for %d seconds",
+                   fileName, seconds );
+
+    delete [] fileName;
+
+    return true;
+    }
+
+
+
+void freeSessionRecording() {
+    stopSessionRecording();
+    }
+
+
+
+// -1 if socket not accepted while recording
+static int getRecordedSocketIndex( Socket *inSock ) {
+    for( int i=0; i<recordedSockets.size(); i++ ) {
+        if( recordedSockets.getElementDirect( i ).sock == inSock ) {
+            return i;
+            }
+        }
+    return -1;
+    }
+
+
+
+void recordSessionConnect( Socket *inSock ) {
+    if( recordFile == NULL ) {
+        return;
+        }
+
+    RecordedSocket r = { inSock, recordNumConnections };
+    recordNumConnections++;
+
+    int i = getRecordedSocketIndex( inSock );
+
+    if( i != -1 ) {
+        // old socket at same address was destroyed without a failed read
+        *( recordedSockets.getElement( i ) ) = r;
+        }
+    else {
+        recordedSockets.push_back( r );
+        }
+
+    writeSessionRecord( SESSION_CONNECT, r.number, NULL, 0 );
+    }
+
+
+
+void recordSessionData( Socket *inSock, unsigned char *inData,
+                        int inLength ) {
+    if( recordFile == NULL ) {
+        return;
+        }
+
+    int i = getRecordedSocketIndex( inSock );
+
+    if( i == -1 ) {
+        return;
+        }
+
+    writeSessionRecord( SESSION_DATA,
+                        recordedSockets.getElementDirect( i ).number,
+                        inData, inLength );
+
+    recordNumBytes += inLength;
+    }
+
+
+
+void recordSessionClose( Socket *inSock ) {
+    if( recordFile == NULL ) {
+        return;
+        }
+
+    int i = getRecordedSocketIndex( inSock );
+
+    if( i == -1 ) {
+        return;
+        }
+
+    writeSessionRecord( SESSION_CLOSE,
+                        recordedSockets.getElementDirect( i ).number,
+                        NULL, 0 );
+
+    recordedSockets.deleteElement( i );
+    }
+
+
+
+// sets replayRecordsDone at end of file
+static void readNextReplayRecord() {
+    replayRecordLoaded = false;
+
+    if( replayRecordsDone ) {
+        return;
+        }
+
+    unsigned char header[ SESSION_RECORD_HEADER_BYTES ];
+
+    if( fread( header, SESSION_RECORD_HEADER_BYTES, 1, replayFile ) != 1 ) {
+        replayRecordsDone = true;
+        return;
+        }
+
+    int length;
+
+    replayRecordOp = header[0];
+    memcpy( &replayRecordNumber, &( header[1] ), 4 );
+    memcpy( &replayRecordTime, &( header[5] ), 8 );
+    memcpy( &length, &( header[13] ), 4 );
+
+    if( length < 0 || length > SESSION_RECORD_MAX_DATA ) {
+        AppLog::errorF( "Session recording has corrupt record at %.3f "
+                        "seconds, stopping there", replayRecordTime );
+        replayRecordsDone = true;
+        return;
+        }
+
+    replayRecordData.deleteAll();
+
+    if( length > 0 ) {
+        unsigned char *data = new unsigned char[ length ];
+
+        int numRead = fread( data, 1, length, replayFile );
+
+        replayRecordData.appendArray( data, numRead );
+        delete [] data;
+
+        if( numRead != length ) {
+            // recording was cut off mid-record
+            replayRecordsDone = true;
+            return;
+            }
+        }
+
+    replayRecordLoaded = true;
+    }
+
+
+
+char initSessionReplay() {
+    char *fileName =
+        SettingsManager::getStringSetting( "replaySessionFile", "" );
+
+    if( strlen( fileName ) == 0 ) {
+        delete [] fileName;
+        return false;
+        }
+
+#ifndef SESSION_REPLAY_SOCKET_PAIRS
+    AppLog::errorF( "Can't replay %s, session replay not supported on "
+                    "this platform", fileName );
+    delete [] fileName;
+    return false;
+#endif
+
+    replayFile = fopen( fileName, "rb" );
+
+    if( replayFile == NULL ) {
+        AppLog::errorF( "Failed to open session recording %s", fileName );
+        delete [] fileName;
+        return false;
+        }
+
+    char magic[5];
+    magic[4] = '\0';
+
+    double startTimeSec;
+
+    if( fread( magic, 4, 1, replayFile ) != 1 ||
+        strcmp( magic, SESSION_RECORD_MAGIC ) != 0 ||
+        fread( &replayStartTime, 8, 1, replayFile ) != 1 ||
+        fread( &startTimeSec, 8, 1, replayFile ) != 1 ||
+        fread( &sessionRandomSeed, 4, 1, replayFile ) != 1 ) {
+
+        AppLog::errorF( "%s is not a session recording", fileName );
+
+        fclose( replayFile );
+        replayFile = NULL;
+        delete [] fileName;
+        return false;
+        }
+
+    replayOffset = 0;
+    replayRecordsDone = false;
+    replayTicks = 0;
+    replayNumConnections = 0;
+    replayBytesIn = 0;
+    replayBytesOut = 0;
+    replayWallStartTime = Time::getCurrentTime();
+
+    setServerVirtualTime( replayStartTime );
+
+    readNextReplayRecord();
+
+    AppLog::infoF( "Replaying session from %s, recorded with MAP_TIMESEC "
+                   "at %.0f", fileName, startTimeSec );
+
+    delete [] fileName;
+
+    return true;
+    }
+
+
+
+#ifdef SESSION_REPLAY_SOCKET_PAIRS
+
+static void closeReplayClient( ReplayConnection *inC ) {
+    if( inC->clientFD != -1 ) {
+        close( inC->clientFD );
+        inC->clientFD = -1;
+        }
+    }
+
+#endif
+
+
+
+void freeSessionReplay() {
+    if( replayFile == NULL ) {
+        return;
+        }
+
+    logSessionReplayStats();
+
+    fclose( replayFile );
+    replayFile = NULL;
+
+    for( int i=0; i<replayConnections.size(); i++ ) {
+        ReplayConnection *c = replayConnections.getElementDirect( i );
+#ifdef SESSION_REPLAY_SOCKET_PAIRS
+        closeReplayClient( c );
+#endif
+        delete c;
+        }
+    replayConnections.deleteAll();
+
+    for( int i=0; i<replayAcceptQueue.size(); i++ ) {
+        delete replayAcceptQueue.getElementDirect( i );
+        }
+    replayAcceptQueue.deleteAll();
+    }
+
+
+
+char isReplayingSession() {
+    return ( replayFile != NULL );
+    }
+
+
+
+unsigned int getSessionRandomSeed() {
+    return sessionRandomSeed;
+    }
+
+
+
+static ReplayConnection *getReplayConnection( int inNumber ) {
+    for( int i=0; i<replayConnections.size(); i++ ) {
+        ReplayConnection *c = replayConnections.getElementDirect( i );
+
+        if( c->number == inNumber ) {
+            return c;
+            }
+        }
+    return NULL;
+    }
+
+
+
+static void applyReplayRecord() {
+#ifdef SESSION_REPLAY_SOCKET_PAIRS
+
+    if( replayRecordOp == SESSION_CONNECT ) {
+        int fds[2];
+
+        if( socketpair( AF_UNIX, SOCK_STREAM, 0, fds ) != 0 ) {
+            AppLog::errorF( "Failed to make socket pair for replayed "
+                            "connection %d", replayRecordNumber );
+            return;
+            }
+
+        // our end never blocks the server's loop
+        fcntl( fds[1], F_SETFL, fcntl( fds[1], F_GETFL ) | O_NONBLOCK );
+
+        // same native form that SocketServer gives accepted sockets
+        int *serverFD = new int[1];
+        serverFD[0] = fds[0];
+
+        replayAcceptQueue.push_back( new Socket( (void*)serverFD ) );
+
+        ReplayConnection *c = new ReplayConnection;
+        c->number = replayRecordNumber;
+        c->clientFD = fds[1];
+        c->closeWhenSent = false;
+
+        replayConnections.push_back( c );
+        replayNumConnections++;
+        return;
+        }
+
+    ReplayConnection *c = getReplayConnection( replayRecordNumber );
+
+    if( c == NULL ) {
+        return;
+        }
+
+    if( replayRecordOp == SESSION_DATA ) {
+        c->outgoing.appendArray( replayRecordData.getElement( 0 ),
+                                 replayRecordData.size() );
+        }
+    else if( replayRecordOp == SESSION_CLOSE ) {
+        c->closeWhenSent = true;
+        }
+
+#endif
+    }
+
+
+
+// sends what it can of client's recorded data, and discards what server
+// sent to client
+//
+// returns false once client is done with
+static char stepReplayConnection( ReplayConnection *inC ) {
+#ifdef SESSION_REPLAY_SOCKET_PAIRS
+
+    if( inC->clientFD == -1 ) {
+        return false;
+        }
+
+    int numOutgoing = inC->outgoing.size();
+
+    if( numOutgoing > 0 ) {
+        int numSent = send( inC->clientFD, inC->outgoing.getElement( 0 ),
+                            numOutgoing, MSG_NOSIGNAL );
+
+        if( numSent > 0 ) {
+            inC->outgoing.deleteStartElements( numSent );
+            replayBytesIn += numSent;
+            }
+        else if( numSent == -1 && errno != EAGAIN && errno != EWOULDBLOCK ) {
+            // server closed its end
+            closeReplayClient( inC );
+            return false;
+            }
+        }
+
+    unsigned char buffer[ 65536 ];
+
+    while( true ) {
+        int numRead = recv( inC->clientFD, buffer, sizeof( buffer ), 0 );
+
+        if( numRead > 0 ) {
+            replayBytesOut += numRead;
+            continue;
+            }
+
+        if( numRead == 0 ||
+            ( errno != EAGAIN && errno != EWOULDBLOCK ) ) {
+            // server closed its end
+            closeReplayClient( inC );
+            return false;
+            }
+        break;
+        }
+
+    if( inC->closeWhenSent && inC->outgoing.size() == 0 ) {
+        closeReplayClient( inC );
+        return false;
+        }
+
+    return true;
+
+#else
+    return false;
+#endif
+    }
+
+
+
+char stepSessionReplay( double inMaxWaitSeconds ) {
+    if( replayFile == NULL ) {
+        return false;
+        }
+
+    replayTicks++;
+
+    if( inMaxWaitSeconds < 0 ) {
+        inMaxWaitSeconds = 0;
+        }
+
+    double target = replayOffset + inMaxWaitSeconds;
+
+    if( replayRecordLoaded && replayRecordTime < target ) {
+        target = replayRecordTime;
+        }
+
+    if( target > replayOffset ) {
+        replayOffset = target;
+        setServerVirtualTime( replayStartTime + replayOffset );
+        }
+
+    while( replayRecordLoaded && replayRecordTime <= replayOffset ) {
+        applyReplayRecord();
+        readNextReplayRecord();
+
+        if( replayRecordsDone ) {
+            replayEndOffset = replayOffset;
+            }
+        }
+
+    for( int i=0; i<replayConnections.size(); i++ ) {
+        ReplayConnection *c = replayConnections.getElementDirect( i );
+
+        if( ! stepReplayConnection( c ) ) {
+            delete c;
+            replayConnections.deleteElement( i );
+            i--;
+            }
+        }
+
+    return ( replayAcceptQueue.size() > 0 );
+    }
+
+
+
+Socket *acceptReplayConnection() {
+    if( replayAcceptQueue.size() == 0 ) {
+        return NULL;
+        }
+
+    Socket *sock = replayAcceptQueue.getElementDirect( 0 );
+    replayAcceptQueue.deleteElement( 0 );
+
+    return sock;
+    }
+
+
+
+char isSessionReplayDone() {
+    if( replayFile == NULL || ! replayRecordsDone ) {
+        return false;
+        }
+
+    return ( replayOffset >= replayEndOffset + REPLAY_TAIL_SECONDS );
+    }
+
+
+
+void logSessionReplayStats() {
+    if( replayFile == NULL ) {
+        return;
+        }
+
+    double wallSeconds = Time::getCurrentTime() - replayWallStartTime;
+
+    double ticksPerSecond = 0;
+    double speedUp = 0;
+
+    if( wallSeconds > 0 ) {
+        ticksPerSecond = replayTicks / wallSeconds;
+        speedUp = replayOffset / wallSeconds;
+        }
+
+    AppLog::infoF( "Session replay:  %u ticks in %.2f seconds "
+                   "(%.1f ticks/sec), %.1f recorded seconds (%.1fx real "
+                   "time), %d connections, %.0f bytes in, %.0f bytes out",
+                   replayTicks, wallSeconds, ticksPerSecond,
+                   replayOffset, speedUp, replayNumConnections,
+                   replayBytesIn, replayBytesOut );
+    }
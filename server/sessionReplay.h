@@ -0,0 +1,116 @@
+#ifndef SESSION_REPLAY_H_INCLUDED
+#define SESSION_REPLAY_H_INCLUDED
+
+
+#include "minorGems/network/Socket.h"
+
+
+// Recording of client sessions, and replay of them as a benchmark.
+//
+// Recording:
+//
+// While recordSessionSeconds.ini is set, the server records each
+// connection that it accepts, and every byte that those clients send,
+// with arrival times, to sessionRecord_<time>.rec.  The setting is reset
+// to 0 once recording starts.  Set it before startup to catch the rush of
+// logins after a restart.  Connections made before recording started are
+// not recorded.
+//
+// Replay:
+//
+// With replaySessionFile.ini naming a recording, the server doesn't take
+// clients.  It feeds the recorded connections and client data to itself
+// through local socket pairs, and runs on a virtual clock (see
+// serverClock.h) that starts where the recording started.  Whenever the
+// server would wait for something to happen, the clock jumps ahead
+// instead, to the next recorded event or the end of the wait, so the
+// recording runs as fast as the server can handle it.  At the end, the
+// server logs its tick rate and phase timings, and quits.
+//
+// For a fair replay, start from a copy of the map databases saved when
+// recording started.  Client password and ticket server checks are
+// skipped, since recorded LOGINs answer the challenges that the original
+// server sent.  Both random sources are reseeded from the recording, so
+// replays of one recording do the same work, though not exactly what
+// happened live.
+//
+// File starts with SESSION_RECORD_MAGIC, then:
+//    double Time::getCurrentTime when recording started
+//    double MAP_TIMESEC when recording started
+//    4-byte random seed
+//
+// Followed by records, in native byte order:
+//    1 byte op
+//    4-byte connection number
+//    double seconds since recording started
+//    4-byte data length, then that many bytes of data
+
+
+#define SESSION_RECORD_MAGIC "OLs1"
+
+
+enum SessionRecordOp {
+    SESSION_CONNECT = 0,
+    SESSION_DATA,
+    SESSION_CLOSE
+    };
+
+
+
+// starts or stops recording based on recordSessionSeconds setting
+//
+// returns true if recording just started, after which random sources
+// should be reseeded with getSessionRandomSeed
+char stepSessionRecording();
+
+void freeSessionRecording();
+
+
+// these do nothing when not recording
+
+void recordSessionConnect( Socket *inSock );
+
+void recordSessionData( Socket *inSock, unsigned char *inData,
+                        int inLength );
+
+// client closed connection
+void recordSessionClose( Socket *inSock );
+
+
+
+// returns true if replaySessionFile names a recording that could be
+// opened, after which random sources should be reseeded with
+// getSessionRandomSeed
+char initSessionReplay();
+
+void freeSessionReplay();
+
+
+char isReplayingSession();
+
+
+unsigned int getSessionRandomSeed();
+
+
+// call instead of waiting for socket events
+//
+// moves virtual clock ahead by up to inMaxWaitSeconds, stopping at the
+// next recorded event, and sends clients' recorded data that is due
+//
+// returns true if a recorded connection is waiting to be accepted
+char stepSessionReplay( double inMaxWaitSeconds );
+
+
+// NULL if no recorded connection is waiting
+Socket *acceptReplayConnection();
+
+
+// true once recording has run out
+char isSessionReplayDone();
+
+
+// logs tick rate of replay so far
+void logSessionReplayStats();
+
+
+#endif
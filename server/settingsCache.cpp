@@ -0,0 +1,374 @@
+#include "settingsCache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+#include "minorGems/util/SettingsManager.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/system/Time.h"
+
+#include "minorGems/util/log/AppLog.h"
+
+
+#ifdef __linux__
+#define SETTINGS_CACHE_INOTIFY
+#endif
+
+
+#ifdef SETTINGS_CACHE_INOTIFY
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+
+
+// SettingsManager's default directory
+#define SETTINGS_DIRECTORY "settings"
+
+#define NUM_SETTING_BUCKETS 256
+
+
+
+typedef struct CachedSetting {
+        char *name;
+
+        char loaded;
+        double loadTime;
+
+        // first word of file, NULL if not set
+        char *value;
+
+        char intFound;
+        int intValue;
+
+        char floatFound;
+        float floatValue;
+
+        // every int in file, NULL until asked for
+        SimpleVector<int> *intValues;
+
+        CachedSetting *next;
+    } CachedSetting;
+
+
+static CachedSetting *buckets[ NUM_SETTING_BUCKETS ];
+
+
+// -1 if no watch, and cache entries expire instead
+static int watchFD = -1;
+
+static double cacheSeconds = 5;
+
+
+
+static unsigned int hashName( const char *inName ) {
+    unsigned int h = 5381;
+
+    while( *inName != '\0' ) {
+        h = h * 33 + (unsigned char)( *inName );
+        inName++;
+        }
+    return h % NUM_SETTING_BUCKETS;
+    }
+
+
+
+static CachedSetting *findSetting( const char *inName ) {
+    CachedSetting *s = buckets[ hashName( inName ) ];
+
+    while( s != NULL ) {
+        if( strcmp( s->name, inName ) == 0 ) {
+            return s;
+            }
+        s = s->next;
+        }
+    return NULL;
+    }
+
+
+
+static void dropValue( CachedSetting *inSetting ) {
+    if( inSetting->value != NULL ) {
+        delete [] inSetting->value;
+        inSetting->value = NULL;
+        }
+    if( inSetting->intValues != NULL ) {
+        delete inSetting->intValues;
+        inSetting->intValues = NULL;
+        }
+    inSetting->loaded = false;
+    }
+
+
+
+static void dropAllValues() {
+    for( int b=0; b<NUM_SETTING_BUCKETS; b++ ) {
+        CachedSetting *s = buckets[b];
+
+        while( s != NULL ) {
+            dropValue( s );
+            s = s->next;
+            }
+        }
+    }
+
+
+
+// returns cached setting, reading its file if needed
+static CachedSetting *getSetting( const char *inName ) {
+    CachedSetting *s = findSetting( inName );
+
+    if( s == NULL ) {
+        s = new CachedSetting;
+
+        s->name = stringDuplicate( inName );
+        s->loaded = false;
+        s->value = NULL;
+        s->intValues = NULL;
+
+        unsigned int b = hashName( inName );
+        s->next = buckets[b];
+        buckets[b] = s;
+        }
+
+    double curTime = 0;
+
+    if( s->loaded && watchFD == -1 ) {
+        curTime = Time::getCurrentTime();
+
+        if( curTime - s->loadTime > cacheSeconds ) {
+            dropValue( s );
+            }
+        }
+
+    if( s->loaded ) {
+        return s;
+        }
+
+    s->value = SettingsManager::getStringSetting( inName );
+
+    s->intFound = false;
+    s->floatFound = false;
+
+    if( s->value != NULL ) {
+        s->intFound = ( sscanf( s->value, "%d", &( s->intValue ) ) == 1 );
+        s->floatFound =
+            ( sscanf( s->value, "%f", &( s->floatValue ) ) == 1 );
+        }
+
+    if( curTime == 0 ) {
+        curTime = Time::getCurrentTime();
+        }
+
+    s->loaded = true;
+    s->loadTime = curTime;
+
+    return s;
+    }
+
+
+
+void initSettingsCache() {
+    freeSettingsCache();
+
+    cacheSeconds =
+        SettingsManager::getFloatSetting( "settingsCacheSeconds", 5 );
+
+#ifdef SETTINGS_CACHE_INOTIFY
+    watchFD = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+
+    if( watchFD != -1 ) {
+        // not IN_MODIFY, which can catch a file half-written
+        if( inotify_add_watch( watchFD, SETTINGS_DIRECTORY,
+                               IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+                               IN_CREATE | IN_DELETE ) == -1 ) {
+            close( watchFD );
+            watchFD = -1;
+            }
+        }
+
+    if( watchFD != -1 ) {
+        AppLog::info( "Watching settings folder for changes" );
+        return;
+        }
+#endif
+
+    AppLog::infoF( "Rereading cached settings every %.1f seconds",
+                   cacheSeconds );
+    }
+
+
+
+void freeSettingsCache() {
+#ifdef SETTINGS_CACHE_INOTIFY
+    if( watchFD != -1 ) {
+        close( watchFD );
+        watchFD = -1;
+        }
+#endif
+
+    for( int b=0; b<NUM_SETTING_BUCKETS; b++ ) {
+        CachedSetting *s = buckets[b];
+
+        while( s != NULL ) {
+            CachedSetting *next = s->next;
+
+            dropValue( s );
+            delete [] s->name;
+            delete s;
+
+            s = next;
+            }
+        buckets[b] = NULL;
+        }
+    }
+
+
+
+void stepSettingsCache() {
+#ifdef SETTINGS_CACHE_INOTIFY
+    if( watchFD == -1 ) {
+        return;
+        }
+
+    char buffer[ 4096 ]
+        __attribute__ ( ( aligned( __alignof__( struct inotify_event ) ) ) );
+
+    while( true ) {
+        int numRead = read( watchFD, buffer, sizeof( buffer ) );
+
+        if( numRead <= 0 ) {
+            if( numRead == -1 && errno == EINTR ) {
+                continue;
+                }
+            // EAGAIN, nothing more to read
+            return;
+            }
+
+        int pos = 0;
+
+        while( pos < numRead ) {
+            struct inotify_event *e =
+                (struct inotify_event *)&( buffer[ pos ] );
+
+            pos += sizeof( struct inotify_event ) + e->len;
+
+            if( e->mask & IN_Q_OVERFLOW ) {
+                // lost track of what changed
+                dropAllValues();
+                continue;
+                }
+
+            if( e->len == 0 ) {
+                continue;
+                }
+
+            // name is fooSetting.ini
+            char *dot = strrchr( e->name, '.' );
+
+            if( dot == NULL || strcmp( dot, ".ini" ) != 0 ) {
+                continue;
+                }
+            *dot = '\0';
+
+            CachedSetting *s = findSetting( e->name );
+
+            if( s != NULL && s->loaded ) {
+                AppLog::infoF( "Setting %s changed", e->name );
+                dropValue( s );
+                }
+            }
+        }
+#endif
+    }
+
+
+
+int getCachedIntSetting( const char *inSettingName, int inDefaultValue ) {
+    CachedSetting *s = getSetting( inSettingName );
+
+    if( s->intFound ) {
+        return s->intValue;
+        }
+    return inDefaultValue;
+    }
+
+
+
+float getCachedFloatSetting( const char *inSettingName,
+                             float inDefaultValue ) {
+    CachedSetting *s = getSetting( inSettingName );
+
+    if( s->floatFound ) {
+        return s->floatValue;
+        }
+    return inDefaultValue;
+    }
+
+
+
+SimpleVector<int> *getCachedIntSettingMulti( const char *inSettingName ) {
+    CachedSetting *s = getSetting( inSettingName );
+
+    if( s->intValues == NULL ) {
+        s->intValues = SettingsManager::getIntSettingMulti( inSettingName );
+        }
+
+    SimpleVector<int> *result = new SimpleVector<int>();
+
+    for( int i=0; i<s->intValues->size(); i++ ) {
+        result->push_back( s->intValues->getElementDirect( i ) );
+        }
+    return result;
+    }
+
+
+
+char *getCachedStringSetting( const char *inSettingName ) {
+    CachedSetting *s = getSetting( inSettingName );
+
+    if( s->value == NULL ) {
+        return NULL;
+        }
+    return stringDuplicate( s->value );
+    }
+
+
+
+char *getCachedStringSetting( const char *inSettingName,
+                              const char *inDefaultValue ) {
+    char *value = getCachedStringSetting( inSettingName );
+
+    if( value == NULL ) {
+        value = stringDuplicate( inDefaultValue );
+        }
+    return value;
+    }
+
+
+
+void setCachedSetting( const char *inSettingName, int inValue ) {
+    SettingsManager::setSetting( inSettingName, inValue );
+
+    CachedSetting *s = findSetting( inSettingName );
+
+    if( s != NULL ) {
+        // reread on next get, so it is parsed as a get would parse it
+        dropValue( s );
+        }
+    }
+
+
+
+void setCachedSetting( const char *inSettingName, float inValue ) {
+    SettingsManager::setSetting( inSettingName, inValue );
+
+    CachedSetting *s = findSetting( inSettingName );
+
+    if( s != NULL ) {
+        dropValue( s );
+        }
+    }
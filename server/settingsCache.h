@@ -0,0 +1,53 @@
+// In-memory copy of settings, so reading a setting in a per-tick or
+// per-connection path doesn't open and parse a file under settings/ every
+// time.
+//
+// A setting's file is read the first time the setting is asked for, and
+// kept until the file changes.  On Linux, an inotify watch on the settings
+// directory tells us which files changed, so settings can still be tuned
+// while the server runs.  Elsewhere, cached values are reread after
+// settingsCacheSeconds.ini.
+//
+// Values are parsed the same way SettingsManager parses them, from the
+// first word in the file.
+//
+// Only for use from the main thread.
+
+
+#include "minorGems/util/SimpleVector.h"
+
+
+void initSettingsCache();
+
+void freeSettingsCache();
+
+
+// drops cached values of settings whose files have changed
+// call once per main loop step
+void stepSettingsCache();
+
+
+
+int getCachedIntSetting( const char *inSettingName, int inDefaultValue );
+
+float getCachedFloatSetting( const char *inSettingName,
+                             float inDefaultValue );
+
+// every int in setting's file, empty if not set
+// result destroyed by caller
+SimpleVector<int> *getCachedIntSettingMulti( const char *inSettingName );
+
+// returns NULL if not set
+// result destroyed by caller
+char *getCachedStringSetting( const char *inSettingName );
+
+// result destroyed by caller
+char *getCachedStringSetting( const char *inSettingName,
+                              const char *inDefaultValue );
+
+
+
+// writes through to setting's file, and updates cache
+void setCachedSetting( const char *inSettingName, int inValue );
+
+void setCachedSetting( const char *inSettingName, float inValue );
@@ -0,0 +1,801 @@
+#include "socketEvents.h"
+
+#include "FlatHashTable.h"
+#include "tickProfiler.h"
+
+#include "../commonSource/streamCompression.h"
+
+#include <stdint.h>
+#include <string.h>
+
+
+#include "minorGems/util/SettingsManager.h"
+#include "minorGems/util/SimpleVector.h"
+
+#include "minorGems/util/log/AppLog.h"
+
+
+#ifdef __linux__
+
+#define SOCKET_EVENTS_EPOLL
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <errno.h>
+
+#else
+
+#include "minorGems/network/SocketPoll.h"
+
+#endif
+
+
+
+// queue starts at this size and doubles as needed, up to max setting
+#define OUTBOUND_QUEUE_START_BYTES 65536
+
+// epoll events handled per wait
+#define MAX_EVENTS_PER_WAIT 256
+
+
+
+typedef struct SocketState {
+        Socket *sock;
+
+        // true if data may have arrived since socket was last read
+        char readable;
+
+        // false after a send would block, until socket says it has room
+        char writable;
+
+        char sendFailed;
+
+        // ring buffer of bytes waiting to be sent
+        unsigned char *queue;
+        int queueSize;
+        int queueStart;
+        int queueLength;
+
+        // NULL unless client takes stream compression
+        StreamCompressor *compressor;
+
+#ifdef SOCKET_EVENTS_EPOLL
+        int fd;
+#endif
+    } SocketState;
+
+
+
+static int queueSoftBytes = 1048576;
+static int queueMaxBytes = 8388608;
+
+
+// all added sockets
+static SimpleVector<SocketState*> socketStates;
+
+// reused for each compressed send
+static ByteWriter streamBlockWriter;
+
+// keyed by Socket pointer
+static FlatHashTable<SocketState*> *socketStateTable = NULL;
+
+
+
+typedef struct FDWatch {
+        int fd;
+        char wantWritable;
+
+        FDEventCallback callback;
+        void *data;
+
+        // removed during dispatch, freed once dispatch is done
+        char removed;
+    } FDWatch;
+
+
+// few of these, so a list is fine
+static SimpleVector<FDWatch*> fdWatches;
+
+static SimpleVector<FDWatch*> removedFDWatches;
+
+static char dispatchingFDWatches = false;
+
+
+
+#ifdef SOCKET_EVENTS_EPOLL
+
+static int epollFD = -1;
+
+static SocketServer *eventServer = NULL;
+
+// used as event data for server socket
+static int serverEventTag = 0;
+
+// watched descriptors sit in their own level-triggered epoll set, which
+// is itself in main set with this as event data
+static int watchEpollFD = -1;
+static int watchEventTag = 0;
+
+
+// minorGems' unix Socket and SocketServer keep their descriptor behind
+// mNativeObjectPointer
+static int getSocketFD( Socket *inSock ) {
+    return ( (int *)( inSock->mNativeObjectPointer ) )[0];
+    }
+
+static int getServerFD( SocketServer *inServer ) {
+    return ( (int *)( inServer->mNativeObjectPointer ) )[0];
+    }
+
+#else
+
+static SocketPoll *eventPoll = NULL;
+
+#endif
+
+
+
+
+static void getPointerKeys( Socket *inSock, int *outA, int *outB ) {
+    uint64_t p = (uint64_t)(uintptr_t)inSock;
+
+    *outA = (int)( p & 0xFFFFFFFF );
+    *outB = (int)( p >> 32 );
+    }
+
+
+
+static SocketState *getSocketState( Socket *inSock ) {
+    if( socketStateTable == NULL ) {
+        return NULL;
+        }
+
+    int a, b;
+    getPointerKeys( inSock, &a, &b );
+
+    char found;
+    return socketStateTable->lookup( a, b, 0, 0, &found );
+    }
+
+
+
+static void freeSocketState( SocketState *inState ) {
+    if( inState->queue != NULL ) {
+        delete [] inState->queue;
+        }
+    if( inState->compressor != NULL ) {
+        delete inState->compressor;
+        }
+    delete inState;
+    }
+
+
+
+// returns number of bytes socket took, 0 if it would block,
+// or -1 on error
+static int trySend( SocketState *inState,
+                    unsigned char *inBuffer, int inNumBytes ) {
+#ifdef SOCKET_EVENTS_EPOLL
+    int numSent = send( inState->fd, inBuffer, inNumBytes,
+                        MSG_DONTWAIT | MSG_NOSIGNAL );
+
+    if( numSent < 0 ) {
+        if( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ) {
+            return 0;
+            }
+        return -1;
+        }
+    return numSent;
+#else
+    int numSent = inState->sock->send( inBuffer, inNumBytes, false, false );
+
+    if( numSent == -2 ) {
+        // would block
+        return 0;
+        }
+    return numSent;
+#endif
+    }
+
+
+
+// sends from front of queue until it is empty or socket is full
+static void drainQueue( SocketState *inState ) {
+
+    while( inState->queueLength > 0 && ! inState->sendFailed ) {
+
+        // send contiguous part up to end of ring
+        int runLength = inState->queueSize - inState->queueStart;
+
+        if( runLength > inState->queueLength ) {
+            runLength = inState->queueLength;
+            }
+
+        int numSent = trySend( inState,
+                               &( inState->queue[ inState->queueStart ] ),
+                               runLength );
+
+        if( numSent < 0 ) {
+            inState->sendFailed = true;
+            return;
+            }
+
+        inState->queueStart =
+            ( inState->queueStart + numSent ) % inState->queueSize;
+        inState->queueLength -= numSent;
+
+        if( numSent < runLength ) {
+            inState->writable = false;
+            return;
+            }
+        }
+
+    if( inState->queueLength == 0 ) {
+        inState->queueStart = 0;
+        }
+    }
+
+
+
+// returns false if queue can't hold them
+static char enqueue( SocketState *inState,
+                     unsigned char *inBuffer, int inNumBytes ) {
+
+    int needed = inState->queueLength + inNumBytes;
+
+    if( needed > queueMaxBytes ) {
+        return false;
+        }
+
+    if( needed > inState->queueSize ) {
+        int newSize = inState->queueSize;
+
+        if( newSize == 0 ) {
+            newSize = OUTBOUND_QUEUE_START_BYTES;
+            }
+        while( newSize < needed ) {
+            newSize *= 2;
+            }
+
+        unsigned char *newQueue = new unsigned char[ newSize ];
+
+        // unwrap into new buffer
+        for( int i=0; i<inState->queueLength; i++ ) {
+            newQueue[i] =
+                inState->queue[ ( inState->queueStart + i ) %
+                                inState->queueSize ];
+            }
+
+        if( inState->queue != NULL ) {
+            delete [] inState->queue;
+            }
+        inState->queue = newQueue;
+        inState->queueSize = newSize;
+        inState->queueStart = 0;
+        }
+
+    int end = ( inState->queueStart + inState->queueLength ) %
+        inState->queueSize;
+
+    int firstPart = inState->queueSize - end;
+
+    if( firstPart > inNumBytes ) {
+        firstPart = inNumBytes;
+        }
+
+    memcpy( &( inState->queue[ end ] ), inBuffer, firstPart );
+    memcpy( inState->queue, &( inBuffer[ firstPart ] ),
+            inNumBytes - firstPart );
+
+    inState->queueLength += inNumBytes;
+
+    return true;
+    }
+
+
+
+
+void initSocketEvents( SocketServer *inServer ) {
+    queueSoftBytes =
+        SettingsManager::getIntSetting( "outboundQueueSoftBytes", 1048576 );
+    queueMaxBytes =
+        SettingsManager::getIntSetting( "outboundQueueMaxBytes", 8388608 );
+
+    socketStateTable = new FlatHashTable<SocketState*>( 512 );
+
+#ifdef SOCKET_EVENTS_EPOLL
+    eventServer = inServer;
+
+    epollFD = epoll_create( MAX_EVENTS_PER_WAIT );
+
+    if( epollFD == -1 ) {
+        AppLog::errorF( "epoll_create failed, errno %d", errno );
+        return;
+        }
+
+    struct epoll_event ev;
+    memset( &ev, 0, sizeof( ev ) );
+
+    // level-triggered, so that connections we don't accept right away
+    // keep waking us up
+    ev.events = EPOLLIN;
+    ev.data.ptr = &serverEventTag;
+
+    if( epoll_ctl( epollFD, EPOLL_CTL_ADD,
+                   getServerFD( inServer ), &ev ) == -1 ) {
+        AppLog::errorF( "Adding server socket to epoll failed, errno %d",
+                        errno );
+        }
+
+    watchEpollFD = epoll_create( MAX_EVENTS_PER_WAIT );
+
+    if( watchEpollFD != -1 ) {
+        ev.events = EPOLLIN;
+        ev.data.ptr = &watchEventTag;
+
+        if( epoll_ctl( epollFD, EPOLL_CTL_ADD, watchEpollFD, &ev ) == -1 ) {
+            AppLog::errorF( "Adding watch set to epoll failed, errno %d",
+                            errno );
+            close( watchEpollFD );
+            watchEpollFD = -1;
+            }
+        }
+#else
+    eventPoll = new SocketPoll();
+    eventPoll->addSocketServer( inServer );
+#endif
+    }
+
+
+
+void freeSocketEvents() {
+    for( int i=0; i<socketStates.size(); i++ ) {
+        freeSocketState( socketStates.getElementDirect( i ) );
+        }
+    socketStates.deleteAll();
+
+    if( socketStateTable != NULL ) {
+        delete socketStateTable;
+        socketStateTable = NULL;
+        }
+
+    for( int i=0; i<fdWatches.size(); i++ ) {
+        delete fdWatches.getElementDirect( i );
+        }
+    fdWatches.deleteAll();
+
+#ifdef SOCKET_EVENTS_EPOLL
+    if( watchEpollFD != -1 ) {
+        close( watchEpollFD );
+        watchEpollFD = -1;
+        }
+    if( epollFD != -1 ) {
+        close( epollFD );
+        epollFD = -1;
+        }
+    eventServer = NULL;
+#else
+    if( eventPoll != NULL ) {
+        delete eventPoll;
+        eventPoll = NULL;
+        }
+#endif
+    }
+
+
+
+void addSocketToEvents( Socket *inSock ) {
+    int a, b;
+    getPointerKeys( inSock, &a, &b );
+
+    SocketState *old = getSocketState( inSock );
+
+    if( old != NULL ) {
+        // left over from a deleted socket at the same address
+        socketStates.deleteElementEqualTo( old );
+        socketStateTable->remove( a, b, 0, 0 );
+        freeSocketState( old );
+        }
+
+    SocketState *s = new SocketState;
+
+    s->sock = inSock;
+    s->readable = true;
+    s->writable = true;
+    s->sendFailed = false;
+    s->queue = NULL;
+    s->queueSize = 0;
+    s->queueStart = 0;
+    s->queueLength = 0;
+    s->compressor = NULL;
+
+#ifdef SOCKET_EVENTS_EPOLL
+    s->fd = getSocketFD( inSock );
+
+    // match send( ..., false, false ) that this replaces
+    int noDelay = 1;
+    setsockopt( s->fd, IPPROTO_TCP, TCP_NODELAY,
+                &noDelay, sizeof( noDelay ) );
+
+    struct epoll_event ev;
+    memset( &ev, 0, sizeof( ev ) );
+
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = s;
+
+    if( epoll_ctl( epollFD, EPOLL_CTL_ADD, s->fd, &ev ) == -1 ) {
+        AppLog::errorF( "Adding socket to epoll failed, errno %d", errno );
+        s->sendFailed = true;
+        }
+#else
+    eventPoll->addSocket( inSock );
+#endif
+
+    socketStates.push_back( s );
+    socketStateTable->insert( a, b, 0, 0, s );
+    }
+
+
+
+void removeSocketFromEvents( Socket *inSock ) {
+    SocketState *s = getSocketState( inSock );
+
+    if( s == NULL ) {
+        return;
+        }
+
+    // last messages, like a REJECTED or death notice, still have a
+    // chance to go out before the socket closes
+    drainQueue( s );
+
+#ifdef SOCKET_EVENTS_EPOLL
+    epoll_ctl( epollFD, EPOLL_CTL_DEL, s->fd, NULL );
+#else
+    eventPoll->removeSocket( inSock );
+#endif
+
+    int a, b;
+    getPointerKeys( inSock, &a, &b );
+
+    socketStateTable->remove( a, b, 0, 0 );
+    socketStates.deleteElementEqualTo( s );
+
+    freeSocketState( s );
+    }
+
+
+
+#ifdef SOCKET_EVENTS_EPOLL
+
+static void dispatchFDWatches() {
+    struct epoll_event events[ MAX_EVENTS_PER_WAIT ];
+
+    int numEvents = epoll_wait( watchEpollFD, events, MAX_EVENTS_PER_WAIT,
+                                0 );
+
+    dispatchingFDWatches = true;
+
+    for( int i=0; i<numEvents; i++ ) {
+        FDWatch *w = (FDWatch *)( events[i].data.ptr );
+
+        if( w->removed ) {
+            continue;
+            }
+
+        // errors and hangups count as readable, so that the next read
+        // finds them
+        char readable = ( events[i].events &
+                          ( EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR ) )
+            != 0;
+        char writable = ( events[i].events & EPOLLOUT ) != 0;
+
+        w->callback( w->data, readable, writable );
+        }
+
+    dispatchingFDWatches = false;
+
+    for( int i=0; i<removedFDWatches.size(); i++ ) {
+        delete removedFDWatches.getElementDirect( i );
+        }
+    removedFDWatches.deleteAll();
+    }
+
+
+
+static void setWatchEvents( FDWatch *inWatch, int inOp ) {
+    struct epoll_event ev;
+    memset( &ev, 0, sizeof( ev ) );
+
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    if( inWatch->wantWritable ) {
+        ev.events |= EPOLLOUT;
+        }
+    ev.data.ptr = inWatch;
+
+    if( epoll_ctl( watchEpollFD, inOp, inWatch->fd, &ev ) == -1 ) {
+        AppLog::errorF( "Watching descriptor %d failed, errno %d",
+                        inWatch->fd, errno );
+        }
+    }
+
+#endif
+
+
+
+static FDWatch *getFDWatch( int inFD ) {
+    for( int i=0; i<fdWatches.size(); i++ ) {
+        FDWatch *w = fdWatches.getElementDirect( i );
+
+        if( w->fd == inFD ) {
+            return w;
+            }
+        }
+    return NULL;
+    }
+
+
+
+char addFDToEvents( int inFD, char inWantWritable,
+                    FDEventCallback inCallback, void *inData ) {
+#ifdef SOCKET_EVENTS_EPOLL
+    if( watchEpollFD == -1 ) {
+        return false;
+        }
+
+    // descriptor numbers are reused after close
+    removeFDFromEvents( inFD );
+
+    FDWatch *w = new FDWatch;
+
+    w->fd = inFD;
+    w->wantWritable = inWantWritable;
+    w->callback = inCallback;
+    w->data = inData;
+    w->removed = false;
+
+    setWatchEvents( w, EPOLL_CTL_ADD );
+
+    fdWatches.push_back( w );
+
+    return true;
+#else
+    return false;
+#endif
+    }
+
+
+
+void setFDWantWritable( int inFD, char inWantWritable ) {
+#ifdef SOCKET_EVENTS_EPOLL
+    FDWatch *w = getFDWatch( inFD );
+
+    if( w == NULL || w->wantWritable == inWantWritable ) {
+        return;
+        }
+
+    w->wantWritable = inWantWritable;
+
+    setWatchEvents( w, EPOLL_CTL_MOD );
+#endif
+    }
+
+
+
+void removeFDFromEvents( int inFD ) {
+    FDWatch *w = getFDWatch( inFD );
+
+    if( w == NULL ) {
+        return;
+        }
+
+#ifdef SOCKET_EVENTS_EPOLL
+    epoll_ctl( watchEpollFD, EPOLL_CTL_DEL, inFD, NULL );
+#endif
+
+    fdWatches.deleteElementEqualTo( w );
+
+    if( dispatchingFDWatches ) {
+        // may still be in list of events being dispatched
+        w->removed = true;
+        removedFDWatches.push_back( w );
+        }
+    else {
+        delete w;
+        }
+    }
+
+
+
+char waitForSocketEvents( int inTimeoutMS ) {
+    char serverReady = false;
+
+#ifdef SOCKET_EVENTS_EPOLL
+    struct epoll_event events[ MAX_EVENTS_PER_WAIT ];
+
+    int numEvents = epoll_wait( epollFD, events, MAX_EVENTS_PER_WAIT,
+                                inTimeoutMS );
+
+    for( int i=0; i<numEvents; i++ ) {
+        if( events[i].data.ptr == &serverEventTag ) {
+            serverReady = true;
+            continue;
+            }
+        if( events[i].data.ptr == &watchEventTag ) {
+            dispatchFDWatches();
+            continue;
+            }
+
+        SocketState *s = (SocketState *)( events[i].data.ptr );
+
+        if( events[i].events & EPOLLOUT ) {
+            s->writable = true;
+            drainQueue( s );
+            }
+
+        // errors and hangups also count as readable, so that the next
+        // read finds them
+        if( events[i].events &
+            ( EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR ) ) {
+            s->readable = true;
+            }
+        }
+#else
+    int timeout = inTimeoutMS;
+
+    for( int i=0; i<socketStates.size(); i++ ) {
+        if( socketStates.getElementDirect( i )->queueLength > 0 ) {
+            // no writable events here, so check back soon
+            if( timeout < 0 || timeout > 10 ) {
+                timeout = 10;
+                }
+            break;
+            }
+        }
+
+    SocketOrServer *ready = eventPoll->wait( timeout );
+
+    if( ready != NULL && ! ready->isSocket ) {
+        serverReady = true;
+        }
+
+    for( int i=0; i<socketStates.size(); i++ ) {
+        SocketState *s = socketStates.getElementDirect( i );
+
+        if( s->queueLength > 0 ) {
+            s->writable = true;
+            drainQueue( s );
+            }
+        }
+#endif
+
+    return serverReady;
+    }
+
+
+
+char isSocketReadable( Socket *inSock ) {
+#ifdef SOCKET_EVENTS_EPOLL
+    SocketState *s = getSocketState( inSock );
+
+    if( s != NULL ) {
+        return s->readable;
+        }
+#endif
+    return true;
+    }
+
+
+
+void markSocketRead( Socket *inSock ) {
+    SocketState *s = getSocketState( inSock );
+
+    if( s != NULL ) {
+        s->readable = false;
+        }
+    }
+
+
+
+int sendToSocket( Socket *inSock, unsigned char *inBuffer, int inNumBytes ) {
+    SocketState *s = getSocketState( inSock );
+
+    addProfileCount( PROFILE_BYTES_SENT, inNumBytes );
+
+    if( s == NULL ) {
+        // not added yet, nothing queued ahead of this
+        return inSock->send( inBuffer, inNumBytes, false, false );
+        }
+
+    if( s->sendFailed ) {
+        return -1;
+        }
+
+    unsigned char *bytes = inBuffer;
+    int numBytes = inNumBytes;
+
+    if( s->compressor != NULL ) {
+        streamBlockWriter.reset();
+        s->compressor->compressBlock( inBuffer, inNumBytes,
+                                      &streamBlockWriter );
+
+        bytes = streamBlockWriter.getBytes();
+        numBytes = streamBlockWriter.getSize();
+
+        addProfileCount( PROFILE_STREAM_RAW_BYTES, inNumBytes );
+        addProfileCount( PROFILE_STREAM_COMPRESSED_BYTES, numBytes );
+        }
+
+    int numSent = 0;
+
+    if( s->queueLength == 0 && s->writable ) {
+        numSent = trySend( s, bytes, numBytes );
+
+        if( numSent < 0 ) {
+            s->sendFailed = true;
+            return -1;
+            }
+
+        if( numSent == numBytes ) {
+            return inNumBytes;
+            }
+
+        s->writable = false;
+        }
+
+    if( ! enqueue( s, &( bytes[ numSent ] ), numBytes - numSent ) ) {
+        AppLog::errorF( "Outbound queue for socket would pass %d bytes, "
+                        "dropping client", queueMaxBytes );
+        s->sendFailed = true;
+        return -1;
+        }
+
+    if( s->writable ) {
+        drainQueue( s );
+
+        if( s->sendFailed ) {
+            return -1;
+            }
+        }
+
+    return inNumBytes;
+    }
+
+
+
+char startSocketStreamCompression( Socket *inSock ) {
+    SocketState *s = getSocketState( inSock );
+
+    if( s == NULL ) {
+        return false;
+        }
+
+    if( s->compressor == NULL ) {
+        s->compressor = new StreamCompressor();
+        }
+    return true;
+    }
+
+
+
+char didSocketSendFail( Socket *inSock ) {
+    SocketState *s = getSocketState( inSock );
+
+    if( s != NULL ) {
+        return s->sendFailed;
+        }
+    return false;
+    }
+
+
+
+char isSocketBackedUp( Socket *inSock ) {
+    SocketState *s = getSocketState( inSock );
+
+    if( s != NULL ) {
+        return ( s->queueLength > queueSoftBytes );
+        }
+    return false;
+    }
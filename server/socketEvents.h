@@ -0,0 +1,95 @@
+#include "minorGems/network/Socket.h"
+#include "minorGems/network/SocketServer.h"
+
+
+// Waits on the server socket and all client sockets at once.
+//
+// On Linux, uses edge-triggered epoll, and remembers which client sockets
+// have had data arrive since they were last read, so the main loop can
+// skip idle sockets.  Elsewhere, falls back on SocketPoll, and every
+// socket counts as readable.
+//
+// Sends go through a per-socket outbound ring buffer.  Whatever the
+// socket won't take right away is queued and sent as room opens up,
+// instead of the send failing.
+//
+// outboundQueueSoftBytes.ini:  while a socket has more than this queued,
+//    isSocketBackedUp is true, and the server stops reading requests from
+//    that client until the queue drains
+//
+// outboundQueueMaxBytes.ini:  a send that would queue more than this fails,
+//    and the client is dropped
+
+
+void initSocketEvents( SocketServer *inServer );
+
+void freeSocketEvents();
+
+
+void addSocketToEvents( Socket *inSock );
+
+// tries to send anything still queued for socket, then forgets about it
+// must be called before socket is destroyed
+void removeSocketFromEvents( Socket *inSock );
+
+
+
+// waits up to inTimeoutMS for data to arrive, a connection to come in,
+// or a socket with queued data to have room for more, and sends what it
+// can from queues
+//
+// returns true if server socket has a connection waiting
+char waitForSocketEvents( int inTimeoutMS );
+
+
+
+// true if data may have arrived since socket was last read
+char isSocketReadable( Socket *inSock );
+
+// call after reading all waiting data from socket
+void markSocketRead( Socket *inSock );
+
+
+
+// sends what socket takes right away, queues the rest
+//
+// returns inNumBytes, or -1 if socket failed or queue is full
+int sendToSocket( Socket *inSock, unsigned char *inBuffer, int inNumBytes );
+
+
+// everything sent to socket from now on goes through its own
+// StreamCompressor (see streamCompression.h)
+//
+// returns false if socket hasn't been added
+char startSocketStreamCompression( Socket *inSock );
+
+
+// true if sending queued data to socket has failed
+char didSocketSendFail( Socket *inSock );
+
+
+// true if socket has more than outboundQueueSoftBytes queued
+char isSocketBackedUp( Socket *inSock );
+
+
+
+// Other descriptors, like the connections of asyncWeb.h, can wake
+// waitForSocketEvents too.  inCallback is called from inside
+// waitForSocketEvents with inData whenever inFD is readable, or writable
+// while inWantWritable is set.
+//
+// Descriptors are watched level-triggered.  A callback can remove any
+// descriptor, including its own.
+
+typedef void (*FDEventCallback)( void *inData,
+                                 char inReadable, char inWritable );
+
+
+// returns false if descriptors can't be watched on this platform, in
+// which case caller must poll inFD itself
+char addFDToEvents( int inFD, char inWantWritable,
+                    FDEventCallback inCallback, void *inData );
+
+void setFDWantWritable( int inFD, char inWantWritable );
+
+void removeFDFromEvents( int inFD );
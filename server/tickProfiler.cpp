@@ -0,0 +1,348 @@
+#include "tickProfiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+#include "minorGems/util/SettingsManager.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/system/Time.h"
+
+#include "minorGems/util/log/AppLog.h"
+
+
+
+// 4 buckets for each power of 2 microseconds, up to 2^32
+#define NUM_PROFILE_BUCKETS 128
+
+
+typedef struct PhaseStats {
+        double startTime;
+
+        unsigned int count;
+        double totalSeconds;
+        double maxSeconds;
+
+        unsigned int buckets[ NUM_PROFILE_BUCKETS ];
+    } PhaseStats;
+
+
+static const char *phaseNames[ NUM_PROFILE_PHASES ] = {
+    "step",
+    "wait",
+    "periodic",
+    "backup",
+    "connections",
+    "messages",
+    "playerStep",
+    "heat",
+    "updates",
+    "stepMap",
+    "format",
+    "sends",
+    "cleanup" };
+
+
+static const char *counterNames[ NUM_PROFILE_COUNTERS ] = {
+    "dbGets",
+    "dbCacheHits",
+    "dbPuts",
+    "messagesReceived",
+    "bytesReceived",
+    "bytesSent",
+    "streamRawBytes",
+    "streamCompressedBytes" };
+
+
+static PhaseStats phaseStats[ NUM_PROFILE_PHASES ];
+
+static unsigned int counters[ NUM_PROFILE_COUNTERS ];
+
+
+static char profilerOn = false;
+
+static double profileIntervalSeconds = 60;
+
+static char *profileFileName = NULL;
+
+static double intervalStartTime = 0;
+
+
+
+static void resetStats() {
+    for( int p=0; p<NUM_PROFILE_PHASES; p++ ) {
+        // keep start time, in case a phase is running
+        double startTime = phaseStats[p].startTime;
+
+        memset( &( phaseStats[p] ), 0, sizeof( PhaseStats ) );
+
+        phaseStats[p].startTime = startTime;
+        }
+
+    memset( counters, 0, sizeof( counters ) );
+
+    intervalStartTime = Time::getCurrentTime();
+    }
+
+
+
+void initTickProfiler() {
+    freeTickProfiler();
+
+    profileIntervalSeconds =
+        SettingsManager::getFloatSetting( "tickProfileSeconds", 60 );
+
+    profilerOn = ( profileIntervalSeconds > 0 );
+
+    profileFileName =
+        SettingsManager::getStringSetting( "tickProfileFile",
+                                           "tickProfile.txt" );
+
+    for( int p=0; p<NUM_PROFILE_PHASES; p++ ) {
+        phaseStats[p].startTime = 0;
+        }
+    resetStats();
+
+    if( profilerOn ) {
+        AppLog::infoF( "Writing main loop profile to %s every %.0f seconds",
+                       profileFileName, profileIntervalSeconds );
+        }
+    }
+
+
+
+void freeTickProfiler() {
+    if( profileFileName != NULL ) {
+        delete [] profileFileName;
+        profileFileName = NULL;
+        }
+    profilerOn = false;
+    }
+
+
+
+void startProfilePhase( ProfilePhase inPhase ) {
+    if( ! profilerOn ) {
+        return;
+        }
+    phaseStats[ inPhase ].startTime = Time::getCurrentTime();
+    }
+
+
+
+double endProfilePhase( ProfilePhase inPhase ) {
+    if( ! profilerOn ) {
+        return 0;
+        }
+
+    double seconds =
+        Time::getCurrentTime() - phaseStats[ inPhase ].startTime;
+
+    recordProfilePhase( inPhase, seconds );
+
+    return seconds;
+    }
+
+
+
+static int getBucket( double inSeconds ) {
+    double micro = inSeconds * 1000000;
+
+    if( micro < 4 ) {
+        if( micro < 0 ) {
+            return 0;
+            }
+        return (int)micro;
+        }
+    if( micro >= 4294967295.0 ) {
+        return NUM_PROFILE_BUCKETS - 1;
+        }
+
+    unsigned int v = (unsigned int)micro;
+
+    // highest bit set
+    int e = 31;
+    while( ( v & ( 1u << e ) ) == 0 ) {
+        e--;
+        }
+
+    // next two bits pick the bucket within this power of 2
+    int sub = ( v >> ( e - 2 ) ) & 3;
+
+    return 4 * ( e - 1 ) + sub;
+    }
+
+
+
+// top of range covered by bucket, in seconds
+static double getBucketTop( int inBucket ) {
+    if( inBucket < 4 ) {
+        return ( inBucket + 1 ) / 1000000.0;
+        }
+
+    int e = inBucket / 4 + 1;
+    int sub = inBucket % 4;
+
+    double bottom = (double)( 4 + sub ) * ( 1u << ( e - 2 ) );
+    double width = (double)( 1u << ( e - 2 ) );
+
+    return ( bottom + width ) / 1000000.0;
+    }
+
+
+
+void recordProfilePhase( ProfilePhase inPhase, double inSeconds ) {
+    if( ! profilerOn ) {
+        return;
+        }
+
+    PhaseStats *s = &( phaseStats[ inPhase ] );
+
+    s->count++;
+    s->totalSeconds += inSeconds;
+
+    if( inSeconds > s->maxSeconds ) {
+        s->maxSeconds = inSeconds;
+        }
+
+    s->buckets[ getBucket( inSeconds ) ]++;
+    }
+
+
+
+void addProfileCount( ProfileCounter inCounter, unsigned int inAmount ) {
+    if( ! profilerOn ) {
+        return;
+        }
+    counters[ inCounter ] += inAmount;
+    }
+
+
+
+// never more than max seen, since top of bucket can be past it
+static double getPercentile( PhaseStats *inStats, double inFraction ) {
+    if( inStats->count == 0 ) {
+        return 0;
+        }
+
+    unsigned int target = (unsigned int)( inFraction * inStats->count );
+
+    if( target >= inStats->count ) {
+        target = inStats->count - 1;
+        }
+
+    unsigned int seen = 0;
+
+    for( int b=0; b<NUM_PROFILE_BUCKETS; b++ ) {
+        seen += inStats->buckets[b];
+
+        if( seen > target ) {
+            double top = getBucketTop( b );
+
+            if( top > inStats->maxSeconds ) {
+                top = inStats->maxSeconds;
+                }
+            return top;
+            }
+        }
+
+    return inStats->maxSeconds;
+    }
+
+
+
+static void writeStatsFile( double inCurrentTime ) {
+    char *tempName = autoSprintf( "%s.temp", profileFileName );
+
+    FILE *f = fopen( tempName, "w" );
+
+    if( f == NULL ) {
+        AppLog::errorF( "Failed to open %s for writing", tempName );
+        delete [] tempName;
+        return;
+        }
+
+    fprintf( f, "time %.0f\n", (double)Time::timeSec() );
+    fprintf( f, "seconds %.1f\n", inCurrentTime - intervalStartTime );
+
+    fprintf( f, "# phase name count p50_ms p99_ms max_ms total_ms\n" );
+
+    for( int p=0; p<NUM_PROFILE_PHASES; p++ ) {
+        PhaseStats *s = &( phaseStats[p] );
+
+        fprintf( f, "phase %s %u %.3f %.3f %.3f %.1f\n",
+                 phaseNames[p], s->count,
+                 getPercentile( s, 0.5 ) * 1000,
+                 getPercentile( s, 0.99 ) * 1000,
+                 s->maxSeconds * 1000,
+                 s->totalSeconds * 1000 );
+        }
+
+    fprintf( f, "# counter name count\n" );
+
+    for( int c=0; c<NUM_PROFILE_COUNTERS; c++ ) {
+        fprintf( f, "counter %s %u\n", counterNames[c], counters[c] );
+        }
+
+    fclose( f );
+
+    if( rename( tempName, profileFileName ) != 0 ) {
+        AppLog::errorF( "Failed to rename %s to %s",
+                        tempName, profileFileName );
+        }
+
+    delete [] tempName;
+    }
+
+
+
+void stepTickProfiler() {
+    if( ! profilerOn ) {
+        return;
+        }
+
+    double currentTime = Time::getCurrentTime();
+
+    if( currentTime - intervalStartTime < profileIntervalSeconds ) {
+        return;
+        }
+
+    writeStatsFile( currentTime );
+
+    PhaseStats *step = &( phaseStats[ PROFILE_STEP ] );
+
+    AppLog::infoF( "Main loop: %u steps, p50 %.2f ms, p99 %.2f ms, "
+                   "max %.2f ms",
+                   step->count,
+                   getPercentile( step, 0.5 ) * 1000,
+                   getPercentile( step, 0.99 ) * 1000,
+                   step->maxSeconds * 1000 );
+
+    resetStats();
+    }
+
+
+
+void flushTickProfiler() {
+    if( ! profilerOn ) {
+        return;
+        }
+
+    double currentTime = Time::getCurrentTime();
+
+    writeStatsFile( currentTime );
+
+    for( int p=0; p<NUM_PROFILE_PHASES; p++ ) {
+        PhaseStats *s = &( phaseStats[p] );
+
+        AppLog::infoF( "Phase %-12s %8u times, p50 %.3f ms, p99 %.3f ms, "
+                       "max %.3f ms, total %.1f ms",
+                       phaseNames[p], s->count,
+                       getPercentile( s, 0.5 ) * 1000,
+                       getPercentile( s, 0.99 ) * 1000,
+                       s->maxSeconds * 1000,
+                       s->totalSeconds * 1000 );
+        }
+
+    resetStats();
+    }
@@ -0,0 +1,82 @@
+
+
+// Times phases of the server's main loop, and counts events, and
+// periodically writes what it saw to a stats file
+//
+// Each phase keeps a histogram of its durations, with four buckets for
+// each power of 2 microseconds, so percentiles are accurate to within
+// about 20% without keeping every sample.
+//
+// tickProfileSeconds.ini sets how often the stats file is rewritten, and
+// how much time each rewrite covers.  With 0, nothing is timed or
+// counted.
+//
+// tickProfileFile.ini names the stats file.  It is written to a
+// temporary file first and then renamed, so scripts that read it (like
+// monitorServer.sh) never see it half-written.  Lines look like:
+//
+//    phase name count p50_ms p99_ms max_ms total_ms
+//    counter name count
+
+
+
+typedef enum ProfilePhase {
+    // whole main loop step, not counting time waiting for sockets
+    PROFILE_STEP = 0,
+    PROFILE_WAIT,
+    PROFILE_PERIODIC,
+    PROFILE_BACKUP,
+    PROFILE_CONNECTIONS,
+    PROFILE_MESSAGES,
+    PROFILE_PLAYER_STEP,
+    PROFILE_HEAT,
+    PROFILE_UPDATES,
+    PROFILE_STEP_MAP,
+    PROFILE_FORMAT,
+    PROFILE_SENDS,
+    PROFILE_CLEANUP,
+    NUM_PROFILE_PHASES
+    } ProfilePhase;
+
+
+
+typedef enum ProfileCounter {
+    PROFILE_DB_GETS = 0,
+    PROFILE_DB_CACHE_HITS,
+    PROFILE_DB_PUTS,
+    PROFILE_MESSAGES_RECEIVED,
+    PROFILE_BYTES_RECEIVED,
+    PROFILE_BYTES_SENT,
+    // bytes sent to clients that take stream compression, before and
+    // after
+    PROFILE_STREAM_RAW_BYTES,
+    PROFILE_STREAM_COMPRESSED_BYTES,
+    NUM_PROFILE_COUNTERS
+    } ProfileCounter;
+
+
+
+void initTickProfiler();
+
+void freeTickProfiler();
+
+
+void startProfilePhase( ProfilePhase inPhase );
+
+// returns seconds since matching startProfilePhase
+double endProfilePhase( ProfilePhase inPhase );
+
+// for durations measured some other way
+void recordProfilePhase( ProfilePhase inPhase, double inSeconds );
+
+
+void addProfileCount( ProfileCounter inCounter, unsigned int inAmount = 1 );
+
+
+// writes stats file if it is due
+void stepTickProfiler();
+
+
+// writes stats file now, and logs timings of each phase, covering
+// everything since stats file was last written
+void flushTickProfiler();
@@ -0,0 +1,571 @@
+#include "kissdb.h"
+#include "stackdb.h"
+#include "lineardb.h"
+#include "lineardb2.h"
+#include "lineardb3.h"
+
+#include "dbCommon.h"
+#include "mapTile.h"
+#include "containedRecord.h"
+#include "mapTrace.h"
+
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+
+// Replays a map access trace, recorded by the server while
+// recordMapTraceSeconds.ini is set (see mapTrace.h), against each DB
+// backend, and reports throughput, per-access latency, file size, and
+// peak RSS for each.
+//
+// Each backend runs in its own child process, so that RSS numbers
+// don't include the others.
+//
+// Two layouts of map data:
+//
+//   tiles: what map.cpp stores now.  Base objects, floors, and their
+//          ETAs live in mapTiles.db, one record per tile of cells, so
+//          each put reads, changes, and rewrites a whole tile.
+//          Container slots live in mapContained.db, one page per cell.
+//
+//   cells: the old layout, one record per cell and slot in map.db,
+//          mapTime.db, floor.db, and floorTime.db.
+//
+// Note that the server keeps caches in front of the DB, and the trace is
+// recorded in front of those caches, so this measures the DB without
+// them.
+
+
+#define TABLE_SIZE 80000
+
+
+// these must match map.cpp
+#define DECAY_SLOT 1
+#define NUM_CONT_SLOT 2
+#define NO_DECAY_SLOT -1
+
+
+
+void usage() {
+    printf( "Usage:\n" );
+    printf( "traceBenchmark trace_file [tiles|cells] [backend_name]\n\n" );
+
+    printf( "Example:\n" );
+    printf( "traceBenchmark mapTrace_1539763200.trace tiles LinearDB3\n\n" );
+
+    printf( "Runs all backends with tiles layout if left off.\n\n" );
+
+    exit( 1 );
+    }
+
+
+
+typedef struct Backend {
+        const char *name;
+
+        // called before any DBs are opened
+        void (*setup)();
+
+        void *(*newDB)();
+        void (*deleteDB)( void *inDB );
+
+        // returns 0 on success
+        int (*open)( void *inDB, const char *inPath,
+                     unsigned int inKeySize, unsigned int inValueSize );
+
+        void (*close)( void *inDB );
+
+        // returns 0 if found
+        int (*get)( void *inDB, const void *inKey, void *outValue );
+
+        int (*put)( void *inDB, const void *inKey, const void *inValue );
+    } Backend;
+
+
+
+// wraps a backend's calls with the signatures in Backend
+#define BACKEND_FUNCTIONS( NAME )                                         \
+    static void *NAME##_new() {                                           \
+        return new NAME;                                                  \
+        }                                                                 \
+    static void NAME##_delete( void *inDB ) {                             \
+        delete (NAME*)inDB;                                               \
+        }                                                                 \
+    static int NAME##_openW( void *inDB, const char *inPath,              \
+                             unsigned int inKeySize,                      \
+                             unsigned int inValueSize ) {                 \
+        return NAME##_open( (NAME*)inDB, inPath,                          \
+                            KISSDB_OPEN_MODE_RWCREAT, TABLE_SIZE,         \
+                            inKeySize, inValueSize );                     \
+        }                                                                 \
+    static void NAME##_closeW( void *inDB ) {                             \
+        NAME##_close( (NAME*)inDB );                                      \
+        }                                                                 \
+    static int NAME##_getW( void *inDB, const void *inKey,                \
+                            void *outValue ) {                            \
+        return NAME##_get( (NAME*)inDB, inKey, outValue );                \
+        }                                                                 \
+    static int NAME##_putW( void *inDB, const void *inKey,                \
+                            const void *inValue ) {                       \
+        return NAME##_put( (NAME*)inDB, inKey, inValue );                 \
+        }
+
+#define BACKEND_ENTRY( NAME, LABEL, SETUP )                               \
+    { LABEL, SETUP, NAME##_new, NAME##_delete, NAME##_openW,              \
+      NAME##_closeW, NAME##_getW, NAME##_putW }
+
+
+BACKEND_FUNCTIONS( KISSDB )
+BACKEND_FUNCTIONS( STACKDB )
+BACKEND_FUNCTIONS( LINEARDB )
+BACKEND_FUNCTIONS( LINEARDB2 )
+BACKEND_FUNCTIONS( LINEARDB3 )
+
+
+static void noSetup() {
+    }
+
+static void mmapSetup() {
+    LINEARDB3_setUseMmap( true );
+    }
+
+
+static Backend backends[] = {
+    BACKEND_ENTRY( KISSDB, "KissDB", noSetup ),
+    BACKEND_ENTRY( STACKDB, "StackDB", noSetup ),
+    BACKEND_ENTRY( LINEARDB, "LinearDB", noSetup ),
+    BACKEND_ENTRY( LINEARDB2, "LinearDB2", noSetup ),
+    BACKEND_ENTRY( LINEARDB3, "LinearDB3", noSetup ),
+    BACKEND_ENTRY( LINEARDB3, "LinearDB3mmap", mmapSetup )
+    };
+
+#define NUM_BACKENDS (int)( sizeof( backends ) / sizeof( Backend ) )
+
+
+
+typedef struct OpenDB {
+        const char *fileName;
+        unsigned int keySize;
+        unsigned int valueSize;
+        void *db;
+    } OpenDB;
+
+
+static OpenDB tileDBs[2] = {
+    { "traceTest_mapTiles.db", MAP_TILE_KEY_BYTES, MAP_TILE_BYTES, NULL },
+    { "traceTest_mapContained.db", CONTAINED_RECORD_KEY_BYTES,
+      CONTAINED_RECORD_PAGE_BYTES, NULL } };
+
+static OpenDB cellDBs[4] = {
+    { "traceTest_map.db", 16, 4, NULL },
+    { "traceTest_mapTime.db", 16, 8, NULL },
+    { "traceTest_floor.db", 8, 4, NULL },
+    { "traceTest_floorTime.db", 8, 8, NULL } };
+
+
+
+static char isContainerSlot( int inSlot, int inSubCont ) {
+    return
+        inSubCont > 0 ||
+        inSlot >= NUM_CONT_SLOT ||
+        inSlot == NO_DECAY_SLOT;
+    }
+
+
+
+static void intQuadToKey( int inX, int inY, int inSlot, int inB,
+                          unsigned char *outKey ) {
+    intToValue( inX, outKey );
+    intToValue( inY, &( outKey[4] ) );
+    intToValue( inSlot, &( outKey[8] ) );
+    intToValue( inB, &( outKey[12] ) );
+    }
+
+
+
+static char isPut( MapTraceRecord *inR ) {
+    return
+        inR->op == MAP_TRACE_PUT ||
+        inR->op == MAP_TRACE_TIME_PUT ||
+        inR->op == MAP_TRACE_FLOOR_PUT ||
+        inR->op == MAP_TRACE_FLOOR_TIME_PUT;
+    }
+
+
+
+// same DB accesses that map.cpp makes, minus its caches
+static void replayTiles( Backend *inB, MapTraceRecord *inR ) {
+    static unsigned char value[ MAP_TILE_BYTES ];
+    static MapTile tile;
+
+    char put = isPut( inR );
+
+    if( inR->op <= MAP_TRACE_TIME_PUT &&
+        isContainerSlot( inR->slot, inR->subCont ) ) {
+
+        // whole container tree is read and rewritten, usually one page
+        unsigned char key[ CONTAINED_RECORD_KEY_BYTES ];
+
+        intToValue( inR->x, key );
+        intToValue( inR->y, &( key[4] ) );
+        intToValue( 0, &( key[8] ) );
+
+        void *db = tileDBs[1].db;
+
+        if( inB->get( db, key, value ) != 0 ) {
+            memset( value, 0, CONTAINED_RECORD_PAGE_BYTES );
+            }
+
+        if( put ) {
+            intToValue( (int)inR->value, value );
+            inB->put( db, key, value );
+            }
+        return;
+        }
+
+    int cell = getMapTileCellIndex( inR->x, inR->y );
+
+    switch( inR->op ) {
+        case MAP_TRACE_GET:
+        case MAP_TRACE_PUT:
+            if( inR->slot != 0 ) {
+                // not stored
+                return;
+                }
+            break;
+        case MAP_TRACE_TIME_GET:
+        case MAP_TRACE_TIME_PUT:
+            if( inR->slot != DECAY_SLOT ) {
+                return;
+                }
+            break;
+        default:
+            break;
+        }
+
+    unsigned char key[ MAP_TILE_KEY_BYTES ];
+    mapTileKey( inR->x, inR->y, key );
+
+    void *db = tileDBs[0].db;
+
+    if( inB->get( db, key, value ) == 0 ) {
+        decodeMapTile( value, inR->x, inR->y, &tile );
+        }
+    else {
+        clearMapTile( &tile, inR->x, inR->y );
+        }
+
+    if( ! put ) {
+        return;
+        }
+
+    switch( inR->op ) {
+        case MAP_TRACE_PUT:
+            tile.objects[ cell ] = (int)inR->value;
+            break;
+        case MAP_TRACE_TIME_PUT:
+            tile.objectEtas[ cell ] = inR->value;
+            break;
+        case MAP_TRACE_FLOOR_PUT:
+            tile.floors[ cell ] = (int)inR->value;
+            break;
+        case MAP_TRACE_FLOOR_TIME_PUT:
+            tile.floorEtas[ cell ] = inR->value;
+            break;
+        default:
+            break;
+        }
+
+    encodeMapTile( &tile, value );
+    inB->put( db, key, value );
+    }
+
+
+
+// DB accesses that map.cpp made before mapTiles.db and mapContained.db
+static void replayCells( Backend *inB, MapTraceRecord *inR ) {
+    unsigned char key[16];
+    unsigned char value[8];
+
+    int dbIndex = 0;
+
+    switch( inR->op ) {
+        case MAP_TRACE_GET:
+        case MAP_TRACE_PUT:
+            dbIndex = 0;
+            break;
+        case MAP_TRACE_TIME_GET:
+        case MAP_TRACE_TIME_PUT:
+            dbIndex = 1;
+            break;
+        case MAP_TRACE_FLOOR_GET:
+        case MAP_TRACE_FLOOR_PUT:
+            dbIndex = 2;
+            break;
+        default:
+            dbIndex = 3;
+            break;
+        }
+
+    OpenDB *o = &( cellDBs[ dbIndex ] );
+
+    if( o->keySize == 16 ) {
+        intQuadToKey( inR->x, inR->y, inR->slot, inR->subCont, key );
+        }
+    else {
+        intToValue( inR->x, key );
+        intToValue( inR->y, &( key[4] ) );
+        }
+
+    if( ! isPut( inR ) ) {
+        inB->get( o->db, key, value );
+        return;
+        }
+
+    if( o->valueSize == 4 ) {
+        intToValue( (int)inR->value, value );
+        }
+    else {
+        timeToValue( inR->value, value );
+        }
+
+    inB->put( o->db, key, value );
+    }
+
+
+
+static int compareFloats( const void *inA, const void *inB ) {
+    float a = *(float*)inA;
+    float b = *(float*)inB;
+
+    if( a < b ) {
+        return -1;
+        }
+    if( a > b ) {
+        return 1;
+        }
+    return 0;
+    }
+
+
+
+// in KiB, from /proc
+static int getPeakRSS() {
+    FILE *f = fopen( "/proc/self/status", "r" );
+
+    if( f == NULL ) {
+        return -1;
+        }
+
+    char line[200];
+    int kib = -1;
+
+    while( fgets( line, sizeof( line ), f ) != NULL ) {
+        if( sscanf( line, "VmHWM: %d", &kib ) == 1 ) {
+            break;
+            }
+        }
+    fclose( f );
+
+    return kib;
+    }
+
+
+
+// returns 0 on success
+static int runBackend( Backend *inB, char inTiles,
+                       MapTraceRecord *inRecords, int inNumRecords ) {
+
+    OpenDB *dbs = inTiles ? tileDBs : cellDBs;
+    int numDBs = inTiles ? 2 : 4;
+
+    inB->setup();
+
+    for( int i=0; i<numDBs; i++ ) {
+        remove( dbs[i].fileName );
+
+        dbs[i].db = inB->newDB();
+
+        if( inB->open( dbs[i].db, dbs[i].fileName,
+                       dbs[i].keySize, dbs[i].valueSize ) != 0 ) {
+            printf( "%s failed to open %s\n", inB->name, dbs[i].fileName );
+            return 1;
+            }
+        }
+
+    float *latencies = new float[ inNumRecords ];
+
+    double startTime = Time::getCurrentTime();
+
+    for( int i=0; i<inNumRecords; i++ ) {
+        double opStart = Time::getCurrentTime();
+
+        if( inTiles ) {
+            replayTiles( inB, &( inRecords[i] ) );
+            }
+        else {
+            replayCells( inB, &( inRecords[i] ) );
+            }
+
+        // microseconds
+        latencies[i] = (float)( ( Time::getCurrentTime() - opStart ) * 1e6 );
+        }
+
+    double totalTime = Time::getCurrentTime() - startTime;
+
+    double fileBytes = 0;
+
+    for( int i=0; i<numDBs; i++ ) {
+        inB->close( dbs[i].db );
+        inB->deleteDB( dbs[i].db );
+
+        struct stat fileStat;
+
+        if( stat( dbs[i].fileName, &fileStat ) == 0 ) {
+            fileBytes += fileStat.st_size;
+            }
+        remove( dbs[i].fileName );
+        }
+
+    qsort( latencies, inNumRecords, sizeof( float ), compareFloats );
+
+    printf( "%-14s %10.0f %9.2f %9.2f %10.2f %9.1f %9.1f\n",
+            inB->name,
+            inNumRecords / totalTime,
+            latencies[ inNumRecords / 2 ],
+            latencies[ (int)( inNumRecords * 0.99 ) ],
+            latencies[ inNumRecords - 1 ],
+            fileBytes / 1048576.0,
+            getPeakRSS() / 1024.0 );
+
+    delete [] latencies;
+
+    return 0;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    if( inNumArgs < 2 || inNumArgs > 4 ) {
+        usage();
+        }
+
+    char tiles = true;
+
+    if( inNumArgs > 2 ) {
+        if( strcmp( inArgs[2], "cells" ) == 0 ) {
+            tiles = false;
+            }
+        else if( strcmp( inArgs[2], "tiles" ) != 0 ) {
+            usage();
+            }
+        }
+
+    const char *onlyBackend = NULL;
+
+    if( inNumArgs > 3 ) {
+        onlyBackend = inArgs[3];
+        }
+
+
+    FILE *traceFile = fopen( inArgs[1], "rb" );
+
+    if( traceFile == NULL ) {
+        printf( "Failed to open trace file %s\n", inArgs[1] );
+        return 1;
+        }
+
+    char magic[5];
+    magic[4] = '\0';
+
+    if( fread( magic, 4, 1, traceFile ) != 1 ||
+        strcmp( magic, MAP_TRACE_MAGIC ) != 0 ) {
+        printf( "%s is not a map trace file\n", inArgs[1] );
+        return 1;
+        }
+
+    fseek( traceFile, 0, SEEK_END );
+    int numRecords = ( ftell( traceFile ) - 4 ) / MAP_TRACE_RECORD_BYTES;
+    fseek( traceFile, 4, SEEK_SET );
+
+    if( numRecords <= 0 ) {
+        printf( "Trace file %s is empty\n", inArgs[1] );
+        return 1;
+        }
+
+    MapTraceRecord *records = new MapTraceRecord[ numRecords ];
+
+    int opCounts[ MAP_TRACE_NUM_OPS ];
+    memset( opCounts, 0, sizeof( opCounts ) );
+
+    for( int i=0; i<numRecords; i++ ) {
+        unsigned char bytes[ MAP_TRACE_RECORD_BYTES ];
+
+        if( fread( bytes, MAP_TRACE_RECORD_BYTES, 1, traceFile ) != 1 ) {
+            printf( "Failed to read trace record %d\n", i );
+            return 1;
+            }
+        decodeMapTraceRecord( bytes, &( records[i] ) );
+
+        if( records[i].op < MAP_TRACE_NUM_OPS ) {
+            opCounts[ records[i].op ]++;
+            }
+        }
+
+    fclose( traceFile );
+
+    printf( "Trace has %d accesses over %.1f seconds of server time\n",
+            numRecords, records[ numRecords - 1 ].time );
+    printf( "get %d, put %d, timeGet %d, timePut %d, floorGet %d, "
+            "floorPut %d, floorTimeGet %d, floorTimePut %d\n\n",
+            opCounts[ MAP_TRACE_GET ], opCounts[ MAP_TRACE_PUT ],
+            opCounts[ MAP_TRACE_TIME_GET ], opCounts[ MAP_TRACE_TIME_PUT ],
+            opCounts[ MAP_TRACE_FLOOR_GET ], opCounts[ MAP_TRACE_FLOOR_PUT ],
+            opCounts[ MAP_TRACE_FLOOR_TIME_GET ],
+            opCounts[ MAP_TRACE_FLOOR_TIME_PUT ] );
+
+    printf( "Replaying with %s layout\n\n", tiles ? "tiles" : "cells" );
+
+    printf( "%-14s %10s %9s %9s %10s %9s %9s\n",
+            "backend", "ops/sec", "p50 us", "p99 us", "max us",
+            "file MiB", "RSS MiB" );
+    fflush( stdout );
+
+    int numFailed = 0;
+
+    for( int b=0; b<NUM_BACKENDS; b++ ) {
+        if( onlyBackend != NULL &&
+            strcmp( onlyBackend, backends[b].name ) != 0 ) {
+            continue;
+            }
+
+        pid_t pid = fork();
+
+        if( pid == 0 ) {
+            int result = runBackend( &( backends[b] ), tiles,
+                                     records, numRecords );
+            fflush( stdout );
+            _exit( result );
+            }
+
+        int status = 1;
+
+        if( pid < 0 || waitpid( pid, &status, 0 ) != pid ||
+            ! WIFEXITED( status ) || WEXITSTATUS( status ) != 0 ) {
+            printf( "%-14s failed\n", backends[b].name );
+            numFailed++;
+            }
+        }
+
+    delete [] records;
+
+    return numFailed;
+    }